@@ -228,6 +228,8 @@ void Sample::Tick()
 
     Render();
 
+    DX::CPUProfiler::Get().EndFrame();
+
     PIXEndEvent();
     m_frame++;
 }
@@ -236,6 +238,7 @@ void Sample::Tick()
 void Sample::Update(DX::StepTimer const& timer)
 {
     PIXBeginEvent(PIX_COLOR_DEFAULT, L"Update");
+    DX::CPUProfileZone zone("Update");
 
     float elapsedTime = float(timer.GetElapsedSeconds());
     auto toggleRight = false;
@@ -287,6 +290,11 @@ void Sample::Update(DX::StepTimer const& timer)
         m_liveResources->SignIn();
     }
 
+    if (m_keyboardButtons.IsKeyPressed(Keyboard::P))
+    {
+        ShowProfile();
+    }
+
     if (m_keyboardButtons.IsKeyPressed(Keyboard::Left))
     {
         toggleLeft = true;
@@ -335,6 +343,20 @@ void Sample::Update(DX::StepTimer const& timer)
 
     PIXEndEvent();
 }
+
+// Writes the CPU time of each profiled zone over recent frames to the console.
+void Sample::ShowProfile()
+{
+    std::vector<DX::CPUProfiler::ZoneStats> stats;
+    DX::CPUProfiler::Get().GetZoneStats(stats);
+
+    m_console->WriteLine(L"CPU profile (ms): last / average / max / 99th percentile");
+    for (const auto& zone : stats)
+    {
+        m_console->Format(L"%*hs%hs: %.3f / %.3f / %.3f / %.3f\n",
+            int(zone.depth * 2), "", zone.name, zone.lastMS, zone.averageMS, zone.maxMS, zone.p99MS);
+    }
+}
 #pragma endregion
 
 #pragma region Frame Render
@@ -351,8 +373,11 @@ void Sample::Render()
 
     auto context = m_deviceResources->GetD3DDeviceContext();
     PIXBeginEvent(context, PIX_COLOR_DEFAULT, L"Render");
-    m_ui->Render();
-    m_console->Render();
+    {
+        DX::CPUProfileZone zone("Render");
+        m_ui->Render();
+        m_console->Render();
+    }
     PIXEndEvent(context);
 
     // Show the new frame.
@@ -48,6 +48,7 @@ public:
 private:
 
     void Update(DX::StepTimer const& timer);
+    void ShowProfile();
     void Render();
 
     void Clear();
@@ -176,11 +176,8 @@ void Sample::UpdateSocialManager()
 {
     // Process events from the social manager
     // This should be called each frame update
+    DX::CPUProfileZone zone("UpdateSocialManager");
 
-#if PERF_COUNTERS
-    auto perfInstance = performance_counters::get_singleton_instance();
-    perfInstance->begin_capture(L"updates");
-#endif
     auto socialEvents = m_socialManager->do_work();
     std::wstring text;
 
@@ -221,9 +218,6 @@ void Sample::UpdateSocialManager()
         source << _T(".");
         m_console->WriteLine(source.str().c_str());
     }
-#if PERF_COUNTERS
-    perfInstance->end_capture(L"updates");
-#endif
 }
 
 std::vector<std::shared_ptr<xbox_social_user_group>> Sample::GetSocialGroups()
@@ -36,6 +36,7 @@
 #include "Mouse.h"
 #include "SpriteBatch.h"
 #include "SpriteFont.h"
+#include "CPUProfiler.h"
 #include "TextConsole.h"
 
 
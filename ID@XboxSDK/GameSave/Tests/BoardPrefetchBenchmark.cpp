@@ -0,0 +1,396 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+//
+// Switches between the game boards as the game board screen does, and measures how long each switch
+// waits before the new active board is loaded. Boards are either read when they become active, as
+// GameSaveManager did before prefetching, or prefetched with the logic of PrefetchBoards, ReadBoards,
+// ReadBoard and TrimPrefetchedBoards. Storage is a LatencyBlobStore, so every read costs a fixed time.
+//
+// The walk steps up through every board, pausing on each as a player would, then flicks quickly back
+// down, and steps up again.
+//
+// Usage: BoardPrefetchBenchmark [read latency ms] [ms on each board] [ms between flicks]
+//
+
+#include "pch.h"
+#include "GameSaveQueryRunner.h"
+#include "LatencyBlobStore.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <list>
+#include <memory>
+#include <numeric>
+#include <thread>
+
+using namespace GameSaveSample;
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    const uint32_t c_boardSize = 512;
+    const size_t c_loadConcurrency = 4;     // BOARD_LOAD_CONCURRENCY
+    const size_t c_prefetchCapacity = 5;    // BOARD_PREFETCH_CAPACITY
+    const wchar_t c_dataBlobName[] = L"data";
+
+    struct Settings
+    {
+        std::chrono::milliseconds   readLatency;
+        std::chrono::milliseconds   dwell;
+        std::chrono::milliseconds   flick;
+    };
+
+    std::wstring GetContainerName(uint32_t boardNumber)
+    {
+        return L"game_board_" + std::to_wstring(boardNumber);
+    }
+
+    // Stands in for GameSave<GameBoard>: a read with keepChanges is discarded if the board is dirty or loaded by the time it completes
+    class Board
+    {
+    public:
+        Board() : m_isLoaded(false), m_isDirty(false) {}
+
+        bool ApplyRead(const BlobData& data, bool keepChanges)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (keepChanges && (m_isDirty || m_isLoaded))
+            {
+                return false;
+            }
+
+            m_data = data;
+            m_isLoaded = true;
+            return true;
+        }
+
+        bool ResetDataIfNotDirty()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_isDirty)
+            {
+                return false;
+            }
+
+            m_data.clear();
+            m_isLoaded = false;
+            return true;
+        }
+
+        bool IsDirtyOrLoaded() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_isDirty || m_isLoaded;
+        }
+
+        bool IsLoaded() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_isLoaded;
+        }
+
+    private:
+        mutable std::mutex  m_mutex;
+        BlobData            m_data;
+        bool                m_isLoaded;
+        bool                m_isDirty;
+    };
+
+    bool ReadBoardData(IGameSaveBlobStore& store, uint32_t boardNumber, BlobData& data)
+    {
+        BlobMap blobs;
+        if (!store.Get(GetContainerName(boardNumber), std::vector<std::wstring>(1, c_dataBlobName), blobs))
+        {
+            return false;
+        }
+
+        data = blobs[c_dataBlobName];
+        return true;
+    }
+
+    // Reads the active board on the game thread if it isn't loaded, as GameSaveManager did before prefetching
+    class ReadOnSwitch
+    {
+    public:
+        ReadOnSwitch(IGameSaveBlobStore& store, std::vector<Board>& boards) : m_store(store), m_boards(boards) {}
+
+        void SetActiveBoard(uint32_t activeBoard)
+        {
+            auto& board = m_boards[activeBoard - 1];
+            BlobData data;
+            if (!board.IsDirtyOrLoaded() && ReadBoardData(m_store, activeBoard, data))
+            {
+                board.ApplyRead(data, false);
+            }
+        }
+
+        void WaitUntilLoaded(uint32_t) {}
+        uint32_t GetUnloads() const { return 0; }
+
+    private:
+        IGameSaveBlobStore&     m_store;
+        std::vector<Board>&     m_boards;
+    };
+
+    // GameSaveManager's prefetching, with a thread for each read standing in for ReadAsync and a flag standing in for the cancellation token
+    class Prefetcher
+    {
+    public:
+        Prefetcher(IGameSaveBlobStore& store, std::vector<Board>& boards) :
+            m_store(store),
+            m_boards(boards),
+            m_canceled(std::make_shared<std::atomic<bool>>(false)),
+            m_batches(0),
+            m_unloads(0)
+        {}
+
+        ~Prefetcher()
+        {
+            std::unique_lock<std::mutex> lock(m_boardReadMutex);
+            m_readCompleted.wait(lock, [this] { return m_batches == 0 && m_boardReads.empty(); });
+        }
+
+        // As PrefetchBoards, called from the thread which sets the active board
+        void SetActiveBoard(uint32_t activeBoard)
+        {
+            std::vector<uint32_t> boardNumbers;
+            boardNumbers.push_back(activeBoard);
+            if (activeBoard > 1)
+            {
+                boardNumbers.push_back(activeBoard - 1);
+            }
+            if (activeBoard < m_boards.size())
+            {
+                boardNumbers.push_back(activeBoard + 1);
+            }
+
+            std::shared_ptr<std::atomic<bool>> canceled;
+            {
+                std::lock_guard<std::mutex> lock(m_boardReadMutex);
+
+                *m_canceled = true;
+                m_canceled = std::make_shared<std::atomic<bool>>(false);
+                canceled = m_canceled;
+
+                for (auto boardNumber = boardNumbers.rbegin(); boardNumber != boardNumbers.rend(); ++boardNumber)
+                {
+                    auto prefetchedBoard = std::find(m_prefetchedBoards.begin(), m_prefetchedBoards.end(), *boardNumber);
+                    if (prefetchedBoard != m_prefetchedBoards.end())
+                    {
+                        m_prefetchedBoards.splice(m_prefetchedBoards.begin(), m_prefetchedBoards, prefetchedBoard);
+                    }
+                }
+
+                TrimPrefetchedBoards(activeBoard);
+            }
+
+            ReadBoards(std::move(boardNumbers), canceled);
+        }
+
+        void WaitUntilLoaded(uint32_t boardNumber)
+        {
+            std::unique_lock<std::mutex> lock(m_boardReadMutex);
+            m_readCompleted.wait(lock, [this, boardNumber] { return m_boards[boardNumber - 1].IsLoaded(); });
+        }
+
+        uint32_t GetUnloads() const { return m_unloads; }
+
+    private:
+        typedef std::function<void(bool loadSuccess)> ReadFunction;
+
+        void ReadBoards(std::vector<uint32_t> boardNumbers, std::shared_ptr<std::atomic<bool>> canceled)
+        {
+            std::vector<GameSaveQueryRunner::StartFunction> boardReads;
+            for (auto boardNumber : boardNumbers)
+            {
+                boardReads.push_back([this, boardNumber, canceled](GameSaveQueryRunner::CompletionFunction onComplete)
+                {
+                    if (*canceled || m_boards[boardNumber - 1].IsDirtyOrLoaded())
+                    {
+                        onComplete(true);
+                        return;
+                    }
+
+                    ReadBoard(boardNumber, [this, boardNumber, canceled, onComplete](bool loadSuccess)
+                    {
+                        if (loadSuccess)
+                        {
+                            std::lock_guard<std::mutex> lock(m_boardReadMutex);
+                            if (std::find(m_prefetchedBoards.begin(), m_prefetchedBoards.end(), boardNumber) == m_prefetchedBoards.end())
+                            {
+                                if (*canceled)
+                                {
+                                    m_prefetchedBoards.push_back(boardNumber);
+                                }
+                                else
+                                {
+                                    m_prefetchedBoards.push_front(boardNumber);
+                                }
+                            }
+                        }
+                        onComplete(loadSuccess);
+                    });
+                });
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_boardReadMutex);
+                ++m_batches;
+            }
+
+            GameSaveQueryRunner::Run(std::move(boardReads), c_loadConcurrency, [this](uint32_t)
+            {
+                std::lock_guard<std::mutex> lock(m_boardReadMutex);
+                --m_batches;
+                m_readCompleted.notify_all();
+            });
+        }
+
+        // Starts a read of the board, or joins the read already in flight for it
+        void ReadBoard(uint32_t boardNumber, ReadFunction onRead)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_boardReadMutex);
+                auto boardRead = m_boardReads.find(boardNumber);
+                if (boardRead != m_boardReads.end())
+                {
+                    boardRead->second.push_back(onRead);
+                    return;
+                }
+
+                m_boardReads[boardNumber].push_back(onRead);
+            }
+
+            std::thread([this, boardNumber]
+            {
+                BlobData data;
+                bool loadSuccess = ReadBoardData(m_store, boardNumber, data) && m_boards[boardNumber - 1].ApplyRead(data, true);
+
+                std::vector<ReadFunction> readers;
+                {
+                    std::lock_guard<std::mutex> lock(m_boardReadMutex);
+                    readers.swap(m_boardReads[boardNumber]);
+                    m_boardReads.erase(boardNumber);
+                    m_readCompleted.notify_all();
+                }
+
+                for (auto& reader : readers)
+                {
+                    reader(loadSuccess);
+                }
+            }).detach();
+        }
+
+        // Call with m_boardReadMutex held
+        void TrimPrefetchedBoards(uint32_t activeBoard)
+        {
+            while (m_prefetchedBoards.size() > c_prefetchCapacity)
+            {
+                auto boardNumber = m_prefetchedBoards.back();
+                m_prefetchedBoards.pop_back();
+
+                if (boardNumber != activeBoard && m_boardReads.find(boardNumber) == m_boardReads.end() && m_boards[boardNumber - 1].ResetDataIfNotDirty())
+                {
+                    ++m_unloads;
+                }
+            }
+        }
+
+        IGameSaveBlobStore&                             m_store;
+        std::vector<Board>&                             m_boards;
+        std::mutex                                      m_boardReadMutex;
+        std::condition_variable                         m_readCompleted;
+        std::map<uint32_t, std::vector<ReadFunction>>   m_boardReads;
+        std::list<uint32_t>                             m_prefetchedBoards;
+        std::shared_ptr<std::atomic<bool>>              m_canceled;
+        uint32_t                                        m_batches;
+        uint32_t                                        m_unloads;
+    };
+
+    struct Result
+    {
+        std::vector<double> waitMs;     // From each switch until the new active board was loaded
+        uint64_t            reads;
+        uint32_t            unloads;
+    };
+
+    template<typename TLoader>
+    Result Walk(const Settings& settings)
+    {
+        LatencyBlobStore store(settings.readLatency, std::chrono::microseconds(0));
+        for (uint32_t boardNumber = 1; boardNumber <= c_saveSlotCount; ++boardNumber)
+        {
+            BlobMap updates;
+            updates[c_dataBlobName] = BlobData(c_boardSize, static_cast<uint8_t>(boardNumber));
+            store.SubmitUpdates(GetContainerName(boardNumber), updates, std::vector<std::wstring>());
+        }
+
+        // step up through every board, flick back down, then step up again
+        std::vector<std::pair<uint32_t, std::chrono::milliseconds>> walk;
+        for (uint32_t boardNumber = 1; boardNumber <= c_saveSlotCount; ++boardNumber)
+        {
+            walk.push_back(std::make_pair(boardNumber, settings.dwell));
+        }
+        for (uint32_t boardNumber = c_saveSlotCount - 1; boardNumber >= 1; --boardNumber)
+        {
+            walk.push_back(std::make_pair(boardNumber, settings.flick));
+        }
+        for (uint32_t boardNumber = 2; boardNumber <= c_saveSlotCount; ++boardNumber)
+        {
+            walk.push_back(std::make_pair(boardNumber, settings.dwell));
+        }
+
+        Result result;
+        std::vector<Board> boards(c_saveSlotCount);
+        {
+            TLoader loader(store, boards);
+            for (auto& step : walk)
+            {
+                auto start = Clock::now();
+                loader.SetActiveBoard(step.first);
+                loader.WaitUntilLoaded(step.first);
+                result.waitMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+
+                std::this_thread::sleep_for(step.second);
+            }
+            result.unloads = loader.GetUnloads();
+        }
+        result.reads = store.GetGets();
+        return result;
+    }
+
+    void Print(const char* name, Result result)
+    {
+        std::sort(result.waitMs.begin(), result.waitMs.end());
+        auto waited = std::count_if(result.waitMs.begin(), result.waitMs.end(), [](double waitMs) { return waitMs >= 1.0; });
+        double totalMs = std::accumulate(result.waitMs.begin(), result.waitMs.end(), 0.0);
+        printf("%-10s %12.1f %12.1f %12.1f %8u/%-3u %8llu %8u\n", name, totalMs, result.waitMs[result.waitMs.size() / 2], result.waitMs.back(),
+            static_cast<uint32_t>(waited), static_cast<uint32_t>(result.waitMs.size()), static_cast<unsigned long long>(result.reads), result.unloads);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Settings settings;
+    settings.readLatency = std::chrono::milliseconds((argc > 1) ? atoi(argv[1]) : 80);
+    settings.dwell = std::chrono::milliseconds((argc > 2) ? atoi(argv[2]) : 300);
+    settings.flick = std::chrono::milliseconds((argc > 3) ? atoi(argv[3]) : 30);
+
+    printf("%u boards, %lld ms per read, %lld ms on each board, %lld ms between flicks\n", c_saveSlotCount,
+        static_cast<long long>(settings.readLatency.count()), static_cast<long long>(settings.dwell.count()), static_cast<long long>(settings.flick.count()));
+    printf("%-10s %12s %12s %12s %12s %8s %8s\n", "boards", "total (ms)", "median (ms)", "max (ms)", "waited", "reads", "unloads");
+
+    Print("on switch", Walk<ReadOnSwitch>(settings));
+    Print("prefetch", Walk<Prefetcher>(settings));
+
+    return 0;
+}
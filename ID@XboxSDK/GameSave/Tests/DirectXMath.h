@@ -0,0 +1,32 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+//
+// Stands in for DirectXMath when GameLogic files are built for these tests. Only the types the
+// platform-neutral files and GlobalConstants.h name are declared; none of the math is provided.
+//
+
+#pragma once
+
+#include <stdint.h>
+
+namespace DirectX
+{
+    struct XMUINT2
+    {
+        uint32_t x;
+        uint32_t y;
+
+        XMUINT2() = default;
+        XMUINT2(uint32_t _x, uint32_t _y) : x(_x), y(_y) {}
+    };
+
+    struct XMVECTORF32
+    {
+        float f[4];
+    };
+}
@@ -0,0 +1,318 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+//
+// Property test for GameBoardScorer, which only scores again the rows and columns that changed. Random
+// edits are made to a board, as the game board screen makes them: letters placed, taken back and
+// cleared, whole words dropped in, and the board switched. After each one the score and the word
+// links must match a full recompute, done as the game did before the scorer, with every run of
+// letters built into a std::wstring and looked up in a std::set of the word list.
+//
+// Usage: GameBoardScorerTests [word list path without extension] [sequences]
+//
+
+#include "pch.h"
+#include "GameBoardScorer.h"
+#include "TestHelpers.h"
+
+#include <random>
+#include <set>
+
+using namespace DirectX;
+using namespace GameSaveSample;
+
+namespace
+{
+    const uint32_t c_editsPerSequence = 40;
+
+    struct WordList
+    {
+        std::set<std::wstring>      set;
+        std::vector<std::wstring>   words;
+        WordGraph                   graph;
+    };
+
+    bool ReadWholeFile(const std::string& path, std::vector<uint8_t>& contents)
+    {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (!file)
+        {
+            return false;
+        }
+
+        uint8_t buffer[4096];
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        {
+            contents.insert(contents.end(), buffer, buffer + read);
+        }
+        fclose(file);
+        return true;
+    }
+
+    bool LoadWordList(const std::string& path, WordList& wordList)
+    {
+        std::vector<uint8_t> text;
+        std::vector<uint8_t> graph;
+        if (!ReadWholeFile(path + ".txt", text) || !ReadWholeFile(path + ".dawg", graph) || !wordList.graph.Load(std::move(graph)))
+        {
+            return false;
+        }
+
+        std::wstring word;
+        for (uint8_t c : text)
+        {
+            if (c == '\r' || c == '\n')
+            {
+                if (!word.empty())
+                {
+                    wordList.set.insert(word);
+                    word.clear();
+                }
+            }
+            else
+            {
+                word += static_cast<wchar_t>(c);
+            }
+        }
+
+        wordList.words.assign(wordList.set.begin(), wordList.set.end());
+        return wordList.set.size() == wordList.graph.GetWordCount();
+    }
+
+    struct Links
+    {
+        bool right[c_boardWidth * c_boardHeight];
+        bool down[c_boardWidth * c_boardHeight];
+    };
+
+    // Scores the whole board as GameBoardScreen did before GameBoardScorer
+    int ScoreBoard(GameBoard& gameBoard, const std::set<std::wstring>& words, Links& links)
+    {
+        memset(&links, 0, sizeof(links));
+
+        int score = 0;
+        for (int isHorizontal = 0; isHorizontal < 2; ++isHorizontal)
+        {
+            uint32_t lineCount = isHorizontal ? gameBoard.m_boardHeight : gameBoard.m_boardWidth;
+            uint32_t length = isHorizontal ? gameBoard.m_boardWidth : gameBoard.m_boardHeight;
+            for (uint32_t line = 0; line < lineCount; ++line)
+            {
+                std::wstring currentWord;
+                for (uint32_t k = 0; k <= length; ++k)
+                {
+                    wchar_t letter = 0;
+                    if (k < length)
+                    {
+                        auto& tile = gameBoard.GetGameTile(isHorizontal ? XMUINT2(k, line) : XMUINT2(line, k));
+                        letter = tile.m_placed ? tile.m_letter : 0;
+                    }
+
+                    if (letter != 0)
+                    {
+                        currentWord += letter;
+                        continue;
+                    }
+
+                    if (currentWord.length() >= 2 && words.find(currentWord) != words.end())
+                    {
+                        for (auto c : currentWord)
+                        {
+                            score += GameBoardScorer::GetLetterValue(c);
+                        }
+
+                        // every tile of the word but the last links to the next
+                        for (uint32_t w = k - uint32_t(currentWord.length()); w + 1 < k; ++w)
+                        {
+                            if (isHorizontal)
+                            {
+                                links.right[w + c_boardWidth * line] = true;
+                            }
+                            else
+                            {
+                                links.down[line + c_boardWidth * w] = true;
+                            }
+                        }
+                    }
+                    currentWord.clear();
+                }
+            }
+        }
+        return score;
+    }
+
+    bool HasLinks(const GameBoardScorer& scorer, const Links& links)
+    {
+        for (uint32_t y = 0; y < c_boardHeight; ++y)
+        {
+            for (uint32_t x = 0; x < c_boardWidth; ++x)
+            {
+                auto& tile = scorer.GetWordTrackerTile(XMUINT2(x, y));
+                if (tile.m_wordRight != links.right[x + c_boardWidth * y] || tile.m_wordDown != links.down[x + c_boardWidth * y])
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    wchar_t RandomLetter(std::mt19937& random)
+    {
+        // mostly the letters words are made of
+        static const wchar_t common[] = L"AEIOUSTRNLDE";
+        return (random() % 3 != 0) ? common[random() % (sizeof(common) / sizeof(common[0]) - 1)] : static_cast<wchar_t>(L'A' + random() % 26);
+    }
+
+    void Edit(std::mt19937& random, const WordList& wordList, GameBoard& board, GameBoardScorer& scorer)
+    {
+        auto& tile = board.GetGameTile(XMUINT2(random() % c_boardWidth, random() % c_boardHeight));
+        switch (random() % 16)
+        {
+        case 0: case 1: case 2: case 3: case 4:
+            tile.m_letter = RandomLetter(random);
+            tile.m_placed = true;
+            break;
+        case 5: case 6:
+            // taken back, but the letter stays on the tile
+            tile.m_placed = false;
+            break;
+        case 7: case 8:
+            tile = GameTile();
+            break;
+        case 9:
+            // a letter chosen but not placed
+            tile.m_letter = RandomLetter(random);
+            tile.m_placed = false;
+            break;
+        case 10: case 11: case 12: case 13:
+        {
+            // a whole word, across or down
+            auto& word = wordList.words[random() % wordList.words.size()];
+            bool isHorizontal = random() % 2 == 0;
+            uint32_t length = uint32_t(word.length());
+            uint32_t start = random() % (c_boardWidth - length + 1);
+            uint32_t line = random() % c_boardHeight;
+            for (uint32_t k = 0; k < length; ++k)
+            {
+                auto& wordTile = board.GetGameTile(isHorizontal ? XMUINT2(start + k, line) : XMUINT2(line, start + k));
+                wordTile.m_letter = word[k];
+                wordTile.m_placed = true;
+            }
+            break;
+        }
+        case 14:
+            // another board becomes the active one
+            if (random() % 4 == 0)
+            {
+                board.ResetBoard();
+            }
+            else
+            {
+                for (auto& boardTile : board.m_board)
+                {
+                    boardTile.m_letter = RandomLetter(random);
+                    boardTile.m_placed = random() % 3 != 0;
+                }
+            }
+            break;
+        case 15:
+            if (random() % 4 == 0)
+            {
+                scorer.Reset();
+            }
+            break;
+        }
+    }
+
+    void TestIncrementalMatchesFullRecompute(const WordList& wordList, uint32_t sequences)
+    {
+        std::mt19937 random(48);
+        uint32_t checks = 0;
+        uint32_t scored = 0;
+        for (uint32_t sequence = 0; sequence < sequences && g_failures == 0; ++sequence)
+        {
+            GameBoard board;
+            GameBoardScorer scorer;
+            for (uint32_t edit = 0; edit < c_editsPerSequence; ++edit)
+            {
+                Edit(random, wordList, board, scorer);
+
+                Links links;
+                int expected = ScoreBoard(board, wordList.set, links);
+                int score = scorer.Update(board, wordList.graph);
+                if (score != expected || !HasLinks(scorer, links))
+                {
+                    printf("sequence %u, edit %u: scored %d, expected %d\n", sequence, edit, score, expected);
+                    CHECK(score == expected);
+                    CHECK(HasLinks(scorer, links));
+                    break;
+                }
+
+                // scoring an unchanged board again changes nothing
+                CHECK(scorer.Update(board, wordList.graph) == expected);
+
+                ++checks;
+                scored += (expected > 0) ? 1 : 0;
+            }
+        }
+
+        printf("%u boards checked, %u with a score\n", checks, scored);
+        CHECK(scored > checks / 2);
+    }
+
+    void TestKnownBoard(const WordList& wordList)
+    {
+        // C A T . .
+        // . . O . .
+        // . . E . .
+        GameBoard board;
+        const wchar_t* letters[] = { L"CAT", L"\0\0O", L"\0\0E" };
+        for (uint32_t y = 0; y < 3; ++y)
+        {
+            for (uint32_t x = 0; x < 3; ++x)
+            {
+                auto& tile = board.GetGameTile(XMUINT2(x, y));
+                tile.m_letter = letters[y][x];
+                tile.m_placed = tile.m_letter != 0;
+            }
+        }
+
+        GameBoardScorer scorer;
+        int score = scorer.Update(board, wordList.graph);
+        CHECK(score == (3 + 1 + 1) + (1 + 1 + 1)); // CAT across, TOE down
+        CHECK(scorer.GetWordTrackerTile(XMUINT2(0, 0)).m_wordRight && scorer.GetWordTrackerTile(XMUINT2(1, 0)).m_wordRight);
+        CHECK(!scorer.GetWordTrackerTile(XMUINT2(2, 0)).m_wordRight && scorer.GetWordTrackerTile(XMUINT2(2, 0)).m_wordDown);
+        CHECK(scorer.GetWordTrackerTile(XMUINT2(2, 1)).m_wordDown && !scorer.GetWordTrackerTile(XMUINT2(2, 2)).m_wordDown);
+
+        // Taking back the E leaves TO, and the links of the row are kept
+        board.GetGameTile(XMUINT2(2, 2)).m_placed = false;
+        CHECK(scorer.Update(board, wordList.graph) == 5 + 2);
+        CHECK(scorer.GetWordTrackerTile(XMUINT2(2, 0)).m_wordDown && !scorer.GetWordTrackerTile(XMUINT2(2, 1)).m_wordDown);
+        CHECK(scorer.GetWordTrackerTile(XMUINT2(0, 0)).m_wordRight);
+
+        CHECK(GameBoardScorer::GetLetterValue(L'Q') == 10 && GameBoardScorer::GetLetterValue(L'a') == 0);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string path = (argc > 1) ? argv[1] : "../Xbox/Assets/TWL06_2to5";
+    uint32_t sequences = (argc > 2) ? static_cast<uint32_t>(strtoul(argv[2], nullptr, 10)) : 3000;
+
+    WordList wordList;
+    if (!LoadWordList(path, wordList))
+    {
+        printf("ERROR loading %s.txt and %s.dawg\n", path.c_str(), path.c_str());
+        return 1;
+    }
+
+    TestKnownBoard(wordList);
+    TestIncrementalMatchesFullRecompute(wordList, sequences);
+
+    return ReportResult("GameBoardScorer");
+}
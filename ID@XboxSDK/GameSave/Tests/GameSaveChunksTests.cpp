@@ -0,0 +1,229 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+//
+// Tests for the chunked save format: saves load back byte for byte through each blob store, a save
+// after a small change writes only the chunks it touched, and blobs the new save doesn't use are
+// deleted. The bytes written by each save are printed against the single blob the sample wrote
+// before chunking.
+//
+
+#include "pch.h"
+#include "GameSaveChunks.h"
+#include "TestHelpers.h"
+
+#include <random>
+
+using namespace GameSaveSample;
+
+namespace
+{
+    const uint32_t c_dataSize = 10000;
+
+    // Mostly repetitive, like a game board, with some noise so the codec has work to do
+    std::vector<uint8_t> MakeData(uint32_t size, uint32_t seed)
+    {
+        std::mt19937 random(seed);
+        std::vector<uint8_t> data(size);
+        for (uint32_t j = 0; j < size; ++j)
+        {
+            data[j] = (random() % 4 == 0) ? static_cast<uint8_t>(random()) : static_cast<uint8_t>('A' + j % 26);
+        }
+        return data;
+    }
+
+    bool HasBlob(IGameSaveBlobStore& store, const std::wstring& containerName, const std::wstring& blobName)
+    {
+        auto names = store.GetBlobNames(containerName);
+        return std::find(names.begin(), names.end(), blobName) != names.end();
+    }
+
+    void TestRoundTrip(IGameSaveBlobStore& store)
+    {
+        // Sizes smaller than, equal to and between multiples of the chunk size, and every byte value
+        const uint32_t sizes[] = { 1, 100, c_defaultChunkSize, c_defaultChunkSize + 1, c_dataSize, 64 * 1024 + 3 };
+        const BlobCodec codecs[] = { BlobCodec::Stored, BlobCodec::Lz };
+
+        for (auto size : sizes)
+        {
+            for (auto codec : codecs)
+            {
+                auto data = MakeData(size, size);
+                GameSaveManifest lastSaved;
+                CHECK(SaveChunks(store, L"roundtrip", data.data(), size, c_defaultChunkSize, lastSaved, codec));
+
+                std::vector<uint8_t> loaded(size, 0xCD);
+                GameSaveManifest manifest;
+                CHECK(LoadChunks(store, L"roundtrip", loaded.data(), size, manifest));
+                CHECK(loaded == data);
+                CHECK(manifest.m_dataSize == size && manifest.GetChunkCount() == lastSaved.GetChunkCount());
+
+                // The wrong size is refused rather than partly loaded
+                std::vector<uint8_t> wrongSize(size + 1);
+                CHECK(!LoadChunks(store, L"roundtrip", wrongSize.data(), size + 1, manifest));
+
+                CHECK(store.DeleteContainer(L"roundtrip"));
+            }
+        }
+    }
+
+    // A one byte change rewrites one chunk and the manifest; saving again with no change writes only the manifest.
+    void TestOnlyChangedChunksAreWritten(IGameSaveBlobStore& store)
+    {
+        auto data = MakeData(c_dataSize, 1);
+        GameSaveManifest lastSaved;
+
+        store.ResetCounters();
+        CHECK(SaveChunks(store, L"delta", data.data(), c_dataSize, c_defaultChunkSize, lastSaved));
+        uint64_t fullBytes = store.GetBytesWritten();
+        CHECK(store.GetBlobsWritten() == lastSaved.GetChunkCount() + 1);
+
+        data[5000] ^= 1;
+        store.ResetCounters();
+        CHECK(SaveChunks(store, L"delta", data.data(), c_dataSize, c_defaultChunkSize, lastSaved));
+        uint64_t deltaBytes = store.GetBytesWritten();
+        CHECK(store.GetBlobsWritten() == 2);
+        CHECK(deltaBytes < fullBytes / 2);
+
+        store.ResetCounters();
+        CHECK(SaveChunks(store, L"delta", data.data(), c_dataSize, c_defaultChunkSize, lastSaved));
+        uint64_t unchangedBytes = store.GetBytesWritten();
+        CHECK(store.GetBlobsWritten() == 1);
+
+        std::vector<uint8_t> loaded(c_dataSize);
+        GameSaveManifest manifest;
+        CHECK(LoadChunks(store, L"delta", loaded.data(), c_dataSize, manifest));
+        CHECK(loaded == data);
+
+        printf("  %u byte save: single blob %u bytes, first save %llu, one byte changed %llu, unchanged %llu\n",
+            c_dataSize,
+            c_dataSize,
+            static_cast<unsigned long long>(fullBytes),
+            static_cast<unsigned long long>(deltaBytes),
+            static_cast<unsigned long long>(unchangedBytes));
+
+        CHECK(store.DeleteContainer(L"delta"));
+    }
+
+    // Saves from before chunking load, and the first chunked save replaces the legacy blob.
+    void TestLegacyData(IGameSaveBlobStore& store)
+    {
+        auto data = MakeData(c_dataSize, 2);
+        BlobMap legacy;
+        legacy[c_legacyDataBlobName] = data;
+        CHECK(store.SubmitUpdates(L"legacy", legacy, std::vector<std::wstring>()));
+
+        std::vector<uint8_t> loaded(c_dataSize);
+        GameSaveManifest manifest;
+        CHECK(LoadChunks(store, L"legacy", loaded.data(), c_dataSize, manifest));
+        CHECK(loaded == data);
+        CHECK(manifest.IsEmpty());
+
+        CHECK(SaveChunks(store, L"legacy", data.data(), c_dataSize, c_defaultChunkSize, manifest));
+        CHECK(!HasBlob(store, L"legacy", c_legacyDataBlobName));
+        CHECK(store.GetBlobNames(L"legacy").size() == manifest.GetChunkCount() + 1);
+
+        std::fill(loaded.begin(), loaded.end(), 0);
+        CHECK(LoadChunks(store, L"legacy", loaded.data(), c_dataSize, manifest));
+        CHECK(loaded == data);
+
+        CHECK(store.DeleteContainer(L"legacy"));
+    }
+
+    // A chunk which doesn't match the manifest fails the load and leaves the destination untouched.
+    void TestCorruptChunk(IGameSaveBlobStore& store)
+    {
+        auto data = MakeData(c_dataSize, 3);
+        GameSaveManifest lastSaved;
+        CHECK(SaveChunks(store, L"corrupt", data.data(), c_dataSize, c_defaultChunkSize, lastSaved));
+
+        BlobMap corrupt;
+        CHECK(store.Get(L"corrupt", std::vector<std::wstring>(1, GetChunkBlobName(1)), corrupt));
+        corrupt[GetChunkBlobName(1)].back() ^= 0x80;
+        CHECK(store.SubmitUpdates(L"corrupt", corrupt, std::vector<std::wstring>()));
+
+        std::vector<uint8_t> loaded(c_dataSize, 0xCD);
+        GameSaveManifest manifest;
+        CHECK(!LoadChunks(store, L"corrupt", loaded.data(), c_dataSize, manifest));
+        CHECK(std::all_of(loaded.begin(), loaded.end(), [](uint8_t b) { return b == 0xCD; }));
+
+        CHECK(store.DeleteContainer(L"corrupt"));
+    }
+
+    // Chunks past the end of smaller data, and the debug padding blob once the save has none, are deleted.
+    void TestStaleBlobsAreDeleted(IGameSaveBlobStore& store)
+    {
+        auto data = MakeData(c_dataSize, 4);
+        GameSaveManifest lastSaved;
+        CHECK(SaveChunks(store, L"stale", data.data(), c_dataSize, c_defaultChunkSize, lastSaved));
+        CHECK(HasBlob(store, L"stale", GetChunkBlobName(2)));
+
+        // As GameSave writes it when a minimum save size is set
+        BlobMap padding;
+        padding[c_paddingBlobName] = BlobData(1000, 0);
+        CHECK(store.SubmitUpdates(L"stale", padding, std::vector<std::wstring>()));
+        lastSaved.m_paddingSize = 1000;
+
+        CHECK(SaveChunks(store, L"stale", data.data(), c_defaultChunkSize, c_defaultChunkSize, lastSaved));
+        CHECK(!HasBlob(store, L"stale", c_paddingBlobName));
+        CHECK(!HasBlob(store, L"stale", GetChunkBlobName(1)));
+        CHECK(!HasBlob(store, L"stale", GetChunkBlobName(2)));
+        CHECK(store.GetBlobNames(L"stale").size() == 2);
+
+        std::vector<uint8_t> loaded(c_defaultChunkSize);
+        GameSaveManifest manifest;
+        CHECK(LoadChunks(store, L"stale", loaded.data(), c_defaultChunkSize, manifest));
+        CHECK(std::equal(loaded.begin(), loaded.end(), data.begin()));
+
+        // The padding is kept while it is still wanted
+        GameSaveManifest previous;
+        previous.SetLayout(c_dataSize, c_defaultChunkSize);
+        previous.m_paddingSize = 1000;
+        GameSaveManifest next = previous;
+        std::vector<std::wstring> staleBlobs;
+        GetStaleBlobNames(previous, next, staleBlobs);
+        CHECK(staleBlobs.empty());
+
+        next.m_paddingSize = 0;
+        GetStaleBlobNames(previous, next, staleBlobs);
+        CHECK(staleBlobs == std::vector<std::wstring>(1, c_paddingBlobName));
+
+        CHECK(store.DeleteContainer(L"stale"));
+    }
+
+    void RunTests(const char* storeName, IGameSaveBlobStore& store)
+    {
+        printf("%s\n", storeName);
+        TestRoundTrip(store);
+        TestOnlyChangedChunksAreWritten(store);
+        TestLegacyData(store);
+        TestCorruptChunk(store);
+        TestStaleBlobsAreDeleted(store);
+    }
+}
+
+int main()
+{
+    {
+        MemoryBlobStore store;
+        RunTests("MemoryBlobStore", store);
+    }
+
+    {
+        ScratchDirectory directory;
+        FileBlobStore store(directory.GetWidePath());
+        RunTests("FileBlobStore", store);
+    }
+
+    {
+        ScratchDirectory directory;
+        JournaledBlobStore store(directory.GetWidePath(), 1024 * 1024);
+        RunTests("JournaledBlobStore", store);
+    }
+
+    return ReportResult("GameSaveChunks");
+}
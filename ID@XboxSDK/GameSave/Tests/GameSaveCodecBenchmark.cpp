@@ -0,0 +1,168 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+//
+// Measures the compression ratio and the encode and decode speed of the LZ blob codec, on GameBoard
+// saves (one board in the tagged format, one in the raw version 1 layout, and a run of boards in
+// the tagged format) and on payloads that are mostly padding: the zeros of the debug padding blob,
+// and records padded out to a fixed size as the tagged format pads a board. Noise, which the codec
+// stores, gives the worst case.
+//
+// Usage: GameSaveCodecBenchmark [megabytes per payload]
+//
+
+#include "pch.h"
+#include "GameBoardFormat.h"
+#include "GameSaveCodec.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+using namespace GameSaveSample;
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    // Keeps the optimizer from dropping the work
+    volatile uint32_t g_sink;
+
+    // A board part way through a game: most tiles have a letter, some of them not yet placed
+    GameBoard MakeBoard(std::mt19937& random)
+    {
+        GameBoard board;
+        board.m_updateCount = random() % 200;
+        for (auto& tile : board.m_board)
+        {
+            if (random() % 5 != 0)
+            {
+                tile.m_letter = static_cast<wchar_t>(L'A' + random() % 26);
+                tile.m_placed = random() % 3 != 0;
+            }
+        }
+        return board;
+    }
+
+    std::vector<uint8_t> TaggedBoards(uint32_t count)
+    {
+        std::mt19937 random(1);
+        std::vector<uint8_t> data(count * SaveDataFormat<GameBoard>::c_payloadSize, 0);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            SaveDataFormat<GameBoard>::Write(MakeBoard(random), data.data() + i * SaveDataFormat<GameBoard>::c_payloadSize);
+        }
+        return data;
+    }
+
+    std::vector<uint8_t> RawBoard()
+    {
+        std::mt19937 random(2);
+        GameBoard board = MakeBoard(random);
+        std::vector<uint8_t> data(sizeof(board));
+        memcpy(data.data(), &board, sizeof(board));
+        return data;
+    }
+
+    // 64 byte records holding 12 bytes each
+    std::vector<uint8_t> PaddedRecords(uint32_t size)
+    {
+        std::mt19937 random(3);
+        std::vector<uint8_t> data(size, 0);
+        for (uint32_t offset = 0; offset + 12 <= size; offset += 64)
+        {
+            for (uint32_t j = 0; j < 12; ++j)
+            {
+                data[offset + j] = static_cast<uint8_t>(random());
+            }
+        }
+        return data;
+    }
+
+    std::vector<uint8_t> Noise(uint32_t size)
+    {
+        std::mt19937 random(4);
+        std::vector<uint8_t> data(size);
+        for (auto& b : data)
+        {
+            b = static_cast<uint8_t>(random());
+        }
+        return data;
+    }
+
+    // Runs func until about 100 MB has gone through it, and returns the rate in MB/s
+    template<typename Func>
+    double MegabytesPerSecond(size_t size, Func func)
+    {
+        uint32_t iterations = static_cast<uint32_t>(std::max<size_t>(1, 100 * 1024 * 1024 / std::max<size_t>(size, 1)));
+        auto start = Clock::now();
+        for (uint32_t j = 0; j < iterations; ++j)
+        {
+            func();
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        return double(size) * iterations / (1024.0 * 1024.0) / seconds;
+    }
+
+    void Run(const char* name, const std::vector<uint8_t>& data)
+    {
+        uint32_t size = static_cast<uint32_t>(data.size());
+        BlobData encoded(GetMaxEncodedSize(size));
+        uint32_t encodedSize = 0;
+
+        double encode = MegabytesPerSecond(size, [&]()
+        {
+            encodedSize = EncodeBlob(data.data(), size, BlobCodec::Lz, encoded.data());
+            g_sink = encoded[encodedSize - 1];
+        });
+
+        std::vector<uint8_t> decoded(size);
+        bool decodedOk = true;
+        double decode = MegabytesPerSecond(size, [&]()
+        {
+            decodedOk = DecodeBlob(encoded.data(), encodedSize, decoded.data(), size) && decodedOk;
+            g_sink = decoded[size - 1];
+        });
+
+        if (!decodedOk || decoded != data)
+        {
+            printf("ERROR: %s didn't decode\n", name);
+            exit(1);
+        }
+
+        BlobCodec codec;
+        uint32_t rawSize;
+        GetEncodedBlobInfo(encoded.data(), encodedSize, codec, rawSize);
+
+        printf("%-20s %10u %10u %8.2f %7s %12.0f %12.0f\n",
+            name,
+            size,
+            encodedSize,
+            double(size) / encodedSize,
+            codec == BlobCodec::Lz ? "lz" : "stored",
+            encode,
+            decode);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t megabytes = (argc > 1) ? static_cast<uint32_t>(strtoul(argv[1], nullptr, 10)) : 1;
+    uint32_t size = std::max(1u, megabytes) * 1024 * 1024;
+
+    printf("%-20s %10s %10s %8s %7s %12s %12s\n", "payload", "bytes", "encoded", "ratio", "codec", "encode MB/s", "decode MB/s");
+
+    Run("board tagged", TaggedBoards(1));
+    Run("board raw v1", RawBoard());
+    Run("boards tagged", TaggedBoards(size / SaveDataFormat<GameBoard>::c_payloadSize));
+    Run("padding zeros", std::vector<uint8_t>(size, 0));
+    Run("padded records", PaddedRecords(size));
+    Run("noise", Noise(size));
+
+    return 0;
+}
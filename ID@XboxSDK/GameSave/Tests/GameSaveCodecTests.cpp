@@ -0,0 +1,269 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+//
+// Tests for the blob codec: blobs decode back byte for byte with each codec, and a blob which has
+// been damaged (a bad hash, a truncated header, a raw size larger than the data it holds, or a
+// corrupt block) is refused rather than loaded. Every damaged blob is decoded into a buffer of
+// exactly the size it claims, so AddressSanitizer catches any read or write past the end.
+//
+// Usage: GameSaveCodecTests
+//
+
+#include "pch.h"
+#include "GameSaveCodec.h"
+#include "TestHelpers.h"
+
+#include <random>
+
+using namespace GameSaveSample;
+
+namespace
+{
+    const uint32_t c_headerSize = 20;       // magic, codec and 3 reserved bytes, raw size, hash
+    const uint32_t c_rawSizeOffset = 8;
+    const uint32_t c_hashOffset = 12;
+
+    // Mostly repetitive, like a game board, with some noise so the codec has work to do
+    std::vector<uint8_t> MakeData(uint32_t size, uint32_t seed)
+    {
+        std::mt19937 random(seed);
+        std::vector<uint8_t> data(size);
+        for (uint32_t j = 0; j < size; ++j)
+        {
+            data[j] = (random() % 4 == 0) ? static_cast<uint8_t>(random()) : static_cast<uint8_t>('A' + j % 26);
+        }
+        return data;
+    }
+
+    void WriteUInt32(BlobData& blob, uint32_t offset, uint32_t value)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            blob[offset + i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
+
+    // Decodes into a buffer of exactly size bytes
+    bool Decode(const BlobData& blob, uint32_t size)
+    {
+        std::vector<uint8_t> decoded(size);
+        return DecodeBlob(blob.data(), blob.size(), decoded.data(), size);
+    }
+
+    void TestRoundTrip()
+    {
+        // Empty, smaller than, equal to and between multiples of the LZ block size, and incompressible
+        const uint32_t sizes[] = { 0, 1, 100, 64 * 1024, 64 * 1024 + 3, 300000 };
+        const BlobCodec codecs[] = { BlobCodec::Stored, BlobCodec::Lz };
+
+        for (auto size : sizes)
+        {
+            for (auto codec : codecs)
+            {
+                auto data = MakeData(size, size);
+                BlobData encoded;
+                EncodeBlob(data.data(), size, codec, encoded);
+                CHECK(encoded.size() <= GetMaxEncodedSize(size));
+
+                BlobCodec infoCodec;
+                uint32_t rawSize;
+                CHECK(GetEncodedBlobInfo(encoded.data(), encoded.size(), infoCodec, rawSize));
+                CHECK(rawSize == size);
+
+                std::vector<uint8_t> decoded(size, 0xCD);
+                CHECK(DecodeBlob(encoded.data(), encoded.size(), decoded.data(), size));
+                CHECK(decoded == data);
+            }
+        }
+
+        // Noise doesn't compress, so it is stored
+        std::mt19937 random(43);
+        std::vector<uint8_t> noise(100000);
+        for (auto& b : noise)
+        {
+            b = static_cast<uint8_t>(random());
+        }
+        BlobData encoded;
+        EncodeBlob(noise.data(), uint32_t(noise.size()), BlobCodec::Lz, encoded);
+        BlobCodec codec;
+        uint32_t rawSize;
+        CHECK(GetEncodedBlobInfo(encoded.data(), encoded.size(), codec, rawSize) && codec == BlobCodec::Stored);
+        CHECK(encoded.size() == c_headerSize + noise.size());
+    }
+
+    // A flipped bit anywhere in the data, or in the stored hash, fails the hash check
+    void TestBadHash()
+    {
+        const BlobCodec codecs[] = { BlobCodec::Stored, BlobCodec::Lz };
+        for (auto codec : codecs)
+        {
+            const uint32_t size = 10000;
+            auto data = MakeData(size, 1);
+            BlobData encoded;
+            EncodeBlob(data.data(), size, codec, encoded);
+            CHECK(Decode(encoded, size));
+
+            for (uint32_t bit = 0; bit < 64; ++bit)
+            {
+                BlobData corrupt = encoded;
+                corrupt[c_hashOffset + bit / 8] ^= static_cast<uint8_t>(1 << (bit % 8));
+                CHECK(!Decode(corrupt, size));
+            }
+
+            // A literal changed in an LZ block still decodes, so only the hash can catch it
+            BlobData corrupt = encoded;
+            corrupt.back() ^= 0x01;
+            CHECK(!Decode(corrupt, size));
+
+            if (codec == BlobCodec::Stored)
+            {
+                for (uint32_t offset = c_headerSize; offset < corrupt.size(); offset += 997)
+                {
+                    BlobData flipped = encoded;
+                    flipped[offset] ^= 0x40;
+                    CHECK(!Decode(flipped, size));
+                }
+            }
+        }
+    }
+
+    // Every length short of a whole header is refused, as are a wrong magic and an unknown codec
+    void TestTruncatedHeader()
+    {
+        const uint32_t size = 5000;
+        auto data = MakeData(size, 2);
+        BlobData encoded;
+        EncodeBlob(data.data(), size, BlobCodec::Lz, encoded);
+
+        BlobCodec codec;
+        uint32_t rawSize;
+        for (uint32_t length = 0; length < c_headerSize; ++length)
+        {
+            BlobData truncated(encoded.begin(), encoded.begin() + length);
+            CHECK(!GetEncodedBlobInfo(truncated.data(), truncated.size(), codec, rawSize));
+            CHECK(!Decode(truncated, size));
+        }
+        CHECK(!GetEncodedBlobInfo(nullptr, 0, codec, rawSize));
+
+        // A whole header with the payload cut short, at every block boundary and in between
+        for (size_t length = c_headerSize; length < encoded.size(); length += 1 + length / 8)
+        {
+            BlobData truncated(encoded.begin(), encoded.begin() + length);
+            CHECK(GetEncodedBlobInfo(truncated.data(), truncated.size(), codec, rawSize) && rawSize == size);
+            CHECK(!Decode(truncated, size));
+        }
+
+        BlobData badMagic = encoded;
+        badMagic[0] ^= 0x01;
+        CHECK(!GetEncodedBlobInfo(badMagic.data(), badMagic.size(), codec, rawSize));
+        CHECK(!Decode(badMagic, size));
+
+        BlobData badCodec = encoded;
+        badCodec[4] = 2;
+        CHECK(!GetEncodedBlobInfo(badCodec.data(), badCodec.size(), codec, rawSize));
+        CHECK(!Decode(badCodec, size));
+    }
+
+    // A header claiming more data than the blob holds is refused, without reading or writing past either buffer
+    void TestOversizedRawSize()
+    {
+        const BlobCodec codecs[] = { BlobCodec::Stored, BlobCodec::Lz };
+        for (auto codec : codecs)
+        {
+            const uint32_t size = 70000; // two LZ blocks
+            auto data = MakeData(size, 3);
+            BlobData encoded;
+            EncodeBlob(data.data(), size, codec, encoded);
+
+            const uint32_t oversized[] = { size + 1, size + 64 * 1024, 4 * 1024 * 1024 };
+            for (auto claimed : oversized)
+            {
+                BlobData corrupt = encoded;
+                WriteUInt32(corrupt, c_rawSizeOffset, claimed);
+
+                BlobCodec infoCodec;
+                uint32_t rawSize;
+                CHECK(GetEncodedBlobInfo(corrupt.data(), corrupt.size(), infoCodec, rawSize) && rawSize == claimed);
+
+                // Into a buffer of the size the header claims, and of the size the data really is
+                CHECK(!Decode(corrupt, claimed));
+                CHECK(!Decode(corrupt, size));
+            }
+
+            // A size the destination could never hold is refused before anything is decoded
+            BlobData corrupt = encoded;
+            WriteUInt32(corrupt, c_rawSizeOffset, 0xFFFFFFFF);
+            std::vector<uint8_t> decoded(size, 0xCD);
+            CHECK(!DecodeBlob(corrupt.data(), corrupt.size(), decoded.data(), size));
+            CHECK(std::all_of(decoded.begin(), decoded.end(), [](uint8_t b) { return b == 0xCD; }));
+
+            // Too small a size is refused too
+            WriteUInt32(corrupt, c_rawSizeOffset, size - 1);
+            CHECK(!Decode(corrupt, size - 1));
+        }
+    }
+
+    // Block headers and match offsets which point outside the data are refused
+    void TestCorruptBlocks()
+    {
+        const uint32_t size = 70000;
+        auto data = MakeData(size, 4);
+        BlobData encoded;
+        EncodeBlob(data.data(), size, BlobCodec::Lz, encoded);
+
+        // A compressed block claiming to be larger than the blob, or to be a stored block of the wrong size
+        BlobData corrupt = encoded;
+        WriteUInt32(corrupt, c_headerSize, 0x7FFFFFFF);
+        CHECK(!Decode(corrupt, size));
+
+        corrupt = encoded;
+        WriteUInt32(corrupt, c_headerSize, 0x80000000 | 100);
+        CHECK(!Decode(corrupt, size));
+
+        // Random damage past the header never strays outside the buffers, and never loads anything but the data saved.
+        // A match offset moved by a multiple of the data's 26 byte period still decodes to the same bytes.
+        std::mt19937 random(5);
+        uint32_t refused = 0;
+        for (uint32_t j = 0; j < 2000; ++j)
+        {
+            corrupt = encoded;
+            uint32_t flips = 1 + random() % 4;
+            for (uint32_t k = 0; k < flips; ++k)
+            {
+                corrupt[c_headerSize + random() % (corrupt.size() - c_headerSize)] ^= static_cast<uint8_t>(1 + random() % 255);
+            }
+
+            std::vector<uint8_t> decoded(size);
+            if (DecodeBlob(corrupt.data(), corrupt.size(), decoded.data(), size))
+            {
+                CHECK(decoded == data);
+            }
+            else
+            {
+                ++refused;
+            }
+        }
+        CHECK(refused > 1900);
+
+        // Trailing bytes after the last block are refused
+        corrupt = encoded;
+        corrupt.push_back(0);
+        CHECK(!Decode(corrupt, size));
+    }
+}
+
+int main()
+{
+    TestRoundTrip();
+    TestBadHash();
+    TestTruncatedHeader();
+    TestOversizedRawSize();
+    TestCorruptBlocks();
+
+    return ReportResult("GameSaveCodec");
+}
@@ -0,0 +1,125 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+//
+// Times encoding and decoding GameBoard and GameBoardIndex in the tagged format, against the copy of
+// the struct's memory they were saved as before it (the default SaveDataFormat).
+//
+// Usage: GameSaveFormatBenchmark [iterations]
+//
+
+#include "pch.h"
+#include "GameBoardFormat.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace GameSaveSample;
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    // Keeps the optimizer from dropping the work
+    volatile uint32_t g_sink;
+
+    uint32_t TouchBoard(GameBoard& board, uint32_t j)
+    {
+        board.m_updateCount += j;
+        return board.m_updateCount + board.m_board[j % 25].m_letter;
+    }
+
+    uint32_t TouchIndex(GameBoardIndex& index, uint32_t j)
+    {
+        index.m_updateCount += j;
+        return index.m_updateCount;
+    }
+
+    template<typename Func>
+    double NanosecondsPerCall(uint32_t iterations, Func func)
+    {
+        auto start = Clock::now();
+        for (uint32_t j = 0; j < iterations; ++j)
+        {
+            func(j);
+        }
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations;
+    }
+
+    // The format before the tagged one: a copy of the struct's memory
+    template<typename TData>
+    struct RawFormat
+    {
+        static const uint32_t c_payloadSize = sizeof(TData);
+
+        static bool Write(const TData& data, uint8_t* payload)
+        {
+            memcpy(payload, &data, sizeof(TData));
+            return true;
+        }
+
+        static bool Read(const uint8_t* payload, uint32_t size, TData& data)
+        {
+            if (size != sizeof(TData))
+            {
+                return false;
+            }
+
+            memcpy(&data, payload, sizeof(TData));
+            return true;
+        }
+    };
+
+    template<typename TData, typename TFormat>
+    void Run(const char* name, uint32_t iterations, TData data, uint32_t (*touch)(TData&, uint32_t))
+    {
+        std::vector<uint8_t> payload(TFormat::c_payloadSize);
+        TData loaded;
+
+        double write = NanosecondsPerCall(iterations, [&](uint32_t j)
+        {
+            g_sink = touch(data, j);
+            TFormat::Write(data, payload.data());
+            g_sink = payload[j % payload.size()];
+        });
+
+        double read = NanosecondsPerCall(iterations, [&](uint32_t j)
+        {
+            // a byte of padding in the tagged format and in the board's raw layout
+            payload[payload.size() - 1] = static_cast<uint8_t>(j);
+            g_sink = TFormat::Read(payload.data(), TFormat::c_payloadSize, loaded) ? touch(loaded, 0) : 0;
+        });
+
+        printf("%-16s %10u %12.1f %12.1f\n", name, TFormat::c_payloadSize, write, read);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t iterations = (argc > 1) ? static_cast<uint32_t>(strtoul(argv[1], nullptr, 10)) : 1000000;
+
+    GameBoard board;
+    for (uint32_t i = 0; i < 25; ++i)
+    {
+        board.m_board[i].m_letter = static_cast<wchar_t>(L'A' + i);
+        board.m_board[i].m_placed = i % 2 == 0;
+    }
+
+    GameBoardIndex index;
+    index.m_activeBoard = 4;
+
+    printf("%u iterations\n", iterations);
+    printf("%-16s %10s %12s %12s\n", "format", "bytes", "write (ns)", "read (ns)");
+
+    Run<GameBoard, SaveDataFormat<GameBoard>>("board tagged", iterations, board, TouchBoard);
+    Run<GameBoard, RawFormat<GameBoard>>("board raw", iterations, board, TouchBoard);
+    Run<GameBoardIndex, SaveDataFormat<GameBoardIndex>>("index tagged", iterations, index, TouchIndex);
+    Run<GameBoardIndex, RawFormat<GameBoardIndex>>("index raw", iterations, index, TouchIndex);
+
+    return 0;
+}
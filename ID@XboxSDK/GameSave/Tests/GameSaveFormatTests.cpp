@@ -0,0 +1,520 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+//
+// Tests for the tagged save format and the GameBoard and GameBoardIndex records written in it. Each
+// file in FormatCorpus is a saved payload, named board_ or index_ for the type it is read as, then
+// valid_ or invalid_ for whether it must load. Every file is checked, then mutated many times with
+// a fixed seed; whatever the bytes, Read must either fail and leave the data alone, or return data
+// which saves and loads back the same.
+//
+// Usage: GameSaveFormatTests [corpus directory]
+//        GameSaveFormatTests --write-corpus <directory>    regenerates the files made from the seeds below
+//
+
+#include "pch.h"
+#include "GameBoardFormat.h"
+#include "TestHelpers.h"
+
+#include <dirent.h>
+#include <random>
+
+using namespace GameSaveSample;
+
+namespace
+{
+    typedef std::vector<uint8_t> Bytes;
+
+    const uint32_t c_mutationsPerFile = 20000;
+
+    const uint32_t c_boardPayloadSize = SaveDataFormat<GameBoard>::c_payloadSize;
+    const uint32_t c_indexPayloadSize = SaveDataFormat<GameBoardIndex>::c_payloadSize;
+
+    // Field ids, as in GameBoardFormat.cpp
+    const uint32_t c_boardTypeField = 1;
+    const uint32_t c_boardUpdateCountField = 2;
+    const uint32_t c_boardWidthField = 3;
+    const uint32_t c_boardHeightField = 4;
+    const uint32_t c_boardTilesField = 5;
+    const uint32_t c_indexUpdateCountField = 1;
+    const uint32_t c_indexActiveBoardField = 2;
+
+    GameBoard MakeBoard(uint32_t seed)
+    {
+        GameBoard board(1 + seed % 3);
+        board.m_updateCount = seed * 7919;
+        for (uint32_t i = 0; i < board.m_boardWidth * board.m_boardHeight; ++i)
+        {
+            board.m_board[i].m_letter = (i + seed) % 4 == 0 ? 0 : static_cast<wchar_t>(L'A' + (i * 3 + seed) % 26);
+            board.m_board[i].m_placed = (i + seed) % 3 == 0;
+        }
+        return board;
+    }
+
+    bool IsSameBoard(const GameBoard& a, const GameBoard& b)
+    {
+        if (a.m_boardType != b.m_boardType || a.m_updateCount != b.m_updateCount ||
+            a.m_boardWidth != b.m_boardWidth || a.m_boardHeight != b.m_boardHeight)
+        {
+            return false;
+        }
+
+        for (uint32_t i = 0; i < a.m_boardWidth * a.m_boardHeight; ++i)
+        {
+            if (a.m_board[i].m_letter != b.m_board[i].m_letter || a.m_board[i].m_placed != b.m_board[i].m_placed)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool IsSameIndex(const GameBoardIndex& a, const GameBoardIndex& b)
+    {
+        return a.m_version == b.m_version && a.m_updateCount == b.m_updateCount && a.m_activeBoard == b.m_activeBoard;
+    }
+
+    Bytes WriteBoard(const GameBoard& board)
+    {
+        Bytes payload(c_boardPayloadSize);
+        CHECK(SaveDataFormat<GameBoard>::Write(board, payload.data()));
+        return payload;
+    }
+
+    Bytes WriteIndex(const GameBoardIndex& index)
+    {
+        Bytes payload(c_indexPayloadSize);
+        CHECK(SaveDataFormat<GameBoardIndex>::Write(index, payload.data()));
+        return payload;
+    }
+
+    void PutUInt32(uint8_t* dest, uint32_t value)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            dest[i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
+
+    // A version 1 save: the raw struct, with a 4-byte tile of letter, placed and padding
+    Bytes WriteBoardV1(const GameBoard& board)
+    {
+        Bytes raw(SaveDataFormat<GameBoard>::c_legacySize, 0);
+        PutUInt32(&raw[0], board.m_boardType);
+        PutUInt32(&raw[4], board.m_updateCount);
+        PutUInt32(&raw[8], board.m_boardWidth);
+        PutUInt32(&raw[12], board.m_boardHeight);
+        for (uint32_t i = 0; i < 25; ++i)
+        {
+            auto letter = static_cast<uint16_t>(board.m_board[i].m_letter);
+            raw[16 + i * 4] = static_cast<uint8_t>(letter);
+            raw[17 + i * 4] = static_cast<uint8_t>(letter >> 8);
+            raw[18 + i * 4] = board.m_board[i].m_placed ? 1 : 0;
+        }
+        return raw;
+    }
+
+    // Tags a record with any version, and any fields, for the cases Write never produces
+    template<typename WriteFields>
+    Bytes WriteRecord(uint32_t payloadSize, uint16_t version, WriteFields writeFields)
+    {
+        Bytes payload(payloadSize, 0);
+        TaggedWriter writer(payload.data(), payloadSize, version);
+        writeFields(writer);
+        CHECK(writer.Finish() > 0);
+        return payload;
+    }
+
+    Bytes PackTiles(const GameBoard& board, uint32_t tileCount)
+    {
+        Bytes tiles;
+        for (uint32_t i = 0; i < tileCount; ++i)
+        {
+            auto letter = static_cast<uint16_t>(board.m_board[i].m_letter);
+            tiles.push_back(static_cast<uint8_t>(letter));
+            tiles.push_back(static_cast<uint8_t>(letter >> 8));
+            tiles.push_back(board.m_board[i].m_placed ? 1 : 0);
+        }
+        return tiles;
+    }
+
+    struct Seed
+    {
+        const char* name;
+        Bytes       payload;
+    };
+
+    std::vector<Seed> MakeSeeds()
+    {
+        GameBoard board = MakeBoard(5);
+        Bytes tiles = PackTiles(board, 25);
+
+        std::vector<Seed> seeds;
+        seeds.push_back({ "board_valid_default", WriteBoard(GameBoard()) });
+        seeds.push_back({ "board_valid_full", WriteBoard(board) });
+        seeds.push_back({ "board_valid_v1", WriteBoardV1(board) });
+        seeds.push_back({ "board_valid_v3_new_fields", WriteRecord(c_boardPayloadSize, 3, [&](TaggedWriter& writer)
+        {
+            writer.WriteFixed32(100, 0xDEADBEEF);
+            writer.WriteVarint(c_boardUpdateCountField, board.m_updateCount);
+            writer.WriteBytes(101, "new", 3);
+            writer.WriteBytes(c_boardTilesField, tiles.data(), static_cast<uint32_t>(tiles.size()));
+            writer.WriteVarint(102, 1ull << 40);
+        }) });
+        seeds.push_back({ "board_valid_tiles_only", WriteRecord(c_boardPayloadSize, 2, [&](TaggedWriter& writer)
+        {
+            writer.WriteBytes(c_boardTilesField, tiles.data(), 10 * 3);
+        }) });
+        seeds.push_back({ "board_invalid_tagged_v1", WriteRecord(c_boardPayloadSize, 1, [&](TaggedWriter& writer)
+        {
+            writer.WriteVarint(c_boardTypeField, 1);
+        }) });
+        seeds.push_back({ "board_invalid_too_large", WriteRecord(c_boardPayloadSize, 2, [&](TaggedWriter& writer)
+        {
+            writer.WriteVarint(c_boardWidthField, 6);
+            writer.WriteVarint(c_boardHeightField, 6);
+        }) });
+        seeds.push_back({ "board_invalid_too_many_tiles", WriteRecord(c_boardPayloadSize, 2, [&](TaggedWriter& writer)
+        {
+            writer.WriteVarint(c_boardWidthField, 2);
+            writer.WriteVarint(c_boardHeightField, 2);
+            writer.WriteBytes(c_boardTilesField, tiles.data(), 5 * 3);
+        }) });
+        seeds.push_back({ "board_invalid_wire_type", WriteRecord(c_boardPayloadSize, 2, [&](TaggedWriter& writer)
+        {
+            writer.WriteFixed32(c_boardWidthField, 5);
+        }) });
+
+        Bytes truncated = WriteBoard(board);
+        truncated.resize(40);
+        seeds.push_back({ "board_invalid_truncated", truncated });
+
+        Bytes badMagic = WriteBoard(board);
+        badMagic[0] ^= 0x20;
+        seeds.push_back({ "board_invalid_magic", badMagic });
+
+        GameBoardIndex index;
+        index.m_updateCount = 42;
+        index.m_activeBoard = 7;
+
+        Bytes indexV1(SaveDataFormat<GameBoardIndex>::c_legacySize, 0);
+        PutUInt32(&indexV1[0], 1);
+        PutUInt32(&indexV1[4], 42);
+        PutUInt32(&indexV1[8], 7);
+
+        seeds.push_back({ "index_valid_default", WriteIndex(GameBoardIndex()) });
+        seeds.push_back({ "index_valid_full", WriteIndex(index) });
+        seeds.push_back({ "index_valid_v1", indexV1 });
+        seeds.push_back({ "index_valid_v3_new_fields", WriteRecord(c_indexPayloadSize, 3, [&](TaggedWriter& writer)
+        {
+            writer.WriteVarint(c_indexActiveBoardField, 3);
+            writer.WriteBytes(50, "board names", 11);
+            writer.WriteVarint(c_indexUpdateCountField, 9);
+        }) });
+        seeds.push_back({ "index_invalid_v0", WriteRecord(c_indexPayloadSize, 0, [&](TaggedWriter& writer)
+        {
+            writer.WriteVarint(c_indexUpdateCountField, 9);
+        }) });
+        seeds.push_back({ "index_invalid_overflow", WriteRecord(c_indexPayloadSize, 2, [&](TaggedWriter& writer)
+        {
+            writer.WriteVarint(c_indexActiveBoardField, 1ull << 33);
+        }) });
+        return seeds;
+    }
+
+    bool ReadFile(const std::string& path, Bytes& bytes)
+    {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (!file)
+        {
+            return false;
+        }
+
+        bytes.clear();
+        uint8_t buffer[4096];
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        {
+            bytes.insert(bytes.end(), buffer, buffer + read);
+        }
+        fclose(file);
+        return true;
+    }
+
+    bool WriteFile(const std::string& path, const Bytes& bytes)
+    {
+        FILE* file = fopen(path.c_str(), "wb");
+        if (!file)
+        {
+            return false;
+        }
+
+        bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+        return fclose(file) == 0 && written;
+    }
+
+    // Reads the bytes as a board and checks the result, returning whether they loaded
+    bool CheckBoard(const Bytes& bytes)
+    {
+        GameBoard sentinel(9, 1, 1);
+        sentinel.m_updateCount = 0xBAD;
+        GameBoard board = sentinel;
+
+        if (!SaveDataFormat<GameBoard>::Read(bytes.data(), static_cast<uint32_t>(bytes.size()), board))
+        {
+            CHECK(IsSameBoard(board, sentinel));
+            return false;
+        }
+
+        CHECK(board.m_boardWidth > 0 && board.m_boardHeight > 0 && board.m_boardWidth * board.m_boardHeight <= 25);
+
+        GameBoard reloaded;
+        Bytes saved = WriteBoard(board);
+        CHECK(SaveDataFormat<GameBoard>::Read(saved.data(), c_boardPayloadSize, reloaded));
+        CHECK(IsSameBoard(board, reloaded));
+        return true;
+    }
+
+    bool CheckIndex(const Bytes& bytes)
+    {
+        GameBoardIndex sentinel;
+        sentinel.m_version = 99;
+        GameBoardIndex index = sentinel;
+
+        if (!SaveDataFormat<GameBoardIndex>::Read(bytes.data(), static_cast<uint32_t>(bytes.size()), index))
+        {
+            CHECK(IsSameIndex(index, sentinel));
+            return false;
+        }
+
+        CHECK(index.m_version >= 1);
+
+        GameBoardIndex reloaded;
+        Bytes saved = WriteIndex(index);
+        CHECK(SaveDataFormat<GameBoardIndex>::Read(saved.data(), c_indexPayloadSize, reloaded));
+        CHECK(reloaded.m_version == c_gameBoardIndexSaveVersion);
+        CHECK(index.m_updateCount == reloaded.m_updateCount && index.m_activeBoard == reloaded.m_activeBoard);
+        return true;
+    }
+
+    // Flips bits, overwrites bytes and header fields, and cuts or pads the bytes; most mutations keep the payload
+    // size, since Read turns any other size away before parsing
+    void Mutate(std::mt19937& random, Bytes& bytes, size_t payloadSize)
+    {
+        static const uint8_t interesting[] = { 0x00, 0x01, 0x7F, 0x80, 0xFF };
+
+        int mutations = 1 + random() % 4;
+        for (int m = 0; m < mutations && !bytes.empty(); ++m)
+        {
+            size_t at = random() % bytes.size();
+            switch (random() % 6)
+            {
+            case 0:
+            case 1:
+                bytes[at] ^= static_cast<uint8_t>(1 << (random() % 8));
+                break;
+            case 2:
+                bytes[at] = interesting[random() % sizeof(interesting)];
+                break;
+            case 3:
+                // the body size in the header
+                if (bytes.size() >= 12)
+                {
+                    PutUInt32(&bytes[8], random() % 2 ? random() % (payloadSize + 16) : random());
+                }
+                break;
+            case 4:
+                // a byte inserted or removed, shifting the fields after it
+                if (random() % 2)
+                {
+                    bytes.insert(bytes.begin() + at, static_cast<uint8_t>(random()));
+                }
+                else
+                {
+                    bytes.erase(bytes.begin() + at);
+                }
+                if (random() % 4 != 0)
+                {
+                    bytes.resize(payloadSize, 0);
+                }
+                break;
+            case 5:
+                bytes.resize(random() % (payloadSize + 8), 0);
+                if (random() % 4 != 0)
+                {
+                    bytes.resize(payloadSize, 0);
+                }
+                break;
+            }
+        }
+    }
+
+    void TestCorpus(const std::string& directory)
+    {
+        DIR* dir = opendir(directory.c_str());
+        if (!dir)
+        {
+            printf("Can't open the corpus directory %s\n", directory.c_str());
+            CHECK(false);
+            return;
+        }
+
+        std::vector<std::string> names;
+        while (dirent* entry = readdir(dir))
+        {
+            std::string name = entry->d_name;
+            if (name.compare(0, 6, "board_") == 0 || name.compare(0, 6, "index_") == 0)
+            {
+                names.push_back(name);
+            }
+        }
+        closedir(dir);
+        std::sort(names.begin(), names.end());
+        CHECK(names.size() >= 10);
+
+        std::mt19937 random(2016);
+        uint32_t loaded = 0;
+        uint32_t mutations = 0;
+        for (auto& name : names)
+        {
+            Bytes seed;
+            CHECK(ReadFile(directory + "/" + name, seed));
+
+            bool isBoard = name.compare(0, 6, "board_") == 0;
+            bool isValid = name.compare(6, 6, "valid_") == 0;
+            size_t payloadSize = isBoard ? c_boardPayloadSize : c_indexPayloadSize;
+
+            bool loadedSeed = isBoard ? CheckBoard(seed) : CheckIndex(seed);
+            if (loadedSeed != isValid)
+            {
+                printf("%s %s\n", name.c_str(), loadedSeed ? "loaded" : "didn't load");
+                CHECK(loadedSeed == isValid);
+            }
+
+            for (uint32_t j = 0; j < c_mutationsPerFile; ++j)
+            {
+                Bytes bytes = seed;
+                Mutate(random, bytes, payloadSize);
+                loaded += (isBoard ? CheckBoard(bytes) : CheckIndex(bytes)) ? 1 : 0;
+                ++mutations;
+            }
+        }
+
+        printf("%zu corpus files, %u mutations, %u loaded\n", names.size(), mutations, loaded);
+    }
+
+    void TestRoundTrip()
+    {
+        for (uint32_t seed = 0; seed < 20; ++seed)
+        {
+            GameBoard board = MakeBoard(seed);
+            Bytes payload = WriteBoard(board);
+
+            GameBoard loaded;
+            CHECK(SaveDataFormat<GameBoard>::Read(payload.data(), c_boardPayloadSize, loaded));
+            CHECK(IsSameBoard(board, loaded));
+        }
+
+        // A board too large for the struct isn't written
+        GameBoard tooLarge;
+        tooLarge.m_boardWidth = 6;
+        Bytes payload(c_boardPayloadSize);
+        CHECK(!SaveDataFormat<GameBoard>::Write(tooLarge, payload.data()));
+
+        GameBoardIndex index;
+        index.m_updateCount = 0xFFFFFFFF;
+        index.m_activeBoard = 8;
+        Bytes indexPayload = WriteIndex(index);
+
+        GameBoardIndex loaded;
+        CHECK(SaveDataFormat<GameBoardIndex>::Read(indexPayload.data(), c_indexPayloadSize, loaded));
+        CHECK(IsSameIndex(index, loaded));
+    }
+
+    void TestMigrationFromV1()
+    {
+        GameBoard board = MakeBoard(11);
+        Bytes raw = WriteBoardV1(board);
+
+        GameBoard loaded;
+        CHECK(SaveDataFormat<GameBoard>::Read(raw.data(), static_cast<uint32_t>(raw.size()), loaded));
+        CHECK(IsSameBoard(board, loaded));
+
+        Bytes indexRaw(SaveDataFormat<GameBoardIndex>::c_legacySize, 0);
+        PutUInt32(&indexRaw[4], 12);
+        PutUInt32(&indexRaw[8], 3);
+
+        GameBoardIndex index;
+        CHECK(SaveDataFormat<GameBoardIndex>::Read(indexRaw.data(), static_cast<uint32_t>(indexRaw.size()), index));
+        CHECK(index.m_version == 1 && index.m_updateCount == 12 && index.m_activeBoard == 3);
+    }
+
+    // Tagged records are read by their schema version: versions before 2 were never tagged, and later ones are
+    // read as version 2 with the fields it doesn't know skipped
+    void TestSchemaVersions()
+    {
+        GameBoard board = MakeBoard(3);
+        Bytes tiles = PackTiles(board, 25);
+
+        for (uint16_t version = 0; version < 6; ++version)
+        {
+            Bytes payload = WriteRecord(c_boardPayloadSize, version, [&](TaggedWriter& writer)
+            {
+                writer.WriteVarint(c_boardTypeField, board.m_boardType);
+                writer.WriteVarint(c_boardUpdateCountField, board.m_updateCount);
+                writer.WriteBytes(200, "future", 6);
+                writer.WriteBytes(c_boardTilesField, tiles.data(), static_cast<uint32_t>(tiles.size()));
+            });
+
+            GameBoard loaded;
+            bool isRead = SaveDataFormat<GameBoard>::Read(payload.data(), c_boardPayloadSize, loaded);
+            CHECK(isRead == (version >= 2));
+            CHECK(!isRead || IsSameBoard(board, loaded));
+
+            Bytes indexPayload = WriteRecord(c_indexPayloadSize, version, [&](TaggedWriter& writer)
+            {
+                writer.WriteFixed32(200, 1);
+                writer.WriteVarint(c_indexActiveBoardField, 4);
+            });
+
+            GameBoardIndex index;
+            isRead = SaveDataFormat<GameBoardIndex>::Read(indexPayload.data(), c_indexPayloadSize, index);
+            CHECK(isRead == (version >= 2));
+            CHECK(!isRead || (index.m_version == version && index.m_activeBoard == 4 && index.m_updateCount == 0));
+        }
+    }
+
+    int WriteCorpus(const std::string& directory)
+    {
+        for (auto& seed : MakeSeeds())
+        {
+            std::string path = directory + "/" + seed.name + ".bin";
+            if (!WriteFile(path, seed.payload))
+            {
+                printf("Failed to write %s\n", path.c_str());
+                return 1;
+            }
+            printf("%s\n", path.c_str());
+        }
+        return 0;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 2 && strcmp(argv[1], "--write-corpus") == 0)
+    {
+        return WriteCorpus(argv[2]);
+    }
+
+    TestRoundTrip();
+    TestMigrationFromV1();
+    TestSchemaVersions();
+    TestCorpus((argc > 1) ? argv[1] : "FormatCorpus");
+
+    return ReportResult("GameSaveFormat");
+}
@@ -0,0 +1,355 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+//
+// Tests for the pieces GameSaveMetadataCache is built from: the query runner, which bounds how many
+// blob info queries are in flight, and the snapshot map the metadata is published in. A mock
+// storage service answers each query on its own thread after a random delay, standing in for the
+// latency of the platform's container queries.
+//
+
+#include "pch.h"
+#include "GameSaveQueryRunner.h"
+#include "GameSaveSnapshotMap.h"
+#include "TestHelpers.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+using namespace GameSaveSample;
+
+namespace
+{
+    // Answers requests on their own threads after a random delay of up to maxLatency
+    class MockService
+    {
+    public:
+        explicit MockService(std::chrono::microseconds maxLatency) :
+            m_maxLatency(maxLatency),
+            m_random(1234),
+            m_inFlight(0),
+            m_maxInFlight(0)
+        {}
+
+        ~MockService()
+        {
+            for (auto& thread : m_threads)
+            {
+                thread.join();
+            }
+        }
+
+        MockService(const MockService&) = delete;
+        MockService& operator=(const MockService&) = delete;
+
+        void Request(std::function<void()> respond)
+        {
+            int inFlight = ++m_inFlight;
+            int maxInFlight = m_maxInFlight;
+            while (inFlight > maxInFlight && !m_maxInFlight.compare_exchange_weak(maxInFlight, inFlight))
+            {
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto latency = std::chrono::microseconds(m_random() % (m_maxLatency.count() + 1));
+            m_threads.emplace_back([this, latency, respond]()
+            {
+                std::this_thread::sleep_for(latency);
+                --m_inFlight;
+                respond();
+            });
+        }
+
+        int GetMaxInFlight() const { return m_maxInFlight; }
+
+    private:
+        std::chrono::microseconds   m_maxLatency;
+        std::mutex                  m_mutex;
+        std::mt19937                m_random;
+        std::vector<std::thread>    m_threads;
+        std::atomic<int>            m_inFlight;
+        std::atomic<int>            m_maxInFlight;
+    };
+
+    // Waits for GameSaveQueryRunner::Run to finish
+    class FinishedEvent
+    {
+    public:
+        FinishedEvent() : m_calls(0), m_failures(0) {}
+
+        GameSaveQueryRunner::FinishedFunction GetFunction()
+        {
+            return [this](uint32_t failures)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                ++m_calls;
+                m_failures = failures;
+                m_finished.notify_all();
+            };
+        }
+
+        bool Wait(uint32_t& failures)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            bool finished = m_finished.wait_for(lock, std::chrono::seconds(10), [this] { return m_calls > 0; });
+            failures = m_failures;
+            return finished;
+        }
+
+        int GetCalls()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_calls;
+        }
+
+    private:
+        std::mutex              m_mutex;
+        std::condition_variable m_finished;
+        int                     m_calls;
+        uint32_t                m_failures;
+    };
+
+    struct ContainerInfo
+    {
+        ContainerInfo(uint32_t version, uint32_t blobCount) : version(version), blobCount(blobCount) {}
+
+        uint32_t    version;
+        uint32_t    blobCount;
+    };
+
+    typedef GameSaveSnapshotMap<ContainerInfo> ContainerMap;
+
+    ContainerMap::Entries MakeEntries(const std::vector<std::wstring>& names, uint32_t version)
+    {
+        ContainerMap::Entries entries;
+        for (auto& name : names)
+        {
+            entries.emplace_back(name, std::make_shared<const ContainerInfo>(version, version * 2));
+        }
+        return entries;
+    }
+
+    // Queries with latency run no more than maxConcurrent at a time; failures and exceptions don't stop the others.
+    void TestRunnerWithLatency()
+    {
+        const size_t queryCount = 40;
+        const size_t maxConcurrent = 4;
+
+        MockService service(std::chrono::microseconds(5000));
+        std::atomic<uint32_t> completed(0);
+
+        std::vector<GameSaveQueryRunner::StartFunction> queries;
+        for (size_t j = 0; j < queryCount; ++j)
+        {
+            queries.push_back([&service, &completed, j](GameSaveQueryRunner::CompletionFunction onComplete)
+            {
+                if (j % 10 == 3)
+                {
+                    throw std::runtime_error("query failed to start");
+                }
+
+                service.Request([&completed, onComplete, j]()
+                {
+                    ++completed;
+                    onComplete(j % 10 != 7);
+                });
+            });
+        }
+
+        FinishedEvent finished;
+        GameSaveQueryRunner::Run(std::move(queries), maxConcurrent, finished.GetFunction());
+
+        uint32_t failures = 0;
+        CHECK(finished.Wait(failures));
+        CHECK(failures == 8);
+        CHECK(completed == queryCount - 4);
+        CHECK(service.GetMaxInFlight() >= 2 && service.GetMaxInFlight() <= int(maxConcurrent));
+        CHECK(finished.GetCalls() == 1);
+    }
+
+    // Queries which complete before returning are run in a loop, not by recursion, so any number can run.
+    void TestRunnerWithSynchronousQueries()
+    {
+        const size_t queryCount = 200000;
+
+        size_t ran = 0;
+        std::vector<GameSaveQueryRunner::StartFunction> queries(queryCount, [&ran](GameSaveQueryRunner::CompletionFunction onComplete)
+        {
+            ++ran;
+            onComplete(true);
+        });
+
+        FinishedEvent finished;
+        GameSaveQueryRunner::Run(std::move(queries), 3, finished.GetFunction());
+
+        uint32_t failures = 1;
+        CHECK(finished.Wait(failures));
+        CHECK(failures == 0);
+        CHECK(ran == queryCount);
+
+        FinishedEvent none;
+        GameSaveQueryRunner::Run(std::vector<GameSaveQueryRunner::StartFunction>(), 4, none.GetFunction());
+        CHECK(none.Wait(failures) && failures == 0);
+    }
+
+    void TestPublishByPrefix()
+    {
+        ContainerMap map;
+        CHECK(map.GetSnapshot()->empty());
+
+        CHECK(map.Publish(L"", MakeEntries({ L"game_board_1", L"game_board_2", L"game_board_index" }, 1), map.GetGeneration()) == 0);
+        CHECK(map.GetSnapshot()->size() == 3);
+
+        // A board which has gone drops out; the entries outside the prefix are kept
+        auto before = map.GetSnapshot();
+        CHECK(map.Publish(L"game_board_1", MakeEntries({}, 2), map.GetGeneration()) == 0);
+        CHECK(map.Find(L"game_board_1") == nullptr);
+        CHECK(map.Find(L"game_board_2")->version == 1);
+
+        // Snapshots already taken don't change
+        CHECK(before->size() == 3);
+    }
+
+    // A query's results don't replace entries published or removed after it started.
+    void TestStaleResultsAreDiscarded()
+    {
+        ContainerMap map;
+        map.Publish(L"", MakeEntries({ L"a", L"b", L"c" }, 1), map.GetGeneration());
+
+        // b is deleted while a slow refresh is running
+        uint64_t slowRefresh = map.GetGeneration();
+        map.Remove(L"b");
+        CHECK(map.Publish(L"", MakeEntries({ L"a", L"b", L"c" }, 2), slowRefresh) == 1);
+        CHECK(map.Find(L"b") == nullptr);
+        CHECK(map.Find(L"a")->version == 2);
+
+        // A refresh which starts later but finishes first is kept
+        uint64_t older = map.GetGeneration();
+        uint64_t newer = map.GetGeneration();
+        CHECK(map.Publish(L"", MakeEntries({ L"a", L"c", L"d" }, 4), newer) == 0);
+        CHECK(map.Publish(L"", MakeEntries({ L"a", L"c" }, 3), older) == 3);
+        CHECK(map.Find(L"a")->version == 4);
+        CHECK(map.Find(L"d") != nullptr);
+
+        // Removing a container no query has found yet still stops a running query adding it
+        uint64_t beforeRemove = map.GetGeneration();
+        map.Remove(L"e");
+        map.Publish(L"e", MakeEntries({ L"e" }, 5), beforeRemove);
+        CHECK(map.Find(L"e") == nullptr);
+
+        // Nothing from before a Clear is published
+        uint64_t beforeClear = map.GetGeneration();
+        map.Clear();
+        CHECK(map.Publish(L"", MakeEntries({ L"a" }, 6), beforeClear) == 1);
+        CHECK(map.GetSnapshot()->empty());
+        CHECK(map.Publish(L"", MakeEntries({ L"a" }, 7), map.GetGeneration()) == 0);
+        CHECK(map.Find(L"a")->version == 7);
+    }
+
+    // Refreshes with blob queries through the mock service, while containers are deleted and the UI reads the
+    // snapshot. A deleted container never reappears, and readers never see an entry half written.
+    void TestRefreshesWithLatency()
+    {
+        const uint32_t containerCount = 12;
+        const int refreshCount = 20;
+
+        ContainerMap map;
+        std::atomic<bool> done(false);
+        std::atomic<bool> consistent(true);
+
+        std::thread reader([&]()
+        {
+            while (!done)
+            {
+                auto snapshot = map.GetSnapshot();
+                for (auto& entry : *snapshot)
+                {
+                    if (entry.second->blobCount != entry.second->version * 2)
+                    {
+                        consistent = false;
+                    }
+                }
+            }
+        });
+
+        std::vector<bool> deleted(containerCount, false);
+        {
+            MockService service(std::chrono::microseconds(3000));
+            for (int refresh = 0; refresh < refreshCount; ++refresh)
+            {
+                // The container query, then a blob query for each container it found
+                uint64_t generation = map.GetGeneration();
+                auto results = std::make_shared<ContainerMap::Entries>();
+                std::vector<std::wstring> names;
+                for (uint32_t c = 0; c < containerCount; ++c)
+                {
+                    if (!deleted[c])
+                    {
+                        names.push_back(L"game_board_" + std::to_wstring(c));
+                    }
+                }
+
+                std::mutex resultsMutex;
+                std::vector<GameSaveQueryRunner::StartFunction> queries;
+                for (auto& name : names)
+                {
+                    queries.push_back([&service, &resultsMutex, results, name, refresh](GameSaveQueryRunner::CompletionFunction onComplete)
+                    {
+                        service.Request([&resultsMutex, results, name, refresh, onComplete]()
+                        {
+                            {
+                                std::lock_guard<std::mutex> lock(resultsMutex);
+                                results->emplace_back(name, std::make_shared<const ContainerInfo>(refresh, refresh * 2));
+                            }
+                            onComplete(true);
+                        });
+                    });
+                }
+
+                FinishedEvent finished;
+                GameSaveQueryRunner::Run(std::move(queries), 4, finished.GetFunction());
+
+                // A board is deleted while the blob queries are in flight
+                uint32_t toDelete = static_cast<uint32_t>(refresh) % containerCount;
+                if (refresh % 3 == 1 && !deleted[toDelete])
+                {
+                    deleted[toDelete] = true;
+                    map.Remove(L"game_board_" + std::to_wstring(toDelete));
+                }
+
+                uint32_t failures = 0;
+                CHECK(finished.Wait(failures) && failures == 0);
+                map.Publish(L"game_board_", *results, generation);
+
+                for (uint32_t c = 0; c < containerCount; ++c)
+                {
+                    CHECK((map.Find(L"game_board_" + std::to_wstring(c)) == nullptr) == deleted[c]);
+                }
+            }
+
+            CHECK(service.GetMaxInFlight() <= 4);
+        }
+
+        done = true;
+        reader.join();
+        CHECK(consistent);
+    }
+}
+
+int main()
+{
+    TestRunnerWithLatency();
+    TestRunnerWithSynchronousQueries();
+    TestPublishByPrefix();
+    TestStaleResultsAreDiscarded();
+    TestRefreshesWithLatency();
+
+    return ReportResult("GameSaveMetadata");
+}
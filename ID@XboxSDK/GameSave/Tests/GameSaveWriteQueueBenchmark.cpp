@@ -0,0 +1,163 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+//
+// 10000 changes to a game board, each followed by a save, as the game board screen makes them. Each
+// save is either written at once, as GameSaveManager did before the write queue, or queued and
+// coalesced. Storage is a LatencyBlobStore, so every submit costs a fixed time. The time the game
+// thread spends in save calls, the submits and the bytes written are compared.
+//
+// Usage: GameSaveWriteQueueBenchmark [changes] [submit latency us] [us between changes] [window ms]
+//
+
+#include "pch.h"
+#include "GameSaveChunks.h"
+#include "GameSaveWriteQueue.h"
+#include "LatencyBlobStore.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+using namespace GameSaveSample;
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    const uint32_t c_boardSize = 512;
+
+    // Stands in for GameSave: SetData replaces the front buffer and marks it dirty, and a snapshot copies it
+    class Board
+    {
+    public:
+        Board() : m_data(c_boardSize, 0), m_isDirty(false) {}
+
+        void SetData(const BlobData& data)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_data = data;
+            m_isDirty = true;
+        }
+
+        void TakeSnapshot(BlobData& snapshot)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            snapshot.assign(m_data.begin(), m_data.end());
+            m_isDirty = false;
+        }
+
+    private:
+        std::mutex  m_mutex;
+        BlobData    m_data;
+        bool        m_isDirty;
+    };
+
+    struct Result
+    {
+        double      gameThreadMs;   // Spent in save calls on the game thread
+        double      totalMs;        // Until the last save reached storage
+        uint64_t    submits;
+        uint64_t    bytesWritten;
+    };
+
+    struct Settings
+    {
+        uint32_t                    changes;
+        std::chrono::microseconds   submitLatency;
+        std::chrono::microseconds   interval;
+        std::chrono::milliseconds   window;
+    };
+
+    // Calls save after each change, and returns the time spent in it
+    template<typename SaveFunc>
+    double MakeChanges(const Settings& settings, Board& board, SaveFunc save)
+    {
+        BlobData data(c_boardSize, 0);
+        Clock::duration inSave(0);
+        for (uint32_t j = 0; j < settings.changes; ++j)
+        {
+            data[(j * 7) % c_boardSize] = static_cast<uint8_t>(j);
+            board.SetData(data);
+
+            auto start = Clock::now();
+            save();
+            inSave += Clock::now() - start;
+
+            std::this_thread::sleep_for(settings.interval);
+        }
+        return std::chrono::duration<double, std::milli>(inSave).count();
+    }
+
+    Result RunDirect(const Settings& settings)
+    {
+        LatencyBlobStore store(std::chrono::microseconds(0), settings.submitLatency);
+        Board board;
+        GameSaveManifest lastSaved;
+        BlobData snapshot;
+
+        auto start = Clock::now();
+        Result result;
+        result.gameThreadMs = MakeChanges(settings, board, [&]()
+        {
+            board.TakeSnapshot(snapshot);
+            SaveChunks(store, L"board", snapshot.data(), c_boardSize, c_defaultChunkSize, lastSaved);
+        });
+        result.totalMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        result.submits = store.GetSubmits();
+        result.bytesWritten = store.GetBytesWritten();
+        return result;
+    }
+
+    Result RunQueued(const Settings& settings)
+    {
+        LatencyBlobStore store(std::chrono::microseconds(0), settings.submitLatency);
+        Board board;
+        GameSaveManifest lastSaved;
+        GameSaveWriteQueue queue(settings.window);
+
+        auto start = Clock::now();
+        Result result;
+        result.gameThreadMs = MakeChanges(settings, board, [&]()
+        {
+            queue.Enqueue(
+                L"board",
+                [&board](BlobData& snapshot) { board.TakeSnapshot(snapshot); },
+                [&](const BlobData& snapshot) { return SaveChunks(store, L"board", snapshot.data(), c_boardSize, c_defaultChunkSize, lastSaved); });
+        });
+        queue.Flush(std::chrono::milliseconds(60000));
+        result.totalMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        result.submits = store.GetSubmits();
+        result.bytesWritten = store.GetBytesWritten();
+        return result;
+    }
+
+    void Print(const char* name, const Result& result)
+    {
+        printf("%-8s %16.1f %12.1f %10llu %14llu\n", name, result.gameThreadMs, result.totalMs,
+            static_cast<unsigned long long>(result.submits), static_cast<unsigned long long>(result.bytesWritten));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Settings settings;
+    settings.changes = (argc > 1) ? static_cast<uint32_t>(strtoul(argv[1], nullptr, 10)) : 10000;
+    settings.submitLatency = std::chrono::microseconds((argc > 2) ? atoi(argv[2]) : 200);
+    settings.interval = std::chrono::microseconds((argc > 3) ? atoi(argv[3]) : 100);
+    settings.window = std::chrono::milliseconds((argc > 4) ? atoi(argv[4]) : 50);
+
+    printf("%u changes, %lld us per submit, %lld us between changes, %lld ms window\n", settings.changes,
+        static_cast<long long>(settings.submitLatency.count()), static_cast<long long>(settings.interval.count()), static_cast<long long>(settings.window.count()));
+    printf("%-8s %16s %12s %10s %14s\n", "saves", "game thread (ms)", "total (ms)", "submits", "bytes written");
+
+    Print("direct", RunDirect(settings));
+    Print("queued", RunQueued(settings));
+
+    return 0;
+}
@@ -0,0 +1,196 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+//
+// Tests for the write-behind save queue: coalescing, flushing, and operations such as deletes,
+// which must not overlap a write of the same container.
+//
+
+#include "pch.h"
+#include "GameSaveWriteQueue.h"
+#include "TestHelpers.h"
+
+#include <chrono>
+#include <thread>
+
+using namespace GameSaveSample;
+
+namespace
+{
+    typedef std::chrono::milliseconds Milliseconds;
+
+    // Records the order writes and operations run in, and checks none of them overlap
+    class Recorder
+    {
+    public:
+        Recorder() : m_running(0), m_overlapped(false) {}
+
+        bool Run(const std::string& name, Milliseconds duration, bool result = true)
+        {
+            if (++m_running > 1)
+            {
+                m_overlapped = true;
+            }
+            std::this_thread::sleep_for(duration);
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_order.push_back(name);
+            }
+            --m_running;
+            return result;
+        }
+
+        std::vector<std::string> GetOrder()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_order;
+        }
+
+        bool Overlapped() const { return m_overlapped; }
+
+    private:
+        std::mutex                  m_mutex;
+        std::vector<std::string>    m_order;
+        std::atomic<int>            m_running;
+        std::atomic<bool>           m_overlapped;
+    };
+
+    // Saves of the same container in the window become one write of the latest data.
+    void TestCoalescing()
+    {
+        GameSaveWriteQueue queue(Milliseconds(50));
+
+        std::atomic<int> value(0);
+        std::atomic<int> writes(0);
+        std::atomic<int> written(-1);
+        std::atomic<int> completions(0);
+
+        for (int j = 0; j < 100; ++j)
+        {
+            value = j;
+            queue.Enqueue(
+                L"board",
+                [&value](BlobData& snapshot) { snapshot.assign(1, static_cast<uint8_t>(value.load())); },
+                [&](const BlobData& snapshot) { ++writes; written = snapshot[0]; return true; },
+                [&completions](bool success) { CHECK(success); ++completions; });
+        }
+
+        CHECK(queue.Flush(Milliseconds(5000)));
+        CHECK(writes == 1);
+        CHECK(written == 99);
+        CHECK(completions == 100);
+
+        auto statistics = queue.GetStatistics();
+        CHECK(statistics.requested == 100);
+        CHECK(statistics.coalesced == 99);
+        CHECK(statistics.written == 1);
+    }
+
+    // An operation waits for the write of its container in progress, drops the one waiting, and is not joined by
+    // the writes queued after it.
+    void TestOperationsAreSerialized()
+    {
+        GameSaveWriteQueue queue(Milliseconds(20));
+        Recorder recorder;
+
+        std::atomic<bool> firstStarted(false);
+        queue.Enqueue(
+            L"board",
+            [](BlobData&) {},
+            [&](const BlobData&) { firstStarted = true; return recorder.Run("save 1", Milliseconds(100)); },
+            nullptr,
+            true);
+
+        while (!firstStarted)
+        {
+            std::this_thread::yield();
+        }
+
+        std::atomic<int> droppedResult(-1);
+        queue.Enqueue(
+            L"board",
+            [](BlobData&) {},
+            [&](const BlobData&) { return recorder.Run("save 2", Milliseconds(0)); },
+            [&droppedResult](bool success) { droppedResult = success ? 1 : 0; });
+
+        std::atomic<int> deleteResult(-1);
+        queue.EnqueueOperation(
+            L"board",
+            [&]() { return recorder.Run("delete", Milliseconds(10)); },
+            [&deleteResult](bool success) { deleteResult = success ? 1 : 0; });
+
+        // The waiting save was requested before the delete, so it is dropped at once
+        CHECK(droppedResult == 0);
+
+        // A save after the delete is written after it, and Remove doesn't drop the delete
+        queue.Enqueue(
+            L"board",
+            [](BlobData&) {},
+            [&](const BlobData&) { return recorder.Run("save 3", Milliseconds(0)); },
+            nullptr,
+            true);
+        queue.Remove(L"other");
+
+        CHECK(queue.Flush(Milliseconds(5000)));
+        CHECK(deleteResult == 1);
+        CHECK(!recorder.Overlapped());
+
+        std::vector<std::string> expected = { "save 1", "delete", "save 3" };
+        CHECK(recorder.GetOrder() == expected);
+
+        auto statistics = queue.GetStatistics();
+        CHECK(statistics.requested == 4);
+        CHECK(statistics.coalesced == 0);
+        CHECK(statistics.written == 3);
+        CHECK(statistics.dropped == 1);
+    }
+
+    void TestFailedOperation()
+    {
+        GameSaveWriteQueue queue(Milliseconds(20));
+        Recorder recorder;
+
+        std::atomic<int> result(-1);
+        queue.EnqueueOperation(L"board", [&]() { return recorder.Run("delete", Milliseconds(0), false); }, [&result](bool success) { result = success ? 1 : 0; });
+
+        CHECK(queue.Flush(Milliseconds(5000)));
+        CHECK(result == 0);
+        CHECK(queue.GetStatistics().failed == 1);
+    }
+
+    // Clear drops the waiting writes but not the one in progress; Flush reports a timeout.
+    void TestClearAndFlushTimeout()
+    {
+        GameSaveWriteQueue queue(Milliseconds(1000));
+        Recorder recorder;
+
+        std::atomic<int> failures(0);
+        for (int j = 0; j < 3; ++j)
+        {
+            std::wstring key = L"board" + std::to_wstring(j);
+            queue.Enqueue(key, [](BlobData&) {}, [&](const BlobData&) { return recorder.Run("save", Milliseconds(0)); }, [&failures](bool success) { if (!success) ++failures; });
+        }
+        queue.Clear();
+        CHECK(failures == 3);
+        CHECK(queue.GetStatistics().dropped == 3);
+
+        queue.Enqueue(L"slow", [](BlobData&) {}, [&](const BlobData&) { return recorder.Run("slow", Milliseconds(200)); }, nullptr, true);
+        CHECK(!queue.Flush(Milliseconds(20)));
+        CHECK(queue.Flush(Milliseconds(5000)));
+        CHECK(recorder.GetOrder().size() == 1);
+    }
+}
+
+int main()
+{
+    TestCoalescing();
+    TestOperationsAreSerialized();
+    TestFailedOperation();
+    TestClearAndFlushTimeout();
+
+    return ReportResult("GameSaveWriteQueue");
+}
@@ -0,0 +1,367 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+//
+// Crash recovery tests for JournaledBlobStore. Updates are stopped at each step in turn, and then at
+// random steps over thousands of random updates, with the store reopened at random as if the process
+// had restarted; a writer process is also killed at random points. After every update each container
+// must hold either all of it or none of it, and the remaining quota must match the blobs in the store.
+//
+// Usage: JournaledBlobStoreTests [random updates] [writer kills]
+//
+
+#include "pch.h"
+#include "GameSaveBlobStore.h"
+#include "TestHelpers.h"
+
+#include <memory>
+#include <numeric>
+#include <random>
+#include <signal.h>
+#include <sys/wait.h>
+
+using namespace GameSaveSample;
+
+namespace
+{
+    typedef std::map<std::wstring, BlobMap> StoreContents;
+
+    const uint32_t c_containerCount = 4;
+    const uint32_t c_blobNameCount = 6;
+    const uint32_t c_stepCount = static_cast<uint32_t>(JournalStep::DeleteContainer) + 1;
+
+    std::wstring GetContainerName(uint32_t container)
+    {
+        return L"container" + std::to_wstring(container);
+    }
+
+    BlobData MakeBlob(std::mt19937& random, uint32_t maxSize)
+    {
+        BlobData blob(random() % maxSize);
+        for (auto& byte : blob)
+        {
+            byte = static_cast<uint8_t>(random());
+        }
+        return blob;
+    }
+
+    // Every blob of every container, read through the store
+    bool ReadContents(JournaledBlobStore& store, StoreContents& contents)
+    {
+        contents.clear();
+        for (uint32_t container = 0; container < c_containerCount; ++container)
+        {
+            auto containerName = GetContainerName(container);
+            auto blobNames = store.GetBlobNames(containerName);
+            if (blobNames.empty())
+            {
+                continue;
+            }
+
+            if (!store.Get(containerName, blobNames, contents[containerName]))
+            {
+                printf("Get failed for %ls\n", containerName.c_str());
+                return false;
+            }
+        }
+        return true;
+    }
+
+    int64_t GetUsedBytes(const StoreContents& contents)
+    {
+        int64_t usedBytes = 0;
+        for (auto& container : contents)
+        {
+            for (auto& blob : container.second)
+            {
+                usedBytes += blob.second.size();
+            }
+        }
+        return usedBytes;
+    }
+
+    // The contents once the update is applied
+    StoreContents ApplyUpdate(StoreContents contents, const std::wstring& containerName, const BlobMap& updates, const std::vector<std::wstring>& deletes)
+    {
+        auto& blobs = contents[containerName];
+        for (auto& blobName : deletes)
+        {
+            blobs.erase(blobName);
+        }
+        for (auto& update : updates)
+        {
+            blobs[update.first] = update.second;
+        }
+
+        if (blobs.empty())
+        {
+            contents.erase(containerName);
+        }
+        return contents;
+    }
+
+    // Stops the update at the faultAt'th step it reaches, or lets it finish if it has fewer steps
+    JournalFaultInjector StopAtStep(int faultAt, std::vector<uint32_t>& faultsByStep)
+    {
+        auto steps = std::make_shared<int>(0);
+        return [steps, faultAt, &faultsByStep](JournalStep step)
+        {
+            if ((*steps)++ != faultAt)
+            {
+                return false;
+            }
+
+            ++faultsByStep[static_cast<uint32_t>(step)];
+            return true;
+        };
+    }
+
+    // Stops an update of two blobs and a delete at each step in turn. The container must be unchanged or updated, both before and after the
+    // store is reopened, and the update must be complete once it has been reopened if it was committed.
+    void TestFaultAtEachStep()
+    {
+        std::vector<uint32_t> faultsByStep(c_stepCount, 0);
+        std::mt19937 random(50);
+
+        for (int faultAt = 0; ; ++faultAt)
+        {
+            ScratchDirectory directory;
+            auto store = std::unique_ptr<JournaledBlobStore>(new JournaledBlobStore(directory.GetWidePath(), 1024 * 1024));
+
+            BlobMap original;
+            original[L"a"] = MakeBlob(random, 4000);
+            original[L"b"] = MakeBlob(random, 4000);
+            original[L"c"] = MakeBlob(random, 4000);
+            CHECK(store->SubmitUpdates(L"container0", original, std::vector<std::wstring>()));
+
+            StoreContents before;
+            CHECK(ReadContents(*store, before));
+
+            BlobMap updates;
+            updates[L"a"] = MakeBlob(random, 4000);
+            updates[L"d"] = MakeBlob(random, 4000);
+            std::vector<std::wstring> deletes(1, L"c");
+            auto after = ApplyUpdate(before, L"container0", updates, deletes);
+
+            auto faultsBefore = std::accumulate(faultsByStep.begin(), faultsByStep.end(), 0u);
+            store->SetFaultInjector(StopAtStep(faultAt, faultsByStep));
+            bool updated = store->SubmitUpdates(L"container0", updates, deletes);
+            store->SetFaultInjector(nullptr);
+            bool faulted = std::accumulate(faultsByStep.begin(), faultsByStep.end(), 0u) != faultsBefore;
+            CHECK(updated != faulted);
+
+            StoreContents contents;
+            CHECK(ReadContents(*store, contents));
+            CHECK(contents == before || contents == after);
+
+            store.reset(new JournaledBlobStore(directory.GetWidePath(), 1024 * 1024));
+            StoreContents reopened;
+            CHECK(ReadContents(*store, reopened));
+            CHECK(reopened == contents);
+            CHECK(store->GetRemainingQuotaInBytes() == 1024 * 1024 - GetUsedBytes(reopened));
+
+            if (!faulted)
+            {
+                CHECK(contents == after);
+                break;
+            }
+        }
+
+        // Every step of an update, and the container delete, must have been stopped
+        {
+            ScratchDirectory directory;
+            JournaledBlobStore store(directory.GetWidePath(), 1024 * 1024);
+            BlobMap blobs;
+            blobs[L"a"] = MakeBlob(random, 100);
+            CHECK(store.SubmitUpdates(L"container0", blobs, std::vector<std::wstring>()));
+
+            store.SetFaultInjector([&faultsByStep](JournalStep step) { ++faultsByStep[static_cast<uint32_t>(step)]; return true; });
+            CHECK(!store.DeleteContainer(L"container0"));
+            store.SetFaultInjector(nullptr);
+            CHECK(store.GetBlobNames(L"container0").size() == 1);
+        }
+
+        for (uint32_t step = 0; step < c_stepCount; ++step)
+        {
+            if (faultsByStep[step] == 0)
+            {
+                printf("No fault at step %u\n", step);
+                CHECK(faultsByStep[step] > 0);
+            }
+        }
+    }
+
+    // Random updates and deletes across several containers, a third of them run to completion and the rest stopped at a random step. The
+    // store is reopened after a quarter of them. The quota is small enough that some updates don't fit.
+    void TestRandomFaults(uint32_t updateCount, int64_t quotaInBytes)
+    {
+        ScratchDirectory directory;
+        auto store = std::unique_ptr<JournaledBlobStore>(new JournaledBlobStore(directory.GetWidePath(), quotaInBytes));
+
+        std::mt19937 random(static_cast<uint32_t>(quotaInBytes));
+        std::vector<uint32_t> faultsByStep(c_stepCount, 0);
+        StoreContents contents;
+        uint32_t committed = 0;
+        uint32_t completed = 0;
+        uint32_t rolledBack = 0;
+        uint32_t overQuota = 0;
+
+        for (uint32_t j = 0; j < updateCount && g_failures == 0; ++j)
+        {
+            auto containerName = GetContainerName(random() % c_containerCount);
+            BlobMap updates;
+            std::vector<std::wstring> deletes;
+            for (uint32_t k = random() % 4; k > 0; --k)
+            {
+                updates[L"blob" + std::to_wstring(random() % c_blobNameCount)] = MakeBlob(random, 6000);
+            }
+            for (uint32_t k = random() % 3; k > 0; --k)
+            {
+                deletes.push_back(L"blob" + std::to_wstring(random() % c_blobNameCount));
+            }
+
+            auto updated = ApplyUpdate(contents, containerName, updates, deletes);
+            int faultAt = (random() % 3 == 0) ? -1 : static_cast<int>(random() % 12);
+            int64_t remainingBefore = store->GetRemainingQuotaInBytes();
+
+            auto faultsBefore = std::accumulate(faultsByStep.begin(), faultsByStep.end(), 0u);
+            store->SetFaultInjector(StopAtStep(faultAt, faultsByStep));
+            bool isUpdated = store->SubmitUpdates(containerName, updates, deletes);
+            store->SetFaultInjector(nullptr);
+            bool faulted = std::accumulate(faultsByStep.begin(), faultsByStep.end(), 0u) != faultsBefore;
+
+            if (!isUpdated && !faulted)
+            {
+                // over the quota, so nothing changed
+                CHECK(GetUsedBytes(updated) > quotaInBytes);
+                CHECK(store->GetRemainingQuotaInBytes() == remainingBefore);
+                ++overQuota;
+            }
+
+            if (random() % 4 == 0)
+            {
+                store.reset(new JournaledBlobStore(directory.GetWidePath(), quotaInBytes));
+            }
+
+            StoreContents actual;
+            CHECK(ReadContents(*store, actual));
+            if (isUpdated)
+            {
+                CHECK(actual == updated);
+                ++committed;
+            }
+            else if (actual == updated)
+            {
+                ++completed;
+            }
+            else if (actual == contents)
+            {
+                rolledBack += faulted ? 1 : 0;
+            }
+            else
+            {
+                printf("Update %u left %ls neither as it was nor updated\n", j, containerName.c_str());
+                CHECK(actual == updated || actual == contents);
+            }
+            contents = actual;
+
+            CHECK(store->GetRemainingQuotaInBytes() == quotaInBytes - GetUsedBytes(contents));
+
+            if (random() % 50 == 0)
+            {
+                // a delete which may stop before, or part way through, removing the container's files
+                auto deletedName = GetContainerName(random() % c_containerCount);
+                store->SetFaultInjector([&random](JournalStep) { return random() % 2 == 0; });
+                bool isDeleted = store->DeleteContainer(deletedName);
+                store->SetFaultInjector(nullptr);
+                if (isDeleted)
+                {
+                    contents.erase(deletedName);
+                }
+
+                StoreContents afterDelete;
+                CHECK(ReadContents(*store, afterDelete));
+                CHECK(afterDelete == contents);
+                CHECK(store->GetRemainingQuotaInBytes() == quotaInBytes - GetUsedBytes(contents));
+            }
+        }
+
+        printf("%u updates, %lld byte quota: %u committed, %u stopped and completed, %u stopped and rolled back, %u over quota\n",
+            updateCount, static_cast<long long>(quotaInBytes), committed, completed, rolledBack, overQuota);
+    }
+
+    // Kills a process writing to the store at random points. Each update writes the same generation to every blob of a container, so a
+    // container which was left part updated has blobs from different generations.
+    void TestKilledWriter(uint32_t killCount)
+    {
+        ScratchDirectory directory;
+        std::mt19937 random(500);
+
+        for (uint32_t round = 0; round < killCount && g_failures == 0; ++round)
+        {
+            fflush(stdout);
+            pid_t writer = fork();
+            if (writer == 0)
+            {
+                JournaledBlobStore store(directory.GetWidePath(), int64_t(1) << 30);
+                std::mt19937 writerRandom(round);
+                for (uint32_t generation = 1; ; ++generation)
+                {
+                    BlobMap updates;
+                    for (uint32_t blob = 0; blob < 4; ++blob)
+                    {
+                        BlobData data(2000 + writerRandom() % 3000, static_cast<uint8_t>(generation));
+                        data[0] = static_cast<uint8_t>(generation >> 8);
+                        updates[L"blob" + std::to_wstring(blob)] = data;
+                    }
+                    store.SubmitUpdates(GetContainerName(writerRandom() % 3), updates, std::vector<std::wstring>());
+                }
+            }
+
+            CHECK(writer > 0);
+            usleep(1000 + random() % 20000);
+            kill(writer, SIGKILL);
+            waitpid(writer, nullptr, 0);
+
+            JournaledBlobStore store(directory.GetWidePath(), int64_t(1) << 30);
+            StoreContents contents;
+            CHECK(ReadContents(store, contents));
+            for (auto& container : contents)
+            {
+                CHECK(container.second.size() == 4);
+
+                int generation = -1;
+                for (auto& blob : container.second)
+                {
+                    int blobGeneration = (blob.second.front() << 8) | blob.second.back();
+                    if (generation >= 0 && blobGeneration != generation)
+                    {
+                        printf("Round %u left %ls part updated\n", round, container.first.c_str());
+                        CHECK(blobGeneration == generation);
+                    }
+                    generation = blobGeneration;
+                }
+            }
+            CHECK(store.GetRemainingQuotaInBytes() == (int64_t(1) << 30) - GetUsedBytes(contents));
+        }
+
+        printf("%u writers killed\n", killCount);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t updateCount = (argc > 1) ? static_cast<uint32_t>(strtoul(argv[1], nullptr, 10)) : 5000;
+    uint32_t killCount = (argc > 2) ? static_cast<uint32_t>(strtoul(argv[2], nullptr, 10)) : 100;
+
+    TestFaultAtEachStep();
+    TestRandomFaults(updateCount, 200 * 1024);
+    TestRandomFaults(updateCount, 30 * 1024);
+    TestKilledWriter(killCount);
+
+    return ReportResult("JournaledBlobStore");
+}
@@ -0,0 +1,56 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+//
+// A MemoryBlobStore which takes a fixed time for each call, standing in for the platform's save
+// storage in benchmarks. Calls on different threads wait at the same time, as requests to the
+// storage service would.
+//
+
+#pragma once
+
+#include "GameSaveBlobStore.h"
+
+#include <chrono>
+#include <thread>
+
+namespace GameSaveSample
+{
+    class LatencyBlobStore : public MemoryBlobStore
+    {
+    public:
+        LatencyBlobStore(std::chrono::microseconds getLatency, std::chrono::microseconds submitLatency) :
+            m_getLatency(getLatency),
+            m_submitLatency(submitLatency),
+            m_gets(0),
+            m_submits(0)
+        {}
+
+        bool Get(const std::wstring& containerName, const std::vector<std::wstring>& blobNames, BlobMap& blobs) override
+        {
+            ++m_gets;
+            std::this_thread::sleep_for(m_getLatency);
+            return MemoryBlobStore::Get(containerName, blobNames, blobs);
+        }
+
+        bool SubmitUpdates(const std::wstring& containerName, const BlobMap& updates, const std::vector<std::wstring>& deletes) override
+        {
+            ++m_submits;
+            std::this_thread::sleep_for(m_submitLatency);
+            return MemoryBlobStore::SubmitUpdates(containerName, updates, deletes);
+        }
+
+        uint64_t GetGets() const { return m_gets; }
+        uint64_t GetSubmits() const { return m_submits; }
+
+    private:
+        std::chrono::microseconds   m_getLatency;
+        std::chrono::microseconds   m_submitLatency;
+        std::atomic<uint64_t>       m_gets;
+        std::atomic<uint64_t>       m_submits;
+    };
+}
@@ -0,0 +1,144 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+//
+// Lines per second logged to a file by 1 to 8 threads, through LogWriter and through the logger it
+// replaced, which opened, appended to, flushed and closed the log file for every line under a global
+// mutex. Both format each line the same way, and the time runs until every line is in the file.
+//
+// Usage: LogWriterBenchmark [lines per thread] [max threads]
+//
+
+#include "pch.h"
+#include "LogWriter.h"
+#include "TestHelpers.h"
+
+#include <chrono>
+#include <cstdarg>
+#include <cwchar>
+#include <thread>
+
+using namespace Log;
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    const size_t c_logBufferSize = 8192;
+
+    // Formats a line as Log does, with the thread id, timestamp and message
+    void FormatLine(LogLine& line, uint32_t thread, uint32_t number)
+    {
+        wchar_t message[c_logBufferSize];
+        swprintf(message, c_logBufferSize, L"Saved board %u (update count %u)\n", thread, number);
+
+        auto now = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now().time_since_epoch()).count();
+        wchar_t timeStr[100];
+        swprintf(timeStr, 100, L"%02u:%02u:%02u.%03u ", unsigned(now / 3600000 % 24), unsigned(now / 60000 % 60), unsigned(now / 1000 % 60), unsigned(now % 1000));
+
+        line.m_text = std::to_wstring(thread);
+        line.m_text += L" \t";
+        line.m_text += timeStr;
+        line.m_messageOffset = line.m_text.length();
+        line.m_text += message;
+    }
+
+    // The logger before LogWriter
+    class OldLogger
+    {
+    public:
+        explicit OldLogger(const std::string& path) : m_path(path) {}
+
+        void Write(uint32_t thread, uint32_t number)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            LogLine line;
+            FormatLine(line, thread, number);
+
+            FILE* file = fopen(m_path.c_str(), "ab");
+            if (file != nullptr)
+            {
+                fwrite(line.m_text.c_str(), sizeof(wchar_t), line.m_text.length(), file);
+                fflush(file);
+                fclose(file);
+            }
+        }
+
+    private:
+        std::string m_path;
+        std::mutex  m_mutex;
+    };
+
+    template<typename WriteFunc>
+    double RunThreads(uint32_t threadCount, uint32_t linesPerThread, WriteFunc write)
+    {
+        auto start = Clock::now();
+
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < threadCount; ++t)
+        {
+            threads.emplace_back([write, t, linesPerThread]()
+            {
+                for (uint32_t j = 0; j < linesPerThread; ++j)
+                {
+                    write(t, j);
+                }
+            });
+        }
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    double RunOld(uint32_t threadCount, uint32_t linesPerThread)
+    {
+        ScratchDirectory directory;
+        OldLogger logger(directory.GetPath() + "/log.txt");
+        return RunThreads(threadCount, linesPerThread, [&logger](uint32_t t, uint32_t j) { logger.Write(t, j); });
+    }
+
+    double RunNew(uint32_t threadCount, uint32_t linesPerThread)
+    {
+        ScratchDirectory directory;
+        std::string path = directory.GetPath() + "/log.txt";
+        LogWriter writer(1024, nullptr, [&path]() { return fopen(path.c_str(), "ab"); });
+
+        auto start = Clock::now();
+        RunThreads(threadCount, linesPerThread, [&writer](uint32_t t, uint32_t j)
+        {
+            LogLine line;
+            FormatLine(line, t, j);
+            writer.Write(line);
+        });
+        writer.Flush();
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t linesPerThread = (argc > 1) ? static_cast<uint32_t>(strtoul(argv[1], nullptr, 10)) : 20000;
+    uint32_t maxThreads = (argc > 2) ? static_cast<uint32_t>(strtoul(argv[2], nullptr, 10)) : 8;
+
+    printf("%u lines per thread, %u hardware threads\n", linesPerThread, std::thread::hardware_concurrency());
+    printf("%-8s %16s %16s %8s\n", "threads", "old (lines/s)", "new (lines/s)", "speedup");
+
+    for (uint32_t threadCount = 1; threadCount <= maxThreads; threadCount *= 2)
+    {
+        double lines = double(threadCount) * linesPerThread;
+        double oldSeconds = RunOld(threadCount, linesPerThread);
+        double newSeconds = RunNew(threadCount, linesPerThread);
+        printf("%-8u %16.0f %16.0f %7.1fx\n", threadCount, lines / oldSeconds, lines / newSeconds, oldSeconds / newSeconds);
+    }
+
+    return 0;
+}
@@ -0,0 +1,246 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+//
+// Stress tests for the parts of Log which run on many threads: the lock-free queue and writer thread
+// the lines go through to the log file, and the display ring. Writers log through a small queue so
+// it is often full, while other threads flush and read the display log.
+//
+
+#include "pch.h"
+#include "LogWriter.h"
+#include "TestHelpers.h"
+
+#include <thread>
+
+using namespace Log;
+
+namespace
+{
+    LogLine MakeLine(uint32_t thread, uint32_t line)
+    {
+        LogLine logLine;
+        logLine.m_text = std::to_wstring(thread) + L" \t";
+        logLine.m_messageOffset = logLine.m_text.length();
+        logLine.m_text += L"line " + std::to_wstring(line) + L"\n";
+        return logLine;
+    }
+
+    // Reads back the lines of a log file written by LogWriter
+    std::vector<std::wstring> ReadLogFile(const std::string& path)
+    {
+        std::vector<std::wstring> lines;
+        FILE* file = fopen(path.c_str(), "rb");
+        if (!file)
+        {
+            return lines;
+        }
+
+        std::wstring line;
+        wchar_t c;
+        while (fread(&c, sizeof(c), 1, file) == 1)
+        {
+            line += c;
+            if (c == L'\n')
+            {
+                lines.push_back(line);
+                line.clear();
+            }
+        }
+        fclose(file);
+        CHECK(line.empty());
+        return lines;
+    }
+
+    // Every line from every thread reaches the debug output and the file, once and in the order each thread wrote
+    // them, with the queue full most of the time.
+    void TestManyWriters(size_t queueCapacity)
+    {
+        const uint32_t threadCount = 8;
+        const uint32_t linesPerThread = 5000;
+
+        ScratchDirectory directory;
+        std::string path = directory.GetPath() + "/log.txt";
+
+        std::atomic<uint32_t> outputLines(0);
+        std::vector<uint32_t> nextLine(threadCount, 0);
+        bool isOrdered = true;
+        {
+            LogWriter writer(
+                queueCapacity,
+                [&](const LogLine& line)
+                {
+                    // only the writer thread calls this
+                    uint32_t thread = std::stoul(line.m_text);
+                    uint32_t number = std::stoul(line.m_text.substr(line.m_messageOffset + 5));
+                    isOrdered = isOrdered && thread < threadCount && number == nextLine[thread];
+                    ++nextLine[thread % threadCount];
+                    ++outputLines;
+                },
+                [&path]() { return fopen(path.c_str(), "wb"); });
+
+            std::vector<std::thread> threads;
+            for (uint32_t t = 0; t < threadCount; ++t)
+            {
+                threads.emplace_back([&writer, &outputLines, t]()
+                {
+                    for (uint32_t j = 0; j < linesPerThread; ++j)
+                    {
+                        LogLine line = MakeLine(t, j);
+                        writer.Write(line);
+
+                        // a flush returns once this thread's lines are all out
+                        if (j % 1000 == 999)
+                        {
+                            writer.Flush();
+                            if (outputLines < (j + 1))
+                            {
+                                CHECK(outputLines >= (j + 1));
+                            }
+                        }
+                    }
+                });
+            }
+
+            for (auto& thread : threads)
+            {
+                thread.join();
+            }
+
+            writer.Flush();
+            CHECK(outputLines == threadCount * linesPerThread);
+        }
+        CHECK(isOrdered);
+
+        // the destructor closed the file, after writing everything
+        auto lines = ReadLogFile(path);
+        CHECK(lines.size() == threadCount * linesPerThread);
+
+        std::vector<uint32_t> fileNextLine(threadCount, 0);
+        for (auto& line : lines)
+        {
+            uint32_t thread = std::stoul(line);
+            if (thread >= threadCount || line != MakeLine(thread, fileNextLine[thread]).m_text)
+            {
+                CHECK(false);
+                break;
+            }
+            ++fileNextLine[thread];
+        }
+    }
+
+    // Lines written just before the writer is destroyed still reach the file, and Flush with nothing queued returns
+    void TestFlushAndShutdown()
+    {
+        ScratchDirectory directory;
+        std::string path = directory.GetPath() + "/log.txt";
+        {
+            LogWriter writer(4, nullptr, [&path]() { return fopen(path.c_str(), "wb"); });
+            writer.Flush();
+
+            for (uint32_t j = 0; j < 100; ++j)
+            {
+                LogLine line = MakeLine(0, j);
+                writer.Write(line);
+            }
+        }
+        CHECK(ReadLogFile(path).size() == 100);
+
+        // Without a file, lines only go to the debug output
+        uint32_t outputLines = 0;
+        {
+            LogWriter writer(4, [&outputLines](const LogLine&) { ++outputLines; }, nullptr);
+            LogLine line = MakeLine(0, 0);
+            writer.Write(line);
+            writer.Flush();
+            CHECK(outputLines == 1);
+        }
+    }
+
+    void TestDisplayRing()
+    {
+        DisplayLogRing<std::wstring> ring(4);
+        CHECK(ring.GetSize() == 0 && ring.GetLine(0).empty());
+
+        for (int j = 0; j < 6; ++j)
+        {
+            ring.Push(std::to_wstring(j));
+        }
+        CHECK(ring.GetSize() == 4);
+        CHECK(ring.GetDropCount() == 2);
+        CHECK(ring.GetLine(0) == L"2" && ring.GetLine(3) == L"5" && ring.GetLine(4).empty());
+
+        ring.Clear();
+        CHECK(ring.GetSize() == 0 && ring.GetLine(0).empty());
+        CHECK(ring.GetDropCount() == 2);
+
+        ring.Push(L"a");
+        CHECK(ring.GetLine(0) == L"a");
+    }
+
+    // Threads push while others read; every line read is one which was pushed, and the drops add up
+    void TestDisplayRingThreads()
+    {
+        const size_t capacity = 64;
+        const uint32_t threadCount = 4;
+        const uint32_t linesPerThread = 20000;
+
+        DisplayLogRing<std::wstring> ring(capacity);
+        std::atomic<bool> done(false);
+        std::atomic<bool> isValid(true);
+
+        std::thread reader([&]()
+        {
+            while (!done)
+            {
+                size_t size = ring.GetSize();
+                for (size_t i = 0; i < size; ++i)
+                {
+                    auto line = ring.GetLine(i);
+                    if (!line.empty() && line.compare(0, 5, L"line ") != 0)
+                    {
+                        isValid = false;
+                    }
+                }
+            }
+        });
+
+        std::vector<std::thread> writers;
+        for (uint32_t t = 0; t < threadCount; ++t)
+        {
+            writers.emplace_back([&ring]()
+            {
+                for (uint32_t j = 0; j < linesPerThread; ++j)
+                {
+                    ring.Push(L"line " + std::to_wstring(j));
+                }
+            });
+        }
+
+        for (auto& writer : writers)
+        {
+            writer.join();
+        }
+        done = true;
+        reader.join();
+
+        CHECK(isValid);
+        CHECK(ring.GetSize() == capacity);
+        CHECK(ring.GetDropCount() == threadCount * linesPerThread - capacity);
+    }
+}
+
+int main()
+{
+    TestManyWriters(8);
+    TestManyWriters(1024);
+    TestFlushAndShutdown();
+    TestDisplayRing();
+    TestDisplayRingThreads();
+
+    return ReportResult("LogWriter");
+}
@@ -0,0 +1,75 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+//
+// Checks and scratch directories shared by the GameSave tests.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace
+{
+    int g_failures = 0;
+
+#define CHECK(condition) \
+    do { if (!(condition)) { ++g_failures; printf("%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #condition); } } while (0)
+
+    // Prints the result and returns the exit code for main
+    inline int ReportResult(const char* name)
+    {
+        if (g_failures != 0)
+        {
+            printf("%d check(s) failed\n", g_failures);
+            return 1;
+        }
+
+        printf("All %s tests passed\n", name);
+        return 0;
+    }
+
+    // A new empty directory for a file store, removed by the destructor
+    class ScratchDirectory
+    {
+    public:
+        ScratchDirectory()
+        {
+            char path[] = "/tmp/GameSaveTests.XXXXXX";
+            if (!mkdtemp(path))
+            {
+                perror("mkdtemp");
+                exit(1);
+            }
+            m_path = path;
+        }
+
+        ~ScratchDirectory()
+        {
+            std::string command = "rm -rf '" + m_path + "'";
+            if (system(command.c_str()) != 0)
+            {
+                printf("Failed to remove %s\n", m_path.c_str());
+            }
+        }
+
+        ScratchDirectory(ScratchDirectory const&) = delete;
+        ScratchDirectory& operator= (ScratchDirectory const&) = delete;
+
+        const std::string& GetPath() const { return m_path; }
+        std::wstring GetWidePath() const { return std::wstring(m_path.begin(), m_path.end()); }
+
+    private:
+        std::string m_path;
+    };
+}
@@ -0,0 +1,192 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+//
+// Loads the word list and looks words up in it, as a WordGraph read from the compiled .dawg and as
+// the std::set<std::wstring> parsed from the .txt which ContentManager used before. Reports the load
+// time, the heap the loaded list holds, and lookups per second, copying each word into a
+// std::wstring for the set as GetWordScore used to.
+//
+// Usage: WordGraphBenchmark [word list path without extension] [probes]
+//
+
+#include "pch.h"
+#include "WordGraph.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <malloc.h>
+#include <random>
+#include <set>
+
+using namespace GameSaveSample;
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    const int c_loadRuns = 20;
+
+    // Bytes allocated from the heap and not yet freed (glibc)
+    int64_t GetHeapBytes()
+    {
+        return static_cast<int64_t>(mallinfo2().uordblks);
+    }
+
+    bool ReadWholeFile(const std::string& path, std::vector<uint8_t>& contents)
+    {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (!file)
+        {
+            return false;
+        }
+
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+
+        contents.resize(size);
+        bool isRead = fread(contents.data(), 1, contents.size(), file) == contents.size();
+        fclose(file);
+        return isRead;
+    }
+
+    // As ContentManager loaded the word list before the graph
+    std::set<std::wstring>* LoadSet(const std::string& path)
+    {
+        auto wordList = new std::set<std::wstring>;
+
+        std::vector<uint8_t> contents;
+        if (!ReadWholeFile(path, contents))
+        {
+            return wordList;
+        }
+        contents.push_back(0);
+
+        wchar_t wword[11] = {}; // longest word supported
+        char* token = nullptr;
+        char* word = strtok_r(reinterpret_cast<char*>(contents.data()), "\r\n", &token);
+        while (word != nullptr)
+        {
+            mbstowcs(wword, word, 10);
+            wordList->insert(wword);
+            word = strtok_r(nullptr, "\r\n", &token);
+        }
+
+        return wordList;
+    }
+
+    WordGraph* LoadGraph(const std::string& path)
+    {
+        auto wordGraph = new WordGraph;
+
+        std::vector<uint8_t> contents;
+        if (ReadWholeFile(path, contents))
+        {
+            wordGraph->Load(std::move(contents));
+        }
+
+        return wordGraph;
+    }
+
+    // Loads the list c_loadRuns times, keeping the fastest, and measures the heap the list holds once loaded
+    template<typename TList>
+    TList* TimeLoad(TList* (*load)(const std::string&), const std::string& path, double& loadMs, int64_t& heapBytes)
+    {
+        TList* list = nullptr;
+        loadMs = 1e9;
+        for (int run = 0; run < c_loadRuns; ++run)
+        {
+            delete list;
+
+            int64_t heapBefore = GetHeapBytes();
+            auto start = Clock::now();
+            list = load(path);
+            loadMs = std::min(loadMs, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+            heapBytes = GetHeapBytes() - heapBefore;
+        }
+        return list;
+    }
+
+    // Random strings of 2 to 5 letters, every 20th probe being the next word of the list instead
+    std::vector<std::wstring> MakeProbes(const std::set<std::wstring>& words, size_t count)
+    {
+        std::mt19937 random(47);
+        std::vector<std::wstring> probes;
+        probes.reserve(count);
+
+        auto it = words.begin();
+        while (probes.size() < count)
+        {
+            if (probes.size() % 20 == 0 && it != words.end())
+            {
+                probes.push_back(*it++);
+                continue;
+            }
+
+            std::wstring probe(2 + random() % 4, L'A');
+            for (auto& letter : probe)
+            {
+                letter = static_cast<wchar_t>(L'A' + random() % 26);
+            }
+            probes.push_back(probe);
+        }
+        return probes;
+    }
+
+    // Takes the word by value, as GetWordScore did
+    __attribute__((noinline)) bool FindInSet(const std::set<std::wstring>& words, std::wstring word)
+    {
+        return words.find(word) != words.end();
+    }
+
+    template<typename Func>
+    double LookupsPerSecond(const std::vector<std::wstring>& probes, size_t& hits, Func contains)
+    {
+        hits = 0;
+        auto start = Clock::now();
+        for (auto& probe : probes)
+        {
+            hits += contains(probe) ? 1 : 0;
+        }
+        return probes.size() / std::chrono::duration<double>(Clock::now() - start).count();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string path = (argc > 1) ? argv[1] : "../Xbox/Assets/TWL06_2to5";
+    size_t probeCount = (argc > 2) ? strtoul(argv[2], nullptr, 10) : 4000000;
+
+    double setLoadMs, graphLoadMs;
+    int64_t setHeap, graphHeap;
+    std::unique_ptr<std::set<std::wstring>> words(TimeLoad(LoadSet, path + ".txt", setLoadMs, setHeap));
+    std::unique_ptr<WordGraph> graph(TimeLoad(LoadGraph, path + ".dawg", graphLoadMs, graphHeap));
+    if (words->empty() || graph->IsEmpty() || words->size() != graph->GetWordCount())
+    {
+        printf("ERROR loading %s.txt and %s.dawg\n", path.c_str(), path.c_str());
+        return 1;
+    }
+
+    auto probes = MakeProbes(*words, probeCount);
+
+    size_t setHits, graphHits;
+    double setLookups = LookupsPerSecond(probes, setHits, [&words](const std::wstring& probe) { return FindInSet(*words, probe); });
+    double graphLookups = LookupsPerSecond(probes, graphHits, [&graph](const std::wstring& probe) { return graph->Contains(probe.c_str(), probe.length()); });
+    if (setHits != graphHits)
+    {
+        printf("ERROR the set found %zu words and the graph %zu\n", setHits, graphHits);
+        return 1;
+    }
+
+    printf("%zu words, %zu probes (%.1f%% words), best of %d loads\n", words->size(), probes.size(), 100.0 * setHits / probes.size(), c_loadRuns);
+    printf("%-22s %10s %12s %16s\n", "word list", "load (ms)", "heap (KB)", "lookups/s");
+    printf("%-22s %10.2f %12.0f %16.0f\n", "std::set (.txt)", setLoadMs, setHeap / 1024.0, setLookups);
+    printf("%-22s %10.2f %12.0f %16.0f\n", "WordGraph (.dawg)", graphLoadMs, graphHeap / 1024.0, graphLookups);
+    return 0;
+}
@@ -0,0 +1,116 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+//
+// Compiles a word list, one upper case word per line, into the WordGraph file ContentManager loads.
+// The graph is loaded back and every word looked up in it before the file is written.
+//
+// Usage: WordGraphBuilder <word list .txt> <output .dawg>
+//
+
+#include "pch.h"
+#include "WordGraph.h"
+
+#include <stdio.h>
+
+using namespace GameSaveSample;
+
+namespace
+{
+    // Reads the lines of a file, as ContentManager splits it: empty lines and line endings are dropped
+    bool ReadWords(const char* path, std::vector<std::string>& words)
+    {
+        FILE* file = fopen(path, "rb");
+        if (!file)
+        {
+            return false;
+        }
+
+        std::string word;
+        int c;
+        while ((c = fgetc(file)) != EOF)
+        {
+            if (c == '\r' || c == '\n')
+            {
+                if (!word.empty())
+                {
+                    words.push_back(word);
+                    word.clear();
+                }
+            }
+            else
+            {
+                word += static_cast<char>(c);
+            }
+        }
+
+        if (!word.empty())
+        {
+            words.push_back(word);
+        }
+
+        fclose(file);
+        return true;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+    {
+        printf("Usage: WordGraphBuilder <word list .txt> <output .dawg>\n");
+        return 1;
+    }
+
+    std::vector<std::string> words;
+    if (!ReadWords(argv[1], words))
+    {
+        printf("ERROR reading %s\n", argv[1]);
+        return 1;
+    }
+
+    auto data = WordGraph::Build(words);
+    if (data.empty())
+    {
+        printf("ERROR compiling %s (a word has a character other than A-Z, or the graph is too big)\n", argv[1]);
+        return 1;
+    }
+
+    WordGraph graph;
+    if (!graph.Load(data))
+    {
+        printf("ERROR the compiled graph is not valid\n");
+        return 1;
+    }
+
+    for (auto& word : words)
+    {
+        std::wstring wideWord(word.begin(), word.end());
+        if (!graph.Contains(wideWord.c_str(), wideWord.length()))
+        {
+            printf("ERROR %s is missing from the compiled graph\n", word.c_str());
+            return 1;
+        }
+    }
+
+    FILE* file = fopen(argv[2], "wb");
+    if (!file)
+    {
+        printf("ERROR creating %s\n", argv[2]);
+        return 1;
+    }
+
+    bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    if (fclose(file) != 0 || !written)
+    {
+        printf("ERROR writing %s\n", argv[2]);
+        return 1;
+    }
+
+    printf("%s: %u words, %zu bytes\n", argv[2], graph.GetWordCount(), data.size());
+    return 0;
+}
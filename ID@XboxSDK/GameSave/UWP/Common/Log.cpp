@@ -7,35 +7,62 @@
 
 #include "pch.h"
 #include "Log.h"
-#include <mutex>
+#include "LogWriter.h"
 
-using namespace Concurrency;
-
-/* extern */
-concurrent_vector<Platform::String^> Log::g_displayLog;
+using namespace Log;
 
 namespace
 {
     const size_t    c_logBufferSize = 8192;
+    const size_t    c_logQueueSize = 1024;              // lines waiting for the writer thread (must be a power of 2)
     const wchar_t*  c_logEntryPrefix = L"WORDGAME: ";
     const wchar_t*  c_logFilename = L"WordGameDebugLog.txt";
     std::wstring    g_logFilePath;
-    std::mutex      g_logMutex;
 
-    // Writes message to debug output, prefixing message with c_logEntryPrefix
-    // If ENABLE_LOGGING_TO_FILE is defined, writes message to c_logFilename, prefixing with timestamp
-    // Returns new string containing message prefixed with timestamp
-    std::wstring WriteToDebugOutputAndLogFile(const wchar_t* message)
+    thread_local wchar_t t_messageBuffer[c_logBufferSize];
+
+    FILE* OpenLogFile()
     {
-        std::lock_guard<std::mutex> lock(g_logMutex);
+        FILE *file = nullptr;
 
-        OutputDebugString(c_logEntryPrefix);
-        OutputDebugString(message);
+#ifdef ENABLE_LOGGING_TO_FILE
+        errno_t err = _wfopen_s(
+            &file,
+            g_logFilePath.c_str(),
+            L"at+, ccs=UTF-8"
+        );
 
+        if (err != 0)
+        {
+            std::wstring err_msg(L"ERROR: Unable to open log file (code ");
+            err_msg += std::to_wstring(err);
+            err_msg += L")\n";
+            OutputDebugString(err_msg.c_str());
+            file = nullptr;
+        }
+#endif
+
+        return file;
+    }
+
+    // The writer is never destroyed, so lines written while the app exits are never queued on a writer which has gone
+    // away
+    std::atomic<LogWriter*> g_logWriter;
+
+    // The last c_displayLogCapacity lines for the in-game log display
+    DisplayLogRing<Platform::String^> g_displayLog(Log::c_displayLogCapacity);
+
+    // Formats message into line for the log file, prefixing it with the thread id and timestamp
+    // Returns the offset of the timestamp in the line
+    size_t FormatLogLine(const wchar_t* message, LogLine& line)
+    {
         // note the log time
         SYSTEMTIME localTime;
         GetLocalTime(&localTime);
 
+        auto threadStr = std::to_wstring(GetCurrentThreadId());
+        threadStr += L" \t";
+
         wchar_t timeStr[100];
         swprintf_s(timeStr, 100, L"%02u:%02u:%02u.%03u ",
             localTime.wHour,
@@ -43,46 +70,37 @@ namespace
             localTime.wSecond,
             localTime.wMilliseconds); // format: "hh:mm:ss.ms"
 
-#ifdef ENABLE_LOGGING_TO_FILE
-        FILE *file = nullptr;
+        line.m_text = threadStr;
+        line.m_text += timeStr;
+        line.m_messageOffset = line.m_text.length();
+        line.m_text += message;
 
-        errno_t err = _wfopen_s(
-            &file,
-            g_logFilePath.c_str(),
-            L"at+, ccs=UTF-8"
-        );
+        return threadStr.length();
+    }
 
-        if (err != 0)
+    // Queues message for the debug output and, if ENABLE_LOGGING_TO_FILE is defined, c_logFilename
+    // If display is true, also adds message to the display log, prefixed with its timestamp
+    void WriteLine(const wchar_t* message, bool display)
+    {
+        LogLine line;
+        size_t timeOffset = FormatLogLine(message, line);
+
+        if (display)
         {
-            std::wstring err_msg(L"ERROR: Unable to open log file (code ");
-            err_msg += std::to_wstring(err);
-            err_msg += L")\n";
-            OutputDebugString(err_msg.c_str());
+            g_displayLog.Push(ref new Platform::String(line.m_text.c_str() + timeOffset));
+        }
+
+        auto writer = g_logWriter.load();
+        if (writer != nullptr)
+        {
+            writer->Write(line);
         }
         else
         {
-            auto fileStr = std::to_wstring(GetCurrentThreadId());
-            fileStr += L" \t";
-            fileStr += timeStr;
-            fileStr += message;
-
-            fwrite(
-                (void*)fileStr.c_str(),
-                sizeof(wchar_t),
-                fileStr.length(),
-                file
-            );
-
-            fflush(file);
-            fclose(file);
+            // not initialized yet, so there is no log file
+            OutputDebugString(c_logEntryPrefix);
+            OutputDebugString(message);
         }
-#endif
-
-        // assemble return line
-        std::wstring returnLine(timeStr);
-        returnLine += message;
-
-        return returnLine;
     }
 
 } // end unnamed namespace
@@ -90,6 +108,11 @@ namespace
 
 void Log::Initialize()
 {
+    if (g_logWriter.load() != nullptr)
+    {
+        return;
+    }
+
 #ifdef ENABLE_LOGGING_TO_FILE
 
     // set log path
@@ -114,38 +137,67 @@ void Log::Initialize()
 #endif
 
 #endif
+
+    g_logWriter.store(new LogWriter(
+        c_logQueueSize,
+        [](const LogLine& line)
+        {
+            OutputDebugString(c_logEntryPrefix);
+            OutputDebugString(line.m_text.c_str() + line.m_messageOffset);
+        },
+        OpenLogFile));
+}
+
+void Log::Flush()
+{
+    auto writer = g_logWriter.load();
+    if (writer != nullptr)
+    {
+        writer->Flush();
+    }
 }
 
 void Log::ClearDisplayLog()
 {
-    g_displayLog.clear();
+    g_displayLog.Clear();
 }
 
 void Log::PushToDisplayLog(const std::wstring& message)
 {
-    g_displayLog.push_back(ref new Platform::String(message.c_str()));
+    g_displayLog.Push(ref new Platform::String(message.c_str()));
 }
 
-void Log::Write(Platform::String^ format, ...)
+size_t Log::GetDisplayLogSize()
+{
+    return g_displayLog.GetSize();
+}
+
+Platform::String^ Log::GetDisplayLogLine(size_t index)
+{
+    return g_displayLog.GetLine(index);
+}
+
+uint64_t Log::GetDisplayLogDropCount()
 {
-    static wchar_t msgbuffer[c_logBufferSize];
+    return g_displayLog.GetDropCount();
+}
 
+void Log::Write(Platform::String^ format, ...)
+{
     va_list args;
     va_start(args, format);
-    vswprintf(msgbuffer, c_logBufferSize, format->Data(), args);
+    vswprintf(t_messageBuffer, c_logBufferSize, format->Data(), args);
     va_end(args);
 
-    WriteToDebugOutputAndLogFile(msgbuffer);
+    WriteLine(t_messageBuffer, false);
 }
 
 void Log::WriteAndDisplay(Platform::String^ format, ...)
 {
-    static wchar_t msgbuffer[c_logBufferSize];
-
     va_list args;
     va_start(args, format);
-    vswprintf(msgbuffer, c_logBufferSize, format->Data(), args);
+    vswprintf(t_messageBuffer, c_logBufferSize, format->Data(), args);
     va_end(args);
 
-    PushToDisplayLog(WriteToDebugOutputAndLogFile(msgbuffer));
+    WriteLine(t_messageBuffer, true);
 }
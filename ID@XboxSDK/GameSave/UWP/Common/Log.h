@@ -7,7 +7,8 @@
 
 #pragma once
 
-#include <concurrent_vector.h>
+#include <stdint.h>
+#include <string>
 
 #ifdef _DEBUG
 #define ENABLE_LOGGING_TO_FILE
@@ -16,22 +17,36 @@
 #define LOG_CREATE_NEW_ON_LAUNCH    1
 
 // Logging for file and screen
+//
+// Write formats the message on the calling thread and queues it; a writer thread started by Initialize sends the
+// queued lines to the debug output and appends them to the log file, which it keeps open. Call Flush before the app
+// is suspended, or when it is about to crash, so that the log file has every line written so far.
 namespace Log
 {
+    const size_t c_displayLogCapacity = 512; // once the display log is full, the oldest line is dropped for each new one
+
     void Initialize();
 
-    // WARNING: Clear is not a thread-safe operation
+    // Blocks until every line written before the call is in the debug output and the log file
+    void Flush();
+
     void ClearDisplayLog();
 
     // Adds message to the display log without any timestamp formatting
     void PushToDisplayLog(const std::wstring& message);
 
+    // Number of lines in the display log
+    size_t GetDisplayLogSize();
+
+    // Returns a line from the display log, 0 being the oldest, or nullptr if there is no such line
+    Platform::String^ GetDisplayLogLine(size_t index);
+
+    // Number of lines dropped from the display log because it was full
+    uint64_t GetDisplayLogDropCount();
+
     // Writes to the debug log file (if enabled)
     void Write(Platform::String^ format, ...);
 
     // Writes to the debug log file AND sends formatted output to the in-game log display
     void WriteAndDisplay(Platform::String^ format, ...);
-
-    // Thread-safe log
-    extern Concurrency::concurrent_vector<Platform::String^> g_displayLog;
 };
@@ -0,0 +1,209 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#include "pch.h"
+#include "LogWriter.h"
+#include <chrono>
+
+using namespace Log;
+
+namespace
+{
+    const size_t    c_logWriteBatchSize = 32 * 1024;    // characters the writer thread collects before writing them to the file
+    const auto      c_logWriterIdleWait = std::chrono::milliseconds(100);
+
+    void WriteToFile(FILE* file, std::wstring& batch)
+    {
+        if (file != nullptr && !batch.empty())
+        {
+            fwrite(
+                (void*)batch.c_str(),
+                sizeof(wchar_t),
+                batch.length(),
+                file
+            );
+        }
+
+        batch.clear();
+    }
+}
+
+LogQueue::LogQueue(size_t capacity) :
+    m_slots(new Slot[capacity]),
+    m_mask(capacity - 1),
+    m_pushPosition(0),
+    m_popPosition(0)
+{
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        m_slots[i].m_sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+bool LogQueue::TryPush(LogLine& line)
+{
+    size_t position = m_pushPosition.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        Slot& slot = m_slots[position & m_mask];
+        size_t sequence = slot.m_sequence.load(std::memory_order_acquire);
+        auto difference = static_cast<ptrdiff_t>(sequence - position);
+        if (difference == 0)
+        {
+            if (m_pushPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                slot.m_line = std::move(line);
+                slot.m_sequence.store(position + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (difference < 0)
+        {
+            return false;
+        }
+        else
+        {
+            position = m_pushPosition.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool LogQueue::TryPop(LogLine& line)
+{
+    Slot& slot = m_slots[m_popPosition & m_mask];
+    if (slot.m_sequence.load(std::memory_order_acquire) != m_popPosition + 1)
+    {
+        return false;
+    }
+
+    line = std::move(slot.m_line);
+    slot.m_sequence.store(m_popPosition + m_mask + 1, std::memory_order_release);
+    ++m_popPosition;
+    return true;
+}
+
+LogWriter::LogWriter(size_t queueCapacity, OutputFunction debugOutput, OpenFunction openFile) :
+    m_queue(queueCapacity),
+    m_debugOutput(std::move(debugOutput)),
+    m_openFile(std::move(openFile)),
+    m_isIdle(false),
+    m_flushedCount(0),
+    m_isStopping(false)
+{
+    m_thread = std::thread(&LogWriter::Run, this);
+}
+
+LogWriter::~LogWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isStopping = true;
+        m_wake.notify_one();
+    }
+    m_thread.join();
+}
+
+void LogWriter::Write(LogLine& line)
+{
+    while (!m_queue.TryPush(line))
+    {
+        WakeWriter();
+        std::this_thread::yield();
+    }
+
+    // pairs with the writer thread setting m_isIdle before it checks for lines, so one of them sees the other
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_isIdle.load())
+    {
+        WakeWriter();
+    }
+}
+
+void LogWriter::Flush()
+{
+    size_t pushCount = m_queue.GetPushCount();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_wake.notify_one();
+    m_flushed.wait(lock, [this, pushCount] { return m_flushedCount >= pushCount; });
+}
+
+void LogWriter::WakeWriter()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_wake.notify_one();
+}
+
+void LogWriter::Run()
+{
+    FILE* file = m_openFile ? m_openFile() : nullptr;
+    std::wstring batch;
+    batch.reserve(c_logWriteBatchSize * 2);
+
+    LogLine line;
+    for (;;)
+    {
+        bool wroteLines = false;
+        while (m_queue.TryPop(line))
+        {
+            if (m_debugOutput)
+            {
+                m_debugOutput(line);
+            }
+
+            batch += line.m_text;
+            if (batch.length() >= c_logWriteBatchSize)
+            {
+                WriteToFile(file, batch);
+            }
+            wroteLines = true;
+        }
+
+        if (wroteLines)
+        {
+            WriteToFile(file, batch);
+            if (file != nullptr)
+            {
+                fflush(file);
+            }
+        }
+
+        size_t popCount = m_queue.GetPopCount();
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_flushedCount != popCount)
+        {
+            m_flushedCount = popCount;
+            m_flushed.notify_all();
+        }
+
+        m_isIdle.store(true);
+        bool hasLines = m_queue.GetPushCount() != popCount;
+        if (!hasLines)
+        {
+            if (m_isStopping)
+            {
+                break;
+            }
+
+            m_wake.wait_for(lock, c_logWriterIdleWait);
+        }
+        m_isIdle.store(false);
+        lock.unlock();
+
+        if (hasLines && !wroteLines)
+        {
+            // a line is still being pushed
+            std::this_thread::yield();
+        }
+    }
+
+    if (file != nullptr)
+    {
+        fclose(file);
+    }
+}
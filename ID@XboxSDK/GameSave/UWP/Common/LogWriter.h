@@ -0,0 +1,175 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The platform-neutral parts of Log: the queue lines are written to, the writer thread which drains it, and the ring of
+// lines for the in-game log display. Log.cpp wires them to the debug output, the log file and Platform::String.
+namespace Log
+{
+    struct LogLine
+    {
+        std::wstring    m_text;             // thread id, timestamp and message, as written to the log file
+        size_t          m_messageOffset;    // where the message starts, for the debug output
+    };
+
+    // Bounded lock-free queue of lines from any number of threads to the writer thread. Each slot has a sequence
+    // number saying whose turn it is: a thread claims a slot by advancing m_pushPosition, and hands it to the writer
+    // thread by advancing the slot's sequence, which the writer thread advances again once it has taken the line.
+    class LogQueue
+    {
+    public:
+        // capacity must be a power of 2
+        explicit LogQueue(size_t capacity);
+
+        LogQueue(const LogQueue&) = delete;
+        LogQueue& operator=(const LogQueue&) = delete;
+
+        // Moves line into the queue; returns false, leaving line unchanged, if the queue is full
+        bool TryPush(LogLine& line);
+
+        // Writer thread only. Returns false if there are no lines, or the next line is still being pushed.
+        bool TryPop(LogLine& line);
+
+        // Lines pushed so far, including any still being pushed
+        size_t GetPushCount() const { return m_pushPosition.load(); }
+
+        // Writer thread only
+        size_t GetPopCount() const { return m_popPosition; }
+
+    private:
+        struct Slot
+        {
+            std::atomic<size_t> m_sequence;
+            LogLine             m_line;
+        };
+
+        std::unique_ptr<Slot[]> m_slots;
+        size_t                  m_mask;
+        std::atomic<size_t>     m_pushPosition;
+        size_t                  m_popPosition;
+    };
+
+    // Owns the writer thread, which sends queued lines to the debug output and appends them to the log file in batches,
+    // keeping the file open.
+    class LogWriter
+    {
+    public:
+        typedef std::function<void(const LogLine& line)> OutputFunction;
+
+        // Called on the writer thread when it starts; returns the log file, or nullptr to write to the debug output only
+        typedef std::function<FILE*()> OpenFunction;
+
+        LogWriter(size_t queueCapacity, OutputFunction debugOutput, OpenFunction openFile);
+
+        // Writes the lines still queued, then stops the writer thread and closes the log file
+        ~LogWriter();
+
+        LogWriter(const LogWriter&) = delete;
+        LogWriter& operator=(const LogWriter&) = delete;
+
+        // Queues a line, waiting for the writer thread if the queue is full
+        void Write(LogLine& line);
+
+        // Blocks until every line written before the call is in the debug output and the log file
+        void Flush();
+
+    private:
+        void WakeWriter();
+        void Run();
+
+        LogQueue                    m_queue;
+        OutputFunction              m_debugOutput;
+        OpenFunction                m_openFile;
+        std::atomic<bool>           m_isIdle;       // Set while the writer thread checks for lines and waits for them
+        std::mutex                  m_mutex;
+        std::condition_variable     m_wake;         // Wakes the writer thread for new lines, a flush or to stop
+        std::condition_variable     m_flushed;
+        size_t                      m_flushedCount; // Lines in the debug output and the log file; guarded by m_mutex
+        bool                        m_isStopping;   // Guarded by m_mutex
+        std::thread                 m_thread;
+    };
+
+    // The last capacity lines, in a ring; once it is full, the oldest line is dropped for each new one
+    template<typename TLine>
+    class DisplayLogRing
+    {
+    public:
+        explicit DisplayLogRing(size_t capacity) :
+            m_lines(capacity),
+            m_first(0),
+            m_size(0),
+            m_dropCount(0)
+        {
+        }
+
+        void Push(TLine line)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_size == m_lines.size())
+            {
+                m_lines[m_first] = line;
+                m_first = (m_first + 1) % m_lines.size();
+                ++m_dropCount;
+            }
+            else
+            {
+                m_lines[(m_first + m_size) % m_lines.size()] = line;
+                ++m_size;
+            }
+        }
+
+        void Clear()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (auto& line : m_lines)
+            {
+                line = TLine();
+            }
+            m_first = 0;
+            m_size = 0;
+        }
+
+        size_t GetSize()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_size;
+        }
+
+        // Returns a line, 0 being the oldest, or an empty line if there is no such line
+        TLine GetLine(size_t index)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return (index < m_size) ? m_lines[(m_first + index) % m_lines.size()] : TLine();
+        }
+
+        // Lines dropped because the ring was full; it keeps counting across Clear
+        uint64_t GetDropCount()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_dropCount;
+        }
+
+    private:
+        std::mutex          m_mutex;
+        std::vector<TLine>  m_lines;
+        size_t              m_first;
+        size_t              m_size;
+        uint64_t            m_dropCount;
+    };
+}
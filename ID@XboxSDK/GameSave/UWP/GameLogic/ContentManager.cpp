@@ -10,6 +10,7 @@
 
 #include <algorithm>
 #include <cctype>
+#include <chrono>
 #include <fstream>
 
 #include <codecvt>
@@ -17,6 +18,55 @@
 using namespace Concurrency;
 using namespace DirectX;
 
+namespace
+{
+    // Reads a file into contents with a single read
+    bool ReadWholeFile(const std::wstring& path, std::vector<uint8_t>& contents, bool logIfNotFound)
+    {
+        HANDLE hFile = CreateFile2(path.c_str(), GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, nullptr);
+        if (hFile == INVALID_HANDLE_VALUE)
+        {
+            auto error = GetLastError();
+            if (logIfNotFound || error != ERROR_FILE_NOT_FOUND)
+            {
+                Log::Write("ERROR opening %ws (%ws)\n", path.c_str(), FormatHResult(HRESULT_FROM_WIN32(error))->Data());
+            }
+            return false;
+        }
+
+        bool success = false;
+        FILE_STANDARD_INFO fileInfo;
+        DWORD bytesRead = 0;
+        if (GetFileInformationByHandleEx(hFile, FileStandardInfo, &fileInfo, sizeof(fileInfo)) == FALSE)
+        {
+            Log::Write("ERROR getting file size of %ws (%ws)\n", path.c_str(), FormatHResult(HRESULT_FROM_WIN32(GetLastError()))->Data());
+        }
+        else if (fileInfo.EndOfFile.HighPart > 0)
+        {
+            Log::Write("ERROR file size of %ws too big\n", path.c_str());
+        }
+        else
+        {
+            contents.resize(fileInfo.EndOfFile.LowPart);
+            if (ReadFile(hFile, contents.data(), fileInfo.EndOfFile.LowPart, &bytesRead, nullptr) == FALSE)
+            {
+                Log::Write("ERROR reading %ws (%ws)\n", path.c_str(), FormatHResult(HRESULT_FROM_WIN32(GetLastError()))->Data());
+            }
+            else if (bytesRead < fileInfo.EndOfFile.LowPart)
+            {
+                Log::Write("ERROR incomplete read of %ws (%d of %d bytes read)\n", path.c_str(), bytesRead, fileInfo.EndOfFile.LowPart);
+            }
+            else
+            {
+                success = true;
+            }
+        }
+
+        CloseHandle(hFile);
+        return success;
+    }
+}
+
 namespace GameSaveSample {
 
 ContentManager::ContentManager(const std::shared_ptr<DX::DeviceResources>& deviceResources)
@@ -51,7 +101,7 @@ std::shared_ptr<Texture2D> ContentManager::LoadTexture(std::wstring path)
 task<WordList> ContentManager::LoadWordList(std::wstring path)
 {
     // Look in our cache first
-    if (m_wordList != nullptr && !m_wordList->empty())
+    if (m_wordList != nullptr && !m_wordList->IsEmpty())
     {
         return create_task([this] { return m_wordList; });
     }
@@ -59,69 +109,52 @@ task<WordList> ContentManager::LoadWordList(std::wstring path)
     return create_task([this, path]
     {
         // Otherwise load the word list into our cache
-        m_wordList.reset(new std::set<std::wstring>);
+        auto start = std::chrono::high_resolution_clock::now();
+
         std::wstring lowercasePath = path;
         std::transform(path.begin(), path.end(), lowercasePath.begin(), [](wchar_t wc) { return static_cast<wchar_t>(std::tolower(wc)); });
+        std::wstring graphPath = lowercasePath.substr(0, lowercasePath.rfind(L'.')) + L".dawg";
 
-        HANDLE hWordFile = CreateFile2(lowercasePath.c_str(), GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, nullptr);
+        auto wordGraph = std::make_shared<WordGraph>();
+        std::vector<uint8_t> contents;
+        if (ReadWholeFile(graphPath, contents, false))
         {
-            if (hWordFile == INVALID_HANDLE_VALUE)
-            {
-                Log::Write("ERROR opening word list file (%ws)\n", FormatHResult(E_INVALIDARG)->Data());
-                return m_wordList;
-            }
-
-            FILE_STANDARD_INFO fileInfo;
-            if (GetFileInformationByHandleEx(hWordFile, FileStandardInfo, &fileInfo, sizeof(fileInfo)) == FALSE)
-            {
-                Log::Write("ERROR getting file size of word list file (%ws)\n", FormatHResult(HRESULT_FROM_WIN32(GetLastError()))->Data());
-                goto ExitFn;
-            }
-
-            LARGE_INTEGER fileSize = fileInfo.EndOfFile;
-            if (fileSize.HighPart > 0)
+            if (!wordGraph->Load(std::move(contents)))
             {
-                Log::Write("ERROR file size of word list too big\n");
-                goto ExitFn;
-            }
-
-            std::unique_ptr<char[]> buffer;
-            buffer.reset(new char[fileSize.LowPart + 1]);
-
-            DWORD bytesRead;
-            if (ReadFile(hWordFile, buffer.get(), fileSize.LowPart, &bytesRead, nullptr) == FALSE)
-            {
-                Log::Write("ERROR reading word list file (%ws)\n", FormatHResult(HRESULT_FROM_WIN32(GetLastError()))->Data());
-                goto ExitFn;
+                Log::Write("ERROR compiled word list is not valid\n");
             }
+        }
 
-            if (bytesRead < fileSize.LowPart)
-            {
-                Log::Write("ERROR incomplete read of word list file (%d of %d bytes read)\n", bytesRead, fileSize.LowPart);
-                goto ExitFn;
-            }
+        if (wordGraph->IsEmpty())
+        {
+            Log::Write("Compiling word list\n");
 
-            auto readBuffer = buffer.get();
-            readBuffer[bytesRead] = 0;
-            char* word = 0;
-            char* token = 0;
-            size_t converted = 0;
-            wchar_t wword[11] = {}; // longest word supported
-            word = strtok_s(readBuffer, "\r\n", &token);
-            while (word != nullptr)
+            contents.clear();
+            if (ReadWholeFile(lowercasePath, contents, true))
             {
-                mbstowcs_s(&converted, wword, word, 10);
-                m_wordList->insert(wword);
-                word = strtok_s(nullptr, "\r\n", &token);
+                contents.push_back(0);
+
+                std::vector<std::string> words;
+                char* token = 0;
+                char* word = strtok_s(reinterpret_cast<char*>(contents.data()), "\r\n", &token);
+                while (word != nullptr)
+                {
+                    words.push_back(word);
+                    word = strtok_s(nullptr, "\r\n", &token);
+                }
+
+                if (!wordGraph->Load(WordGraph::Build(std::move(words))))
+                {
+                    Log::Write("ERROR compiling word list\n");
+                }
             }
         }
 
-    ExitFn:
-        if (hWordFile != INVALID_HANDLE_VALUE)
-        {
-            CloseHandle(hWordFile);
-        }
+        auto stop = std::chrono::high_resolution_clock::now();
+        auto durationMS = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
+        Log::Write("Word list load duration: " + durationMS.ToString() + "ms (%u words, %u bytes)\n", wordGraph->GetWordCount(), static_cast<uint32>(wordGraph->GetSizeInBytes()));
 
+        m_wordList = wordGraph;
         return m_wordList;
     });
 }
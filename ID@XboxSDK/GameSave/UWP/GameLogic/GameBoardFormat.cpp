@@ -0,0 +1,288 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#include "pch.h"
+#include "GameBoardFormat.h"
+
+using namespace GameSaveSample;
+
+namespace
+{
+    // GameBoard field ids
+    const uint32_t  c_boardTypeField = 1;
+    const uint32_t  c_boardUpdateCountField = 2;
+    const uint32_t  c_boardWidthField = 3;
+    const uint32_t  c_boardHeightField = 4;
+    const uint32_t  c_boardTilesField = 5;       // Packed tiles: 16-bit letter, then flags (bit 0: placed)
+
+    // GameBoardIndex field ids
+    const uint32_t  c_indexUpdateCountField = 1;
+    const uint32_t  c_indexActiveBoardField = 2;
+
+    const uint32_t  c_packedTileSize = 3;
+    const uint8_t   c_tilePlacedFlag = 0x01;
+
+    const uint32_t  c_v1TilesOffset = 16;
+    const uint32_t  c_v1TileSize = 4;           // wchar_t letter, bool placed, 1 byte of padding
+
+    const uint32_t  c_maxTiles = sizeof(GameBoard::m_board) / sizeof(GameBoard::m_board[0]);
+
+    uint32_t ReadUInt32(const uint8_t* src)
+    {
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            value |= uint32_t(src[i]) << (8 * i);
+        }
+        return value;
+    }
+
+    bool IsValidBoardSize(uint32_t width, uint32_t height)
+    {
+        return width > 0 && height > 0 && uint64_t(width) * height <= c_maxTiles;
+    }
+
+    // Reads a field that must be a varint no larger than 32 bits
+    bool GetUInt32(const TaggedField& field, uint32_t& value)
+    {
+        if (field.m_type != WireType::Varint || field.m_value > 0xFFFFFFFF)
+        {
+            return false;
+        }
+
+        value = static_cast<uint32_t>(field.m_value);
+        return true;
+    }
+
+    // Reads the fields of a version 2 record. Later versions only add fields, which are skipped, so they are read
+    // with it too.
+    bool ReadGameBoardV2(TaggedReader& reader, GameBoard& data)
+    {
+        // fields missing from the record keep these defaults
+        GameBoard board;
+        const TaggedField* tilesField = nullptr;
+        TaggedField tiles = {};
+
+        TaggedField field;
+        while (reader.Next(field))
+        {
+            bool isValid = true;
+            switch (field.m_id)
+            {
+            case c_boardTypeField:          isValid = GetUInt32(field, board.m_boardType); break;
+            case c_boardUpdateCountField:   isValid = GetUInt32(field, board.m_updateCount); break;
+            case c_boardWidthField:         isValid = GetUInt32(field, board.m_boardWidth); break;
+            case c_boardHeightField:        isValid = GetUInt32(field, board.m_boardHeight); break;
+            case c_boardTilesField:
+                isValid = field.m_type == WireType::Bytes && field.m_size % c_packedTileSize == 0;
+                tiles = field;
+                tilesField = &tiles;
+                break;
+            default:
+                // a field added by a later version
+                break;
+            }
+
+            if (!isValid)
+            {
+                return false;
+            }
+        }
+
+        if (!reader.IsValid() || !IsValidBoardSize(board.m_boardWidth, board.m_boardHeight))
+        {
+            return false;
+        }
+
+        // the tiles are read straight from the payload once the board size is known
+        if (tilesField != nullptr)
+        {
+            uint32_t tileCount = tilesField->m_size / c_packedTileSize;
+            if (tileCount > board.m_boardWidth * board.m_boardHeight)
+            {
+                return false;
+            }
+
+            for (uint32_t i = 0; i < tileCount; ++i)
+            {
+                auto tile = tilesField->m_data + i * c_packedTileSize;
+                board.m_board[i].m_letter = static_cast<wchar_t>(tile[0] | (tile[1] << 8));
+                board.m_board[i].m_placed = (tile[2] & c_tilePlacedFlag) != 0;
+            }
+        }
+
+        data = board;
+        return true;
+    }
+
+    bool ReadGameBoardIndexV2(TaggedReader& reader, GameBoardIndex& data)
+    {
+        GameBoardIndex index;
+        index.m_version = reader.GetSchemaVersion();
+
+        TaggedField field;
+        while (reader.Next(field))
+        {
+            bool isValid = true;
+            switch (field.m_id)
+            {
+            case c_indexUpdateCountField:   isValid = GetUInt32(field, index.m_updateCount); break;
+            case c_indexActiveBoardField:   isValid = GetUInt32(field, index.m_activeBoard); break;
+            default:                        break;
+            }
+
+            if (!isValid)
+            {
+                return false;
+            }
+        }
+
+        if (!reader.IsValid())
+        {
+            return false;
+        }
+
+        data = index;
+        return true;
+    }
+}
+
+namespace GameSaveSample
+{
+    bool MigrateGameBoardFromV1(const uint8_t* raw, uint32_t size, GameBoard& data)
+    {
+        if (size != SaveDataFormat<GameBoard>::c_legacySize)
+        {
+            return false;
+        }
+
+        uint32_t boardWidth = ReadUInt32(raw + 8);
+        uint32_t boardHeight = ReadUInt32(raw + 12);
+        if (!IsValidBoardSize(boardWidth, boardHeight))
+        {
+            return false;
+        }
+
+        GameBoard board(ReadUInt32(raw), boardWidth, boardHeight);
+        board.m_updateCount = ReadUInt32(raw + 4);
+
+        for (uint32_t i = 0; i < c_maxTiles; ++i)
+        {
+            auto tile = raw + c_v1TilesOffset + i * c_v1TileSize;
+            board.m_board[i].m_letter = static_cast<wchar_t>(tile[0] | (tile[1] << 8));
+            board.m_board[i].m_placed = tile[2] != 0;
+        }
+
+        data = board;
+        return true;
+    }
+
+    bool MigrateGameBoardIndexFromV1(const uint8_t* raw, uint32_t size, GameBoardIndex& data)
+    {
+        if (size != SaveDataFormat<GameBoardIndex>::c_legacySize)
+        {
+            return false;
+        }
+
+        GameBoardIndex index;
+        index.m_version = 1;
+        index.m_updateCount = ReadUInt32(raw + 4);
+        index.m_activeBoard = ReadUInt32(raw + 8);
+
+        data = index;
+        return true;
+    }
+
+    bool SaveDataFormat<GameBoard>::Write(const GameBoard& data, uint8_t* payload)
+    {
+        if (!IsValidBoardSize(data.m_boardWidth, data.m_boardHeight))
+        {
+            return false;
+        }
+
+        uint32_t tileCount = data.m_boardWidth * data.m_boardHeight;
+        uint8_t tiles[c_maxTiles * c_packedTileSize];
+        for (uint32_t i = 0; i < tileCount; ++i)
+        {
+            auto letter = static_cast<uint16_t>(data.m_board[i].m_letter);
+            tiles[i * c_packedTileSize] = static_cast<uint8_t>(letter);
+            tiles[i * c_packedTileSize + 1] = static_cast<uint8_t>(letter >> 8);
+            tiles[i * c_packedTileSize + 2] = data.m_board[i].m_placed ? c_tilePlacedFlag : 0;
+        }
+
+        memset(payload, 0, c_payloadSize);
+
+        TaggedWriter writer(payload, c_payloadSize, c_gameBoardSaveVersion);
+        writer.WriteVarint(c_boardTypeField, data.m_boardType);
+        writer.WriteVarint(c_boardUpdateCountField, data.m_updateCount);
+        writer.WriteVarint(c_boardWidthField, data.m_boardWidth);
+        writer.WriteVarint(c_boardHeightField, data.m_boardHeight);
+        writer.WriteBytes(c_boardTilesField, tiles, tileCount * c_packedTileSize);
+        return writer.Finish() > 0;
+    }
+
+    bool SaveDataFormat<GameBoard>::Read(const uint8_t* payload, uint32_t size, GameBoard& data)
+    {
+        if (size == c_legacySize)
+        {
+            return MigrateGameBoardFromV1(payload, size, data);
+        }
+
+        TaggedReader reader(payload, size);
+        if (size != c_payloadSize || !reader.IsValid())
+        {
+            return false;
+        }
+
+        switch (reader.GetSchemaVersion())
+        {
+        case 0:
+        case 1:
+            // version 1 saves are the raw layout, read above; they were never tagged records
+            return false;
+
+        case 2:
+        default:
+            return ReadGameBoardV2(reader, data);
+        }
+    }
+
+    bool SaveDataFormat<GameBoardIndex>::Write(const GameBoardIndex& data, uint8_t* payload)
+    {
+        memset(payload, 0, c_payloadSize);
+
+        TaggedWriter writer(payload, c_payloadSize, c_gameBoardIndexSaveVersion);
+        writer.WriteVarint(c_indexUpdateCountField, data.m_updateCount);
+        writer.WriteVarint(c_indexActiveBoardField, data.m_activeBoard);
+        return writer.Finish() > 0;
+    }
+
+    bool SaveDataFormat<GameBoardIndex>::Read(const uint8_t* payload, uint32_t size, GameBoardIndex& data)
+    {
+        if (size == c_legacySize)
+        {
+            return MigrateGameBoardIndexFromV1(payload, size, data);
+        }
+
+        TaggedReader reader(payload, size);
+        if (size != c_payloadSize || !reader.IsValid())
+        {
+            return false;
+        }
+
+        switch (reader.GetSchemaVersion())
+        {
+        case 0:
+        case 1:
+            return false;
+
+        case 2:
+        default:
+            return ReadGameBoardIndexV2(reader, data);
+        }
+    }
+}
@@ -0,0 +1,43 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#pragma once
+
+#include "GameBoard.h"
+#include "GameSaveFormat.h"
+
+// GameBoard and GameBoardIndex are saved as tagged records (see GameSaveFormat.h), padded with zeros to a fixed
+// payload size; the padding costs next to nothing once the chunks are compressed. Version 1 saves were a copy of the
+// struct's memory, which is still read, and migrated, through the functions below.
+namespace GameSaveSample
+{
+    // Copies a version 1 (raw struct) save into a GameBoard. The layout is spelled out rather than taken from the
+    // struct, so it keeps working when the struct changes.
+    bool MigrateGameBoardFromV1(const uint8_t* raw, uint32_t size, GameBoard& data);
+
+    bool MigrateGameBoardIndexFromV1(const uint8_t* raw, uint32_t size, GameBoardIndex& data);
+
+    template <>
+    struct SaveDataFormat<GameBoard>
+    {
+        static const uint32_t c_payloadSize = 512;
+        static const uint32_t c_legacySize = 116; // sizeof(GameBoard) in version 1, as saved on Windows
+
+        static bool Write(const GameBoard& data, uint8_t* payload);
+        static bool Read(const uint8_t* payload, uint32_t size, GameBoard& data);
+    };
+
+    template <>
+    struct SaveDataFormat<GameBoardIndex>
+    {
+        static const uint32_t c_payloadSize = 128;
+        static const uint32_t c_legacySize = 12;
+
+        static bool Write(const GameBoardIndex& data, uint8_t* payload);
+        static bool Read(const uint8_t* payload, uint32_t size, GameBoardIndex& data);
+    };
+}
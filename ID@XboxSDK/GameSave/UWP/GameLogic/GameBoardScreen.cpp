@@ -105,37 +105,6 @@ namespace
         3, // Y
         2 // Z
     };
-
-    // Letter values
-    const int c_letterValues[] =
-    {
-        1, // A
-        3, // B
-        3, // C
-        2, // D
-        1, // E
-        4, // F
-        2, // G
-        4, // H
-        1, // I
-        8, // J
-        5, // K
-        1, // L
-        3, // M
-        1, // N
-        1, // O
-        3, // P
-        10, // Q
-        1, // R
-        1, // S
-        1, // T
-        1, // U
-        4, // V
-        4, // W
-        8, // X
-        4, // Y
-        10 // Z
-    };
 #pragma endregion
 }
 
@@ -148,6 +117,7 @@ GameBoardScreen::GameBoardScreen(const std::shared_ptr<ScreenManager>& screenMan
     m_lettersRemaining(c_letterCounts, c_letterCounts + sizeof(c_letterCounts) / sizeof(c_letterCounts[0])),
     m_logFontHeight(0),
     m_logLineBegin(0),
+    m_logDropCount(Log::GetDisplayLogDropCount()),
     m_logScrollDownDelay(0),
     m_logScrollUpDelay(0),
     m_score(0),
@@ -155,13 +125,6 @@ GameBoardScreen::GameBoardScreen(const std::shared_ptr<ScreenManager>& screenMan
     m_tileScrollUpDelay(0),
     m_wordListLoaded(false)
 {
-    // Setup word tracker
-    auto boardTiles = c_boardWidth * c_boardHeight;
-    for (uint32_t i = 1; i <= boardTiles; ++i)
-    {
-        m_wordTracker.push_back(WordTrackerTile());
-    }
-
     // Setup menu display parameters
     m_animateSelected = false;
     m_menuActive = false;
@@ -179,9 +142,9 @@ GameBoardScreen::GameBoardScreen(const std::shared_ptr<ScreenManager>& screenMan
         m_logLineBegin = 0;
 
         // load or reload game state using GetAsync()
-        auto activeBoardMetadata = Game->GameSaveManager->ActiveBoardGameSave->m_containerMetadata;
-        auto activeBoardContainerName = activeBoardMetadata->m_containerName;
-        auto activeBoardNeedsSync = activeBoardMetadata->m_needsSync;
+        auto activeBoardContainerName = Game->GameSaveManager->ActiveBoardGameSave->m_containerMetadata->m_containerName;
+        auto activeBoardMetadata = Game->GameSaveManager->GetContainerMetadata(activeBoardContainerName);
+        auto activeBoardNeedsSync = activeBoardMetadata != nullptr && activeBoardMetadata->m_needsSync;
         Game->GameSaveManager->Get().then([=](bool)
         {
             if (activeBoardNeedsSync)
@@ -198,9 +161,9 @@ GameBoardScreen::GameBoardScreen(const std::shared_ptr<ScreenManager>& screenMan
         m_logLineBegin = 0;
 
         // load or reload game state using ReadAsync()
-        auto activeBoardMetadata = Game->GameSaveManager->ActiveBoardGameSave->m_containerMetadata;
-        auto activeBoardContainerName = activeBoardMetadata->m_containerName;
-        auto activeBoardNeedsSync = activeBoardMetadata->m_needsSync;
+        auto activeBoardContainerName = Game->GameSaveManager->ActiveBoardGameSave->m_containerMetadata->m_containerName;
+        auto activeBoardMetadata = Game->GameSaveManager->GetContainerMetadata(activeBoardContainerName);
+        auto activeBoardNeedsSync = activeBoardMetadata != nullptr && activeBoardMetadata->m_needsSync;
         Game->GameSaveManager->Read().then([=](bool)
         {
             if (activeBoardNeedsSync)
@@ -399,6 +362,16 @@ void GameBoardScreen::Update(float totalTime, float elapsedTime, bool otherScree
 {
     MenuScreen::Update(totalTime, elapsedTime, otherScreenHasFocus, coveredByOtherScreen);
     
+    // the display log drops its oldest lines once it is full, so move a scrolled log back by as many lines to keep
+    // showing the same ones
+    auto logDropCount = Log::GetDisplayLogDropCount();
+    if (m_logLineBegin > 0)
+    {
+        auto dropped = logDropCount - m_logDropCount;
+        m_logLineBegin = (dropped < m_logLineBegin) ? static_cast<size_t>(m_logLineBegin - dropped) : size_t(1);
+    }
+    m_logDropCount = logDropCount;
+
     if (m_logScrollDownDelay > 0)
     {
         m_logScrollDownDelay -= elapsedTime;
@@ -595,7 +568,7 @@ void GameBoardScreen::HandleInput(const DirectX::InputState & input)
         else if (input.IsLogScrollUp())
         {
             size_t maxDisplayLines = static_cast<size_t>(c_debugLog_Region.Height / m_logFontHeight);
-            auto logIndexSize = Log::g_displayLog.size();
+            auto logIndexSize = Log::GetDisplayLogSize();
             if (m_logLineBegin == 0)
             {
                 if (logIndexSize > maxDisplayLines)
@@ -619,7 +592,7 @@ void GameBoardScreen::HandleInput(const DirectX::InputState & input)
             if (m_logLineBegin > 0)
             {
                 size_t maxDisplayLines = static_cast<size_t>(c_debugLog_Region.Height / m_logFontHeight);
-                auto logIndexSize = Log::g_displayLog.size();
+                auto logIndexSize = Log::GetDisplayLogSize();
 
                 if ((m_logLineBegin + 1) > (logIndexSize - maxDisplayLines))
                 {
@@ -638,7 +611,7 @@ void GameBoardScreen::HandleInput(const DirectX::InputState & input)
         else if (input.IsNewKeyPress(Keyboard::Keys::Home))
         {
             size_t maxDisplayLines = static_cast<size_t>(c_debugLog_Region.Height / m_logFontHeight);
-            auto logIndexSize = Log::g_displayLog.size();
+            auto logIndexSize = Log::GetDisplayLogSize();
             if (logIndexSize > maxDisplayLines)
             {
                 m_logLineBegin = 1;
@@ -752,7 +725,7 @@ void GameBoardScreen::Draw(float totalTime, float elapsedTime)
     auto activeBoardNum = gameSaveManager->ActiveBoardNumber;
     auto activeBoard = gameSaveManager->ActiveBoard;
     auto activeBoardGameSave = gameSaveManager->ActiveBoardGameSave;
-    auto activeBoardMetadata = activeBoardGameSave->m_containerMetadata;
+    auto activeBoardMetadata = gameSaveManager->GetContainerMetadata(activeBoardGameSave->m_containerMetadata->m_containerName);
 
     spriteBatch->Begin(SpriteSortMode_Deferred, blendStates->NonPremultiplied(), nullptr, nullptr, nullptr, nullptr, scaleMatrix);
 
@@ -795,7 +768,7 @@ void GameBoardScreen::Draw(float totalTime, float elapsedTime)
 
     // Draw active board metadata (last save date, current user gamertag)
     Platform::String^ gameBoardMetadataDisplay;
-    if (activeBoardMetadata->m_isGameDataOnDisk)
+    if (activeBoardMetadata != nullptr && activeBoardMetadata->m_isGameDataOnDisk)
     {
         gameBoardMetadataDisplay += activeBoardGameSave->m_isGameDataLoaded ? "BOARD LOADED" : "BOARD NOT LOADED";
 
@@ -852,7 +825,7 @@ void GameBoardScreen::Draw(float totalTime, float elapsedTime)
         {
             auto letterIndex = letter - L'A';
             auto lettersRemaining = m_lettersRemaining[letterIndex];
-            auto letterValue = c_letterValues[letterIndex];
+            auto letterValue = GameBoardScorer::GetLetterValue(letter);
             Platform::String^ countStr = letter + "=" + letterValue.ToString() + "(" + lettersRemaining.ToString() + ")";
             auto countColor = c_lettersRemaining_Color;
             if (lettersRemaining < 0)
@@ -915,7 +888,7 @@ void GameBoardScreen::Draw(float totalTime, float elapsedTime)
                     m_gameBoardTileFont->DrawString(spriteBatch.get(), letter->Data(), tileCenter, Colors::Pink, 0.0f, letterOrigin, 0.75f);
 
                     // draw letter value (top-left-justified, offset from tile center)
-                    Platform::String^ letterValue = c_letterValues[letter->Data()[0] - L'A'].ToString();
+                    Platform::String^ letterValue = GameBoardScorer::GetLetterValue(letter->Data()[0]).ToString();
                     XMFLOAT2 letterValuePosition = XMFLOAT2(tileCenter.x + c_letterTileValue_OffsetFromTileCenter.x, tileCenter.y + c_letterTileValue_OffsetFromTileCenter.y);
                     XMVECTOR letterValueSize = m_gameBoardTileValueFont->MeasureString(letterValue->Data());
                     float letterValueScale = 0.45f;
@@ -928,7 +901,7 @@ void GameBoardScreen::Draw(float totalTime, float elapsedTime)
             }
 
             // draw word arrows
-            auto trackerTile = GetWordTrackerTile(XMUINT2(i, j));
+            auto& trackerTile = m_scorer.GetWordTrackerTile(XMUINT2(i, j));
             if (trackerTile.m_wordRight)
             {
                 XMFLOAT2 horizontalWordLinkerCenter = XMFLOAT2(c_wordLinkFirstHorizontal_Center.x + (c_letterTile_CenterOffset.x * i), c_wordLinkFirstHorizontal_Center.y + (c_letterTile_CenterOffset.y * j));
@@ -1004,7 +977,7 @@ void GameBoardScreen::Draw(float totalTime, float elapsedTime)
     // Draw game debug log
     auto logPosition = XMFLOAT2(c_debugLog_Region.X, c_debugLog_Region.Y);
     size_t maxDisplayLines = static_cast<size_t>(c_debugLog_Region.Height / m_logFontHeight);
-    auto logIndexSize = Log::g_displayLog.size();
+    auto logIndexSize = Log::GetDisplayLogSize();
     auto logIndexBegin = size_t(0);
     auto logIndexEnd = logIndexSize - 1;
 
@@ -1022,7 +995,13 @@ void GameBoardScreen::Draw(float totalTime, float elapsedTime)
 
     for (auto i = logIndexBegin; i <= logIndexEnd; ++i)
     {
-        m_logFont->DrawString(spriteBatch.get(), Log::g_displayLog[i]->Data(), logPosition);
+        auto logLine = Log::GetDisplayLogLine(i);
+        if (logLine == nullptr)
+        {
+            break;
+        }
+
+        m_logFont->DrawString(spriteBatch.get(), logLine->Data(), logPosition);
         logPosition.y += m_logFontHeight;
     }
 
@@ -1111,64 +1090,6 @@ void GameBoardScreen::ComputeMenuBounds(float viewportWidth, float viewportHeigh
     m_menuBounds = c_menu_Region;
 }
 
-int GameBoardScreen::GetWordScore(std::wstring word)
-{
-    auto wordLength = word.length();
-    if (wordLength < 2)
-    {
-        return 0;
-    }
-
-    auto it = m_wordList->find(word);
-    if (it == m_wordList->end())
-    {
-        return 0;
-    }
-
-    int score = 0;
-    std::for_each(word.cbegin(), word.cend(), [&score](wchar_t letter)
-    {
-        score += c_letterValues[letter - L'A'];
-    });
-
-    return score;
-}
-
-GameBoardScreen::WordTrackerTile& GameBoardScreen::GetWordTrackerTile(const XMUINT2& position)
-{
-    size_t tile = size_t(position.x + (c_boardWidth * position.y));
-    if (tile >= c_boardWidth * c_boardHeight)
-    {
-        throw std::invalid_argument("position is not valid for the current board size");
-    }
-
-    return m_wordTracker[tile];
-}
-
-void GameBoardScreen::TrackWord(bool isHorizontal, XMUINT2 startTile, size_t wordLength)
-{
-    if (isHorizontal)
-    {
-        auto lastX = startTile.x + wordLength - 2;
-        for (auto i = startTile.x; i <= lastX; ++i)
-        {
-            auto& trackerTile = GetWordTrackerTile(startTile);
-            trackerTile.m_wordRight = true;
-            startTile.x++;
-        }
-    }
-    else
-    {
-        auto lastY = startTile.y + wordLength - 2;
-        for (auto i = startTile.y; i <= lastY; ++i)
-        {
-            auto& trackerTile = GetWordTrackerTile(startTile);
-            trackerTile.m_wordDown = true;
-            startTile.y++;
-        }
-    }
-}
-
 void GameBoardScreen::UpdateLettersRemaining()
 {
     m_lettersRemaining.assign(c_letterCounts, c_letterCounts + sizeof(c_letterCounts)/sizeof(c_letterCounts[0]));
@@ -1205,100 +1126,12 @@ void GameBoardScreen::UpdateScore()
     assert(Game->GameSaveManager->HasActiveBoard);
 
     m_score = 0;
-    if (m_wordList == nullptr || m_wordList->empty())
+    if (m_wordList == nullptr || m_wordList->IsEmpty())
     {
         return;
     }
 
-    auto gameBoard = Game->GameSaveManager->ActiveBoard;
-    int newScore = 0;
-    std::wstring currentWord;
-
-    // Reset word tracker
-    auto boardTiles = c_boardWidth * c_boardHeight;
-    for (uint32_t i = 0; i < boardTiles; ++i)
-    {
-        m_wordTracker[i].m_wordDown = false;
-        m_wordTracker[i].m_wordRight = false;
-    }
-
-    // Score the horizontal words
-    for (uint32_t j = 0; j < gameBoard.m_boardHeight; ++j)
-    {
-        for (uint32_t i = 0; i < gameBoard.m_boardWidth; ++i)
-        {
-            auto currentTile = gameBoard.GetGameTile(XMUINT2(i, j));
-            auto currentLetter = currentTile.m_letter;
-            if (currentLetter != 0 && currentTile.m_placed)
-            {
-                currentWord += currentLetter;
-            }
-            else
-            {
-                if (!currentWord.empty())
-                {
-                    auto wordScore = GetWordScore(currentWord);
-                    if (wordScore > 0)
-                    {
-                        auto wordLength = uint32_t(currentWord.length());
-                        TrackWord(true, XMUINT2(i - wordLength, j), wordLength);
-                    }
-                    newScore += wordScore;
-                    currentWord.clear();
-                }
-            }
-        }
-        if (!currentWord.empty())
-        {
-            auto wordScore = GetWordScore(currentWord);
-            if (wordScore > 0)
-            {
-                auto wordLength = uint32_t(currentWord.length());
-                TrackWord(true, XMUINT2(gameBoard.m_boardWidth - wordLength, j), wordLength);
-            }
-            newScore += wordScore;
-            currentWord.clear();
-        }
-    }
-
-    // Score the vertical words
-    for (uint32_t i = 0; i < gameBoard.m_boardWidth; ++i)
-    {
-        for (uint32_t j = 0; j < gameBoard.m_boardHeight; ++j)
-        {
-            auto currentTile = gameBoard.GetGameTile(XMUINT2(i, j));
-            auto currentLetter = currentTile.m_letter;
-            if (currentLetter != 0 && currentTile.m_placed)
-            {
-                currentWord += currentLetter;
-            }
-            else
-            {
-                if (!currentWord.empty())
-                {
-                    auto wordScore = GetWordScore(currentWord);
-                    if (wordScore > 0)
-                    {
-                        auto wordLength = uint32_t(currentWord.length());
-                        TrackWord(false, XMUINT2(i, j - wordLength), wordLength);
-                    }
-                    newScore += wordScore;
-                    currentWord.clear();
-                }
-            }
-        }
-        if (!currentWord.empty())
-        {
-            auto wordScore = GetWordScore(currentWord);
-            if (wordScore > 0)
-            {
-                auto wordLength = uint32_t(currentWord.length());
-                TrackWord(false, XMUINT2(i, gameBoard.m_boardHeight - wordLength), wordLength);
-            }
-            newScore += wordScore;
-            currentWord.clear();
-        }
-    }
+    int newScore = m_scorer.Update(Game->GameSaveManager->ActiveBoard, *m_wordList);
 
     if (!m_isOverLimitOnLetters)
     {
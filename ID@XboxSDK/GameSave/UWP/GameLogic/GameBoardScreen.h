@@ -8,6 +8,8 @@
 #pragma once
 
 #include "ContentManager.h"
+#include "GameBoard.h"
+#include "GameBoardScorer.h"
 #include "MenuScreen.h"
 #include "Texture2D.h"
 
@@ -30,16 +32,6 @@ namespace GameSaveSample
         virtual void ComputeMenuBounds(float viewportWidth, float viewportHeight) override;
 
     private:
-        struct WordTrackerTile
-        {
-            WordTrackerTile() {}
-            bool m_wordDown = false;
-            bool m_wordRight = false;
-        };
-
-        int GetWordScore(std::wstring word);
-        WordTrackerTile& GetWordTrackerTile(const DirectX::XMUINT2& position); // returns WordTrackerTile given a zero-based (x, y) position
-        void TrackWord(bool isHorizontal, DirectX::XMUINT2 startTile, size_t wordLength);
         void UpdateLettersRemaining();
         void UpdateScore();
 
@@ -85,13 +77,14 @@ namespace GameSaveSample
         bool                                                m_isOverLimitOnLetters;
         std::vector<int>                                    m_lettersRemaining;
         size_t                                              m_logLineBegin; // set to non-zero value to stop auto-scrolling
+        uint64_t                                            m_logDropCount; // display log lines dropped as of the last Update
         float                                               m_logScrollDownDelay;
         float                                               m_logScrollUpDelay;
         int                                                 m_score;
+        GameBoardScorer                                     m_scorer;
         float                                               m_tileScrollDownDelay;
         float                                               m_tileScrollUpDelay;
         WordList                                            m_wordList;
         bool                                                m_wordListLoaded;
-        std::vector<WordTrackerTile>                        m_wordTracker;
     };
 }
@@ -8,12 +8,13 @@
 #pragma once
 
 #include "Common\Helpers.h"
-#include "Common\WrapBuffer.h"
+#include "GameSaveChunks.h"
 #include "GameSaveContainerMetadata.h"
+#include "GameSaveFormat.h"
+#include "GameSaveWriteQueue.h"
 #include <map>
 #include <mutex>
 #include <ppltasks.h>
-#include <wrl/implements.h>
 
 #ifdef _DEBUG
 #define DEFAULT_MINIMUM_SAVE_SIZE       1024 * 1024 // set this to a value > 0 and <= 16 MB to add padding for the purposes of simulating large game save scenarios, for demos and debugging (DO NOT SHIP A GAME WITH PADDING!)
@@ -25,11 +26,15 @@ template <typename TData>
 class GameSave
 {
 public:
-    GameSave(Platform::String^ containerName, Platform::String^ containerDisplayName, std::function<void(TData&)> saveFunction, uint32 minSaveSizeInBytes = static_cast<uint32>(DEFAULT_MINIMUM_SAVE_SIZE)) :
+    typedef GameSaveSample::SaveDataFormat<TData> Format; // how the data is laid out in the saved chunks
+
+    GameSave(Platform::String^ containerName, Platform::String^ containerDisplayName, std::function<void(TData&)> saveFunction, uint32 minSaveSizeInBytes = static_cast<uint32>(DEFAULT_MINIMUM_SAVE_SIZE), uint32 chunkSizeInBytes = GameSaveSample::c_defaultChunkSize) :
         OnSave(saveFunction),
         m_isGameDataDirty(false),
         m_isGameDataLoaded(false),
         m_minSaveSize(minSaveSizeInBytes),
+        m_chunkSize(std::max(chunkSizeInBytes, 1u)),
+        m_blobCodec(GameSaveSample::c_defaultBlobCodec),
         m_currentDataBuffer(0)
     {
         m_containerMetadata = std::make_shared<GameSaveContainerMetadata>(containerName, containerDisplayName);
@@ -50,19 +55,26 @@ public:
     void ResetData()
     {
         std::lock_guard<std::mutex> lock(m_mutex);
-        m_isGameDataDirty = false;
-        m_isGameDataLoaded = false;
-        m_containerMetadata->ResetData();
+        ResetDataLocked();
+    }
 
-        TData emptyData;
-        auto err = memcpy_s(&BackBuffer(), sizeof(TData), &emptyData, sizeof(TData));
-        if (err != 0)
+    // Resets the data unless it has changes which haven't been saved yet. Returns whether it was reset.
+    bool ResetDataIfNotDirty()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_isGameDataDirty)
         {
-            Log::Write("ERROR: GameSave::ResetData(): memcpy of game save data failed\n");
-            return;
+            return false;
         }
 
-        SwapBuffers();
+        ResetDataLocked();
+        return true;
+    }
+
+    bool IsDirtyOrLoaded() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_isGameDataDirty || m_isGameDataLoaded;
     }
 
     bool SetData(TData* newData, bool markDirtyOnSuccess = true)
@@ -118,15 +130,17 @@ public:
         });
     }
 
+    // With keepChanges, the data read is discarded if the data is dirty or loaded by the time the read completes, so that a read started
+    // in the background never overwrites changes made, or data loaded, while it was in flight
 #ifdef _XBOX_ONE
-    Concurrency::task<bool> Read(Windows::Xbox::Storage::ConnectedStorageContainer^ withContainer)
+    Concurrency::task<bool> Read(Windows::Xbox::Storage::ConnectedStorageContainer^ withContainer, bool keepChanges = false)
 #else
-    Concurrency::task<bool> Read(Windows::Gaming::XboxLive::Storage::GameSaveContainer^ withContainer)
+    Concurrency::task<bool> Read(Windows::Gaming::XboxLive::Storage::GameSaveContainer^ withContainer, bool keepChanges = false)
 #endif
     {
         Log::Write("GameSave::Read(%ws)\n", withContainer->Name->Data());
 
-        return ReadData(withContainer).then([this](bool readSuccess)
+        return ReadData(withContainer, keepChanges).then([this](bool readSuccess)
         {
             std::lock_guard<std::mutex> lock(m_mutex);
             if (!m_isGameDataLoaded)
@@ -151,27 +165,101 @@ public:
     {
         Log::Write("GameSave::Save(%ws)\n", withContainer->Name->Data());
 
+        GameSaveSample::BlobData snapshot;
+        bool wasGameDataDirty = TakeSnapshot(snapshot);
+
+        return SaveSnapshot(withContainer, snapshot, wasGameDataDirty);
+    }
+
+    // Runs OnSave on the front buffer and writes it into snapshot for SaveSnapshot, clearing the dirty flag. Returns whether the data was dirty.
+    bool TakeSnapshot(GameSaveSample::BlobData& snapshot)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        OnSave(FrontBuffer());
+
         bool wasGameDataDirty = m_isGameDataDirty; // preserve the current state of dirtiness in case the save fails
         m_isGameDataDirty = false;
 
-        OnSave(FrontBuffer());
+        snapshot.resize(Format::c_payloadSize);
+        if (!Format::Write(FrontBuffer(), snapshot.data()))
+        {
+            Log::Write("ERROR: GameSave::TakeSnapshot(): game save data could not be written\n");
+            snapshot.clear(); // fails the save
+        }
 
+        return wasGameDataDirty;
+    }
+
+    // Saves data copied by TakeSnapshot. The snapshot is only used before this returns, so it can be reused as soon as it does.
+#ifdef _XBOX_ONE
+    Concurrency::task<bool> SaveSnapshot(Windows::Xbox::Storage::ConnectedStorageContainer^ withContainer, const GameSaveSample::BlobData& snapshot, bool wasGameDataDirty)
+#else
+    Concurrency::task<bool> SaveSnapshot(Windows::Gaming::XboxLive::Storage::GameSaveContainer^ withContainer, const GameSaveSample::BlobData& snapshot, bool wasGameDataDirty)
+#endif
+    {
+        if (snapshot.size() != Format::c_payloadSize)
+        {
+            Log::Write("ERROR: GameSave::SaveSnapshot(): snapshot is %u bytes, expected %u\n", static_cast<uint32>(snapshot.size()), Format::c_payloadSize);
+            return Concurrency::task_from_result(false);
+        }
+
+        // only the chunks which changed since the last save or load are submitted, along with the new manifest
+        uint32 paddingSize = (Format::c_payloadSize < m_minSaveSize) ? m_minSaveSize - Format::c_payloadSize : 0;
+        auto manifest = std::make_shared<GameSaveSample::GameSaveManifest>();
         auto updates = ref new Platform::Collections::Map<Platform::String^, Windows::Storage::Streams::IBuffer^>();
-        auto dataBuffer = MakeDataBuffer(FrontBuffer());
+        std::vector<std::wstring> staleBlobs;
+        bool writePadding = false;
+        uint32 encodedSize = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
 
-        Platform::String^ blobName = "data";
-        updates->Insert(blobName, dataBuffer);
+            std::vector<uint32_t> changedChunks;
+            GameSaveSample::BuildManifest(snapshot.data(), Format::c_payloadSize, m_chunkSize, paddingSize, m_savedManifest, *manifest, changedChunks);
+            GameSaveSample::GetStaleBlobNames(m_savedManifest, *manifest, staleBlobs);
+            writePadding = paddingSize > 0 && (m_savedManifest.IsEmpty() || m_savedManifest.m_paddingSize != paddingSize);
 
-        auto totalRealBlobSize = dataBuffer->Length;
-        if (totalRealBlobSize < m_minSaveSize)
+            uint32 rawSize = 0;
+            for (auto chunk : changedChunks)
+            {
+                auto chunkBuffer = MakeChunkBuffer(snapshot.data(), *manifest, chunk);
+                rawSize += manifest->GetChunkLength(chunk);
+                encodedSize += chunkBuffer->Length;
+                updates->Insert(ref new Platform::String(GameSaveSample::GetChunkBlobName(chunk).c_str()), chunkBuffer);
+            }
+
+            Log::Write("GameSave::Save(): %u of %u chunks changed, %u bytes compressed to %u\n", static_cast<uint32>(changedChunks.size()), manifest->GetChunkCount(), rawSize, encodedSize);
+        }
+
+        updates->Insert(ref new Platform::String(GameSaveSample::c_manifestBlobName), MakeManifestBuffer(*manifest));
+
+        if (writePadding)
         {
             // a default minimum save size was specified for this game save data (should ONLY be used for debug or demo purposes)
-            updates->Insert("padding", MakePaddingBuffer(totalRealBlobSize, true));
+            // the padding never changes size, so it is only written when the container doesn't already have it
+            updates->Insert(ref new Platform::String(GameSaveSample::c_paddingBlobName), MakePaddingBuffer(Format::c_payloadSize, true));
         }
 
-        return SaveData(withContainer, updates->GetView(), nullptr).then([this, wasGameDataDirty](bool saveSuccess)
+        Platform::Collections::VectorView<Platform::String^>^ deletes = nullptr;
+        if (!staleBlobs.empty())
+        {
+            std::vector<Platform::String^> blobsToDelete;
+            for (auto& blobName : staleBlobs)
+            {
+                blobsToDelete.push_back(ref new Platform::String(blobName.c_str()));
+            }
+
+            deletes = ref new Platform::Collections::VectorView<Platform::String^>(blobsToDelete);
+        }
+
+        return SaveData(withContainer, updates->GetView(), deletes).then([this, wasGameDataDirty, manifest](bool saveSuccess)
         {
             std::lock_guard<std::mutex> lock(m_mutex);
+            if (saveSuccess)
+            {
+                m_savedManifest = *manifest;
+            }
+
             if (!m_isGameDataLoaded)
             {
                 m_isGameDataLoaded = saveSuccess;
@@ -194,9 +282,20 @@ public:
     {
         Log::Write("GameSave::DeleteBlobs(%ws)\n", withContainer->Name->Data());
 
+        uint32_t chunkCount = GetChunkLayout().GetChunkCount();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            chunkCount = std::max(chunkCount, m_savedManifest.GetChunkCount());
+        }
+
         std::vector<Platform::String^> blobsToDelete;
-        blobsToDelete.push_back(L"data");
-        blobsToDelete.push_back(L"padding");
+        blobsToDelete.push_back(ref new Platform::String(GameSaveSample::c_manifestBlobName));
+        for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+        {
+            blobsToDelete.push_back(ref new Platform::String(GameSaveSample::GetChunkBlobName(chunk).c_str()));
+        }
+        blobsToDelete.push_back(ref new Platform::String(GameSaveSample::c_legacyDataBlobName));
+        blobsToDelete.push_back(ref new Platform::String(GameSaveSample::c_paddingBlobName));
 
         return SaveData(withContainer, nullptr, ref new Platform::Collections::VectorView<Platform::String^>(blobsToDelete)).then([this](bool deleteSuccess)
         {
@@ -224,166 +323,345 @@ public:
     bool                                        m_isGameDataDirty;
     bool                                        m_isGameDataLoaded;
     uint32                                      m_minSaveSize; // adds padding data so that a save is this minimum size (see DEFAULT_MINIMUM_SAVE_SIZE above, for debugging only)
+    uint32                                      m_chunkSize; // the data is saved in blobs of this size, so that a save only writes the parts which changed
+    GameSaveSample::BlobCodec                   m_blobCodec; // the chunks and padding are compressed with this codec before they are saved
     mutable std::mutex                          m_mutex;
 
 private:
 #ifdef _XBOX_ONE
-    Concurrency::task<bool> GetData(Windows::Xbox::Storage::ConnectedStorageContainer^ withContainer)
+    typedef Windows::Xbox::Storage::ConnectedStorageContainer StorageContainer;
+#else
+    typedef Windows::Gaming::XboxLive::Storage::GameSaveContainer StorageContainer;
+#endif
+    typedef Windows::Foundation::Collections::IMapView<Platform::String^, Windows::Storage::Streams::IBuffer^> BlobMapView;
+
+    enum class BlobStatus
     {
-        using namespace Microsoft::WRL;
-        using namespace Platform::Collections;
-        using namespace Windows::Foundation::Collections;
-        using namespace Windows::Storage::Streams;
+        Ok,
+        BlobNotFound,
+        Failed
+    };
 
-        std::vector<Platform::String^> blobsToRead;
-        blobsToRead.push_back("data");
+    // Reads the manifest and every chunk in one GetAsync call, falling back to the single data blob written before saves were chunked
+    Concurrency::task<bool> GetData(StorageContainer^ withContainer)
+    {
+        return GetBlobs(withContainer, GetChunkedBlobNames(), [this](BlobMapView^ blobsRead) { return SetChunkedData(blobsRead); }).then([this, withContainer](BlobStatus status)
+        {
+            if (status != BlobStatus::BlobNotFound)
+            {
+                return Concurrency::task_from_result(status == BlobStatus::Ok);
+            }
 
-        auto start = std::chrono::high_resolution_clock::now();
+            Log::Write("GameSave::GetData(): no manifest, reading legacy data blob\n");
 
-        return create_task(withContainer->GetAsync(ref new VectorView<Platform::String^>(blobsToRead))).then([this, start](task<IMapView<Platform::String^, IBuffer^>^> t)
-        {
-            auto stop = std::chrono::high_resolution_clock::now();
-            auto durationMS = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
-            Log::WriteAndDisplay("GetAsync duration: " + durationMS.ToString() + "ms\n");
+            std::vector<Platform::String^> blobsToRead;
+            blobsToRead.push_back(ref new Platform::String(GameSaveSample::c_legacyDataBlobName));
 
-            try
+            return GetBlobs(withContainer, blobsToRead, [this](BlobMapView^ blobsRead) { return SetLegacyData(blobsRead); }).then([](BlobStatus legacyStatus)
             {
-                auto blobsRead = t.get();
-                Log::Write(L"GetAsync task succeeded\n");
+                return legacyStatus == BlobStatus::Ok;
+            });
+        });
+    }
 
-                if (blobsRead == nullptr)
+    // Reads the manifest and every chunk in one ReadAsync call, reading the chunks directly into the back buffer
+    Concurrency::task<bool> ReadData(StorageContainer^ withContainer, bool keepChanges)
+    {
+        using namespace Windows::Storage::Streams;
+
+        auto layout = GetChunkLayout();
+        auto manifestSize = GameSaveSample::GameSaveManifest::GetSerializedSize(layout.GetChunkCount());
+        Buffer^ manifestBuffer = ref new Buffer(manifestSize);
+        manifestBuffer->Length = manifestSize;
+
+        // the chunks are compressed, so each is read into a buffer big enough for its largest encoding and then decoded into the payload
+        auto chunkBuffers = std::make_shared<std::vector<Buffer^>>();
+        std::map<Platform::String^, IBuffer^> toRead;
+        toRead[ref new Platform::String(GameSaveSample::c_manifestBlobName)] = manifestBuffer;
+        for (uint32_t chunk = 0; chunk < layout.GetChunkCount(); ++chunk)
+        {
+            Buffer^ chunkBuffer = ref new Buffer(GameSaveSample::GetMaxEncodedSize(layout.GetChunkLength(chunk)));
+            chunkBuffers->push_back(chunkBuffer);
+            toRead[ref new Platform::String(GameSaveSample::GetChunkBlobName(chunk).c_str())] = chunkBuffer;
+        }
+
+        return ReadBlobs(withContainer, toRead).then([this, withContainer, manifestBuffer, chunkBuffers, keepChanges](BlobStatus status)
+        {
+            if (status == BlobStatus::Ok)
+            {
+                GameSaveSample::GameSaveManifest manifest;
+                if (!ParseManifest(manifestBuffer, manifest))
                 {
-                    Log::Write("ERROR: GetAsync OK but no blobs in result\n");
-                    return false;
+                    return Concurrency::task_from_result(false);
                 }
 
-                auto blobBuffer = blobsRead->Lookup("data");
-                if (blobBuffer == nullptr)
+                if (manifest.GetChunkCount() != chunkBuffers->size())
                 {
-                    Log::Write("ERROR: GetAsync OK but data blob not in result\n");
-                    return false;
+                    Log::Write("ERROR: GameSave::ReadData(): manifest has %u chunks, expected %u\n", manifest.GetChunkCount(), static_cast<uint32>(chunkBuffers->size()));
+                    return Concurrency::task_from_result(false);
                 }
 
-                IUnknown* unknown = reinterpret_cast<IUnknown*>(blobBuffer);
-                ComPtr<IBufferByteAccess> bufferByteAccess;
-                HRESULT hr = unknown->QueryInterface(_uuidof(IBufferByteAccess), &bufferByteAccess);
-                if (FAILED(hr))
+                GameSaveSample::BlobData payload(manifest.m_dataSize);
+                for (uint32_t chunk = 0; chunk < manifest.GetChunkCount(); ++chunk)
                 {
-                    Log::Write("ERROR: GetAsync OK but QueryInterface failed to get IBufferByteAccess\n");
-                    return false;
+                    if (!CopyChunkBuffer(manifest, chunk, (*chunkBuffers)[chunk], payload))
+                    {
+                        return Concurrency::task_from_result(false);
+                    }
                 }
 
-                byte* blobData = nullptr;
-                bufferByteAccess->Buffer(&blobData);
+                std::lock_guard<std::mutex> lock(m_mutex);
+                return Concurrency::task_from_result(ApplyChunkedData(manifest, payload, keepChanges));
+            }
 
-                return SetData(reinterpret_cast<TData*>(blobData), false);
+            if (status != BlobStatus::BlobNotFound)
+            {
+                return Concurrency::task_from_result(false);
             }
-            catch (Platform::Exception^ ex)
+
+            Log::Write("GameSave::ReadData(): no manifest, reading legacy data blob\n");
+
+            Buffer^ legacyBuffer = ref new Buffer(Format::c_legacySize);
+            std::map<Platform::String^, IBuffer^> legacyToRead;
+            legacyToRead[ref new Platform::String(GameSaveSample::c_legacyDataBlobName)] = legacyBuffer;
+
+            return ReadBlobs(withContainer, legacyToRead).then([this, legacyBuffer, keepChanges](BlobStatus legacyStatus)
             {
-                auto hr = ex->HResult;
-                if (hr == (int)Windows::Xbox::Storage::ConnectedStorageErrorStatus::BlobNotFound)
+                if (legacyStatus != BlobStatus::Ok)
                 {
-                    Log::WriteAndDisplay("GetAsync result: BlobNotFound (%ws)\n", FormatHResult(hr)->Data());
-                }
-                else
-                {
-                    Log::WriteAndDisplay("GetAsync task returned exception (%ws)\n", FormatHResult(hr)->Data());
+                    return false;
                 }
 
+                return SetLegacyData(legacyBuffer, keepChanges);
+            });
+        });
+    }
+
+    // Decodes the chunks into the payload, and loads it into the front buffer if it matches the manifest
+    bool SetChunkedData(BlobMapView^ blobsRead)
+    {
+        auto manifestName = ref new Platform::String(GameSaveSample::c_manifestBlobName);
+        GameSaveSample::GameSaveManifest manifest;
+        if (!blobsRead->HasKey(manifestName) || !ParseManifest(blobsRead->Lookup(manifestName), manifest))
+        {
+            Log::Write("ERROR: GetAsync OK but manifest blob not in result\n");
+            return false;
+        }
+
+        GameSaveSample::BlobData payload(manifest.m_dataSize);
+        for (uint32_t chunk = 0; chunk < manifest.GetChunkCount(); ++chunk)
+        {
+            auto chunkName = ref new Platform::String(GameSaveSample::GetChunkBlobName(chunk).c_str());
+            if (!CopyChunkBuffer(manifest, chunk, blobsRead->HasKey(chunkName) ? blobsRead->Lookup(chunkName) : nullptr, payload))
+            {
                 return false;
             }
-        });
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return ApplyChunkedData(manifest, payload, false);
     }
-#else
-    Concurrency::task<bool> GetData(Windows::Gaming::XboxLive::Storage::GameSaveContainer^ withContainer)
+
+    // Decodes a chunk read from storage into the payload
+    bool CopyChunkBuffer(const GameSaveSample::GameSaveManifest& manifest, uint32_t chunk, Windows::Storage::Streams::IBuffer^ chunkBuffer, GameSaveSample::BlobData& payload) const
     {
-        using namespace Microsoft::WRL;
-        using namespace Platform::Collections;
-        using namespace Windows::Foundation::Collections;
-        using namespace Windows::Gaming::XboxLive::Storage;
-        using namespace Windows::Storage::Streams;
+        if (chunkBuffer == nullptr || !GameSaveSample::CopyChunk(manifest, chunk, Helpers::GetBufferData(chunkBuffer), chunkBuffer->Length, payload.data()))
+        {
+            Log::Write("ERROR: GameSave: %ws blob is missing or not valid\n", GameSaveSample::GetChunkBlobName(chunk).c_str());
+            return false;
+        }
+
+        return true;
+    }
+
+    bool SetLegacyData(BlobMapView^ blobsRead)
+    {
+        auto blobName = ref new Platform::String(GameSaveSample::c_legacyDataBlobName);
+        auto blobBuffer = blobsRead->HasKey(blobName) ? blobsRead->Lookup(blobName) : nullptr;
+        if (blobBuffer == nullptr)
+        {
+            Log::Write("ERROR: GetAsync OK but data blob not in result\n");
+            return false;
+        }
+
+        return SetLegacyData(blobBuffer, false);
+    }
+
+    // Loads the single data blob written before saves were chunked, migrating it to the current layout of TData
+    bool SetLegacyData(Windows::Storage::Streams::IBuffer^ blobBuffer, bool keepChanges)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!Format::Read(Helpers::GetBufferData(blobBuffer), blobBuffer->Length, BackBuffer()))
+        {
+            Log::WriteAndDisplay("ERROR: legacy game save data is not valid (%u bytes)\n", blobBuffer->Length);
+            return false;
+        }
+
+        if (keepChanges && IsReadStale())
+        {
+            return false;
+        }
+
+        SwapBuffers();
+        m_savedManifest.Reset();
+        return true;
+    }
+
+    // Call with m_mutex held
+    void ResetDataLocked()
+    {
+        m_isGameDataDirty = false;
+        m_isGameDataLoaded = false;
+        m_containerMetadata->ResetData();
+        m_savedManifest.Reset();
+
+        TData emptyData;
+        auto err = memcpy_s(&BackBuffer(), sizeof(TData), &emptyData, sizeof(TData));
+        if (err != 0)
+        {
+            Log::Write("ERROR: GameSave::ResetData(): memcpy of game save data failed\n");
+            return;
+        }
+
+        SwapBuffers();
+    }
+
+    // Call with m_mutex held, once the chunks have been decoded into the payload
+    bool ApplyChunkedData(const GameSaveSample::GameSaveManifest& manifest, const GameSaveSample::BlobData& payload, bool keepChanges)
+    {
+        if (!GameSaveSample::VerifyChunks(manifest, payload.data(), payload.size()))
+        {
+            Log::WriteAndDisplay("ERROR: game save data does not match its manifest\n");
+            return false;
+        }
+
+        if (!Format::Read(payload.data(), static_cast<uint32_t>(payload.size()), BackBuffer()))
+        {
+            Log::WriteAndDisplay("ERROR: game save data is not valid\n");
+            return false;
+        }
+
+        if (keepChanges && IsReadStale())
+        {
+            return false;
+        }
+
+        SwapBuffers();
+        m_savedManifest = manifest;
+        return true;
+    }
+
+    // Call with m_mutex held: true if a read with keepChanges has to be discarded, as the data is dirty or already loaded
+    bool IsReadStale() const
+    {
+        if (m_isGameDataDirty || m_isGameDataLoaded)
+        {
+            Log::Write("GameSave: %ws changed while it was being read, the read is discarded\n", m_containerMetadata->m_containerName->Data());
+            return true;
+        }
+
+        return false;
+    }
+
+    bool ParseManifest(Windows::Storage::Streams::IBuffer^ buffer, GameSaveSample::GameSaveManifest& manifest) const
+    {
+        if (buffer == nullptr || !manifest.Parse(Helpers::GetBufferData(buffer), buffer->Length))
+        {
+            Log::Write("ERROR: GameSave: manifest blob is not valid\n");
+            return false;
+        }
+
+        // data saved before TData had a format of its own is still loaded, and is migrated by Format::Read
+        if (manifest.m_dataSize != Format::c_payloadSize && manifest.m_dataSize != Format::c_legacySize)
+        {
+            Log::Write("ERROR: GameSave: manifest is for %u bytes of data, expected %u\n", manifest.m_dataSize, Format::c_payloadSize);
+            return false;
+        }
+
+        return true;
+    }
+
+    // The chunks the current data would be saved as, without the hashes
+    GameSaveSample::GameSaveManifest GetChunkLayout() const
+    {
+        GameSaveSample::GameSaveManifest layout;
+        layout.SetLayout(Format::c_payloadSize, m_chunkSize);
+        return layout;
+    }
 
-        std::vector<Platform::String^> blobsToRead;
-        blobsToRead.push_back("data");
+    std::vector<Platform::String^> GetChunkedBlobNames() const
+    {
+        std::vector<Platform::String^> blobNames;
+        blobNames.push_back(ref new Platform::String(GameSaveSample::c_manifestBlobName));
+
+        uint32_t chunkCount = GetChunkLayout().GetChunkCount();
+        for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+        {
+            blobNames.push_back(ref new Platform::String(GameSaveSample::GetChunkBlobName(chunk).c_str()));
+        }
+
+        return blobNames;
+    }
+
+#ifdef _XBOX_ONE
+    Concurrency::task<BlobStatus> GetBlobs(StorageContainer^ withContainer, const std::vector<Platform::String^>& blobsToRead, std::function<bool(BlobMapView^)> onBlobsRead)
+    {
+        using namespace Platform::Collections;
 
         auto start = std::chrono::high_resolution_clock::now();
 
-        return create_task(withContainer->GetAsync(ref new VectorView<Platform::String^>(blobsToRead))).then([this, start](GameSaveBlobGetResult^ getResult)
+        return create_task(withContainer->GetAsync(ref new VectorView<Platform::String^>(blobsToRead))).then([start, onBlobsRead](task<BlobMapView^> t)
         {
             auto stop = std::chrono::high_resolution_clock::now();
             auto durationMS = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
             Log::WriteAndDisplay("GetAsync duration: " + durationMS.ToString() + "ms\n");
 
-            switch (getResult->Status)
-            {
-            case GameSaveErrorStatus::BlobNotFound:
-                Log::WriteAndDisplay("GetAsync result: BlobNotFound\n");
-                return false;
-            case GameSaveErrorStatus::Ok:
+            try
             {
-                IMapView<Platform::String^, IBuffer^>^ blobsRead = getResult->Value;
+                auto blobsRead = t.get();
+                Log::Write(L"GetAsync task succeeded\n");
+
                 if (blobsRead == nullptr)
                 {
                     Log::Write("ERROR: GetAsync OK but no blobs in result\n");
-                    return false;
+                    return BlobStatus::Failed;
                 }
 
-                auto blobBuffer = blobsRead->Lookup("data");
-                if (blobBuffer == nullptr)
-                {
-                    Log::Write("ERROR: GetAsync OK but data blob not in result\n");
-                    return false;
-                }
-
-                IUnknown* unknown = reinterpret_cast<IUnknown*>(blobBuffer);
-                ComPtr<IBufferByteAccess> bufferByteAccess;
-                HRESULT hr = unknown->QueryInterface(_uuidof(IBufferByteAccess), &bufferByteAccess);
-                if (FAILED(hr))
+                return onBlobsRead(blobsRead) ? BlobStatus::Ok : BlobStatus::Failed;
+            }
+            catch (Platform::Exception^ ex)
+            {
+                auto hr = ex->HResult;
+                if (hr == (int)Windows::Xbox::Storage::ConnectedStorageErrorStatus::BlobNotFound)
                 {
-                    Log::Write("ERROR: GetAsync OK but QueryInterface failed to get IBufferByteAccess\n");
-                    return false;
+                    Log::WriteAndDisplay("GetAsync result: BlobNotFound (%ws)\n", FormatHResult(hr)->Data());
+                    return BlobStatus::BlobNotFound;
                 }
 
-                byte* blobData = nullptr;
-                bufferByteAccess->Buffer(&blobData);
-
-                return SetData(reinterpret_cast<TData*>(blobData), false);
-            }
-            default:
-                Log::WriteAndDisplay("GetAsync result: %ws\n", getResult->Status.ToString()->Data());
-                return false;
+                Log::WriteAndDisplay("GetAsync task returned exception (%ws)\n", FormatHResult(hr)->Data());
+                return BlobStatus::Failed;
             }
         });
     }
-#endif
 
-#ifdef _XBOX_ONE
-    Concurrency::task<bool> ReadData(Windows::Xbox::Storage::ConnectedStorageContainer^ withContainer)
+    Concurrency::task<BlobStatus> ReadBlobs(StorageContainer^ withContainer, const std::map<Platform::String^, Windows::Storage::Streams::IBuffer^>& toRead)
     {
         using namespace Platform::Collections;
         using namespace Windows::Storage::Streams;
 
-        std::map<Platform::String^, IBuffer^> toRead;
-        toRead["data"] = MakeDataBuffer(BackBuffer());
-
         auto start = std::chrono::high_resolution_clock::now();
 
-        return create_task(withContainer->ReadAsync(ref new MapView<Platform::String^, IBuffer^>(toRead))).then([=](task<void> t)
+        return create_task(withContainer->ReadAsync(ref new MapView<Platform::String^, IBuffer^>(toRead))).then([start](task<void> t)
         {
             auto stop = std::chrono::high_resolution_clock::now();
             auto durationMS = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
             Log::WriteAndDisplay("ReadAsync duration: " + durationMS.ToString() + "ms\n");
 
-            bool readSuccess = false;
-
             try
             {
                 t.get();
                 Log::Write("ReadAsync task succeeded\n");
-
-                std::lock_guard<std::mutex> lock(m_mutex);
-                SwapBuffers();
-                readSuccess = true;
+                return BlobStatus::Ok;
             }
             catch (Platform::Exception^ ex)
             {
@@ -391,53 +669,76 @@ private:
                 if (hr == (int)Windows::Xbox::Storage::ConnectedStorageErrorStatus::BlobNotFound)
                 {
                     Log::WriteAndDisplay("ReadAsync result: BlobNotFound (%ws)\n", FormatHResult(hr)->Data());
+                    return BlobStatus::BlobNotFound;
                 }
-                else
+
+                Log::WriteAndDisplay("ERROR: ReadAsync task returned exception (%ws)\n", FormatHResult(hr)->Data());
+                return BlobStatus::Failed;
+            }
+        });
+    }
+#else
+    Concurrency::task<BlobStatus> GetBlobs(StorageContainer^ withContainer, const std::vector<Platform::String^>& blobsToRead, std::function<bool(BlobMapView^)> onBlobsRead)
+    {
+        using namespace Platform::Collections;
+        using namespace Windows::Gaming::XboxLive::Storage;
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        return create_task(withContainer->GetAsync(ref new VectorView<Platform::String^>(blobsToRead))).then([start, onBlobsRead](GameSaveBlobGetResult^ getResult)
+        {
+            auto stop = std::chrono::high_resolution_clock::now();
+            auto durationMS = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
+            Log::WriteAndDisplay("GetAsync duration: " + durationMS.ToString() + "ms\n");
+
+            switch (getResult->Status)
+            {
+            case GameSaveErrorStatus::BlobNotFound:
+                Log::WriteAndDisplay("GetAsync result: BlobNotFound\n");
+                return BlobStatus::BlobNotFound;
+            case GameSaveErrorStatus::Ok:
+            {
+                BlobMapView^ blobsRead = getResult->Value;
+                if (blobsRead == nullptr)
                 {
-                    Log::WriteAndDisplay("ERROR: ReadAsync task returned exception (%ws)\n", FormatHResult(hr)->Data());
+                    Log::Write("ERROR: GetAsync OK but no blobs in result\n");
+                    return BlobStatus::Failed;
                 }
-            }
 
-            return readSuccess;
+                return onBlobsRead(blobsRead) ? BlobStatus::Ok : BlobStatus::Failed;
+            }
+            default:
+                Log::WriteAndDisplay("GetAsync result: %ws\n", getResult->Status.ToString()->Data());
+                return BlobStatus::Failed;
+            }
         });
     }
-#else
-    Concurrency::task<bool> ReadData(Windows::Gaming::XboxLive::Storage::GameSaveContainer^ withContainer)
+
+    Concurrency::task<BlobStatus> ReadBlobs(StorageContainer^ withContainer, const std::map<Platform::String^, Windows::Storage::Streams::IBuffer^>& toRead)
     {
         using namespace Platform::Collections;
         using namespace Windows::Gaming::XboxLive::Storage;
         using namespace Windows::Storage::Streams;
 
-        std::map<Platform::String^, IBuffer^> toRead;
-        toRead["data"] = MakeDataBuffer(BackBuffer());
-
         auto start = std::chrono::high_resolution_clock::now();
 
-        return create_task(withContainer->ReadAsync(ref new MapView<Platform::String^, IBuffer^>(toRead))).then([=](GameSaveOperationResult^ readResult)
+        return create_task(withContainer->ReadAsync(ref new MapView<Platform::String^, IBuffer^>(toRead))).then([start](GameSaveOperationResult^ readResult)
         {
             auto stop = std::chrono::high_resolution_clock::now();
             auto durationMS = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
             Log::WriteAndDisplay("ReadAsync duration: " + durationMS.ToString() + "ms\n");
 
-            bool readSuccess = false;
-
             switch (readResult->Status)
             {
             case GameSaveErrorStatus::BlobNotFound:
                 Log::WriteAndDisplay("ReadAsync result: BlobNotFound\n");
-                break;
+                return BlobStatus::BlobNotFound;
             case GameSaveErrorStatus::Ok:
-            {
-                std::lock_guard<std::mutex> lock(m_mutex);
-                SwapBuffers();
-                readSuccess = true;
-                break;
-            }
+                return BlobStatus::Ok;
             default:
                 Log::WriteAndDisplay("ReadAsync result: %ws\n", readResult->Status.ToString()->Data());
+                return BlobStatus::Failed;
             }
-
-            return readSuccess;
         });
     }
 #endif
@@ -513,37 +814,55 @@ private:
     }
 #endif
 
-    Windows::Storage::Streams::IBuffer^ MakeDataBuffer(TData& data) const
+    // Chunks are compressed into their own buffers rather than wrapped, so that the snapshot can be reused once the update has been submitted
+    Windows::Storage::Streams::Buffer^ MakeChunkBuffer(const uint8_t* data, const GameSaveSample::GameSaveManifest& manifest, uint32_t chunk) const
+    {
+        return MakeEncodedBuffer(data + manifest.GetChunkOffset(chunk), manifest.GetChunkLength(chunk));
+    }
+
+    Windows::Storage::Streams::Buffer^ MakeEncodedBuffer(const void* data, uint32 size) const
     {
-        using namespace Microsoft::WRL;
-        using namespace Microsoft::WRL::Details;
         using namespace Windows::Storage::Streams;
 
-        Log::Write("data buffer = %u bytes\n", sizeof(TData));
-        ComPtr<ABI::Windows::Storage::Streams::IBuffer> wrapBuffer = Make<WrapBuffer>(&data, sizeof(TData));
+        Buffer^ buffer = ref new Buffer(GameSaveSample::GetMaxEncodedSize(size));
+        buffer->Length = GameSaveSample::EncodeBlob(data, size, m_blobCodec, Helpers::GetBufferData(buffer));
 
-        return reinterpret_cast<IBuffer^>(wrapBuffer.Get());
+        return buffer;
     }
 
-    Windows::Storage::Streams::Buffer^ MakePaddingBuffer(uint32 size, bool fillWithRandomData) const // (for debugging only)
+    Windows::Storage::Streams::Buffer^ MakeManifestBuffer(const GameSaveSample::GameSaveManifest& manifest) const
     {
         using namespace Windows::Storage::Streams;
 
-        size = m_minSaveSize - size;
-
+        uint32 size = GameSaveSample::GameSaveManifest::GetSerializedSize(manifest.GetChunkCount());
         Buffer^ buffer = ref new Buffer(size);
         buffer->Length = size;
 
+        manifest.Serialize(Helpers::GetBufferData(buffer));
+
+        return buffer;
+    }
+
+    Windows::Storage::Streams::Buffer^ MakePaddingBuffer(uint32 size, bool fillWithRandomData) const // (for debugging only)
+    {
+        using namespace Windows::Storage::Streams;
+
+        size = m_minSaveSize - size;
+
+        // the padding is compressed like the chunks, so it only fills the quota as much as real data would
+        std::vector<int> data((size + sizeof(int) - 1) / sizeof(int));
         if (fillWithRandomData)
         {
-            int* data = reinterpret_cast<int*>(Helpers::GetBufferData(buffer));
-            size_t randNumbersToWrite = size / sizeof(*data);
+            size_t randNumbersToWrite = size / sizeof(int);
             for (size_t i = 0; i < randNumbersToWrite; ++i)
             {
                 data[i] = rand();
             }
         }
 
+        Buffer^ buffer = MakeEncodedBuffer(data.data(), size);
+        Log::Write("padding buffer = %u bytes, compressed to %u\n", size, buffer->Length);
+
         return buffer;
     }
 
@@ -557,6 +876,75 @@ private:
         m_currentDataBuffer = (m_currentDataBuffer + 1) & 1;
     }
 
-    size_t                  m_currentDataBuffer;
-    TData                   m_data[2];
+    size_t                              m_currentDataBuffer;
+    TData                               m_data[2];
+    GameSaveSample::GameSaveManifest    m_savedManifest; // the chunks last read or written, so a save can skip the ones which haven't changed
 };
+
+// Saves gameSave through the write queue, so the save may be coalesced with others of the same container. The front
+// buffer is copied when the write starts, and the task completes when it finishes.
+template <typename TData>
+#ifdef _XBOX_ONE
+Concurrency::task<bool> QueueSave(GameSaveSample::GameSaveWriteQueue& queue, std::shared_ptr<GameSave<TData>> gameSave, Windows::Xbox::Storage::ConnectedStorageContainer^ withContainer, bool immediate)
+#else
+Concurrency::task<bool> QueueSave(GameSaveSample::GameSaveWriteQueue& queue, std::shared_ptr<GameSave<TData>> gameSave, Windows::Gaming::XboxLive::Storage::GameSaveContainer^ withContainer, bool immediate)
+#endif
+{
+    Concurrency::task_completion_event<bool> writeCompleted;
+    auto wasGameDataDirty = std::make_shared<bool>(false);
+
+    queue.Enqueue(
+        withContainer->Name->Data(),
+        [gameSave, wasGameDataDirty](GameSaveSample::BlobData& snapshot)
+        {
+            *wasGameDataDirty = gameSave->TakeSnapshot(snapshot);
+        },
+        [gameSave, withContainer, wasGameDataDirty](const GameSaveSample::BlobData& snapshot)
+        {
+            // the queue's worker thread isn't an STA thread, so it can wait on the save
+            try
+            {
+                return gameSave->SaveSnapshot(withContainer, snapshot, *wasGameDataDirty).get();
+            }
+            catch (Platform::Exception^ ex)
+            {
+                Log::WriteAndDisplay("ERROR: queued save of %ws threw exception (%ws)\n", withContainer->Name->Data(), GetErrorStringForException(ex)->Data());
+                return false;
+            }
+        },
+        [writeCompleted](bool saveSuccess)
+        {
+            writeCompleted.set(saveSuccess);
+        },
+        immediate);
+
+    return Concurrency::create_task(writeCompleted);
+}
+
+// Runs operation, such as a delete, through the write queue, so it can't overlap a save of the container; a save of the
+// container waiting in the queue is dropped. The task completes when the operation's task has finished.
+inline Concurrency::task<bool> QueueContainerOperation(GameSaveSample::GameSaveWriteQueue& queue, Platform::String^ containerName, std::function<Concurrency::task<bool>()> operation)
+{
+    Concurrency::task_completion_event<bool> operationCompleted;
+
+    queue.EnqueueOperation(
+        containerName->Data(),
+        [containerName, operation]()
+        {
+            try
+            {
+                return operation().get();
+            }
+            catch (Platform::Exception^ ex)
+            {
+                Log::WriteAndDisplay("ERROR: queued operation on %ws threw exception (%ws)\n", containerName->Data(), GetErrorStringForException(ex)->Data());
+                return false;
+            }
+        },
+        [operationCompleted](bool success)
+        {
+            operationCompleted.set(success);
+        });
+
+    return Concurrency::create_task(operationCompleted);
+}
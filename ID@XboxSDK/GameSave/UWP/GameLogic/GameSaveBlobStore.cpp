@@ -0,0 +1,1044 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#include "pch.h"
+#include "GameSaveBlobStore.h"
+#include "GameSaveChunks.h"
+#include <algorithm>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <codecvt>
+#include <dirent.h>
+#include <fcntl.h>
+#include <locale>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const wchar_t   c_pathSeparator = L'/';
+    const wchar_t*  c_tempSuffix = L".tmp";
+    const wchar_t*  c_journalName = L".journal";    // Blob names can't start with '.', so this can't be a blob
+    const wchar_t*  c_deletedSuffix = L".deleted";  // A container being deleted is renamed to this first
+
+    // Journal: header, an entry for each updated blob (name, size, hash) and each deleted blob (name), then the hash
+    // of everything before it. Names are stored as a length and then 32-bit characters.
+    const uint32_t  c_journalMagic = 0x4C4A5347; // "GSJL"
+    const uint16_t  c_journalVersion = 1;
+    const uint32_t  c_journalHeaderSize = 4 + 2 + 2 + 4 + 4; // magic, version, reserved, update count, delete count
+    const uint32_t  c_maxJournalNameLength = 1024;
+
+    // Thin wrappers over the file system calls which differ between Windows and POSIX
+#ifdef _WIN32
+    FILE* OpenBlobFile(const std::wstring& path, const wchar_t* mode)
+    {
+        FILE* file = nullptr;
+        if (_wfopen_s(&file, path.c_str(), mode) != 0)
+        {
+            return nullptr;
+        }
+
+        return file;
+    }
+
+    bool CreateDirectoryIfMissing(const std::wstring& path)
+    {
+        return CreateDirectoryW(path.c_str(), nullptr) || GetLastError() == ERROR_ALREADY_EXISTS;
+    }
+
+    bool RemoveEmptyDirectory(const std::wstring& path)
+    {
+        return RemoveDirectoryW(path.c_str()) != FALSE;
+    }
+
+    bool RenameOverFile(const std::wstring& from, const std::wstring& to)
+    {
+        return MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != FALSE;
+    }
+
+    bool SyncFile(FILE* file)
+    {
+        return _commit(_fileno(file)) == 0;
+    }
+
+    bool SyncDirectory(const std::wstring&)
+    {
+        // renames are written through (see RenameOverFile), and NTFS journals directory changes
+        return true;
+    }
+
+    bool DeleteFileIfPresent(const std::wstring& path)
+    {
+        return DeleteFileW(path.c_str()) || GetLastError() == ERROR_FILE_NOT_FOUND;
+    }
+
+    std::vector<std::wstring> ListFiles(const std::wstring& path)
+    {
+        std::vector<std::wstring> files;
+
+        WIN32_FIND_DATAW findData = {};
+        HANDLE find = FindFirstFileExW((path + L"\\*").c_str(), FindExInfoBasic, &findData, FindExSearchNameMatch, nullptr, 0);
+        if (find == INVALID_HANDLE_VALUE)
+        {
+            return files;
+        }
+
+        do
+        {
+            if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+            {
+                files.push_back(findData.cFileName);
+            }
+        } while (FindNextFileW(find, &findData));
+
+        FindClose(find);
+        return files;
+    }
+
+    std::vector<std::wstring> ListDirectories(const std::wstring& path)
+    {
+        std::vector<std::wstring> directories;
+
+        WIN32_FIND_DATAW findData = {};
+        HANDLE find = FindFirstFileExW((path + L"\\*").c_str(), FindExInfoBasic, &findData, FindExSearchLimitToDirectories, nullptr, 0);
+        if (find == INVALID_HANDLE_VALUE)
+        {
+            return directories;
+        }
+
+        do
+        {
+            if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && wcscmp(findData.cFileName, L".") != 0 && wcscmp(findData.cFileName, L"..") != 0)
+            {
+                directories.push_back(findData.cFileName);
+            }
+        } while (FindNextFileW(find, &findData));
+
+        FindClose(find);
+        return directories;
+    }
+#else
+    std::string ToNarrow(const std::wstring& path)
+    {
+        return std::wstring_convert<std::codecvt_utf8<wchar_t>>().to_bytes(path);
+    }
+
+    std::wstring ToWide(const char* path)
+    {
+        return std::wstring_convert<std::codecvt_utf8<wchar_t>>().from_bytes(path);
+    }
+
+    FILE* OpenBlobFile(const std::wstring& path, const wchar_t* mode)
+    {
+        return fopen(ToNarrow(path).c_str(), ToNarrow(mode).c_str());
+    }
+
+    bool CreateDirectoryIfMissing(const std::wstring& path)
+    {
+        return mkdir(ToNarrow(path).c_str(), 0755) == 0 || errno == EEXIST;
+    }
+
+    bool RemoveEmptyDirectory(const std::wstring& path)
+    {
+        return rmdir(ToNarrow(path).c_str()) == 0;
+    }
+
+    bool RenameOverFile(const std::wstring& from, const std::wstring& to)
+    {
+        return rename(ToNarrow(from).c_str(), ToNarrow(to).c_str()) == 0;
+    }
+
+    bool SyncFile(FILE* file)
+    {
+        return fsync(fileno(file)) == 0;
+    }
+
+    // Flushes the directory's entries, so that files created, renamed or deleted in it stay that way after a crash
+    bool SyncDirectory(const std::wstring& path)
+    {
+        int directory = open(ToNarrow(path).c_str(), O_RDONLY | O_DIRECTORY);
+        if (directory < 0)
+        {
+            return false;
+        }
+
+        bool success = fsync(directory) == 0;
+        close(directory);
+        return success;
+    }
+
+    bool DeleteFileIfPresent(const std::wstring& path)
+    {
+        return unlink(ToNarrow(path).c_str()) == 0 || errno == ENOENT;
+    }
+
+    // The type of a directory entry, DT_REG, DT_DIR or another DT_ value. File systems which don't fill in d_type report DT_UNKNOWN,
+    // so the entry is looked up instead; a symbolic link is reported as DT_LNK either way.
+    unsigned char GetEntryType(DIR* dir, const dirent* entry)
+    {
+        if (entry->d_type != DT_UNKNOWN)
+        {
+            return entry->d_type;
+        }
+
+        struct stat entryStat;
+        if (fstatat(dirfd(dir), entry->d_name, &entryStat, AT_SYMLINK_NOFOLLOW) != 0)
+        {
+            return DT_UNKNOWN;
+        }
+
+        if (S_ISREG(entryStat.st_mode))
+        {
+            return DT_REG;
+        }
+
+        if (S_ISDIR(entryStat.st_mode))
+        {
+            return DT_DIR;
+        }
+
+        return S_ISLNK(entryStat.st_mode) ? DT_LNK : DT_UNKNOWN;
+    }
+
+    std::vector<std::wstring> ListFiles(const std::wstring& path)
+    {
+        std::vector<std::wstring> files;
+
+        DIR* dir = opendir(ToNarrow(path).c_str());
+        if (dir == nullptr)
+        {
+            return files;
+        }
+
+        while (dirent* entry = readdir(dir))
+        {
+            if (GetEntryType(dir, entry) == DT_REG)
+            {
+                files.push_back(ToWide(entry->d_name));
+            }
+        }
+
+        closedir(dir);
+        return files;
+    }
+
+    std::vector<std::wstring> ListDirectories(const std::wstring& path)
+    {
+        std::vector<std::wstring> directories;
+
+        DIR* dir = opendir(ToNarrow(path).c_str());
+        if (dir == nullptr)
+        {
+            return directories;
+        }
+
+        while (dirent* entry = readdir(dir))
+        {
+            if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0 && GetEntryType(dir, entry) == DT_DIR)
+            {
+                directories.push_back(ToWide(entry->d_name));
+            }
+        }
+
+        closedir(dir);
+        return directories;
+    }
+#endif
+
+    bool ReadFileContents(const std::wstring& path, GameSaveSample::BlobData& data)
+    {
+        FILE* file = OpenBlobFile(path, L"rb");
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        bool success = fseek(file, 0, SEEK_END) == 0;
+        long size = success ? ftell(file) : -1;
+        success = size >= 0 && fseek(file, 0, SEEK_SET) == 0;
+
+        if (success)
+        {
+            data.resize(size_t(size));
+            success = data.empty() || fread(data.data(), 1, data.size(), file) == data.size();
+        }
+
+        fclose(file);
+        return success;
+    }
+
+    bool GetFileContentsSize(const std::wstring& path, uint64_t& size)
+    {
+        FILE* file = OpenBlobFile(path, L"rb");
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        bool success = fseek(file, 0, SEEK_END) == 0;
+        long fileSize = success ? ftell(file) : -1;
+        fclose(file);
+
+        size = (fileSize >= 0) ? uint64_t(fileSize) : 0;
+        return fileSize >= 0;
+    }
+
+    // Writes size bytes of data (all of it if size is SIZE_MAX), flushing them to the disk if syncToDisk is set
+    bool WriteFileContents(const std::wstring& path, const GameSaveSample::BlobData& data, bool syncToDisk = false, size_t size = SIZE_MAX)
+    {
+        FILE* file = OpenBlobFile(path, L"wb");
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        size = std::min(size, data.size());
+        bool success = size == 0 || fwrite(data.data(), 1, size, file) == size;
+        success = (fflush(file) == 0) && success;
+        if (syncToDisk)
+        {
+            success = SyncFile(file) && success;
+        }
+        success = (fclose(file) == 0) && success;
+        return success;
+    }
+
+    bool HasSuffix(const std::wstring& name, const wchar_t* suffix)
+    {
+        size_t suffixLength = wcslen(suffix);
+        return name.length() >= suffixLength && name.compare(name.length() - suffixLength, suffixLength, suffix) == 0;
+    }
+
+    bool IsTempFile(const std::wstring& name)
+    {
+        return HasSuffix(name, c_tempSuffix);
+    }
+
+    // Deletes a directory and the files in it
+    bool RemoveDirectoryAndFiles(const std::wstring& path)
+    {
+        bool success = true;
+        for (auto& file : ListFiles(path))
+        {
+            success = DeleteFileIfPresent(path + c_pathSeparator + file) && success;
+        }
+
+        return RemoveEmptyDirectory(path) && success;
+    }
+
+    void AppendUInt32(GameSaveSample::BlobData& data, uint32_t value)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            data.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    void AppendUInt64(GameSaveSample::BlobData& data, uint64_t value)
+    {
+        AppendUInt32(data, static_cast<uint32_t>(value));
+        AppendUInt32(data, static_cast<uint32_t>(value >> 32));
+    }
+
+    void AppendName(GameSaveSample::BlobData& data, const std::wstring& name)
+    {
+        AppendUInt32(data, static_cast<uint32_t>(name.length()));
+        for (auto character : name)
+        {
+            AppendUInt32(data, static_cast<uint32_t>(character));
+        }
+    }
+
+    // Reads values from a journal, failing every read after the first one which runs past the end
+    class JournalReader
+    {
+    public:
+        JournalReader(const uint8_t* data, size_t size) : m_current(data), m_end(data + size) {}
+
+        bool ReadUInt32(uint32_t& value)
+        {
+            value = 0;
+            if (m_end - m_current < 4)
+            {
+                m_current = m_end;
+                return false;
+            }
+
+            for (int i = 0; i < 4; ++i)
+            {
+                value |= uint32_t(m_current[i]) << (8 * i);
+            }
+            m_current += 4;
+            return true;
+        }
+
+        bool ReadUInt64(uint64_t& value)
+        {
+            uint32_t low, high;
+            bool success = ReadUInt32(low) && ReadUInt32(high);
+            value = success ? (uint64_t(high) << 32) | low : 0;
+            return success;
+        }
+
+        bool ReadName(std::wstring& name)
+        {
+            uint32_t length;
+            if (!ReadUInt32(length) || length == 0 || length > c_maxJournalNameLength)
+            {
+                return false;
+            }
+
+            name.clear();
+            for (uint32_t i = 0; i < length; ++i)
+            {
+                uint32_t character;
+                if (!ReadUInt32(character))
+                {
+                    return false;
+                }
+                name.push_back(static_cast<wchar_t>(character));
+            }
+
+            return true;
+        }
+
+    private:
+        const uint8_t*  m_current;
+        const uint8_t*  m_end;
+    };
+}
+
+using namespace GameSaveSample;
+
+bool MemoryBlobStore::Get(const std::wstring& containerName, const std::vector<std::wstring>& blobNames, BlobMap& blobs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto container = m_containers.find(containerName);
+    if (container == m_containers.end())
+    {
+        return false;
+    }
+
+    BlobMap result;
+    for (auto& blobName : blobNames)
+    {
+        auto blob = container->second.find(blobName);
+        if (blob == container->second.end())
+        {
+            return false;
+        }
+
+        result[blobName] = blob->second;
+    }
+
+    blobs.swap(result);
+    return true;
+}
+
+bool MemoryBlobStore::SubmitUpdates(const std::wstring& containerName, const BlobMap& updates, const std::vector<std::wstring>& deletes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto& container = m_containers[containerName];
+    for (auto& blobName : deletes)
+    {
+        container.erase(blobName);
+    }
+
+    for (auto& update : updates)
+    {
+        container[update.first] = update.second;
+    }
+
+    CountUpdates(updates);
+    return true;
+}
+
+std::vector<std::wstring> MemoryBlobStore::GetBlobNames(const std::wstring& containerName)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::vector<std::wstring> blobNames;
+
+    auto container = m_containers.find(containerName);
+    if (container != m_containers.end())
+    {
+        for (auto& blob : container->second)
+        {
+            blobNames.push_back(blob.first);
+        }
+    }
+
+    return blobNames;
+}
+
+bool MemoryBlobStore::DeleteContainer(const std::wstring& containerName)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_containers.erase(containerName) > 0;
+}
+
+FileBlobStore::FileBlobStore(const std::wstring& rootPath) :
+    m_rootPath(rootPath)
+{
+    if (!m_rootPath.empty() && m_rootPath.back() != c_pathSeparator && m_rootPath.back() != L'\\')
+    {
+        m_rootPath += c_pathSeparator;
+    }
+}
+
+bool FileBlobStore::Get(const std::wstring& containerName, const std::vector<std::wstring>& blobNames, BlobMap& blobs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    BlobMap result;
+    for (auto& blobName : blobNames)
+    {
+        if (!ReadFileContents(GetBlobPath(containerName, blobName), result[blobName]))
+        {
+            return false;
+        }
+    }
+
+    blobs.swap(result);
+    return true;
+}
+
+bool FileBlobStore::SubmitUpdates(const std::wstring& containerName, const BlobMap& updates, const std::vector<std::wstring>& deletes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!CreateDirectoryIfMissing(GetContainerPath(containerName)))
+    {
+        return false;
+    }
+
+    for (auto& blobName : deletes)
+    {
+        if (!DeleteFileIfPresent(GetBlobPath(containerName, blobName)))
+        {
+            return false;
+        }
+    }
+
+    for (auto& update : updates)
+    {
+        auto blobPath = GetBlobPath(containerName, update.first);
+        auto tempPath = blobPath + c_tempSuffix;
+
+        if (!WriteFileContents(tempPath, update.second) || !RenameOverFile(tempPath, blobPath))
+        {
+            DeleteFileIfPresent(tempPath);
+            return false;
+        }
+    }
+
+    CountUpdates(updates);
+    return true;
+}
+
+std::vector<std::wstring> FileBlobStore::GetBlobNames(const std::wstring& containerName)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto files = ListFiles(GetContainerPath(containerName));
+    files.erase(std::remove_if(files.begin(), files.end(), IsTempFile), files.end());
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+bool FileBlobStore::DeleteContainer(const std::wstring& containerName)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto containerPath = GetContainerPath(containerName);
+    for (auto& file : ListFiles(containerPath))
+    {
+        if (!DeleteFileIfPresent(containerPath + c_pathSeparator + file))
+        {
+            return false;
+        }
+    }
+
+    return RemoveEmptyDirectory(containerPath);
+}
+
+std::wstring FileBlobStore::GetContainerPath(const std::wstring& containerName) const
+{
+    return m_rootPath + containerName;
+}
+
+std::wstring FileBlobStore::GetBlobPath(const std::wstring& containerName, const std::wstring& blobName) const
+{
+    return GetContainerPath(containerName) + c_pathSeparator + blobName;
+}
+
+JournaledBlobStore::JournaledBlobStore(const std::wstring& rootPath, int64_t quotaInBytes) :
+    m_rootPath(rootPath),
+    m_quotaInBytes(quotaInBytes),
+    m_usedBytes(0)
+{
+    if (!m_rootPath.empty() && m_rootPath.back() != c_pathSeparator && m_rootPath.back() != L'\\')
+    {
+        m_rootPath += c_pathSeparator;
+    }
+
+    CreateDirectoryIfMissing(m_rootPath.substr(0, m_rootPath.length() - 1));
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& directory : ListDirectories(m_rootPath))
+    {
+        if (HasSuffix(directory, c_deletedSuffix))
+        {
+            // the container was deleted, but not all of its files were
+            RemoveDirectoryAndFiles(m_rootPath + directory);
+        }
+        else if (IsValidContainerName(directory) && !Recover(directory))
+        {
+            m_containersToRecover.insert(directory);
+        }
+    }
+}
+
+bool JournaledBlobStore::Get(const std::wstring& containerName, const std::vector<std::wstring>& blobNames, BlobMap& blobs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!IsValidContainerName(containerName) || !RecoverIfNeeded(containerName))
+    {
+        return false;
+    }
+
+    BlobMap result;
+    for (auto& blobName : blobNames)
+    {
+        if (!IsValidBlobName(blobName) || !ReadFileContents(GetBlobPath(containerName, blobName), result[blobName]))
+        {
+            return false;
+        }
+    }
+
+    blobs.swap(result);
+    return true;
+}
+
+bool JournaledBlobStore::SubmitUpdates(const std::wstring& containerName, const BlobMap& updates, const std::vector<std::wstring>& deletes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!IsValidContainerName(containerName)
+        || !std::all_of(deletes.begin(), deletes.end(), IsValidBlobName)
+        || !std::all_of(updates.begin(), updates.end(), [](const BlobMap::value_type& update) { return IsValidBlobName(update.first); })
+        || !RecoverIfNeeded(containerName))
+    {
+        return false;
+    }
+
+    // a blob which is deleted and updated in the same call is just updated, so that applying the journal again can't delete it
+    Journal journal;
+    BlobSizes blobSizes;
+    auto container = m_containers.find(containerName);
+    if (container != m_containers.end())
+    {
+        blobSizes = container->second;
+    }
+
+    for (auto& blobName : deletes)
+    {
+        if (updates.find(blobName) == updates.end() && blobSizes.erase(blobName) > 0)
+        {
+            journal.m_deletes.push_back(blobName);
+        }
+    }
+
+    for (auto& update : updates)
+    {
+        JournalEntry entry = { update.first, update.second.size(), HashChunk(update.second.data(), update.second.size()) };
+        journal.m_updates.push_back(entry);
+        blobSizes[update.first] = update.second.size();
+    }
+
+    int64_t usedBytes = m_usedBytes;
+    if (container != m_containers.end())
+    {
+        for (auto& blobSize : container->second)
+        {
+            usedBytes -= int64_t(blobSize.second);
+        }
+    }
+    for (auto& blobSize : blobSizes)
+    {
+        usedBytes += int64_t(blobSize.second);
+    }
+
+    // an update which doesn't add to the size of the store is allowed even if the store is over its quota
+    if (usedBytes > m_quotaInBytes && usedBytes > m_usedBytes)
+    {
+        return false;
+    }
+
+    auto containerPath = GetContainerPath(containerName);
+    if (container == m_containers.end())
+    {
+        if (!CreateDirectoryIfMissing(containerPath) || !SyncDirectory(m_rootPath))
+        {
+            return false;
+        }
+
+        container = m_containers.insert(std::make_pair(containerName, BlobSizes())).first;
+    }
+
+    if (journal.m_updates.empty() && journal.m_deletes.empty())
+    {
+        return true;
+    }
+
+    // stage the updated blobs
+    for (auto& update : updates)
+    {
+        auto stagingPath = GetBlobPath(containerName, update.first) + c_tempSuffix;
+        if (InjectFault(JournalStep::WriteBlob))
+        {
+            WriteFileContents(stagingPath, update.second, false, update.second.size() / 2);
+            return StopUpdate(containerName);
+        }
+
+        if (InjectFault(JournalStep::SyncBlob))
+        {
+            WriteFileContents(stagingPath, update.second);
+            return StopUpdate(containerName);
+        }
+
+        if (!WriteFileContents(stagingPath, update.second, true))
+        {
+            return StopUpdate(containerName);
+        }
+    }
+
+    // write the journal, and commit the update by renaming it into place
+    auto journalData = SerializeJournal(journal);
+    auto journalPath = GetBlobPath(containerName, c_journalName);
+    auto journalStagingPath = journalPath + c_tempSuffix;
+    if (InjectFault(JournalStep::WriteJournal))
+    {
+        WriteFileContents(journalStagingPath, journalData, false, journalData.size() / 2);
+        return StopUpdate(containerName);
+    }
+
+    if (InjectFault(JournalStep::SyncJournal))
+    {
+        WriteFileContents(journalStagingPath, journalData);
+        return StopUpdate(containerName);
+    }
+
+    if (!WriteFileContents(journalStagingPath, journalData, true) || InjectFault(JournalStep::CommitJournal))
+    {
+        return StopUpdate(containerName);
+    }
+
+    if (!RenameOverFile(journalStagingPath, journalPath) || !SyncDirectory(containerPath))
+    {
+        return StopUpdate(containerName);
+    }
+
+    // the update is committed; from here on a stopped update is completed by recovery
+    if (!ApplyJournal(containerName, journal))
+    {
+        return StopUpdate(containerName);
+    }
+
+    m_usedBytes = usedBytes;
+    container->second.swap(blobSizes);
+
+    CountUpdates(updates);
+    return true;
+}
+
+std::vector<std::wstring> JournaledBlobStore::GetBlobNames(const std::wstring& containerName)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::vector<std::wstring> blobNames;
+
+    if (IsValidContainerName(containerName) && RecoverIfNeeded(containerName))
+    {
+        auto container = m_containers.find(containerName);
+        if (container != m_containers.end())
+        {
+            for (auto& blobSize : container->second)
+            {
+                blobNames.push_back(blobSize.first);
+            }
+        }
+    }
+
+    return blobNames;
+}
+
+bool JournaledBlobStore::DeleteContainer(const std::wstring& containerName)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!IsValidContainerName(containerName))
+    {
+        return false;
+    }
+
+    // the container is renamed out of the way in one step, so it is never seen half deleted; a container left over
+    // from a delete which stopped part way through is removed first, so the rename can't fail because of it
+    auto containerPath = GetContainerPath(containerName);
+    auto deletedPath = containerPath + c_deletedSuffix;
+    RemoveDirectoryAndFiles(deletedPath);
+
+    if (InjectFault(JournalStep::DeleteContainer) || !RenameOverFile(containerPath, deletedPath) || !SyncDirectory(m_rootPath))
+    {
+        return false;
+    }
+
+    auto container = m_containers.find(containerName);
+    if (container != m_containers.end())
+    {
+        for (auto& blobSize : container->second)
+        {
+            m_usedBytes -= int64_t(blobSize.second);
+        }
+        m_containers.erase(container);
+    }
+    m_containersToRecover.erase(containerName);
+
+    // if this fails, the files are deleted the next time the store is opened
+    RemoveDirectoryAndFiles(deletedPath);
+    return true;
+}
+
+int64_t JournaledBlobStore::GetRemainingQuotaInBytes()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_quotaInBytes - m_usedBytes;
+}
+
+void JournaledBlobStore::SetFaultInjector(JournalFaultInjector faultInjector)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_faultInjector = faultInjector;
+}
+
+bool JournaledBlobStore::Recover(const std::wstring& containerName)
+{
+    auto containerPath = GetContainerPath(containerName);
+    auto journalPath = GetBlobPath(containerName, c_journalName);
+
+    // a journal that is present was committed, since it is only renamed into place once it is complete and flushed
+    BlobData journalData;
+    if (ReadFileContents(journalPath, journalData))
+    {
+        Journal journal;
+        if (!ParseJournal(journalData, journal) || !ApplyJournal(containerName, journal))
+        {
+            return false;
+        }
+    }
+
+    // anything still staged belongs to an update which wasn't committed
+    BlobSizes blobSizes;
+    for (auto& file : ListFiles(containerPath))
+    {
+        if (IsTempFile(file))
+        {
+            if (!DeleteFileIfPresent(containerPath + c_pathSeparator + file))
+            {
+                return false;
+            }
+        }
+        else if (IsValidBlobName(file))
+        {
+            if (!GetFileContentsSize(GetBlobPath(containerName, file), blobSizes[file]))
+            {
+                return false;
+            }
+        }
+    }
+
+    auto& container = m_containers[containerName];
+    for (auto& blobSize : container)
+    {
+        m_usedBytes -= int64_t(blobSize.second);
+    }
+    for (auto& blobSize : blobSizes)
+    {
+        m_usedBytes += int64_t(blobSize.second);
+    }
+    container.swap(blobSizes);
+
+    return true;
+}
+
+bool JournaledBlobStore::RecoverIfNeeded(const std::wstring& containerName)
+{
+    if (m_containersToRecover.find(containerName) == m_containersToRecover.end())
+    {
+        return true;
+    }
+
+    if (!Recover(containerName))
+    {
+        return false;
+    }
+
+    m_containersToRecover.erase(containerName);
+    return true;
+}
+
+bool JournaledBlobStore::ApplyJournal(const std::wstring& containerName, const Journal& journal)
+{
+    for (auto& entry : journal.m_updates)
+    {
+        if (InjectFault(JournalStep::ApplyUpdate))
+        {
+            return false;
+        }
+
+        auto blobPath = GetBlobPath(containerName, entry.m_blobName);
+        auto stagingPath = blobPath + c_tempSuffix;
+        if (!RenameOverFile(stagingPath, blobPath))
+        {
+            // the staging file was renamed when the journal was applied before, so the blob must be the one staged
+            BlobData blob;
+            if (!ReadFileContents(blobPath, blob) || blob.size() != entry.m_size || HashChunk(blob.data(), blob.size()) != entry.m_hash)
+            {
+                return false;
+            }
+        }
+    }
+
+    for (auto& blobName : journal.m_deletes)
+    {
+        if (InjectFault(JournalStep::ApplyDelete) || !DeleteFileIfPresent(GetBlobPath(containerName, blobName)))
+        {
+            return false;
+        }
+    }
+
+    auto containerPath = GetContainerPath(containerName);
+    if (!SyncDirectory(containerPath) || InjectFault(JournalStep::RemoveJournal))
+    {
+        return false;
+    }
+
+    return DeleteFileIfPresent(GetBlobPath(containerName, c_journalName)) && SyncDirectory(containerPath);
+}
+
+BlobData JournaledBlobStore::SerializeJournal(const Journal& journal)
+{
+    BlobData journalData;
+    AppendUInt32(journalData, c_journalMagic);
+    AppendUInt32(journalData, c_journalVersion); // and the reserved 16 bits
+    AppendUInt32(journalData, static_cast<uint32_t>(journal.m_updates.size()));
+    AppendUInt32(journalData, static_cast<uint32_t>(journal.m_deletes.size()));
+    for (auto& entry : journal.m_updates)
+    {
+        AppendName(journalData, entry.m_blobName);
+        AppendUInt64(journalData, entry.m_size);
+        AppendUInt64(journalData, entry.m_hash);
+    }
+    for (auto& blobName : journal.m_deletes)
+    {
+        AppendName(journalData, blobName);
+    }
+
+    AppendUInt64(journalData, HashChunk(journalData.data(), journalData.size()));
+    return journalData;
+}
+
+bool JournaledBlobStore::ParseJournal(const BlobData& journalData, Journal& journal)
+{
+    if (journalData.size() < c_journalHeaderSize + sizeof(uint64_t))
+    {
+        return false;
+    }
+
+    size_t bodySize = journalData.size() - sizeof(uint64_t);
+    uint64_t hash;
+    if (!JournalReader(journalData.data() + bodySize, sizeof(uint64_t)).ReadUInt64(hash) || hash != HashChunk(journalData.data(), bodySize))
+    {
+        return false;
+    }
+
+    JournalReader reader(journalData.data(), bodySize);
+    uint32_t magic, version, updateCount, deleteCount;
+    if (!reader.ReadUInt32(magic) || magic != c_journalMagic
+        || !reader.ReadUInt32(version) || version != c_journalVersion
+        || !reader.ReadUInt32(updateCount) || !reader.ReadUInt32(deleteCount))
+    {
+        return false;
+    }
+
+    journal.m_updates.clear();
+    journal.m_deletes.clear();
+
+    for (uint32_t i = 0; i < updateCount; ++i)
+    {
+        JournalEntry entry;
+        if (!reader.ReadName(entry.m_blobName) || !reader.ReadUInt64(entry.m_size) || !reader.ReadUInt64(entry.m_hash) || !IsValidBlobName(entry.m_blobName))
+        {
+            return false;
+        }
+        journal.m_updates.push_back(entry);
+    }
+
+    for (uint32_t i = 0; i < deleteCount; ++i)
+    {
+        std::wstring blobName;
+        if (!reader.ReadName(blobName) || !IsValidBlobName(blobName))
+        {
+            return false;
+        }
+        journal.m_deletes.push_back(blobName);
+    }
+
+    return true;
+}
+
+bool JournaledBlobStore::StopUpdate(const std::wstring& containerName)
+{
+    m_containersToRecover.insert(containerName);
+    return false;
+}
+
+bool JournaledBlobStore::InjectFault(JournalStep step)
+{
+    return m_faultInjector && m_faultInjector(step);
+}
+
+bool JournaledBlobStore::IsValidContainerName(const std::wstring& containerName)
+{
+    return !containerName.empty() && containerName[0] != L'.' && !HasSuffix(containerName, c_deletedSuffix)
+        && containerName.find_first_of(L"/\\") == std::wstring::npos;
+}
+
+bool JournaledBlobStore::IsValidBlobName(const std::wstring& blobName)
+{
+    return !blobName.empty() && blobName[0] != L'.' && !IsTempFile(blobName)
+        && blobName.find_first_of(L"/\\") == std::wstring::npos;
+}
+
+std::wstring JournaledBlobStore::GetContainerPath(const std::wstring& containerName) const
+{
+    return m_rootPath + containerName;
+}
+
+std::wstring JournaledBlobStore::GetBlobPath(const std::wstring& containerName, const std::wstring& blobName) const
+{
+    return GetContainerPath(containerName) + c_pathSeparator + blobName;
+}
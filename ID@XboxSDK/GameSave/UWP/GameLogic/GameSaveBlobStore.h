@@ -0,0 +1,196 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace GameSaveSample
+{
+    typedef std::vector<uint8_t> BlobData;
+    typedef std::map<std::wstring, BlobData> BlobMap;
+
+    // Platform-neutral storage for named blobs grouped into containers, mirroring the container API used
+    // by GameSave (GetAsync and SubmitUpdatesAsync) without any WinRT types. Used to exercise the save
+    // format (chunking, manifests) off the console.
+    class IGameSaveBlobStore
+    {
+    public:
+        virtual ~IGameSaveBlobStore() {}
+
+        // Reads the named blobs from a container. Fails if the container or any of the blobs is missing.
+        virtual bool Get(const std::wstring& containerName, const std::vector<std::wstring>& blobNames, BlobMap& blobs) = 0;
+
+        // Writes updates and removes deletes from a container, creating it if needed. Deleting a blob which
+        // doesn't exist is not an error.
+        virtual bool SubmitUpdates(const std::wstring& containerName, const BlobMap& updates, const std::vector<std::wstring>& deletes) = 0;
+
+        // Names of the blobs in a container, or an empty list if it doesn't exist.
+        virtual std::vector<std::wstring> GetBlobNames(const std::wstring& containerName) = 0;
+
+        virtual bool DeleteContainer(const std::wstring& containerName) = 0;
+
+        // Totals over the lifetime of the store, for measuring how much each save writes.
+        uint64_t GetBytesWritten() const { return m_bytesWritten; }
+        uint64_t GetBlobsWritten() const { return m_blobsWritten; }
+        void ResetCounters() { m_bytesWritten = 0; m_blobsWritten = 0; }
+
+    protected:
+        IGameSaveBlobStore() : m_bytesWritten(0), m_blobsWritten(0) {}
+
+        void CountUpdates(const BlobMap& updates)
+        {
+            for (auto& update : updates)
+            {
+                m_bytesWritten += update.second.size();
+                ++m_blobsWritten;
+            }
+        }
+
+        std::atomic<uint64_t>   m_bytesWritten;
+        std::atomic<uint64_t>   m_blobsWritten;
+    };
+
+    class MemoryBlobStore : public IGameSaveBlobStore
+    {
+    public:
+        bool Get(const std::wstring& containerName, const std::vector<std::wstring>& blobNames, BlobMap& blobs) override;
+        bool SubmitUpdates(const std::wstring& containerName, const BlobMap& updates, const std::vector<std::wstring>& deletes) override;
+        std::vector<std::wstring> GetBlobNames(const std::wstring& containerName) override;
+        bool DeleteContainer(const std::wstring& containerName) override;
+
+    private:
+        std::mutex                          m_mutex;
+        std::map<std::wstring, BlobMap>     m_containers;
+    };
+
+    // Stores each container as a directory under rootPath, and each blob as a file in it. Blobs are written
+    // to a temporary file and renamed over the previous version, so a blob is never left half written, but
+    // an update to several blobs is not atomic.
+    class FileBlobStore : public IGameSaveBlobStore
+    {
+    public:
+        explicit FileBlobStore(const std::wstring& rootPath);
+
+        bool Get(const std::wstring& containerName, const std::vector<std::wstring>& blobNames, BlobMap& blobs) override;
+        bool SubmitUpdates(const std::wstring& containerName, const BlobMap& updates, const std::vector<std::wstring>& deletes) override;
+        std::vector<std::wstring> GetBlobNames(const std::wstring& containerName) override;
+        bool DeleteContainer(const std::wstring& containerName) override;
+
+    private:
+        std::wstring GetContainerPath(const std::wstring& containerName) const;
+        std::wstring GetBlobPath(const std::wstring& containerName, const std::wstring& blobName) const;
+
+        std::mutex      m_mutex;
+        std::wstring    m_rootPath;
+    };
+
+    // The steps of a JournaledBlobStore update, in order, at which a fault can be injected
+    enum class JournalStep
+    {
+        WriteBlob,          // writing an updated blob to its staging file
+        SyncBlob,           // flushing a staging file to the disk
+        WriteJournal,       // writing the journal which lists the update
+        SyncJournal,        // flushing the journal to the disk
+        CommitJournal,      // renaming the journal into place, which commits the update
+        ApplyUpdate,        // renaming a staging file over the blob
+        ApplyDelete,        // deleting a blob
+        RemoveJournal,      // deleting the journal once the update is applied
+        DeleteContainer,    // renaming a container out of the way before its files are deleted
+    };
+
+    // Returns true to stop an update at step as if the process had stopped there; a fault while writing a file
+    // leaves it half written.
+    typedef std::function<bool(JournalStep step)> JournalFaultInjector;
+
+    // Stores containers as FileBlobStore does, but each SubmitUpdates is atomic and durable: the updated blobs are
+    // written to staging files and flushed, then a journal listing the update is written, flushed and renamed into
+    // place, which commits it. The staging files are then renamed over the blobs, and the journal deleted.
+    //
+    // An update which stops part way through (the process stops, or a write fails) is recovered the next time the
+    // container is used, or when the store is next opened: if its journal was committed, the update is completed,
+    // otherwise its staging files are deleted. Either way the container holds either all of the update or none of it.
+    //
+    // Like the platform's save storage, the total size of the blobs is limited by a quota; an update which would
+    // take the store over its quota fails without changing anything.
+    class JournaledBlobStore : public IGameSaveBlobStore
+    {
+    public:
+        // Recovers any update left unfinished in the containers under rootPath, which is created if needed
+        JournaledBlobStore(const std::wstring& rootPath, int64_t quotaInBytes);
+
+        bool Get(const std::wstring& containerName, const std::vector<std::wstring>& blobNames, BlobMap& blobs) override;
+
+        // Returns false if the update would exceed the quota, or didn't complete. An update which stops after it is
+        // committed still returns false, and is completed when the container is next used.
+        bool SubmitUpdates(const std::wstring& containerName, const BlobMap& updates, const std::vector<std::wstring>& deletes) override;
+
+        std::vector<std::wstring> GetBlobNames(const std::wstring& containerName) override;
+        bool DeleteContainer(const std::wstring& containerName) override;
+
+        // The quota less the size of every blob in the store (may be negative if the quota was lowered)
+        int64_t GetRemainingQuotaInBytes();
+
+        // For testing crash consistency: the injector is called before each step of every update that follows
+        void SetFaultInjector(JournalFaultInjector faultInjector);
+
+    private:
+        struct JournalEntry
+        {
+            std::wstring    m_blobName;
+            uint64_t        m_size;
+            uint64_t        m_hash;
+        };
+
+        struct Journal
+        {
+            std::vector<JournalEntry>   m_updates;
+            std::vector<std::wstring>   m_deletes;
+        };
+
+        // Completes or discards an unfinished update, then reloads the blob sizes of the container
+        bool Recover(const std::wstring& containerName);
+        bool RecoverIfNeeded(const std::wstring& containerName);
+
+        // Renames the staged blobs over the blobs and deletes the deleted ones, then deletes the journal. Steps which
+        // were done before are skipped, so a journal can be applied any number of times.
+        bool ApplyJournal(const std::wstring& containerName, const Journal& journal);
+
+        static BlobData SerializeJournal(const Journal& journal);
+
+        // Checks the journal's hash and names; returns false if it is not valid
+        static bool ParseJournal(const BlobData& journalData, Journal& journal);
+
+        // Marks an update which stopped part way through to be recovered, and returns false
+        bool StopUpdate(const std::wstring& containerName);
+
+        bool InjectFault(JournalStep step);
+
+        static bool IsValidContainerName(const std::wstring& containerName);
+        static bool IsValidBlobName(const std::wstring& blobName);
+
+        std::wstring GetContainerPath(const std::wstring& containerName) const;
+        std::wstring GetBlobPath(const std::wstring& containerName, const std::wstring& blobName) const;
+
+        typedef std::map<std::wstring, uint64_t> BlobSizes;
+
+        std::mutex                              m_mutex;
+        std::wstring                            m_rootPath;
+        int64_t                                 m_quotaInBytes;
+        int64_t                                 m_usedBytes;            // Total size of the committed blobs
+        std::map<std::wstring, BlobSizes>       m_containers;           // Sizes of the committed blobs, by container
+        std::set<std::wstring>                  m_containersToRecover;  // Containers with an update which stopped part way through
+        JournalFaultInjector                    m_faultInjector;
+    };
+}
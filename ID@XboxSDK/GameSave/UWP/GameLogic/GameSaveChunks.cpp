@@ -0,0 +1,352 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#include "pch.h"
+#include "GameSaveChunks.h"
+#include <algorithm>
+#include <string.h>
+
+namespace
+{
+    const uint32_t  c_manifestMagic = 0x4D435347; // "GSCM"
+    const uint32_t  c_rawChunksVersion = 1;     // Written before chunks were compressed
+    const uint32_t  c_manifestVersion = 2;
+    const uint32_t  c_manifestHeaderSize = 6 * sizeof(uint32_t);
+
+    // The manifest is stored little-endian regardless of the platform writing it
+    void WriteUInt32(uint8_t*& dest, uint32_t value)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            *dest++ = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
+
+    void WriteUInt64(uint8_t*& dest, uint64_t value)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            *dest++ = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
+
+    uint32_t ReadUInt32(const uint8_t*& src)
+    {
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            value |= uint32_t(*src++) << (8 * i);
+        }
+        return value;
+    }
+
+    uint64_t ReadUInt64(const uint8_t*& src)
+    {
+        uint64_t value = 0;
+        for (int i = 0; i < 8; ++i)
+        {
+            value |= uint64_t(*src++) << (8 * i);
+        }
+        return value;
+    }
+
+    uint32_t CountChunks(uint32_t dataSize, uint32_t chunkSize)
+    {
+        return dataSize / chunkSize + ((dataSize % chunkSize) ? 1 : 0);
+    }
+}
+
+namespace GameSaveSample
+{
+    const wchar_t* const c_manifestBlobName = L"manifest";
+    const wchar_t* const c_legacyDataBlobName = L"data";
+    const wchar_t* const c_paddingBlobName = L"padding";
+
+    uint64_t HashChunk(const void* data, size_t size)
+    {
+        auto bytes = static_cast<const uint8_t*>(data);
+
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    std::wstring GetChunkBlobName(uint32_t chunk)
+    {
+        return L"chunk" + std::to_wstring(chunk);
+    }
+
+    void GameSaveManifest::SetLayout(uint32_t dataSize, uint32_t chunkSize)
+    {
+        m_dataSize = dataSize;
+        m_chunkSize = std::max(chunkSize, 1u);
+        m_chunkHashes.assign(CountChunks(m_dataSize, m_chunkSize), 0);
+    }
+
+    uint32_t GameSaveManifest::GetChunkLength(uint32_t chunk) const
+    {
+        uint32_t offset = GetChunkOffset(chunk);
+        return (offset < m_dataSize) ? std::min(m_chunkSize, m_dataSize - offset) : 0;
+    }
+
+    uint32_t GameSaveManifest::GetSerializedSize(uint32_t chunkCount)
+    {
+        return c_manifestHeaderSize + chunkCount * sizeof(uint64_t);
+    }
+
+    void GameSaveManifest::Serialize(uint8_t* dest) const
+    {
+        WriteUInt32(dest, c_manifestMagic);
+        WriteUInt32(dest, m_isEncoded ? c_manifestVersion : c_rawChunksVersion);
+        WriteUInt32(dest, m_dataSize);
+        WriteUInt32(dest, m_chunkSize);
+        WriteUInt32(dest, m_paddingSize);
+        WriteUInt32(dest, GetChunkCount());
+
+        for (auto hash : m_chunkHashes)
+        {
+            WriteUInt64(dest, hash);
+        }
+    }
+
+    bool GameSaveManifest::Parse(const uint8_t* data, size_t size)
+    {
+        if (data == nullptr || size < c_manifestHeaderSize)
+        {
+            return false;
+        }
+
+        const uint8_t* src = data;
+        uint32_t magic = ReadUInt32(src);
+        uint32_t version = ReadUInt32(src);
+        uint32_t dataSize = ReadUInt32(src);
+        uint32_t chunkSize = ReadUInt32(src);
+        uint32_t paddingSize = ReadUInt32(src);
+        uint32_t chunkCount = ReadUInt32(src);
+
+        if (magic != c_manifestMagic
+            || (version != c_manifestVersion && version != c_rawChunksVersion)
+            || chunkSize == 0
+            || chunkCount != CountChunks(dataSize, chunkSize)
+            || size != c_manifestHeaderSize + uint64_t(chunkCount) * sizeof(uint64_t))
+        {
+            return false;
+        }
+
+        m_dataSize = dataSize;
+        m_chunkSize = chunkSize;
+        m_paddingSize = paddingSize;
+        m_isEncoded = (version == c_manifestVersion);
+        m_chunkHashes.resize(chunkCount);
+        for (auto& hash : m_chunkHashes)
+        {
+            hash = ReadUInt64(src);
+        }
+
+        return true;
+    }
+
+    void BuildManifest(
+        const void* data,
+        uint32_t dataSize,
+        uint32_t chunkSize,
+        uint32_t paddingSize,
+        const GameSaveManifest& previous,
+        GameSaveManifest& manifest,
+        std::vector<uint32_t>& changedChunks)
+    {
+        auto bytes = static_cast<const uint8_t*>(data);
+
+        manifest.SetLayout(dataSize, chunkSize);
+        manifest.m_paddingSize = paddingSize;
+        manifest.m_isEncoded = true;
+
+        bool sameLayout = !previous.IsEmpty()
+            && previous.m_isEncoded
+            && previous.m_dataSize == manifest.m_dataSize
+            && previous.m_chunkSize == manifest.m_chunkSize;
+
+        changedChunks.clear();
+        for (uint32_t chunk = 0; chunk < manifest.GetChunkCount(); ++chunk)
+        {
+            uint64_t hash = HashChunk(bytes + manifest.GetChunkOffset(chunk), manifest.GetChunkLength(chunk));
+            manifest.m_chunkHashes[chunk] = hash;
+
+            if (!sameLayout || previous.m_chunkHashes[chunk] != hash)
+            {
+                changedChunks.push_back(chunk);
+            }
+        }
+    }
+
+    void GetStaleBlobNames(const GameSaveManifest& previous, const GameSaveManifest& manifest, std::vector<std::wstring>& blobNames)
+    {
+        blobNames.clear();
+
+        if (previous.IsEmpty())
+        {
+            blobNames.push_back(c_legacyDataBlobName);
+        }
+
+        for (uint32_t chunk = manifest.GetChunkCount(); chunk < previous.GetChunkCount(); ++chunk)
+        {
+            blobNames.push_back(GetChunkBlobName(chunk));
+        }
+
+        // the debug padding blob is left behind otherwise when the minimum save size is turned off
+        if (manifest.m_paddingSize == 0 && (previous.IsEmpty() || previous.m_paddingSize != 0))
+        {
+            blobNames.push_back(c_paddingBlobName);
+        }
+    }
+
+    bool VerifyChunks(const GameSaveManifest& manifest, const void* data, size_t dataSize)
+    {
+        if (manifest.IsEmpty() || dataSize != manifest.m_dataSize)
+        {
+            return false;
+        }
+
+        auto bytes = static_cast<const uint8_t*>(data);
+        for (uint32_t chunk = 0; chunk < manifest.GetChunkCount(); ++chunk)
+        {
+            if (HashChunk(bytes + manifest.GetChunkOffset(chunk), manifest.GetChunkLength(chunk)) != manifest.m_chunkHashes[chunk])
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool CopyChunk(const GameSaveManifest& manifest, uint32_t chunk, const uint8_t* blob, size_t blobSize, void* data)
+    {
+        auto chunkData = static_cast<uint8_t*>(data) + manifest.GetChunkOffset(chunk);
+        uint32_t chunkLength = manifest.GetChunkLength(chunk);
+
+        if (manifest.m_isEncoded)
+        {
+            return DecodeBlob(blob, blobSize, chunkData, chunkLength);
+        }
+
+        if (blobSize != chunkLength)
+        {
+            return false;
+        }
+
+        if (chunkLength > 0)
+        {
+            memcpy(chunkData, blob, chunkLength);
+        }
+        return true;
+    }
+
+    bool SaveChunks(
+        IGameSaveBlobStore& store,
+        const std::wstring& containerName,
+        const void* data,
+        uint32_t dataSize,
+        uint32_t chunkSize,
+        GameSaveManifest& lastSaved,
+        BlobCodec codec)
+    {
+        auto bytes = static_cast<const uint8_t*>(data);
+
+        GameSaveManifest manifest;
+        std::vector<uint32_t> changedChunks;
+        BuildManifest(data, dataSize, chunkSize, 0, lastSaved, manifest, changedChunks);
+
+        BlobMap updates;
+        for (auto chunk : changedChunks)
+        {
+            EncodeBlob(bytes + manifest.GetChunkOffset(chunk), manifest.GetChunkLength(chunk), codec, updates[GetChunkBlobName(chunk)]);
+        }
+
+        auto& manifestData = updates[c_manifestBlobName];
+        manifestData.resize(GameSaveManifest::GetSerializedSize(manifest.GetChunkCount()));
+        manifest.Serialize(manifestData.data());
+
+        std::vector<std::wstring> deletes;
+        GetStaleBlobNames(lastSaved, manifest, deletes);
+
+        if (!store.SubmitUpdates(containerName, updates, deletes))
+        {
+            return false;
+        }
+
+        lastSaved = std::move(manifest);
+        return true;
+    }
+
+    bool LoadChunks(
+        IGameSaveBlobStore& store,
+        const std::wstring& containerName,
+        void* data,
+        uint32_t dataSize,
+        GameSaveManifest& manifest)
+    {
+        BlobMap blobs;
+        if (!store.Get(containerName, std::vector<std::wstring>(1, c_manifestBlobName), blobs))
+        {
+            if (!store.Get(containerName, std::vector<std::wstring>(1, c_legacyDataBlobName), blobs)
+                || blobs[c_legacyDataBlobName].size() != dataSize)
+            {
+                return false;
+            }
+
+            memcpy(data, blobs[c_legacyDataBlobName].data(), dataSize);
+            manifest.Reset();
+            return true;
+        }
+
+        auto& manifestData = blobs[c_manifestBlobName];
+        GameSaveManifest loaded;
+        if (!loaded.Parse(manifestData.data(), manifestData.size()) || loaded.m_dataSize != dataSize)
+        {
+            return false;
+        }
+
+        std::vector<std::wstring> chunkNames;
+        for (uint32_t chunk = 0; chunk < loaded.GetChunkCount(); ++chunk)
+        {
+            chunkNames.push_back(GetChunkBlobName(chunk));
+        }
+
+        if (!store.Get(containerName, chunkNames, blobs))
+        {
+            return false;
+        }
+
+        // Assemble the chunks separately so data is untouched if any of them is bad
+        std::vector<uint8_t> assembled(dataSize);
+        for (uint32_t chunk = 0; chunk < loaded.GetChunkCount(); ++chunk)
+        {
+            auto& chunkData = blobs[chunkNames[chunk]];
+            if (!CopyChunk(loaded, chunk, chunkData.data(), chunkData.size(), assembled.data()))
+            {
+                return false;
+            }
+        }
+
+        if (!VerifyChunks(loaded, assembled.data(), assembled.size()))
+        {
+            return false;
+        }
+
+        if (dataSize > 0)
+        {
+            memcpy(data, assembled.data(), dataSize);
+        }
+
+        manifest = std::move(loaded);
+        return true;
+    }
+}
@@ -0,0 +1,119 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#pragma once
+
+#include "GameSaveBlobStore.h"
+#include "GameSaveCodec.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Game save data is split into fixed-size chunks, each stored as its own blob ("chunk0", "chunk1", ...), plus a
+// small "manifest" blob holding the 64-bit hash of every chunk. A save only submits the chunks whose hash differs
+// from the manifest that was last read or written, so a small change to a large save writes one chunk and the
+// manifest rather than the whole save. The manifest is always submitted in the same update as the chunks it
+// describes, and loads check each chunk against it. Chunks are compressed (see GameSaveCodec.h); the hashes are of
+// the uncompressed data. The manifest itself is not compressed.
+namespace GameSaveSample
+{
+    extern const wchar_t* const c_manifestBlobName;
+    extern const wchar_t* const c_legacyDataBlobName;   // Saves from before chunking store everything in one blob
+    extern const wchar_t* const c_paddingBlobName;
+
+    const uint32_t c_defaultChunkSize = 4 * 1024;
+
+    // 64-bit FNV-1a; used to detect changes, not for security
+    uint64_t HashChunk(const void* data, size_t size);
+
+    std::wstring GetChunkBlobName(uint32_t chunk);
+
+    struct GameSaveManifest
+    {
+        GameSaveManifest() :
+            m_dataSize(0),
+            m_chunkSize(0),
+            m_paddingSize(0),
+            m_isEncoded(false)
+        {}
+
+        void Reset()
+        {
+            m_dataSize = 0;
+            m_chunkSize = 0;
+            m_paddingSize = 0;
+            m_isEncoded = false;
+            m_chunkHashes.clear();
+        }
+
+        // Sets the sizes and chunk count for dataSize bytes split into chunkSize byte chunks, zeroing the hashes
+        void SetLayout(uint32_t dataSize, uint32_t chunkSize);
+
+        // An empty manifest means nothing is known about what is in storage, so the next save writes every chunk
+        bool IsEmpty() const { return m_chunkSize == 0; }
+
+        uint32_t GetChunkCount() const { return static_cast<uint32_t>(m_chunkHashes.size()); }
+        uint32_t GetChunkOffset(uint32_t chunk) const { return chunk * m_chunkSize; }
+        uint32_t GetChunkLength(uint32_t chunk) const;
+
+        static uint32_t GetSerializedSize(uint32_t chunkCount);
+
+        // Writes GetSerializedSize(GetChunkCount()) bytes to dest
+        void Serialize(uint8_t* dest) const;
+
+        // Returns false, leaving the manifest unchanged, if data is not a valid manifest
+        bool Parse(const uint8_t* data, size_t size);
+
+        uint32_t                m_dataSize;
+        uint32_t                m_chunkSize;
+        uint32_t                m_paddingSize;  // Size of the padding blob written with the save, if any (for debugging only)
+        bool                    m_isEncoded;    // The chunks are encoded blobs; saves from before compression store them raw
+        std::vector<uint64_t>   m_chunkHashes;
+    };
+
+    // Builds the manifest for data split into chunkSize byte encoded chunks, and lists the chunks which differ from
+    // previous. Every chunk is listed if previous is empty, splits the data differently or has raw chunks.
+    void BuildManifest(
+        const void* data,
+        uint32_t dataSize,
+        uint32_t chunkSize,
+        uint32_t paddingSize,
+        const GameSaveManifest& previous,
+        GameSaveManifest& manifest,
+        std::vector<uint32_t>& changedChunks);
+
+    // Lists the blobs a save with manifest should delete: chunks previous had beyond the end of the new data, the
+    // padding blob if the new save has none, and the legacy data blob if nothing is known about what is in storage.
+    void GetStaleBlobNames(const GameSaveManifest& previous, const GameSaveManifest& manifest, std::vector<std::wstring>& blobNames);
+
+    // Checks the size of data and the hash of each of its chunks against the manifest
+    bool VerifyChunks(const GameSaveManifest& manifest, const void* data, size_t dataSize);
+
+    // Copies a chunk blob read from storage into data, decoding it if the manifest says it is encoded. data is the
+    // start of the whole save, not of the chunk.
+    bool CopyChunk(const GameSaveManifest& manifest, uint32_t chunk, const uint8_t* blob, size_t blobSize, void* data);
+
+    // Saves data to a container as chunks, submitting the manifest and the chunks which changed since lastSaved.
+    // lastSaved is updated on success; pass an empty manifest to write every chunk.
+    bool SaveChunks(
+        IGameSaveBlobStore& store,
+        const std::wstring& containerName,
+        const void* data,
+        uint32_t dataSize,
+        uint32_t chunkSize,
+        GameSaveManifest& lastSaved,
+        BlobCodec codec = c_defaultBlobCodec);
+
+    // Loads dataSize bytes saved with SaveChunks, falling back to the legacy single blob layout. manifest receives
+    // the manifest that was read, or is reset if the save used the legacy layout.
+    bool LoadChunks(
+        IGameSaveBlobStore& store,
+        const std::wstring& containerName,
+        void* data,
+        uint32_t dataSize,
+        GameSaveManifest& manifest);
+}
@@ -8,23 +8,32 @@
 #pragma once
 
 #include "GameBoard.h"
+#include "GameBoardFormat.h"
 #include "GameSave.h"
+#include "GameSaveMetadataCache.h"
+#include "GameSaveWriteQueue.h"
 #include <DirectXMath.h>
+#include <list>
+#include <map>
 
 #define GAME_BOARD_INDEX_NAME               L"game_board_index"
 #define GAME_BOARD_INDEX_DISPLAY_NAME       L"Game Board Index"
 #define GAME_BOARD_NAME_PREFIX              L"game_board_"
 #define GAME_BOARD_DISPLAY_NAME_PREFIX      L"Game Board "
 
+#define SAVE_COALESCE_WINDOW_MS             500     // saves of a container made within this time of the first are written once
+#ifdef _XBOX_ONE
+#define SUSPEND_SAVE_TIMEOUT_MS             800     // how long a suspend waits for queued saves (titles have 1 second to complete a suspend)
+#else
+#define SUSPEND_SAVE_TIMEOUT_MS             4000    // how long a suspend waits for queued saves (apps have 5 seconds to complete a suspend)
+#endif
+#define SIGN_OUT_SAVE_TIMEOUT_MS            10000   // how long a sign out waits for queued saves
+#define METADATA_QUERY_CONCURRENCY          4       // blob info queries in flight at once while loading container metadata
+#define BOARD_LOAD_CONCURRENCY              4       // game board reads in flight at once while loading or prefetching boards
+#define BOARD_PREFETCH_CAPACITY             5       // boards loaded by prefetching that are kept loaded, counting the active board and its neighbours
+
 namespace GameSaveSample
 {
-    struct GameBoardIndex
-    {
-        uint32_t m_version = 1;
-        uint32_t m_updateCount = 0;
-        uint32_t m_activeBoard = 1;
-    };
-
     const std::function<void(GameBoardIndex&)> fnSaveContainerIndex = [](GameBoardIndex& dataToSave)
     {
         dataToSave.m_updateCount++;
@@ -62,8 +71,12 @@ namespace GameSaveSample
         // Load or refresh game save container and blob metadata
         // Use containerQuery string to limit update to specific container(s), or leave empty to update all containers
         // Use queryBlobs bool to specify whether or not to query and update blob info - querying blobs has the side effect of forcing a sync for sync-on-demand save contexts, which may be undesirable
+        // Blob info is cached, and only queried again for containers whose last modified time has changed
         Concurrency::task<void> LoadContainerMetadata(Platform::String^ containerQuery = nullptr, bool queryBlobs = true);
 
+        // Return the metadata last loaded for a container, or nullptr if it wasn't found on disk (doesn't block, so this is safe to call while drawing)
+        std::shared_ptr<const GameSaveContainerMetadata> GetContainerMetadata(Platform::String^ containerName);
+
         // Return the current remaining quota in bytes for this user for this title
         Concurrency::task<int64_t> GetRemainingQuota();
 
@@ -76,6 +89,15 @@ namespace GameSaveSample
         // Write current container metadata (and optionally blob info) to the game display log
         void WriteGameSaveMetadataToDisplayLog(bool listBlobs);
 
+        // Start any queued saves now, completing once they have all been written or with false if the timeout passes first
+        Concurrency::task<bool> FlushSaves(std::chrono::milliseconds timeout);
+
+        // Set how long queued saves wait for further saves of the same container to join them
+        void SetSaveCoalesceWindow(std::chrono::milliseconds coalesceWindow);
+
+        // Return the number of saves requested, and how many were written, coalesced, failed or dropped
+        GameSaveWriteQueue::Statistics GetSaveStatistics();
+
         //
         // Game Index Tasks
         //
@@ -84,6 +106,7 @@ namespace GameSaveSample
         Concurrency::task<bool> LoadIndex();
 
         // Save the index blob that tells us the last board played by the current user
+        // Saves are queued and written in the background; saves made only because the data is dirty wait for the coalescing window
         Concurrency::task<bool> SaveIndex(bool saveOnlyIfDirty);
 
         //
@@ -103,11 +126,15 @@ namespace GameSaveSample
         Concurrency::task<bool> Read();
 
         // Save the game board for uploading to the cloud
+        // Saves are queued and written in the background; saves made only because the data is dirty wait for the coalescing window
         Concurrency::task<bool> Save(bool saveOnlyIfDirty);
 
         // Mark the current game board dirty so that it will be saved automatically when switching to a different board OR during a suspend
         void MarkActiveBoardDirty();
 
+        // Load every game board found on disk by the last container query that isn't already loaded, up to BOARD_LOAD_CONCURRENCY at once
+        Concurrency::task<void> LoadAllBoards();
+
         //
         // GameSaveManager Public Properties
         //
@@ -238,6 +265,8 @@ namespace GameSaveSample
 
                         gameBoardIndex.m_activeBoard = value;
                         m_gameBoardIndex->SetData(&gameBoardIndex);
+
+                        PrefetchBoards(value);
                     }
                 }
             }
@@ -269,16 +298,41 @@ namespace GameSaveSample
         }
 
     private:
-        void WriteContainerMetadataToDisplayLog(bool listBlobs, std::shared_ptr<GameSaveContainerMetadata> containerMetadata);
+        void WriteContainerMetadataToDisplayLog(bool listBlobs, std::shared_ptr<const GameSaveContainerMetadata> containerMetadata);
+
+        // Returns true if the container belongs to the index or one of the game boards
+        bool IsGameSaveContainer(Platform::String^ containerName);
+
+        // Load the active board if it isn't loaded, then the boards either side of it, so that switching to a neighbour doesn't wait for a read
+        // Reads queued for the boards around the previous active board are canceled, and boards loaded by earlier prefetches which aren't
+        // near the active board are unloaded once there are more than BOARD_PREFETCH_CAPACITY of them, least recently wanted first
+        void PrefetchBoards(uint32_t activeBoard);
+
+        // Read the boards found on disk which aren't loaded or dirty, up to BOARD_LOAD_CONCURRENCY at once, skipping any not started when token is canceled
+        Concurrency::task<void> ReadBoards(std::vector<uint32_t> boardNumbers, Concurrency::cancellation_token token, bool isPrefetch);
+
+        // Read a board with ReadAsync, or return the read already in flight for it
+        Concurrency::task<bool> ReadBoard(uint32_t boardNumber);
+
+        // Unload the least recently wanted prefetched boards beyond BOARD_PREFETCH_CAPACITY, other than activeBoard
+        // (call with m_boardReadMutex held, from the thread which sets ActiveBoardNumber, so that activeBoard is current)
+        void TrimPrefetchedBoards(uint32_t activeBoard);
 
         mutable std::mutex                                      m_mutex;
         bool                                                    m_isSuspending;
         bool                                                    m_isSyncOnDemand;
         int64_t                                                 m_remainingQuotaInBytes;
+        std::unique_ptr<GameSaveWriteQueue>                     m_saveQueue;
+        std::unique_ptr<GameSaveMetadataCache>                  m_metadataCache;
 
-        std::unique_ptr<GameSave<GameBoardIndex>>               m_gameBoardIndex;
+        std::shared_ptr<GameSave<GameBoardIndex>>               m_gameBoardIndex;
         std::vector<std::shared_ptr<GameSave<GameBoard>>>       m_gameBoardSaves;
 
+        std::mutex                                              m_boardReadMutex;       // Guards the board reads and the prefetch state below
+        std::map<uint32_t, Concurrency::task<bool>>             m_boardReads;           // Reads in flight by board number, so a board is never read twice at once
+        std::list<uint32_t>                                     m_prefetchedBoards;     // Boards loaded by a prefetch, most recently wanted first
+        Concurrency::cancellation_token_source                  m_prefetchCancellation; // Canceled when the active board changes
+
 #ifdef _XBOX_ONE
         Windows::Xbox::Storage::ConnectedStorageSpace^          m_gameSaveProvider;
         Windows::Xbox::System::User^                            m_user;
@@ -0,0 +1,119 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#include "pch.h"
+#include "GameSaveMetadataCache.h"
+#include "GameSaveQueryRunner.h"
+
+using namespace Concurrency;
+using namespace GameSaveSample;
+
+std::shared_ptr<const GameSaveMetadataCache::ContainerMap> GameSaveMetadataCache::GetSnapshot() const
+{
+    return m_containers.GetSnapshot();
+}
+
+std::shared_ptr<const GameSaveContainerMetadata> GameSaveMetadataCache::Find(const std::wstring& containerName) const
+{
+    return m_containers.Find(containerName);
+}
+
+std::shared_ptr<const GameSaveContainerMetadata> GameSaveMetadataCache::FindCurrent(const std::wstring& containerName, Windows::Foundation::DateTime lastModified, bool needBlobInfo) const
+{
+    auto metadata = Find(containerName);
+    if (metadata == nullptr
+        || metadata->m_lastModified.UniversalTime != lastModified.UniversalTime
+        || (needBlobInfo && !metadata->m_hasBlobInfo))
+    {
+        return nullptr;
+    }
+
+    return metadata;
+}
+
+uint64_t GameSaveMetadataCache::GetGeneration() const
+{
+    return m_containers.GetGeneration();
+}
+
+size_t GameSaveMetadataCache::Publish(const std::wstring& containerPrefix, const std::vector<std::shared_ptr<GameSaveContainerMetadata>>& containers, uint64_t generation)
+{
+    GameSaveSnapshotMap<GameSaveContainerMetadata>::Entries entries;
+    for (auto& metadata : containers)
+    {
+        entries.emplace_back(metadata->m_containerName->Data(), metadata);
+    }
+
+    return m_containers.Publish(containerPrefix, entries, generation);
+}
+
+void GameSaveMetadataCache::Remove(const std::wstring& containerName)
+{
+    m_containers.Remove(containerName);
+}
+
+void GameSaveMetadataCache::Clear()
+{
+    m_containers.Clear();
+}
+
+task<void> GameSaveMetadataCache::RunQueries(std::vector<Query> queries, size_t maxConcurrent)
+{
+    task_completion_event<void> queriesCompleted;
+
+    std::vector<GameSaveQueryRunner::StartFunction> startFunctions;
+    for (auto& query : queries)
+    {
+        startFunctions.push_back([query](GameSaveQueryRunner::CompletionFunction onComplete)
+        {
+            task<void> queryTask;
+            try
+            {
+                queryTask = query();
+            }
+            catch (Platform::Exception^ ex)
+            {
+                Log::WriteAndDisplay("ERROR: metadata query threw exception (%ws)\n", GetErrorStringForException(ex)->Data());
+                onComplete(false);
+                return;
+            }
+            catch (...)
+            {
+                Log::WriteAndDisplay("ERROR: metadata query threw an unknown exception\n");
+                onComplete(false);
+                return;
+            }
+
+            queryTask.then([onComplete](task<void> t)
+            {
+                bool success = false;
+                try
+                {
+                    t.get();
+                    success = true;
+                }
+                catch (Platform::Exception^ ex)
+                {
+                    Log::WriteAndDisplay("ERROR: metadata query task returned exception (%ws)\n", GetErrorStringForException(ex)->Data());
+                }
+                catch (...)
+                {
+                    Log::WriteAndDisplay("ERROR: metadata query task returned an unknown exception\n");
+                }
+
+                onComplete(success);
+            });
+        });
+    }
+
+    GameSaveQueryRunner::Run(std::move(startFunctions), maxConcurrent, [queriesCompleted](uint32_t)
+    {
+        queriesCompleted.set();
+    });
+
+    return create_task(queriesCompleted);
+}
@@ -0,0 +1,65 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#pragma once
+
+#include "GameSaveContainerMetadata.h"
+#include "GameSaveSnapshotMap.h"
+#include <functional>
+#include <memory>
+#include <ppltasks.h>
+#include <string>
+#include <vector>
+
+namespace GameSaveSample
+{
+    // Container metadata from the last container queries, keyed by container name. The metadata is published as an
+    // immutable snapshot (see GameSaveSnapshotMap), so readers (such as the UI, every frame) take a reference to the
+    // current snapshot without locking. A refresh takes the generation when it starts, and its results don't replace
+    // metadata published or removed since then.
+    class GameSaveMetadataCache
+    {
+    public:
+        typedef GameSaveSnapshotMap<GameSaveContainerMetadata>::Map ContainerMap;
+        typedef std::function<Concurrency::task<void>()> Query;
+
+        GameSaveMetadataCache() {}
+
+        GameSaveMetadataCache(const GameSaveMetadataCache&) = delete;
+        GameSaveMetadataCache& operator=(const GameSaveMetadataCache&) = delete;
+
+        // The current snapshot; never null, and never changed once published
+        std::shared_ptr<const ContainerMap> GetSnapshot() const;
+
+        // The metadata of a container, or nullptr if the last query didn't find it
+        std::shared_ptr<const GameSaveContainerMetadata> Find(const std::wstring& containerName) const;
+
+        // Returns the cached metadata of a container if it is still current: it was last modified at lastModified,
+        // and has blob info if that is needed. Otherwise returns nullptr, and the container should be queried.
+        std::shared_ptr<const GameSaveContainerMetadata> FindCurrent(const std::wstring& containerName, Windows::Foundation::DateTime lastModified, bool needBlobInfo) const;
+
+        // The generation to publish the results of a container query started now with
+        uint64_t GetGeneration() const;
+
+        // Publishes the result of a container query for names starting with containerPrefix (all containers if it
+        // is empty), started at generation: containers replaces every cached entry matching the prefix, and other
+        // entries are kept. Entries published or removed since the query started are left as they are; returns how
+        // many there were.
+        size_t Publish(const std::wstring& containerPrefix, const std::vector<std::shared_ptr<GameSaveContainerMetadata>>& containers, uint64_t generation);
+
+        void Remove(const std::wstring& containerName);
+
+        void Clear();
+
+        // Runs queries with no more than maxConcurrent in flight at once, completing when they have all finished.
+        // A query which fails or throws is logged and doesn't stop the others.
+        static Concurrency::task<void> RunQueries(std::vector<Query> queries, size_t maxConcurrent);
+
+    private:
+        GameSaveSnapshotMap<GameSaveContainerMetadata>  m_containers;
+    };
+}
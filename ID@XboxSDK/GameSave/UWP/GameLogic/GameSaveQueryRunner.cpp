@@ -0,0 +1,101 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#include "pch.h"
+#include "GameSaveQueryRunner.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+using namespace GameSaveSample;
+
+namespace
+{
+    struct RunState
+    {
+        std::vector<GameSaveQueryRunner::StartFunction> queries;
+        GameSaveQueryRunner::FinishedFunction           onFinished;
+        std::atomic<size_t>                             nextQuery;
+        std::atomic<size_t>                             activeChains;
+        std::atomic<uint32_t>                           failures;
+    };
+
+    // The progress of one query: whichever of the query completing and its start function returning happens second
+    // carries on the chain, so a query which completes before returning doesn't add to the stack.
+    const int c_running = 0;
+    const int c_returned = 1;
+    const int c_completed = 2;
+
+    // Runs one query at a time and then takes the next one, until there are none left
+    void RunChain(std::shared_ptr<RunState> state)
+    {
+        for (;;)
+        {
+            size_t query = state->nextQuery++;
+            if (query >= state->queries.size())
+            {
+                if (--state->activeChains == 0)
+                {
+                    state->onFinished(state->failures);
+                }
+                return;
+            }
+
+            auto progress = std::make_shared<std::atomic<int>>(c_running);
+            try
+            {
+                state->queries[query]([state, progress](bool success)
+                {
+                    if (!success)
+                    {
+                        ++state->failures;
+                    }
+
+                    if (progress->exchange(c_completed) == c_returned)
+                    {
+                        RunChain(state);
+                    }
+                });
+            }
+            catch (...)
+            {
+                int running = c_running;
+                if (progress->compare_exchange_strong(running, c_completed))
+                {
+                    ++state->failures;
+                }
+            }
+
+            if (progress->exchange(c_returned) != c_completed)
+            {
+                return;
+            }
+        }
+    }
+}
+
+void GameSaveQueryRunner::Run(std::vector<StartFunction> queries, size_t maxConcurrent, FinishedFunction onFinished)
+{
+    if (queries.empty())
+    {
+        onFinished(0);
+        return;
+    }
+
+    auto state = std::make_shared<RunState>();
+    state->queries = std::move(queries);
+    state->onFinished = std::move(onFinished);
+    state->nextQuery = 0;
+    state->failures = 0;
+
+    size_t chainCount = std::min(std::max(maxConcurrent, size_t(1)), state->queries.size());
+    state->activeChains = chainCount;
+    for (size_t i = 0; i < chainCount; ++i)
+    {
+        RunChain(state);
+    }
+}
@@ -0,0 +1,123 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#pragma once
+
+#include "GameSaveBlobStore.h"
+#include <stdint.h>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace GameSaveSample
+{
+    // Write-behind queue for game saves. Every container write goes through one worker thread, so writes never
+    // overlap. A save waits in the queue for the coalescing window, and further saves of the same container in
+    // that time join it rather than queueing another write. The data is copied (into a pooled buffer) when the
+    // write starts, so the one write saves the latest data. Other operations on a container, such as deleting it,
+    // go through the queue too, so they can't overlap its writes.
+    class GameSaveWriteQueue
+    {
+    public:
+        // Copies the data to save into snapshot, which may hold a previous write's data
+        typedef std::function<void(BlobData& snapshot)> SnapshotFunction;
+
+        // Writes the snapshot to storage, blocking until it is done; returns false if the write failed
+        typedef std::function<bool(const BlobData& snapshot)> WriteFunction;
+
+        typedef std::function<void(bool success)> CompletionFunction;
+
+        // Runs an operation other than a write, such as a delete, blocking until it is done; returns false if it failed
+        typedef std::function<bool()> OperationFunction;
+
+        struct Statistics
+        {
+            uint64_t    requested;  // Calls to Enqueue and EnqueueOperation
+            uint64_t    coalesced;  // Requests which joined a write already waiting for the same container
+            uint64_t    written;    // Writes and operations which reached storage
+            uint64_t    failed;     // Writes and operations which failed
+            uint64_t    dropped;    // Writes removed by Clear, or still waiting when the queue was destroyed
+        };
+
+        explicit GameSaveWriteQueue(std::chrono::milliseconds coalesceWindow);
+
+        GameSaveWriteQueue(const GameSaveWriteQueue&) = delete;
+        GameSaveWriteQueue& operator=(const GameSaveWriteQueue&) = delete;
+
+        // Waits for the write in progress, if any, and drops the rest
+        ~GameSaveWriteQueue();
+
+        // Queues a write of key. If a write of key is already waiting, this request replaces its snapshot and write
+        // functions and both requests complete when it does. An immediate write doesn't wait for the window.
+        // onComplete is called on the worker thread.
+        void Enqueue(
+            const std::wstring& key,
+            SnapshotFunction snapshot,
+            WriteFunction write,
+            CompletionFunction onComplete = nullptr,
+            bool immediate = false);
+
+        // Queues operation on key to run without waiting for the window, after the write of key in progress if any.
+        // A waiting write of key is dropped and completed as failed, since it was requested before the operation;
+        // writes of key queued after it wait for it to finish rather than joining it. onComplete is called on the
+        // worker thread.
+        void EnqueueOperation(
+            const std::wstring& key,
+            OperationFunction operation,
+            CompletionFunction onComplete = nullptr);
+
+        // Starts the waiting writes without waiting out their windows, and blocks until there are no writes waiting
+        // or in progress. Returns false if timeout passed first; the writes carry on in the background.
+        bool Flush(std::chrono::milliseconds timeout);
+
+        // Drops the waiting write of key, if any, completing it as failed. A write already in progress is not affected.
+        void Remove(const std::wstring& key);
+
+        // Drops the waiting writes, completing them as failed
+        void Clear();
+
+        void SetCoalesceWindow(std::chrono::milliseconds coalesceWindow);
+
+        Statistics GetStatistics() const;
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        struct PendingWrite
+        {
+            std::wstring                    key;
+            SnapshotFunction                snapshot;
+            WriteFunction                   write;
+            std::vector<CompletionFunction> completions;
+            Clock::time_point               due;
+            bool                            isOperation;    // Runs write without a snapshot, and isn't joined by later writes
+        };
+
+        void WorkerThread();
+
+        std::list<PendingWrite>::iterator FindWaitingWrite(const std::wstring& key);
+
+        static void Complete(std::vector<CompletionFunction>& completions, bool success);
+
+        mutable std::mutex              m_mutex;
+        std::condition_variable         m_wake;     // Signals the worker
+        std::condition_variable         m_idle;     // Signals Flush when a write finishes
+        std::list<PendingWrite>         m_pending;
+        std::vector<BlobData>           m_bufferPool;
+        std::chrono::milliseconds       m_coalesceWindow;
+        uint32_t                        m_flushCount;
+        bool                            m_isWriting;
+        bool                            m_stop;
+        Statistics                      m_statistics;
+        std::thread                     m_worker;
+    };
+}
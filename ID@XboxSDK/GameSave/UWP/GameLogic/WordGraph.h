@@ -0,0 +1,59 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace GameSaveSample
+{
+    // The word list as a minimized DAWG (directed acyclic word graph): a trie of the words in which identical subtrees
+    // are stored once, so words with a common suffix share it. The graph is a flat array of 32-bit edges, the edges
+    // leaving a node being stored together, which is also its serialized form: a compiled word list is loaded with a
+    // single read, and a word is looked up by walking the edges, without allocating.
+    //
+    // Assets\TWL06_2to5.dawg is Assets\TWL06_2to5.txt compiled by Build. Rebuild it with Tools\WordGraphBuilder ('make dawg'
+    // in Tools) whenever the word list changes.
+    class WordGraph
+    {
+    public:
+        typedef uint32_t Node;
+
+        static const Node c_emptyNode = 0; // the node after a word no other word starts with
+
+        WordGraph();
+
+        // Compiles words (in any order, upper case A-Z only) into the serialized form Load reads. Returns an empty
+        // vector if a word has any other character in it, or the graph is too big.
+        static std::vector<uint8_t> Build(std::vector<std::string> words);
+
+        // Takes data written by Build, which is checked before it is used. Returns false, leaving the graph unchanged,
+        // if the data is not valid.
+        bool Load(std::vector<uint8_t> data);
+
+        bool IsEmpty() const { return m_wordCount == 0; }
+        uint32_t GetWordCount() const { return m_wordCount; }
+        size_t GetSizeInBytes() const { return m_data.size(); }
+
+        // The node to walk from for the first letter of a word
+        Node GetRoot() const { return m_root; }
+
+        // Follows letter from node, setting isWord if the letters walked so far make a word. Returns false, leaving
+        // node unchanged, if no word starts with those letters.
+        bool Next(Node& node, wchar_t letter, bool& isWord) const;
+
+        bool Contains(const wchar_t* word, size_t length) const;
+
+    private:
+        std::vector<uint8_t>    m_data;
+        const uint32_t*         m_edges;
+        Node                    m_root;
+        uint32_t                m_wordCount;
+    };
+}
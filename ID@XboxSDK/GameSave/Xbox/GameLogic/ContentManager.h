@@ -9,14 +9,14 @@
 
 #include "DeviceResources.h"
 #include "Texture2D.h"
+#include "WordGraph.h"
 #include <map>
 #include <string>
 #include <memory>
-#include <set>
 
 namespace GameSaveSample
 {
-    typedef std::shared_ptr<std::set<std::wstring>> WordList;
+    typedef std::shared_ptr<const WordGraph> WordList;
 
     class ContentManager
     {
@@ -25,6 +25,9 @@ namespace GameSaveSample
         ~ContentManager();
 
         std::shared_ptr<DirectX::Texture2D> LoadTexture(std::wstring path);
+
+        // Loads the word list compiled from the text file at path (the same path with a .dawg extension), or
+        // compiles the text file if there is no compiled word list
         Concurrency::task<WordList> LoadWordList(std::wstring path);
 
     private:
@@ -14,6 +14,10 @@
 
 namespace GameSaveSample
 {
+    // Versions of the tagged save formats (see GameBoardFormat.h); version 1 is the raw struct layout saved before them
+    const uint16_t c_gameBoardSaveVersion = 2;
+    const uint16_t c_gameBoardIndexSaveVersion = 2;
+
     struct GameTile
     {
         GameTile() {}
@@ -63,4 +67,11 @@ namespace GameSaveSample
     {
         dataToSave.m_updateCount++;
     };
+
+    struct GameBoardIndex
+    {
+        uint32_t m_version = c_gameBoardIndexSaveVersion; // the save format version this was loaded from (1 if it was migrated from the raw layout)
+        uint32_t m_updateCount = 0;
+        uint32_t m_activeBoard = 1;
+    };
 }
@@ -0,0 +1,229 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#include "pch.h"
+#include "GameBoardScorer.h"
+#include <algorithm>
+
+using namespace DirectX;
+using namespace GameSaveSample;
+
+namespace
+{
+    // Letter values
+    const int c_letterValues[] =
+    {
+        1, // A
+        3, // B
+        3, // C
+        2, // D
+        1, // E
+        4, // F
+        2, // G
+        4, // H
+        1, // I
+        8, // J
+        5, // K
+        1, // L
+        3, // M
+        1, // N
+        1, // O
+        3, // P
+        10, // Q
+        1, // R
+        1, // S
+        1, // T
+        1, // U
+        4, // V
+        4, // W
+        8, // X
+        4, // Y
+        10 // Z
+    };
+
+    const GameTile& GetGameTile(const GameBoard& gameBoard, const XMUINT2& position)
+    {
+        size_t tile = size_t(position.x + (gameBoard.m_boardWidth * position.y));
+        if (tile >= gameBoard.m_boardWidth * gameBoard.m_boardHeight)
+        {
+            throw std::invalid_argument("position is not valid for the current board size");
+        }
+
+        return gameBoard.m_board[tile];
+    }
+}
+
+GameBoardScorer::GameBoardScorer() :
+    m_wordTracker(c_boardWidth * c_boardHeight)
+{
+}
+
+int GameBoardScorer::GetLetterValue(wchar_t letter)
+{
+    return (letter >= L'A' && letter <= L'Z') ? c_letterValues[letter - L'A'] : 0;
+}
+
+int GameBoardScorer::Update(const GameBoard& gameBoard, const WordGraph& wordList)
+{
+    if (m_rowScores.size() != gameBoard.m_boardHeight || m_columnScores.size() != gameBoard.m_boardWidth)
+    {
+        // Reset word tracker, and score every line
+        for (auto& trackerTile : m_wordTracker)
+        {
+            trackerTile.m_wordDown = false;
+            trackerTile.m_wordRight = false;
+        }
+
+        m_rowScores.assign(gameBoard.m_boardHeight, LineScore());
+        m_columnScores.assign(gameBoard.m_boardWidth, LineScore());
+    }
+
+    int score = 0;
+
+    // Score the horizontal words
+    for (uint32_t j = 0; j < gameBoard.m_boardHeight; ++j)
+    {
+        score += ScoreLine(gameBoard, wordList, true, j, m_rowScores[j]);
+    }
+
+    // Score the vertical words
+    for (uint32_t i = 0; i < gameBoard.m_boardWidth; ++i)
+    {
+        score += ScoreLine(gameBoard, wordList, false, i, m_columnScores[i]);
+    }
+
+    return score;
+}
+
+void GameBoardScorer::Reset()
+{
+    m_rowScores.clear();
+    m_columnScores.clear();
+}
+
+const GameBoardScorer::WordTrackerTile& GameBoardScorer::GetWordTrackerTile(const XMUINT2& position) const
+{
+    size_t tile = size_t(position.x + (c_boardWidth * position.y));
+    if (tile >= c_boardWidth * c_boardHeight)
+    {
+        throw std::invalid_argument("position is not valid for the current board size");
+    }
+
+    return m_wordTracker[tile];
+}
+
+GameBoardScorer::WordTrackerTile& GameBoardScorer::GetTrackerTile(const XMUINT2& position)
+{
+    return const_cast<WordTrackerTile&>(static_cast<const GameBoardScorer*>(this)->GetWordTrackerTile(position));
+}
+
+void GameBoardScorer::TrackWord(bool isHorizontal, XMUINT2 startTile, size_t wordLength)
+{
+    if (isHorizontal)
+    {
+        auto lastX = startTile.x + wordLength - 2;
+        for (auto i = startTile.x; i <= lastX; ++i)
+        {
+            auto& trackerTile = GetTrackerTile(startTile);
+            trackerTile.m_wordRight = true;
+            startTile.x++;
+        }
+    }
+    else
+    {
+        auto lastY = startTile.y + wordLength - 2;
+        for (auto i = startTile.y; i <= lastY; ++i)
+        {
+            auto& trackerTile = GetTrackerTile(startTile);
+            trackerTile.m_wordDown = true;
+            startTile.y++;
+        }
+    }
+}
+
+int GameBoardScorer::ScoreLine(const GameBoard& gameBoard, const WordGraph& wordList, bool isHorizontal, uint32_t line, LineScore& lineScore)
+{
+    uint32_t length = isHorizontal ? gameBoard.m_boardWidth : gameBoard.m_boardHeight;
+    if (length > c_maxLineLength)
+    {
+        return 0;
+    }
+
+    auto linePosition = [isHorizontal, line](uint32_t k) { return isHorizontal ? XMUINT2(k, line) : XMUINT2(line, k); };
+
+    wchar_t letters[c_maxLineLength];
+    for (uint32_t k = 0; k < length; ++k)
+    {
+        auto& currentTile = GetGameTile(gameBoard, linePosition(k));
+        letters[k] = currentTile.m_placed ? currentTile.m_letter : 0;
+    }
+
+    if (lineScore.m_length == length && std::equal(letters, letters + length, lineScore.m_letters))
+    {
+        return lineScore.m_score;
+    }
+
+    // The line has changed, so unlink its tiles and find its words again
+    for (uint32_t k = 0; k < length; ++k)
+    {
+        auto& trackerTile = GetTrackerTile(linePosition(k));
+        if (isHorizontal)
+        {
+            trackerTile.m_wordRight = false;
+        }
+        else
+        {
+            trackerTile.m_wordDown = false;
+        }
+    }
+
+    // Each run of placed letters is walked through the word list as it is read, and the walk stops as soon as no word
+    // starts with the letters so far
+    int score = 0;
+    uint32_t wordStart = 0;
+    int wordScore = 0;
+    WordGraph::Node node = WordGraph::c_emptyNode;
+    bool isPrefix = false;
+    bool isWord = false;
+    for (uint32_t k = 0; k <= length; ++k)
+    {
+        wchar_t currentLetter = (k < length) ? letters[k] : 0;
+        if (currentLetter != 0)
+        {
+            if (k == 0 || letters[k - 1] == 0)
+            {
+                wordStart = k;
+                wordScore = 0;
+                node = wordList.GetRoot();
+                isPrefix = true;
+            }
+
+            if (isPrefix)
+            {
+                isPrefix = wordList.Next(node, currentLetter, isWord);
+                if (isPrefix)
+                {
+                    wordScore += GetLetterValue(currentLetter);
+                }
+            }
+        }
+        else if (k > 0 && letters[k - 1] != 0)
+        {
+            auto wordLength = k - wordStart;
+            if (wordLength >= 2 && isPrefix && isWord)
+            {
+                score += wordScore;
+                TrackWord(isHorizontal, linePosition(wordStart), wordLength);
+            }
+        }
+    }
+
+    std::copy(letters, letters + length, lineScore.m_letters);
+    lineScore.m_length = length;
+    lineScore.m_score = score;
+    return score;
+}
@@ -0,0 +1,61 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#pragma once
+
+#include "GameBoard.h"
+#include "WordGraph.h"
+
+namespace GameSaveSample
+{
+    // Scores a game board: each run of two or more placed letters in a row or column which is a word scores the values
+    // of its letters. Each row and column is kept as it was when it was last scored, so that it is only scored again
+    // once its tiles change. The tiles linked to the next one in a word are tracked for drawing.
+    class GameBoardScorer
+    {
+    public:
+        struct WordTrackerTile
+        {
+            WordTrackerTile() {}
+            bool m_wordDown = false;
+            bool m_wordRight = false;
+        };
+
+        GameBoardScorer();
+
+        static int GetLetterValue(wchar_t letter); // 0 for anything other than A-Z
+
+        // Returns the score of the board, scoring again only the rows and columns which changed since the last call
+        int Update(const GameBoard& gameBoard, const WordGraph& wordList);
+
+        // Forgets every line, so the next Update scores them all
+        void Reset();
+
+        // returns WordTrackerTile given a zero-based (x, y) position
+        const WordTrackerTile& GetWordTrackerTile(const DirectX::XMUINT2& position) const;
+
+    private:
+        static const size_t c_maxLineLength = (c_boardWidth > c_boardHeight) ? c_boardWidth : c_boardHeight;
+
+        // A row or column as it was when it was last scored
+        struct LineScore
+        {
+            LineScore() {}
+            wchar_t m_letters[c_maxLineLength] = {}; // the placed letters, 0 for tiles with none
+            uint32_t m_length = 0; // 0 until the line has been scored
+            int m_score = 0;
+        };
+
+        WordTrackerTile& GetTrackerTile(const DirectX::XMUINT2& position);
+        int ScoreLine(const GameBoard& gameBoard, const WordGraph& wordList, bool isHorizontal, uint32_t line, LineScore& lineScore);
+        void TrackWord(bool isHorizontal, DirectX::XMUINT2 startTile, size_t wordLength);
+
+        std::vector<LineScore>          m_rowScores;
+        std::vector<LineScore>          m_columnScores;
+        std::vector<WordTrackerTile>    m_wordTracker;
+    };
+}
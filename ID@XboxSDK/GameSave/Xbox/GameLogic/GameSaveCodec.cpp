@@ -0,0 +1,441 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#include "pch.h"
+#include "GameSaveCodec.h"
+#include "GameSaveChunks.h"
+#include <algorithm>
+#include <string.h>
+
+using namespace GameSaveSample;
+
+namespace
+{
+    const uint32_t  c_blobMagic = 0x5A425347; // "GSBZ"
+    const uint32_t  c_blobHeaderSize = 4 + 4 + 4 + 8; // magic, codec and 3 reserved bytes, raw size, hash
+
+    const uint32_t  c_blockSize = 64 * 1024;
+    const uint32_t  c_blockHeaderSize = 4;
+    const uint32_t  c_storedBlockFlag = 0x80000000;
+
+    const uint32_t  c_minMatch = 4;
+    const uint32_t  c_hashBits = 12;
+    const uint32_t  c_noPosition = 0xFFFFFFFF;
+
+    void WriteUInt32(uint8_t* dest, uint32_t value)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            dest[i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
+
+    uint32_t ReadUInt32(const uint8_t* src)
+    {
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            value |= uint32_t(src[i]) << (8 * i);
+        }
+        return value;
+    }
+
+    void WriteUInt64(uint8_t* dest, uint64_t value)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            dest[i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
+
+    uint64_t ReadUInt64(const uint8_t* src)
+    {
+        uint64_t value = 0;
+        for (int i = 0; i < 8; ++i)
+        {
+            value |= uint64_t(src[i]) << (8 * i);
+        }
+        return value;
+    }
+
+    // Native byte order is fine here, the value is only compared and hashed
+    uint32_t Load32(const uint8_t* src)
+    {
+        uint32_t value;
+        memcpy(&value, src, sizeof(value));
+        return value;
+    }
+
+    uint32_t HashSequence(uint32_t sequence)
+    {
+        return (sequence * 2654435761u) >> (32 - c_hashBits);
+    }
+
+    uint32_t CountBlocks(uint32_t size)
+    {
+        return size / c_blockSize + ((size % c_blockSize) ? 1 : 0);
+    }
+
+    void WriteHeader(uint8_t* dest, BlobCodec codec, const void* data, uint32_t size)
+    {
+        WriteUInt32(dest, c_blobMagic);
+        dest[4] = static_cast<uint8_t>(codec);
+        dest[5] = dest[6] = dest[7] = 0;
+        WriteUInt32(dest + 8, size);
+        WriteUInt64(dest + 12, HashChunk(data, size));
+    }
+
+    // Lengths of 15 or more spill into extra bytes of 255, ending with one less than 255
+    bool WriteLength(uint8_t*& out, const uint8_t* outEnd, uint32_t length)
+    {
+        for (; length >= 255; length -= 255)
+        {
+            if (out == outEnd)
+            {
+                return false;
+            }
+            *out++ = 255;
+        }
+
+        if (out == outEnd)
+        {
+            return false;
+        }
+        *out++ = static_cast<uint8_t>(length);
+        return true;
+    }
+
+    bool ReadLength(const uint8_t*& in, const uint8_t* inEnd, uint32_t& length)
+    {
+        uint8_t byte;
+        do
+        {
+            if (in == inEnd)
+            {
+                return false;
+            }
+            byte = *in++;
+            length += byte;
+        } while (byte == 255);
+
+        return true;
+    }
+
+    // Writes one sequence: a token holding the literal and match lengths, the literals, then (unless this is the last
+    // sequence of the block) the 16-bit match offset and any extra match length bytes.
+    bool WriteSequence(uint8_t*& out, const uint8_t* outEnd, const uint8_t* literals, uint32_t literalLength, uint32_t offset, uint32_t matchLength)
+    {
+        if (out == outEnd)
+        {
+            return false;
+        }
+
+        uint32_t matchCode = (offset != 0) ? matchLength - c_minMatch : 0;
+        uint8_t* token = out++;
+        *token = static_cast<uint8_t>((std::min(literalLength, 15u) << 4) | std::min(matchCode, 15u));
+
+        if (literalLength >= 15 && !WriteLength(out, outEnd, literalLength - 15))
+        {
+            return false;
+        }
+
+        if (uint32_t(outEnd - out) < literalLength)
+        {
+            return false;
+        }
+        memcpy(out, literals, literalLength);
+        out += literalLength;
+
+        if (offset == 0)
+        {
+            return true;
+        }
+
+        if (outEnd - out < 2)
+        {
+            return false;
+        }
+        *out++ = static_cast<uint8_t>(offset);
+        *out++ = static_cast<uint8_t>(offset >> 8);
+
+        return matchCode < 15 || WriteLength(out, outEnd, matchCode - 15);
+    }
+
+    // Compresses one block into dest, returning the compressed size, or 0 if it doesn't fit in capacity bytes
+    uint32_t CompressBlock(const uint8_t* src, uint32_t size, uint8_t* dest, uint32_t capacity)
+    {
+        uint32_t lastPosition[1 << c_hashBits];
+        std::fill(std::begin(lastPosition), std::end(lastPosition), c_noPosition);
+
+        uint8_t* out = dest;
+        const uint8_t* outEnd = dest + capacity;
+        uint32_t anchor = 0;
+        uint32_t position = 0;
+
+        while (position + c_minMatch <= size)
+        {
+            uint32_t sequence = Load32(src + position);
+            uint32_t& entry = lastPosition[HashSequence(sequence)];
+            uint32_t candidate = entry;
+            entry = position;
+
+            if (candidate == c_noPosition || Load32(src + candidate) != sequence)
+            {
+                // Step further the longer nothing has matched, so incompressible data is skipped over quickly
+                position += 1 + ((position - anchor) >> 6);
+                continue;
+            }
+
+            uint32_t matchLength = c_minMatch;
+            while (position + matchLength < size && src[candidate + matchLength] == src[position + matchLength])
+            {
+                ++matchLength;
+            }
+
+            if (!WriteSequence(out, outEnd, src + anchor, position - anchor, position - candidate, matchLength))
+            {
+                return 0;
+            }
+
+            position += matchLength;
+            anchor = position;
+        }
+
+        if (anchor < size && !WriteSequence(out, outEnd, src + anchor, size - anchor, 0, 0))
+        {
+            return 0;
+        }
+
+        return static_cast<uint32_t>(out - dest);
+    }
+
+    bool DecompressBlock(const uint8_t* src, uint32_t srcSize, uint8_t* dest, uint32_t destSize)
+    {
+        const uint8_t* in = src;
+        const uint8_t* inEnd = src + srcSize;
+        uint8_t* out = dest;
+        uint8_t* outEnd = dest + destSize;
+
+        while (in < inEnd)
+        {
+            uint8_t token = *in++;
+
+            uint32_t literalLength = token >> 4;
+            if (literalLength == 15 && !ReadLength(in, inEnd, literalLength))
+            {
+                return false;
+            }
+
+            if (uint32_t(inEnd - in) < literalLength || uint32_t(outEnd - out) < literalLength)
+            {
+                return false;
+            }
+            memcpy(out, in, literalLength);
+            in += literalLength;
+            out += literalLength;
+
+            if (in == inEnd)
+            {
+                break;
+            }
+
+            if (inEnd - in < 2)
+            {
+                return false;
+            }
+            uint32_t offset = uint32_t(in[0]) | (uint32_t(in[1]) << 8);
+            in += 2;
+
+            uint32_t matchLength = token & 15;
+            if (matchLength == 15 && !ReadLength(in, inEnd, matchLength))
+            {
+                return false;
+            }
+            matchLength += c_minMatch;
+
+            if (offset == 0 || offset > uint32_t(out - dest) || uint32_t(outEnd - out) < matchLength)
+            {
+                return false;
+            }
+
+            // A match which overlaps the bytes it produces repeats them, so it has to be copied a byte at a time
+            const uint8_t* match = out - offset;
+            if (offset >= matchLength)
+            {
+                memcpy(out, match, matchLength);
+            }
+            else
+            {
+                for (uint32_t i = 0; i < matchLength; ++i)
+                {
+                    out[i] = match[i];
+                }
+            }
+            out += matchLength;
+        }
+
+        return out == outEnd;
+    }
+
+    uint32_t EncodeStored(const uint8_t* data, uint32_t size, uint8_t* dest)
+    {
+        WriteHeader(dest, BlobCodec::Stored, data, size);
+        if (size > 0)
+        {
+            memcpy(dest + c_blobHeaderSize, data, size);
+        }
+        return c_blobHeaderSize + size;
+    }
+
+    uint32_t EncodeLz(const uint8_t* data, uint32_t size, uint8_t* dest)
+    {
+        WriteHeader(dest, BlobCodec::Lz, data, size);
+
+        uint8_t* out = dest + c_blobHeaderSize;
+        for (uint32_t offset = 0; offset < size; offset += c_blockSize)
+        {
+            uint32_t blockSize = std::min(c_blockSize, size - offset);
+
+            // A block is only compressed if that makes it smaller
+            uint32_t compressedSize = CompressBlock(data + offset, blockSize, out + c_blockHeaderSize, blockSize - 1);
+            if (compressedSize > 0)
+            {
+                WriteUInt32(out, compressedSize);
+                out += c_blockHeaderSize + compressedSize;
+            }
+            else
+            {
+                WriteUInt32(out, blockSize | c_storedBlockFlag);
+                memcpy(out + c_blockHeaderSize, data + offset, blockSize);
+                out += c_blockHeaderSize + blockSize;
+            }
+        }
+
+        return static_cast<uint32_t>(out - dest);
+    }
+
+    bool DecodeLz(const uint8_t* src, size_t srcSize, uint8_t* dest, uint32_t destSize)
+    {
+        const uint8_t* in = src;
+        const uint8_t* inEnd = src + srcSize;
+
+        for (uint32_t offset = 0; offset < destSize; offset += c_blockSize)
+        {
+            uint32_t blockSize = std::min(c_blockSize, destSize - offset);
+
+            if (uint32_t(inEnd - in) < c_blockHeaderSize)
+            {
+                return false;
+            }
+            uint32_t blockHeader = ReadUInt32(in);
+            uint32_t payloadSize = blockHeader & ~c_storedBlockFlag;
+            in += c_blockHeaderSize;
+
+            if (uint32_t(inEnd - in) < payloadSize)
+            {
+                return false;
+            }
+
+            if (blockHeader & c_storedBlockFlag)
+            {
+                if (payloadSize != blockSize)
+                {
+                    return false;
+                }
+                memcpy(dest + offset, in, blockSize);
+            }
+            else if (!DecompressBlock(in, payloadSize, dest + offset, blockSize))
+            {
+                return false;
+            }
+
+            in += payloadSize;
+        }
+
+        return in == inEnd;
+    }
+}
+
+namespace GameSaveSample
+{
+    uint32_t GetMaxEncodedSize(uint32_t rawSize)
+    {
+        return c_blobHeaderSize + rawSize + CountBlocks(rawSize) * c_blockHeaderSize;
+    }
+
+    uint32_t EncodeBlob(const void* data, uint32_t size, BlobCodec codec, uint8_t* dest)
+    {
+        auto bytes = static_cast<const uint8_t*>(data);
+
+        if (codec == BlobCodec::Lz)
+        {
+            uint32_t encodedSize = EncodeLz(bytes, size, dest);
+            if (encodedSize < c_blobHeaderSize + size)
+            {
+                return encodedSize;
+            }
+        }
+
+        return EncodeStored(bytes, size, dest);
+    }
+
+    void EncodeBlob(const void* data, uint32_t size, BlobCodec codec, BlobData& encoded)
+    {
+        encoded.resize(GetMaxEncodedSize(size));
+        encoded.resize(EncodeBlob(data, size, codec, encoded.data()));
+    }
+
+    bool DecodeBlob(const uint8_t* encoded, size_t encodedSize, void* dest, uint32_t destSize)
+    {
+        BlobCodec codec;
+        uint32_t rawSize;
+        if (!GetEncodedBlobInfo(encoded, encodedSize, codec, rawSize) || rawSize != destSize)
+        {
+            return false;
+        }
+
+        auto payload = encoded + c_blobHeaderSize;
+        size_t payloadSize = encodedSize - c_blobHeaderSize;
+        auto bytes = static_cast<uint8_t*>(dest);
+
+        switch (codec)
+        {
+        case BlobCodec::Stored:
+            if (payloadSize != destSize)
+            {
+                return false;
+            }
+            if (destSize > 0)
+            {
+                memcpy(bytes, payload, destSize);
+            }
+            break;
+        case BlobCodec::Lz:
+            if (!DecodeLz(payload, payloadSize, bytes, destSize))
+            {
+                return false;
+            }
+            break;
+        default:
+            return false;
+        }
+
+        return HashChunk(bytes, destSize) == ReadUInt64(encoded + 12);
+    }
+
+    bool GetEncodedBlobInfo(const uint8_t* encoded, size_t encodedSize, BlobCodec& codec, uint32_t& rawSize)
+    {
+        if (encoded == nullptr || encodedSize < c_blobHeaderSize || ReadUInt32(encoded) != c_blobMagic)
+        {
+            return false;
+        }
+
+        codec = static_cast<BlobCodec>(encoded[4]);
+        rawSize = ReadUInt32(encoded + 8);
+        return codec == BlobCodec::Stored || codec == BlobCodec::Lz;
+    }
+}
@@ -0,0 +1,45 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#pragma once
+
+#include "GameSaveBlobStore.h"
+#include <stdint.h>
+
+// Blobs are compressed before they are submitted, so that a save uses as little of the user's quota as possible.
+// Every encoded blob starts with a header naming the codec, the size of the data and its hash, so a blob can be
+// decoded without knowing how it was written, and a corrupt blob is detected rather than loaded.
+//
+// The LZ codec compresses the data in independent blocks of up to 64 KB (a byte-oriented LZ77 with a 64 KB window,
+// in the style of LZ4), storing any block which doesn't compress. Encoding never needs more than
+// GetMaxEncodedSize bytes, so the destination can be allocated up front.
+namespace GameSaveSample
+{
+    enum class BlobCodec : uint8_t
+    {
+        Stored = 0, // The data as is, after the header
+        Lz = 1,     // Fast LZ77 in 64 KB blocks
+    };
+
+    const BlobCodec c_defaultBlobCodec = BlobCodec::Lz;
+
+    // The most bytes EncodeBlob can write for rawSize bytes of data, with any codec
+    uint32_t GetMaxEncodedSize(uint32_t rawSize);
+
+    // Encodes data into dest, which must hold GetMaxEncodedSize(size) bytes, and returns the encoded size. The data is
+    // stored instead if the codec doesn't make it any smaller.
+    uint32_t EncodeBlob(const void* data, uint32_t size, BlobCodec codec, uint8_t* dest);
+
+    void EncodeBlob(const void* data, uint32_t size, BlobCodec codec, BlobData& encoded);
+
+    // Decodes a blob written by EncodeBlob into dest. Fails, possibly having written to dest, unless the blob is valid
+    // and holds exactly destSize bytes of data matching its hash.
+    bool DecodeBlob(const uint8_t* encoded, size_t encodedSize, void* dest, uint32_t destSize);
+
+    // Reads the codec and data size from an encoded blob's header, without decoding it
+    bool GetEncodedBlobInfo(const uint8_t* encoded, size_t encodedSize, BlobCodec& codec, uint32_t& rawSize);
+}
@@ -33,6 +33,7 @@ struct GameSaveContainerMetadata
     {
         m_blobs.clear();
         m_changedSinceLastSync = false;
+        m_hasBlobInfo = false;
         m_isGameDataOnDisk = false;
         m_lastModified.UniversalTime = 0;
         m_needsSync = false;
@@ -41,6 +42,7 @@ struct GameSaveContainerMetadata
 
     std::vector<GameSaveBlobMetadata>   m_blobs;
     bool                                m_changedSinceLastSync;
+    bool                                m_hasBlobInfo;  // m_blobs has been queried (an empty list could also mean there are no blobs)
     Platform::String^                   m_containerDisplayName;
     Platform::String^                   m_containerName;
     bool                                m_isGameDataOnDisk;
@@ -0,0 +1,236 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#include "pch.h"
+#include "GameSaveFormat.h"
+
+using namespace GameSaveSample;
+
+namespace
+{
+    const uint32_t  c_recordMagic = 0x52545347; // "GSTR"
+    const uint32_t  c_recordHeaderSize = 4 + 2 + 2 + 4; // magic, schema version, reserved, body size
+    const uint32_t  c_maxFieldId = 0x1FFFFFFF;
+
+    void WriteUInt32(uint8_t* dest, uint32_t value)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            dest[i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
+
+    uint32_t ReadUInt32(const uint8_t* src)
+    {
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            value |= uint32_t(src[i]) << (8 * i);
+        }
+        return value;
+    }
+}
+
+TaggedWriter::TaggedWriter(uint8_t* dest, uint32_t capacity, uint16_t schemaVersion) :
+    m_dest(dest),
+    m_capacity(capacity),
+    m_size(0),
+    m_overflowed(false)
+{
+    if (m_capacity < c_recordHeaderSize)
+    {
+        m_overflowed = true;
+        return;
+    }
+
+    WriteUInt32(m_dest, c_recordMagic);
+    m_dest[4] = static_cast<uint8_t>(schemaVersion);
+    m_dest[5] = static_cast<uint8_t>(schemaVersion >> 8);
+    m_dest[6] = m_dest[7] = 0;
+    WriteUInt32(m_dest + 8, 0);
+    m_size = c_recordHeaderSize;
+}
+
+void TaggedWriter::WriteVarint(uint32_t fieldId, uint64_t value)
+{
+    WriteTag(fieldId, WireType::Varint);
+    WriteRawVarint(value);
+}
+
+void TaggedWriter::WriteFixed32(uint32_t fieldId, uint32_t value)
+{
+    uint8_t bytes[4];
+    WriteUInt32(bytes, value);
+
+    WriteTag(fieldId, WireType::Fixed32);
+    WriteRaw(bytes, sizeof(bytes));
+}
+
+void TaggedWriter::WriteBytes(uint32_t fieldId, const void* data, uint32_t size)
+{
+    uint8_t length[4];
+    WriteUInt32(length, size);
+
+    WriteTag(fieldId, WireType::Bytes);
+    WriteRaw(length, sizeof(length));
+    WriteRaw(data, size);
+}
+
+uint32_t TaggedWriter::Finish()
+{
+    if (m_overflowed)
+    {
+        return 0;
+    }
+
+    WriteUInt32(m_dest + 8, m_size - c_recordHeaderSize);
+    return m_size;
+}
+
+void TaggedWriter::WriteTag(uint32_t fieldId, WireType type)
+{
+    if (fieldId > c_maxFieldId)
+    {
+        m_overflowed = true;
+        return;
+    }
+
+    WriteRawVarint((uint64_t(fieldId) << 3) | static_cast<uint8_t>(type));
+}
+
+void TaggedWriter::WriteRawVarint(uint64_t value)
+{
+    uint8_t bytes[10];
+    uint32_t size = 0;
+    do
+    {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        bytes[size++] = byte | (value ? 0x80 : 0);
+    } while (value);
+
+    WriteRaw(bytes, size);
+}
+
+void TaggedWriter::WriteRaw(const void* data, uint32_t size)
+{
+    if (m_overflowed || m_capacity - m_size < size)
+    {
+        m_overflowed = true;
+        return;
+    }
+
+    if (size > 0)
+    {
+        memcpy(m_dest + m_size, data, size);
+    }
+    m_size += size;
+}
+
+TaggedReader::TaggedReader(const uint8_t* data, size_t size) :
+    m_current(nullptr),
+    m_end(nullptr),
+    m_schemaVersion(0),
+    m_isValid(false)
+{
+    if (data == nullptr || size < c_recordHeaderSize || ReadUInt32(data) != c_recordMagic)
+    {
+        return;
+    }
+
+    uint32_t bodySize = ReadUInt32(data + 8);
+    if (bodySize > size - c_recordHeaderSize)
+    {
+        return;
+    }
+
+    m_schemaVersion = static_cast<uint16_t>(data[4] | (data[5] << 8));
+    m_current = data + c_recordHeaderSize;
+    m_end = m_current + bodySize;
+    m_isValid = true;
+}
+
+bool TaggedReader::Next(TaggedField& field)
+{
+    if (!m_isValid || m_current == m_end)
+    {
+        return false;
+    }
+
+    uint64_t tag;
+    if (!ReadRawVarint(tag) || (tag >> 3) > c_maxFieldId)
+    {
+        m_isValid = false;
+        return false;
+    }
+
+    field.m_id = static_cast<uint32_t>(tag >> 3);
+    field.m_type = static_cast<WireType>(tag & 7);
+    field.m_value = 0;
+    field.m_data = nullptr;
+    field.m_size = 0;
+
+    switch (field.m_type)
+    {
+    case WireType::Varint:
+        m_isValid = ReadRawVarint(field.m_value);
+        break;
+
+    case WireType::Fixed32:
+        m_isValid = (m_end - m_current) >= 4;
+        if (m_isValid)
+        {
+            field.m_value = ReadUInt32(m_current);
+            m_current += 4;
+        }
+        break;
+
+    case WireType::Bytes:
+        m_isValid = (m_end - m_current) >= 4;
+        if (m_isValid)
+        {
+            field.m_size = ReadUInt32(m_current);
+            m_current += 4;
+
+            m_isValid = uint64_t(m_end - m_current) >= field.m_size;
+            if (m_isValid)
+            {
+                field.m_data = m_current;
+                m_current += field.m_size;
+            }
+        }
+        break;
+
+    default:
+        // A field of an unknown wire type can't be skipped, so nothing after it can be read
+        m_isValid = false;
+        break;
+    }
+
+    return m_isValid;
+}
+
+bool TaggedReader::ReadRawVarint(uint64_t& value)
+{
+    value = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 7)
+    {
+        if (m_current == m_end)
+        {
+            return false;
+        }
+
+        uint8_t byte = *m_current++;
+        value |= uint64_t(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
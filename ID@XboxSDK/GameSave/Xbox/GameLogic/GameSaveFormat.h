@@ -0,0 +1,121 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+namespace GameSaveSample
+{
+    // How GameSave<TData> turns TData into the bytes it saves (the payload) and back. The payload is always
+    // c_payloadSize bytes, so the chunks to read are known before the manifest has been read. Read must also accept
+    // c_legacySize bytes, the layout saves had before the type had a format of its own.
+    //
+    // By default the payload is a copy of the struct's memory. Specialize this for types which are saved in the
+    // tagged format below, so that their layout can change without breaking existing saves.
+    template <typename TData>
+    struct SaveDataFormat
+    {
+        static const uint32_t c_payloadSize = sizeof(TData);
+        static const uint32_t c_legacySize = sizeof(TData);
+
+        // Writes c_payloadSize bytes to payload; returns false if data doesn't fit
+        static bool Write(const TData& data, uint8_t* payload)
+        {
+            memcpy(payload, &data, sizeof(TData));
+            return true;
+        }
+
+        // Reads size bytes written by Write (or in the legacy layout) into data; returns false, leaving data
+        // unchanged, if they are not valid
+        static bool Read(const uint8_t* payload, uint32_t size, TData& data)
+        {
+            if (size != sizeof(TData))
+            {
+                return false;
+            }
+
+            memcpy(&data, payload, sizeof(TData));
+            return true;
+        }
+    };
+
+    // Compact tagged binary format for save data. A record is a 12-byte header (magic, schema version, body size)
+    // followed by fields. Each field is a varint tag holding the field id and wire type, then the value:
+    //
+    //   Varint     unsigned LEB128 integer
+    //   Fixed32    4 bytes, little-endian
+    //   Bytes      4-byte little-endian length, then that many bytes (packed arrays, strings, nested records)
+    //
+    // Readers skip fields whose ids they don't know, so a newer version of a record can add fields and still be read
+    // by older code, and fields missing from an older version keep their default values. A field id is never reused
+    // with a different meaning. Anything after the body (such as the padding up to c_payloadSize) is ignored.
+    enum class WireType : uint8_t
+    {
+        Varint = 0,
+        Fixed32 = 1,
+        Bytes = 2,
+    };
+
+    class TaggedWriter
+    {
+    public:
+        // Writes a record into dest, which holds capacity bytes. Writes which don't fit are dropped, and Finish fails.
+        TaggedWriter(uint8_t* dest, uint32_t capacity, uint16_t schemaVersion);
+
+        void WriteVarint(uint32_t fieldId, uint64_t value);
+        void WriteFixed32(uint32_t fieldId, uint32_t value);
+        void WriteBytes(uint32_t fieldId, const void* data, uint32_t size);
+
+        // Fills in the body size, and returns the size of the record, or 0 if it didn't fit
+        uint32_t Finish();
+
+    private:
+        void WriteTag(uint32_t fieldId, WireType type);
+        void WriteRawVarint(uint64_t value);
+        void WriteRaw(const void* data, uint32_t size);
+
+        uint8_t*    m_dest;
+        uint32_t    m_capacity;
+        uint32_t    m_size;
+        bool        m_overflowed;
+    };
+
+    struct TaggedField
+    {
+        uint32_t        m_id;
+        WireType        m_type;
+        uint64_t        m_value;    // Varint and Fixed32 fields
+        const uint8_t*  m_data;     // Bytes fields: the bytes in the record itself, not a copy
+        uint32_t        m_size;
+    };
+
+    // Reads the fields of a record in place. Every length is checked against the body, so a corrupt or truncated
+    // record makes IsValid false rather than reading past the end of the data.
+    class TaggedReader
+    {
+    public:
+        TaggedReader(const uint8_t* data, size_t size);
+
+        // False if the data doesn't start with a record, or a field runs past the end of the body
+        bool IsValid() const { return m_isValid; }
+
+        uint16_t GetSchemaVersion() const { return m_schemaVersion; }
+
+        // Reads the next field, returning false at the end of the body or if the record is not valid
+        bool Next(TaggedField& field);
+
+    private:
+        bool ReadRawVarint(uint64_t& value);
+
+        const uint8_t*  m_current;
+        const uint8_t*  m_end;
+        uint16_t        m_schemaVersion;
+        bool            m_isValid;
+    };
+}
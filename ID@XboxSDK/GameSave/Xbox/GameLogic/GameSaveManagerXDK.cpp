@@ -18,7 +18,9 @@ bool GameSaveManager::s_hasBeenInitialized = false;
 
 GameSaveManager::GameSaveManager() :
     m_isSuspending(false),
-    m_isSyncOnDemand(false)
+    m_isSyncOnDemand(false),
+    m_saveQueue(std::make_unique<GameSaveWriteQueue>(std::chrono::milliseconds(SAVE_COALESCE_WINDOW_MS))),
+    m_metadataCache(std::make_unique<GameSaveMetadataCache>())
 {
     Reset();
 }
@@ -31,9 +33,19 @@ void GameSaveManager::Reset()
     IsInitialized = false;
     m_isSuspending = false;
     m_remainingQuotaInBytes = 0;
+    m_saveQueue->Clear();
+    m_metadataCache->Clear();
     m_gameBoardIndex.reset();
     m_gameBoardSaves.clear();
 
+    {
+        std::lock_guard<std::mutex> boardReadLock(m_boardReadMutex);
+        m_prefetchCancellation.cancel();
+        m_prefetchCancellation = cancellation_token_source();
+        m_prefetchedBoards.clear();
+        m_boardReads.clear();
+    }
+
     for (auto i = 1; i <= c_saveSlotCount; ++i)
     {
         Platform::String^ containerName = ref new Platform::String(GAME_BOARD_NAME_PREFIX) + i.ToString();
@@ -126,6 +138,17 @@ task<HRESULT> GameSaveManager::InitializeForUser(Windows::Xbox::System::User^ us
                             }
 
                             GetRemainingQuota();
+
+                            // with full sync every board is already on the local disk, so they are all loaded up front; with sync on demand
+                            // a read may have to download the board, so only the active board and its neighbours are
+                            if (IsSyncOnDemand)
+                            {
+                                PrefetchBoards(ActiveBoardNumber);
+                            }
+                            else
+                            {
+                                LoadAllBoards();
+                            }
                         });
                     });
                 }
@@ -176,7 +199,13 @@ task<void> GameSaveManager::LoadContainerMetadata(Platform::String^ containerQue
         return create_task([] {});
     }
 
-    return create_task(query->GetContainerInfo2Async()).then([this, queryBlobs](task<IVectorView<ContainerInfo2>^> t) -> task<void>
+    std::wstring containerPrefix = (containerQuery != nullptr) ? containerQuery->Data() : L"";
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // metadata published or removed while this query runs (such as by a board being deleted) is newer than its results
+    uint64_t generation = m_metadataCache->GetGeneration();
+
+    return create_task(query->GetContainerInfo2Async()).then([this, queryBlobs, containerPrefix, start, generation](task<IVectorView<ContainerInfo2>^> t) -> task<void>
     {
         try
         {
@@ -186,70 +215,73 @@ task<void> GameSaveManager::LoadContainerMetadata(Platform::String^ containerQue
             {
                 Log::Write("LoadContainerMetadata: no containers found\n");
             }
-            else
+
+            auto updatedMetadata = std::make_shared<std::vector<std::shared_ptr<GameSaveContainerMetadata>>>();
+            std::vector<GameSaveMetadataCache::Query> blobQueries;
+
+            for (auto containerInfo : containerCollection)
             {
-                std::vector<task<void>> blobQueries;
+                auto containerName = containerInfo.Name;
 
-                for (auto containerInfo : containerCollection)
+                // Match container found in query to an existing GameSave object
+                if (!IsGameSaveContainer(containerName))
                 {
-                    auto containerName = containerInfo.Name;
-                    std::shared_ptr<GameSaveContainerMetadata> gameSaveMetadata;
-
-                    // Match container found in query to an existing GameSave object
-                    if (m_gameBoardIndex->m_containerMetadata->m_containerName->Equals(containerName))
-                    {
-                        gameSaveMetadata = m_gameBoardIndex->m_containerMetadata;
-                    }
-                    else
-                    {
-                        auto it = std::find_if(m_gameBoardSaves.begin(), m_gameBoardSaves.end(), [containerName](std::shared_ptr<GameSave<GameBoard>> gameBoardSave)
-                        {
-                            return gameBoardSave->m_containerMetadata->m_containerName->Equals(containerName);
-                        });
-                        if (it != m_gameBoardSaves.end())
-                        {
-                            gameSaveMetadata = (*it)->m_containerMetadata;
-                        }
-                        else
-                        {
-                            Log::WriteAndDisplay("WARNING: Found non-game-related container: %ws (%ws) (%llu bytes)\n", containerName->Data(), containerInfo.DisplayName->Data(), containerInfo.TotalSize);
-                        }
-                    }
+                    Log::WriteAndDisplay("WARNING: Found non-game-related container: %ws (%ws) (%llu bytes)\n", containerName->Data(), containerInfo.DisplayName->Data(), containerInfo.TotalSize);
+                    continue;
+                }
 
-                    // Update saved metadata if the query result matches a known type of data
-                    if (gameSaveMetadata != nullptr)
+                // The metadata goes in a new object, which nothing else can see until the cache publishes it
+                auto gameSaveMetadata = std::make_shared<GameSaveContainerMetadata>(containerName, containerInfo.DisplayName);
+                gameSaveMetadata->m_isGameDataOnDisk = true;
+                gameSaveMetadata->m_lastModified = containerInfo.LastModifiedTime;
+                gameSaveMetadata->m_needsSync = containerInfo.NeedsSync;
+                gameSaveMetadata->m_totalSize = containerInfo.TotalSize;
+                updatedMetadata->push_back(gameSaveMetadata);
+
+                // The blobs can't have changed if the container hasn't been modified since they were last queried
+                auto cachedMetadata = m_metadataCache->FindCurrent(containerName->Data(), containerInfo.LastModifiedTime, true);
+                if (cachedMetadata != nullptr)
+                {
+                    gameSaveMetadata->m_blobs = cachedMetadata->m_blobs;
+                    gameSaveMetadata->m_hasBlobInfo = true;
+                }
+                else if (queryBlobs)
+                {
+                    // Get blob metadata
+                    auto provider = m_gameSaveProvider;
+                    blobQueries.push_back([provider, gameSaveMetadata]
                     {
-                        gameSaveMetadata->m_isGameDataOnDisk = true;
-                        gameSaveMetadata->m_containerDisplayName = containerInfo.DisplayName;
-                        gameSaveMetadata->m_lastModified = containerInfo.LastModifiedTime;
-                        gameSaveMetadata->m_needsSync = containerInfo.NeedsSync;
-                        gameSaveMetadata->m_totalSize = containerInfo.TotalSize;
+                        auto container = provider->CreateContainer(gameSaveMetadata->m_containerName);
+                        auto blobQuery = container->CreateBlobInfoQuery("");
 
-                        if (queryBlobs)
+                        return create_task(blobQuery->GetBlobInfoAsync()).then([gameSaveMetadata](task<IVectorView<BlobInfo>^> t)
                         {
-                            // Get blob metadata
-                            auto container = m_gameSaveProvider->CreateContainer(containerName);
-                            auto blobQuery = container->CreateBlobInfoQuery("");
-                            gameSaveMetadata->m_blobs.clear();
+                            auto blobCollection = t.get();
 
-                            blobQueries.push_back(create_task(blobQuery->GetBlobInfoAsync()).then([gameSaveMetadata](task<IVectorView<BlobInfo>^> t)
+                            for (auto blobInfo : blobCollection)
                             {
-                                auto blobCollection = t.get();
-
-                                for (auto blobInfo : blobCollection)
-                                {
-                                    gameSaveMetadata->m_blobs.push_back(GameSaveBlobMetadata(blobInfo.Name, blobInfo.Size));
-                                }
-                            }));
-                        }
-                    }
+                                gameSaveMetadata->m_blobs.push_back(GameSaveBlobMetadata(blobInfo.Name, blobInfo.Size));
+                            }
+                            gameSaveMetadata->m_hasBlobInfo = true;
+                        });
+                    });
                 }
+            }
 
-                return when_all(std::begin(blobQueries), std::end(blobQueries)).then([]
+            auto blobQueryCount = static_cast<uint32_t>(blobQueries.size());
+            return GameSaveMetadataCache::RunQueries(std::move(blobQueries), METADATA_QUERY_CONCURRENCY).then([this, containerPrefix, updatedMetadata, blobQueryCount, start, generation]
+            {
+                size_t skipped = m_metadataCache->Publish(containerPrefix, *updatedMetadata, generation);
+                if (skipped > 0)
                 {
-                    Log::WriteAndDisplay("Game board metadata updated\n");
-                });
-            }
+                    Log::Write("LoadContainerMetadata: %u containers changed while the query ran and were not updated\n", static_cast<uint32_t>(skipped));
+                }
+
+                auto stop = std::chrono::high_resolution_clock::now();
+                auto durationMS = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
+                Log::Write("LoadContainerMetadata duration: " + durationMS.ToString() + "ms\n");
+                Log::WriteAndDisplay("Game board metadata updated (%u containers, %u blob queries)\n", static_cast<uint32_t>(updatedMetadata->size()), blobQueryCount);
+            });
         }
         catch (Platform::Exception^ ex)
         {
@@ -260,6 +292,24 @@ task<void> GameSaveManager::LoadContainerMetadata(Platform::String^ containerQue
     });
 }
 
+std::shared_ptr<const GameSaveContainerMetadata> GameSaveManager::GetContainerMetadata(Platform::String^ containerName)
+{
+    return m_metadataCache->Find(containerName->Data());
+}
+
+bool GameSaveManager::IsGameSaveContainer(Platform::String^ containerName)
+{
+    if (m_gameBoardIndex != nullptr && m_gameBoardIndex->m_containerMetadata->m_containerName->Equals(containerName))
+    {
+        return true;
+    }
+
+    return std::any_of(m_gameBoardSaves.begin(), m_gameBoardSaves.end(), [containerName](std::shared_ptr<GameSave<GameBoard>> gameBoardSave)
+    {
+        return gameBoardSave->m_containerMetadata->m_containerName->Equals(containerName);
+    });
+}
+
 task<int64_t> GameSaveManager::GetRemainingQuota()
 {
     Log::Write("GameSaveManager::GetRemainingQuota()\n");
@@ -290,10 +340,13 @@ task<void> GameSaveManager::OnSignOut()
 {
     Log::WriteAndDisplay("GameSaveManager::OnSignOut() start...\n");
 
-    return Save(true).then([this](task<bool>)
+    if (HasActiveBoard)
     {
-        return SaveIndex(true);
-    }).then([](task<bool>)
+        Save(true);
+    }
+    SaveIndex(true);
+
+    return FlushSaves(std::chrono::milliseconds(SIGN_OUT_SAVE_TIMEOUT_MS)).then([](bool)
     {
         Log::WriteAndDisplay("GameSaveManager::OnSignOut() complete\n");
     });
@@ -310,12 +363,20 @@ task<void> GameSaveManager::Suspend()
     {
         IsInitialized = false;
 
-        return Save(true).then([this](task<bool>)
+        // queue the saves, then wait for them along with any saves already queued or in progress, up to the suspend deadline
+        if (HasActiveBoard)
         {
-            return SaveIndex(true);
-        }).then([this](task<bool>)
+            Save(true);
+        }
+        SaveIndex(true);
+
+        return FlushSaves(std::chrono::milliseconds(SUSPEND_SAVE_TIMEOUT_MS)).then([this](bool flushed)
         {
             m_isSuspending = false;
+            if (!flushed)
+            {
+                Log::WriteAndDisplay("WARNING: saves still in progress at the suspend deadline\n");
+            }
             Log::WriteAndDisplay("GameSaveManager::Suspend() (with save) complete\n");
         });
     }
@@ -329,6 +390,37 @@ task<void> GameSaveManager::Suspend()
     }
 }
 
+task<bool> GameSaveManager::FlushSaves(std::chrono::milliseconds timeout)
+{
+    Log::Write("GameSaveManager::FlushSaves()\n");
+
+    // wait on a background thread, since this may be called from the UI thread
+    return create_task([this, timeout]
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        bool flushed = m_saveQueue->Flush(timeout);
+        auto stop = std::chrono::high_resolution_clock::now();
+        auto durationMS = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
+        Log::WriteAndDisplay("FlushSaves duration: " + durationMS.ToString() + "ms\n");
+
+        auto statistics = m_saveQueue->GetStatistics();
+        Log::Write("Saves requested: %llu, written: %llu, coalesced: %llu, failed: %llu, dropped: %llu\n",
+            statistics.requested, statistics.written, statistics.coalesced, statistics.failed, statistics.dropped);
+
+        return flushed;
+    });
+}
+
+void GameSaveManager::SetSaveCoalesceWindow(std::chrono::milliseconds coalesceWindow)
+{
+    m_saveQueue->SetCoalesceWindow(coalesceWindow);
+}
+
+GameSaveWriteQueue::Statistics GameSaveManager::GetSaveStatistics()
+{
+    return m_saveQueue->GetStatistics();
+}
+
 void GameSaveManager::WriteGameSaveMetadataToDisplayLog(bool listBlobs)
 {
     if (m_gameBoardIndex == nullptr)
@@ -336,13 +428,20 @@ void GameSaveManager::WriteGameSaveMetadataToDisplayLog(bool listBlobs)
         return;
     }
 
-    WriteContainerMetadataToDisplayLog(listBlobs, m_gameBoardIndex->m_containerMetadata);
+    // the index is listed even if it isn't on disk yet
+    auto indexMetadata = GetContainerMetadata(m_gameBoardIndex->m_containerMetadata->m_containerName);
+    if (indexMetadata == nullptr)
+    {
+        indexMetadata = m_gameBoardIndex->m_containerMetadata;
+    }
+    WriteContainerMetadataToDisplayLog(listBlobs, indexMetadata);
 
     for (auto gameSave : m_gameBoardSaves)
     {
-        if (gameSave->m_containerMetadata->m_isGameDataOnDisk)
+        auto containerMetadata = GetContainerMetadata(gameSave->m_containerMetadata->m_containerName);
+        if (containerMetadata != nullptr && containerMetadata->m_isGameDataOnDisk)
         {
-            WriteContainerMetadataToDisplayLog(listBlobs, gameSave->m_containerMetadata);
+            WriteContainerMetadataToDisplayLog(listBlobs, containerMetadata);
         }
     }
 }
@@ -360,7 +459,7 @@ task<bool> GameSaveManager::LoadIndex()
     Platform::String^ indexContainerDisplayName = ref new Platform::String(GAME_BOARD_INDEX_DISPLAY_NAME);
     auto container = m_gameSaveProvider->CreateContainer(indexContainerName);
 
-    m_gameBoardIndex = std::make_unique<GameSave<GameBoardIndex>>(indexContainerName, indexContainerDisplayName, fnSaveContainerIndex);
+    m_gameBoardIndex = std::make_shared<GameSave<GameBoardIndex>>(indexContainerName, indexContainerDisplayName, fnSaveContainerIndex);
 
     return m_gameBoardIndex->Read(container).then([this, container](bool loadSuccess)
     {
@@ -404,7 +503,7 @@ task<bool> GameSaveManager::SaveIndex(bool saveOnlyIfDirty)
     Log::WriteAndDisplay("Saving game board index...\n");
 
     auto container = m_gameSaveProvider->CreateContainer(m_gameBoardIndex->m_containerMetadata->m_containerName);
-    return m_gameBoardIndex->Save(container).then([](bool saveSuccess)
+    return QueueSave(*m_saveQueue, m_gameBoardIndex, container, !saveOnlyIfDirty).then([](bool saveSuccess)
     {
         if (saveSuccess)
         {
@@ -432,21 +531,27 @@ task<bool> GameSaveManager::Delete()
 
     Platform::String^ containerToDelete = m_gameBoardSaves[activeBoard - 1]->m_containerMetadata->m_containerName;
 
-    return create_task(m_gameSaveProvider->DeleteContainerAsync(containerToDelete)).then([=](task<void> t)
+    // the delete goes through the save queue, so it waits for a save of the board in progress, and a waiting save
+    // is dropped rather than writing the board again after it has been deleted
+    return QueueContainerOperation(*m_saveQueue, containerToDelete, [=]
     {
-        try
+        return create_task(m_gameSaveProvider->DeleteContainerAsync(containerToDelete)).then([=](task<void> t)
         {
-            t.get();
-            Log::WriteAndDisplay("Game board %d deleted\n", activeBoard);
-            m_gameBoardSaves[activeBoard - 1]->ResetData();
-            return true;
-        }
-        catch (Platform::Exception^ ex)
-        {
-            Log::WriteAndDisplay("ERROR: Game board %d delete FAILED (%ws)\n", activeBoard, GetErrorStringForException(ex)->Data());
-        }
+            try
+            {
+                t.get();
+                Log::WriteAndDisplay("Game board %d deleted\n", activeBoard);
+                m_gameBoardSaves[activeBoard - 1]->ResetData();
+                m_metadataCache->Remove(containerToDelete->Data());
+                return true;
+            }
+            catch (Platform::Exception^ ex)
+            {
+                Log::WriteAndDisplay("ERROR: Game board %d delete FAILED (%ws)\n", activeBoard, GetErrorStringForException(ex)->Data());
+            }
 
-        return false;
+            return false;
+        });
     });
 }
 
@@ -462,7 +567,11 @@ Concurrency::task<bool> GameSaveManager::DeleteBlobs()
     Log::WriteAndDisplay("Deleting game board %d blobs (SubmitUpdatesAsync)...\n", activeBoard);
 
     auto container = m_gameSaveProvider->CreateContainer(m_gameBoardSaves[activeBoard - 1]->m_containerMetadata->m_containerName);
-    return m_gameBoardSaves[activeBoard - 1]->DeleteBlobs(container).then([activeBoard](bool deleteSuccess)
+    auto gameSave = m_gameBoardSaves[activeBoard - 1];
+    return QueueContainerOperation(*m_saveQueue, container->Name, [gameSave, container]
+    {
+        return gameSave->DeleteBlobs(container);
+    }).then([activeBoard](bool deleteSuccess)
     {
         if (deleteSuccess)
         {
@@ -548,7 +657,7 @@ task<bool> GameSaveManager::Save(bool saveOnlyIfDirty)
     Log::WriteAndDisplay("Saving game board %d (SubmitUpdatesAsync)...\n", activeBoard);
 
     auto container = m_gameSaveProvider->CreateContainer(m_gameBoardSaves[activeBoard - 1]->m_containerMetadata->m_containerName);
-    return m_gameBoardSaves[activeBoard - 1]->Save(container).then([activeBoard](bool saveSuccess)
+    return QueueSave(*m_saveQueue, m_gameBoardSaves[activeBoard - 1], container, !saveOnlyIfDirty).then([activeBoard](bool saveSuccess)
     {
         if (saveSuccess)
         {
@@ -574,7 +683,208 @@ void GameSaveManager::MarkActiveBoardDirty()
     }
 }
 
-void GameSaveManager::WriteContainerMetadataToDisplayLog(bool listBlobs, std::shared_ptr<GameSaveContainerMetadata> containerMetadata)
+task<void> GameSaveManager::LoadAllBoards()
+{
+    if (m_gameSaveProvider == nullptr)
+    {
+        return create_task([] {});
+    }
+
+    Log::WriteAndDisplay("Loading game boards...\n");
+
+    std::vector<uint32_t> boardNumbers;
+    for (uint32_t boardNumber = 1; boardNumber <= m_gameBoardSaves.size(); ++boardNumber)
+    {
+        boardNumbers.push_back(boardNumber);
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    return ReadBoards(std::move(boardNumbers), cancellation_token::none(), false).then([this, start]
+    {
+        auto stop = std::chrono::high_resolution_clock::now();
+        auto durationMS = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
+        Log::Write("LoadAllBoards duration: " + durationMS.ToString() + "ms\n");
+
+        auto loadedCount = std::count_if(m_gameBoardSaves.begin(), m_gameBoardSaves.end(), [](std::shared_ptr<GameSave<GameBoard>> gameBoardSave)
+        {
+            return gameBoardSave->m_isGameDataLoaded;
+        });
+        Log::WriteAndDisplay("Game boards loaded (%u of %u)\n", static_cast<uint32_t>(loadedCount), static_cast<uint32_t>(m_gameBoardSaves.size()));
+    });
+}
+
+void GameSaveManager::PrefetchBoards(uint32_t activeBoard)
+{
+    if (m_gameSaveProvider == nullptr || activeBoard == 0 || activeBoard > m_gameBoardSaves.size())
+    {
+        return;
+    }
+
+    // the active board is read first, then its neighbours
+    std::vector<uint32_t> boardNumbers;
+    boardNumbers.push_back(activeBoard);
+    if (activeBoard > 1)
+    {
+        boardNumbers.push_back(activeBoard - 1);
+    }
+    if (activeBoard < m_gameBoardSaves.size())
+    {
+        boardNumbers.push_back(activeBoard + 1);
+    }
+
+    cancellation_token token = cancellation_token::none();
+    {
+        std::lock_guard<std::mutex> lock(m_boardReadMutex);
+
+        // reads queued for the boards around the previous active board are no longer wanted (reads already in flight finish)
+        m_prefetchCancellation.cancel();
+        m_prefetchCancellation = cancellation_token_source();
+        token = m_prefetchCancellation.get_token();
+
+        // the boards wanted now are the last to be unloaded
+        for (auto boardNumber = boardNumbers.rbegin(); boardNumber != boardNumbers.rend(); ++boardNumber)
+        {
+            auto prefetchedBoard = std::find(m_prefetchedBoards.begin(), m_prefetchedBoards.end(), *boardNumber);
+            if (prefetchedBoard != m_prefetchedBoards.end())
+            {
+                m_prefetchedBoards.splice(m_prefetchedBoards.begin(), m_prefetchedBoards, prefetchedBoard);
+            }
+        }
+
+        // the prefetch made when the user is initialized may race a switch, which trims the boards itself once it has set the new active board
+        if (activeBoard == ActiveBoardNumber)
+        {
+            TrimPrefetchedBoards(activeBoard);
+        }
+    }
+
+    Log::Write("GameSaveManager::PrefetchBoards(%u)\n", activeBoard);
+
+    ReadBoards(std::move(boardNumbers), token, true);
+}
+
+task<void> GameSaveManager::ReadBoards(std::vector<uint32_t> boardNumbers, cancellation_token token, bool isPrefetch)
+{
+    std::vector<GameSaveMetadataCache::Query> boardReads;
+    for (auto boardNumber : boardNumbers)
+    {
+        boardReads.push_back([this, boardNumber, token, isPrefetch]() -> task<void>
+        {
+            if (token.is_canceled() || m_gameSaveProvider == nullptr)
+            {
+                return task_from_result();
+            }
+
+            // a board is only read if there is something on disk to read, and never over changes which haven't been saved yet
+            auto gameSave = m_gameBoardSaves[boardNumber - 1];
+            auto containerMetadata = GetContainerMetadata(gameSave->m_containerMetadata->m_containerName);
+            if (gameSave->IsDirtyOrLoaded() || containerMetadata == nullptr || !containerMetadata->m_isGameDataOnDisk)
+            {
+                return task_from_result();
+            }
+
+            return ReadBoard(boardNumber).then([this, boardNumber, token, isPrefetch](bool loadSuccess)
+            {
+                if (!loadSuccess || !isPrefetch)
+                {
+                    return;
+                }
+
+                // the board is only unloaded by the next prefetch, on the thread which changes the active board, so that the active board
+                // is never unloaded as it changes
+                std::lock_guard<std::mutex> lock(m_boardReadMutex);
+                if (std::find(m_prefetchedBoards.begin(), m_prefetchedBoards.end(), boardNumber) == m_prefetchedBoards.end())
+                {
+                    // a board read for a previous active board is the first to be unloaded
+                    if (token.is_canceled())
+                    {
+                        m_prefetchedBoards.push_back(boardNumber);
+                    }
+                    else
+                    {
+                        m_prefetchedBoards.push_front(boardNumber);
+                    }
+                }
+            });
+        });
+    }
+
+    return GameSaveMetadataCache::RunQueries(std::move(boardReads), BOARD_LOAD_CONCURRENCY);
+}
+
+task<bool> GameSaveManager::ReadBoard(uint32_t boardNumber)
+{
+    std::lock_guard<std::mutex> lock(m_boardReadMutex);
+
+    auto boardRead = m_boardReads.find(boardNumber);
+    if (boardRead != m_boardReads.end())
+    {
+        return boardRead->second;
+    }
+
+    Log::Write("Loading game board %d (ReadAsync)...\n", boardNumber);
+
+    auto gameSave = m_gameBoardSaves[boardNumber - 1];
+    auto container = m_gameSaveProvider->CreateContainer(gameSave->m_containerMetadata->m_containerName);
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // the continuation takes the lock, so it can't remove the read before it is added; the data read is discarded if the board is
+    // changed or loaded some other way while it is in flight
+    auto readTask = gameSave->Read(container, true).then([this, gameSave, boardNumber, start](task<bool> t)
+    {
+        bool loadSuccess = false;
+        try
+        {
+            loadSuccess = t.get();
+        }
+        catch (Platform::Exception^ ex)
+        {
+            Log::WriteAndDisplay("ERROR: Game board %d read threw exception (%ws)\n", boardNumber, GetErrorStringForException(ex)->Data());
+        }
+
+        auto stop = std::chrono::high_resolution_clock::now();
+        auto durationMS = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
+        if (loadSuccess)
+        {
+            Log::Write("Game board %d loaded (" + durationMS.ToString() + "ms)\n", boardNumber);
+        }
+        else if (gameSave->IsDirtyOrLoaded())
+        {
+            Log::Write("Game board %d changed while it was being read, read discarded\n", boardNumber);
+        }
+        else
+        {
+            Log::WriteAndDisplay("ERROR: Game board %d load FAILED\n", boardNumber);
+        }
+
+        std::lock_guard<std::mutex> lock(m_boardReadMutex);
+        m_boardReads.erase(boardNumber);
+
+        return loadSuccess;
+    });
+
+    m_boardReads[boardNumber] = readTask;
+    return readTask;
+}
+
+void GameSaveManager::TrimPrefetchedBoards(uint32_t activeBoard)
+{
+    while (m_prefetchedBoards.size() > BOARD_PREFETCH_CAPACITY)
+    {
+        auto boardNumber = m_prefetchedBoards.back();
+        m_prefetchedBoards.pop_back();
+
+        // a board that has become active, has unsaved changes, or is being read again is left loaded
+        auto gameSave = m_gameBoardSaves[boardNumber - 1];
+        if (boardNumber != activeBoard && m_boardReads.find(boardNumber) == m_boardReads.end() && gameSave->ResetDataIfNotDirty())
+        {
+            Log::Write("Unloaded prefetched game board %d\n", boardNumber);
+        }
+    }
+}
+
+void GameSaveManager::WriteContainerMetadataToDisplayLog(bool listBlobs, std::shared_ptr<const GameSaveContainerMetadata> containerMetadata)
 {
     Platform::String^ containerLog = containerMetadata->m_containerDisplayName;
     containerLog += " (" + containerMetadata->m_totalSize + " bytes)";
@@ -0,0 +1,33 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#pragma once
+
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+namespace GameSaveSample
+{
+    // Runs asynchronous queries with a bound on how many are in flight at once. It knows nothing about how a query runs:
+    // each is started with a completion function, which it calls once it has finished, on any thread.
+    class GameSaveQueryRunner
+    {
+    public:
+        typedef std::function<void(bool success)> CompletionFunction;
+
+        // Starts a query, which must call onComplete exactly once, either before returning or later. A query which
+        // throws without calling onComplete is counted as failed.
+        typedef std::function<void(CompletionFunction onComplete)> StartFunction;
+
+        typedef std::function<void(uint32_t failures)> FinishedFunction;
+
+        // Starts queries in order, with no more than maxConcurrent in flight, and calls onFinished with the number of
+        // queries which failed once they have all completed. A query which fails doesn't stop the others.
+        static void Run(std::vector<StartFunction> queries, size_t maxConcurrent, FinishedFunction onFinished);
+    };
+}
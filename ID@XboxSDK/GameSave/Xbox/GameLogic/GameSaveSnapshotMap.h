@@ -0,0 +1,162 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#pragma once
+
+#include <stdint.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace GameSaveSample
+{
+    // Values keyed by name, published as immutable snapshots: each update builds a new map and swaps it in, so readers
+    // take a reference to the current snapshot without locking, and never see an entry half updated.
+    //
+    // Updates are numbered. A query takes the generation before it starts and publishes its results with it; any entry
+    // which has been published or removed since then is left as it is, so a slow query can't overwrite newer results
+    // or bring back an entry which was removed while it ran.
+    template<typename TValue>
+    class GameSaveSnapshotMap
+    {
+    public:
+        typedef std::map<std::wstring, std::shared_ptr<const TValue>> Map;
+        typedef std::vector<std::pair<std::wstring, std::shared_ptr<const TValue>>> Entries;
+
+        GameSaveSnapshotMap() :
+            m_snapshot(std::make_shared<const Map>()),
+            m_generation(0),
+            m_clearedAt(0)
+        {}
+
+        GameSaveSnapshotMap(const GameSaveSnapshotMap&) = delete;
+        GameSaveSnapshotMap& operator=(const GameSaveSnapshotMap&) = delete;
+
+        // The current snapshot; never null, and never changed once published
+        std::shared_ptr<const Map> GetSnapshot() const
+        {
+            return std::atomic_load(&m_snapshot);
+        }
+
+        std::shared_ptr<const TValue> Find(const std::wstring& name) const
+        {
+            auto snapshot = GetSnapshot();
+            auto it = snapshot->find(name);
+            return (it != snapshot->end()) ? it->second : nullptr;
+        }
+
+        // The generation to publish the results of a query started now with
+        uint64_t GetGeneration() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_generation;
+        }
+
+        // Replaces the entries whose names start with prefix (every entry if it is empty) with entries, the result of a
+        // query started at generation; other entries are kept. Returns the number of names left as they were because
+        // they changed after the query started.
+        size_t Publish(const std::wstring& prefix, const Entries& entries, uint64_t generation)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            auto current = GetSnapshot();
+            if (generation < m_clearedAt)
+            {
+                return current->size() + entries.size();
+            }
+
+            size_t skipped = 0;
+            std::vector<std::wstring> updated;
+
+            auto snapshot = std::make_shared<Map>();
+            for (auto& entry : *current)
+            {
+                if (entry.first.compare(0, prefix.length(), prefix) != 0)
+                {
+                    snapshot->insert(entry);
+                }
+                else if (IsChangedSince(entry.first, generation))
+                {
+                    snapshot->insert(entry);
+                    ++skipped;
+                }
+                else
+                {
+                    updated.push_back(entry.first);
+                }
+            }
+
+            for (auto& entry : entries)
+            {
+                if (IsChangedSince(entry.first, generation))
+                {
+                    // an entry which is still there was counted above
+                    if (current->find(entry.first) == current->end())
+                    {
+                        ++skipped;
+                    }
+                    continue;
+                }
+
+                (*snapshot)[entry.first] = entry.second;
+                updated.push_back(entry.first);
+            }
+
+            ++m_generation;
+            for (auto& name : updated)
+            {
+                m_changedAt[name] = m_generation;
+            }
+
+            std::atomic_store(&m_snapshot, std::shared_ptr<const Map>(snapshot));
+            return skipped;
+        }
+
+        void Remove(const std::wstring& name)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            // Recorded even if there is no entry yet, so a query already running doesn't add it
+            m_changedAt[name] = ++m_generation;
+
+            auto current = GetSnapshot();
+            if (current->find(name) == current->end())
+            {
+                return;
+            }
+
+            auto snapshot = std::make_shared<Map>(*current);
+            snapshot->erase(name);
+            std::atomic_store(&m_snapshot, std::shared_ptr<const Map>(snapshot));
+        }
+
+        void Clear()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            m_clearedAt = ++m_generation;
+            m_changedAt.clear();
+            std::atomic_store(&m_snapshot, std::make_shared<const Map>());
+        }
+
+    private:
+        bool IsChangedSince(const std::wstring& name, uint64_t generation) const
+        {
+            auto it = m_changedAt.find(name);
+            return it != m_changedAt.end() && it->second > generation;
+        }
+
+        mutable std::mutex                  m_mutex;        // Serializes updates, which copy the snapshot; readers don't take it
+        std::shared_ptr<const Map>          m_snapshot;     // Accessed with std::atomic_load and std::atomic_store
+        uint64_t                            m_generation;   // Incremented by every update
+        uint64_t                            m_clearedAt;
+        std::map<std::wstring, uint64_t>    m_changedAt;    // The generation of the last update of each name, including removals
+    };
+}
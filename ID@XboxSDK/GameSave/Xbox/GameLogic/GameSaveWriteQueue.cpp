@@ -0,0 +1,251 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#include "pch.h"
+#include "GameSaveWriteQueue.h"
+#include <algorithm>
+
+using namespace GameSaveSample;
+
+GameSaveWriteQueue::GameSaveWriteQueue(std::chrono::milliseconds coalesceWindow) :
+    m_coalesceWindow(coalesceWindow),
+    m_flushCount(0),
+    m_isWriting(false),
+    m_stop(false),
+    m_statistics{}
+{
+    m_worker = std::thread([this] { WorkerThread(); });
+}
+
+GameSaveWriteQueue::~GameSaveWriteQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+
+    m_wake.notify_all();
+    m_worker.join();
+
+    Clear();
+}
+
+void GameSaveWriteQueue::Enqueue(
+    const std::wstring& key,
+    SnapshotFunction snapshot,
+    WriteFunction write,
+    CompletionFunction onComplete,
+    bool immediate)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    ++m_statistics.requested;
+
+    auto due = Clock::now();
+    if (!immediate)
+    {
+        due += m_coalesceWindow;
+    }
+
+    auto it = FindWaitingWrite(key);
+    if (it != m_pending.end())
+    {
+        // The window runs from the first request, so repeated saves can't hold a write back indefinitely
+        ++m_statistics.coalesced;
+        it->snapshot = std::move(snapshot);
+        it->write = std::move(write);
+        it->due = std::min(it->due, due);
+        if (onComplete)
+        {
+            it->completions.push_back(std::move(onComplete));
+        }
+    }
+    else
+    {
+        m_pending.emplace_back();
+        auto& pending = m_pending.back();
+        pending.key = key;
+        pending.snapshot = std::move(snapshot);
+        pending.write = std::move(write);
+        pending.due = due;
+        pending.isOperation = false;
+        if (onComplete)
+        {
+            pending.completions.push_back(std::move(onComplete));
+        }
+    }
+
+    lock.unlock();
+    m_wake.notify_one();
+}
+
+void GameSaveWriteQueue::EnqueueOperation(
+    const std::wstring& key,
+    OperationFunction operation,
+    CompletionFunction onComplete)
+{
+    std::list<PendingWrite> dropped;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_statistics.requested;
+
+        auto it = FindWaitingWrite(key);
+        if (it != m_pending.end())
+        {
+            dropped.splice(dropped.end(), m_pending, it);
+            ++m_statistics.dropped;
+        }
+
+        m_pending.emplace_back();
+        auto& pending = m_pending.back();
+        pending.key = key;
+        pending.write = [operation](const BlobData&) { return operation(); };
+        pending.due = Clock::now();
+        pending.isOperation = true;
+        if (onComplete)
+        {
+            pending.completions.push_back(std::move(onComplete));
+        }
+    }
+
+    m_wake.notify_one();
+
+    for (auto& pending : dropped)
+    {
+        Complete(pending.completions, false);
+    }
+}
+
+bool GameSaveWriteQueue::Flush(std::chrono::milliseconds timeout)
+{
+    auto deadline = Clock::now() + timeout;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    ++m_flushCount;
+    m_wake.notify_one();
+
+    bool flushed = m_idle.wait_until(lock, deadline, [this] { return m_pending.empty() && !m_isWriting; });
+
+    --m_flushCount;
+    return flushed;
+}
+
+void GameSaveWriteQueue::Remove(const std::wstring& key)
+{
+    std::list<PendingWrite> dropped;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = FindWaitingWrite(key);
+        if (it == m_pending.end())
+        {
+            return;
+        }
+
+        dropped.splice(dropped.end(), m_pending, it);
+        ++m_statistics.dropped;
+    }
+
+    m_idle.notify_all();
+    Complete(dropped.front().completions, false);
+}
+
+void GameSaveWriteQueue::Clear()
+{
+    std::list<PendingWrite> dropped;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        dropped.swap(m_pending);
+        m_statistics.dropped += dropped.size();
+    }
+
+    m_idle.notify_all();
+
+    for (auto& pending : dropped)
+    {
+        Complete(pending.completions, false);
+    }
+}
+
+void GameSaveWriteQueue::SetCoalesceWindow(std::chrono::milliseconds coalesceWindow)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_coalesceWindow = coalesceWindow;
+}
+
+GameSaveWriteQueue::Statistics GameSaveWriteQueue::GetStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_statistics;
+}
+
+void GameSaveWriteQueue::WorkerThread()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (!m_stop)
+    {
+        if (m_pending.empty())
+        {
+            m_wake.wait(lock);
+            continue;
+        }
+
+        auto next = std::min_element(m_pending.begin(), m_pending.end(), [](const PendingWrite& a, const PendingWrite& b) { return a.due < b.due; });
+        if (m_flushCount == 0 && next->due > Clock::now())
+        {
+            m_wake.wait_until(lock, next->due);
+            continue;
+        }
+
+        PendingWrite pending = std::move(*next);
+        m_pending.erase(next);
+        m_isWriting = true;
+
+        BlobData snapshot;
+        if (!m_bufferPool.empty())
+        {
+            snapshot = std::move(m_bufferPool.back());
+            m_bufferPool.pop_back();
+        }
+
+        lock.unlock();
+
+        if (!pending.isOperation)
+        {
+            pending.snapshot(snapshot);
+        }
+        bool success = pending.write(snapshot);
+        Complete(pending.completions, success);
+
+        lock.lock();
+
+        m_bufferPool.push_back(std::move(snapshot));
+        if (success)
+        {
+            ++m_statistics.written;
+        }
+        else
+        {
+            ++m_statistics.failed;
+        }
+
+        m_isWriting = false;
+        m_idle.notify_all();
+    }
+}
+
+std::list<GameSaveWriteQueue::PendingWrite>::iterator GameSaveWriteQueue::FindWaitingWrite(const std::wstring& key)
+{
+    return std::find_if(m_pending.begin(), m_pending.end(), [&key](const PendingWrite& pending) { return pending.key == key && !pending.isOperation; });
+}
+
+void GameSaveWriteQueue::Complete(std::vector<CompletionFunction>& completions, bool success)
+{
+    for (auto& onComplete : completions)
+    {
+        onComplete(success);
+    }
+}
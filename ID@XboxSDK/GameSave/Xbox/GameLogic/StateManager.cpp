@@ -144,6 +144,7 @@ void StateManager::Suspend(Windows::ApplicationModel::SuspendingDeferral^ deferr
     Game->GameSaveManager->Suspend().then([deferral]
     {
         Log::WriteAndDisplay("OnSuspending() complete\n");
+        Log::Flush();
         deferral->Complete();
     });
 }
@@ -0,0 +1,307 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#include "pch.h"
+#include "WordGraph.h"
+#include <algorithm>
+#include <map>
+
+using namespace GameSaveSample;
+
+namespace
+{
+    // Serialized graph: header, then the edges. Node n is the run of edges starting at edge n and ending with an edge
+    // with c_lastEdge set. Edge 0 is a node with no edges (it matches no letter), so a child of 0 means no children.
+    //
+    // Edge: bits 0-4 letter (0 = 'A'), bit 5 the word ends here, bit 6 last edge of its node, bits 8-31 child node
+    const uint32_t  c_graphMagic = 0x47414457; // "WDAG"
+    const uint16_t  c_graphVersion = 1;
+    const uint32_t  c_graphHeaderSize = 4 + 2 + 2 + 4 + 4 + 4; // magic, version, reserved, edge count, root, word count
+
+    const uint32_t  c_letterMask = 0x1F;
+    const uint32_t  c_endOfWord = 1 << 5;
+    const uint32_t  c_lastEdge = 1 << 6;
+    const uint32_t  c_childShift = 8;
+    const uint32_t  c_maxEdges = 1 << (32 - c_childShift);
+    const uint32_t  c_noLetter = c_letterMask;
+    const uint32_t  c_letterCount = 26;
+
+    void WriteUInt32(uint8_t* dest, uint32_t value)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            dest[i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
+
+    uint32_t ReadUInt32(const uint8_t* src)
+    {
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            value |= uint32_t(src[i]) << (8 * i);
+        }
+        return value;
+    }
+
+    uint32_t GetLetterIndex(wchar_t letter)
+    {
+        return (letter >= L'A' && letter <= L'Z') ? uint32_t(letter - L'A') : c_noLetter;
+    }
+
+    // Builds the trie of the words, and merges identical subtrees as it goes
+    class GraphBuilder
+    {
+    public:
+        struct Edge
+        {
+            uint32_t    m_letter;
+            bool        m_endOfWord;
+            uint32_t    m_child;    // unique node id; 0 is the node with no edges
+        };
+
+        typedef std::vector<Edge> NodeEdges;
+
+        GraphBuilder()
+        {
+            m_nodes.push_back(NodeEdges()); // node 0
+        }
+
+        // Adds the unique node for the trie of words [begin, end), which all share their first depth letters
+        uint32_t AddNode(const std::vector<std::string>& words, size_t begin, size_t end, size_t depth)
+        {
+            NodeEdges edges;
+            while (begin < end)
+            {
+                if (words[begin].length() <= depth)
+                {
+                    ++begin; // the word ended at the edge into this node
+                    continue;
+                }
+
+                char letter = words[begin][depth];
+                size_t next = begin;
+                while (next < end && words[next].length() > depth && words[next][depth] == letter)
+                {
+                    ++next;
+                }
+
+                Edge edge;
+                edge.m_letter = uint32_t(letter - 'A');
+                edge.m_endOfWord = words[begin].length() == depth + 1;
+                edge.m_child = AddNode(words, begin, next, depth + 1);
+                edges.push_back(edge);
+
+                begin = next;
+            }
+
+            if (edges.empty())
+            {
+                return 0;
+            }
+
+            std::vector<uint32_t> signature;
+            for (auto& edge : edges)
+            {
+                signature.push_back(edge.m_letter | (edge.m_endOfWord ? c_endOfWord : 0));
+                signature.push_back(edge.m_child);
+            }
+
+            auto it = m_uniqueNodes.find(signature);
+            if (it != m_uniqueNodes.end())
+            {
+                return it->second;
+            }
+
+            uint32_t node = static_cast<uint32_t>(m_nodes.size());
+            m_nodes.push_back(edges);
+            m_uniqueNodes[signature] = node;
+            return node;
+        }
+
+        // Lays out the nodes reachable from root as edges, root first. Returns false if there are too many edges.
+        bool Layout(uint32_t root, std::vector<uint32_t>& edges) const
+        {
+            // the position of each node's first edge
+            std::vector<uint32_t> offsets(m_nodes.size(), 0);
+            std::vector<uint32_t> order;
+            uint64_t edgeCount = 1;
+            if (root != 0)
+            {
+                order.push_back(root);
+                offsets[root] = 1;
+                edgeCount += m_nodes[root].size();
+            }
+
+            for (size_t i = 0; i < order.size(); ++i)
+            {
+                for (auto& edge : m_nodes[order[i]])
+                {
+                    if (edge.m_child != 0 && offsets[edge.m_child] == 0)
+                    {
+                        order.push_back(edge.m_child);
+                        offsets[edge.m_child] = static_cast<uint32_t>(edgeCount);
+                        edgeCount += m_nodes[edge.m_child].size();
+                    }
+                }
+            }
+
+            if (edgeCount > c_maxEdges)
+            {
+                return false;
+            }
+
+            edges.clear();
+            edges.push_back(c_noLetter | c_lastEdge);
+            for (auto node : order)
+            {
+                auto& nodeEdges = m_nodes[node];
+                for (size_t i = 0; i < nodeEdges.size(); ++i)
+                {
+                    auto& edge = nodeEdges[i];
+                    edges.push_back(edge.m_letter
+                        | (edge.m_endOfWord ? c_endOfWord : 0)
+                        | ((i + 1 == nodeEdges.size()) ? c_lastEdge : 0)
+                        | (offsets[edge.m_child] << c_childShift));
+                }
+            }
+
+            return true;
+        }
+
+    private:
+        std::vector<NodeEdges>                          m_nodes;
+        std::map<std::vector<uint32_t>, uint32_t>       m_uniqueNodes;
+    };
+}
+
+WordGraph::WordGraph() :
+    m_edges(nullptr),
+    m_root(c_emptyNode),
+    m_wordCount(0)
+{
+}
+
+std::vector<uint8_t> WordGraph::Build(std::vector<std::string> words)
+{
+    for (auto& word : words)
+    {
+        if (word.empty() || !std::all_of(word.begin(), word.end(), [](char letter) { return letter >= 'A' && letter <= 'Z'; }))
+        {
+            return std::vector<uint8_t>();
+        }
+    }
+
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+
+    GraphBuilder builder;
+    uint32_t root = builder.AddNode(words, 0, words.size(), 0);
+
+    std::vector<uint32_t> edges;
+    if (!builder.Layout(root, edges))
+    {
+        return std::vector<uint8_t>();
+    }
+
+    std::vector<uint8_t> data(c_graphHeaderSize + edges.size() * sizeof(uint32_t));
+    WriteUInt32(data.data(), c_graphMagic);
+    data[4] = static_cast<uint8_t>(c_graphVersion);
+    data[5] = static_cast<uint8_t>(c_graphVersion >> 8);
+    data[6] = data[7] = 0;
+    WriteUInt32(data.data() + 8, static_cast<uint32_t>(edges.size()));
+    WriteUInt32(data.data() + 12, (root != 0) ? 1 : 0);
+    WriteUInt32(data.data() + 16, static_cast<uint32_t>(words.size()));
+
+    for (size_t i = 0; i < edges.size(); ++i)
+    {
+        WriteUInt32(data.data() + c_graphHeaderSize + i * sizeof(uint32_t), edges[i]);
+    }
+
+    return data;
+}
+
+bool WordGraph::Load(std::vector<uint8_t> data)
+{
+    if (data.size() < c_graphHeaderSize
+        || ReadUInt32(data.data()) != c_graphMagic
+        || (data[4] | (data[5] << 8)) != c_graphVersion)
+    {
+        return false;
+    }
+
+    uint32_t edgeCount = ReadUInt32(data.data() + 8);
+    uint32_t root = ReadUInt32(data.data() + 12);
+    uint32_t wordCount = ReadUInt32(data.data() + 16);
+    if (edgeCount == 0 || edgeCount > c_maxEdges || data.size() != c_graphHeaderSize + size_t(edgeCount) * sizeof(uint32_t) || root >= edgeCount)
+    {
+        return false;
+    }
+
+    // edges are read in place (the platforms this runs on are all little-endian)
+    auto edges = reinterpret_cast<const uint32_t*>(data.data() + c_graphHeaderSize);
+
+    // every edge must lead to a node in the graph, and the last edge must end a node, so no walk can leave the graph
+    if ((edges[0] & c_lastEdge) == 0 || (edges[edgeCount - 1] & c_lastEdge) == 0)
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < edgeCount; ++i)
+    {
+        if ((edges[i] >> c_childShift) >= edgeCount)
+        {
+            return false;
+        }
+    }
+
+    m_data = std::move(data);
+    m_edges = reinterpret_cast<const uint32_t*>(m_data.data() + c_graphHeaderSize);
+    m_root = root;
+    m_wordCount = wordCount;
+    return true;
+}
+
+bool WordGraph::Next(Node& node, wchar_t letter, bool& isWord) const
+{
+    uint32_t letterIndex = GetLetterIndex(letter);
+    if (m_edges == nullptr || letterIndex >= c_letterCount)
+    {
+        return false;
+    }
+
+    for (uint32_t i = node; ; ++i)
+    {
+        uint32_t edge = m_edges[i];
+        if ((edge & c_letterMask) == letterIndex)
+        {
+            isWord = (edge & c_endOfWord) != 0;
+            node = edge >> c_childShift;
+            return true;
+        }
+
+        if (edge & c_lastEdge)
+        {
+            return false;
+        }
+    }
+}
+
+bool WordGraph::Contains(const wchar_t* word, size_t length) const
+{
+    Node node = m_root;
+    bool isWord = false;
+    for (size_t i = 0; i < length; ++i)
+    {
+        if (!Next(node, word[i], isWord))
+        {
+            return false;
+        }
+    }
+
+    return isWord;
+}
@@ -51,6 +51,7 @@ performance_counters::get_capture_instace(
     _In_ const string_t& metadata
     )
 {
+    std::lock_guard<std::mutex> guard(m_lock);
     auto iter = m_performanceCaptureMap.find(metadata);
     if (iter == m_performanceCaptureMap.end())
     {
@@ -65,6 +66,7 @@ performance_counters::get_capture_instace(
 void
 performance_counters::clear_captured_data()
 {
+    std::lock_guard<std::mutex> guard(m_lock);
     m_performanceCaptureMap.clear();
 }
 
@@ -87,12 +89,14 @@ performance_capture::performance_capture(
 void
 performance_capture::_Start()
 {
+    std::lock_guard<std::mutex> guard(m_lock);
     QueryPerformanceCounter(&m_startTime);
 }
 
 void
 performance_capture::_End()
 {
+    std::lock_guard<std::mutex> guard(m_lock);
     QueryPerformanceCounter(&m_endTime);
     update();
 }
@@ -3,6 +3,8 @@
 
 #pragma once
 
+#include <mutex>
+
 class performance_capture
 {
 public:
@@ -10,9 +12,9 @@ public:
         _In_ string_t metadata
         );
 
-    double min_time() const { return m_minTime; }
-    double max_time() const { return m_maxTime; }
-    double average_time() const { return m_averageTime; }
+    double min_time() const { std::lock_guard<std::mutex> guard(m_lock); return m_minTime; }
+    double max_time() const { std::lock_guard<std::mutex> guard(m_lock); return m_maxTime; }
+    double average_time() const { std::lock_guard<std::mutex> guard(m_lock); return m_averageTime; }
     const string_t& capture_metadata() const { return m_metadata; }
 
     void _Start();
@@ -37,6 +39,8 @@ private:
     LARGE_INTEGER m_startTime;
     LARGE_INTEGER m_endTime;
     LARGE_INTEGER m_frequency;
+
+    mutable std::mutex m_lock;
 };
 
 class performance_counters
@@ -79,5 +83,6 @@ private:
     performance_counters(const performance_counters&);
     void operator=(const performance_counters&);
 
+    std::mutex m_lock;
     std::unordered_map<string_t, std::shared_ptr<performance_capture>> m_performanceCaptureMap;
 };
\ No newline at end of file
@@ -0,0 +1,726 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "pch.h"
+#include "CPUProfiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <climits>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <string>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define USE_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define USE_TSC
+#endif
+
+#ifndef _WIN32
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#endif
+
+using namespace DX;
+
+namespace
+{
+#ifdef _WIN32
+    struct handle_closer { void operator()(HANDLE h) { if (h) CloseHandle(h); } };
+
+    typedef std::unique_ptr<void, handle_closer> ScopedHandle;
+
+    inline HANDLE safe_handle(HANDLE h) { return (h == INVALID_HANDLE_VALUE) ? nullptr : h; }
+#endif
+
+    static_assert((CPUProfiler::c_eventsPerThread & (CPUProfiler::c_eventsPerThread - 1)) == 0, "Ring size must be a power of 2");
+
+    const uint32_t c_invalidNode = uint32_t(-1);
+
+    // Zones captured for a trace before further ones are ignored
+    const size_t c_maxTraceEvents = 4 * 1024 * 1024;
+
+    inline int64_t QPC()
+    {
+#ifdef _WIN32
+        LARGE_INTEGER t;
+        QueryPerformanceCounter(&t);
+        return t.QuadPart;
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    // The time stamp counter is much cheaper to read than QueryPerformanceCounter, and is invariant on
+    // all x64 hardware Windows 10 and Xbox One run on. Its rate is calibrated against QPC (or the steady
+    // clock on other platforms).
+    inline uint64_t ReadTicks()
+    {
+#ifdef USE_TSC
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(QPC());
+#endif
+    }
+
+    // Event with a null name marks the end of the innermost zone.
+    struct Event
+    {
+        uint64_t    ticks;
+        const char* name;
+    };
+
+    // Single-producer, single-consumer ring written by its thread and drained by EndFrame.
+    struct ThreadBuffer
+    {
+        ThreadBuffer(uint32_t threadIndex) :
+            head(0),
+            tail(0),
+            dropped(0),
+            open(0),
+            suppressed(0),
+            index(threadIndex),
+            rootNode(c_invalidNode),
+            name{}
+        {
+        }
+
+        std::atomic<uint32_t>   head;
+        std::atomic<uint32_t>   tail;
+        std::atomic<uint64_t>   dropped;
+
+        // Owned by the recording thread
+        uint32_t                open;           // Zones recorded that haven't ended
+        uint32_t                suppressed;     // Zones dropped that haven't ended
+
+        // Owned by EndFrame
+        struct OpenZone
+        {
+            uint32_t    node;
+            uint64_t    start;
+        };
+
+        uint32_t                index;
+        uint32_t                rootNode;
+        std::vector<OpenZone>   stack;
+        char                    name[32];
+
+        Event                   events[CPUProfiler::c_eventsPerThread];
+    };
+
+    thread_local ThreadBuffer* t_buffer = nullptr;
+}
+
+
+//--------------------------------------------------------------------------------------
+class CPUProfiler::Impl
+{
+public:
+    Impl() :
+        m_ticksPerSecond(1.0),
+        m_calibrationTicks(0),
+        m_calibrationQPC(0),
+        m_qpcFrequency(1),
+        m_frameCount(0),
+        m_capturing(false),
+        m_captureStart(0),
+        m_traceDropped(0)
+    {
+#ifdef _WIN32
+        LARGE_INTEGER freq;
+        if (!QueryPerformanceFrequency(&freq))
+        {
+            throw std::exception("QueryPerformanceFrequency");
+        }
+
+        m_qpcFrequency = freq.QuadPart;
+#else
+        m_qpcFrequency = 1000000000;
+#endif
+        m_calibrationQPC = QPC();
+        m_calibrationTicks = ReadTicks();
+
+#ifdef USE_TSC
+        // Initial estimate of the TSC rate, which is refined every frame
+#ifdef _WIN32
+        Sleep(10);
+#else
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+#endif
+        Calibrate();
+#else
+        m_ticksPerSecond = double(m_qpcFrequency);
+#endif
+    }
+
+    ThreadBuffer* Register()
+    {
+        std::lock_guard<std::mutex> lock(m_threadLock);
+
+        m_threads.emplace_back(new ThreadBuffer(static_cast<uint32_t>(m_threads.size())));
+        auto buffer = m_threads.back().get();
+        snprintf(buffer->name, sizeof(buffer->name), "Thread %u", buffer->index);
+        return buffer;
+    }
+
+    void SetThreadName(ThreadBuffer* buffer, const char* name)
+    {
+        std::lock_guard<std::mutex> lock(m_threadLock);
+        size_t length = std::min(strlen(name), sizeof(buffer->name) - 1);
+        memcpy(buffer->name, name, length);
+        buffer->name[length] = 0;
+    }
+
+    void EndFrame();
+    void GetZoneStats(std::vector<ZoneStats>& stats) const;
+    void Reset();
+    uint64_t GetDroppedZones() const;
+    void BeginCapture();
+    HRESULT EndCapture(const wchar_t* fileName);
+
+    bool IsCapturing() const
+    {
+        std::lock_guard<std::mutex> lock(m_statsLock);
+        return m_capturing;
+    }
+
+private:
+    struct Node
+    {
+        const char* name;
+        uint32_t    thread;
+        uint32_t    depth;
+        uint32_t    firstChild;
+        uint32_t    nextSibling;
+        uint32_t    calls;
+        uint64_t    frameTicks;
+        uint32_t    lastCalls;
+        double      lastMS;
+        uint32_t    historyCount;
+        uint32_t    historyNext;
+        float       history[c_historyFrames];
+    };
+
+    struct TraceEvent
+    {
+        uint32_t    node;
+        uint64_t    start;
+        uint64_t    end;
+    };
+
+    void Calibrate()
+    {
+#ifdef USE_TSC
+        int64_t qpc = QPC();
+        uint64_t ticks = ReadTicks();
+        if (qpc > m_calibrationQPC && ticks > m_calibrationTicks)
+        {
+            m_ticksPerSecond = double(ticks - m_calibrationTicks) * double(m_qpcFrequency) / double(qpc - m_calibrationQPC);
+        }
+#endif
+    }
+
+    uint32_t NewNode(const char* name, uint32_t thread, uint32_t depth)
+    {
+        m_nodes.emplace_back();
+        auto& node = m_nodes.back();
+        memset(&node, 0, sizeof(Node));
+        node.name = name;
+        node.thread = thread;
+        node.depth = depth;
+        node.firstChild = c_invalidNode;
+        node.nextSibling = c_invalidNode;
+        return static_cast<uint32_t>(m_nodes.size() - 1);
+    }
+
+    uint32_t FindChild(uint32_t parent, const char* name)
+    {
+        uint32_t child = m_nodes[parent].firstChild;
+        for (; child != c_invalidNode; child = m_nodes[child].nextSibling)
+        {
+            if (m_nodes[child].name == name)
+                return child;
+        }
+
+        child = NewNode(name, m_nodes[parent].thread, m_nodes[parent].depth + 1);
+        m_nodes[child].nextSibling = m_nodes[parent].firstChild;
+        m_nodes[parent].firstChild = child;
+        return child;
+    }
+
+    void Drain(ThreadBuffer& buffer);
+    void AppendStats(uint32_t node, std::vector<ZoneStats>& stats, std::vector<float>& sorted) const;
+
+    double                                      m_ticksPerSecond;
+    uint64_t                                    m_calibrationTicks;
+    int64_t                                     m_calibrationQPC;
+    int64_t                                     m_qpcFrequency;
+
+    mutable std::mutex                          m_threadLock;
+    std::vector<std::unique_ptr<ThreadBuffer>>  m_threads;
+
+    // Owned by EndFrame
+    mutable std::mutex                          m_statsLock;
+    std::vector<Node>                           m_nodes;        // Includes an unnamed root node for each thread
+    uint64_t                                    m_frameCount;
+
+    bool                                        m_capturing;
+    uint64_t                                    m_captureStart;
+    std::vector<TraceEvent>                     m_trace;
+    uint64_t                                    m_traceDropped;
+};
+
+
+void CPUProfiler::Impl::Drain(ThreadBuffer& buffer)
+{
+    if (buffer.rootNode == c_invalidNode)
+    {
+        buffer.rootNode = NewNode(nullptr, buffer.index, 0);
+        m_nodes[buffer.rootNode].depth = uint32_t(-1);
+    }
+
+    uint32_t tail = buffer.tail.load(std::memory_order_relaxed);
+    uint32_t head = buffer.head.load(std::memory_order_acquire);
+
+    for (; tail != head; ++tail)
+    {
+        const Event& event = buffer.events[tail & (c_eventsPerThread - 1)];
+
+        if (event.name)
+        {
+            uint32_t parent = buffer.stack.empty() ? buffer.rootNode : buffer.stack.back().node;
+            ThreadBuffer::OpenZone zone = { FindChild(parent, event.name), event.ticks };
+            buffer.stack.push_back(zone);
+        }
+        else if (!buffer.stack.empty())
+        {
+            auto zone = buffer.stack.back();
+            buffer.stack.pop_back();
+
+            auto& node = m_nodes[zone.node];
+            node.frameTicks += event.ticks - zone.start;
+            ++node.calls;
+
+            if (m_capturing && zone.start >= m_captureStart)
+            {
+                if (m_trace.size() < c_maxTraceEvents)
+                {
+                    TraceEvent trace = { zone.node, zone.start, event.ticks };
+                    m_trace.push_back(trace);
+                }
+                else
+                {
+                    ++m_traceDropped;
+                }
+            }
+        }
+    }
+
+    buffer.tail.store(tail, std::memory_order_release);
+}
+
+
+void CPUProfiler::Impl::EndFrame()
+{
+    std::lock_guard<std::mutex> statsLock(m_statsLock);
+
+    {
+        std::lock_guard<std::mutex> lock(m_threadLock);
+        for (auto& buffer : m_threads)
+        {
+            Drain(*buffer);
+        }
+    }
+
+    Calibrate();
+
+    double msPerTick = 1000.0 / m_ticksPerSecond;
+    for (auto& node : m_nodes)
+    {
+        node.lastMS = double(node.frameTicks) * msPerTick;
+        node.lastCalls = node.calls;
+        if (node.calls > 0)
+        {
+            node.history[node.historyNext] = float(node.lastMS);
+            node.historyNext = (node.historyNext + 1) % c_historyFrames;
+            node.historyCount = std::min(node.historyCount + 1, c_historyFrames);
+        }
+
+        node.frameTicks = 0;
+        node.calls = 0;
+    }
+
+    ++m_frameCount;
+}
+
+
+void CPUProfiler::Impl::AppendStats(uint32_t index, std::vector<ZoneStats>& stats, std::vector<float>& sorted) const
+{
+    // Children are linked newest first, so visit them in reverse to list zones in order of first use
+    std::vector<uint32_t> children;
+    for (uint32_t child = m_nodes[index].firstChild; child != c_invalidNode; child = m_nodes[child].nextSibling)
+    {
+        children.push_back(child);
+    }
+
+    for (auto it = children.crbegin(); it != children.crend(); ++it)
+    {
+        auto& node = m_nodes[*it];
+
+        ZoneStats zone = {};
+        zone.name = node.name;
+        zone.thread = node.thread;
+        zone.threadName = m_threads[node.thread]->name;
+        zone.depth = node.depth;
+        zone.calls = node.lastCalls;
+        zone.lastMS = node.lastMS;
+
+        if (node.historyCount > 0)
+        {
+            sorted.assign(node.history, node.history + node.historyCount);
+            std::sort(sorted.begin(), sorted.end());
+
+            double total = 0.0;
+            for (auto value : sorted)
+            {
+                total += value;
+            }
+
+            zone.minMS = sorted.front();
+            zone.maxMS = sorted.back();
+            zone.averageMS = total / double(sorted.size());
+            zone.p99MS = sorted[(sorted.size() * 99 - 1) / 100];
+        }
+
+        stats.push_back(zone);
+
+        AppendStats(*it, stats, sorted);
+    }
+}
+
+
+void CPUProfiler::Impl::GetZoneStats(std::vector<ZoneStats>& stats) const
+{
+    stats.clear();
+
+    std::lock_guard<std::mutex> statsLock(m_statsLock);
+    std::lock_guard<std::mutex> lock(m_threadLock);
+
+    std::vector<float> sorted;
+    for (auto& buffer : m_threads)
+    {
+        if (buffer->rootNode != c_invalidNode)
+        {
+            AppendStats(buffer->rootNode, stats, sorted);
+        }
+    }
+}
+
+
+void CPUProfiler::Impl::Reset()
+{
+    std::lock_guard<std::mutex> statsLock(m_statsLock);
+
+    for (auto& node : m_nodes)
+    {
+        node.historyCount = 0;
+        node.historyNext = 0;
+    }
+}
+
+
+uint64_t CPUProfiler::Impl::GetDroppedZones() const
+{
+    std::lock_guard<std::mutex> lock(m_threadLock);
+
+    uint64_t dropped = 0;
+    for (auto& buffer : m_threads)
+    {
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    return dropped;
+}
+
+
+void CPUProfiler::Impl::BeginCapture()
+{
+    std::lock_guard<std::mutex> statsLock(m_statsLock);
+
+    m_trace.clear();
+    m_traceDropped = 0;
+    m_captureStart = ReadTicks();
+    m_capturing = true;
+}
+
+
+HRESULT CPUProfiler::Impl::EndCapture(const wchar_t* fileName)
+{
+    if (!fileName)
+        return E_INVALIDARG;
+
+    std::string json;
+
+    {
+        std::lock_guard<std::mutex> statsLock(m_statsLock);
+        if (!m_capturing)
+            return E_ILLEGAL_METHOD_CALL;
+
+        std::lock_guard<std::mutex> lock(m_threadLock);
+        for (auto& buffer : m_threads)
+        {
+            Drain(*buffer);
+        }
+
+        m_capturing = false;
+
+        Calibrate();
+
+        double usPerTick = 1000000.0 / m_ticksPerSecond;
+
+        json.reserve(128 + m_trace.size() * 96);
+        json += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+        char buff[256] = {};
+        for (auto& buffer : m_threads)
+        {
+            std::string name;
+            for (const char* c = buffer->name; *c; ++c)
+            {
+                if (*c == '"' || *c == '\\')
+                    name += '\\';
+                name += *c;
+            }
+
+            snprintf(buff, sizeof(buff), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}},\n",
+                buffer->index, name.c_str());
+            json += buff;
+        }
+
+        std::sort(m_trace.begin(), m_trace.end(), [](const TraceEvent& a, const TraceEvent& b) { return a.start < b.start; });
+
+        for (auto& event : m_trace)
+        {
+            auto& node = m_nodes[event.node];
+
+            json += "{\"name\":\"";
+            for (const char* c = node.name; *c; ++c)
+            {
+                if (*c == '"' || *c == '\\')
+                    json += '\\';
+                if (static_cast<unsigned char>(*c) >= 0x20)
+                    json += *c;
+            }
+
+            snprintf(buff, sizeof(buff), "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f},\n",
+                node.thread,
+                double(event.start - m_captureStart) * usPerTick,
+                double(event.end - event.start) * usPerTick);
+            json += buff;
+        }
+
+        snprintf(buff, sizeof(buff), "{\"name\":\"dropped_zones\",\"ph\":\"M\",\"pid\":1,\"args\":{\"count\":%llu}}\n]}\n",
+            static_cast<unsigned long long>(m_traceDropped));
+        json += buff;
+
+        m_trace.clear();
+        m_trace.shrink_to_fit();
+    }
+
+#ifdef _WIN32
+#if (_WIN32_WINNT >= 0x0602 /*_WIN32_WINNT_WIN8*/)
+    ScopedHandle hFile(safe_handle(CreateFile2(fileName,
+        GENERIC_WRITE,
+        0,
+        CREATE_ALWAYS,
+        nullptr)));
+#else
+    ScopedHandle hFile(safe_handle(CreateFileW(fileName,
+        GENERIC_WRITE,
+        0,
+        nullptr,
+        CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL,
+        nullptr)));
+#endif
+    if (!hFile)
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    size_t offset = 0;
+    while (offset < json.size())
+    {
+        DWORD bytesToWrite = static_cast<DWORD>(std::min<size_t>(json.size() - offset, 0x10000000));
+        DWORD bytesWritten = 0;
+        if (!WriteFile(hFile.get(), json.data() + offset, bytesToWrite, &bytesWritten, nullptr))
+        {
+            return HRESULT_FROM_WIN32(GetLastError());
+        }
+
+        if (bytesWritten != bytesToWrite)
+        {
+            return E_FAIL;
+        }
+
+        offset += bytesWritten;
+    }
+
+    return S_OK;
+#else
+    std::string path(wcslen(fileName) * MB_LEN_MAX + 1, '\0');
+    size_t length = wcstombs(&path[0], fileName, path.size());
+    if (length == size_t(-1))
+        return E_INVALIDARG;
+    path.resize(length);
+
+    std::unique_ptr<FILE, int(*)(FILE*)> file(fopen(path.c_str(), "wb"), fclose);
+    if (!file || fwrite(json.data(), 1, json.size(), file.get()) != json.size())
+        return E_FAIL;
+
+    return S_OK;
+#endif
+}
+
+
+//--------------------------------------------------------------------------------------
+const uint32_t CPUProfiler::c_eventsPerThread;
+const uint32_t CPUProfiler::c_historyFrames;
+
+
+CPUProfiler::CPUProfiler() :
+    pImpl(new Impl)
+{
+}
+
+
+CPUProfiler::~CPUProfiler()
+{
+}
+
+
+CPUProfiler& CPUProfiler::Get()
+{
+    static CPUProfiler s_profiler;
+    return s_profiler;
+}
+
+
+_Use_decl_annotations_
+void CPUProfiler::BeginZone(const char* name)
+{
+    auto buffer = t_buffer;
+    if (!buffer)
+    {
+        buffer = t_buffer = Get().pImpl->Register();
+    }
+
+    // Leave room for the end of this zone and every open one, so ends are never dropped
+    uint32_t head = buffer->head.load(std::memory_order_relaxed);
+    uint32_t tail = buffer->tail.load(std::memory_order_acquire);
+    if (buffer->suppressed || (head - tail) + buffer->open + 2 > c_eventsPerThread)
+    {
+        ++buffer->suppressed;
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Event& event = buffer->events[head & (c_eventsPerThread - 1)];
+    event.name = name;
+    event.ticks = ReadTicks();
+
+    ++buffer->open;
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+
+void CPUProfiler::EndZone()
+{
+    uint64_t ticks = ReadTicks();
+
+    auto buffer = t_buffer;
+    if (!buffer)
+        return;
+
+    if (buffer->suppressed)
+    {
+        --buffer->suppressed;
+        return;
+    }
+
+    if (!buffer->open)
+        return;
+
+    uint32_t head = buffer->head.load(std::memory_order_relaxed);
+
+    Event& event = buffer->events[head & (c_eventsPerThread - 1)];
+    event.name = nullptr;
+    event.ticks = ticks;
+
+    --buffer->open;
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+
+_Use_decl_annotations_
+void CPUProfiler::SetThreadName(const char* name)
+{
+    if (!name)
+        return;
+
+    auto buffer = t_buffer;
+    if (!buffer)
+    {
+        buffer = t_buffer = Get().pImpl->Register();
+    }
+
+    Get().pImpl->SetThreadName(buffer, name);
+}
+
+
+void CPUProfiler::EndFrame()
+{
+    pImpl->EndFrame();
+}
+
+
+void CPUProfiler::GetZoneStats(std::vector<ZoneStats>& stats) const
+{
+    pImpl->GetZoneStats(stats);
+}
+
+
+void CPUProfiler::Reset()
+{
+    pImpl->Reset();
+}
+
+
+uint64_t CPUProfiler::GetDroppedZones() const
+{
+    return pImpl->GetDroppedZones();
+}
+
+
+void CPUProfiler::BeginCapture()
+{
+    pImpl->BeginCapture();
+}
+
+
+_Use_decl_annotations_
+HRESULT CPUProfiler::EndCapture(const wchar_t* fileName)
+{
+    return pImpl->EndCapture(fileName);
+}
+
+
+bool CPUProfiler::IsCapturing() const
+{
+    return pImpl->IsCapturing();
+}
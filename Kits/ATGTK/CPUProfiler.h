@@ -0,0 +1,97 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Hierarchical multi-threaded CPU profiler
+//
+// Zones are marked with CPUProfileZone (or BeginZone/EndZone) on any thread. Each thread records begin and
+// end timestamps into its own fixed-size ring buffer without locking, so zones are cheap enough to leave in
+// shipping code paths. Once per frame, EndFrame drains every thread's ring, builds the zone tree for each
+// thread and updates min/average/max/99th percentile timings over recent frames. A capture of every zone can
+// be written out in the Chrome trace event format (chrome://tracing or https://ui.perfetto.dev).
+//
+// Zone names must be string literals (or otherwise outlive the profiler), as only the pointer is recorded.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+
+namespace DX
+{
+    class CPUProfiler
+    {
+    public:
+        // Events each thread can have recorded between calls to EndFrame. Zones are dropped when it is full.
+        static const uint32_t c_eventsPerThread = 16384;
+
+        // Frames of history used for the timing statistics.
+        static const uint32_t c_historyFrames = 256;
+
+        struct ZoneStats
+        {
+            const char* name;
+            const char* threadName;
+            uint32_t    thread;         // Index of the thread in order of first use
+            uint32_t    depth;          // 0 for top-level zones of a thread
+            uint32_t    calls;          // Number of times the zone ended in the last frame
+            double      lastMS;         // Total time in the zone in the last frame
+            double      minMS;          // Over the frames of history in which the zone was used
+            double      averageMS;
+            double      maxMS;
+            double      p99MS;
+        };
+
+        CPUProfiler(const CPUProfiler&) = delete;
+        CPUProfiler& operator=(const CPUProfiler&) = delete;
+
+        static CPUProfiler& Get();
+
+        // Marks the start and end of a zone on the calling thread. Zones on a thread must be properly nested.
+        static void BeginZone(_In_z_ const char* name);
+        static void EndZone();
+
+        // Names the calling thread in statistics and traces.
+        static void SetThreadName(_In_z_ const char* name);
+
+        // Collects the zones recorded on all threads since the last call. Call once per frame from one thread.
+        void EndFrame();
+
+        // Gets the timing statistics of each zone, depth-first for each thread.
+        void GetZoneStats(std::vector<ZoneStats>& stats) const;
+
+        // Clears the timing history.
+        void Reset();
+
+        // Number of zones dropped because a thread's ring buffer was full.
+        uint64_t GetDroppedZones() const;
+
+        // Records every zone collected by EndFrame until EndCapture, which writes them to a Chrome trace JSON file.
+        void BeginCapture();
+        HRESULT EndCapture(_In_z_ const wchar_t* fileName);
+        bool IsCapturing() const;
+
+    private:
+        CPUProfiler();
+        ~CPUProfiler();
+
+        // Private implementation.
+        class Impl;
+
+        std::unique_ptr<Impl> pImpl;
+    };
+
+    // Times the enclosing scope.
+    class CPUProfileZone
+    {
+    public:
+        explicit CPUProfileZone(_In_z_ const char* name) { CPUProfiler::BeginZone(name); }
+        ~CPUProfileZone() { CPUProfiler::EndZone(); }
+
+        CPUProfileZone(const CPUProfileZone&) = delete;
+        CPUProfileZone& operator=(const CPUProfileZone&) = delete;
+    };
+}
@@ -3,16 +3,37 @@
 //
 // Simple parser for .csv (Comma-Separated Values) files.
 //
+// UTF-8 files are memory-mapped and parsed in place. Items can be read as zero-copy
+// UTF-8 views, and are only converted to UTF-16 when requested through NextItem.
+//
+// The line and item scans use AVX2 or SSE2 where the compiler targets them. Defining
+// _XM_NO_INTRINSICS_ (as for DirectXMath) selects the scalar scan.
+//
+// Given a DX::JobSystem, large files are indexed and columns extracted on its workers.
+// The job system is only named by a template, so samples which don't use one needn't
+// build JobSystem.cpp.
+//
 // Copyright (c) Microsoft Corporation. All rights reserved.
 // Licensed under the MIT License.
 //-------------------------------------------------------------------------------------
 
 #pragma once
 
-#include <exception>
+#include <algorithm>
+#include <functional>
 #include <memory>
+#include <stdexcept>
 #include <vector>
 
+#if defined(_XM_NO_INTRINSICS_)
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "MappedFile.h"
+
 
 namespace DX
 {
@@ -25,257 +46,741 @@ namespace DX
             UTF8,   // File is Unicode UTF-8
         };
 
+        // A single item of a record as it appears in the file. For quoted items the text excludes the
+        // enclosing quotes, and 'escaped' is set if it still contains "" pairs.
+        struct Item
+        {
+            const char* text;
+            size_t      length;
+            bool        escaped;
+        };
+
+        // Indexes the file on the calling thread.
         explicit CSVReader(_In_z_ const wchar_t* fileName, Encoding encoding = Encoding::UTF8, bool ignoreComments = false) :
+            m_data(nullptr),
             m_end(nullptr),
             m_currentChar(nullptr),
             m_currentLine(0),
-            m_ignoreComments(ignoreComments)
+            m_ignoreComments(ignoreComments),
+            m_threadCount(1)
         {
-            assert(fileName != 0);
+            Open(fileName, encoding);
+        }
 
-#if (_WIN32_WINNT >= 0x0602 /*_WIN32_WINNT_WIN8*/)
-            ScopedHandle hFile(safe_handle(CreateFile2(fileName,
-                GENERIC_READ,
-                FILE_SHARE_READ,
-                OPEN_EXISTING,
-                nullptr)));
-#else
-            ScopedHandle hFile(safe_handle(CreateFileW(fileName,
-                GENERIC_READ,
-                FILE_SHARE_READ,
-                nullptr,
-                OPEN_EXISTING,
-                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
-                nullptr)));
-#endif
-            if (!hFile)
-            {
-                throw std::exception("CreateFile");
-            }
+        // Indexes large files, and extracts columns of large tables, on the workers of jobs (a DX::JobSystem) as
+        // well as the calling thread. jobs must outlive the reader.
+        template<typename TJobSystem>
+        CSVReader(_In_z_ const wchar_t* fileName, Encoding encoding, bool ignoreComments, TJobSystem& jobs) :
+            m_data(nullptr),
+            m_end(nullptr),
+            m_currentChar(nullptr),
+            m_currentLine(0),
+            m_ignoreComments(ignoreComments),
+            m_threadCount(jobs.GetWorkerCount() + 1),
+            m_parallelFor([&jobs](size_t count, const RangeFunction& func) { jobs.ParallelFor(count, 1, func); })
+        {
+            Open(fileName, encoding);
+        }
 
-            FILE_STANDARD_INFO fileInfo;
-            if (!GetFileInformationByHandleEx(hFile.get(), FileStandardInfo, &fileInfo, sizeof(fileInfo)))
-            {
-                throw std::exception("GetFileInformationByHandleEx");
-            }
+        CSVReader(const CSVReader&) = delete;
+        CSVReader& operator=(const CSVReader&) = delete;
 
-            if (fileInfo.EndOfFile.HighPart > 0 || fileInfo.EndOfFile.LowPart > 0x7ffffffd)
-            {
-                // File is 2 GBs or larger
-                throw std::exception("CSV too large");
-            }
+        // Return number of lines of data in CSV
+        size_t GetRecordCount() const { return m_lines.size(); }
 
-            std::unique_ptr<uint8_t[]> data(new uint8_t[fileInfo.EndOfFile.LowPart + 2]);
+        // Check for end of file
+        bool EndOfFile() const { return m_currentChar == nullptr; }
 
-            DWORD out;
-            if (!ReadFile(hFile.get(), data.get(), fileInfo.EndOfFile.LowPart, &out, nullptr)
-                || out != fileInfo.EndOfFile.LowPart)
-            {
-                throw std::exception("ReadFile");
-            }
+        // Return current record number (0-based)
+        size_t RecordIndex() const { return m_currentLine; }
 
-            // Ensure buffer is nul terminated
-            data[out] = data[out + 1] = '\0';
+        // Set to top of file
+        void TopOfFile()
+        {
+            m_currentChar = (m_lines.empty()) ? nullptr : m_lines[0];
+            m_currentLine = 0;
+        }
 
-            // Ignore lines in .csv that start with '#' character
+        // Start processing next record (returns false when out of data)
+        bool NextRecord()
+        {
+            if (!m_currentChar)
+                return false;
 
-            // Handle text encoding
-            if (encoding == Encoding::UTF16)
+            if (++m_currentLine >= m_lines.size())
             {
-                m_data.reset(reinterpret_cast<wchar_t*>(data.release()));
-                m_end = reinterpret_cast<wchar_t*>(&data[out]);
+                m_currentChar = nullptr;
+                return false;
             }
-            else
-            {
-                // If we are not UTF16, we have to convert...
-                int cch = ::MultiByteToWideChar(CP_UTF8, 0, reinterpret_cast<LPCSTR>(data.get()), -1, nullptr, 0);
 
-                if (cch <= 0)
-                {
-                    throw std::exception("MultiByteToWideChar");
-                }
+            m_currentChar = m_lines[m_currentLine];
+
+            return true;
+        }
 
-                m_data.reset(new wchar_t[size_t(cch)]);
+        // Get next item in record without copying it (returns false when reached end of record)
+        bool NextItem(Item& item)
+        {
+            if (!m_currentChar)
+                return false;
+
+            const char* end = RecordEnd(m_currentLine);
+
+            if (m_currentChar >= end)
+                return false;
 
-                int result = ::MultiByteToWideChar(CP_UTF8, 0, reinterpret_cast<LPCSTR>(data.get()), -1, m_data.get(), cch);
+            m_currentChar = ParseItem(m_currentChar, end, item);
 
-                if (result <= 0)
+            return true;
+        }
+
+        // Get next item in record (returns false when reached end of record)
+        bool NextItem(_Out_writes_(maxstr) wchar_t* str, _In_ size_t maxstr)
+        {
+            if (!str || !m_currentChar || !maxstr)
+                return false;
+
+            *str = L'\0';
+
+            Item item;
+            if (!NextItem(item))
+                return false;
+
+            DecodeItem(item, str, maxstr);
+
+            return true;
+        }
+
+        template<size_t TNameLength>
+        bool NextItem(wchar_t(&name)[TNameLength])
+        {
+            return NextItem(name, TNameLength);
+        }
+
+        // Extract a single column of every record in one pass. Records where the column is missing or
+        // not a number get defaultValue. Returns the number of such records.
+        size_t GetColumn(size_t column, std::vector<int32_t>& values, int32_t defaultValue = 0) const
+        {
+            return ExtractColumn(column, values, [defaultValue](const Item& item, int32_t& value) -> bool
+            {
+                if (!ParseInt(item, value))
                 {
-                    m_data.reset();
-                    throw std::exception("MultiByteToWideChar");
+                    value = defaultValue;
+                    return false;
                 }
+                return true;
+            });
+        }
 
-                m_end = &m_data[size_t(result - 1)];
-            }
-
-            // Locate the start of lines
-            bool newline = true;
-            for (const wchar_t* ptr = m_data.get(); *ptr != 0 && ptr < m_end; )
+        size_t GetColumn(size_t column, std::vector<float>& values, float defaultValue = 0.f) const
+        {
+            return ExtractColumn(column, values, [defaultValue](const Item& item, float& value) -> bool
             {
-                if (*ptr == '\n' || *ptr == '\r')
+                if (!ParseFloat(item, value))
                 {
-                    ++ptr;
-                    newline = true;
+                    value = defaultValue;
+                    return false;
                 }
-                else if (*ptr == '#' && m_ignoreComments && newline)
+                return true;
+            });
+        }
+
+        // String columns are returned as views into the file data, which remain valid for the lifetime
+        // of the reader. Missing items are returned as empty strings.
+        size_t GetColumn(size_t column, std::vector<Item>& values) const
+        {
+            return ExtractColumn(column, values, [](const Item& item, Item& value) -> bool
+            {
+                value = item;
+                return item.text != nullptr;
+            });
+        }
+
+        // Converts an item to nul-terminated UTF-16, undoing "" escapes and truncating to fit.
+        // Returns the number of characters written, not including the terminator.
+        static size_t DecodeItem(const Item& item, _Out_writes_(maxstr) wchar_t* str, _In_ size_t maxstr)
+        {
+            if (!str || !maxstr)
+                return 0;
+
+            wchar_t* dest = str;
+            wchar_t* edest = str + maxstr - 1;
+
+            auto ptr = reinterpret_cast<const uint8_t*>(item.text);
+            auto end = ptr + item.length;
+            while (ptr < end && dest < edest)
+            {
+                uint32_t c = *ptr++;
+
+                if (c < 0x80)
                 {
-                    // Skip to CR
-                    for (; *ptr != 0 && *ptr != '\n' && ptr < m_end; ++ptr) {}
+                    if (c == '"' && item.escaped && ptr < end && *ptr == '"')
+                        ++ptr;
                 }
-                else if (*ptr == '"')
+                else
                 {
-                    if (newline)
+                    // Multi-byte sequence; invalid or truncated sequences become U+FFFD
+                    size_t extra = (c >= 0xF0) ? 3 : (c >= 0xE0) ? 2 : (c >= 0xC0) ? 1 : 0;
+                    c &= (extra == 3) ? 0x07 : (extra == 2) ? 0x0F : 0x1F;
+                    if (!extra || size_t(end - ptr) < extra)
                     {
-                        m_lines.push_back(ptr);
-                        newline = false;
+                        c = 0xFFFD;
+                        ptr = (extra) ? end : ptr;
                     }
-
-                    // Skip to next " (skipping "" escapes)
-                    for (ptr++; *ptr != 0 && ptr < m_end; ++ptr)
+                    else
                     {
-                        if (*ptr == '"')
+                        for (size_t j = 0; j < extra; ++j)
                         {
-                            ++ptr;
-                            if (*ptr != '"')
+                            if ((ptr[j] & 0xC0) != 0x80)
+                            {
+                                c = 0xFFFD;
+                                extra = j;
                                 break;
+                            }
+                            c = (c << 6) | (ptr[j] & 0x3F);
                         }
+                        ptr += extra;
+                    }
+
+                    if (c > 0xFFFF && c != 0xFFFD)
+                    {
+                        if (c > 0x10FFFF || edest - dest < 2)
+                            break;
+
+                        // Surrogate pair
+                        c -= 0x10000;
+                        *(dest++) = static_cast<wchar_t>(0xD800 + (c >> 10));
+                        c = 0xDC00 + (c & 0x3FF);
                     }
                 }
-                else if (newline)
+
+                *(dest++) = static_cast<wchar_t>(c);
+            }
+
+            *dest = 0;
+            return size_t(dest - str);
+        }
+
+    private:
+        typedef std::function<void(size_t begin, size_t end)> RangeFunction;
+
+        void Open(_In_z_ const wchar_t* fileName, Encoding encoding)
+        {
+            assert(fileName != 0);
+
+            if (FAILED(m_file.Open(fileName, true)))
+            {
+                throw std::runtime_error("CreateFile");
+            }
+
+            const uint8_t* data = m_file.GetData();
+            size_t size = m_file.GetSize();
+
+            // Handle text encoding
+            if (encoding == Encoding::UTF16)
+            {
+                // Parsing is done on UTF-8, so this is the only case that needs a copy of the file.
+                size_t cch = size / sizeof(uint16_t);
+                if (cch > 0)
                 {
-                    m_lines.push_back(ptr);
-                    newline = false;
-                    ++ptr;
+                    auto wdata = reinterpret_cast<const uint16_t*>(data);
+
+                    size_t cb = ConvertUTF16(wdata, cch, nullptr);
+                    m_converted.reset(new char[cb]);
+
+                    m_data = m_converted.get();
+                    m_end = m_data + ConvertUTF16(wdata, cch, m_converted.get());
                 }
-                else
-                    ++ptr;
+
+                m_file.Close();
+            }
+            else
+            {
+                m_data = reinterpret_cast<const char*>(data);
+                m_end = m_data + size;
             }
 
+            // Skip the UTF-8 byte order mark
+            if (m_end - m_data >= 3
+                && uint8_t(m_data[0]) == 0xEF && uint8_t(m_data[1]) == 0xBB && uint8_t(m_data[2]) == 0xBF)
+            {
+                m_data += 3;
+            }
+
+            IndexLines();
+
             TopOfFile();
         }
 
-        CSVReader(const CSVReader&) = delete;
-        CSVReader& operator=(const CSVReader&) = delete;
+        // Converts count UTF-16 code units to UTF-8, and returns the number of bytes. With a null dest
+        // only the size is computed. Unpaired surrogates become U+FFFD, as with WideCharToMultiByte.
+        static size_t ConvertUTF16(const uint16_t* src, size_t count, char* dest)
+        {
+            size_t size = 0;
+            const uint16_t* end = src + count;
+            while (src < end)
+            {
+                uint32_t c = *src++;
+                if (c >= 0xD800 && c <= 0xDFFF)
+                {
+                    if (c <= 0xDBFF && src < end && *src >= 0xDC00 && *src <= 0xDFFF)
+                    {
+                        c = 0x10000 + ((c - 0xD800) << 10) + (*src++ - 0xDC00u);
+                    }
+                    else
+                    {
+                        c = 0xFFFD;
+                    }
+                }
 
-        // Return number of lines of data in CSV
-        size_t GetRecordCount() const { return m_lines.size(); }
+                size_t bytes = (c < 0x80) ? 1 : (c < 0x800) ? 2 : (c < 0x10000) ? 3 : 4;
+                if (dest)
+                {
+                    char* ptr = dest + size;
+                    switch (bytes)
+                    {
+                    case 1:
+                        ptr[0] = static_cast<char>(c);
+                        break;
+                    case 2:
+                        ptr[0] = static_cast<char>(0xC0 | (c >> 6));
+                        ptr[1] = static_cast<char>(0x80 | (c & 0x3F));
+                        break;
+                    case 3:
+                        ptr[0] = static_cast<char>(0xE0 | (c >> 12));
+                        ptr[1] = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+                        ptr[2] = static_cast<char>(0x80 | (c & 0x3F));
+                        break;
+                    default:
+                        ptr[0] = static_cast<char>(0xF0 | (c >> 18));
+                        ptr[1] = static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+                        ptr[2] = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+                        ptr[3] = static_cast<char>(0x80 | (c & 0x3F));
+                        break;
+                    }
+                }
+                size += bytes;
+            }
+            return size;
+        }
 
-        // Check for end of file
-        bool EndOfFile() const { return m_currentChar == nullptr; }
+        // Returns the first character in [ptr, end) that is one of a, b or c, or end if there is none.
+        static const char* FindFirstOf(const char* ptr, const char* end, char a, char b, char c)
+        {
+#if !defined(_XM_NO_INTRINSICS_) && defined(__AVX2__)
+            const __m256i va = _mm256_set1_epi8(a);
+            const __m256i vb = _mm256_set1_epi8(b);
+            const __m256i vc = _mm256_set1_epi8(c);
+            for (; end - ptr >= 32; ptr += 32)
+            {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+                __m256i match = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, va), _mm256_cmpeq_epi8(v, vb)), _mm256_cmpeq_epi8(v, vc));
+                uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(match));
+                if (mask)
+                    return ptr + CountTrailingZeros(mask);
+            }
+#endif
+#if !defined(_XM_NO_INTRINSICS_) && (defined(__AVX2__) || defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__))
+            const __m128i sa = _mm_set1_epi8(a);
+            const __m128i sb = _mm_set1_epi8(b);
+            const __m128i sc = _mm_set1_epi8(c);
+            for (; end - ptr >= 16; ptr += 16)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+                __m128i match = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, sa), _mm_cmpeq_epi8(v, sb)), _mm_cmpeq_epi8(v, sc));
+                uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(match));
+                if (mask)
+                    return ptr + CountTrailingZeros(mask);
+            }
+#endif
+            for (; ptr < end; ++ptr)
+            {
+                if (*ptr == a || *ptr == b || *ptr == c)
+                    break;
+            }
+            return ptr;
+        }
 
-        // Return current record number (0-based)
-        size_t RecordIndex() const { return m_currentLine; }
+        static uint32_t CountTrailingZeros(uint32_t mask)
+        {
+#if defined(_MSC_VER)
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return index;
+#else
+            return static_cast<uint32_t>(__builtin_ctz(mask));
+#endif
+        }
 
-        // Set to top of file
-        void TopOfFile()
+        // Skips to the character after the closing quote, skipping "" escapes. ptr is the first character inside the quotes.
+        // Returns nullptr if the quote is not closed before end.
+        static const char* SkipQuoted(const char* ptr, const char* end)
         {
-            m_currentChar = (m_lines.empty()) ? nullptr : m_lines[0];
-            m_currentLine = 0;
+            for (;;)
+            {
+                ptr = static_cast<const char*>(memchr(ptr, '"', size_t(end - ptr)));
+                if (!ptr)
+                    return nullptr;
+
+                ++ptr;
+                if (ptr >= end || *ptr != '"')
+                    return ptr;
+
+                ++ptr;
+            }
         }
 
-        // Start processing next record (returns false when out of data)
-        bool NextRecord()
+        // Parses one item starting at ptr, and returns the start of the next item.
+        static const char* ParseItem(const char* ptr, const char* end, Item& item)
         {
-            if (!m_currentChar)
-                return false;
+            // Whitespace
+            while (ptr < end && (*ptr == '\t' || *ptr == ' '))
+                ++ptr;
 
-            if (++m_currentLine >= m_lines.size())
+            item.escaped = false;
+
+            if (ptr < end && *ptr == '"')
             {
-                m_currentChar = nullptr;
+                // Take from " to ", respecting "" as double-quotes
+                item.text = ++ptr;
+                for (; ptr < end; ++ptr)
+                {
+                    if (*ptr == '"')
+                    {
+                        if (ptr + 1 < end && ptr[1] == '"')
+                        {
+                            item.escaped = true;
+                            ++ptr;
+                        }
+                        else
+                            break;
+                    }
+                }
+                item.length = size_t(ptr - item.text);
+
+                // Anything between the closing quote and the separator is ignored
+                ptr = FindFirstOf(ptr, end, ',', '\n', '\r');
+            }
+            else
+            {
+                item.text = ptr;
+                ptr = FindFirstOf(ptr, end, ',', '\n', '\r');
+                item.length = size_t(ptr - item.text);
+            }
+
+            return (ptr < end && *ptr == ',') ? ptr + 1 : end;
+        }
+
+        const char* RecordEnd(size_t record) const
+        {
+            return ((record + 1) >= m_lines.size()) ? m_end : m_lines[record + 1];
+        }
+
+        static bool ParseInt(const Item& item, int32_t& value)
+        {
+            const char* ptr = item.text;
+            const char* end = ptr + item.length;
+
+            bool negative = false;
+            if (ptr < end && (*ptr == '-' || *ptr == '+'))
+            {
+                negative = (*ptr == '-');
+                ++ptr;
+            }
+
+            if (ptr >= end || *ptr < '0' || *ptr > '9')
                 return false;
+
+            int64_t result = 0;
+            for (; ptr < end && *ptr >= '0' && *ptr <= '9'; ++ptr)
+            {
+                result = result * 10 + (*ptr - '0');
+                if (result > int64_t(INT32_MAX) + 1)
+                    return false;
             }
 
-            m_currentChar = m_lines[m_currentLine];
+            while (ptr < end && (*ptr == '\t' || *ptr == ' '))
+                ++ptr;
+
+            if (ptr != end)
+                return false;
 
+            result = negative ? -result : result;
+            if (result > INT32_MAX)
+                return false;
+
+            value = static_cast<int32_t>(result);
             return true;
         }
 
-        // Get next item in record (returns false when reached end of record)
-        bool NextItem(_Out_writes_(maxstr) wchar_t* str, _In_ size_t maxstr)
+        static bool ParseFloat(const Item& item, float& value)
         {
-            if (!str || !m_currentChar || !maxstr)
+            // Fast path for plain decimals such as 12.5, where the digits and the power of ten are both
+            // exact as doubles so a single division gives the correctly rounded double
+            {
+                static const double s_powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                                   1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+                const char* ptr = item.text;
+                const char* end = ptr + item.length;
+
+                bool negative = false;
+                if (ptr < end && (*ptr == '-' || *ptr == '+'))
+                {
+                    negative = (*ptr == '-');
+                    ++ptr;
+                }
+
+                uint64_t mantissa = 0;
+                size_t digits = 0;
+                size_t fraction = 0;
+                bool point = false;
+                for (; ptr < end; ++ptr)
+                {
+                    if (*ptr >= '0' && *ptr <= '9')
+                    {
+                        mantissa = mantissa * 10 + uint64_t(*ptr - '0');
+                        ++digits;
+                        if (point)
+                            ++fraction;
+                    }
+                    else if (*ptr == '.' && !point)
+                        point = true;
+                    else
+                        break;
+                }
+
+                while (ptr < end && (*ptr == '\t' || *ptr == ' '))
+                    ++ptr;
+
+                if (ptr == end && digits > 0 && digits <= 15 && fraction < _countof(s_powers))
+                {
+                    double result = double(mantissa) / s_powers[fraction];
+                    value = static_cast<float>(negative ? -result : result);
+                    return true;
+                }
+            }
+
+            // Items aren't nul-terminated, so copy them for strtof. Anything longer isn't a sensible number.
+            char buff[64];
+            if (!item.length || item.length >= sizeof(buff))
                 return false;
 
-            *str = L'\0';
+            memcpy(buff, item.text, item.length);
+            buff[item.length] = 0;
 
-            const wchar_t* end = ((m_currentLine + 1) >= m_lines.size()) ? m_end : (m_lines[(m_currentLine + 1)]);
+            char* last = nullptr;
+            float result = strtof(buff, &last);
+            if (last == buff)
+                return false;
 
-            if (m_currentChar >= end)
+            while (*last == '\t' || *last == ' ')
+                ++last;
+
+            if (*last)
                 return false;
 
-            wchar_t* dest = str;
-            wchar_t* edest = str + maxstr;
+            value = result;
+            return true;
+        }
+
+        // Calls func(index) for each index in [0, count), on the job system if there is one.
+        template<typename TFunc>
+        void ParallelFor(size_t count, TFunc func) const
+        {
+            auto range = [&func](size_t begin, size_t end)
+            {
+                for (size_t index = begin; index < end; ++index)
+                    func(index);
+            };
+
+            if (count > 1 && m_parallelFor)
+            {
+                m_parallelFor(count, range);
+            }
+            else
+            {
+                range(0, count);
+            }
+        }
+
+        template<typename T, typename TConvert>
+        size_t ExtractColumn(size_t column, std::vector<T>& values, TConvert convert) const
+        {
+            values.resize(m_lines.size());
+
+            // Small tables aren't worth the cost of running jobs
+            size_t count = std::min<size_t>(m_threadCount, std::max<size_t>(m_lines.size() / 16384, 1));
+            std::vector<size_t> failures(count, 0);
 
-            for (const wchar_t* ptr = m_currentChar; ; )
+            ParallelFor(count, [&](size_t index)
             {
-                if (*ptr == 0 || ptr >= end || *ptr == '\n' || *ptr == '\r')
+                size_t first = m_lines.size() * index / count;
+                size_t last = m_lines.size() * (index + 1) / count;
+                size_t failed = 0;
+                for (size_t record = first; record < last; ++record)
                 {
-                    m_currentChar = end;
-                    break;
+                    const char* ptr = m_lines[record];
+                    const char* end = RecordEnd(record);
+
+                    Item item = {};
+                    for (size_t j = 0; j <= column && ptr < end; ++j)
+                    {
+                        ptr = ParseItem(ptr, end, item);
+                        if (j < column)
+                            item.text = nullptr;
+                    }
+
+                    if (!item.text)
+                    {
+                        item.text = "";
+                        item.length = 0;
+                        item.escaped = false;
+                        convert(item, values[record]);
+                        ++failed;
+                    }
+                    else if (!convert(item, values[record]))
+                    {
+                        ++failed;
+                    }
                 }
-                else if (*ptr == ',')
+                failures[index] = failed;
+            });
+
+            size_t failed = 0;
+            for (auto f : failures)
+                failed += f;
+
+            return failed;
+        }
+
+        // Records line starts in [ptr, end), where ptr is either the start of a line or inside a quoted item.
+        // Returns true if end is inside a quoted item.
+        static bool ScanLines(const char* ptr, const char* end, bool inQuote, bool ignoreComments, std::vector<const char*>& lines)
+        {
+            bool newline = true;
+            if (inQuote)
+            {
+                ptr = SkipQuoted(ptr, end);
+                if (!ptr)
+                    return true;
+
+                newline = false;
+            }
+
+            // Between line starts only newlines and quotes matter, so the data is scanned for those a vector at a time.
+            while (ptr < end)
+            {
+                if (!newline)
                 {
-                    m_currentChar = ptr + 1;
-                    break;
+                    ptr = FindFirstOf(ptr, end, '\n', '\r', '"');
+                    if (ptr >= end)
+                        break;
                 }
-                else if (*ptr == '\t' || *ptr == ' ')
+
+                if (*ptr == '\n' || *ptr == '\r')
                 {
-                    // Whitespace
                     ++ptr;
+                    newline = true;
+                }
+                else if (*ptr == '#' && ignoreComments && newline)
+                {
+                    // Skip to CR
+                    ptr = static_cast<const char*>(memchr(ptr, '\n', size_t(end - ptr)));
+                    if (!ptr)
+                        break;
                 }
                 else if (*ptr == '"')
                 {
-                    // Copy from " to ", respecting "" as double-quotes
-                    for (ptr++; *ptr != 0 && ptr < end; ++ptr)
+                    if (newline)
                     {
-                        if (*ptr == '"')
-                        {
-                            ++ptr;
-                            if (*ptr != '"')
-                                break;
-                            else if (dest < edest)
-                                *(dest++) = '"';
-                        }
-                        else if (dest < edest)
-                            *(dest++) = *ptr;
+                        lines.push_back(ptr);
+                        newline = false;
                     }
+
+                    // Skip to next " (skipping "" escapes)
+                    ptr = SkipQuoted(ptr + 1, end);
+                    if (!ptr)
+                        return true;
                 }
                 else
                 {
-                    for (; *ptr != 0 && ptr < end; ++ptr)
-                    {
-                        if (*ptr == '\n' || *ptr == '\r' || *ptr == ',')
-                            break;
-                        else if (dest < edest)
-                            *(dest++) = *ptr;
-                    }
+                    // Start of a line
+                    lines.push_back(ptr);
+                    newline = false;
+                    ++ptr;
                 }
             }
 
-            if (dest < edest)
-                *dest = 0;
-
-            return true;
+            return false;
         }
 
-        template<size_t TNameLength>
-        bool NextItem(wchar_t(&name)[TNameLength])
+        // Locate the start of lines. Large files are split into chunks that are indexed in parallel. Chunks
+        // begin just after a newline, so each one starts either at the start of a line, or inside a quoted
+        // item that spans lines. Chunks are indexed assuming the former, and the rare chunk that turns out to
+        // start inside quotes is indexed again once the state at its start is known.
+        void IndexLines()
         {
-            return NextItem(name, TNameLength);
-        }
+            const size_t c_minChunkSize = 1024 * 1024;
 
-    private:
-        struct handle_closer { void operator()(HANDLE h) { if (h) CloseHandle(h); } };
+            size_t size = size_t(m_end - m_data);
+            size_t count = std::min<size_t>(m_threadCount, std::max<size_t>(size / c_minChunkSize, 1));
+
+            if (count <= 1)
+            {
+                (void)ScanLines(m_data, m_end, false, m_ignoreComments, m_lines);
+                return;
+            }
+
+            std::vector<const char*> starts(count + 1);
+            starts[0] = m_data;
+            starts[count] = m_end;
+            for (size_t j = 1; j < count; ++j)
+            {
+                const char* ptr = std::max(m_data + size * j / count, starts[j - 1]);
+                ptr = static_cast<const char*>(memchr(ptr, '\n', size_t(m_end - ptr)));
+                starts[j] = (ptr) ? ptr + 1 : m_end;
+            }
 
-        typedef std::unique_ptr<void, handle_closer> ScopedHandle;
+            std::vector<std::vector<const char*>> lines(count);
+            std::vector<char> endsInQuote(count, 0);
 
-        inline HANDLE safe_handle(HANDLE h) { return (h == INVALID_HANDLE_VALUE) ? nullptr : h; }
+            bool ignoreComments = m_ignoreComments;
+            ParallelFor(count, [&](size_t index)
+            {
+                lines[index].reserve(size_t(starts[index + 1] - starts[index]) / 32);
+                endsInQuote[index] = ScanLines(starts[index], starts[index + 1], false, ignoreComments, lines[index]);
+            });
+
+            bool inQuote = false;
+            size_t total = 0;
+            for (size_t j = 0; j < count; ++j)
+            {
+                if (inQuote)
+                {
+                    lines[j].clear();
+                    endsInQuote[j] = ScanLines(starts[j], starts[j + 1], true, ignoreComments, lines[j]);
+                }
+                inQuote = endsInQuote[j] != 0;
+                total += lines[j].size();
+            }
+
+            m_lines.reserve(total);
+            for (auto& chunk : lines)
+            {
+                m_lines.insert(m_lines.end(), chunk.begin(), chunk.end());
+            }
+        }
 
-        std::unique_ptr<wchar_t[]>  m_data;
-        const wchar_t*              m_end;
-        const wchar_t*              m_currentChar;
+        MappedFile                  m_file;
+        std::unique_ptr<char[]>     m_converted;
+        const char*                 m_data;
+        const char*                 m_end;
+        const char*                 m_currentChar;
         size_t                      m_currentLine;
         bool                        m_ignoreComments;
-        std::vector<const wchar_t*> m_lines;
+        size_t                      m_threadCount;
+        std::function<void(size_t count, const RangeFunction& func)> m_parallelFor;
+        std::vector<const char*>    m_lines;
     };
 }
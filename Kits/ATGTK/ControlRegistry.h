@@ -0,0 +1,241 @@
+//--------------------------------------------------------------------------------------
+// File: ControlRegistry.h
+//
+// Dense table of the controls of the ATG Sample GUI's panels.
+//
+// Controls are added as their panels and the controls themselves are created, and keep their
+// slot for as long as their panel is registered, so a slot is a stable handle that resolves with
+// an index. Slots of removed panels are never reused. Each control also carries the reasons it
+// needs per-frame work (dirty, focused or animating), and only controls with a reason are kept on
+// the active list that the update pass walks, so static controls cost nothing per frame. There
+// are no Direct3D or DirectXTK dependencies, so the registry can be tested and profiled without
+// a GPU.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+//-------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <stdint.h>
+
+#include <unordered_map>
+#include <vector>
+
+#ifndef _In_
+#define _In_
+#endif
+
+
+namespace ATG
+{
+    template<class TControl, class TPanel>
+    class ControlRegistry
+    {
+    public:
+        static const uint32_t c_Invalid = UINT32_MAX;
+
+        // Reasons for a control to be in the update pass
+        static const uint32_t c_StateDirty = 0x1;
+        static const uint32_t c_StateFocused = 0x2;
+        static const uint32_t c_StateAnimating = 0x4;
+
+        ControlRegistry() = default;
+
+        ControlRegistry(ControlRegistry const&) = delete;
+        ControlRegistry& operator=(ControlRegistry const&) = delete;
+
+        // Panels are added before their controls. Controls can only be found by id within a registered panel.
+        void AddPanel(unsigned panelId, _In_ TPanel* panel)
+        {
+            m_panelIds[panel] = panelId;
+        }
+
+        // Removes a panel and its controls, whose handles then resolve to nullptr.
+        void RemovePanel(_In_ TPanel* panel)
+        {
+            if (!m_panelIds.erase(panel))
+                return;
+
+            for (uint32_t slot = 0; slot < m_entries.size(); ++slot)
+            {
+                auto& entry = m_entries[slot];
+                if (entry.panel != panel)
+                    continue;
+
+                auto it = m_index.find(entry.key);
+                if (it != m_index.end() && it->second == slot)
+                {
+                    m_index.erase(it);
+                }
+
+                // Left on the active list until the next update pass drops it
+                entry.control = nullptr;
+                entry.panel = nullptr;
+                entry.state = 0;
+            }
+        }
+
+        bool HasPanel(_In_ TPanel* panel) const
+        {
+            return m_panelIds.find(panel) != m_panelIds.end();
+        }
+
+        // Adds a control of a registered panel, and returns its slot or c_Invalid if the panel isn't registered.
+        // New controls are dirty. When ids are repeated within a panel, the first control added is the one found.
+        uint32_t AddControl(_In_ TPanel* panel, _In_ TControl* control, unsigned ctrlId)
+        {
+            auto it = m_panelIds.find(panel);
+            if (it == m_panelIds.end())
+                return c_Invalid;
+
+            auto slot = static_cast<uint32_t>(m_entries.size());
+
+            Entry entry = { control, panel, MakeKey(it->second, ctrlId), 0, false };
+            m_entries.push_back(entry);
+            m_index.emplace(entry.key, slot);
+
+            SetState(slot, c_StateDirty, true);
+            return slot;
+        }
+
+        // Updates the id a control is found by
+        void SetControlId(uint32_t slot, unsigned ctrlId)
+        {
+            if (slot >= m_entries.size() || !m_entries[slot].control)
+                return;
+
+            auto& entry = m_entries[slot];
+            uint64_t oldKey = entry.key;
+            uint64_t newKey = MakeKey(unsigned(oldKey >> 32), ctrlId);
+            if (newKey == oldKey)
+                return;
+
+            entry.key = newKey;
+
+            auto it = m_index.find(oldKey);
+            if (it != m_index.end() && it->second == slot)
+            {
+                m_index.erase(it);
+
+                // Another control may have had the same id
+                for (uint32_t other = 0; other < m_entries.size(); ++other)
+                {
+                    if (m_entries[other].control && m_entries[other].key == oldKey)
+                    {
+                        m_index.emplace(oldKey, other);
+                        break;
+                    }
+                }
+            }
+
+            it = m_index.find(newKey);
+            if (it == m_index.end() || it->second > slot)
+            {
+                m_index[newKey] = slot;
+            }
+        }
+
+        // Returns the slot of a control, or c_Invalid
+        uint32_t Find(unsigned panelId, unsigned ctrlId) const
+        {
+            auto it = m_index.find(MakeKey(panelId, ctrlId));
+            return (it != m_index.end()) ? it->second : c_Invalid;
+        }
+
+        // Returns nullptr for slots that are out of range or whose panel was removed
+        TControl* Get(uint32_t slot) const
+        {
+            return (slot < m_entries.size()) ? m_entries[slot].control : nullptr;
+        }
+
+        // Number of slots, including those of removed panels
+        size_t GetSlotCount() const { return m_entries.size(); }
+
+        // Sets or clears reasons for a control to be in the update pass
+        void SetState(uint32_t slot, uint32_t state, bool set)
+        {
+            if (slot >= m_entries.size() || !m_entries[slot].control)
+                return;
+
+            auto& entry = m_entries[slot];
+            if (set)
+            {
+                entry.state |= state;
+            }
+            else
+            {
+                entry.state &= ~state;
+            }
+
+            if (entry.state && !entry.active)
+            {
+                entry.active = true;
+                m_active.push_back(slot);
+            }
+        }
+
+        uint32_t GetState(uint32_t slot) const
+        {
+            return (slot < m_entries.size()) ? m_entries[slot].state : 0;
+        }
+
+        // Number of controls on the active list, which may include some that stopped needing updates since the last pass
+        size_t GetActiveCount() const { return m_active.size(); }
+
+        // Calls update(control, state) for each control that is dirty, focused or animating, and clears the dirty
+        // state before the call. Controls that become active during the pass are updated in the next one.
+        template<typename TFunc>
+        void UpdateActive(TFunc update)
+        {
+            size_t count = m_active.size();
+            for (size_t j = 0; j < count; ++j)
+            {
+                uint32_t slot = m_active[j];
+
+                uint32_t state = m_entries[slot].state;
+                if (!state)
+                    continue;
+
+                m_entries[slot].state &= ~c_StateDirty;
+                update(m_entries[slot].control, state);
+            }
+
+            // Drop controls that no longer need updates
+            size_t kept = 0;
+            for (size_t j = 0; j < m_active.size(); ++j)
+            {
+                uint32_t slot = m_active[j];
+                if (m_entries[slot].state)
+                {
+                    m_active[kept++] = slot;
+                }
+                else
+                {
+                    m_entries[slot].active = false;
+                }
+            }
+            m_active.resize(kept);
+        }
+
+    private:
+        struct Entry
+        {
+            TControl*   control;
+            TPanel*     panel;
+            uint64_t    key;
+            uint32_t    state;
+            bool        active;
+        };
+
+        static uint64_t MakeKey(unsigned panelId, unsigned ctrlId)
+        {
+            return (uint64_t(panelId) << 32) | ctrlId;
+        }
+
+        std::vector<Entry>                      m_entries;
+        std::vector<uint32_t>                   m_active;
+        std::unordered_map<uint64_t, uint32_t>  m_index;
+        std::unordered_map<TPanel*, unsigned>   m_panelIds;
+    };
+}
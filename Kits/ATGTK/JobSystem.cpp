@@ -0,0 +1,600 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "pch.h"
+#include "JobSystem.h"
+
+#ifdef _WIN32
+#include "ThreadHelpers.h"
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <stdexcept>
+#include <thread>
+
+using namespace DX;
+
+struct JobCounter::Continuation
+{
+    JobSystem::JobFunction  func;
+    JobCounter*             counter;
+};
+
+namespace
+{
+    //----------------------------------------------------------------------------------
+    // Chase-Lev work-stealing deque of fixed size. Push and Pop are only called by the owning worker;
+    // Steal can be called by any thread.
+    // See "Correct and Efficient Work-Stealing for Weak Memory Models" (Le, Pop, Cohen, Zappa Nardelli 2013).
+    template<typename T>
+    class WorkStealingDeque
+    {
+    public:
+        explicit WorkStealingDeque(uint32_t size) :
+            m_top(0),
+            m_bottom(0),
+            m_mask(size - 1),
+            m_jobs(new std::atomic<T*>[size])
+        {
+        }
+
+        bool Push(T* job)
+        {
+            int64_t b = m_bottom.load(std::memory_order_relaxed);
+            int64_t t = m_top.load(std::memory_order_acquire);
+            if (b - t > int64_t(m_mask))
+                return false;
+
+            m_jobs[b & m_mask].store(job, std::memory_order_release);
+            std::atomic_thread_fence(std::memory_order_release);
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+        T* Pop()
+        {
+            int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+            m_bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = m_top.load(std::memory_order_relaxed);
+
+            if (t > b)
+            {
+                // Empty
+                m_bottom.store(b + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+
+            T* job = m_jobs[b & m_mask].load(std::memory_order_relaxed);
+            if (t == b)
+            {
+                // Last job, so race any thieves for it
+                if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                {
+                    job = nullptr;
+                }
+                m_bottom.store(b + 1, std::memory_order_relaxed);
+            }
+
+            return job;
+        }
+
+        T* Steal()
+        {
+            int64_t t = m_top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t b = m_bottom.load(std::memory_order_acquire);
+
+            if (t >= b)
+                return nullptr;
+
+            T* job = m_jobs[t & m_mask].load(std::memory_order_acquire);
+            if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return nullptr;
+
+            return job;
+        }
+
+    private:
+        // Keep the thief and owner ends on separate cache lines
+        std::atomic<int64_t>                    m_top;
+        uint8_t                                 m_pad[64 - sizeof(std::atomic<int64_t>)];
+        std::atomic<int64_t>                    m_bottom;
+        int64_t                                 m_mask;
+        std::unique_ptr<std::atomic<T*>[]>      m_jobs;
+    };
+
+    // Spins before a worker with nothing to do goes to sleep
+    const uint32_t c_spinCount = 64;
+}
+
+
+//--------------------------------------------------------------------------------------
+class JobSystem::Impl
+{
+public:
+    typedef JobCounter::Continuation Job;
+
+    Impl(const Settings& settings);
+    ~Impl();
+
+    void Submit(Job* job);
+    void Wait(JobCounter& counter);
+
+    uint32_t GetWorkerCount() const { return static_cast<uint32_t>(m_workers.size()); }
+
+    void GetWorkerCores(std::vector<uint32_t>& cores) const
+    {
+        cores.clear();
+        for (auto& worker : m_workers)
+        {
+            cores.push_back(worker->core);
+        }
+    }
+
+    uint64_t GetJobsRun() const { return m_jobsRun.load(std::memory_order_relaxed); }
+    uint64_t GetJobsStolen() const { return m_jobsStolen.load(std::memory_order_relaxed); }
+
+    void Execute(Job* job);
+
+private:
+    struct Worker
+    {
+        Worker(uint32_t dequeSize, uint32_t coreIndex) :
+            deque(dequeSize),
+            core(coreIndex)
+        {
+        }
+
+        WorkStealingDeque<Job>  deque;
+        uint32_t                core;
+        std::thread             thread;
+    };
+
+    int GetWorkerIndex() const;
+    Job* FindJob(int workerIndex, uint32_t& victim);
+    void WorkerThread(int index);
+
+    std::vector<std::unique_ptr<Worker>>    m_workers;
+
+    // Jobs from threads outside the pool, and overflow from full deques
+    std::mutex                              m_queueLock;
+    std::deque<Job*>                        m_queue;
+    std::atomic<uint32_t>                   m_queueSize;
+
+    // Workers sleep when they find no work, and are woken when more is submitted
+    std::mutex                              m_sleepLock;
+    std::condition_variable                 m_wake;
+    std::atomic<uint32_t>                   m_sleeping;
+    uint64_t                                m_wakeEpoch;
+    bool                                    m_shutdown;
+
+    std::atomic<uint64_t>                   m_jobsRun;
+    std::atomic<uint64_t>                   m_jobsStolen;
+
+    // Job system and worker the current thread belongs to
+    static thread_local Impl*               t_owner;
+    static thread_local int                 t_workerIndex;
+};
+
+thread_local JobSystem::Impl* JobSystem::Impl::t_owner = nullptr;
+thread_local int JobSystem::Impl::t_workerIndex = -1;
+
+
+JobSystem::Impl::Impl(const Settings& settings) :
+    m_queueSize(0),
+    m_sleeping(0),
+    m_wakeEpoch(0),
+    m_shutdown(false),
+    m_jobsRun(0),
+    m_jobsStolen(0)
+{
+    if (!settings.dequeSize || (settings.dequeSize & (settings.dequeSize - 1)))
+    {
+        throw std::invalid_argument("JobSystem deque size must be a power of 2");
+    }
+
+#ifdef _WIN32
+    auto threadHelpers = ThreadHelpers::Instance();
+    uint32_t coreCount = std::max(threadHelpers->GetCoreCount(), 1u);
+#else
+    uint32_t coreCount = std::max(std::thread::hardware_concurrency(), 1u);
+#endif
+
+    std::vector<uint32_t> cores;
+    for (uint32_t core = 0; core < coreCount; ++core)
+    {
+        if (core >= 32 || !(settings.reservedCoreMask & (1u << core)))
+        {
+            cores.push_back(core);
+        }
+    }
+
+    if (cores.empty())
+    {
+        throw std::invalid_argument("JobSystem has no cores available");
+    }
+
+    // By default the calling thread is expected to keep one of the cores busy
+    uint32_t workerCount = settings.workerCount;
+    if (!workerCount)
+    {
+        workerCount = std::max(static_cast<uint32_t>(cores.size()) - 1, 1u);
+    }
+
+    for (uint32_t j = 0; j < workerCount; ++j)
+    {
+        // Cores are assigned from the end, leaving lower cores for the calling thread
+        uint32_t core = cores[cores.size() - 1 - (j % cores.size())];
+        m_workers.emplace_back(new Worker(settings.dequeSize, core));
+    }
+
+    for (size_t j = 0; j < m_workers.size(); ++j)
+    {
+        auto& worker = *m_workers[j];
+        worker.thread = std::thread(&JobSystem::Impl::WorkerThread, this, static_cast<int>(j));
+
+#ifdef _WIN32
+        HANDLE hThread = static_cast<HANDLE>(worker.thread.native_handle());
+        if (settings.pinThreads)
+        {
+            threadHelpers->SetThreadPhysicalProcessor(hThread, worker.core);
+        }
+        SetThreadName(hThread, "JobSystem Worker");
+#elif defined(__linux__)
+        if (settings.pinThreads)
+        {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(worker.core, &cpus);
+            (void)pthread_setaffinity_np(worker.thread.native_handle(), sizeof(cpus), &cpus);
+        }
+#endif
+    }
+}
+
+
+JobSystem::Impl::~Impl()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleepLock);
+        m_shutdown = true;
+        ++m_wakeEpoch;
+    }
+    m_wake.notify_all();
+
+    for (auto& worker : m_workers)
+    {
+        if (worker->thread.joinable())
+            worker->thread.join();
+    }
+
+    // A worker can push a job to its deque after another worker has done its final pass, so finish
+    // whatever is left in every deque and the shared queue on this thread.
+    uint32_t victim = 0;
+    while (Job* job = FindJob(-1, victim))
+    {
+        Execute(job);
+    }
+}
+
+
+int JobSystem::Impl::GetWorkerIndex() const
+{
+    return (t_owner == this) ? t_workerIndex : -1;
+}
+
+
+void JobSystem::Impl::Submit(Job* job)
+{
+    int index = GetWorkerIndex();
+    if (index < 0 || !m_workers[index]->deque.Push(job))
+    {
+        std::lock_guard<std::mutex> lock(m_queueLock);
+        m_queue.push_back(job);
+        m_queueSize.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    // Pairs with the fence in WorkerThread, so either the worker sees this job or this sees it sleeping
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_sleeping.load(std::memory_order_relaxed) > 0)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_sleepLock);
+            ++m_wakeEpoch;
+        }
+        m_wake.notify_one();
+    }
+}
+
+
+JobSystem::Impl::Job* JobSystem::Impl::FindJob(int workerIndex, uint32_t& victim)
+{
+    if (workerIndex >= 0)
+    {
+        Job* job = m_workers[workerIndex]->deque.Pop();
+        if (job)
+            return job;
+    }
+
+    if (m_queueSize.load(std::memory_order_relaxed) > 0)
+    {
+        std::lock_guard<std::mutex> lock(m_queueLock);
+        if (!m_queue.empty())
+        {
+            Job* job = m_queue.front();
+            m_queue.pop_front();
+            m_queueSize.fetch_sub(1, std::memory_order_relaxed);
+            return job;
+        }
+    }
+
+    // Try each other worker once, starting where the last successful steal was
+    size_t count = m_workers.size();
+    for (size_t j = 0; j < count; ++j)
+    {
+        uint32_t index = static_cast<uint32_t>((victim + j) % count);
+        if (int(index) == workerIndex)
+            continue;
+
+        Job* job = m_workers[index]->deque.Steal();
+        if (job)
+        {
+            victim = index;
+            m_jobsStolen.fetch_add(1, std::memory_order_relaxed);
+            return job;
+        }
+    }
+
+    return nullptr;
+}
+
+
+void JobSystem::Impl::Execute(Job* job)
+{
+    job->func();
+
+    JobCounter* counter = job->counter;
+    delete job;
+
+    m_jobsRun.fetch_add(1, std::memory_order_relaxed);
+
+    if (!counter)
+        return;
+
+    uint32_t value = counter->m_value.load(std::memory_order_relaxed);
+    while (value > 1)
+    {
+        if (counter->m_value.compare_exchange_weak(value, value - 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+            return;
+    }
+
+    // Counter reaches zero under its lock, so Wait can't return (and the counter be destroyed) until this is
+    // done with it. Then release the jobs waiting on it. Another job may have been submitted with the counter
+    // since it was read above, in which case this was not the last one after all.
+    std::vector<Job*> continuations;
+    {
+        std::lock_guard<std::mutex> lock(counter->m_lock);
+        if (counter->m_value.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            continuations.swap(counter->m_continuations);
+        }
+    }
+
+    for (auto continuation : continuations)
+    {
+        Submit(continuation);
+    }
+}
+
+
+void JobSystem::Impl::WorkerThread(int index)
+{
+    t_owner = this;
+    t_workerIndex = index;
+
+    uint32_t victim = static_cast<uint32_t>(index + 1);
+    uint32_t idle = 0;
+
+    for (;;)
+    {
+        Job* job = FindJob(index, victim);
+        if (job)
+        {
+            Execute(job);
+            idle = 0;
+            continue;
+        }
+
+        if (++idle < c_spinCount)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepLock);
+        if (m_shutdown)
+            break;
+
+        uint64_t epoch = m_wakeEpoch;
+        m_sleeping.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        // Look once more now that submitters can see this worker is going to sleep
+        lock.unlock();
+        job = FindJob(index, victim);
+        lock.lock();
+
+        if (!job)
+        {
+            m_wake.wait(lock, [&]() { return m_shutdown || m_wakeEpoch != epoch; });
+        }
+
+        m_sleeping.fetch_sub(1, std::memory_order_relaxed);
+        lock.unlock();
+
+        if (job)
+        {
+            Execute(job);
+        }
+        idle = 0;
+    }
+
+    // Finish anything still queued
+    while (Job* job = FindJob(index, victim))
+    {
+        Execute(job);
+    }
+}
+
+
+void JobSystem::Impl::Wait(JobCounter& counter)
+{
+    int index = GetWorkerIndex();
+    uint32_t victim = 0;
+
+    while (!counter.IsDone())
+    {
+        Job* job = FindJob(index, victim);
+        if (job)
+        {
+            Execute(job);
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    // Wait for the job that finished the counter to be done with it
+    std::lock_guard<std::mutex> lock(counter.m_lock);
+}
+
+
+//--------------------------------------------------------------------------------------
+JobSystem::JobSystem(const Settings& settings) :
+    pImpl(new Impl(settings))
+{
+}
+
+
+// Move constructor.
+JobSystem::JobSystem(JobSystem&& moveFrom)
+    : pImpl(std::move(moveFrom.pImpl))
+{
+}
+
+
+// Move assignment.
+JobSystem& JobSystem::operator= (JobSystem&& moveFrom)
+{
+    pImpl = std::move(moveFrom.pImpl);
+    return *this;
+}
+
+
+JobSystem::~JobSystem()
+{
+}
+
+
+_Use_decl_annotations_
+void JobSystem::Run(JobFunction job, JobCounter* counter)
+{
+    if (counter)
+    {
+        counter->m_value.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    pImpl->Submit(new Impl::Job{ std::move(job), counter });
+}
+
+
+_Use_decl_annotations_
+void JobSystem::RunAfter(JobCounter& dependency, JobFunction job, JobCounter* counter)
+{
+    if (counter)
+    {
+        counter->m_value.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::unique_ptr<Impl::Job> continuation(new Impl::Job{ std::move(job), counter });
+
+    {
+        std::lock_guard<std::mutex> lock(dependency.m_lock);
+        if (!dependency.IsDone())
+        {
+            dependency.m_continuations.push_back(continuation.release());
+            return;
+        }
+    }
+
+    pImpl->Submit(continuation.release());
+}
+
+
+_Use_decl_annotations_
+void JobSystem::Wait(JobCounter& counter)
+{
+    pImpl->Wait(counter);
+}
+
+
+void JobSystem::ParallelFor(size_t count, size_t grainSize, RangeFunction func)
+{
+    if (!count)
+        return;
+
+    if (!grainSize)
+    {
+        size_t ranges = size_t(pImpl->GetWorkerCount() + 1) * 4;
+        grainSize = std::max<size_t>((count + ranges - 1) / ranges, 1);
+    }
+
+    if (grainSize >= count)
+    {
+        func(0, count);
+        return;
+    }
+
+    // The calling thread takes the first range itself
+    JobCounter counter;
+    for (size_t begin = grainSize; begin < count; begin += grainSize)
+    {
+        size_t end = std::min(begin + grainSize, count);
+        Run([&func, begin, end]() { func(begin, end); }, &counter);
+    }
+
+    func(0, grainSize);
+
+    pImpl->Wait(counter);
+}
+
+
+uint32_t JobSystem::GetWorkerCount() const
+{
+    return pImpl->GetWorkerCount();
+}
+
+
+void JobSystem::GetWorkerCores(std::vector<uint32_t>& cores) const
+{
+    pImpl->GetWorkerCores(cores);
+}
+
+
+uint64_t JobSystem::GetJobsRun() const
+{
+    return pImpl->GetJobsRun();
+}
+
+
+uint64_t JobSystem::GetJobsStolen() const
+{
+    return pImpl->GetJobsStolen();
+}
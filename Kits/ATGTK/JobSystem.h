@@ -0,0 +1,117 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Work-stealing job system
+//
+// One worker thread is pinned to each available physical core (from DX::ThreadHelpers, or each logical
+// processor on other platforms), skipping any cores reserved for other work such as rendering. Each worker pushes and pops jobs at the bottom of its own
+// Chase-Lev deque, and steals from the top of the other workers' deques when it runs out. Jobs submitted
+// from threads outside the pool go through a shared queue.
+//
+// Completion is tracked with JobCounters: each job submitted with a counter increments it, and decrements
+// it when the job finishes. Waiting on a counter runs other jobs rather than blocking, and jobs can be
+// deferred until a counter reaches zero to express dependencies.
+//
+// Jobs must not throw exceptions.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+namespace DX
+{
+    class JobSystem;
+
+    class JobCounter
+    {
+    public:
+        JobCounter() : m_value(0) {}
+
+        JobCounter(const JobCounter&) = delete;
+        JobCounter& operator=(const JobCounter&) = delete;
+
+        // Number of jobs submitted with this counter that haven't finished.
+        uint32_t GetValue() const { return m_value.load(std::memory_order_acquire); }
+        bool IsDone() const { return GetValue() == 0; }
+
+    private:
+        friend class JobSystem;
+
+        struct Continuation;
+
+        std::atomic<uint32_t>       m_value;
+        std::mutex                  m_lock;
+        std::vector<Continuation*>  m_continuations;
+    };
+
+    class JobSystem
+    {
+    public:
+        typedef std::function<void()> JobFunction;
+        typedef std::function<void(size_t begin, size_t end)> RangeFunction;
+
+        struct Settings
+        {
+            uint32_t    workerCount;        // 0 for one per available core, less one for the calling thread
+            uint32_t    reservedCoreMask;   // Bit per physical core index which workers must not run on
+            uint32_t    dequeSize;          // Jobs each worker can have queued; must be a power of 2
+            bool        pinThreads;         // Set each worker's affinity to its core
+
+            Settings() :
+                workerCount(0),
+                reservedCoreMask(0),
+                dequeSize(4096),
+                pinThreads(true)
+            {
+            }
+        };
+
+        explicit JobSystem(const Settings& settings = Settings());
+
+        JobSystem(JobSystem&& moveFrom);
+        JobSystem& operator= (JobSystem&& moveFrom);
+
+        JobSystem(const JobSystem&) = delete;
+        JobSystem& operator=(const JobSystem&) = delete;
+
+        // Waits for the jobs that have already been submitted, then stops the workers.
+        ~JobSystem();
+
+        // Submits a job. If counter is not null, it is incremented now and decremented once the job has run.
+        void Run(JobFunction job, _In_opt_ JobCounter* counter = nullptr);
+
+        // Submits a job once dependency reaches zero.
+        void RunAfter(_In_ JobCounter& dependency, JobFunction job, _In_opt_ JobCounter* counter = nullptr);
+
+        // Runs jobs on the calling thread until counter reaches zero. A counter that jobs were submitted with
+        // must be waited on before it is destroyed.
+        void Wait(_In_ JobCounter& counter);
+
+        // Calls func over [0, count) in ranges of at most grainSize and waits for them all. A grainSize of 0
+        // picks a size that gives each worker a few ranges.
+        void ParallelFor(size_t count, size_t grainSize, RangeFunction func);
+
+        uint32_t GetWorkerCount() const;
+
+        // Physical core index each worker runs on.
+        void GetWorkerCores(std::vector<uint32_t>& cores) const;
+
+        // Jobs run, and taken from another worker's deque, since the job system was created.
+        uint64_t GetJobsRun() const;
+        uint64_t GetJobsStolen() const;
+
+    private:
+        // Private implementation.
+        class Impl;
+
+        std::unique_ptr<Impl> pImpl;
+    };
+}
@@ -0,0 +1,248 @@
+//--------------------------------------------------------------------------------------
+// File: MappedFile.h
+//
+// Read-only memory-mapped view of a file. Pages are faulted in by the OS as they are
+// touched, so only the parts of a file that are actually read become resident and the
+// physical pages can be shared with other processes mapping the same file.
+//
+// Other platforms use mmap, so the kit's parsers can be tested outside of Windows.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+//-------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace DX
+{
+    class MappedFile
+    {
+    public:
+        MappedFile() noexcept :
+#ifndef _WIN32
+            m_file(-1),
+#endif
+            m_data(nullptr),
+            m_size(0)
+        {
+        }
+
+        MappedFile(MappedFile&& moveFrom) noexcept :
+#ifdef _WIN32
+            m_hFile(std::move(moveFrom.m_hFile)),
+            m_hMapping(std::move(moveFrom.m_hMapping)),
+#else
+            m_file(moveFrom.m_file),
+#endif
+            m_data(moveFrom.m_data),
+            m_size(moveFrom.m_size)
+        {
+#ifndef _WIN32
+            moveFrom.m_file = -1;
+#endif
+            moveFrom.m_data = nullptr;
+            moveFrom.m_size = 0;
+        }
+
+        MappedFile& operator= (MappedFile&& moveFrom) noexcept
+        {
+            if (this != &moveFrom)
+            {
+                Close();
+#ifdef _WIN32
+                m_hFile = std::move(moveFrom.m_hFile);
+                m_hMapping = std::move(moveFrom.m_hMapping);
+#else
+                m_file = moveFrom.m_file;
+                moveFrom.m_file = -1;
+#endif
+                m_data = moveFrom.m_data;
+                m_size = moveFrom.m_size;
+                moveFrom.m_data = nullptr;
+                moveFrom.m_size = 0;
+            }
+            return *this;
+        }
+
+        MappedFile(MappedFile const&) = delete;
+        MappedFile& operator= (MappedFile const&) = delete;
+
+        ~MappedFile()
+        {
+            Close();
+        }
+
+        // sequentialScan is a caching hint for files that will be read front to back.
+        HRESULT Open(_In_z_ const wchar_t* fileName, bool sequentialScan = false)
+        {
+            Close();
+
+            if (!fileName)
+                return E_INVALIDARG;
+
+#ifndef _WIN32
+            size_t length = wcstombs(nullptr, fileName, 0);
+            if (length == static_cast<size_t>(-1))
+                return E_INVALIDARG;
+
+            std::string path(length, '\0');
+            wcstombs(&path[0], fileName, length);
+
+            int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (file < 0)
+                return E_FAIL;
+
+            struct stat fileInfo;
+            if (fstat(file, &fileInfo) != 0 || static_cast<uint64_t>(fileInfo.st_size) > SIZE_MAX)
+            {
+                close(file);
+                return E_FAIL;
+            }
+
+            // Zero-length files can't be mapped, but are valid (and empty)
+            if (fileInfo.st_size > 0)
+            {
+                void* view = mmap(nullptr, static_cast<size_t>(fileInfo.st_size), PROT_READ, MAP_SHARED, file, 0);
+                if (view == MAP_FAILED)
+                {
+                    close(file);
+                    return E_FAIL;
+                }
+
+                madvise(view, static_cast<size_t>(fileInfo.st_size), sequentialScan ? MADV_SEQUENTIAL : MADV_RANDOM);
+
+                m_data = static_cast<const uint8_t*>(view);
+                m_size = static_cast<size_t>(fileInfo.st_size);
+            }
+
+            m_file = file;
+
+            return S_OK;
+#else
+#if (_WIN32_WINNT >= 0x0602 /*_WIN32_WINNT_WIN8*/)
+            CREATEFILE2_EXTENDED_PARAMETERS params = {};
+            params.dwSize = sizeof(CREATEFILE2_EXTENDED_PARAMETERS);
+            params.dwFileAttributes = FILE_ATTRIBUTE_NORMAL;
+            params.dwFileFlags = sequentialScan ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS;
+            ScopedHandle hFile(safe_handle(CreateFile2(fileName,
+                GENERIC_READ,
+                FILE_SHARE_READ,
+                OPEN_EXISTING,
+                &params)));
+#else
+            ScopedHandle hFile(safe_handle(CreateFileW(fileName,
+                GENERIC_READ,
+                FILE_SHARE_READ,
+                nullptr,
+                OPEN_EXISTING,
+                FILE_ATTRIBUTE_NORMAL | (sequentialScan ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS),
+                nullptr)));
+#endif
+            if (!hFile)
+            {
+                return HRESULT_FROM_WIN32(GetLastError());
+            }
+
+            FILE_STANDARD_INFO fileInfo;
+            if (!GetFileInformationByHandleEx(hFile.get(), FileStandardInfo, &fileInfo, sizeof(fileInfo)))
+            {
+                return HRESULT_FROM_WIN32(GetLastError());
+            }
+
+            if (static_cast<uint64_t>(fileInfo.EndOfFile.QuadPart) > SIZE_MAX)
+            {
+                // File can't be mapped into the address space
+                return HRESULT_FROM_WIN32(ERROR_FILE_TOO_LARGE);
+            }
+
+            // Zero-length files can't be mapped, but are valid (and empty)
+            if (fileInfo.EndOfFile.QuadPart > 0)
+            {
+                ScopedHandle hMapping(CreateFileMappingW(hFile.get(), nullptr, PAGE_READONLY, 0, 0, nullptr));
+                if (!hMapping)
+                {
+                    return HRESULT_FROM_WIN32(GetLastError());
+                }
+
+                void* view = MapViewOfFile(hMapping.get(), FILE_MAP_READ, 0, 0, 0);
+                if (!view)
+                {
+                    return HRESULT_FROM_WIN32(GetLastError());
+                }
+
+                m_hMapping = std::move(hMapping);
+                m_data = static_cast<const uint8_t*>(view);
+                m_size = static_cast<size_t>(fileInfo.EndOfFile.QuadPart);
+            }
+
+            m_hFile = std::move(hFile);
+
+            return S_OK;
+#endif
+        }
+
+        void Close() noexcept
+        {
+#ifdef _WIN32
+            if (m_data)
+            {
+                UnmapViewOfFile(m_data);
+                m_data = nullptr;
+            }
+            m_size = 0;
+            m_hMapping.reset();
+            m_hFile.reset();
+#else
+            if (m_data)
+            {
+                munmap(const_cast<uint8_t*>(m_data), m_size);
+                m_data = nullptr;
+            }
+            m_size = 0;
+            if (m_file >= 0)
+            {
+                close(m_file);
+                m_file = -1;
+            }
+#endif
+        }
+
+#ifdef _WIN32
+        bool IsOpen() const noexcept { return m_hFile != nullptr; }
+#else
+        bool IsOpen() const noexcept { return m_file >= 0; }
+#endif
+
+        const uint8_t* GetData() const noexcept { return m_data; }
+        size_t GetSize() const noexcept { return m_size; }
+
+    private:
+#ifdef _WIN32
+        struct handle_closer { void operator()(HANDLE h) { if (h) CloseHandle(h); } };
+
+        typedef std::unique_ptr<void, handle_closer> ScopedHandle;
+
+        static HANDLE safe_handle(HANDLE h) { return (h == INVALID_HANDLE_VALUE) ? nullptr : h; }
+
+        ScopedHandle    m_hFile;
+        ScopedHandle    m_hMapping;
+#else
+        int             m_file;
+#endif
+        const uint8_t*  m_data;
+        size_t          m_size;
+    };
+}
@@ -36,8 +36,12 @@
 #endif
 
 // Other required ATG Tool Kit components
+#include "ControlRegistry.h"
 #include "ControllerFont.h"
 #include "CSVReader.h"
+#include "MappedFile.h"
+#include "SampleGUILayout.h"
+#include "TextLayout.h"
 
 using namespace DirectX;
 using namespace ATG;
@@ -245,136 +249,6 @@ namespace
         }
     }
 
-    void TrimTrailingWhitespace(_Inout_z_ wchar_t* str)
-    {
-        size_t len = wcslen(str);
-        for(wchar_t *ptr = str + len; len > 0; --len, --ptr)
-        {
-            if (!iswspace( *(ptr-1) ))
-            {
-                *ptr = 0;
-                break;
-            }
-        }
-    }
-
-    std::wstring WordWrap( _In_z_ const wchar_t* text, _In_ SpriteFont* font, const RECT& rect, std::vector<size_t>* lineStarts = nullptr)
-    {
-        if (lineStarts)
-        {
-            lineStarts->clear();
-            if (*text)
-                lineStarts->push_back(0);
-        }
-
-        std::wstring str;
-        str.reserve(wcslen(text));
-
-        size_t line_start = 0;
-        size_t last_line = 0;
-        size_t last_word = 0;
-        size_t extra = 0;
-
-        const wchar_t *ptr = text;
-
-        XMFLOAT2 pos(float(rect.left), float(rect.top));
-
-        wchar_t prevch = 0;
-        while (*ptr != L'\0')
-        {
-            const wchar_t ch = *ptr;
-
-            str.push_back(ch);
-
-            if (iswspace(ch))
-            {
-                last_word = size_t(ptr - text);
-            }
-            else if (prevch == L'-')
-            {
-                last_word = size_t(ptr - text - 1);
-            }
-
-            RECT textrect = font->MeasureDrawBounds(str.c_str() + line_start, pos);
-
-            if (textrect.right > rect.right)
-            {
-                if (last_word > last_line)
-                {
-                    str.erase(str.cbegin() + ptrdiff_t(last_word + extra), str.cend());
-                    str.push_back(L'\n');
-                    ++extra;
-                    last_line = last_word;
-                    ptr = text + last_word + 1;
-                }
-                else
-                {
-                    str.erase(str.cend() - 1);
-                    str.push_back(L'\n');
-                    ++extra;
-                    last_line = last_word = str.length() - extra;
-                }
-
-                line_start = last_line + extra;
-
-                if (lineStarts)
-                {
-                    lineStarts->push_back(last_line + extra);
-                }
-
-                prevch = 0;
-                continue;
-            }
-
-            ++ptr;
-            prevch = ch;
-        }
-
-        return str;
-    }
-
-    void HandleEscapeCharacters(_Inout_z_ wchar_t* str)
-    {
-        for (wchar_t*ptr = str; *ptr != 0; ++ptr)
-        {
-            if (*ptr == L'|')
-                *ptr = L'\n';
-        }
-    }
-
-    unsigned HandleVirtualKeys(_Inout_z_ wchar_t* str)
-    {
-        static const struct Map { const wchar_t* first; unsigned second; } s_map[] =
-        {
-            { L"F1", VK_F1 },
-            { L"F2", VK_F2 },
-            { L"F3", VK_F3 },
-            { L"F4", VK_F4 },
-            { L"F5", VK_F5 },
-            { L"F6", VK_F6 },
-            { L"F7", VK_F7 },
-            { L"F8", VK_F8 },
-            { L"F9", VK_F9 },
-            { L"F10", VK_F10 },
-        };
-
-        for(size_t j = 0; j < _countof(s_map); ++j)
-        {
-            if (_wcsicmp(s_map[j].first, str) == 0)
-            {
-                return s_map[j].second;
-            }
-        }
-
-        if (*(str + 1) == 0)
-        {
-            return unsigned(*str);
-        }
-
-        return 0;
-    }
-
-
     bool UpdateScrollBar(RECT& thumbRect, const RECT& trackRect, int position, int start, int end, int pageSize)
     {
         assert(pageSize > 0);
@@ -424,6 +298,45 @@ namespace
             (*cb)(false, true);
         }
     }
+
+
+    // Compiled layouts store the controls' own style values and virtual keys
+    static_assert(c_LayoutStylePanelCustom == c_styleCustomPanel && c_LayoutStylePanelEmphasis == c_stylePopupEmphasis
+        && c_LayoutStylePanelSuppressCancel == c_styleSuppressCancel, "Layout panel styles mismatch");
+    static_assert(c_LayoutStyleAlignLeft == TextLabel::c_StyleAlignLeft && c_LayoutStyleAlignCenter == TextLabel::c_StyleAlignCenter
+        && c_LayoutStyleAlignRight == TextLabel::c_StyleAlignRight && c_LayoutStyleAlignMiddle == TextLabel::c_StyleAlignMiddle
+        && c_LayoutStyleLabelTransparent == TextLabel::c_StyleTransparent && c_LayoutStyleLabelWordWrap == TextLabel::c_StyleWordWrap
+        && c_LayoutStyleFontSmall == TextLabel::c_StyleFontSmall && c_LayoutStyleFontLarge == TextLabel::c_StyleFontLarge
+        && c_LayoutStyleFontBold == TextLabel::c_StyleFontBold && c_LayoutStyleFontItalic == TextLabel::c_StyleFontItalic, "Layout label styles mismatch");
+    static_assert(c_LayoutStyleAlignLeft == Legend::c_StyleAlignLeft && c_LayoutStyleAlignCenter == Legend::c_StyleAlignCenter
+        && c_LayoutStyleAlignRight == Legend::c_StyleAlignRight && c_LayoutStyleAlignMiddle == Legend::c_StyleAlignMiddle
+        && c_LayoutStyleLabelTransparent == Legend::c_StyleTransparent
+        && c_LayoutStyleFontSmall == Legend::c_StyleFontSmall && c_LayoutStyleFontLarge == Legend::c_StyleFontLarge
+        && c_LayoutStyleFontBold == Legend::c_StyleFontBold && c_LayoutStyleFontItalic == Legend::c_StyleFontItalic, "Layout legend styles mismatch");
+    static_assert(c_LayoutStyleExit == Button::c_StyleExit && c_LayoutStyleDefault == Button::c_StyleDefault
+        && c_LayoutStyleButtonTransparent == Button::c_StyleTransparent
+        && c_LayoutStyleFontSmall == Button::c_StyleFontSmall && c_LayoutStyleFontLarge == Button::c_StyleFontLarge
+        && c_LayoutStyleFontBold == Button::c_StyleFontBold && c_LayoutStyleFontItalic == Button::c_StyleFontItalic, "Layout button styles mismatch");
+    static_assert(c_LayoutStyleExit == ImageButton::c_StyleExit && c_LayoutStyleDefault == ImageButton::c_StyleDefault
+        && c_LayoutStyleImageButtonBackground == ImageButton::c_StyleBackground
+        && c_LayoutStyleImageButtonTransparent == ImageButton::c_StyleTransparent, "Layout image button styles mismatch");
+    static_assert(c_LayoutStyleCheckBoxTransparent == CheckBox::c_StyleTransparent
+        && c_LayoutStyleFontSmall == CheckBox::c_StyleFontSmall && c_LayoutStyleFontLarge == CheckBox::c_StyleFontLarge
+        && c_LayoutStyleFontBold == CheckBox::c_StyleFontBold && c_LayoutStyleFontItalic == CheckBox::c_StyleFontItalic, "Layout check box styles mismatch");
+    static_assert(c_LayoutStyleSliderTransparent == Slider::c_StyleTransparent, "Layout slider styles mismatch");
+    static_assert(c_LayoutStyleListBoxMultiSelection == ListBox::c_StyleMultiSelection && c_LayoutStyleListBoxTransparent == ListBox::c_StyleTransparent
+        && c_LayoutStyleListBoxScrollBar == ListBox::c_StyleScrollBar
+        && c_LayoutStyleFontSmall == ListBox::c_StyleFontSmall && c_LayoutStyleFontLarge == ListBox::c_StyleFontLarge
+        && c_LayoutStyleFontBold == ListBox::c_StyleFontBold && c_LayoutStyleFontItalic == ListBox::c_StyleFontItalic, "Layout list box styles mismatch");
+    static_assert(c_LayoutStyleTextBoxTransparent == TextBox::c_StyleTransparent && c_LayoutStyleTextBoxScrollBar == TextBox::c_StyleScrollBar
+        && c_LayoutStyleTextBoxNoBackground == TextBox::c_StyleNoBackground
+        && c_LayoutStyleFontSmall == TextBox::c_StyleFontSmall && c_LayoutStyleFontLarge == TextBox::c_StyleFontLarge
+        && c_LayoutStyleFontBold == TextBox::c_StyleFontBold && c_LayoutStyleFontItalic == TextBox::c_StyleFontItalic, "Layout text box styles mismatch");
+    static_assert(c_LayoutColorCount == UIConfig::MAX_COLORS, "Layout colors mismatch");
+    static_assert(c_LayoutKeyF1 == VK_F1 && c_LayoutKeyF1 + 9 == VK_F10, "Layout virtual keys mismatch");
+
+    // The compiled string table is UTF-16, used in place
+    static_assert(sizeof(wchar_t) == sizeof(uint16_t), "Compiled layouts need a 16-bit wchar_t");
 }
 
 
@@ -442,6 +355,7 @@ public:
         m_focusPanel(nullptr),
         m_overlayPanel(nullptr),
         m_hudPanel(nullptr),
+        m_controlEpoch(++s_controlEpochs),
         m_heldTimer(0),
         m_mouseLastX(-1),
         m_mouseLastY(-1),
@@ -461,912 +375,203 @@ public:
         {
             delete it.second;
         }
-        m_panels.clear();
-
-        m_focusPanel = nullptr;
-        m_overlayPanel = nullptr;
-        m_hudPanel = nullptr;
-
-        s_uiManager = nullptr;
-    }
-
-    void LoadLayout(const wchar_t* layoutFile, const wchar_t* imageDir, unsigned offset)
-    {
-        static const wchar_t* s_seps = L" ,;|";
-        static wchar_t s_text[4096] = {};
-
-        DX::CSVReader reader(layoutFile, DX::CSVReader::Encoding::UTF8, true);
-
-        IPanel* currentPanel = nullptr;
-
-        if (imageDir)
-            m_layoutImageDir = imageDir;
-        else
-            m_layoutImageDir.clear();
-
-        while (!reader.EndOfFile())
-        {
-            // Each record starts with ITEM,ID,RECTX,RECTY,DX,DY
-            wchar_t item[1024] = {};
-            if (!reader.NextItem(item))
-            {
-                reader.NextRecord();
-                continue;
-            }
-
-            TrimTrailingWhitespace(item);
-
-            unsigned id;
-            {
-                // IPanel object ids need to be globally unique
-                wchar_t tmp[16] = {};
-                if (!reader.NextItem(tmp))
-                {
-                    DebugTrace("ERROR: Expected an id for record %zu\n", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
-                }
-                id = static_cast<unsigned>(_wtoi(tmp));
-            }
-
-            RECT rct = { 0, 0, 0, 0 };
-            {
-                wchar_t tmp[16] = {};
-                if (!reader.NextItem(tmp))
-                {
-                    DebugTrace("ERROR: Expected an rectx for record %zu\n", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
-                }
-
-                rct.left = _wtoi(tmp);
-
-                if (!reader.NextItem(tmp))
-                {
-                    DebugTrace("ERROR: Expected an recty for record %zu\n", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
-                }
-
-                rct.top = _wtoi(tmp);
-
-                if (!reader.NextItem(tmp))
-                {
-                    DebugTrace("ERROR: Expected an dx for record %zu\n", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
-                }
-
-                rct.right = rct.left + _wtoi(tmp);
-
-                if (!reader.NextItem(tmp))
-                {
-                    DebugTrace("ERROR: Expected an dy for record %zu\n", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
-                }
-
-                rct.bottom = rct.top + _wtoi(tmp);
-            }
-
-            // Create item
-            if (_wcsicmp(item, L"POPUP") == 0 || _wcsicmp(item, L"CUSTOM_POPUP") == 0)
-            {
-                id += offset;
-
-                auto it = m_panels.find(id);
-                if (it != m_panels.end())
-                {
-                    DebugTrace("ERROR: Duplicate panel id found [record %zu]\n", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
-                }
-
-                unsigned int styleFlags = (_wcsicmp(item, L"CUSTOM_POPUP") == 0) ? c_styleCustomPanel : 0;
-                wchar_t styleStr[128] = {};
-                if (reader.NextItem(styleStr))
-                {
-                    _wcsupr_s(styleStr);
-
-                    wchar_t* context = nullptr;
-                    const wchar_t* tok = wcstok_s(styleStr, s_seps, &context);
-                    while (tok)
-                    {
-                        if (wcscmp(tok, L"EMPHASIS") == 0)
-                        {
-                            styleFlags |= c_stylePopupEmphasis;
-                        }
-                        else if (wcscmp(tok, L"SUPPRESS_CANCEL") == 0)
-                        {
-                            styleFlags |= c_styleSuppressCancel;
-                        }
-                        tok = wcstok_s(nullptr, s_seps, &context);
-                    }
-                }
-
-                currentPanel = new Popup(rct, styleFlags);
-
-                m_panels[id] = currentPanel;
-            }
-            else if (_wcsicmp(item, L"HUD") == 0)
-            {
-                id += offset;
-
-                auto it = m_panels.find(id);
-                if (it != m_panels.end())
-                {
-                    DebugTrace("ERROR: Duplicate panel id found [record %zu]\n", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
-                }
-
-                currentPanel = new HUD(rct);
-
-                m_panels[id] = currentPanel;
-
-                if (!m_hudPanel)
-                {
-                    currentPanel->Show();
-                }
-            }
-            else if (_wcsicmp(item, L"OVERLAY") == 0 || _wcsicmp(item, L"CUSTOM_OVERLAY") == 0)
-            {
-                id += offset;
-
-                auto it = m_panels.find(id);
-                if (it != m_panels.end())
-                {
-                    DebugTrace("ERROR: Duplicate panel id found [record %zu]\n", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
-                }
-
-                unsigned int styleFlags = (_wcsicmp(item, L"CUSTOM_OVERLAY") == 0) ? c_styleCustomPanel : 0;
-                wchar_t styleStr[128] = {};
-                if (reader.NextItem(styleStr))
-                {
-                    _wcsupr_s(styleStr);
-
-                    wchar_t *context = nullptr;
-                    const wchar_t *tok = wcstok_s(styleStr, s_seps, &context);
-                    while (tok)
-                    {
-                        if (wcscmp(tok, L"SUPPRESS_CANCEL") == 0)
-                        {
-                            styleFlags |= c_styleSuppressCancel;
-                        }
-                        tok = wcstok_s(nullptr, s_seps, &context);
-                    }
-                }
-
-                currentPanel = new Overlay(rct, styleFlags);
-
-                m_panels[id] = currentPanel;
-            }
-            else if (_wcsicmp(item, L"LABEL") == 0)
-            {
-                if (!currentPanel)
-                {
-                    DebugTrace("ERROR: LABEL found outside of panel [record %zu]\n", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
-                }
-
-                if (!reader.NextItem(s_text))
-                {
-                    DebugTrace("ERROR: LABEL missing text string [record %zu]\n", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
-                }
-
-                HandleEscapeCharacters(s_text);
-
-                unsigned style = 0;
-                XMVECTOR fgColor = Colors::White;
-                XMVECTOR bgColor = Colors::Transparent;
-
-                wchar_t styleStr[128] = {};
-                if (reader.NextItem(styleStr))
-                {
-                    _wcsupr_s(styleStr);
-
-                    wchar_t* context = nullptr;
-                    const wchar_t* tok = wcstok_s(styleStr, s_seps, &context);
-                    while (tok)
-                    {
-                        if (wcscmp(tok, L"LEFT") == 0)
-                        {
-                            style |= TextLabel::c_StyleAlignLeft | TextLabel::c_StyleAlignMiddle;
-                        }
-                        else if (wcscmp(tok, L"CENTER") == 0)
-                        {
-                            style |= TextLabel::c_StyleAlignCenter | TextLabel::c_StyleAlignMiddle;
-                        }
-                        else if (wcscmp(tok, L"RIGHT") == 0)
-                        {
-                            style |= TextLabel::c_StyleAlignRight | TextLabel::c_StyleAlignMiddle;
-                        }
-                        else if (wcscmp(tok, L"LARGE") == 0)
-                        {
-                            style |= TextLabel::c_StyleFontLarge;
-                        }
-                        else if (wcscmp(tok, L"SMALL") == 0)
-                        {
-                            style |= TextLabel::c_StyleFontSmall;
-                        }
-                        else if (wcscmp(tok, L"BOLD") == 0)
-                        {
-                            style |= TextLabel::c_StyleFontBold;
-                        }
-                        else if (wcscmp(tok, L"ITALIC") == 0)
-                        {
-                            style |= TextLabel::c_StyleFontItalic;
-                        }
-                        else if (wcscmp(tok, L"TRANSPARENT") == 0)
-                        {
-                            style |= TextLabel::c_StyleTransparent;
-                        }
-                        else if (wcscmp(tok, L"WORDWRAP") == 0)
-                        {
-                            style |= TextLabel::c_StyleWordWrap;
-                        }
-
-                        tok = wcstok_s(nullptr, s_seps, &context);
-                    }
-
-                    wchar_t colorStr[32] = {};
-                    if (reader.NextItem(colorStr))
-                    {
-                        _wcsupr_s(colorStr);
-                        fgColor = LoadColorItem(colorStr, reader.RecordIndex());
-                    }
-
-                    if (reader.NextItem(colorStr))
-                    {
-                        _wcsupr_s(colorStr);
-                        bgColor = LoadColorItem(colorStr, reader.RecordIndex());
-                    }
-                }
-
-                if (id)
-                {
-                    // check for duplicates if nonzero ids used
-                    if (currentPanel->Find(id))
-                    {
-                        DebugTrace("ERROR: Duplicate control id found [record %zu]\n", reader.RecordIndex() + 1);
-                        throw std::exception("LoadLayout");
-                    }
-                }
-
-                auto label = new TextLabel(id, s_text, rct, style);
-                label->SetForegroundColor(fgColor);
-                label->SetBackgroundColor(bgColor);
-                currentPanel->Add(label);
-            }
-            else if (_wcsicmp(item, L"LEGEND") == 0)
-            {
-                if (!currentPanel)
-                {
-                    DebugTrace("ERROR: LEGEND found outside of panel [record %zu]\n", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
-                }
-
-                if (!reader.NextItem(s_text))
-                {
-                    DebugTrace("ERROR: LEGEND missing text string [record %zu]\n", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
-                }
-
-                HandleEscapeCharacters(s_text);
-
-                unsigned style = 0;
-                XMVECTOR fgColor = Colors::White;
-                XMVECTOR bgColor = Colors::Transparent;
-
-                wchar_t styleStr[128] = {};
-                if (reader.NextItem(styleStr))
-                {
-                    _wcsupr_s(styleStr);
-
-                    wchar_t* context = nullptr;
-                    const wchar_t* tok = wcstok_s(styleStr, s_seps, &context);
-                    while (tok)
-                    {
-                        if (wcscmp(tok, L"LEFT") == 0)
-                        {
-                            style |= Legend::c_StyleAlignLeft | Legend::c_StyleAlignMiddle;
-                        }
-                        else if (wcscmp(tok, L"CENTER") == 0)
-                        {
-                            style |= Legend::c_StyleAlignCenter | Legend::c_StyleAlignMiddle;
-                        }
-                        else if (wcscmp(tok, L"RIGHT") == 0)
-                        {
-                            style |= Legend::c_StyleAlignRight | Legend::c_StyleAlignMiddle;
-                        }
-                        else if (wcscmp(tok, L"LARGE") == 0)
-                        {
-                            style |= Legend::c_StyleFontLarge;
-                        }
-                        else if (wcscmp(tok, L"SMALL") == 0)
-                        {
-                            style |= Legend::c_StyleFontSmall;
-                        }
-                        else if (wcscmp(tok, L"BOLD") == 0)
-                        {
-                            style |= Legend::c_StyleFontBold;
-                        }
-                        else if (wcscmp(tok, L"ITALIC") == 0)
-                        {
-                            style |= Legend::c_StyleFontItalic;
-                        }
-                        else if (wcscmp(tok, L"TRANSPARENT") == 0)
-                        {
-                            style |= Legend::c_StyleTransparent;
-                        }
-
-                        tok = wcstok_s(nullptr, s_seps, &context);
-                    }
-
-                    wchar_t colorStr[32] = {};
-                    if (reader.NextItem(colorStr))
-                    {
-                        _wcsupr_s(colorStr);
-                        fgColor = LoadColorItem(colorStr, reader.RecordIndex());
-                    }
-
-                    if (reader.NextItem(colorStr))
-                    {
-                        _wcsupr_s(colorStr);
-                        bgColor = LoadColorItem(colorStr, reader.RecordIndex());
-                    }
-                }
-
-                if (id)
-                {
-                    // check for duplicates if nonzero ids used
-                    if (currentPanel->Find(id))
-                    {
-                        DebugTrace("ERROR: Duplicate control id found [record %zu]\n", reader.RecordIndex() + 1);
-                        throw std::exception("LoadLayout");
-                    }
-                }
-
-                auto legend = new Legend(id, s_text, rct, style);
-                legend->SetForegroundColor(fgColor);
-                legend->SetBackgroundColor(bgColor);
-                currentPanel->Add(legend);
-            }
-            else if (_wcsicmp(item, L"IMAGE") == 0)
-            {
-                if (!currentPanel)
-                {
-                    DebugTrace("ERROR: IMAGE found outside of panel [record %zu]\n", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
-                }
-
-                unsigned imageId = 0;
-                wchar_t imageFile[MAX_PATH] = {};
-                if (reader.NextItem(imageFile))
-                {
-                    TrimTrailingWhitespace(imageFile);
-                    imageId = LoadImageItem(imageFile);
-                }
-                else
-                {
-                    DebugTrace("ERROR: IMAGE missing image file name [record %zu]\n", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
-                }
-
-                if (id)
-                {
-                    // check for duplicates if nonzero ids used
-                    if (currentPanel->Find(id))
-                    {
-                        DebugTrace("ERROR: Duplicate control id found [record %zu]\n", reader.RecordIndex() + 1);
-                        throw std::exception("LoadLayout");
-                    }
-                }
-
-                currentPanel->Add(new Image(id, imageId, rct));
-            }
-            else if (_wcsicmp(item, L"BUTTON") == 0 || _wcsicmp(item, L"EXITBUTTON") == 0 || _wcsicmp(item, L"DEFBUTTON") == 0)
-            {
-                if (!currentPanel)
-                {
-                    DebugTrace("ERROR: BUTTON found outside of panel [record %zu]\n", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
-                }
-
-                if (!reader.NextItem(s_text))
-                {
-                    DebugTrace("ERROR: BUTTON missing text string [record %zu]\n", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
-                }
-
-                unsigned hotkey = 0;
-                wchar_t hotkeyStr[64] = {};
-                unsigned style = 0;
-                bool showBorder = false;
-                bool noFocusColor = false;
-                bool focusOnText = false;
-                XMVECTOR color = Colors::Black;
-
-                if (reader.NextItem(hotkeyStr))
-                {
-                    TrimTrailingWhitespace(hotkeyStr);
-
-                    hotkey = HandleVirtualKeys(hotkeyStr);
-
-                    // Optional style
-                    wchar_t styleStr[128] = {};
-                    if (reader.NextItem(styleStr))
-                    {
-                        _wcsupr_s(styleStr);
-
-                        wchar_t* context = nullptr;
-                        const wchar_t* tok = wcstok_s(styleStr, s_seps, &context);
-                        while (tok)
-                        {
-                            if (wcscmp(tok, L"LARGE") == 0)
-                            {
-                                style |= Button::c_StyleFontLarge;
-                            }
-                            else if (wcscmp(tok, L"SMALL") == 0)
-                            {
-                                style |= Button::c_StyleFontSmall;
-                            }
-                            else if (wcscmp(tok, L"BOLD") == 0)
-                            {
-                                style |= Button::c_StyleFontBold;
-                            }
-                            else if (wcscmp(tok, L"ITALIC") == 0)
-                            {
-                                style |= Button::c_StyleFontItalic;
-                            }
-                            else if (wcscmp(tok, L"TRANSPARENT") == 0)
-                            {
-                                style |= Button::c_StyleTransparent;
-                            }
-                            else if (wcscmp(tok, L"BORDER") == 0)
-                            {
-                                showBorder = true;
-                            }
-                            else if (wcscmp(tok, L"NO_FOCUS_COLOR") == 0)
-                            {
-                                noFocusColor = true;
-                            }
-                            else if (wcscmp(tok, L"FOCUS_ON_TEXT") == 0)
-                            {
-                                focusOnText = true;
-                            }
-                            tok = wcstok_s(nullptr, s_seps, &context);
-                        }
-
-                        wchar_t colorStr[32] = {};
-                        if (reader.NextItem(colorStr))
-                        {
-                            _wcsupr_s(colorStr);
-                            color = LoadColorItem(colorStr, reader.RecordIndex());
-                        }
-                    }
-                }
-
-                if (_wcsicmp(item, L"EXITBUTTON") == 0)
-                {
-                    style |= Button::c_StyleExit;
-                }
-                else if (_wcsicmp(item, L"DEFBUTTON") == 0)
-                {
-                    style |= Button::c_StyleExit | Button::c_StyleDefault;
-                }
-
-                // check for duplicate id
-                if (currentPanel->Find(id))
-                {
-                    DebugTrace("ERROR: Duplicate control found [record %zu]\n", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
-                }
-
-                auto *butn = new Button(id, s_text, rct);
-                butn->SetStyle(style);
-                butn->SetHotKey(hotkey);
-                butn->SetColor(color);
-                butn->ShowBorder(showBorder);
-                butn->NoFocusColor(noFocusColor);
-                butn->FocusOnText(focusOnText);
-                currentPanel->Add(butn);
-            }
-            else if (_wcsicmp(item, L"IMAGEBUTTON") == 0 || _wcsicmp(item, L"EXITIMAGEBUTTON") == 0 || _wcsicmp(item, L"DEFIMAGEBUTTON") == 0)
-            {
-                if (!currentPanel)
-                {
-                    DebugTrace("ERROR: IMAGEBUTTON found outside of panel [record %zu]\n", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
-                }
-
-                unsigned imageId = 0;
-                wchar_t imageFile[MAX_PATH] = {};
-                if (reader.NextItem(imageFile))
-                {
-                    TrimTrailingWhitespace(imageFile);
-                    imageId = LoadImageItem(imageFile);
-                }
-                else
-                {
-                    DebugTrace("ERROR: IMAGEBUTTON missing image file name [record %zu]\n", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
-                }
-
-                unsigned hotkey = 0;
-                wchar_t hotkeyStr[64] = {};
-                unsigned style = 0;
-                if (reader.NextItem(hotkeyStr))
-                {
-                    TrimTrailingWhitespace(hotkeyStr);
-
-                    hotkey = HandleVirtualKeys(hotkeyStr);
-
-                    // Optional style
-                    wchar_t styleStr[128] = {};
-                    if (reader.NextItem(styleStr))
-                    {
-                        _wcsupr_s(styleStr);
-
-                        wchar_t* context = nullptr;
-                        const wchar_t* tok = wcstok_s(styleStr, s_seps, &context);
-                        while (tok)
-                        {
-                            if (wcscmp(tok, L"BACKGROUND") == 0)
-                            {
-                                style |= ImageButton::c_StyleBackground;
-                            }
-                            else if (wcscmp(tok, L"TRANSPARENT") == 0)
-                            {
-                                style |= ImageButton::c_StyleTransparent | ImageButton::c_StyleBackground;
-                            }
-
-                            tok = wcstok_s(nullptr, s_seps, &context);
-                        }
-                    }
-                }
-
-                if (_wcsicmp(item, L"EXITIMAGEBUTTON") == 0)
-                {
-                    style |= ImageButton::c_StyleExit;
-                }
-                else if (_wcsicmp(item, L"DEFIMAGEBUTTON") == 0)
-                {
-                    style |= ImageButton::c_StyleExit | ImageButton::c_StyleDefault;
-                }
-
-                // check for duplicate id
-                if (currentPanel->Find(id))
-                {
-                    DebugTrace("ERROR: Duplicate control found [record %zu]\n", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
-                }
+        m_panels.clear();
 
-                auto *butn = new ImageButton(id, imageId, rct);
-                butn->SetStyle(style);
-                butn->SetHotKey(hotkey);
-                currentPanel->Add(butn);
-            }
-            else if (_wcsicmp(item, L"CHECKBOX") == 0)
-            {
-                if (!currentPanel)
-                {
-                    DebugTrace("ERROR: CHECKBOX found outside of panel [record %zu]", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
-                }
+        m_focusPanel = nullptr;
+        m_overlayPanel = nullptr;
+        m_hudPanel = nullptr;
 
-                if (!reader.NextItem(s_text))
-                {
-                    DebugTrace("ERROR: CHECKBOX missing text string [record %zu]", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
-                }
+        s_uiManager = nullptr;
+    }
 
-                unsigned style = 0;
-                bool checked = false;
-                {
-                    wchar_t styleStr[128] = {};
-                    if (reader.NextItem(styleStr))
-                    {
-                        _wcsupr_s(styleStr);
+    void LoadLayout(const wchar_t* layoutFile, const wchar_t* imageDir, unsigned offset)
+    {
+        if (imageDir)
+            m_layoutImageDir = imageDir;
+        else
+            m_layoutImageDir.clear();
 
-                        wchar_t* context = nullptr;
-                        const wchar_t* tok = wcstok_s(styleStr, s_seps, &context);
-                        while (tok)
-                        {
-                            if (wcscmp(tok, L"LARGE") == 0)
-                            {
-                                style |= CheckBox::c_StyleFontLarge;
-                            }
-                            else if (wcscmp(tok, L"SMALL") == 0)
-                            {
-                                style |= CheckBox::c_StyleFontSmall;
-                            }
-                            else if (wcscmp(tok, L"BOLD") == 0)
-                            {
-                                style |= CheckBox::c_StyleFontBold;
-                            }
-                            else if (wcscmp(tok, L"ITALIC") == 0)
-                            {
-                                style |= CheckBox::c_StyleFontItalic;
-                            }
-                            else if (wcscmp(tok, L"CHECKED") == 0)
-                            {
-                                checked = true;
-                            }
-                            else if (wcscmp(tok, L"TRANSPARENT") == 0)
-                            {
-                                style |= CheckBox::c_StyleTransparent;
-                            }
-
-                            tok = wcstok_s(nullptr, s_seps, &context);
-                        }
-                    }
-                }
+        // Use a compiled layout when there is one that matches the .csv, or if it was asked for directly
+        std::wstring csvFile;
+        DX::MappedFile compiled;
+        if (IsCompiledLayoutName(layoutFile))
+        {
+            csvFile = ReplaceLayoutExtension(layoutFile, L".csv");
+            (void)compiled.Open(layoutFile, true);
+        }
+        else
+        {
+            csvFile = layoutFile;
+            (void)compiled.Open(ReplaceLayoutExtension(layoutFile, c_CompiledLayoutExt).c_str(), true);
+        }
 
-                // check for duplicate id
-                if (currentPanel->Find(id))
-                {
-                    DebugTrace("ERROR: Duplicate control id found [record %zu]", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
-                }
+        const LayoutHeader* header = (compiled.IsOpen()) ? ValidateCompiledLayout(compiled.GetData(), compiled.GetSize()) : nullptr;
+        if (header && !IsCompiledLayoutCurrent(*header, csvFile.c_str()))
+        {
+            DebugTrace("WARNING: Compiled layout is out of date, using %ls\n", csvFile.c_str());
+            header = nullptr;
+        }
 
-                auto *box = new CheckBox(id, s_text, rct, checked);
-                box->SetStyle(style);
-                currentPanel->Add(box);
-            }
-            else if (_wcsicmp(item, L"SLIDER") == 0)
-            {
-                if (!currentPanel)
-                {
-                    DebugTrace("ERROR: SLIDER found outside of panel [record %zu]\n", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
-                }
+        if (header)
+        {
+            const uint8_t* data = compiled.GetData();
+            CreateLayout(reinterpret_cast<const LayoutRecord*>(data + header->recordOffset),
+                header->recordCount,
+                reinterpret_cast<const wchar_t*>(data + header->stringOffset),
+                offset);
+        }
+        else
+        {
+            std::vector<LayoutRecord> records;
+            LayoutStrings strings;
+            ParseLayout(csvFile.c_str(), records, strings);
 
-                // check for duplicate id
-                if (currentPanel->Find(id))
-                {
-                    DebugTrace("ERROR: Duplicate control id found [record %zu]\n", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
-                }
+            CreateLayout(records.data(), records.size(), strings.GetData().data(), offset);
+        }
+    }
 
-                unsigned style = 0;
-                {
-                    wchar_t styleStr[128] = {};
-                    if (reader.NextItem(styleStr))
-                    {
-                        _wcsupr_s(styleStr);
+    void CreateLayout(_In_reads_(count) const LayoutRecord* records, size_t count, _In_ const wchar_t* strings, unsigned offset)
+    {
+        IPanel* currentPanel = nullptr;
 
-                        wchar_t* context = nullptr;
-                        const wchar_t* tok = wcstok_s(styleStr, s_seps, &context);
-                        while (tok)
-                        {
-                            if (wcscmp(tok, L"TRANSPARENT") == 0)
-                            {
-                                style |= Slider::c_StyleTransparent;
-                            }
+        for (size_t j = 0; j < count; ++j)
+        {
+            const LayoutRecord& record = records[j];
 
-                            tok = wcstok_s(nullptr, s_seps, &context);
-                        }
-                    }
-                }
+            unsigned id = record.id;
+            RECT rct = { record.rect[0], record.rect[1], record.rect[2], record.rect[3] };
 
-                auto slider = new Slider(id, rct);
-                slider->SetStyle(style);
-                currentPanel->Add(slider);
-            }
-            else if (_wcsicmp(item, L"PROGRESSBAR") == 0)
+            if (record.type <= LAYOUT_OVERLAY)
             {
-                if (!currentPanel)
-                {
-                    DebugTrace("ERROR: PROGRESSBAR found outside of panel [record %zu]\n", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
-                }
+                // IPanel object ids need to be globally unique
+                id += offset;
 
-                // check for duplicate id
-                if (currentPanel->Find(id))
+                auto it = m_panels.find(id);
+                if (it != m_panels.end())
                 {
-                    DebugTrace("ERROR: Duplicate control id found [record %zu]\n", reader.RecordIndex() + 1);
+                    DebugTrace("ERROR: Duplicate panel id found [record %u]\n", record.record);
                     throw std::exception("LoadLayout");
                 }
-
-                currentPanel->Add(new ProgressBar(id, rct));
             }
-            else if (_wcsicmp(item, L"TEXTLIST") == 0)
+            else
             {
-                if (!currentPanel)
-                {
-                    DebugTrace("ERROR: TEXTLIST found outside of panel [record %zu]\n", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
-                }
+                assert(currentPanel != nullptr);
 
-                // check for duplicate id
-                if (currentPanel->Find(id))
+                // Labels, legends, images and text boxes only check for duplicates if nonzero ids used
+                bool optionalId = (record.type == LAYOUT_LABEL || record.type == LAYOUT_LEGEND || record.type == LAYOUT_IMAGE || record.type == LAYOUT_TEXTBOX);
+                if ((id || !optionalId) && currentPanel->Find(id))
                 {
-                    DebugTrace("ERROR: Duplicate control id found [record %zu]\n", reader.RecordIndex() + 1);
+                    DebugTrace("ERROR: Duplicate control id found [record %u]\n", record.record);
                     throw std::exception("LoadLayout");
                 }
+            }
 
-                int itemHeight = 0;
-                wchar_t itemHeightStr[64] = {};
-                unsigned style = 0;
-                if (reader.NextItem(itemHeightStr))
-                {
-                    itemHeight = _wtoi(itemHeightStr);
+            const wchar_t* text = strings + record.text;
 
-                    wchar_t styleStr[128] = {};
-                    if (reader.NextItem(styleStr))
-                    {
-                        _wcsupr_s(styleStr);
+            switch (record.type)
+            {
+            case LAYOUT_POPUP:
+                currentPanel = new Popup(rct, record.style);
+                m_panels[id] = currentPanel;
+                m_controls.AddPanel(id, currentPanel);
+                break;
 
-                        wchar_t* context = nullptr;
-                        const wchar_t* tok = wcstok_s(styleStr, s_seps, &context);
-                        while (tok)
-                        {
-                            if (wcscmp(tok, L"LARGE") == 0)
-                            {
-                                style |= ListBox::c_StyleFontLarge;
-                            }
-                            else if (wcscmp(tok, L"SMALL") == 0)
-                            {
-                                style |= ListBox::c_StyleFontSmall;
-                            }
-                            else if (wcscmp(tok, L"BOLD") == 0)
-                            {
-                                style |= ListBox::c_StyleFontBold;
-                            }
-                            else if (wcscmp(tok, L"ITALIC") == 0)
-                            {
-                                style |= ListBox::c_StyleFontItalic;
-                            }
-                            else if (wcscmp(tok, L"TRANSPARENT") == 0)
-                            {
-                                style |= ListBox::c_StyleTransparent;
-                            }
-
-                            tok = wcstok_s(nullptr, s_seps, &context);
-                        }
-                    }
-                }
+            case LAYOUT_HUD:
+                currentPanel = new HUD(rct);
+                m_panels[id] = currentPanel;
+                m_controls.AddPanel(id, currentPanel);
 
-                currentPanel->Add(new TextList(id, rct, style, itemHeight));
-            }
-            else if (_wcsicmp(item, L"LISTBOX") == 0)
-            {
-                if (!currentPanel)
+                if (!m_hudPanel)
                 {
-                    DebugTrace("ERROR: LISTBOX found outside of panel [record %zu]\n", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
+                    currentPanel->Show();
                 }
+                break;
+
+            case LAYOUT_OVERLAY:
+                currentPanel = new Overlay(rct, record.style);
+                m_panels[id] = currentPanel;
+                m_controls.AddPanel(id, currentPanel);
+                break;
 
-                // check for duplicate id
-                if (currentPanel->Find(id))
+            case LAYOUT_LABEL:
                 {
-                    DebugTrace("ERROR: Duplicate control id found [record %zu]\n", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
+                    auto label = new TextLabel(id, text, rct, record.style);
+                    label->SetForegroundColor(LoadLayoutColor(record.fgColor, Colors::White));
+                    label->SetBackgroundColor(LoadLayoutColor(record.bgColor, Colors::Transparent));
+                    currentPanel->Add(label);
                 }
+                break;
 
-                int itemHeight = 0;
-                wchar_t itemHeightStr[64] = {};
-                unsigned style = 0;
-                if (reader.NextItem(itemHeightStr))
+            case LAYOUT_LEGEND:
                 {
-                    itemHeight = _wtoi(itemHeightStr);
+                    auto legend = new Legend(id, text, rct, record.style);
+                    legend->SetForegroundColor(LoadLayoutColor(record.fgColor, Colors::White));
+                    legend->SetBackgroundColor(LoadLayoutColor(record.bgColor, Colors::Transparent));
+                    currentPanel->Add(legend);
+                }
+                break;
 
-                    wchar_t styleStr[128] = {};
-                    if (reader.NextItem(styleStr))
-                    {
-                        _wcsupr_s(styleStr);
+            case LAYOUT_IMAGE:
+                currentPanel->Add(new Image(id, LoadImageItem(strings + record.image), rct));
+                break;
 
-                        wchar_t* context = nullptr;
-                        const wchar_t* tok = wcstok_s(styleStr, s_seps, &context);
-                        while (tok)
-                        {
-                            if (wcscmp(tok, L"MULTISELECT") == 0)
-                            {
-                                style |= ListBox::c_StyleMultiSelection;
-                            }
-                            else if (wcscmp(tok, L"LARGE") == 0)
-                            {
-                                style |= ListBox::c_StyleFontLarge;
-                            }
-                            else if (wcscmp(tok, L"SMALL") == 0)
-                            {
-                                style |= ListBox::c_StyleFontSmall;
-                            }
-                            else if (wcscmp(tok, L"BOLD") == 0)
-                            {
-                                style |= ListBox::c_StyleFontBold;
-                            }
-                            else if (wcscmp(tok, L"ITALIC") == 0)
-                            {
-                                style |= ListBox::c_StyleFontItalic;
-                            }
-                            else if (wcscmp(tok, L"TRANSPARENT") == 0)
-                            {
-                                style |= ListBox::c_StyleTransparent;
-                            }
-                            else if (wcscmp(tok, L"SCROLLBAR") == 0)
-                            {
-                                style |= ListBox::c_StyleScrollBar;
-                            }
-
-                            tok = wcstok_s(nullptr, s_seps, &context);
-                        }
-                    }
+            case LAYOUT_BUTTON:
+                {
+                    auto *butn = new Button(id, text, rct);
+                    butn->SetStyle(record.style);
+                    butn->SetHotKey(record.hotkey);
+                    butn->SetColor(LoadLayoutColor(record.fgColor, Colors::Black));
+                    butn->ShowBorder((record.flags & c_LayoutFlagBorder) != 0);
+                    butn->NoFocusColor((record.flags & c_LayoutFlagNoFocusColor) != 0);
+                    butn->FocusOnText((record.flags & c_LayoutFlagFocusOnText) != 0);
+                    currentPanel->Add(butn);
                 }
+                break;
 
-                currentPanel->Add(new ListBox(id, rct, style, itemHeight));
-            }
-            else if (_wcsicmp(item, L"TEXTBOX") == 0)
-            {
-                if (!currentPanel)
+            case LAYOUT_IMAGEBUTTON:
                 {
-                    DebugTrace("ERROR: TEXTBOX found outside of panel [record %zu]\n", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
+                    auto *butn = new ImageButton(id, LoadImageItem(strings + record.image), rct);
+                    butn->SetStyle(record.style);
+                    butn->SetHotKey(record.hotkey);
+                    currentPanel->Add(butn);
                 }
+                break;
 
-                if (id)
+            case LAYOUT_CHECKBOX:
                 {
-                    // check for duplicates if nonzero ids used
-                    if (currentPanel->Find(id))
-                    {
-                        DebugTrace("ERROR: Duplicate control id found [record %zu]\n", reader.RecordIndex() + 1);
-                        throw std::exception("LoadLayout");
-                    }
+                    auto *box = new CheckBox(id, text, rct, (record.flags & c_LayoutFlagChecked) != 0);
+                    box->SetStyle(record.style);
+                    currentPanel->Add(box);
                 }
+                break;
 
-                if (!reader.NextItem(s_text))
+            case LAYOUT_SLIDER:
                 {
-                    DebugTrace("ERROR: TEXTBOX missing text string [record %zu]\n", reader.RecordIndex() + 1);
-                    throw std::exception("LoadLayout");
+                    auto slider = new Slider(id, rct);
+                    slider->SetStyle(record.style);
+                    currentPanel->Add(slider);
                 }
+                break;
 
-                HandleEscapeCharacters(s_text);
+            case LAYOUT_PROGRESSBAR:
+                currentPanel->Add(new ProgressBar(id, rct));
+                break;
 
-                unsigned style = 0;
-                {
-                    wchar_t styleStr[128] = {};
-                    if (reader.NextItem(styleStr))
-                    {
-                        _wcsupr_s(styleStr);
+            case LAYOUT_TEXTLIST:
+                currentPanel->Add(new TextList(id, rct, record.style, record.itemHeight));
+                break;
 
-                        wchar_t* context = nullptr;
-                        const wchar_t* tok = wcstok_s(styleStr, s_seps, &context);
-                        while (tok)
-                        {
-                            if (wcscmp(tok, L"LARGE") == 0)
-                            {
-                                style |= TextBox::c_StyleFontLarge;
-                            }
-                            else if (wcscmp(tok, L"SMALL") == 0)
-                            {
-                                style |= TextBox::c_StyleFontSmall;
-                            }
-                            else if (wcscmp(tok, L"BOLD") == 0)
-                            {
-                                style |= TextBox::c_StyleFontBold;
-                            }
-                            else if (wcscmp(tok, L"ITALIC") == 0)
-                            {
-                                style |= TextBox::c_StyleFontItalic;
-                            }
-                            else if (wcscmp(tok, L"TRANSPARENT") == 0)
-                            {
-                                style |= TextBox::c_StyleTransparent;
-                            }
-                            else if (wcscmp(tok, L"SCROLLBAR") == 0)
-                            {
-                                style |= TextBox::c_StyleScrollBar;
-                            }
-                            else if (wcscmp(tok, L"NOBACKGROUND") == 0)
-                            {
-                                style |= TextBox::c_StyleNoBackground;
-                            }
-
-                            tok = wcstok_s(nullptr, s_seps, &context);
-                        }
-                    }
-                }
+            case LAYOUT_LISTBOX:
+                currentPanel->Add(new ListBox(id, rct, record.style, record.itemHeight));
+                break;
 
-                currentPanel->Add(new TextBox(id, s_text, rct, style));
-            }
+            case LAYOUT_TEXTBOX:
+                currentPanel->Add(new TextBox(id, text, rct, record.style));
+                break;
 
-            reader.NextRecord();
+            default:
+                break;
+            }
         }
     }
 
@@ -1413,6 +618,8 @@ public:
 
         // m_hudPanel never gets input, but does get Update for time
 
+        UpdateControls(elapsedTime);
+
         return result;
     }
 
@@ -1480,6 +687,8 @@ public:
 
         // m_hudPanel never gets input, but does get Update for time
 
+        UpdateControls(elapsedTime);
+
         return result;
     }
 
@@ -1531,6 +740,8 @@ public:
         m_largeBoldFont.reset();
         m_smallLegend.reset();
         m_largeLegend.reset();
+        m_textLayout.Clear();
+        m_glyphTables.clear();
         m_fxFactory.reset();
         m_defaultTex.Reset();
 #if defined(__d3d12_h__) || defined(__d3d12_x_h__)
@@ -1894,6 +1105,96 @@ public:
         return font;
     }
 
+    // Controller font for Legend
+    SpriteFont* SelectLegendFont(unsigned style)
+    {
+        SpriteFont* font = (style & Legend::c_StyleFontLarge) ? m_largeLegend.get() : m_smallLegend.get();
+
+        assert(font != 0);
+
+        return font;
+    }
+
+    IControl* LookupControl(unsigned panelId, unsigned ctrlId, _Out_opt_ uint32_t* index)
+    {
+        uint32_t slot = m_controls.Find(panelId, ctrlId);
+        if (index)
+        {
+            *index = slot;
+        }
+        return m_controls.Get(slot);
+    }
+
+    // Panels are registered along with the controls they already have, and controls added later register as they
+    // are added, so every control of a registered panel has a slot.
+    void RegisterPanel(unsigned id, _In_ IPanel* panel)
+    {
+        m_controls.AddPanel(id, panel);
+        panel->Enumerate([=](IControl* ctrl)
+        {
+            RegisterControl(panel, ctrl);
+        });
+    }
+
+    void RegisterControl(_In_ IPanel* panel, _In_ IControl* ctrl)
+    {
+        ctrl->m_slot = m_controls.AddControl(panel, ctrl, ctrl->GetId());
+    }
+
+    // Controls are owned by their panel, so registry entries are removed along with the panel
+    void UnregisterControls(_In_ IPanel* panel)
+    {
+        m_controls.RemovePanel(panel);
+    }
+
+    // Only dirty, focused and animating controls are updated; static controls are skipped
+    void UpdateControls(float elapsedTime)
+    {
+        // Text placement needs the fonts
+        if (!m_batch)
+            return;
+
+        m_controls.UpdateActive([=](IControl* ctrl, uint32_t)
+        {
+            ctrl->Update(elapsedTime);
+        });
+    }
+
+    // Word wrap text to fit in the width of rect. Results are cached, so unchanged text is only laid
+    // out again if the width changes.
+    std::shared_ptr<const WrappedText> WordWrap(_In_ SpriteFont* font, _In_z_ const wchar_t* text, const RECT& rect)
+    {
+        assert(font != 0);
+
+        auto it = m_glyphTables.find(font);
+        if (it == m_glyphTables.end())
+        {
+            auto glyphs = font->GetGlyphs();
+
+            std::vector<GlyphAdvanceTable::Glyph> advances;
+            advances.reserve(glyphs.size());
+
+            for (auto& glyph : glyphs)
+            {
+                long width = glyph.Subrect.right - glyph.Subrect.left;
+                long height = glyph.Subrect.bottom - glyph.Subrect.top;
+
+                GlyphAdvanceTable::Glyph advance;
+                advance.character = glyph.Character;
+                advance.xOffset = glyph.XOffset;
+                advance.advance = float(width) + glyph.XAdvance;
+                advance.width = float(width);
+                advance.blank = iswspace(wchar_t(glyph.Character)) && width <= 1 && height <= 1;
+                advances.push_back(advance);
+            }
+
+            auto table = std::make_unique<GlyphAdvanceTable>(advances.data(), advances.size(), font->GetDefaultCharacter());
+            it = m_glyphTables.emplace(font, std::move(table)).first;
+        }
+
+        return m_textLayout.WordWrap(*it->second, text, rect.right - rect.left);
+    }
+
     // Direct3D resources
     std::unique_ptr<SpriteBatch>        m_batch;
     std::unique_ptr<SpriteFont>         m_smallFont;
@@ -1908,6 +1209,10 @@ public:
     std::unique_ptr<SpriteFont>         m_smallLegend;
     std::unique_ptr<SpriteFont>         m_largeLegend;
 
+    // Glyph metrics of each font used for word wrap
+    std::map<const SpriteFont*, std::unique_ptr<GlyphAdvanceTable>> m_glyphTables;
+    TextLayoutCache                     m_textLayout;
+
 #if defined(__d3d12_h__) || defined(__d3d12_x_h__)
     std::unique_ptr<EffectTextureFactory>   m_fxFactory;
     D3D12_GPU_DESCRIPTOR_HANDLE             m_defaultTexDescriptor;
@@ -1932,6 +1237,14 @@ public:
     IPanel*                             m_hudPanel;
     std::map<unsigned, IPanel*>         m_panels;
 
+    // Every control of the registered panels, indexed by control handles
+    typedef ControlRegistry<IControl, IPanel> ControlTable;
+
+    ControlTable                        m_controls;
+    uint32_t                            m_controlEpoch;
+
+    static uint32_t                     s_controlEpochs;
+
     std::vector<std::wstring>           m_layoutImages;
     std::wstring                        m_layoutImageDir;
 
@@ -1952,42 +1265,94 @@ public:
     static UIManager::Impl* s_uiManager;
 
     // Helpers
+    // Controls that stay inside their rectangle share one batch at the full-screen scissor, so a panel of
+    // static labels and images is drawn with one batch rather than one per control. Controls that need
+    // clipping still get their own scissored batch.
     void RenderControls(std::vector<IControl*>& controls)
     {
 #if defined(__d3d12_h__) || defined(__d3d12_x_h__)
         if (m_commandList == nullptr || m_batch == nullptr)
             return;
 
+        bool shared = false;
         for (auto it : controls)
         {
-            if (it->IsVisible())
-            {
-                m_commandList->RSSetScissorRects(1, it->GetRectangle());
+            if (!it->IsVisible())
+                continue;
 
-                m_batch->Begin(m_commandList);
+            if (!it->NeedsClipping())
+            {
+                if (!shared)
+                {
+                    m_commandList->RSSetScissorRects(1, &m_fullscreen);
+                    m_batch->Begin(m_commandList);
+                    shared = true;
+                }
 
                 it->Render();
+                continue;
+            }
 
+            if (shared)
+            {
                 m_batch->End();
+                shared = false;
             }
+
+            m_commandList->RSSetScissorRects(1, it->GetRectangle());
+
+            m_batch->Begin(m_commandList);
+
+            it->Render();
+
+            m_batch->End();
+        }
+
+        if (shared)
+        {
+            m_batch->End();
         }
 #elif defined(__d3d11_h__) || defined(__d3d11_x_h__)
         if (m_context == nullptr || m_batch == nullptr)
             return;
 
+        bool shared = false;
         for (auto it : controls)
         {
-            if (it->IsVisible())
+            if (!it->IsVisible())
+                continue;
+
+            if (!it->NeedsClipping())
             {
-                m_batch->Begin(SpriteSortMode_Deferred, m_blendState.Get(), nullptr, nullptr, m_scissorState.Get(), [=]()
+                if (!shared)
                 {
-                    m_context->RSSetScissorRects(1, it->GetRectangle());
-                });
+                    m_batch->Begin(SpriteSortMode_Deferred, m_blendState.Get());
+                    shared = true;
+                }
 
                 it->Render();
+                continue;
+            }
 
+            if (shared)
+            {
                 m_batch->End();
+                shared = false;
             }
+
+            m_batch->Begin(SpriteSortMode_Deferred, m_blendState.Get(), nullptr, nullptr, m_scissorState.Get(), [=]()
+            {
+                m_context->RSSetScissorRects(1, it->GetRectangle());
+            });
+
+            it->Render();
+
+            m_batch->End();
+        }
+
+        if (shared)
+        {
+            m_batch->End();
         }
 #endif
     }
@@ -2053,105 +1418,63 @@ private:
         assert(imageFile != 0);
 
         unsigned imageId = 0;
-
-        std::wstring wname(imageFile);
-        auto it = std::find(m_layoutImages.cbegin(), m_layoutImages.cend(), wname);
-        if (it == m_layoutImages.end())
-        {
-            imageId = c_LayoutImageIdStart + unsigned(m_layoutImages.size());
-            m_layoutImages.push_back(wname);
-        }
-        else
-        {
-            imageId = c_LayoutImageIdStart + unsigned(it - m_layoutImages.cbegin());
-        }
-
-        return imageId;
-    }
-
-    XMVECTOR XM_CALLCONV LoadColorItem(_In_z_ const wchar_t* colorStr, size_t index)
-    {
-        assert(colorStr != 0);
-        XMVECTOR color = Colors::White;
-
-        if (*colorStr == L'#')
-        {
-            unsigned int bgra = 0xFFFFFF;
-            if (swscanf_s(colorStr + 1, L"%x", &bgra) == 1)
-            {
-                using namespace PackedVector;
-
-                bgra &= 0xFFFFFF;
-                XMVECTOR clr = XMLoadColor(reinterpret_cast<const XMCOLOR*>(&bgra));
-                color = XMVectorSelect(g_XMIdentityR3, clr, g_XMSelect1110);
-
-                if (mConfig.forceSRGB)
-                {
-                    color = XMColorSRGBToRGB(color);
-                }
-            }
-            else
-            {
-                DebugTrace("WARNING: Invalid color value [record %zu]\n", index + 1);
-            }
-        }
-        else if (*colorStr)
-        {
-            if (wcscmp(colorStr, L"RED") == 0)
-            {
-                color = XMLoadFloat4(&mConfig.colorDictionary[UIConfig::RED]);
-            }
-            else if (wcscmp(colorStr, L"GREEN") == 0)
-            {
-                color = XMLoadFloat4(&mConfig.colorDictionary[UIConfig::GREEN]);
-            }
-            else if (wcscmp(colorStr, L"BLUE") == 0)
-            {
-                color = XMLoadFloat4(&mConfig.colorDictionary[UIConfig::BLUE]);
-            }
-            else if (wcscmp(colorStr, L"ORANGE") == 0)
-            {
-                color = XMLoadFloat4(&mConfig.colorDictionary[UIConfig::ORANGE]);
-            }
-            else if (wcscmp(colorStr, L"YELLOW") == 0)
-            {
-                color = XMLoadFloat4(&mConfig.colorDictionary[UIConfig::YELLOW]);
-            }
-            else if (wcscmp(colorStr, L"DARKGREY") == 0)
-            {
-                color = XMLoadFloat4(&mConfig.colorDictionary[UIConfig::DARK_GREY]);
-            }
-            else if (wcscmp(colorStr, L"LIGHTGREY") == 0)
-            {
-                color = XMLoadFloat4(&mConfig.colorDictionary[UIConfig::LIGHT_GREY]);
-            }
-            else if (wcscmp(colorStr, L"OFFWHITE") == 0)
-            {
-                color = XMLoadFloat4(&mConfig.colorDictionary[UIConfig::OFF_WHITE]);
-            }
-            else if (wcscmp(colorStr, L"WHITE") == 0)
-            {
-                color = XMLoadFloat4(&mConfig.colorDictionary[UIConfig::WHITE]);
-            }
-            else if (wcscmp(colorStr, L"BLACK") == 0)
-            {
-                color = XMLoadFloat4(&mConfig.colorDictionary[UIConfig::BLACK]);
-            }
-            else if (wcscmp(colorStr, L"MID_GREY") == 0)
+
+        std::wstring wname(imageFile);
+        auto it = std::find(m_layoutImages.cbegin(), m_layoutImages.cend(), wname);
+        if (it == m_layoutImages.end())
+        {
+            imageId = c_LayoutImageIdStart + unsigned(m_layoutImages.size());
+            m_layoutImages.push_back(wname);
+        }
+        else
+        {
+            imageId = c_LayoutImageIdStart + unsigned(it - m_layoutImages.cbegin());
+        }
+
+        return imageId;
+    }
+
+    XMVECTOR XM_CALLCONV LoadLayoutColor(uint32_t color, FXMVECTOR defaultColor)
+    {
+        switch (color & 0xFF000000)
+        {
+        case c_LayoutColorNamed:
             {
-                color = XMLoadFloat4(&mConfig.colorDictionary[UIConfig::MID_GREY]);
+                uint32_t index = color & 0xFFFFFF;
+                if (index < UIConfig::MAX_COLORS)
+                {
+                    return XMLoadFloat4(&mConfig.colorDictionary[index]);
+                }
             }
-            else
+            return Colors::White;
+
+        case c_LayoutColorRGB:
             {
-                DebugTrace("WARNING: Invalid color value [record %zu]\n", index + 1);
+                using namespace PackedVector;
+
+                uint32_t bgra = color & 0xFFFFFF;
+                XMVECTOR clr = XMLoadColor(reinterpret_cast<const XMCOLOR*>(&bgra));
+                clr = XMVectorSelect(g_XMIdentityR3, clr, g_XMSelect1110);
+
+                if (mConfig.forceSRGB)
+                {
+                    clr = XMColorSRGBToRGB(clr);
+                }
+
+                return clr;
             }
-        }
 
-        return color;
+        case c_LayoutColorWhite:
+            return Colors::White;
+
+        default:
+            return defaultColor;
+        }
     }
 };
 
 UIManager::Impl* UIManager::Impl::s_uiManager = nullptr;
+uint32_t UIManager::Impl::s_controlEpochs = 0;
 
 // Public constructors
 UIManager::UIManager(const UIConfig& config) :
@@ -2206,6 +1529,11 @@ void UIManager::LoadLayout(const wchar_t* layoutFile, const wchar_t* imageDir, u
     pImpl->LoadLayout(layoutFile, imageDir, offset);
 }
 
+void UIManager::CompileLayout(const wchar_t* layoutFile, const wchar_t* compiledFile)
+{
+    CompileLayoutFile(layoutFile, compiledFile);
+}
+
 void UIManager::Add(unsigned id, _In_ IPanel* panel)
 {
     auto it = pImpl->m_panels.find(id);
@@ -2224,10 +1552,12 @@ void UIManager::Add(unsigned id, _In_ IPanel* panel)
         {
             pImpl->m_hudPanel = nullptr;
         }
+        pImpl->UnregisterControls(it->second);
         delete it->second;
     }
 
     pImpl->m_panels[id] = panel;
+    pImpl->RegisterPanel(id, panel);
 }
 
 IPanel* UIManager::Find(unsigned id) const
@@ -2239,6 +1569,33 @@ IPanel* UIManager::Find(unsigned id) const
     return nullptr;
 }
 
+_Use_decl_annotations_
+IControl* UIManager::LookupControl(unsigned panelId, unsigned ctrlId, uint32_t* index) const
+{
+    return pImpl->LookupControl(panelId, ctrlId, index);
+}
+
+IControl* UIManager::ResolveControl(uint32_t index, uint32_t epoch) const
+{
+    if (epoch != pImpl->m_controlEpoch)
+    {
+        throw std::exception("Get (control)");
+    }
+
+    auto ctrl = pImpl->m_controls.Get(index);
+    if (!ctrl)
+    {
+        throw std::exception("Get (control)");
+    }
+
+    return ctrl;
+}
+
+uint32_t UIManager::GetControlEpoch() const
+{
+    return pImpl->m_controlEpoch;
+}
+
 void UIManager::CloseAll()
 {
     std::for_each(pImpl->m_panels.begin(), pImpl->m_panels.end(), [](auto pair)
@@ -2391,6 +1748,8 @@ void UIManager::CallbackYesNoCancel(_In_ IPanel* panel, std::function<void(bool,
 //=====================================================================================
 void IControl::ComputeLayout(const RECT& parent)
 {
+    Invalidate();
+
     m_screenRect.top = m_layoutRect.top + parent.top;
     m_screenRect.bottom = m_layoutRect.bottom + parent.top;
 
@@ -2413,6 +1772,8 @@ void IControl::ComputeLayout(const RECT& parent)
 
 void IControl::ComputeLayout(const RECT& bounds, float dx, float dy)
 {
+    Invalidate();
+
     m_screenRect.left = long(float(m_layoutRect.left) * dx);
     m_screenRect.right = long(float(m_layoutRect.right ) * dx);
 
@@ -2452,6 +1813,53 @@ void IControl::SetVisible(bool visible)
     m_visible = visible;
 }
 
+void IControl::OnFocus(bool in)
+{
+    m_focus = in;
+
+    auto mgr = UIManager::Impl::s_uiManager;
+    if (mgr)
+    {
+        mgr->m_controls.SetState(m_slot, UIManager::Impl::ControlTable::c_StateFocused, in);
+    }
+
+    if (in && m_focusCb)
+    {
+        m_focusCb(nullptr, this);
+    }
+}
+
+void IControl::SetId(unsigned id)
+{
+    m_id = id;
+
+    auto mgr = UIManager::Impl::s_uiManager;
+    if (mgr)
+    {
+        mgr->m_controls.SetControlId(m_slot, id);
+    }
+}
+
+void IControl::SetAnimating(bool animating)
+{
+    auto mgr = UIManager::Impl::s_uiManager;
+    if (mgr)
+    {
+        mgr->m_controls.SetState(m_slot, UIManager::Impl::ControlTable::c_StateAnimating, animating);
+    }
+}
+
+void IControl::Invalidate()
+{
+    m_dirty = true;
+
+    auto mgr = UIManager::Impl::s_uiManager;
+    if (mgr)
+    {
+        mgr->m_controls.SetState(m_slot, UIManager::Impl::ControlTable::c_StateDirty, true);
+    }
+}
+
 
 //=====================================================================================
 // Text static label control
@@ -2460,6 +1868,7 @@ _Use_decl_annotations_
 TextLabel::TextLabel(unsigned id, const wchar_t* text, const RECT& rect, unsigned style) :
     IControl(rect, id),
     m_style(style),
+    m_overflow(false),
     m_text(text)
 {
     auto mgr = UIManager::Impl::s_uiManager;
@@ -2480,6 +1889,47 @@ void TextLabel::Render()
         throw std::exception("UIManager");
     }
 
+    if (m_dirty)
+    {
+        PlaceText();
+    }
+
+    // Determine font
+    SpriteFont* font = mgr->SelectFont(m_style);
+
+    const wchar_t* text = (m_style & c_StyleWordWrap) ? m_wordWrap.c_str() : m_text.c_str();
+
+    // Draw
+    if (m_bgColor.w != 0.f)
+    {
+        XMVECTOR bgColor = m_style & c_StyleTransparent ?
+            XMLoadFloat4(&mgr->mConfig.colorTransparent) :
+            XMLoadFloat4(&m_bgColor);
+
+        mgr->DrawRect(m_screenRect, bgColor);
+    }
+    
+    XMVECTOR color = XMLoadFloat4(&m_fgColor);
+
+    font->DrawString(mgr->m_batch.get(), text, m_textPos, color);
+}
+
+void TextLabel::Update(float)
+{
+    if (m_dirty)
+    {
+        PlaceText();
+    }
+}
+
+void TextLabel::PlaceText()
+{
+    auto mgr = UIManager::Impl::s_uiManager;
+    if (!mgr)
+    {
+        throw std::exception("UIManager");
+    }
+
     // Determine font
     SpriteFont* font = mgr->SelectFont(m_style);
 
@@ -2492,64 +1942,52 @@ void TextLabel::Render()
                 && m_screenRect.left != m_screenRect.right
                 && m_screenRect.top != m_screenRect.bottom))
         {
-            m_wordWrap = WordWrap(text, font, m_screenRect);
+            m_wordWrap = mgr->WordWrap(font, text, m_screenRect)->text;
         }
 
         text = m_wordWrap.c_str();
     }
-        
+
     // Determine layout
+    XMVECTOR fsize = font->MeasureString(text);
+
     XMFLOAT2 pos(float(m_screenRect.left), float(m_screenRect.top));
-    if (m_style & (c_StyleAlignCenter | c_StyleAlignRight | c_StyleAlignMiddle | c_StyleAlignBottom))
+    if (m_style & c_StyleAlignCenter)
     {
-        XMVECTOR fsize = font->MeasureString(text);
-
-        if (m_style & c_StyleAlignCenter)
-        {
-            pos.x = float(m_screenRect.left) + float((m_screenRect.right - m_screenRect.left) / 2) - XMVectorGetX(fsize) / 2.f;
-            if (pos.x < float(m_screenRect.left))
-                pos.x = float(m_screenRect.left);
-        }
-        else if (m_style & c_StyleAlignRight)
-        {
-            pos.x = float(m_screenRect.right - 1) - XMVectorGetX(fsize);
-            if (pos.x < float(m_screenRect.left))
-                pos.x = float(m_screenRect.left);
-        }
-
-        if (m_style & c_StyleAlignMiddle)
-        {
-            pos.y = float(m_screenRect.top) + float((m_screenRect.bottom - m_screenRect.top) / 2) - XMVectorGetY(fsize) / 2.f;
-            if (pos.y < float(m_screenRect.top))
-                pos.y = float(m_screenRect.top);
-        }
-        else if (m_style & c_StyleAlignBottom)
-        {
-            pos.y = float(m_screenRect.bottom - 1) - XMVectorGetY(fsize);
-            if (pos.y < float(m_screenRect.top))
-                pos.y = float(m_screenRect.top);
-        }
+        pos.x = float(m_screenRect.left) + float((m_screenRect.right - m_screenRect.left) / 2) - XMVectorGetX(fsize) / 2.f;
+        if (pos.x < float(m_screenRect.left))
+            pos.x = float(m_screenRect.left);
     }
-
-    // Draw
-    if (m_bgColor.w != 0.f)
+    else if (m_style & c_StyleAlignRight)
     {
-        XMVECTOR bgColor = m_style & c_StyleTransparent ?
-            XMLoadFloat4(&mgr->mConfig.colorTransparent) :
-            XMLoadFloat4(&m_bgColor);
+        pos.x = float(m_screenRect.right - 1) - XMVectorGetX(fsize);
+        if (pos.x < float(m_screenRect.left))
+            pos.x = float(m_screenRect.left);
+    }
 
-        mgr->DrawRect(m_screenRect, bgColor);
+    if (m_style & c_StyleAlignMiddle)
+    {
+        pos.y = float(m_screenRect.top) + float((m_screenRect.bottom - m_screenRect.top) / 2) - XMVectorGetY(fsize) / 2.f;
+        if (pos.y < float(m_screenRect.top))
+            pos.y = float(m_screenRect.top);
+    }
+    else if (m_style & c_StyleAlignBottom)
+    {
+        pos.y = float(m_screenRect.bottom - 1) - XMVectorGetY(fsize);
+        if (pos.y < float(m_screenRect.top))
+            pos.y = float(m_screenRect.top);
     }
-    
-    XMVECTOR color = XMLoadFloat4(&m_fgColor);
 
-    font->DrawString(mgr->m_batch.get(), text, pos, color);
+    m_textPos = pos;
+    m_overflow = (pos.x + XMVectorGetX(fsize) > float(m_screenRect.right)) || (pos.y + XMVectorGetY(fsize) > float(m_screenRect.bottom));
+    m_dirty = false;
 }
 
 void TextLabel::SetText(const wchar_t* text)
 {
     m_text = text;
     m_wordWrap.clear();
+    Invalidate();
 }
 
 void TextLabel::ComputeLayout(const RECT& parent)
@@ -2594,6 +2032,7 @@ _Use_decl_annotations_
 Legend::Legend(unsigned id, const wchar_t* text, const RECT& rect, unsigned style) :
     IControl(rect, id),
     m_style(style),
+    m_overflow(false),
     m_text(text)
 {
     auto mgr = UIManager::Impl::s_uiManager;
@@ -2614,71 +2053,85 @@ void Legend::Render()
         throw std::exception("UIManager");
     }
 
+    if (m_dirty)
+    {
+        PlaceText();
+    }
+
     // Determine font
     SpriteFont* font = mgr->SelectFont(m_style);
+    SpriteFont* ctrlFont = mgr->SelectLegendFont(m_style);
 
-    SpriteFont* ctrlFont = nullptr;
-    if (m_style & c_StyleFontLarge)
+    // Draw
+    if(m_bgColor.w != 0.f)
     {
-        ctrlFont = mgr->m_largeLegend.get();
+        XMVECTOR bgColor = m_style & c_StyleTransparent ?
+            XMLoadFloat4(&mgr->mConfig.colorTransparent) :
+            XMLoadFloat4(&m_bgColor);
+
+        mgr->DrawRect(m_screenRect, bgColor);
     }
-    else if (m_style & c_StyleFontSmall)
+        
+
+    XMVECTOR color = XMLoadFloat4(&m_fgColor);
+    DX::DrawControllerString(mgr->m_batch.get(), font, ctrlFont, m_text.c_str(), m_textPos, color);
+}
+
+void Legend::Update(float)
+{
+    if (m_dirty)
     {
-        ctrlFont = mgr->m_smallLegend.get();
+        PlaceText();
     }
-    else
+}
+
+void Legend::PlaceText()
+{
+    auto mgr = UIManager::Impl::s_uiManager;
+    if (!mgr)
     {
-        ctrlFont = mgr->m_smallLegend.get();
+        throw std::exception("UIManager");
     }
 
-    assert(ctrlFont != 0);
+    // Determine font
+    SpriteFont* font = mgr->SelectFont(m_style);
+    SpriteFont* ctrlFont = mgr->SelectLegendFont(m_style);
 
     // Determine layout
     XMFLOAT2 pos(float(m_screenRect.left), float(m_screenRect.top));
-    if (m_style & (c_StyleAlignCenter | c_StyleAlignRight | c_StyleAlignMiddle | c_StyleAlignBottom))
-    {
-        RECT rect = DX::MeasureControllerDrawBounds(font, ctrlFont, m_text.c_str(), pos);
-
-        if (m_style & c_StyleAlignCenter)
-        {
-            pos.x = float(m_screenRect.left) + float((m_screenRect.right - m_screenRect.left) / 2) - float(rect.right - rect.left) / 2.f;
-            if (pos.x < float(m_screenRect.left))
-                pos.x = float(m_screenRect.left);
-        }
-        else if (m_style & c_StyleAlignRight)
-        {
-            pos.x = float(m_screenRect.right - 1) - float(rect.right - rect.left);
-            if (pos.x < float(m_screenRect.left))
-                pos.x = float(m_screenRect.left);
-        }
+    RECT rect = DX::MeasureControllerDrawBounds(font, ctrlFont, m_text.c_str(), pos);
+    float width = float(rect.right - rect.left);
+    float height = float(rect.bottom - rect.top);
 
-        if (m_style & c_StyleAlignMiddle)
-        {
-            pos.y = float(m_screenRect.top) + float((m_screenRect.bottom - m_screenRect.top) / 2) - float(rect.bottom - rect.top) / 2.f;
-            if (pos.y < float(m_screenRect.top))
-                pos.y = float(m_screenRect.top);
-        }
-        else if (m_style & c_StyleAlignBottom)
-        {
-            pos.y = float(m_screenRect.bottom - 1) - float(rect.bottom - rect.top);
-            if (pos.y < float(m_screenRect.top))
-                pos.y = float(m_screenRect.top);
-        }
+    if (m_style & c_StyleAlignCenter)
+    {
+        pos.x = float(m_screenRect.left) + float((m_screenRect.right - m_screenRect.left) / 2) - width / 2.f;
+        if (pos.x < float(m_screenRect.left))
+            pos.x = float(m_screenRect.left);
     }
-
-    // Draw
-    if(m_bgColor.w != 0.f)
+    else if (m_style & c_StyleAlignRight)
     {
-        XMVECTOR bgColor = m_style & c_StyleTransparent ?
-            XMLoadFloat4(&mgr->mConfig.colorTransparent) :
-            XMLoadFloat4(&m_bgColor);
+        pos.x = float(m_screenRect.right - 1) - width;
+        if (pos.x < float(m_screenRect.left))
+            pos.x = float(m_screenRect.left);
+    }
 
-        mgr->DrawRect(m_screenRect, bgColor);
+    if (m_style & c_StyleAlignMiddle)
+    {
+        pos.y = float(m_screenRect.top) + float((m_screenRect.bottom - m_screenRect.top) / 2) - height / 2.f;
+        if (pos.y < float(m_screenRect.top))
+            pos.y = float(m_screenRect.top);
+    }
+    else if (m_style & c_StyleAlignBottom)
+    {
+        pos.y = float(m_screenRect.bottom - 1) - height;
+        if (pos.y < float(m_screenRect.top))
+            pos.y = float(m_screenRect.top);
     }
-        
 
-    XMVECTOR color = XMLoadFloat4(&m_fgColor);
-    DX::DrawControllerString(mgr->m_batch.get(), font, ctrlFont, m_text.c_str(), pos, color);
+    m_textPos = pos;
+    m_overflow = (pos.x + width > float(m_screenRect.right)) || (pos.y + height > float(m_screenRect.bottom));
+    m_dirty = false;
 }
 
 
@@ -2691,6 +2144,7 @@ Button::Button(unsigned id, const wchar_t* text, const RECT& rect) :
     m_enabled(true),
     m_showBorder(false),
     m_noFocusColor(false),
+    m_overflow(false),
     m_style(c_StyleFontMid),
     m_text(text)
 {
@@ -2705,17 +2159,15 @@ void Button::Render()
         throw std::exception("UIManager");
     }
 
+    if (m_dirty)
+    {
+        PlaceText();
+    }
+
     // Determine font
     SpriteFont* font = mgr->SelectFont(m_style);
 
-    // Determine layout
-    XMVECTOR fsize = font->MeasureString(m_text.c_str());
-    XMFLOAT2 pos(float(m_screenRect.left) + float((m_screenRect.right - m_screenRect.left) / 2) - XMVectorGetX(fsize) / 2.f,
-                 float(m_screenRect.top) + float((m_screenRect.bottom - m_screenRect.top) / 2) - XMVectorGetY(fsize) / 2.f);
-    if (pos.x < float(m_screenRect.left))
-        pos.x = float(m_screenRect.left);
-    if (pos.y < float(m_screenRect.top))
-        pos.y = float(m_screenRect.top);
+    const XMFLOAT2& pos = m_textPos;
 
     int borderWidth = 5;
     RECT buttonRect = { m_screenRect.left + borderWidth, m_screenRect.top + borderWidth, m_screenRect.right - borderWidth, m_screenRect.bottom - borderWidth };
@@ -2797,6 +2249,39 @@ void Button::Render()
     }
 }
 
+void Button::Update(float)
+{
+    if (m_dirty)
+    {
+        PlaceText();
+    }
+}
+
+void Button::PlaceText()
+{
+    auto mgr = UIManager::Impl::s_uiManager;
+    if (!mgr)
+    {
+        throw std::exception("UIManager");
+    }
+
+    // Determine font
+    SpriteFont* font = mgr->SelectFont(m_style);
+
+    // Determine layout
+    XMVECTOR fsize = font->MeasureString(m_text.c_str());
+    XMFLOAT2 pos(float(m_screenRect.left) + float((m_screenRect.right - m_screenRect.left) / 2) - XMVectorGetX(fsize) / 2.f,
+                 float(m_screenRect.top) + float((m_screenRect.bottom - m_screenRect.top) / 2) - XMVectorGetY(fsize) / 2.f);
+    if (pos.x < float(m_screenRect.left))
+        pos.x = float(m_screenRect.left);
+    if (pos.y < float(m_screenRect.top))
+        pos.y = float(m_screenRect.top);
+
+    m_textPos = pos;
+    m_overflow = (pos.x + XMVectorGetX(fsize) > float(m_screenRect.right)) || (pos.y + XMVectorGetY(fsize) > float(m_screenRect.bottom));
+    m_dirty = false;
+}
+
 bool Button::OnSelected(IPanel* panel)
 {
     if (m_callBack)
@@ -4038,7 +3523,9 @@ void TextBox::Render()
                 && m_itemRect.left != m_itemRect.right
                 && m_itemRect.top != m_itemRect.bottom))
         {
-            m_wordWrap = WordWrap(text, font, m_itemRect, &m_wordWrapLines);
+            auto wrapped = mgr->WordWrap(font, text, m_itemRect);
+            m_wordWrap = wrapped->text;
+            m_wordWrapLines = wrapped->lineStarts;
         }
 
         if (m_topLine >= static_cast<int>(m_wordWrapLines.size()))
@@ -4672,6 +4159,12 @@ void Popup::Add(_In_ IControl* ctrl)
     {
         m_controls.push_back(ctrl);
         ctrl->SetParent(this);
+
+        auto mgr = UIManager::Impl::s_uiManager;
+        if (mgr)
+        {
+            mgr->RegisterControl(this, ctrl);
+        }
     }
 }
 
@@ -4686,6 +4179,14 @@ IControl* Popup::Find(unsigned id)
     return nullptr;
 }
 
+void Popup::Enumerate(std::function<void(_In_ IControl*)> enumCallback)
+{
+    for (auto it : m_controls)
+    {
+        enumCallback(it);
+    }
+}
+
 void Popup::SetFocus(_In_ IControl* ctrl)
 {
     m_focusControl = ::SetFocusCtrl(m_focusControl, ctrl);
@@ -4786,6 +4287,12 @@ void HUD::Add(_In_ IControl* ctrl)
     {
         m_controls.push_back(ctrl);
         ctrl->SetParent(this);
+
+        auto mgr = UIManager::Impl::s_uiManager;
+        if (mgr)
+        {
+            mgr->RegisterControl(this, ctrl);
+        }
     }
 }
 
@@ -4800,6 +4307,14 @@ IControl* HUD::Find(unsigned id)
     return nullptr;
 }
 
+void HUD::Enumerate(std::function<void(_In_ IControl*)> enumCallback)
+{
+    for (auto it : m_controls)
+    {
+        enumCallback(it);
+    }
+}
+
 void HUD::OnWindowSize(const RECT& layout)
 {
     float dx = float(layout.right - layout.left) / float(m_screenRect.right - m_screenRect.left);
@@ -5116,6 +4631,12 @@ void Overlay::Add(_In_ IControl* ctrl)
     {
         m_controls.push_back(ctrl);
         ctrl->SetParent(this);
+
+        auto mgr = UIManager::Impl::s_uiManager;
+        if (mgr)
+        {
+            mgr->RegisterControl(this, ctrl);
+        }
     }
 }
 
@@ -5130,6 +4651,14 @@ IControl* Overlay::Find(unsigned id)
     return nullptr;
 }
 
+void Overlay::Enumerate(std::function<void(_In_ IControl*)> enumCallback)
+{
+    for (auto it : m_controls)
+    {
+        enumCallback(it);
+    }
+}
+
 void Overlay::SetFocus(_In_ IControl* ctrl)
 {
     m_focusControl = ::SetFocusCtrl(m_focusControl, ctrl);
@@ -58,20 +58,21 @@ namespace ATG
 
         virtual bool CanFocus() const { return false;  }
         virtual bool DefaultFocus() const { return false; }
-        virtual void OnFocus(bool in)
-        { 
-            m_focus = in;
-            if (in && m_focusCb)
-            {
-                m_focusCb(nullptr, this);
-            }
-        }
+        virtual void OnFocus(bool in);
 
         virtual bool OnSelected(IPanel*) { return false; }
 
         virtual bool Update(float /*elapsedTime*/, const DirectX::GamePad::State&) { return false; }
         virtual bool Update(float /*elapsedTime*/, const DirectX::Mouse::State&, const DirectX::Keyboard::State&) { return false; }
 
+        // Per-frame work that doesn't need input. The UIManager only calls this for controls that are dirty,
+        // focused or animating, so static controls cost nothing.
+        virtual void Update(float /*elapsedTime*/) {}
+
+        // Whether Render can draw outside of the control's rectangle, so it needs a scissor rectangle and a sprite
+        // batch of its own. Controls that draw inside it share batches with their neighbors.
+        virtual bool NeedsClipping() const { return true; }
+
         // Properties
         using callback_t = std::function<void(_In_ IPanel*, _In_ IControl*)>;
 
@@ -88,7 +89,7 @@ namespace ATG
         unsigned GetHotKey() const { return m_hotKey; }
         void SetHotKey(unsigned hotkey) { m_hotKey = hotkey;  }
 
-        void SetId(unsigned id) { m_id = id; }
+        void SetId(unsigned id);
         unsigned GetId() const { return m_id; }
 
         void SetUser(void* user) { m_user = user; }
@@ -96,26 +97,37 @@ namespace ATG
 
         void SetParent(IPanel* panel) { m_parent = panel; }
 
+        // Controls that change every frame are updated every frame while this is set
+        void SetAnimating(bool animating = true);
+
         void SetVisible(bool visible = true);
         bool IsVisible() const { return m_visible; }
 
         const RECT* GetRectangle() const { return &m_screenRect; }
 
+        // Controls cache their text placement between frames. It is recomputed by the next update after layout,
+        // text or style changes, or when Invalidate is called.
+        void Invalidate();
+        bool IsDirty() const { return m_dirty; }
+
     protected:
         IControl(const RECT& rect, unsigned id) :
             m_visible(true),
             m_focus(false),
+            m_dirty(true),
             m_layoutRect(rect),
             m_screenRect(rect),
             m_hotKey(0),
             m_id(id),
             m_user(nullptr),
-            m_parent(nullptr)
+            m_parent(nullptr),
+            m_slot(UINT32_MAX)
         {
         }
 
         bool        m_visible;
         bool        m_focus;
+        bool        m_dirty;
         RECT        m_layoutRect;
         RECT        m_screenRect;
         callback_t  m_callBack;
@@ -124,6 +136,11 @@ namespace ATG
         unsigned    m_id;
         void*       m_user;
         IPanel*     m_parent;
+
+    private:
+        friend class UIManager;
+
+        uint32_t    m_slot;         // In the UIManager's control registry
     };
 
     // Static text label
@@ -151,7 +168,7 @@ namespace ATG
         static const unsigned c_StyleFontBold = 0x40000;
         static const unsigned c_StyleFontItalic = 0x80000;
 
-        void SetStyle(unsigned style) { m_style = style; }
+        void SetStyle(unsigned style) { m_style = style; m_wordWrap.clear(); Invalidate(); }
         unsigned GetStyle() const { return m_style; }
 
         void SetText(const wchar_t* text);
@@ -162,13 +179,19 @@ namespace ATG
         virtual void ComputeLayout(const RECT& parent) override;
         virtual void ComputeLayout(const RECT& bounds, float dx, float dy) override;
         virtual bool Contains(long, long) const override { return false; }
+        virtual void Update(float) override;
+        virtual bool NeedsClipping() const override { return m_dirty || m_overflow; }
 
     private:
         unsigned            m_style;
+        bool                m_overflow;
         DirectX::XMFLOAT4   m_fgColor;
         DirectX::XMFLOAT4   m_bgColor;
         std::wstring        m_text;
         std::wstring        m_wordWrap;
+        DirectX::XMFLOAT2   m_textPos;
+
+        void PlaceText();
     };
     
     // Static image
@@ -183,6 +206,7 @@ namespace ATG
         // IControl
         virtual void Render() override;
         virtual bool Contains(long, long) const override { return false; }
+        virtual bool NeedsClipping() const override { return false; }
 
     private:
         unsigned m_imageId;
@@ -212,21 +236,27 @@ namespace ATG
         static const unsigned c_StyleFontBold = 0x40000;
         static const unsigned c_StyleFontItalic = 0x80000;
 
-        void SetStyle(unsigned style) { m_style = style; }
+        void SetStyle(unsigned style) { m_style = style; Invalidate(); }
         unsigned GetStyle() const { return m_style; }
 
-        void SetText(const wchar_t* text) { m_text = text; }
+        void SetText(const wchar_t* text) { m_text = text; Invalidate(); }
         const wchar_t* GetText() const { return m_text.c_str(); }
 
         // IControl
         virtual void Render() override;
         virtual bool Contains(long, long) const override { return false; }
+        virtual void Update(float) override;
+        virtual bool NeedsClipping() const override { return m_dirty || m_overflow; }
 
     private:
         unsigned            m_style;
+        bool                m_overflow;
         DirectX::XMFLOAT4   m_bgColor;
         DirectX::XMFLOAT4   m_fgColor;
         std::wstring        m_text;
+        DirectX::XMFLOAT2   m_textPos;
+
+        void PlaceText();
     };
 
     // Pressable button
@@ -255,10 +285,10 @@ namespace ATG
         static const unsigned c_StyleFontBold = 0x40000;
         static const unsigned c_StyleFontItalic = 0x80000;
 
-        void SetStyle(unsigned style) { m_style = style; }
+        void SetStyle(unsigned style) { m_style = style; Invalidate(); }
         unsigned GetStyle() const { return m_style; }
 
-        void SetText(const wchar_t* text) { m_text = text; }
+        void SetText(const wchar_t* text) { m_text = text; Invalidate(); }
         const wchar_t* GetText() const { return m_text.c_str(); }
 
         // IControl
@@ -266,15 +296,21 @@ namespace ATG
         virtual bool CanFocus() const override { return m_enabled; }
         virtual bool DefaultFocus() const override { return (m_style & c_StyleDefault) != 0; }
         virtual bool OnSelected(IPanel* panel) override;
+        virtual void Update(float) override;
+        virtual bool NeedsClipping() const override { return m_dirty || m_overflow; }
 
     private:
         bool               m_enabled;
         bool               m_showBorder;
         bool               m_noFocusColor;
         bool               m_focusOnText;
+        bool               m_overflow;
         unsigned           m_style;
         std::wstring       m_text;
         DirectX::XMFLOAT4  m_color;
+        DirectX::XMFLOAT2  m_textPos;
+
+        void PlaceText();
     };
 
     // Pressable image
@@ -590,6 +626,7 @@ namespace ATG
 
         virtual void Add(_In_ IControl* ctrl) = 0;
         virtual IControl* Find(unsigned id) = 0;
+        virtual void Enumerate(std::function<void(_In_ IControl*)> enumCallback) = 0;
 
         virtual void SetFocus(_In_ IControl*) {}
 
@@ -645,6 +682,7 @@ namespace ATG
         virtual void Cancel() override;
         virtual void Add(_In_ IControl* ctrl) override;
         virtual IControl* Find(unsigned id) override;
+        virtual void Enumerate(std::function<void(_In_ IControl*)> enumCallback) override;
         virtual void SetFocus(_In_ IControl* ctrl) override;
         virtual void OnWindowSize(const RECT& layout) override;
         
@@ -673,6 +711,7 @@ namespace ATG
         virtual void Close() override;
         virtual void Add(_In_ IControl* ctrl) override;
         virtual IControl* Find(unsigned id) override;
+        virtual void Enumerate(std::function<void(_In_ IControl*)> enumCallback) override;
         virtual void OnWindowSize(const RECT& layout) override;
 
     private:
@@ -695,6 +734,7 @@ namespace ATG
         virtual void Cancel() override;
         virtual void Add(_In_ IControl* ctrl) override;
         virtual IControl* Find(unsigned id) override;
+        virtual void Enumerate(std::function<void(_In_ IControl*)> enumCallback) override;
         virtual void SetFocus(_In_ IControl* ctrl) override;
         virtual void OnWindowSize(const RECT& layout) override;
 
@@ -826,6 +866,23 @@ namespace ATG
         }
     };
 
+    // Handle to a control found through the UIManager, which resolves without a search or type check.
+    // Handles become invalid when the control's panel is replaced or the UIManager is cleared.
+    template<class T>
+    class ControlHandle
+    {
+    public:
+        ControlHandle() : m_index(UINT32_MAX), m_epoch(0) {}
+
+        bool IsValid() const { return m_index != UINT32_MAX; }
+
+    private:
+        friend class UIManager;
+
+        uint32_t m_index;
+        uint32_t m_epoch;
+    };
+
     class UIManager
     {
     public:
@@ -850,9 +907,15 @@ namespace ATG
 
         virtual ~UIManager();
 
-        // Load UI layout from disk
+        // Load UI layout from disk. A .uilayout next to the .csv, compiled by Tools/CompileUILayout or
+        // CompileLayout, is used instead when the .csv's size and write time match those it was compiled from;
+        // otherwise the .csv is parsed.
         void LoadLayout(const wchar_t* layoutFile, const wchar_t* imageDir = nullptr, unsigned offset = 0);
 
+        // Compile a .csv UI layout into a binary layout that loads without parsing, as Tools/CompileUILayout
+        // does offline. By default the output has the same name with a .uilayout extension.
+        static void CompileLayout(const wchar_t* layoutFile, const wchar_t* compiledFile = nullptr);
+
         // Add a panel (takes ownership)
         void Add(unsigned id, _In_ IPanel* panel);
 
@@ -875,17 +938,34 @@ namespace ATG
         template<class T>
         T* FindControl(unsigned panelId, unsigned ctrlId) const
         {
-            auto panel = Find(panelId);
-            if (panel)
+            auto ctrl = dynamic_cast<T*>(LookupControl(panelId, ctrlId, nullptr));
+            if (ctrl)
+                return ctrl;
+
+            throw std::exception("Find (control)");
+        }
+
+        // Get the typed handle of a control, for controls that are accessed every frame. Every control has one
+        // from when it or its panel was added, so this is a lookup rather than a search.
+        template<class T>
+        ControlHandle<T> FindControlHandle(unsigned panelId, unsigned ctrlId) const
+        {
+            ControlHandle<T> handle;
+            if (dynamic_cast<T*>(LookupControl(panelId, ctrlId, &handle.m_index)))
             {
-                auto ctrl = dynamic_cast<T*>(panel->Find(ctrlId));
-                if (ctrl)
-                    return ctrl;
+                handle.m_epoch = GetControlEpoch();
+                return handle;
             }
 
             throw std::exception("Find (control)");
         }
 
+        template<class T>
+        T* GetControl(ControlHandle<T> handle) const
+        {
+            return static_cast<T*>(ResolveControl(handle.m_index, handle.m_epoch));
+        }
+
         // Close all visible panels
         void CloseAll();
 
@@ -950,6 +1030,10 @@ namespace ATG
 
         std::unique_ptr<Impl> pImpl;
 
+        IControl* LookupControl(unsigned panelId, unsigned ctrlId, _Out_opt_ uint32_t* index) const;
+        IControl* ResolveControl(uint32_t index, uint32_t epoch) const;
+        uint32_t GetControlEpoch() const;
+
         friend class IControl;
         friend class TextLabel;
         friend class Image;
@@ -0,0 +1,843 @@
+//--------------------------------------------------------------------------------------
+// File: SampleGUILayout.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//-------------------------------------------------------------------------------------
+
+#include "pch.h"
+#include "SampleGUILayout.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Other required ATG Tool Kit components
+#include "CSVReader.h"
+#include "MappedFile.h"
+
+using namespace ATG;
+
+namespace
+{
+    // Names of the UIConfig::COLORS values, in order
+    const wchar_t* c_LayoutColorNames[] =
+    {
+        L"RED", L"GREEN", L"BLUE", L"ORANGE", L"YELLOW", L"DARKGREY", L"MID_GREY", L"LIGHTGREY", L"OFFWHITE", L"WHITE", L"BLACK"
+    };
+
+    static_assert(_countof(c_LayoutColorNames) == c_LayoutColorCount, "Layout color names mismatch");
+
+    void DebugTrace(_In_z_ _Printf_format_string_ const char* format, ...)
+    {
+#ifdef _WIN32
+#ifdef _DEBUG
+        va_list args;
+        va_start(args, format);
+
+        char buff[1024] = {};
+        vsprintf_s(buff, format, args);
+        OutputDebugStringA(buff);
+        va_end(args);
+#else
+        UNREFERENCED_PARAMETER(format);
+#endif
+#else
+        // The offline compiler and the tests report warnings on the console
+        va_list args;
+        va_start(args, format);
+        vfprintf(stderr, format, args);
+        va_end(args);
+#endif
+    }
+
+    // Throws a std::runtime_error describing an invalid layout, which is also traced for samples on Windows.
+    [[noreturn]] void LayoutError(_In_z_ _Printf_format_string_ const char* format, ...)
+    {
+        char buff[1024] = {};
+
+        va_list args;
+        va_start(args, format);
+        vsnprintf(buff, sizeof(buff), format, args);
+        va_end(args);
+
+#ifdef _WIN32
+        DebugTrace("ERROR: %s\n", buff);
+#endif
+        throw std::runtime_error(buff);
+    }
+
+    void TrimTrailingWhitespace(_Inout_z_ wchar_t* str)
+    {
+        size_t len = wcslen(str);
+        for(wchar_t *ptr = str + len; len > 0; --len, --ptr)
+        {
+            if (!iswspace( *(ptr-1) ))
+            {
+                *ptr = 0;
+                break;
+            }
+        }
+    }
+
+    void HandleEscapeCharacters(_Inout_z_ wchar_t* str)
+    {
+        for (wchar_t*ptr = str; *ptr != 0; ++ptr)
+        {
+            if (*ptr == L'|')
+                *ptr = L'\n';
+        }
+    }
+
+    unsigned HandleVirtualKeys(_Inout_z_ wchar_t* str)
+    {
+        static const struct Map { const wchar_t* first; unsigned second; } s_map[] =
+        {
+            { L"F1", c_LayoutKeyF1 },
+            { L"F2", c_LayoutKeyF1 + 1 },
+            { L"F3", c_LayoutKeyF1 + 2 },
+            { L"F4", c_LayoutKeyF1 + 3 },
+            { L"F5", c_LayoutKeyF1 + 4 },
+            { L"F6", c_LayoutKeyF1 + 5 },
+            { L"F7", c_LayoutKeyF1 + 6 },
+            { L"F8", c_LayoutKeyF1 + 7 },
+            { L"F9", c_LayoutKeyF1 + 8 },
+            { L"F10", c_LayoutKeyF1 + 9 },
+        };
+
+        for(size_t j = 0; j < _countof(s_map); ++j)
+        {
+            if (_wcsicmp(s_map[j].first, str) == 0)
+            {
+                return s_map[j].second;
+            }
+        }
+
+        if (*(str + 1) == 0)
+        {
+            return unsigned(*str);
+        }
+
+        return 0;
+    }
+
+    struct LayoutStyleToken
+    {
+        const wchar_t*  name;
+        unsigned        style;
+        uint16_t        flags;
+    };
+
+    const LayoutStyleToken c_PopupStyles[] =
+    {
+        { L"EMPHASIS", c_LayoutStylePanelEmphasis, 0 },
+        { L"SUPPRESS_CANCEL", c_LayoutStylePanelSuppressCancel, 0 },
+    };
+
+    const LayoutStyleToken c_OverlayStyles[] =
+    {
+        { L"SUPPRESS_CANCEL", c_LayoutStylePanelSuppressCancel, 0 },
+    };
+
+    const LayoutStyleToken c_LabelStyles[] =
+    {
+        { L"LEFT", c_LayoutStyleAlignLeft | c_LayoutStyleAlignMiddle, 0 },
+        { L"CENTER", c_LayoutStyleAlignCenter | c_LayoutStyleAlignMiddle, 0 },
+        { L"RIGHT", c_LayoutStyleAlignRight | c_LayoutStyleAlignMiddle, 0 },
+        { L"LARGE", c_LayoutStyleFontLarge, 0 },
+        { L"SMALL", c_LayoutStyleFontSmall, 0 },
+        { L"BOLD", c_LayoutStyleFontBold, 0 },
+        { L"ITALIC", c_LayoutStyleFontItalic, 0 },
+        { L"TRANSPARENT", c_LayoutStyleLabelTransparent, 0 },
+        { L"WORDWRAP", c_LayoutStyleLabelWordWrap, 0 },
+    };
+
+    const LayoutStyleToken c_LegendStyles[] =
+    {
+        { L"LEFT", c_LayoutStyleAlignLeft | c_LayoutStyleAlignMiddle, 0 },
+        { L"CENTER", c_LayoutStyleAlignCenter | c_LayoutStyleAlignMiddle, 0 },
+        { L"RIGHT", c_LayoutStyleAlignRight | c_LayoutStyleAlignMiddle, 0 },
+        { L"LARGE", c_LayoutStyleFontLarge, 0 },
+        { L"SMALL", c_LayoutStyleFontSmall, 0 },
+        { L"BOLD", c_LayoutStyleFontBold, 0 },
+        { L"ITALIC", c_LayoutStyleFontItalic, 0 },
+        { L"TRANSPARENT", c_LayoutStyleLabelTransparent, 0 },
+    };
+
+    const LayoutStyleToken c_ButtonStyles[] =
+    {
+        { L"LARGE", c_LayoutStyleFontLarge, 0 },
+        { L"SMALL", c_LayoutStyleFontSmall, 0 },
+        { L"BOLD", c_LayoutStyleFontBold, 0 },
+        { L"ITALIC", c_LayoutStyleFontItalic, 0 },
+        { L"TRANSPARENT", c_LayoutStyleButtonTransparent, 0 },
+        { L"BORDER", 0, c_LayoutFlagBorder },
+        { L"NO_FOCUS_COLOR", 0, c_LayoutFlagNoFocusColor },
+        { L"FOCUS_ON_TEXT", 0, c_LayoutFlagFocusOnText },
+    };
+
+    const LayoutStyleToken c_ImageButtonStyles[] =
+    {
+        { L"BACKGROUND", c_LayoutStyleImageButtonBackground, 0 },
+        { L"TRANSPARENT", c_LayoutStyleImageButtonTransparent | c_LayoutStyleImageButtonBackground, 0 },
+    };
+
+    const LayoutStyleToken c_CheckBoxStyles[] =
+    {
+        { L"LARGE", c_LayoutStyleFontLarge, 0 },
+        { L"SMALL", c_LayoutStyleFontSmall, 0 },
+        { L"BOLD", c_LayoutStyleFontBold, 0 },
+        { L"ITALIC", c_LayoutStyleFontItalic, 0 },
+        { L"CHECKED", 0, c_LayoutFlagChecked },
+        { L"TRANSPARENT", c_LayoutStyleCheckBoxTransparent, 0 },
+    };
+
+    const LayoutStyleToken c_SliderStyles[] =
+    {
+        { L"TRANSPARENT", c_LayoutStyleSliderTransparent, 0 },
+    };
+
+    const LayoutStyleToken c_TextListStyles[] =
+    {
+        { L"LARGE", c_LayoutStyleFontLarge, 0 },
+        { L"SMALL", c_LayoutStyleFontSmall, 0 },
+        { L"BOLD", c_LayoutStyleFontBold, 0 },
+        { L"ITALIC", c_LayoutStyleFontItalic, 0 },
+        { L"TRANSPARENT", c_LayoutStyleListBoxTransparent, 0 },
+    };
+
+    const LayoutStyleToken c_ListBoxStyles[] =
+    {
+        { L"MULTISELECT", c_LayoutStyleListBoxMultiSelection, 0 },
+        { L"LARGE", c_LayoutStyleFontLarge, 0 },
+        { L"SMALL", c_LayoutStyleFontSmall, 0 },
+        { L"BOLD", c_LayoutStyleFontBold, 0 },
+        { L"ITALIC", c_LayoutStyleFontItalic, 0 },
+        { L"TRANSPARENT", c_LayoutStyleListBoxTransparent, 0 },
+        { L"SCROLLBAR", c_LayoutStyleListBoxScrollBar, 0 },
+    };
+
+    const LayoutStyleToken c_TextBoxStyles[] =
+    {
+        { L"LARGE", c_LayoutStyleFontLarge, 0 },
+        { L"SMALL", c_LayoutStyleFontSmall, 0 },
+        { L"BOLD", c_LayoutStyleFontBold, 0 },
+        { L"ITALIC", c_LayoutStyleFontItalic, 0 },
+        { L"TRANSPARENT", c_LayoutStyleTextBoxTransparent, 0 },
+        { L"SCROLLBAR", c_LayoutStyleTextBoxScrollBar, 0 },
+        { L"NOBACKGROUND", c_LayoutStyleTextBoxNoBackground, 0 },
+    };
+
+    // Reads an optional style item made up of tokens separated by s_seps. Returns false if the record has no more items.
+    template<size_t TCount>
+    bool ParseLayoutStyle(DX::CSVReader& reader, const LayoutStyleToken(&tokens)[TCount], LayoutRecord& record)
+    {
+        static const wchar_t* s_seps = L" ,;|";
+
+        wchar_t styleStr[128] = {};
+        if (!reader.NextItem(styleStr))
+            return false;
+
+        _wcsupr_s(styleStr);
+
+        wchar_t* context = nullptr;
+        const wchar_t* tok = wcstok_s(styleStr, s_seps, &context);
+        while (tok)
+        {
+            for (size_t j = 0; j < TCount; ++j)
+            {
+                if (wcscmp(tok, tokens[j].name) == 0)
+                {
+                    record.style |= tokens[j].style;
+                    record.flags |= tokens[j].flags;
+                    break;
+                }
+            }
+            tok = wcstok_s(nullptr, s_seps, &context);
+        }
+
+        return true;
+    }
+
+    // Reads an optional color item. Returns false if the record has no more items.
+    bool ParseLayoutColor(DX::CSVReader& reader, uint32_t& color)
+    {
+        wchar_t colorStr[32] = {};
+        if (!reader.NextItem(colorStr))
+            return false;
+
+        _wcsupr_s(colorStr);
+
+        color = c_LayoutColorWhite;
+
+        if (*colorStr == L'#')
+        {
+            unsigned int bgra = 0xFFFFFF;
+            if (swscanf_s(colorStr + 1, L"%x", &bgra) == 1)
+            {
+                color = c_LayoutColorRGB | (bgra & 0xFFFFFF);
+            }
+            else
+            {
+                DebugTrace("WARNING: Invalid color value [record %zu]\n", reader.RecordIndex() + 1);
+            }
+        }
+        else if (*colorStr)
+        {
+            size_t j = 0;
+            for (; j < _countof(c_LayoutColorNames); ++j)
+            {
+                if (wcscmp(colorStr, c_LayoutColorNames[j]) == 0)
+                {
+                    color = c_LayoutColorNamed | uint32_t(j);
+                    break;
+                }
+            }
+
+            if (j >= _countof(c_LayoutColorNames))
+            {
+                DebugTrace("WARNING: Invalid color value [record %zu]\n", reader.RecordIndex() + 1);
+            }
+        }
+
+        return true;
+    }
+
+    // Reads a required text item.
+    void ParseLayoutText(DX::CSVReader& reader, _In_z_ const char* item, LayoutStrings& strings, bool escapes, uint32_t& text)
+    {
+        static wchar_t s_text[4096] = {};
+
+        if (!reader.NextItem(s_text))
+        {
+            LayoutError("%s missing text string [record %zu]", item, reader.RecordIndex() + 1);
+        }
+
+        if (escapes)
+        {
+            HandleEscapeCharacters(s_text);
+        }
+
+        text = strings.Intern(s_text);
+    }
+
+    // Reads a required image file name item.
+    void ParseLayoutImage(DX::CSVReader& reader, _In_z_ const char* item, LayoutStrings& strings, uint32_t& image)
+    {
+        wchar_t imageFile[MAX_PATH] = {};
+        if (!reader.NextItem(imageFile))
+        {
+            LayoutError("%s missing image file name [record %zu]", item, reader.RecordIndex() + 1);
+        }
+
+        TrimTrailingWhitespace(imageFile);
+        image = strings.Intern(imageFile);
+    }
+
+    // Writes the compiled layout in one go, so a failed write doesn't leave a partial file that looks valid.
+    void WriteLayoutFile(_In_z_ const wchar_t* fileName, const std::vector<uint8_t>& data)
+    {
+#ifdef _WIN32
+        struct handle_closer { void operator()(HANDLE h) { if (h) CloseHandle(h); } };
+
+        typedef std::unique_ptr<void, handle_closer> ScopedHandle;
+
+#if (_WIN32_WINNT >= 0x0602 /*_WIN32_WINNT_WIN8*/)
+        HANDLE hFile = CreateFile2(fileName,
+            GENERIC_WRITE,
+            0,
+            CREATE_ALWAYS,
+            nullptr);
+#else
+        HANDLE hFile = CreateFileW(fileName,
+            GENERIC_WRITE,
+            0,
+            nullptr,
+            CREATE_ALWAYS,
+            FILE_ATTRIBUTE_NORMAL,
+            nullptr);
+#endif
+        ScopedHandle file((hFile == INVALID_HANDLE_VALUE) ? nullptr : hFile);
+        if (!file)
+        {
+            LayoutError("Failed to create compiled layout %ls (%08X)", fileName, static_cast<unsigned int>(HRESULT_FROM_WIN32(GetLastError())));
+        }
+
+        DWORD bytesWritten = 0;
+        if (!WriteFile(file.get(), data.data(), static_cast<DWORD>(data.size()), &bytesWritten, nullptr)
+            || bytesWritten != data.size())
+        {
+            file.reset();
+            DeleteFileW(fileName);
+            LayoutError("Failed writing compiled layout %ls", fileName);
+        }
+#else
+        size_t length = wcstombs(nullptr, fileName, 0);
+        if (length == static_cast<size_t>(-1))
+        {
+            LayoutError("Invalid compiled layout name");
+        }
+
+        std::string path(length, '\0');
+        wcstombs(&path[0], fileName, length);
+
+        int file = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (file < 0)
+        {
+            LayoutError("Failed to create compiled layout %s", path.c_str());
+        }
+
+        bool written = (write(file, data.data(), data.size()) == static_cast<ssize_t>(data.size()));
+        if (close(file) != 0 || !written)
+        {
+            unlink(path.c_str());
+            LayoutError("Failed writing compiled layout %s", path.c_str());
+        }
+#endif
+    }
+}
+
+
+// Parses a .csv layout into records.
+_Use_decl_annotations_
+void ATG::ParseLayout(const wchar_t* layoutFile, std::vector<LayoutRecord>& records, LayoutStrings& strings)
+{
+    static const struct { const wchar_t* name; const char* item; LayoutType type; } s_types[] =
+    {
+        { L"POPUP", "POPUP", LAYOUT_POPUP },
+        { L"CUSTOM_POPUP", "POPUP", LAYOUT_POPUP },
+        { L"HUD", "HUD", LAYOUT_HUD },
+        { L"OVERLAY", "OVERLAY", LAYOUT_OVERLAY },
+        { L"CUSTOM_OVERLAY", "OVERLAY", LAYOUT_OVERLAY },
+        { L"LABEL", "LABEL", LAYOUT_LABEL },
+        { L"LEGEND", "LEGEND", LAYOUT_LEGEND },
+        { L"IMAGE", "IMAGE", LAYOUT_IMAGE },
+        { L"BUTTON", "BUTTON", LAYOUT_BUTTON },
+        { L"EXITBUTTON", "BUTTON", LAYOUT_BUTTON },
+        { L"DEFBUTTON", "BUTTON", LAYOUT_BUTTON },
+        { L"IMAGEBUTTON", "IMAGEBUTTON", LAYOUT_IMAGEBUTTON },
+        { L"EXITIMAGEBUTTON", "IMAGEBUTTON", LAYOUT_IMAGEBUTTON },
+        { L"DEFIMAGEBUTTON", "IMAGEBUTTON", LAYOUT_IMAGEBUTTON },
+        { L"CHECKBOX", "CHECKBOX", LAYOUT_CHECKBOX },
+        { L"SLIDER", "SLIDER", LAYOUT_SLIDER },
+        { L"PROGRESSBAR", "PROGRESSBAR", LAYOUT_PROGRESSBAR },
+        { L"TEXTLIST", "TEXTLIST", LAYOUT_TEXTLIST },
+        { L"LISTBOX", "LISTBOX", LAYOUT_LISTBOX },
+        { L"TEXTBOX", "TEXTBOX", LAYOUT_TEXTBOX },
+    };
+
+    DX::CSVReader reader(layoutFile, DX::CSVReader::Encoding::UTF8, true);
+
+    bool havePanel = false;
+
+    records.reserve(reader.GetRecordCount());
+
+    while (!reader.EndOfFile())
+    {
+        // Each record starts with ITEM,ID,RECTX,RECTY,DX,DY
+        wchar_t item[1024] = {};
+        if (!reader.NextItem(item))
+        {
+            reader.NextRecord();
+            continue;
+        }
+
+        TrimTrailingWhitespace(item);
+
+        LayoutRecord record = {};
+        record.record = static_cast<uint32_t>(reader.RecordIndex() + 1);
+
+        {
+            // IPanel object ids need to be globally unique
+            wchar_t tmp[16] = {};
+            if (!reader.NextItem(tmp))
+            {
+                LayoutError("Expected an id for record %zu", reader.RecordIndex() + 1);
+            }
+            record.id = static_cast<uint32_t>(_wtoi(tmp));
+        }
+
+        {
+            static const char* s_rectNames[] = { "rectx", "recty", "dx", "dy" };
+
+            int values[4] = {};
+            for (size_t j = 0; j < _countof(values); ++j)
+            {
+                wchar_t tmp[16] = {};
+                if (!reader.NextItem(tmp))
+                {
+                    LayoutError("Expected an %s for record %zu", s_rectNames[j], reader.RecordIndex() + 1);
+                }
+
+                values[j] = _wtoi(tmp);
+            }
+
+            record.rect[0] = values[0];
+            record.rect[1] = values[1];
+            record.rect[2] = values[0] + values[2];
+            record.rect[3] = values[1] + values[3];
+        }
+
+        size_t typeIndex = 0;
+        for (; typeIndex < _countof(s_types); ++typeIndex)
+        {
+            if (_wcsicmp(item, s_types[typeIndex].name) == 0)
+                break;
+        }
+
+        if (typeIndex >= _countof(s_types))
+        {
+            // Unknown items are ignored
+            reader.NextRecord();
+            continue;
+        }
+
+        const wchar_t* name = s_types[typeIndex].name;
+        const char* itemName = s_types[typeIndex].item;
+        record.type = s_types[typeIndex].type;
+
+        if (record.type > LAYOUT_OVERLAY && !havePanel)
+        {
+            LayoutError("%s found outside of panel [record %zu]", itemName, reader.RecordIndex() + 1);
+        }
+
+        switch (record.type)
+        {
+        case LAYOUT_POPUP:
+            record.style = (_wcsicmp(name, L"CUSTOM_POPUP") == 0) ? c_LayoutStylePanelCustom : 0;
+            (void)ParseLayoutStyle(reader, c_PopupStyles, record);
+            havePanel = true;
+            break;
+
+        case LAYOUT_HUD:
+            havePanel = true;
+            break;
+
+        case LAYOUT_OVERLAY:
+            record.style = (_wcsicmp(name, L"CUSTOM_OVERLAY") == 0) ? c_LayoutStylePanelCustom : 0;
+            (void)ParseLayoutStyle(reader, c_OverlayStyles, record);
+            havePanel = true;
+            break;
+
+        case LAYOUT_LABEL:
+        case LAYOUT_LEGEND:
+            ParseLayoutText(reader, itemName, strings, true, record.text);
+            if ((record.type == LAYOUT_LABEL) ? ParseLayoutStyle(reader, c_LabelStyles, record) : ParseLayoutStyle(reader, c_LegendStyles, record))
+            {
+                if (ParseLayoutColor(reader, record.fgColor))
+                {
+                    (void)ParseLayoutColor(reader, record.bgColor);
+                }
+            }
+            break;
+
+        case LAYOUT_IMAGE:
+            ParseLayoutImage(reader, itemName, strings, record.image);
+            break;
+
+        case LAYOUT_BUTTON:
+            ParseLayoutText(reader, itemName, strings, false, record.text);
+            {
+                wchar_t hotkeyStr[64] = {};
+                if (reader.NextItem(hotkeyStr))
+                {
+                    TrimTrailingWhitespace(hotkeyStr);
+
+                    record.hotkey = HandleVirtualKeys(hotkeyStr);
+
+                    // Optional style
+                    if (ParseLayoutStyle(reader, c_ButtonStyles, record))
+                    {
+                        (void)ParseLayoutColor(reader, record.fgColor);
+                    }
+                }
+            }
+
+            if (_wcsicmp(name, L"EXITBUTTON") == 0)
+            {
+                record.style |= c_LayoutStyleExit;
+            }
+            else if (_wcsicmp(name, L"DEFBUTTON") == 0)
+            {
+                record.style |= c_LayoutStyleExit | c_LayoutStyleDefault;
+            }
+            break;
+
+        case LAYOUT_IMAGEBUTTON:
+            ParseLayoutImage(reader, itemName, strings, record.image);
+            {
+                wchar_t hotkeyStr[64] = {};
+                if (reader.NextItem(hotkeyStr))
+                {
+                    TrimTrailingWhitespace(hotkeyStr);
+
+                    record.hotkey = HandleVirtualKeys(hotkeyStr);
+
+                    // Optional style
+                    (void)ParseLayoutStyle(reader, c_ImageButtonStyles, record);
+                }
+            }
+
+            if (_wcsicmp(name, L"EXITIMAGEBUTTON") == 0)
+            {
+                record.style |= c_LayoutStyleExit;
+            }
+            else if (_wcsicmp(name, L"DEFIMAGEBUTTON") == 0)
+            {
+                record.style |= c_LayoutStyleExit | c_LayoutStyleDefault;
+            }
+            break;
+
+        case LAYOUT_CHECKBOX:
+            ParseLayoutText(reader, itemName, strings, false, record.text);
+            (void)ParseLayoutStyle(reader, c_CheckBoxStyles, record);
+            break;
+
+        case LAYOUT_SLIDER:
+            (void)ParseLayoutStyle(reader, c_SliderStyles, record);
+            break;
+
+        case LAYOUT_TEXTLIST:
+        case LAYOUT_LISTBOX:
+            {
+                wchar_t itemHeightStr[64] = {};
+                if (reader.NextItem(itemHeightStr))
+                {
+                    record.itemHeight = _wtoi(itemHeightStr);
+
+                    if (record.type == LAYOUT_TEXTLIST)
+                        (void)ParseLayoutStyle(reader, c_TextListStyles, record);
+                    else
+                        (void)ParseLayoutStyle(reader, c_ListBoxStyles, record);
+                }
+            }
+            break;
+
+        case LAYOUT_TEXTBOX:
+            ParseLayoutText(reader, itemName, strings, true, record.text);
+            (void)ParseLayoutStyle(reader, c_TextBoxStyles, record);
+            break;
+
+        default:
+            break;
+        }
+
+        records.push_back(record);
+
+        reader.NextRecord();
+    }
+}
+
+
+_Use_decl_annotations_
+void ATG::CompileLayoutFile(const wchar_t* layoutFile, const wchar_t* compiledFile)
+{
+    LayoutHeader header = {};
+    DX::MappedFile source;
+    if (FAILED(GetLayoutSourceStamp(layoutFile, header.sourceSize, header.sourceTime))
+        || FAILED(source.Open(layoutFile, true)))
+    {
+        LayoutError("Failed to read layout %ls", layoutFile);
+    }
+
+    std::vector<LayoutRecord> records;
+    LayoutStrings strings;
+    ParseLayout(layoutFile, records, strings);
+
+    auto& stringData = strings.GetData();
+
+    header.magic = c_LayoutMagic;
+    header.version = c_LayoutVersion;
+    header.recordCount = static_cast<uint32_t>(records.size());
+    header.recordOffset = sizeof(LayoutHeader);
+    header.stringCount = static_cast<uint32_t>(stringData.size());
+    header.stringOffset = static_cast<uint32_t>(sizeof(LayoutHeader) + records.size() * sizeof(LayoutRecord));
+    header.sourceHash = HashLayoutSource(source.GetData(), source.GetSize());
+
+    std::vector<uint8_t> data(header.stringOffset + stringData.size() * sizeof(uint16_t));
+    memcpy(data.data(), &header, sizeof(header));
+    if (!records.empty())
+    {
+        memcpy(data.data() + header.recordOffset, records.data(), records.size() * sizeof(LayoutRecord));
+    }
+
+    // The parser's strings are UTF-16 code units, even where wchar_t is wider
+    auto dest = data.data() + header.stringOffset;
+    for (wchar_t c : stringData)
+    {
+        auto unit = static_cast<uint16_t>(c);
+        memcpy(dest, &unit, sizeof(unit));
+        dest += sizeof(unit);
+    }
+
+    std::wstring outputFile = (compiledFile) ? std::wstring(compiledFile) : ReplaceLayoutExtension(layoutFile, c_CompiledLayoutExt);
+    WriteLayoutFile(outputFile.c_str(), data);
+}
+
+
+_Use_decl_annotations_
+const LayoutHeader* ATG::ValidateCompiledLayout(const uint8_t* data, size_t size)
+{
+    if (!data || size < sizeof(LayoutHeader))
+        return nullptr;
+
+    auto header = reinterpret_cast<const LayoutHeader*>(data);
+    if (header->magic != c_LayoutMagic)
+        return nullptr;
+
+    if (header->version != c_LayoutVersion)
+    {
+        DebugTrace("WARNING: Compiled layout is version %u, expected %u\n", header->version, c_LayoutVersion);
+        return nullptr;
+    }
+
+    if ((header->recordOffset % sizeof(uint32_t)) != 0
+        || header->recordOffset > size
+        || uint64_t(header->recordCount) * sizeof(LayoutRecord) > size - header->recordOffset)
+        return nullptr;
+
+    if ((header->stringOffset % sizeof(uint16_t)) != 0
+        || header->stringOffset > size
+        || !header->stringCount
+        || uint64_t(header->stringCount) * sizeof(uint16_t) > size - header->stringOffset)
+        return nullptr;
+
+    auto strings = reinterpret_cast<const uint16_t*>(data + header->stringOffset);
+    if (strings[header->stringCount - 1] != 0)
+        return nullptr;
+
+    // Controls must follow a panel
+    bool havePanel = false;
+    auto records = reinterpret_cast<const LayoutRecord*>(data + header->recordOffset);
+    for (uint32_t j = 0; j < header->recordCount; ++j)
+    {
+        if (records[j].type >= LAYOUT_TYPE_COUNT
+            || records[j].text >= header->stringCount
+            || records[j].image >= header->stringCount)
+            return nullptr;
+
+        if (records[j].type <= LAYOUT_OVERLAY)
+            havePanel = true;
+        else if (!havePanel)
+            return nullptr;
+    }
+
+    return header;
+}
+
+
+_Use_decl_annotations_
+bool ATG::IsCompiledLayoutCurrent(const LayoutHeader& header, const wchar_t* layoutFile)
+{
+    uint64_t size = 0;
+    uint64_t writeTime = 0;
+    if (FAILED(GetLayoutSourceStamp(layoutFile, size, writeTime)))
+    {
+        // Titles can ship the compiled layout alone
+        return true;
+    }
+
+    if (size != header.sourceSize)
+        return false;
+
+    if (writeTime == header.sourceTime)
+        return true;
+
+#ifdef _DEBUG
+    DX::MappedFile source;
+    if (SUCCEEDED(source.Open(layoutFile, true))
+        && HashLayoutSource(source.GetData(), source.GetSize()) == header.sourceHash)
+    {
+        DebugTrace("INFO: Layout %ls was touched but not changed since it was compiled\n", layoutFile);
+        return true;
+    }
+#endif
+
+    return false;
+}
+
+
+_Use_decl_annotations_
+HRESULT ATG::GetLayoutSourceStamp(const wchar_t* fileName, uint64_t& size, uint64_t& writeTime)
+{
+    size = writeTime = 0;
+
+    if (!fileName)
+        return E_INVALIDARG;
+
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA info = {};
+    if (!GetFileAttributesExW(fileName, GetFileExInfoStandard, &info))
+        return HRESULT_FROM_WIN32(GetLastError());
+
+    size = (uint64_t(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+    writeTime = (uint64_t(info.ftLastWriteTime.dwHighDateTime) << 32) | info.ftLastWriteTime.dwLowDateTime;
+#else
+    size_t length = wcstombs(nullptr, fileName, 0);
+    if (length == static_cast<size_t>(-1))
+        return E_INVALIDARG;
+
+    std::string path(length, '\0');
+    wcstombs(&path[0], fileName, length);
+
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+        return E_FAIL;
+
+    size = static_cast<uint64_t>(info.st_size);
+    writeTime = static_cast<uint64_t>(info.st_mtim.tv_sec) * 1000000000ull + static_cast<uint64_t>(info.st_mtim.tv_nsec);
+#endif
+
+    return S_OK;
+}
+
+
+// FNV-1a
+_Use_decl_annotations_
+uint64_t ATG::HashLayoutSource(const uint8_t* data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t j = 0; j < size; ++j)
+    {
+        hash ^= data[j];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+
+_Use_decl_annotations_
+std::wstring ATG::ReplaceLayoutExtension(const wchar_t* layoutFile, const wchar_t* ext)
+{
+    std::wstring result(layoutFile);
+
+    size_t dot = result.find_last_of(L'.');
+    size_t slash = result.find_last_of(L"\\/");
+    if (dot != std::wstring::npos && (slash == std::wstring::npos || dot > slash))
+    {
+        result.erase(dot);
+    }
+
+    result += ext;
+    return result;
+}
+
+
+_Use_decl_annotations_
+bool ATG::IsCompiledLayoutName(const wchar_t* layoutFile)
+{
+    size_t len = wcslen(layoutFile);
+    size_t extLen = wcslen(c_CompiledLayoutExt);
+    return (len >= extLen) && (_wcsicmp(layoutFile + len - extLen, c_CompiledLayoutExt) == 0);
+}
@@ -0,0 +1,208 @@
+//--------------------------------------------------------------------------------------
+// File: SampleGUILayout.h
+//
+// Compiled UI layouts for the ATG Sample GUI
+//
+// A .csv layout is first parsed into a flat array of LayoutRecords that refer to an
+// interned string table, and UIManager then creates controls from those records. The same
+// records are what CompileLayoutFile writes to disk, so a compiled layout can be
+// memory-mapped and used directly without any parsing.
+//
+// Compiled layout file format:
+//   LayoutHeader
+//   LayoutRecord[recordCount]      at recordOffset
+//   uint16_t[stringCount]          at stringOffset, nul-terminated UTF-16 strings
+//
+// All references are offsets, so the data is relocatable. c_LayoutVersion must be
+// changed whenever LayoutHeader, LayoutRecord or the meaning of any of their values changes.
+//
+// Nothing here depends on Direct3D, so layouts can be compiled offline by
+// Tools/CompileUILayout and tested outside of Windows.
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//-------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <stdint.h>
+#include <wchar.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+
+namespace ATG
+{
+    const uint32_t c_LayoutMagic = 0x4C475441; // "ATGL"
+    const uint32_t c_LayoutVersion = 2;
+
+    const wchar_t* const c_CompiledLayoutExt = L".uilayout";
+
+    enum LayoutType : uint16_t
+    {
+        LAYOUT_POPUP = 0,
+        LAYOUT_HUD,
+        LAYOUT_OVERLAY,
+        LAYOUT_LABEL,
+        LAYOUT_LEGEND,
+        LAYOUT_IMAGE,
+        LAYOUT_BUTTON,
+        LAYOUT_IMAGEBUTTON,
+        LAYOUT_CHECKBOX,
+        LAYOUT_SLIDER,
+        LAYOUT_PROGRESSBAR,
+        LAYOUT_TEXTLIST,
+        LAYOUT_LISTBOX,
+        LAYOUT_TEXTBOX,
+        LAYOUT_TYPE_COUNT
+    };
+
+    const uint16_t c_LayoutFlagBorder = 0x1;
+    const uint16_t c_LayoutFlagNoFocusColor = 0x2;
+    const uint16_t c_LayoutFlagFocusOnText = 0x4;
+    const uint16_t c_LayoutFlagChecked = 0x8;
+
+    // Colors are resolved when controls are created, since they depend on the UIConfig.
+    // The top byte is the kind of color, and the rest is a UIConfig::COLORS value or BGR.
+    const uint32_t c_LayoutColorDefault = 0;
+    const uint32_t c_LayoutColorNamed = 0x01000000;
+    const uint32_t c_LayoutColorRGB = 0x02000000;
+    const uint32_t c_LayoutColorWhite = 0x03000000;
+
+    const uint32_t c_LayoutColorCount = 11;     // UIConfig::MAX_COLORS
+
+    // Style bits are stored as the controls' own c_Style values, which SampleGUI.cpp checks these against.
+    const uint32_t c_LayoutStylePanelCustom = 0x1;
+    const uint32_t c_LayoutStylePanelEmphasis = 0x2;
+    const uint32_t c_LayoutStylePanelSuppressCancel = 0x4;
+
+    const uint32_t c_LayoutStyleAlignLeft = 0;
+    const uint32_t c_LayoutStyleAlignCenter = 0x1;
+    const uint32_t c_LayoutStyleAlignRight = 0x2;
+    const uint32_t c_LayoutStyleAlignMiddle = 0x4;
+    const uint32_t c_LayoutStyleLabelTransparent = 0x10;
+    const uint32_t c_LayoutStyleLabelWordWrap = 0x20;
+
+    const uint32_t c_LayoutStyleExit = 0x1;
+    const uint32_t c_LayoutStyleDefault = 0x2;
+    const uint32_t c_LayoutStyleButtonTransparent = 0x4;
+    const uint32_t c_LayoutStyleImageButtonBackground = 0x4;
+    const uint32_t c_LayoutStyleImageButtonTransparent = 0x8;
+
+    const uint32_t c_LayoutStyleCheckBoxTransparent = 0x1;
+    const uint32_t c_LayoutStyleSliderTransparent = 0x1;
+
+    const uint32_t c_LayoutStyleListBoxMultiSelection = 0x1;
+    const uint32_t c_LayoutStyleListBoxTransparent = 0x2;
+    const uint32_t c_LayoutStyleListBoxScrollBar = 0x4;
+
+    const uint32_t c_LayoutStyleTextBoxTransparent = 0x1;
+    const uint32_t c_LayoutStyleTextBoxScrollBar = 0x2;
+    const uint32_t c_LayoutStyleTextBoxNoBackground = 0x4;
+
+    const uint32_t c_LayoutStyleFontSmall = 0x10000;
+    const uint32_t c_LayoutStyleFontLarge = 0x20000;
+    const uint32_t c_LayoutStyleFontBold = 0x40000;
+    const uint32_t c_LayoutStyleFontItalic = 0x80000;
+
+    // Hotkeys are virtual key codes; F1 to F10 are VK_F1 to VK_F10.
+    const uint32_t c_LayoutKeyF1 = 0x70;
+
+#pragma pack(push,4)
+    struct LayoutHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t recordCount;
+        uint32_t recordOffset;
+        uint32_t stringCount;
+        uint32_t stringOffset;
+        uint64_t sourceSize;        // Stamp of the .csv it was compiled from; see IsCompiledLayoutCurrent
+        uint64_t sourceTime;
+        uint64_t sourceHash;
+    };
+
+    struct LayoutRecord
+    {
+        uint16_t type;
+        uint16_t flags;
+        uint32_t id;
+        int32_t  rect[4];
+        uint32_t text;              // Offset into the string table
+        uint32_t image;             // Offset into the string table
+        uint32_t style;             // The control's c_Style bits
+        uint32_t hotkey;            // Virtual key code, or 0
+        int32_t  itemHeight;
+        uint32_t fgColor;
+        uint32_t bgColor;
+        uint32_t record;            // Record number in the .csv for error messages
+    };
+#pragma pack(pop)
+
+    static_assert(sizeof(LayoutHeader) == 48, "Layout header size mismatch");
+    static_assert(sizeof(LayoutRecord) == 56, "Layout record size mismatch");
+
+    class LayoutStrings
+    {
+    public:
+        LayoutStrings()
+        {
+            // Offset 0 is always the empty string
+            m_data.push_back(0);
+        }
+
+        uint32_t Intern(_In_z_ const wchar_t* str)
+        {
+            if (!*str)
+                return 0;
+
+            auto it = m_offsets.find(str);
+            if (it != m_offsets.end())
+                return it->second;
+
+            auto offset = static_cast<uint32_t>(m_data.size());
+            m_data.insert(m_data.end(), str, str + wcslen(str) + 1);
+            m_offsets[str] = offset;
+            return offset;
+        }
+
+        // UTF-16 code units, even where wchar_t is wider
+        const std::vector<wchar_t>& GetData() const { return m_data; }
+
+    private:
+        std::vector<wchar_t>            m_data;
+        std::map<std::wstring, uint32_t> m_offsets;
+    };
+
+    // Parses a .csv layout into records. Throws std::runtime_error if the layout is invalid.
+    void ParseLayout(_In_z_ const wchar_t* layoutFile, std::vector<LayoutRecord>& records, LayoutStrings& strings);
+
+    // Parses a .csv layout and writes it compiled. By default the output has the same name with a
+    // .uilayout extension. Throws std::runtime_error on failure.
+    void CompileLayoutFile(_In_z_ const wchar_t* layoutFile, _In_opt_z_ const wchar_t* compiledFile = nullptr);
+
+    // Checks a mapped compiled layout, and returns its header if it is usable.
+    const LayoutHeader* ValidateCompiledLayout(_In_reads_bytes_(size) const uint8_t* data, size_t size);
+
+    // Whether a compiled layout was built from the .csv as it is now. This compares the size and last
+    // write time stored when it was compiled, without reading the .csv, and a missing .csv is taken to
+    // be current. Debug builds also compare the FNV-1a hash of the contents when the write time alone
+    // differs, so a .csv that was only touched (say by a checkout) doesn't need recompiling.
+    bool IsCompiledLayoutCurrent(const LayoutHeader& header, _In_z_ const wchar_t* layoutFile);
+
+    // Size and last write time of a file, in the file system's own units.
+    HRESULT GetLayoutSourceStamp(_In_z_ const wchar_t* fileName, uint64_t& size, uint64_t& writeTime);
+
+    uint64_t HashLayoutSource(_In_reads_bytes_(size) const uint8_t* data, size_t size);
+
+    // Returns the layout file name with its extension replaced.
+    std::wstring ReplaceLayoutExtension(_In_z_ const wchar_t* layoutFile, _In_z_ const wchar_t* ext);
+
+    bool IsCompiledLayoutName(_In_z_ const wchar_t* layoutFile);
+}
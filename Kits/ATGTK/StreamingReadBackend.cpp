@@ -0,0 +1,142 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Read backends for WaveBankStreamer
+//
+#include "pch.h"
+#include "StreamingReadBackend.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <thread>
+
+
+namespace
+{
+
+//--------------------------------------------------------------------------------------
+// Worker thread backend
+class ThreadedReadBackend : public DX::IStreamingReadBackend
+{
+public:
+    ThreadedReadBackend( DX::StreamingReadFunction read, uint32_t sectorSize ) :
+        m_read( read ),
+        m_sectorSize( sectorSize ),
+        m_busy( false ),
+        m_shutdown( false )
+    {
+        m_thread = std::thread( &ThreadedReadBackend::WorkerThread, this );
+    }
+
+    ~ThreadedReadBackend()
+    {
+        {
+            std::lock_guard<std::mutex> lock( m_mutex );
+            m_shutdown = true;
+        }
+        m_wake.notify_all();
+        m_thread.join();
+    }
+
+    HRESULT Submit( DX::StreamingReadRequest* request ) override
+    {
+        if ( !request )
+            return E_INVALIDARG;
+
+        request->bytesRead = 0;
+        request->result = E_PENDING;
+
+        {
+            std::lock_guard<std::mutex> lock( m_mutex );
+            m_queue.push_back( request );
+        }
+        m_wake.notify_one();
+        return S_OK;
+    }
+
+    DX::StreamingReadRequest* GetCompleted() override
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        if ( m_completed.empty() )
+            return nullptr;
+
+        auto request = m_completed.front();
+        m_completed.pop_front();
+        return request;
+    }
+
+    void CancelAll() override
+    {
+        std::unique_lock<std::mutex> lock( m_mutex );
+        for( auto request : m_queue )
+        {
+            request->result = E_ABORT;
+            m_completed.push_back( request );
+        }
+        m_queue.clear();
+
+        m_idle.wait( lock, [this]() { return !m_busy; } );
+    }
+
+    uint32_t SectorSize() const override { return m_sectorSize; }
+
+private:
+    void WorkerThread()
+    {
+        std::unique_lock<std::mutex> lock( m_mutex );
+        for(;;)
+        {
+            m_wake.wait( lock, [this]() { return m_shutdown || !m_queue.empty(); } );
+            if ( m_shutdown )
+                break;
+
+            auto request = m_queue.front();
+            m_queue.pop_front();
+            m_busy = true;
+
+            lock.unlock();
+
+            uint32_t bytesRead = 0;
+            HRESULT hr = m_read( request->offset, request->dest, request->size, bytesRead );
+
+            lock.lock();
+
+            request->bytesRead = bytesRead;
+            request->result = hr;
+            m_completed.push_back( request );
+            m_busy = false;
+            m_idle.notify_all();
+        }
+    }
+
+    DX::StreamingReadFunction               m_read;
+    uint32_t                                m_sectorSize;
+
+    std::mutex                              m_mutex;
+    std::condition_variable                 m_wake;
+    std::condition_variable                 m_idle;
+    std::deque<DX::StreamingReadRequest*>   m_queue;
+    std::deque<DX::StreamingReadRequest*>   m_completed;
+    bool                                    m_busy;
+    bool                                    m_shutdown;
+    std::thread                             m_thread;
+};
+
+} // anonymous namespace
+
+
+_Use_decl_annotations_
+HRESULT DX::CreateThreadedReadBackend( StreamingReadFunction read, uint32_t sectorSize, std::unique_ptr<IStreamingReadBackend>& backend )
+{
+    backend.reset();
+
+    bool isPow2 = sectorSize && !( sectorSize & ( sectorSize - 1 ) );
+    if ( !read || !isPow2 )
+        return E_INVALIDARG;
+
+    backend.reset( new (std::nothrow) ThreadedReadBackend( read, sectorSize ) );
+    return ( backend ) ? S_OK : E_OUTOFMEMORY;
+}
@@ -0,0 +1,55 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Read backends for WaveBankStreamer
+//
+// A backend carries out sector-aligned reads for the streamer. The threaded backend declared here
+// is portable; the overlapped I/O backend for Windows is declared in WaveBankStreamer.h.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <functional>
+#include <memory>
+
+
+namespace DX
+{
+    // A read of 'size' bytes at 'offset' into 'dest'. Offset, size and dest are all multiples of the
+    // backend's sector size.
+    struct StreamingReadRequest
+    {
+        uint64_t    offset;
+        void*       dest;
+        uint32_t    size;
+        uint32_t    bytesRead;
+        HRESULT     result;
+    };
+
+    class IStreamingReadBackend
+    {
+    public:
+        virtual ~IStreamingReadBackend() {}
+
+        // Starts a read. The request must stay valid until it is returned by GetCompleted.
+        virtual HRESULT Submit( _Inout_ StreamingReadRequest* request ) = 0;
+
+        // Returns a finished read, or nullptr if none have finished. Never blocks.
+        virtual StreamingReadRequest* GetCompleted() = 0;
+
+        // Cancels what can be cancelled and waits for all submitted reads to finish. Finished reads
+        // are still returned by GetCompleted.
+        virtual void CancelAll() = 0;
+
+        // Required alignment of offsets, sizes and buffers.
+        virtual uint32_t SectorSize() const = 0;
+    };
+
+    // Portable backend where reads are done on a worker thread by a blocking read function, which returns
+    // the number of bytes read (which can be short at the end of the file).
+    typedef std::function<HRESULT( uint64_t offset, void* dest, uint32_t size, uint32_t& bytesRead )> StreamingReadFunction;
+
+    HRESULT CreateThreadedReadBackend( _In_ StreamingReadFunction read, _In_ uint32_t sectorSize, _Out_ std::unique_ptr<IStreamingReadBackend>& backend );
+}
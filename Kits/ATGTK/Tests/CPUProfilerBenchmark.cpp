@@ -0,0 +1,78 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Cost of a CPUProfileZone, the time a begin and end pair adds to the code it wraps, against the
+// 50 ns budget for zones that are left in shipping code paths. Each frame records fewer zones than
+// fit in the ring, so none are dropped.
+//
+// Usage: CPUProfilerBenchmark [frames]
+//
+
+#include "pch.h"
+#include "CPUProfiler.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace DX;
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    const uint32_t c_zonesPerFrame = CPUProfiler::c_eventsPerThread / 4;
+
+    volatile uint32_t g_sink = 0;
+
+    // Nanoseconds per iteration of a loop, with or without a zone in its body.
+    double Measure(uint32_t frames, bool zones)
+    {
+        auto& profiler = CPUProfiler::Get();
+
+        double best = 1e30;
+        for (uint32_t frame = 0; frame < frames; ++frame)
+        {
+            auto start = Clock::now();
+            for (uint32_t j = 0; j < c_zonesPerFrame; ++j)
+            {
+                if (zones)
+                {
+                    CPUProfileZone zone("Zone");
+                    g_sink = g_sink + 1;
+                }
+                else
+                {
+                    g_sink = g_sink + 1;
+                }
+            }
+            auto end = Clock::now();
+
+            // Collecting the frame is not part of the per-zone cost
+            profiler.EndFrame();
+
+            best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count() / c_zonesPerFrame);
+        }
+        return best;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t frames = (argc > 1) ? static_cast<uint32_t>(strtoul(argv[1], nullptr, 10)) : 200;
+
+    CPUProfiler::Get().EndFrame();
+
+    double baseline = Measure(frames, false);
+    double withZones = Measure(frames, true);
+    double perZone = withZones - baseline;
+
+    printf("%u frames of %u zones, best frame\n", frames, c_zonesPerFrame);
+    printf("%-24s %10.2f ns\n", "loop body", baseline);
+    printf("%-24s %10.2f ns\n", "loop body with a zone", withZones);
+    printf("%-24s %10.2f ns (budget 50 ns)\n", "zone overhead", perZone);
+    printf("%-24s %10llu\n", "dropped zones", static_cast<unsigned long long>(CPUProfiler::Get().GetDroppedZones()));
+
+    return 0;
+}
@@ -0,0 +1,203 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Tests for the hierarchical CPU profiler.
+//
+
+#include "pch.h"
+#include "CPUProfiler.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+using namespace DX;
+
+namespace
+{
+    int g_failures = 0;
+
+#define CHECK(condition) \
+    do { if (!(condition)) { ++g_failures; printf("%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #condition); } } while (0)
+
+    void Spin(double ms)
+    {
+        auto end = std::chrono::steady_clock::now() + std::chrono::duration<double, std::milli>(ms);
+        while (std::chrono::steady_clock::now() < end) {}
+    }
+
+    const CPUProfiler::ZoneStats* FindZone(const std::vector<CPUProfiler::ZoneStats>& stats, const char* threadName, const char* name)
+    {
+        for (auto& zone : stats)
+        {
+            if (strcmp(zone.threadName, threadName) == 0 && strcmp(zone.name, name) == 0)
+                return &zone;
+        }
+        return nullptr;
+    }
+
+    void TestNestedZones()
+    {
+        auto& profiler = CPUProfiler::Get();
+        CPUProfiler::SetThreadName("Main");
+
+        for (int frame = 0; frame < 4; ++frame)
+        {
+            CPUProfileZone outer("Outer");
+            for (int j = 0; j < 3; ++j)
+            {
+                CPUProfileZone inner("Inner");
+                Spin(1.0);
+            }
+        }
+        profiler.EndFrame();
+
+        std::vector<CPUProfiler::ZoneStats> stats;
+        profiler.GetZoneStats(stats);
+
+        auto outer = FindZone(stats, "Main", "Outer");
+        auto inner = FindZone(stats, "Main", "Inner");
+        CHECK(outer && inner);
+        if (outer && inner)
+        {
+            CHECK(outer->depth == 0 && inner->depth == 1);
+            CHECK(outer->calls == 4 && inner->calls == 12);
+            CHECK(inner->lastMS >= 11.0 && inner->lastMS < 100.0);
+            CHECK(outer->lastMS >= inner->lastMS);
+            CHECK(outer < inner);   // Parents are listed before their children
+        }
+
+        // A frame without the zones leaves their history alone.
+        profiler.EndFrame();
+        profiler.GetZoneStats(stats);
+        inner = FindZone(stats, "Main", "Inner");
+        CHECK(inner && inner->calls == 0 && inner->averageMS >= 11.0);
+    }
+
+    void TestThreads()
+    {
+        auto& profiler = CPUProfiler::Get();
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t)
+        {
+            threads.emplace_back([t]()
+            {
+                char name[16];
+                snprintf(name, sizeof(name), "Worker %d", t);
+                CPUProfiler::SetThreadName(name);
+                for (int j = 0; j < 1000; ++j)
+                {
+                    CPUProfileZone zone("Job");
+                }
+            });
+        }
+
+        // Collect while the workers are recording.
+        for (int j = 0; j < 10; ++j)
+        {
+            profiler.EndFrame();
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        profiler.EndFrame();
+
+        std::vector<CPUProfiler::ZoneStats> stats;
+        profiler.GetZoneStats(stats);
+
+        uint32_t threadsSeen = 0;
+        for (auto& zone : stats)
+        {
+            if (strcmp(zone.name, "Job") == 0)
+            {
+                CHECK(strncmp(zone.threadName, "Worker ", 7) == 0);
+                ++threadsSeen;
+            }
+        }
+        CHECK(threadsSeen == 4);
+    }
+
+    // Zones that don't fit in the ring are dropped without unbalancing the nesting of the rest.
+    void TestDroppedZones()
+    {
+        auto& profiler = CPUProfiler::Get();
+        profiler.EndFrame();
+        uint64_t dropped = profiler.GetDroppedZones();
+
+        std::thread([&profiler]()
+        {
+            CPUProfiler::SetThreadName("Flood");
+            CPUProfileZone outer("Flood");
+            for (uint32_t j = 0; j < CPUProfiler::c_eventsPerThread; ++j)
+            {
+                CPUProfileZone zone("Item");
+            }
+        }).join();
+
+        CHECK(profiler.GetDroppedZones() > dropped);
+
+        profiler.EndFrame();
+        std::vector<CPUProfiler::ZoneStats> stats;
+        profiler.GetZoneStats(stats);
+
+        auto outer = FindZone(stats, "Flood", "Flood");
+        auto item = FindZone(stats, "Flood", "Item");
+        CHECK(outer && outer->calls == 1);
+        CHECK(item && item->depth == 1 && item->calls > 0 && item->calls < CPUProfiler::c_eventsPerThread / 2);
+    }
+
+    void TestCapture()
+    {
+        auto& profiler = CPUProfiler::Get();
+
+        CHECK(profiler.EndCapture(L"CPUProfilerTests.json") == E_ILLEGAL_METHOD_CALL);
+
+        profiler.BeginCapture();
+        CHECK(profiler.IsCapturing());
+        {
+            CPUProfileZone zone("Captured \"zone\"");
+        }
+        profiler.EndFrame();
+        CHECK(SUCCEEDED(profiler.EndCapture(L"CPUProfilerTests.json")));
+        CHECK(!profiler.IsCapturing());
+
+        std::string json;
+        if (FILE* file = fopen("CPUProfilerTests.json", "rb"))
+        {
+            char buffer[4096];
+            size_t count;
+            while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+            {
+                json.append(buffer, count);
+            }
+            fclose(file);
+        }
+        remove("CPUProfilerTests.json");
+
+        CHECK(json.find("\"traceEvents\"") != std::string::npos);
+        CHECK(json.find("\"name\":\"Captured \\\"zone\\\"\",\"ph\":\"X\"") != std::string::npos);
+        CHECK(json.find("\"name\":\"Main\"") != std::string::npos);
+    }
+}
+
+int main()
+{
+    TestNestedZones();
+    TestThreads();
+    TestDroppedZones();
+    TestCapture();
+
+    if (g_failures != 0)
+    {
+        printf("%d check(s) failed\n", g_failures);
+        return 1;
+    }
+
+    printf("All CPUProfiler tests passed\n");
+    return 0;
+}
@@ -0,0 +1,462 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Read throughput of DX::CSVReader against the reader it replaced, which read the whole file, widened
+// it to wchar_t with MultiByteToWideChar and found the lines a character at a time. The old reader is
+// reproduced here with a portable UTF-8 decode in place of MultiByteToWideChar. Each reader opens and
+// indexes a generated file of about 100 MB, then reads every item, and both must find the same items;
+// the benchmark fails if they don't.
+//
+// The Makefile builds this file with SSE2 (CSVReaderBenchmark) and with AVX2 (CSVReaderAVX2Benchmark).
+//
+// A table of 1M rows is then indexed, and two of its columns extracted, on the calling thread and on
+// a JobSystem.
+//
+// Usage: CSVReaderBenchmark [megabytes]
+//
+
+#include "pch.h"
+#include "CSVReader.h"
+#include "JobSystem.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <unistd.h>
+
+using namespace DX;
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    // The reader before the file was mapped and scanned a vector at a time
+    class LegacyCSVReader
+    {
+    public:
+        explicit LegacyCSVReader(const char* path) :
+            m_end(nullptr),
+            m_currentChar(nullptr),
+            m_currentLine(0)
+        {
+            FILE* file = fopen(path, "rb");
+            if (!file)
+                throw std::runtime_error("fopen");
+
+            fseek(file, 0, SEEK_END);
+            size_t size = size_t(ftell(file));
+            fseek(file, 0, SEEK_SET);
+
+            std::unique_ptr<uint8_t[]> data(new uint8_t[size + 2]);
+            size_t out = fread(data.get(), 1, size, file);
+            fclose(file);
+            if (out != size)
+                throw std::runtime_error("fread");
+
+            data[out] = data[out + 1] = '\0';
+
+            // Stands in for MultiByteToWideChar(CP_UTF8, ...), counting and then converting
+            size_t cch = Widen(data.get(), out, nullptr) + 1;
+            m_data.reset(new wchar_t[cch]);
+            m_end = m_data.get() + Widen(data.get(), out, m_data.get());
+            *const_cast<wchar_t*>(m_end) = 0;
+
+            // Locate the start of lines
+            bool newline = true;
+            for (const wchar_t* ptr = m_data.get(); *ptr != 0 && ptr < m_end; )
+            {
+                if (*ptr == '\n' || *ptr == '\r')
+                {
+                    ++ptr;
+                    newline = true;
+                }
+                else if (*ptr == '"')
+                {
+                    if (newline)
+                    {
+                        m_lines.push_back(ptr);
+                        newline = false;
+                    }
+
+                    // Skip to next " (skipping "" escapes)
+                    for (ptr++; *ptr != 0 && ptr < m_end; ++ptr)
+                    {
+                        if (*ptr == '"')
+                        {
+                            ++ptr;
+                            if (*ptr != '"')
+                                break;
+                        }
+                    }
+                }
+                else if (newline)
+                {
+                    m_lines.push_back(ptr);
+                    newline = false;
+                    ++ptr;
+                }
+                else
+                    ++ptr;
+            }
+
+            m_currentChar = (m_lines.empty()) ? nullptr : m_lines[0];
+        }
+
+        size_t GetRecordCount() const { return m_lines.size(); }
+
+        bool NextRecord()
+        {
+            if (!m_currentChar)
+                return false;
+
+            if (++m_currentLine >= m_lines.size())
+            {
+                m_currentChar = nullptr;
+                return false;
+            }
+
+            m_currentChar = m_lines[m_currentLine];
+            return true;
+        }
+
+        bool NextItem(wchar_t* str, size_t maxstr)
+        {
+            if (!str || !m_currentChar || !maxstr)
+                return false;
+
+            *str = L'\0';
+
+            const wchar_t* end = ((m_currentLine + 1) >= m_lines.size()) ? m_end : (m_lines[(m_currentLine + 1)]);
+
+            if (m_currentChar >= end)
+                return false;
+
+            wchar_t* dest = str;
+            wchar_t* edest = str + maxstr;
+
+            for (const wchar_t* ptr = m_currentChar; ; )
+            {
+                if (*ptr == 0 || ptr >= end || *ptr == '\n' || *ptr == '\r')
+                {
+                    m_currentChar = end;
+                    break;
+                }
+                else if (*ptr == ',')
+                {
+                    m_currentChar = ptr + 1;
+                    break;
+                }
+                else if (*ptr == '\t' || *ptr == ' ')
+                {
+                    ++ptr;
+                }
+                else if (*ptr == '"')
+                {
+                    for (ptr++; *ptr != 0 && ptr < end; ++ptr)
+                    {
+                        if (*ptr == '"')
+                        {
+                            ++ptr;
+                            if (*ptr != '"')
+                                break;
+                            else if (dest < edest)
+                                *(dest++) = '"';
+                        }
+                        else if (dest < edest)
+                            *(dest++) = *ptr;
+                    }
+                }
+                else
+                {
+                    for (; *ptr != 0 && ptr < end; ++ptr)
+                    {
+                        if (*ptr == '\n' || *ptr == '\r' || *ptr == ',')
+                            break;
+                        else if (dest < edest)
+                            *(dest++) = *ptr;
+                    }
+                }
+            }
+
+            if (dest < edest)
+                *dest = 0;
+
+            return true;
+        }
+
+    private:
+        static size_t Widen(const uint8_t* src, size_t size, wchar_t* dest)
+        {
+            size_t count = 0;
+            for (const uint8_t* end = src + size; src < end; ++count)
+            {
+                uint32_t c = *src++;
+                if (c >= 0xC0)
+                {
+                    size_t extra = (c >= 0xF0) ? 3 : (c >= 0xE0) ? 2 : 1;
+                    c &= (extra == 3) ? 0x07 : (extra == 2) ? 0x0F : 0x1F;
+                    for (; extra && src < end; --extra)
+                        c = (c << 6) | (*src++ & 0x3F);
+                }
+                if (dest)
+                    dest[count] = static_cast<wchar_t>(c);
+            }
+            return count;
+        }
+
+        std::unique_ptr<wchar_t[]>  m_data;
+        const wchar_t*              m_end;
+        const wchar_t*              m_currentChar;
+        size_t                      m_currentLine;
+        std::vector<const wchar_t*> m_lines;
+    };
+
+    // A table of numbers, as exported from a spreadsheet
+    std::string NumericRecord(uint32_t record)
+    {
+        char buffer[256];
+        snprintf(buffer, sizeof(buffer), "%u,%d,%.3f,%.2f,%u,%d,%.4f,%u\r\n",
+            record, int(record * 7919u % 20001u) - 10000, record * 0.125, (record % 977) * 1.5,
+            record * 2654435761u, int(record % 256) - 128, (record % 10007) / 7.0, record % 3);
+        return buffer;
+    }
+
+    // Localized strings: plain, quoted with commas, escaped quotes and line breaks, and non-ASCII text
+    std::string TextRecord(uint32_t record)
+    {
+        static const char* s_words[] = { "Start", "Options", "Continue", "Quit game", "Load", "Save slot", "Achievements", "Credits" };
+        std::string id = "ID_STRING_" + std::to_string(record);
+        const char* word = s_words[record % _countof(s_words)];
+
+        switch (record % 4)
+        {
+        case 0:  return id + "," + word + ",en-US,Menu text\n";
+        case 1:  return id + ",\"" + word + ", then press A\",en-US,\"Shown after \"\"" + word + "\"\"\"\n";
+        case 2:  return id + ",\"" + word + "\nsecond line\",de-DE,Zweizeilig \xC3\xBC\xC3\xA4\n";
+        default: return id + "," + word + " \xE2\x86\x92 \xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E,ja-JP,\"Quoted, \xE6\x97\xA5\xE6\x9C\xAC\"\n";
+        }
+    }
+
+    // Writes whole records until the file is at least size bytes or has maxRecords records, and returns the size written
+    std::string WriteFile(size_t& size, std::string (*makeRecord)(uint32_t), uint32_t maxRecords = UINT32_MAX)
+    {
+        char path[] = "/tmp/CSVReaderBenchmarkXXXXXX";
+        int file = mkstemp(path);
+        if (file < 0)
+        {
+            printf("ERROR: can't create %s\n", path);
+            exit(1);
+        }
+
+        std::string block;
+        size_t written = 0;
+        for (uint32_t record = 0; written < size && record < maxRecords; ++record)
+        {
+            block += makeRecord(record);
+            if (block.size() >= 1024 * 1024 || written + block.size() >= size || record + 1 == maxRecords)
+            {
+                if (write(file, block.data(), block.size()) != static_cast<ssize_t>(block.size()))
+                {
+                    printf("ERROR: can't write %s\n", path);
+                    exit(1);
+                }
+                written += block.size();
+                block.clear();
+            }
+        }
+        close(file);
+        size = written;
+        return path;
+    }
+
+    struct Result
+    {
+        size_t  records;
+        size_t  items;
+        size_t  characters;
+    };
+
+    double GigabytesPerSecond(size_t size, Clock::time_point start)
+    {
+        return double(size) / (1024.0 * 1024.0 * 1024.0) / std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // Returns the rates of opening and indexing the file, and of also reading every item
+    void RunLegacy(const std::string& path, size_t size, Result& result, double& indexRate, double& readRate)
+    {
+        wchar_t item[1024];
+
+        auto start = Clock::now();
+        LegacyCSVReader reader(path.c_str());
+        indexRate = GigabytesPerSecond(size, start);
+
+        result = {};
+        result.records = reader.GetRecordCount();
+        do
+        {
+            while (reader.NextItem(item, _countof(item)))
+            {
+                ++result.items;
+                result.characters += wcslen(item);
+            }
+        } while (reader.NextRecord());
+        readRate = GigabytesPerSecond(size, start);
+    }
+
+    // With decode set, every item is copied out as UTF-16 as the old reader did; otherwise the items are read in place
+    void RunMapped(const std::string& path, size_t size, JobSystem* jobs, bool decode, Result& result, double& indexRate, double& readRate)
+    {
+        std::wstring name(path.begin(), path.end());
+        wchar_t buffer[1024];
+
+        auto start = Clock::now();
+        std::unique_ptr<CSVReader> reader(jobs
+            ? new CSVReader(name.c_str(), CSVReader::Encoding::UTF8, false, *jobs)
+            : new CSVReader(name.c_str(), CSVReader::Encoding::UTF8, false));
+        indexRate = GigabytesPerSecond(size, start);
+
+        result = {};
+        result.records = reader->GetRecordCount();
+        do
+        {
+            CSVReader::Item item;
+            while (reader->NextItem(item))
+            {
+                ++result.items;
+                result.characters += decode ? CSVReader::DecodeItem(item, buffer, _countof(buffer)) : item.length;
+            }
+        } while (reader->NextRecord());
+        readRate = GigabytesPerSecond(size, start);
+    }
+
+    void Run(const char* name, const std::string& path, size_t size, JobSystem& jobs)
+    {
+        printf("%s, %.0f MB\n", name, double(size) / (1024.0 * 1024.0));
+        printf("  %-30s %12s %12s\n", "reader", "index GB/s", "read GB/s");
+
+        Result legacy;
+        double indexRate;
+        double readRate;
+        RunLegacy(path, size, legacy, indexRate, readRate);
+        printf("  %-30s %12.2f %12.2f\n", "old (read, widen, scan)", indexRate, readRate);
+
+        struct Config
+        {
+            const char*     name;
+            JobSystem*      jobs;
+            bool            decode;
+        };
+        const Config configs[] =
+        {
+            { "mapped, 1 thread, UTF-16", nullptr, true },
+            { "mapped, 1 thread, in place", nullptr, false },
+            { "mapped, job system, in place", &jobs, false },
+        };
+
+        for (auto& config : configs)
+        {
+            Result result;
+            RunMapped(path, size, config.jobs, config.decode, result, indexRate, readRate);
+            printf("  %-30s %12.2f %12.2f\n", config.name, indexRate, readRate);
+
+            // Characters only match when both readers produce UTF-16, as the in-place items are UTF-8
+            if (result.records != legacy.records || result.items != legacy.items
+                || (config.decode && result.characters != legacy.characters))
+            {
+                printf("ERROR: the readers disagree (%zu/%zu records, %zu/%zu items, %zu/%zu characters)\n",
+                    result.records, legacy.records, result.items, legacy.items, result.characters, legacy.characters);
+                exit(1);
+            }
+        }
+    }
+
+    double Milliseconds(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    // Indexes a table of 1M rows and extracts an int and a float column, the values checked against each other
+    void RunMillionRows(JobSystem& jobs)
+    {
+        const uint32_t c_records = 1000000;
+
+        size_t size = SIZE_MAX;
+        std::string path = WriteFile(size, NumericRecord, c_records);
+        std::wstring name(path.begin(), path.end());
+
+        printf("1M rows, %.0f MB, job system workers: %u\n", double(size) / (1024.0 * 1024.0), jobs.GetWorkerCount());
+        printf("  %-30s %12s %12s %12s\n", "reader", "index ms", "int col ms", "float col ms");
+
+        std::vector<int32_t> serialInts;
+        std::vector<float> serialFloats;
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            auto start = Clock::now();
+            std::unique_ptr<CSVReader> reader(pass
+                ? new CSVReader(name.c_str(), CSVReader::Encoding::UTF8, false, jobs)
+                : new CSVReader(name.c_str(), CSVReader::Encoding::UTF8, false));
+            double index = Milliseconds(start);
+
+            std::vector<int32_t> ints;
+            start = Clock::now();
+            size_t intFailures = reader->GetColumn(1, ints);
+            double intColumn = Milliseconds(start);
+
+            std::vector<float> floats;
+            start = Clock::now();
+            size_t floatFailures = reader->GetColumn(2, floats);
+            double floatColumn = Milliseconds(start);
+
+            printf("  %-30s %12.1f %12.1f %12.1f\n", pass ? "mapped, job system" : "mapped, 1 thread", index, intColumn, floatColumn);
+
+            if (reader->GetRecordCount() != c_records || intFailures || floatFailures
+                || (pass && (ints != serialInts || floats != serialFloats)))
+            {
+                printf("ERROR: the 1M row table wasn't read the same way\n");
+                exit(1);
+            }
+            serialInts.swap(ints);
+            serialFloats.swap(floats);
+        }
+
+        unlink(path.c_str());
+    }
+}
+
+int main(int argc, char **argv)
+{
+#if defined(__AVX2__)
+    if (!__builtin_cpu_supports("avx2"))
+    {
+        printf("Skipped the AVX2 benchmark: the CPU doesn't support AVX2\n");
+        return 0;
+    }
+    printf("CSVReader scan: AVX2\n");
+#elif defined(_XM_NO_INTRINSICS_)
+    printf("CSVReader scan: scalar\n");
+#else
+    printf("CSVReader scan: SSE2\n");
+#endif
+
+    size_t megabytes = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 100;
+    megabytes = std::max<size_t>(1, megabytes);
+
+    JobSystem jobs;
+
+    size_t size = megabytes * 1024 * 1024;
+    std::string numeric = WriteFile(size, NumericRecord);
+    Run("Numeric table", numeric, size, jobs);
+    unlink(numeric.c_str());
+
+    size = megabytes * 1024 * 1024;
+    std::string text = WriteFile(size, TextRecord);
+    Run("Quoted text", text, size, jobs);
+    unlink(text.c_str());
+
+    RunMillionRows(jobs);
+
+    return 0;
+}
@@ -0,0 +1,608 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Tests for DX::CSVReader. The Makefile builds this file three times, once for each of the reader's
+// scans: CSVReaderTests uses SSE2, CSVReaderAVX2Tests uses AVX2, and CSVReaderScalarTests defines
+// _XM_NO_INTRINSICS_ for the scalar scan. Separators are placed at every offset around the 16 and 32
+// byte vector boundaries, UTF-16 files are converted, and a sparse file larger than 2 GB is read
+// through the mapping.
+//
+// Files indexed in parallel on a JobSystem, with quoted items spanning the chunks the file is split
+// into, must give the same records as the serial scan for every number of workers. GetColumn must
+// count each missing or malformed value and replace it with the default.
+//
+// Usage: CSVReaderTests
+//
+
+#include "pch.h"
+#include "CSVReader.h"
+#include "JobSystem.h"
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace DX;
+
+namespace
+{
+    int g_failures = 0;
+
+#define CHECK(condition) \
+    do { if (!(condition)) { ++g_failures; printf("%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #condition); } } while (0)
+
+    typedef std::vector<std::vector<std::string>> Table;
+
+    JobSystem::Settings TestSettings(uint32_t workers)
+    {
+        JobSystem::Settings settings;
+        settings.workerCount = workers;
+        settings.pinThreads = false;
+        settings.dequeSize = 64;
+        return settings;
+    }
+
+    // A file in /tmp which is removed when it goes out of scope
+    class TempFile
+    {
+    public:
+        explicit TempFile(const void* data, size_t size)
+        {
+            char path[] = "/tmp/CSVReaderTestsXXXXXX";
+            int file = mkstemp(path);
+            if (file < 0 || write(file, data, size) != static_cast<ssize_t>(size))
+            {
+                printf("ERROR: can't write %s\n", path);
+                exit(1);
+            }
+            close(file);
+            m_path = path;
+        }
+
+        explicit TempFile(const std::string& text) : TempFile(text.data(), text.size()) {}
+
+        TempFile(const TempFile&) = delete;
+        TempFile& operator=(const TempFile&) = delete;
+
+        ~TempFile() { unlink(m_path.c_str()); }
+
+        std::wstring Name() const { return std::wstring(m_path.begin(), m_path.end()); }
+
+    private:
+        std::string m_path;
+    };
+
+    std::string ItemText(const CSVReader::Item& item)
+    {
+        std::string text(item.text, item.length);
+        if (item.escaped)
+        {
+            for (size_t pos = text.find("\"\""); pos != std::string::npos; pos = text.find("\"\"", pos + 1))
+            {
+                text.erase(pos, 1);
+            }
+        }
+        return text;
+    }
+
+    // Every item of every record, read through the zero-copy items
+    Table ReadAll(CSVReader& reader)
+    {
+        Table table;
+        reader.TopOfFile();
+        for (bool more = !reader.EndOfFile(); more; more = reader.NextRecord())
+        {
+            table.emplace_back();
+            CSVReader::Item item;
+            while (reader.NextItem(item))
+            {
+                table.back().push_back(ItemText(item));
+            }
+        }
+        return table;
+    }
+
+    // Where every item of every record lies in the file, and whether it has escapes; cheaper to compare than ReadAll
+    std::vector<size_t> ItemOffsets(CSVReader& reader)
+    {
+        std::vector<size_t> offsets;
+        const char* base = nullptr;
+        reader.TopOfFile();
+        for (bool more = !reader.EndOfFile(); more; more = reader.NextRecord())
+        {
+            offsets.push_back(reader.RecordIndex());
+            CSVReader::Item item;
+            while (reader.NextItem(item))
+            {
+                base = base ? base : item.text;
+                offsets.push_back(size_t(item.text - base));
+                offsets.push_back(item.length * 2 + (item.escaped ? 1 : 0));
+            }
+        }
+        return offsets;
+    }
+
+    // Quotes a field which needs it, as a spreadsheet would
+    std::string Quote(const std::string& field)
+    {
+        std::string quoted = "\"";
+        for (char c : field)
+        {
+            quoted += c;
+            if (c == '"')
+                quoted += '"';
+        }
+        return quoted + "\"";
+    }
+
+    std::string Letters(size_t length, size_t seed)
+    {
+        std::string text;
+        for (size_t j = 0; j < length; ++j)
+        {
+            text += static_cast<char>('a' + (seed + j * 7) % 26);
+        }
+        return text;
+    }
+
+    // One record per offset, with the first separator (a comma, a newline or a CR) at that offset from the
+    // start of the record, so every lane of a 16 or 32 byte vector holds a separator in turn. The records
+    // are written one after another, so their starts also move through every alignment.
+    void TestSeparatorsAtVectorBoundaries()
+    {
+        const char* endings[] = { "\n", "\r\n", "\r" };
+        for (auto ending : endings)
+        {
+            std::string text;
+            Table expected;
+            for (size_t offset = 1; offset < 100; ++offset)
+            {
+                expected.push_back({ Letters(offset, offset), Letters(offset % 35, 3 * offset), "x" });
+                text += expected.back()[0] + "," + expected.back()[1] + "," + "x" + ending;
+
+                // A record which is one item, ending at the offset
+                expected.push_back({ Letters(offset, 5 * offset) });
+                text += expected.back()[0] + ending;
+            }
+
+            TempFile file(text);
+            CSVReader reader(file.Name().c_str(), CSVReader::Encoding::UTF8, false);
+            CHECK(reader.GetRecordCount() == expected.size());
+            CHECK(ReadAll(reader) == expected);
+        }
+
+        // The last record has no line ending, so the scan runs into the end of the file at every offset
+        for (size_t offset = 0; offset < 100; ++offset)
+        {
+            std::string last = Letters(offset, offset);
+            TempFile file("a,b\n" + last);
+            CSVReader reader(file.Name().c_str(), CSVReader::Encoding::UTF8, false);
+            Table expected = { { "a", "b" } };
+            if (offset)
+                expected.push_back({ last });
+            CHECK(ReadAll(reader) == expected);
+        }
+    }
+
+    // Quoted items whose closing quote, escaped quotes and embedded separators fall at every offset. Newlines
+    // inside quotes don't start records.
+    void TestQuotesAtVectorBoundaries()
+    {
+        std::string text;
+        Table expected;
+        for (size_t offset = 0; offset < 100; ++offset)
+        {
+            std::string field = Letters(offset, offset);
+            field.insert(offset / 2, (offset % 3 == 0) ? "\"" : (offset % 3 == 1) ? "," : "\n");
+
+            expected.push_back({ field, Letters(offset % 40, offset), field });
+            text += Quote(field) + "," + expected.back()[1] + "," + Quote(field) + ((offset & 1) ? "\r\n" : "\n");
+        }
+
+        TempFile file(text);
+        CSVReader reader(file.Name().c_str(), CSVReader::Encoding::UTF8, false);
+        CHECK(reader.GetRecordCount() == expected.size());
+        CHECK(ReadAll(reader) == expected);
+
+        // The decoded copy undoes the escapes too
+        reader.TopOfFile();
+        for (size_t record = 0; record < expected.size(); ++record, reader.NextRecord())
+        {
+            wchar_t item[256];
+            CHECK(reader.NextItem(item));
+            CHECK(std::wstring(item) == std::wstring(expected[record][0].begin(), expected[record][0].end()));
+        }
+    }
+
+    // Comments are skipped only at the start of a line, and whitespace before an item is dropped
+    void TestCommentsAndWhitespace()
+    {
+        TempFile file("# comment, with a comma\n  a,\tb\n#another\nc,#d\n");
+
+        CSVReader withComments(file.Name().c_str(), CSVReader::Encoding::UTF8, true);
+        Table expected = { { "a", "b" }, { "c", "#d" } };
+        CHECK(ReadAll(withComments) == expected);
+
+        CSVReader withoutComments(file.Name().c_str(), CSVReader::Encoding::UTF8, false);
+        CHECK(withoutComments.GetRecordCount() == 4);
+    }
+
+    void AppendUTF16(std::vector<uint16_t>& units, const std::string& ascii)
+    {
+        units.insert(units.end(), ascii.begin(), ascii.end());
+    }
+
+    // UTF-16 files are converted to UTF-8 for parsing: characters of every UTF-8 length, surrogate pairs, and
+    // unpaired surrogates (which become U+FFFD, as with WideCharToMultiByte).
+    void TestUTF16()
+    {
+        struct Field
+        {
+            std::vector<uint16_t> utf16;
+            std::string utf8;
+            std::vector<uint16_t> decoded;
+        };
+
+        const Field fields[] =
+        {
+            { { 'a', 'b', 'c' }, "abc", { 'a', 'b', 'c' } },
+            { { 0xE9, 0x20AC }, "\xC3\xA9\xE2\x82\xAC", { 0xE9, 0x20AC } },
+            { { 0x65E5, 0x672C }, "\xE6\x97\xA5\xE6\x9C\xAC", { 0x65E5, 0x672C } },
+            { { 0xD83D, 0xDE00, 'x' }, "\xF0\x9F\x98\x80x", { 0xD83D, 0xDE00, 'x' } },
+            { { 'y', 0xD83D }, "y\xEF\xBF\xBD", { 'y', 0xFFFD } },
+            { { 0xDE00, 'z' }, "\xEF\xBF\xBDz", { 0xFFFD, 'z' } },
+        };
+
+        // Large enough to be indexed in parallel once converted
+        const size_t records = 60000;
+
+        std::vector<uint16_t> units = { 0xFEFF };
+        for (size_t record = 0; record < records; ++record)
+        {
+            for (size_t j = 0; j < _countof(fields); ++j)
+            {
+                if (j)
+                    units.push_back(',');
+                units.insert(units.end(), fields[j].utf16.begin(), fields[j].utf16.end());
+            }
+            AppendUTF16(units, "," + std::to_string(record) + "\r\n");
+        }
+
+        TempFile file(units.data(), units.size() * sizeof(uint16_t));
+        JobSystem jobs(TestSettings(3));
+        CSVReader reader(file.Name().c_str(), CSVReader::Encoding::UTF16, false, jobs);
+        CHECK(reader.GetRecordCount() == records);
+
+        bool converted = true;
+        bool decoded = true;
+        for (size_t record = 0; record < records; ++record, reader.NextRecord())
+        {
+            for (auto& field : fields)
+            {
+                CSVReader::Item item;
+                converted = converted && reader.NextItem(item) && ItemText(item) == field.utf8;
+
+                // wchar_t is 32 bits here, but DecodeItem writes UTF-16 code units as it does on Windows
+                wchar_t buffer[16];
+                size_t length = CSVReader::DecodeItem(item, buffer, _countof(buffer));
+                decoded = decoded && length == field.decoded.size() && std::equal(field.decoded.begin(), field.decoded.end(), buffer);
+            }
+
+            CSVReader::Item item;
+            converted = converted && reader.NextItem(item) && ItemText(item) == std::to_string(record) && !reader.NextItem(item);
+        }
+        CHECK(converted);
+        CHECK(decoded);
+
+        std::vector<int32_t> numbers;
+        CHECK(reader.GetColumn(_countof(fields), numbers) == 0);
+        CHECK(numbers.size() == records && numbers.back() == int32_t(records - 1));
+
+        // An odd trailing byte is ignored, and an empty file has no records
+        std::vector<uint8_t> odd = { 'a', 0, ',', 0, 'b', 0, 'c' };
+        TempFile oddFile(odd.data(), odd.size());
+        CSVReader oddReader(oddFile.Name().c_str(), CSVReader::Encoding::UTF16, false);
+        Table expected = { { "a", "b" } };
+        CHECK(ReadAll(oddReader) == expected);
+
+        TempFile emptyFile{ std::string() };
+        CSVReader emptyReader(emptyFile.Name().c_str(), CSVReader::Encoding::UTF16, false);
+        CHECK(emptyReader.GetRecordCount() == 0 && emptyReader.EndOfFile());
+    }
+
+    // About 6 MB of records, most with quoted items holding separators, escaped quotes and line breaks. Every
+    // 1 MB or so one quoted item runs to 1.5 MB of lines, so the chunks the file is indexed in start inside
+    // quotes, and some lie wholly inside a single item. expected gets the records with comment lines kept,
+    // and expectedWithoutComments without them.
+    std::string QuoteHeavyFile(Table& expected, Table& expectedWithoutComments)
+    {
+        std::mt19937 random(7);
+        std::string text;
+        size_t nextLongItem = 700 * 1024;
+        while (text.size() < 6 * 1024 * 1024)
+        {
+            std::vector<std::string> record;
+            std::string line;
+
+            if (random() % 50 == 0)
+            {
+                line = "# comment " + Letters(random() % 30, random());
+                record.push_back(line);
+                expected.push_back(record);
+                text += line + "\n";
+                continue;
+            }
+
+            uint32_t items = 1 + random() % 6;
+            for (uint32_t j = 0; j < items; ++j)
+            {
+                std::string item;
+                bool quoted = random() % 3 != 0;
+                if (quoted && text.size() >= nextLongItem)
+                {
+                    for (size_t k = 0; item.size() < 1536 * 1024; ++k)
+                    {
+                        item += Letters(10 + k % 50, k) + ((k % 7 == 0) ? "\"\n" : (k % 3 == 0) ? ",\r\n" : "\n");
+                    }
+                    nextLongItem = text.size() + 1024 * 1024 + random() % (512 * 1024);
+                }
+                else if (quoted)
+                {
+                    const char* pieces[] = { "\n", "\r\n", "\"", ",", "\"\"", "#", " " };
+                    uint32_t count = random() % 6;
+                    for (uint32_t k = 0; k < count; ++k)
+                    {
+                        item += Letters(random() % 12, random()) + pieces[random() % _countof(pieces)];
+                    }
+                }
+                else
+                {
+                    item = Letters(random() % 20, random());
+                }
+
+                record.push_back(item);
+                line += (j ? "," : "") + (quoted ? Quote(item) : item);
+            }
+
+            // An unquoted empty record would be a blank line
+            if (line.empty())
+            {
+                line = Quote("");
+            }
+
+            expected.push_back(record);
+            expectedWithoutComments.push_back(record);
+            text += line + ((random() & 1) ? "\r\n" : "\n");
+        }
+        return text;
+    }
+
+    // The parallel index stitches chunks together, and indexes again any chunk which turns out to start inside
+    // quotes. It has to find exactly the records the serial scan does, however many chunks the file is split into.
+    void TestParallelIndexMatchesSerial()
+    {
+        Table expected;
+        Table expectedWithoutComments;
+        TempFile file(QuoteHeavyFile(expected, expectedWithoutComments));
+
+        CSVReader serial(file.Name().c_str(), CSVReader::Encoding::UTF8, false);
+        CHECK(serial.GetRecordCount() == expected.size());
+        CHECK(ReadAll(serial) == expected);
+
+        CSVReader serialWithoutComments(file.Name().c_str(), CSVReader::Encoding::UTF8, true);
+        CHECK(ReadAll(serialWithoutComments) == expectedWithoutComments);
+
+        auto serialOffsets = ItemOffsets(serial);
+        auto serialOffsetsWithoutComments = ItemOffsets(serialWithoutComments);
+
+        const uint32_t workerCounts[] = { 0, 1, 2, 3, 4, 5, 7, 11 };
+        for (auto workers : workerCounts)
+        {
+            JobSystem jobs(TestSettings(workers));
+
+            CSVReader parallel(file.Name().c_str(), CSVReader::Encoding::UTF8, false, jobs);
+            CHECK(parallel.GetRecordCount() == expected.size());
+            CHECK(ItemOffsets(parallel) == serialOffsets);
+
+            CSVReader parallelWithoutComments(file.Name().c_str(), CSVReader::Encoding::UTF8, true, jobs);
+            CHECK(ItemOffsets(parallelWithoutComments) == serialOffsetsWithoutComments);
+        }
+
+        // A file which ends inside an unclosed quote
+        TempFile unclosed("a,b\n" + std::string(3 * 1024 * 1024, 'x') + "\n\"c\n" + std::string(2 * 1024 * 1024, 'y') + "\n");
+        CSVReader unclosedSerial(unclosed.Name().c_str(), CSVReader::Encoding::UTF8, false);
+        for (auto workers : workerCounts)
+        {
+            JobSystem jobs(TestSettings(workers));
+            CSVReader unclosedParallel(unclosed.Name().c_str(), CSVReader::Encoding::UTF8, false, jobs);
+            CHECK(unclosedParallel.GetRecordCount() == 3);
+            CHECK(ReadAll(unclosedParallel) == ReadAll(unclosedSerial));
+        }
+    }
+
+    // Column 1 of each record, and what GetColumn makes of it
+    struct ColumnCase
+    {
+        const char* record;
+        bool        intValid;
+        int32_t     intValue;
+        bool        floatValid;
+        float       floatValue;
+    };
+
+    const ColumnCase c_columnCases[] =
+    {
+        { "a,42",                       true,  42,         true,  42.f },
+        { "a,  -7  ",                   true,  -7,         true,  -7.f },
+        { "a,+5",                       true,  5,          true,  5.f },
+        { "a,\"17\"",                   true,  17,         true,  17.f },
+        { "a,2147483647",               true,  INT32_MAX,  true,  2147483647.f },
+        { "a,-2147483648",              true,  INT32_MIN,  true,  -2147483648.f },
+        { "a,2147483648",               false, 0,          true,  2147483648.f },
+        { "a,99999999999999999999",     false, 0,          true,  1e20f },
+        { "a,3.5",                      false, 0,          true,  3.5f },
+        { "a,.25",                      false, 0,          true,  0.25f },
+        { "a,1e3",                      false, 0,          true,  1000.f },
+        { "a,",                         false, 0,          false, 0.f },
+        { "a",                          false, 0,          false, 0.f },
+        { "a,12abc",                    false, 0,          false, 0.f },
+        { "a,-",                        false, 0,          false, 0.f },
+        { "a,abc",                      false, 0,          false, 0.f },
+        { "a,1 2",                      false, 0,          false, 0.f },
+        { "a,\"\",9",                   false, 0,          false, 0.f },
+    };
+
+    // Missing and malformed values are replaced by the default and counted, the same way whether the column is
+    // extracted on the calling thread or, for a large table, in parallel.
+    void TestGetColumnDefaults()
+    {
+        // Enough records for the column to be extracted in parallel
+        const size_t repeats = 4000;
+        const size_t cases = _countof(c_columnCases);
+
+        std::string text;
+        size_t intFailures = 0;
+        size_t floatFailures = 0;
+        for (size_t repeat = 0; repeat < repeats; ++repeat)
+        {
+            for (auto& c : c_columnCases)
+            {
+                text += std::string(c.record) + "\n";
+                intFailures += c.intValid ? 0 : 1;
+                floatFailures += c.floatValid ? 0 : 1;
+            }
+        }
+        TempFile file(text);
+
+        const uint32_t workerCounts[] = { 0, 3, 7 };
+        for (size_t run = 0; run <= _countof(workerCounts); ++run)
+        {
+            std::unique_ptr<JobSystem> jobs;
+            std::unique_ptr<CSVReader> reader;
+            if (run == 0)
+            {
+                reader.reset(new CSVReader(file.Name().c_str()));
+            }
+            else
+            {
+                jobs.reset(new JobSystem(TestSettings(workerCounts[run - 1])));
+                reader.reset(new CSVReader(file.Name().c_str(), CSVReader::Encoding::UTF8, false, *jobs));
+            }
+            CHECK(reader->GetRecordCount() == repeats * cases);
+
+            std::vector<int32_t> ints;
+            CHECK(reader->GetColumn(1, ints, -1) == intFailures);
+
+            std::vector<float> floats;
+            CHECK(reader->GetColumn(1, floats, -1.f) == floatFailures);
+
+            bool matched = ints.size() == repeats * cases && floats.size() == repeats * cases;
+            for (size_t record = 0; matched && record < ints.size(); ++record)
+            {
+                auto& c = c_columnCases[record % cases];
+                matched = ints[record] == (c.intValid ? c.intValue : -1)
+                    && floats[record] == (c.floatValid ? c.floatValue : -1.f);
+            }
+            CHECK(matched);
+
+            // Only the missing item is a failure for strings; an empty one is returned as it is
+            std::vector<CSVReader::Item> items;
+            CHECK(reader->GetColumn(1, items) == repeats);
+            CHECK(items.size() == repeats * cases && items[11].length == 0 && items[12].length == 0 && ItemText(items[3]) == "17");
+
+            // A column past the end of every record is a failure for every record
+            CHECK(reader->GetColumn(2, ints, 5) == repeats * (cases - 1));
+            CHECK(ints[0] == 5 && ints[cases - 1] == 9);
+        }
+    }
+
+    // A sparse file just over 2 GB is mapped rather than read, so the holes cost neither disk nor memory. The
+    // record after the 2 GB mark is found and read, and the gap between reads as a single record of NULs.
+    void TestLargerThan2GB()
+    {
+#if defined(__SANITIZE_THREAD__)
+        // ThreadSanitizer keeps several bytes of shadow for every byte read, more than the machine has for 2 GB
+        printf("Skipped the 2 GB test under ThreadSanitizer\n");
+        return;
+#endif
+        const off_t c_lastRecord = off_t(0x80000000) + 4099;
+        const std::string first = "first,1\n";
+        const std::string last = "\nbeyond,3\n";
+
+        char path[] = "/tmp/CSVReaderTestsXXXXXX";
+        int file = mkstemp(path);
+        bool written = file >= 0
+            && ftruncate(file, c_lastRecord + off_t(last.size())) == 0
+            && pwrite(file, first.data(), first.size(), 0) == static_cast<ssize_t>(first.size())
+            && pwrite(file, last.data(), last.size(), c_lastRecord) == static_cast<ssize_t>(last.size());
+        if (file >= 0)
+            close(file);
+        if (!written)
+        {
+            printf("Skipped the 2 GB test: can't write a sparse file in /tmp\n");
+            unlink(path);
+            return;
+        }
+
+        std::string name = path;
+        {
+            JobSystem jobs(TestSettings(1));
+            CSVReader reader(std::wstring(name.begin(), name.end()).c_str(), CSVReader::Encoding::UTF8, false, jobs);
+            CHECK(reader.GetRecordCount() == 3);
+
+            CSVReader::Item item;
+            CHECK(reader.NextItem(item) && ItemText(item) == "first");
+
+            CHECK(reader.NextRecord());
+            CHECK(reader.NextItem(item) && item.length == size_t(c_lastRecord) - first.size() && item.text[0] == '\0');
+            CHECK(!reader.NextItem(item));
+
+            CHECK(reader.NextRecord());
+            CHECK(reader.NextItem(item) && ItemText(item) == "beyond");
+            CHECK(reader.NextItem(item) && ItemText(item) == "3");
+            CHECK(!reader.NextRecord());
+
+            std::vector<int32_t> values;
+            CHECK(reader.GetColumn(1, values, -1) == 1);
+            CHECK(values == std::vector<int32_t>({ 1, -1, 3 }));
+        }
+        unlink(path);
+    }
+}
+
+int main()
+{
+#if defined(__AVX2__)
+    if (!__builtin_cpu_supports("avx2"))
+    {
+        printf("Skipped the CSVReader AVX2 tests: the CPU doesn't support AVX2\n");
+        return 0;
+    }
+    const char* scan = "AVX2";
+#elif defined(_XM_NO_INTRINSICS_)
+    const char* scan = "scalar";
+#else
+    const char* scan = "SSE2";
+#endif
+
+    TestSeparatorsAtVectorBoundaries();
+    TestQuotesAtVectorBoundaries();
+    TestCommentsAndWhitespace();
+    TestUTF16();
+    TestParallelIndexMatchesSerial();
+    TestGetColumnDefaults();
+    TestLargerThan2GB();
+
+    if (g_failures != 0)
+    {
+        printf("%d check(s) failed\n", g_failures);
+        return 1;
+    }
+
+    printf("All CSVReader tests passed (%s)\n", scan);
+    return 0;
+}
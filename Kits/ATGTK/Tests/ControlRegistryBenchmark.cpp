@@ -0,0 +1,227 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Per-frame cost of the Sample GUI's control bookkeeping with thousands of controls, headless. Each frame a
+// few controls have their text changed, one control has focus and one animates, and then the controls are
+// updated, in two ways:
+//
+//   every control   the changed controls are found with FindControl, which searched their panel and used
+//                   dynamic_cast, and every control of every panel is updated
+//   active controls the changed controls are resolved from handles found once, and the registry's update
+//                   pass visits only the controls that are dirty, focused or animating
+//
+// The controls stand in for IControl, with a virtual per-frame update that places their text when it is
+// dirty. Both ways must place text for the same controls; the benchmark fails if they don't.
+//
+// Usage: ControlRegistryBenchmark [frames]
+//
+
+#include "pch.h"
+#include "ControlRegistry.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <vector>
+
+using namespace ATG;
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    size_t g_placed = 0;
+
+    class Control
+    {
+    public:
+        explicit Control(unsigned id) : m_id(id), m_dirty(true), m_textX(0.f), m_textY(0.f) {}
+        virtual ~Control() {}
+
+        virtual void Update(float elapsedTime)
+        {
+            if (m_dirty)
+            {
+                // Stands in for measuring and aligning the text
+                m_textX = std::sqrt(float(m_id) + elapsedTime);
+                m_textY = m_textX * 0.5f;
+                m_dirty = false;
+                ++g_placed;
+            }
+        }
+
+        unsigned GetId() const { return m_id; }
+        void Invalidate() { m_dirty = true; }
+
+    private:
+        unsigned    m_id;
+        bool        m_dirty;
+        float       m_textX;
+        float       m_textY;
+    };
+
+    class Label : public Control
+    {
+    public:
+        explicit Label(unsigned id) : Control(id) {}
+    };
+
+    class Button : public Control
+    {
+    public:
+        explicit Button(unsigned id) : Control(id) {}
+    };
+
+    class Panel
+    {
+    public:
+        void Add(Control* ctrl) { m_controls.emplace_back(ctrl); }
+
+        Control* Find(unsigned id)
+        {
+            for (auto& it : m_controls)
+            {
+                if (it->GetId() == id)
+                    return it.get();
+            }
+            return nullptr;
+        }
+
+        std::vector<std::unique_ptr<Control>> m_controls;
+    };
+
+    typedef ControlRegistry<Control, Panel> Registry;
+
+    struct Frame
+    {
+        unsigned panel;
+        unsigned ctrl;
+    };
+
+    // The controls a frame touches: its text changes, so it is dirty
+    std::vector<Frame> MakeTouches(unsigned panels, unsigned controlsPerPanel, int frames, int perFrame)
+    {
+        std::vector<Frame> touches;
+        uint32_t seed = 12345;
+        for (int j = 0; j < frames * perFrame; ++j)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            Frame touch = { (seed >> 8) % panels, (seed >> 20) % controlsPerPanel };
+            touches.push_back(touch);
+        }
+        return touches;
+    }
+
+    void Run(unsigned panels, unsigned controlsPerPanel, int frames)
+    {
+        const int c_TouchesPerFrame = 4;
+        const float c_ElapsedTime = 1.f / 60.f;
+
+        std::map<unsigned, std::unique_ptr<Panel>> map;
+        Registry registry;
+
+        for (unsigned p = 0; p < panels; ++p)
+        {
+            auto panel = new Panel;
+            map[p].reset(panel);
+            registry.AddPanel(p, panel);
+
+            for (unsigned c = 0; c < controlsPerPanel; ++c)
+            {
+                Control* ctrl = (c % 2) ? static_cast<Control*>(new Button(c)) : new Label(c);
+                panel->Add(ctrl);
+                registry.AddControl(panel, ctrl, c);
+            }
+        }
+
+        auto touches = MakeTouches(panels, controlsPerPanel, frames, c_TouchesPerFrame);
+
+        // Handles are found once, as a sample would on load
+        std::vector<uint32_t> handles;
+        for (auto& touch : touches)
+        {
+            handles.push_back(registry.Find(touch.panel, touch.ctrl));
+        }
+
+        uint32_t focus = registry.Find(0, 1);
+        uint32_t animating = registry.Find(panels - 1, controlsPerPanel - 1);
+        registry.SetState(focus, Registry::c_StateFocused, true);
+        registry.SetState(animating, Registry::c_StateAnimating, true);
+
+        // Place everything once, so both loops start from the same state
+        registry.UpdateActive([&](Control* ctrl, uint32_t) { ctrl->Update(c_ElapsedTime); });
+
+        size_t placed[2] = {};
+
+        // Every control of every panel, found by search
+        g_placed = 0;
+        auto start = Clock::now();
+        for (int frame = 0; frame < frames; ++frame)
+        {
+            for (int j = 0; j < c_TouchesPerFrame; ++j)
+            {
+                auto& touch = touches[size_t(frame * c_TouchesPerFrame + j)];
+                Control* found = map.find(touch.panel)->second->Find(touch.ctrl);
+                Control* ctrl = (touch.ctrl % 2) ? static_cast<Control*>(dynamic_cast<Button*>(found)) : dynamic_cast<Label*>(found);
+                ctrl->Invalidate();
+            }
+
+            for (auto& panel : map)
+            {
+                for (auto& ctrl : panel.second->m_controls)
+                {
+                    ctrl->Update(c_ElapsedTime);
+                }
+            }
+        }
+        double fullTime = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / frames;
+        placed[0] = g_placed;
+
+        // Only the active controls, found by handle
+        size_t visited = 0;
+        g_placed = 0;
+        start = Clock::now();
+        for (int frame = 0; frame < frames; ++frame)
+        {
+            for (int j = 0; j < c_TouchesPerFrame; ++j)
+            {
+                uint32_t handle = handles[size_t(frame * c_TouchesPerFrame + j)];
+                registry.Get(handle)->Invalidate();
+                registry.SetState(handle, Registry::c_StateDirty, true);
+            }
+
+            visited += registry.GetActiveCount();
+            registry.UpdateActive([&](Control* ctrl, uint32_t) { ctrl->Update(c_ElapsedTime); });
+        }
+        double activeTime = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / frames;
+        placed[1] = g_placed;
+
+        if (placed[0] != placed[1] || placed[0] == 0)
+        {
+            printf("ERROR: the passes placed text differently\n");
+            exit(1);
+        }
+
+        printf("%6u controls in %4u panels: every control %8.2f us/frame, active controls %6.2f us/frame (%.1f per frame), %5.1fx\n",
+            panels * controlsPerPanel, panels, fullTime, activeTime, double(visited) / frames, fullTime / activeTime);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int frames = (argc > 1) ? atoi(argv[1]) : 2000;
+    if (frames <= 0)
+    {
+        printf("Usage: ControlRegistryBenchmark [frames]\n");
+        return 1;
+    }
+
+    Run(16, 64, frames);
+    Run(64, 64, frames);
+    Run(256, 64, frames);
+    return 0;
+}
@@ -0,0 +1,252 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Tests for the Sample GUI's control registry: handles, lookup by id, and which controls the update pass visits.
+//
+
+#include "pch.h"
+#include "ControlRegistry.h"
+
+#include <cstdio>
+#include <vector>
+
+using namespace ATG;
+
+namespace
+{
+    int g_failures = 0;
+
+#define CHECK(condition) \
+    do { if (!(condition)) { ++g_failures; printf("%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #condition); } } while (0)
+
+    struct Control
+    {
+        explicit Control(unsigned id) : id(id), updates(0) {}
+
+        unsigned    id;
+        int         updates;
+    };
+
+    struct Panel
+    {
+    };
+
+    typedef ControlRegistry<Control, Panel> Registry;
+
+    // Runs an update pass, and returns the ids of the controls it visited
+    std::vector<unsigned> UpdatePass(Registry& registry)
+    {
+        std::vector<unsigned> ids;
+        registry.UpdateActive([&](Control* ctrl, uint32_t)
+        {
+            ++ctrl->updates;
+            ids.push_back(ctrl->id);
+        });
+        return ids;
+    }
+
+    void TestFind()
+    {
+        Registry registry;
+        Panel first, second;
+        Control a(1), b(2), c(1), d(1);
+
+        CHECK(registry.AddControl(&first, &a, a.id) == Registry::c_Invalid);
+        CHECK(registry.GetSlotCount() == 0);
+
+        registry.AddPanel(10, &first);
+        registry.AddPanel(20, &second);
+        CHECK(registry.HasPanel(&first));
+
+        uint32_t slotA = registry.AddControl(&first, &a, a.id);
+        uint32_t slotB = registry.AddControl(&first, &b, b.id);
+        uint32_t slotC = registry.AddControl(&second, &c, c.id);
+        uint32_t slotD = registry.AddControl(&first, &d, d.id);
+
+        CHECK(slotA == 0 && slotB == 1 && slotC == 2 && slotD == 3);
+        CHECK(registry.Get(slotB) == &b);
+        CHECK(registry.Get(Registry::c_Invalid) == nullptr);
+
+        CHECK(registry.Find(10, 1) == slotA);
+        CHECK(registry.Find(10, 2) == slotB);
+        CHECK(registry.Find(20, 1) == slotC);
+        CHECK(registry.Find(20, 2) == Registry::c_Invalid);
+        CHECK(registry.Find(30, 1) == Registry::c_Invalid);
+
+        // Repeated ids find the first control, as IPanel::Find does
+        CHECK(registry.Find(10, 1) != slotD);
+    }
+
+    void TestRemovePanel()
+    {
+        Registry registry;
+        Panel first, second;
+        Control a(1), b(2), c(3);
+
+        registry.AddPanel(10, &first);
+        registry.AddPanel(20, &second);
+        uint32_t slotA = registry.AddControl(&first, &a, a.id);
+        uint32_t slotB = registry.AddControl(&second, &b, b.id);
+
+        registry.RemovePanel(&first);
+        CHECK(!registry.HasPanel(&first));
+        CHECK(registry.Get(slotA) == nullptr);
+        CHECK(registry.Find(10, 1) == Registry::c_Invalid);
+        CHECK(registry.Get(slotB) == &b);
+        CHECK(registry.AddControl(&first, &c, c.id) == Registry::c_Invalid);
+
+        // Slots aren't reused, so old handles stay invalid
+        registry.AddPanel(10, &first);
+        uint32_t slotC = registry.AddControl(&first, &c, c.id);
+        CHECK(slotC != slotA);
+        CHECK(registry.Get(slotA) == nullptr);
+        CHECK(registry.Find(10, 3) == slotC);
+
+        // Removed controls are dropped from the update pass
+        CHECK(UpdatePass(registry) == std::vector<unsigned>({ 2, 3 }));
+        CHECK(a.updates == 0);
+
+        registry.RemovePanel(&second);
+        registry.SetState(slotB, Registry::c_StateFocused, true);
+        CHECK(registry.GetState(slotB) == 0);
+        CHECK(UpdatePass(registry).empty());
+        CHECK(registry.GetActiveCount() == 0);
+    }
+
+    void TestSetControlId()
+    {
+        Registry registry;
+        Panel panel;
+        Control a(1), b(1);
+
+        registry.AddPanel(10, &panel);
+        uint32_t slotA = registry.AddControl(&panel, &a, a.id);
+        uint32_t slotB = registry.AddControl(&panel, &b, b.id);
+        CHECK(registry.Find(10, 1) == slotA);
+
+        // The other control with the old id can now be found by it
+        registry.SetControlId(slotA, 5);
+        CHECK(registry.Find(10, 5) == slotA);
+        CHECK(registry.Find(10, 1) == slotB);
+
+        // The first control added is still the one found
+        registry.SetControlId(slotA, 1);
+        CHECK(registry.Find(10, 1) == slotA);
+        CHECK(registry.Find(10, 5) == Registry::c_Invalid);
+
+        registry.SetControlId(slotB, 7);
+        CHECK(registry.Find(10, 7) == slotB);
+        CHECK(registry.Find(10, 1) == slotA);
+
+        registry.SetControlId(Registry::c_Invalid, 7);
+        CHECK(registry.Find(10, 7) == slotB);
+    }
+
+    void TestUpdatePass()
+    {
+        Registry registry;
+        Panel panel;
+        std::vector<Control> controls;
+        for (unsigned id = 0; id < 100; ++id)
+        {
+            controls.emplace_back(id);
+        }
+
+        registry.AddPanel(10, &panel);
+        for (auto& ctrl : controls)
+        {
+            registry.AddControl(&panel, &ctrl, ctrl.id);
+        }
+
+        // New controls are dirty, so each is updated once
+        CHECK(registry.GetActiveCount() == 100);
+        CHECK(UpdatePass(registry).size() == 100);
+        CHECK(registry.GetActiveCount() == 0);
+        CHECK(UpdatePass(registry).empty());
+
+        // Dirty controls are updated once, focused and animating ones until that is cleared
+        registry.SetState(3, Registry::c_StateDirty, true);
+        registry.SetState(3, Registry::c_StateDirty, true);
+        registry.SetState(7, Registry::c_StateFocused, true);
+        registry.SetState(9, Registry::c_StateAnimating, true);
+        CHECK(registry.GetActiveCount() == 3);
+
+        CHECK(UpdatePass(registry) == std::vector<unsigned>({ 3, 7, 9 }));
+        CHECK(registry.GetState(3) == 0);
+        CHECK(registry.GetState(7) == Registry::c_StateFocused);
+        CHECK(UpdatePass(registry) == std::vector<unsigned>({ 7, 9 }));
+
+        registry.SetState(7, Registry::c_StateFocused, false);
+        registry.SetState(7, Registry::c_StateFocused, true);
+        registry.SetState(7, Registry::c_StateDirty, true);
+        CHECK(registry.GetActiveCount() == 2);
+
+        uint32_t seen = 0;
+        registry.UpdateActive([&](Control* ctrl, uint32_t state)
+        {
+            if (ctrl->id == 7)
+            {
+                seen = state;
+            }
+        });
+        CHECK(seen == (Registry::c_StateFocused | Registry::c_StateDirty));
+
+        registry.SetState(7, Registry::c_StateFocused, false);
+        registry.SetState(9, Registry::c_StateAnimating, false);
+        CHECK(UpdatePass(registry).empty());
+        CHECK(registry.GetActiveCount() == 0);
+
+        CHECK(controls[3].updates == 2);
+        CHECK(controls[7].updates == 3);
+        CHECK(controls[9].updates == 3);
+        CHECK(controls[50].updates == 1);
+    }
+
+    void TestStateChangesDuringPass()
+    {
+        Registry registry;
+        Panel panel;
+        Control a(1), b(2);
+
+        registry.AddPanel(10, &panel);
+        uint32_t slotA = registry.AddControl(&panel, &a, a.id);
+        uint32_t slotB = registry.AddControl(&panel, &b, b.id);
+        UpdatePass(registry);
+
+        // A control that invalidates itself while it is updated is updated again in the next pass, not this one
+        registry.SetState(slotA, Registry::c_StateDirty, true);
+        int calls = 0;
+        registry.UpdateActive([&](Control* ctrl, uint32_t)
+        {
+            ++calls;
+            registry.SetState(slotA, Registry::c_StateDirty, true);
+            if (ctrl == &a)
+            {
+                registry.SetState(slotB, Registry::c_StateDirty, true);
+            }
+        });
+        CHECK(calls == 1);
+        CHECK(registry.GetState(slotA) == Registry::c_StateDirty);
+        CHECK(UpdatePass(registry) == std::vector<unsigned>({ 1, 2 }));
+        CHECK(UpdatePass(registry).empty());
+    }
+}
+
+int main()
+{
+    TestFind();
+    TestRemovePanel();
+    TestSetControlId();
+    TestUpdatePass();
+    TestStateChangesDuringPass();
+
+    if (g_failures != 0)
+    {
+        printf("%d check(s) failed\n", g_failures);
+        return 1;
+    }
+
+    printf("All ControlRegistry tests passed\n");
+    return 0;
+}
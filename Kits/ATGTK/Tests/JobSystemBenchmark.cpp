@@ -0,0 +1,121 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Scaling of DX::JobSystem from one core to all of them: a coarse ParallelFor over compute-bound work and a
+// flood of small independent jobs. The calling thread takes part in both, so N cores is N - 1 workers.
+//
+// Usage: JobSystemBenchmark [max cores]
+//
+
+#include "pch.h"
+#include "JobSystem.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    // Roughly a microsecond of arithmetic the optimizer can't remove.
+    inline uint32_t Work(uint32_t seed, uint32_t iterations)
+    {
+        uint32_t x = seed | 1;
+        for (uint32_t i = 0; i < iterations; ++i)
+        {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+        }
+        return x;
+    }
+
+    const size_t c_elements = 1 << 20;
+    const uint32_t c_elementIterations = 64;
+    const size_t c_smallJobs = 200000;
+    const uint32_t c_smallJobIterations = 256;
+
+    std::vector<uint32_t> g_results(c_elements);
+
+    double ParallelForMs(JobSystem* jobs)
+    {
+        auto start = Clock::now();
+        auto body = [](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                g_results[i] = Work(static_cast<uint32_t>(i), c_elementIterations);
+        };
+
+        if (jobs)
+            jobs->ParallelFor(c_elements, 0, body);
+        else
+            body(0, c_elements);
+
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    double SmallJobsMs(JobSystem* jobs)
+    {
+        std::atomic<uint32_t> sink(0);
+        auto start = Clock::now();
+
+        if (jobs)
+        {
+            JobCounter counter;
+            for (size_t j = 0; j < c_smallJobs; ++j)
+            {
+                jobs->Run([&sink, j]() { sink.fetch_add(Work(static_cast<uint32_t>(j), c_smallJobIterations), std::memory_order_relaxed); }, &counter);
+            }
+            jobs->Wait(counter);
+        }
+        else
+        {
+            for (size_t j = 0; j < c_smallJobs; ++j)
+                sink.fetch_add(Work(static_cast<uint32_t>(j), c_smallJobIterations), std::memory_order_relaxed);
+        }
+
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    // Best of a few runs, after a warm up.
+    template<typename F>
+    double Best(F func)
+    {
+        func();
+        double best = 1e30;
+        for (int run = 0; run < 5; ++run)
+            best = std::min(best, func());
+        return best;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t maxCores = (argc > 1) ? static_cast<uint32_t>(strtoul(argv[1], nullptr, 10)) : std::max(std::thread::hardware_concurrency(), 1u);
+
+    printf("%u hardware threads\n", std::thread::hardware_concurrency());
+    printf("%-6s %16s %9s %16s %9s %14s\n", "cores", "ParallelFor (ms)", "speedup", "small jobs (ms)", "speedup", "jobs/s");
+
+    double serialFor = Best([]() { return ParallelForMs(nullptr); });
+    double serialJobs = Best([]() { return SmallJobsMs(nullptr); });
+    printf("%-6s %16.2f %9.2f %16.2f %9.2f %14s\n", "serial", serialFor, 1.0, serialJobs, 1.0, "-");
+
+    for (uint32_t cores = 2; cores <= std::max(maxCores, 2u); ++cores)
+    {
+        JobSystem::Settings settings;
+        settings.workerCount = cores - 1;
+        JobSystem jobs(settings);
+
+        double forMs = Best([&jobs]() { return ParallelForMs(&jobs); });
+        double jobsMs = Best([&jobs]() { return SmallJobsMs(&jobs); });
+        printf("%-6u %16.2f %9.2f %16.2f %9.2f %14.0f\n", cores, forMs, serialFor / forMs, jobsMs, serialJobs / jobsMs, c_smallJobs / (jobsMs / 1000.0));
+    }
+
+    return 0;
+}
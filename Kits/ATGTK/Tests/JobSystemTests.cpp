@@ -0,0 +1,157 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Tests for DX::JobSystem.
+//
+
+#include "pch.h"
+#include "JobSystem.h"
+
+#include <atomic>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    int g_failures = 0;
+
+#define CHECK(condition) \
+    do { if (!(condition)) { ++g_failures; printf("%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #condition); } } while (0)
+
+    JobSystem::Settings TestSettings(uint32_t workers)
+    {
+        JobSystem::Settings settings;
+        settings.workerCount = workers;
+        settings.pinThreads = false;
+        settings.dequeSize = 64;
+        return settings;
+    }
+
+    void TestParallelForCoversEveryIndexOnce()
+    {
+        JobSystem jobs(TestSettings(4));
+
+        const size_t count = 100000;
+        std::vector<std::atomic<uint32_t>> hits(count);
+        for (auto& hit : hits)
+            hit = 0;
+
+        for (size_t grain : { size_t(0), size_t(1), size_t(7), size_t(1000) })
+        {
+            jobs.ParallelFor(count, grain, [&hits](size_t begin, size_t end)
+            {
+                for (size_t i = begin; i < end; ++i)
+                    ++hits[i];
+            });
+        }
+
+        bool all = true;
+        for (auto& hit : hits)
+            all = all && (hit == 4);
+        CHECK(all);
+    }
+
+    // Every job in a chain of RunAfter dependencies sees all of the jobs it depends on finished.
+    void TestRunAfterOrdering()
+    {
+        JobSystem jobs(TestSettings(4));
+
+        for (int round = 0; round < 2000; ++round)
+        {
+            const int stages = 4;
+            const int width = 8;
+            JobCounter counters[stages];
+            std::atomic<int> finished[stages];
+            std::atomic<int> early(0);
+            for (auto& f : finished)
+                f = 0;
+
+            for (int j = 0; j < width; ++j)
+            {
+                jobs.Run([&finished]() { ++finished[0]; }, &counters[0]);
+            }
+
+            for (int stage = 1; stage < stages; ++stage)
+            {
+                for (int j = 0; j < width; ++j)
+                {
+                    jobs.RunAfter(counters[stage - 1], [&, stage]()
+                    {
+                        if (finished[stage - 1] != width)
+                            ++early;
+                        ++finished[stage];
+                    }, &counters[stage]);
+                }
+            }
+
+            jobs.Wait(counters[stages - 1]);
+            for (auto& counter : counters)
+                jobs.Wait(counter);
+
+            CHECK(early == 0);
+            CHECK(finished[stages - 1] == width);
+        }
+    }
+
+    // Jobs that keep submitting children from worker threads while the job system is shutting down
+    // still all run before the destructor returns. The deques are small so some children overflow to
+    // the shared queue.
+    void TestShutdownRunsEverything()
+    {
+        for (int round = 0; round < 50; ++round)
+        {
+            std::atomic<int> ran(0);
+            int expected = 0;
+            {
+                // Declared before the job system so it outlives the jobs that the destructor runs.
+                JobSystem* system = nullptr;
+                std::function<void(int)> spawn = [&](int depth)
+                {
+                    ++ran;
+                    if (depth == 0)
+                        return;
+                    for (int j = 0; j < 3; ++j)
+                    {
+                        system->Run([&spawn, depth]() { spawn(depth - 1); });
+                    }
+                };
+
+                JobSystem jobs(TestSettings(3));
+                system = &jobs;
+
+                // 1 + 3 + 9 + ... + 3^6 jobs per root
+                const int roots = 8;
+                const int depth = 6;
+                for (int r = 0; r < roots; ++r)
+                {
+                    jobs.Run([&spawn]() { spawn(depth); });
+                }
+                int perRoot = 0;
+                for (int d = 0, n = 1; d <= depth; ++d, n *= 3)
+                    perRoot += n;
+                expected = roots * perRoot;
+            }
+            CHECK(ran == expected);
+        }
+    }
+}
+
+int main()
+{
+    TestParallelForCoversEveryIndexOnce();
+    TestRunAfterOrdering();
+    TestShutdownRunsEverything();
+
+    if (g_failures != 0)
+    {
+        printf("%d check(s) failed\n", g_failures);
+        return 1;
+    }
+
+    printf("All JobSystem tests passed\n");
+    return 0;
+}
@@ -0,0 +1,190 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// The layout part of UIManager::LoadLayout's startup cost for each sample's SampleUI.csv, warm in the file
+// cache, as the median of many loads:
+//
+//   parse       ParseLayout on the .csv, which every launch did before layouts were compiled
+//   hash        mapping and validating the compiled layout, then mapping the .csv and hashing all of it,
+//               which is how compiled layouts were first checked against their .csv
+//   stamp       mapping and validating the compiled layout, then comparing the stamp of the .csv, which
+//               is what LoadLayout does now
+//
+// Creating the controls from the records is the same for every path, and needs Direct3D, so isn't timed.
+//
+// Usage: SampleGUILayoutBenchmark [layout.csv...]
+//
+
+#include "pch.h"
+#include "SampleGUILayout.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <glob.h>
+#include <unistd.h>
+
+using namespace ATG;
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    const int c_Runs = 301;
+
+    // The samples' layouts, found from this directory
+    std::vector<std::string> FindSampleLayouts()
+    {
+        static const char* s_patterns[] =
+        {
+            "../../../*/*/*/Assets/SampleUI.csv",
+            "../../../*/*/*/*/Assets/SampleUI.csv",
+            "../../../*/*/*/*/*/Assets/SampleUI.csv",
+        };
+
+        std::vector<std::string> files;
+        for (auto pattern : s_patterns)
+        {
+            glob_t result = {};
+            if (glob(pattern, 0, nullptr, &result) == 0)
+            {
+                files.insert(files.end(), result.gl_pathv, result.gl_pathv + result.gl_pathc);
+            }
+            globfree(&result);
+        }
+        return files;
+    }
+
+    // Returns the median time in microseconds
+    template<typename TFunc>
+    double Measure(TFunc func)
+    {
+        std::vector<double> times;
+        for (int run = 0; run < c_Runs; ++run)
+        {
+            auto start = Clock::now();
+            func();
+            times.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        }
+
+        std::nth_element(times.begin(), times.begin() + c_Runs / 2, times.end());
+        return times[c_Runs / 2];
+    }
+
+    void Fail(const std::string& file, const char* message)
+    {
+        printf("ERROR: %s: %s\n", file.c_str(), message);
+        exit(1);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> files(argv + 1, argv + argc);
+    if (files.empty())
+    {
+        files = FindSampleLayouts();
+    }
+
+    if (files.empty())
+    {
+        printf("ERROR: no layouts found\n");
+        return 1;
+    }
+
+    // Parse warnings are only debugger output in a sample
+    if (!freopen("/dev/null", "w", stderr))
+        return 1;
+
+    printf("median of %d loads, microseconds\n", c_Runs);
+    printf("%-56s %7s %9s %9s %9s\n", "layout", "records", "parse", "hash", "stamp");
+
+    double totals[3] = {};
+    for (auto& file : files)
+    {
+        std::wstring layoutFile(file.begin(), file.end());
+
+        char compiledPath[] = "/tmp/SampleGUILayoutBenchmarkXXXXXX";
+        int compiledHandle = mkstemp(compiledPath);
+        if (compiledHandle < 0)
+            Fail(file, "can't create the compiled layout");
+        close(compiledHandle);
+        std::wstring compiledFile(compiledPath, compiledPath + strlen(compiledPath));
+
+        size_t recordCount = 0;
+        try
+        {
+            CompileLayoutFile(layoutFile.c_str(), compiledFile.c_str());
+
+            std::vector<LayoutRecord> records;
+            LayoutStrings strings;
+            ParseLayout(layoutFile.c_str(), records, strings);
+            recordCount = records.size();
+        }
+        catch (const std::exception& e)
+        {
+            unlink(compiledPath);
+            Fail(file, e.what());
+        }
+
+        double parse = Measure([&]()
+        {
+            std::vector<LayoutRecord> records;
+            LayoutStrings strings;
+            ParseLayout(layoutFile.c_str(), records, strings);
+            if (records.size() != recordCount)
+                Fail(file, "parse mismatch");
+        });
+
+        double hash = Measure([&]()
+        {
+            DX::MappedFile compiled;
+            const LayoutHeader* header = SUCCEEDED(compiled.Open(compiledFile.c_str(), true)) ? ValidateCompiledLayout(compiled.GetData(), compiled.GetSize()) : nullptr;
+
+            DX::MappedFile source;
+            if (!header
+                || FAILED(source.Open(layoutFile.c_str(), true))
+                || source.GetSize() != header->sourceSize
+                || HashLayoutSource(source.GetData(), source.GetSize()) != header->sourceHash)
+                Fail(file, "compiled layout rejected");
+        });
+
+        double stamp = Measure([&]()
+        {
+            DX::MappedFile compiled;
+            const LayoutHeader* header = SUCCEEDED(compiled.Open(compiledFile.c_str(), true)) ? ValidateCompiledLayout(compiled.GetData(), compiled.GetSize()) : nullptr;
+            if (!header || !IsCompiledLayoutCurrent(*header, layoutFile.c_str()))
+                Fail(file, "compiled layout rejected");
+        });
+
+        unlink(compiledPath);
+
+        // Name layouts by their sample
+        std::string name = file;
+        while (name.compare(0, 3, "../") == 0)
+        {
+            name.erase(0, 3);
+        }
+        size_t assets = name.rfind("/Assets/");
+        if (assets != std::string::npos)
+        {
+            name.erase(assets);
+        }
+
+        printf("%-56s %7zu %9.1f %9.1f %9.1f\n", name.c_str(), recordCount, parse, hash, stamp);
+        fflush(stdout);
+
+        totals[0] += parse;
+        totals[1] += hash;
+        totals[2] += stamp;
+    }
+
+    printf("%-56s %7s %9.1f %9.1f %9.1f\n", "total", "", totals[0], totals[1], totals[2]);
+    return 0;
+}
@@ -0,0 +1,461 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Tests for the compiled UI layouts in SampleGUILayout.h. Every sample's SampleUI.csv is compiled, and
+// the mapped blob must validate and hold the same records and strings as parsing the .csv. Styles,
+// colors and hotkeys are checked on a small layout, damaged blobs must be rejected, and a compiled
+// layout must only be used while the stamp of its .csv matches.
+//
+// The Makefile builds this file twice: SampleGUILayoutDebugTests defines _DEBUG, where a .csv that was
+// touched without being changed is rehashed and still matches.
+//
+// Usage: SampleGUILayoutTests [layout.csv...]
+//
+
+#include "pch.h"
+#include "SampleGUILayout.h"
+#include "MappedFile.h"
+
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <glob.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace ATG;
+
+namespace
+{
+    int g_failures = 0;
+
+#define CHECK(condition) \
+    do { if (!(condition)) { ++g_failures; printf("%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #condition); } } while (0)
+
+    // The samples' layouts, found from this directory
+    std::vector<std::string> FindSampleLayouts()
+    {
+        static const char* s_patterns[] =
+        {
+            "../../../*/*/*/Assets/SampleUI.csv",
+            "../../../*/*/*/*/Assets/SampleUI.csv",
+            "../../../*/*/*/*/*/Assets/SampleUI.csv",
+        };
+
+        std::vector<std::string> files;
+        for (auto pattern : s_patterns)
+        {
+            glob_t result = {};
+            if (glob(pattern, 0, nullptr, &result) == 0)
+            {
+                files.insert(files.end(), result.gl_pathv, result.gl_pathv + result.gl_pathc);
+            }
+            globfree(&result);
+        }
+        return files;
+    }
+
+    std::wstring Widen(const std::string& str)
+    {
+        return std::wstring(str.begin(), str.end());
+    }
+
+    // A file in /tmp which is removed when it goes out of scope
+    class TempFile
+    {
+    public:
+        explicit TempFile(const std::string& text, const char* suffix = ".csv")
+        {
+            char path[] = "/tmp/SampleGUILayoutTestsXXXXXX";
+            int file = mkstemp(path);
+            if (file < 0)
+            {
+                printf("ERROR: can't create %s\n", path);
+                exit(1);
+            }
+            close(file);
+            unlink(path);
+
+            m_path = std::string(path) + suffix;
+            Write(text);
+        }
+
+        TempFile(const TempFile&) = delete;
+        TempFile& operator=(const TempFile&) = delete;
+
+        ~TempFile() { unlink(m_path.c_str()); }
+
+        void Write(const std::string& text)
+        {
+            FILE* file = fopen(m_path.c_str(), "wb");
+            if (!file || fwrite(text.data(), 1, text.size(), file) != text.size())
+            {
+                printf("ERROR: can't write %s\n", m_path.c_str());
+                exit(1);
+            }
+            fclose(file);
+        }
+
+        // Moves the last write time, as an editor or a checkout would
+        void Touch(int seconds)
+        {
+            struct stat info = {};
+            stat(m_path.c_str(), &info);
+
+            struct timespec times[2] = { info.st_atim, info.st_mtim };
+            times[1].tv_sec += seconds;
+            utimensat(AT_FDCWD, m_path.c_str(), times, 0);
+        }
+
+        const std::string& Path() const { return m_path; }
+        std::wstring Name() const { return Widen(m_path); }
+
+    private:
+        std::string m_path;
+    };
+
+    // Parse warnings about the samples' own layouts aren't what's being tested
+    class QuietStderr
+    {
+    public:
+        QuietStderr()
+        {
+            fflush(stderr);
+            m_saved = dup(STDERR_FILENO);
+            int null = open("/dev/null", O_WRONLY);
+            dup2(null, STDERR_FILENO);
+            close(null);
+        }
+
+        ~QuietStderr()
+        {
+            fflush(stderr);
+            dup2(m_saved, STDERR_FILENO);
+            close(m_saved);
+        }
+
+    private:
+        int m_saved;
+    };
+
+    std::string ReadFile(const std::string& path)
+    {
+        std::string data;
+        FILE* file = fopen(path.c_str(), "rb");
+        if (file)
+        {
+            char buff[4096];
+            size_t count;
+            while ((count = fread(buff, 1, sizeof(buff), file)) > 0)
+            {
+                data.append(buff, count);
+            }
+            fclose(file);
+        }
+        return data;
+    }
+
+    bool SameRecord(const LayoutRecord& a, const LayoutRecord& b)
+    {
+        return memcmp(&a, &b, sizeof(LayoutRecord)) == 0;
+    }
+
+    // The compiled layout holds what the parser returns
+    void TestSampleLayoutsRoundTrip(const std::vector<std::string>& files)
+    {
+        CHECK(!files.empty());
+
+        for (auto& file : files)
+        {
+            std::wstring layoutFile = Widen(file);
+
+            std::vector<LayoutRecord> records;
+            LayoutStrings strings;
+            TempFile compiledFile(std::string(), ".uilayout");
+            try
+            {
+                QuietStderr quiet;
+                ParseLayout(layoutFile.c_str(), records, strings);
+                CompileLayoutFile(layoutFile.c_str(), compiledFile.Name().c_str());
+            }
+            catch (const std::exception& e)
+            {
+                printf("%s: %s\n", file.c_str(), e.what());
+                CHECK(false);
+                continue;
+            }
+
+            DX::MappedFile compiled;
+            CHECK(SUCCEEDED(compiled.Open(compiledFile.Name().c_str())));
+
+            auto header = ValidateCompiledLayout(compiled.GetData(), compiled.GetSize());
+            CHECK(header != nullptr);
+            if (!header)
+                continue;
+
+            CHECK(!records.empty() && header->recordCount == records.size());
+            CHECK(header->stringCount == strings.GetData().size());
+            CHECK(compiled.GetSize() == header->stringOffset + header->stringCount * sizeof(uint16_t));
+
+            auto compiledRecords = reinterpret_cast<const LayoutRecord*>(compiled.GetData() + header->recordOffset);
+            for (size_t j = 0; j < records.size() && j < header->recordCount; ++j)
+            {
+                CHECK(SameRecord(compiledRecords[j], records[j]));
+            }
+
+            auto compiledStrings = reinterpret_cast<const uint16_t*>(compiled.GetData() + header->stringOffset);
+            for (size_t j = 0; j < strings.GetData().size() && j < header->stringCount; ++j)
+            {
+                CHECK(compiledStrings[j] == static_cast<uint16_t>(strings.GetData()[j]));
+            }
+
+            std::string source = ReadFile(file);
+            CHECK(header->sourceSize == source.size());
+            CHECK(header->sourceHash == HashLayoutSource(reinterpret_cast<const uint8_t*>(source.data()), source.size()));
+            CHECK(IsCompiledLayoutCurrent(*header, layoutFile.c_str()));
+        }
+    }
+
+    const char* c_TestLayout =
+        "# Every kind of control\n"
+        "POPUP,100,0,0,640,480,EMPHASIS\n"
+        "LABEL,1,10,20,100,30,Title|Line two,CENTER LARGE,RED,#102030\n"
+        "LEGEND,2,10,60,100,30,[A] Select,RIGHT;ITALIC,BLUE\n"
+        "IMAGE,3,10,100,32,32,logo.png   \n"
+        "BUTTON,4,10,140,100,30,Go,F5,BOLD|BORDER,YELLOW\n"
+        "DEFBUTTON,5,10,180,100,30,Cancel,x\n"
+        "EXITIMAGEBUTTON,6,10,220,32,32,logo.png,F10,TRANSPARENT\n"
+        "CHECKBOX,7,10,260,100,30,Check,checked small\n"
+        "SLIDER,8,10,300,100,30,TRANSPARENT\n"
+        "PROGRESSBAR,9,10,340,100,30\n"
+        "UNKNOWN,10,0,0,0,0\n"
+        "LISTBOX,11,10,380,100,90,24,MULTISELECT SCROLLBAR\n"
+        "TEXTLIST,12,120,380,100,90,20\n"
+        "HUD,200,0,0,1920,1080\n"
+        "TEXTBOX,1,10,20,300,200,Some|text,NOBACKGROUND\n"
+        "CUSTOM_OVERLAY,300,0,0,1920,1080,SUPPRESS_CANCEL\n";
+
+    void TestParseLayout()
+    {
+        TempFile layout(c_TestLayout);
+
+        std::vector<LayoutRecord> records;
+        LayoutStrings strings;
+        ParseLayout(layout.Name().c_str(), records, strings);
+
+        CHECK(records.size() == 15);
+        if (records.size() != 15)
+            return;
+
+        auto text = [&](uint32_t offset) { return std::wstring(strings.GetData().data() + offset); };
+
+        CHECK(records[0].type == LAYOUT_POPUP && records[0].id == 100 && records[0].style == c_LayoutStylePanelEmphasis);
+        CHECK(records[0].rect[2] == 640 && records[0].rect[3] == 480 && records[0].record == 1);
+
+        CHECK(records[1].type == LAYOUT_LABEL && text(records[1].text) == L"Title\nLine two");
+        CHECK(records[1].rect[0] == 10 && records[1].rect[1] == 20 && records[1].rect[2] == 110 && records[1].rect[3] == 50);
+        CHECK(records[1].style == (c_LayoutStyleAlignCenter | c_LayoutStyleAlignMiddle | c_LayoutStyleFontLarge));
+        CHECK(records[1].fgColor == (c_LayoutColorNamed | 0) && records[1].bgColor == (c_LayoutColorRGB | 0x102030));
+
+        CHECK(records[2].type == LAYOUT_LEGEND && records[2].style == (c_LayoutStyleAlignRight | c_LayoutStyleAlignMiddle | c_LayoutStyleFontItalic));
+        CHECK(records[2].fgColor == (c_LayoutColorNamed | 2) && records[2].bgColor == c_LayoutColorDefault);
+
+        CHECK(records[3].type == LAYOUT_IMAGE && text(records[3].image) == L"logo.png");
+
+        CHECK(records[4].type == LAYOUT_BUTTON && records[4].hotkey == c_LayoutKeyF1 + 4);
+        CHECK(records[4].style == c_LayoutStyleFontBold && records[4].flags == c_LayoutFlagBorder);
+        CHECK(records[4].fgColor == (c_LayoutColorNamed | 4));
+
+        CHECK(records[5].type == LAYOUT_BUTTON && records[5].hotkey == L'x');
+        CHECK(records[5].style == (c_LayoutStyleExit | c_LayoutStyleDefault));
+
+        CHECK(records[6].type == LAYOUT_IMAGEBUTTON && records[6].image == records[3].image && records[6].hotkey == c_LayoutKeyF1 + 9);
+        CHECK(records[6].style == (c_LayoutStyleExit | c_LayoutStyleImageButtonTransparent | c_LayoutStyleImageButtonBackground));
+
+        CHECK(records[7].type == LAYOUT_CHECKBOX && records[7].flags == c_LayoutFlagChecked && records[7].style == c_LayoutStyleFontSmall);
+        CHECK(records[8].type == LAYOUT_SLIDER && records[8].style == c_LayoutStyleSliderTransparent);
+        CHECK(records[9].type == LAYOUT_PROGRESSBAR);
+
+        // The unknown item is skipped
+        CHECK(records[10].type == LAYOUT_LISTBOX && records[10].id == 11 && records[10].itemHeight == 24);
+        CHECK(records[10].style == (c_LayoutStyleListBoxMultiSelection | c_LayoutStyleListBoxScrollBar));
+        CHECK(records[11].type == LAYOUT_TEXTLIST && records[11].itemHeight == 20 && records[11].style == 0);
+
+        CHECK(records[12].type == LAYOUT_HUD);
+        CHECK(records[13].type == LAYOUT_TEXTBOX && text(records[13].text) == L"Some\ntext" && records[13].style == c_LayoutStyleTextBoxNoBackground);
+        CHECK(records[14].type == LAYOUT_OVERLAY && records[14].style == (c_LayoutStylePanelCustom | c_LayoutStylePanelSuppressCancel));
+
+        // Strings are interned
+        CHECK(strings.GetData().size() == 1 + 15 + 11 + 9 + 3 + 7 + 6 + 10);
+    }
+
+    void TestParseErrors()
+    {
+        static const char* s_invalid[] =
+        {
+            "LABEL,1,0,0,10,10,Outside a panel\n",
+            "HUD,1,0,0,10,10\nLABEL,2,0,0,10,10\n",
+            "HUD,1,0,0,10,10\nIMAGE,2,0,0,10,10\n",
+            "HUD,1,0,0\n",
+            "POPUP\n",
+        };
+
+        for (auto text : s_invalid)
+        {
+            TempFile layout(text);
+
+            std::vector<LayoutRecord> records;
+            LayoutStrings strings;
+            bool threw = false;
+            try
+            {
+                ParseLayout(layout.Name().c_str(), records, strings);
+            }
+            catch (const std::runtime_error&)
+            {
+                threw = true;
+            }
+            CHECK(threw);
+        }
+
+        bool threw = false;
+        try
+        {
+            CompileLayoutFile(L"/tmp/SampleGUILayoutTests-missing.csv");
+        }
+        catch (const std::runtime_error&)
+        {
+            threw = true;
+        }
+        CHECK(threw);
+    }
+
+    void TestValidateRejectsDamagedLayouts()
+    {
+        TempFile layout(c_TestLayout);
+        TempFile compiledFile(std::string(), ".uilayout");
+        CompileLayoutFile(layout.Name().c_str(), compiledFile.Name().c_str());
+
+        const std::string blob = ReadFile(compiledFile.Path());
+        auto validate = [](const std::string& data)
+        {
+            return ValidateCompiledLayout(reinterpret_cast<const uint8_t*>(data.data()), data.size()) != nullptr;
+        };
+
+        CHECK(validate(blob));
+        CHECK(!ValidateCompiledLayout(nullptr, 0));
+
+        auto header = reinterpret_cast<const LayoutHeader*>(blob.data());
+        CHECK(header->magic == c_LayoutMagic && header->version == c_LayoutVersion && header->recordOffset == sizeof(LayoutHeader));
+
+        auto damaged = [&](size_t offset, uint32_t value)
+        {
+            std::string data = blob;
+            memcpy(&data[offset], &value, sizeof(value));
+            return data;
+        };
+
+        CHECK(!validate(damaged(offsetof(LayoutHeader, magic), 0)));
+        CHECK(!validate(damaged(offsetof(LayoutHeader, version), c_LayoutVersion - 1)));
+        CHECK(!validate(damaged(offsetof(LayoutHeader, recordCount), header->recordCount + 1000)));
+        CHECK(!validate(damaged(offsetof(LayoutHeader, recordOffset), 2)));
+        CHECK(!validate(damaged(offsetof(LayoutHeader, stringOffset), static_cast<uint32_t>(blob.size()))));
+        CHECK(!validate(damaged(offsetof(LayoutHeader, stringCount), 0)));
+        CHECK(!validate(blob.substr(0, blob.size() - 2)));
+        CHECK(!validate(blob.substr(0, sizeof(LayoutHeader) - 1)));
+
+        // The string table must end with a nul
+        std::string unterminated = blob;
+        unterminated[unterminated.size() - 2] = 'x';
+        CHECK(!validate(unterminated));
+
+        size_t firstRecord = header->recordOffset;
+        CHECK(!validate(damaged(firstRecord + offsetof(LayoutRecord, type), LAYOUT_TYPE_COUNT)));
+        CHECK(!validate(damaged(firstRecord + offsetof(LayoutRecord, type), LAYOUT_LABEL)));
+        CHECK(!validate(damaged(firstRecord + sizeof(LayoutRecord) + offsetof(LayoutRecord, text), header->stringCount)));
+    }
+
+    // A compiled layout is used while its .csv has the size and write time it was compiled from
+    void TestSourceStamp()
+    {
+        TempFile layout(c_TestLayout);
+        TempFile compiledFile(std::string(), ".uilayout");
+        CompileLayoutFile(layout.Name().c_str(), compiledFile.Name().c_str());
+
+        const std::string blob = ReadFile(compiledFile.Path());
+        const LayoutHeader header = *reinterpret_cast<const LayoutHeader*>(blob.data());
+        CHECK(IsCompiledLayoutCurrent(header, layout.Name().c_str()));
+
+        uint64_t size = 0;
+        uint64_t writeTime = 0;
+        CHECK(SUCCEEDED(GetLayoutSourceStamp(layout.Name().c_str(), size, writeTime)));
+        CHECK(size == header.sourceSize && writeTime == header.sourceTime && size == strlen(c_TestLayout));
+
+        // Only touched: the contents still hash the same, which only debug builds check
+        layout.Touch(10);
+#ifdef _DEBUG
+        CHECK(IsCompiledLayoutCurrent(header, layout.Name().c_str()));
+#else
+        CHECK(!IsCompiledLayoutCurrent(header, layout.Name().c_str()));
+#endif
+
+        // Edited, keeping the size
+        std::string edited = c_TestLayout;
+        edited[edited.find("Title")] = 'X';
+        layout.Write(edited);
+        layout.Touch(20);
+        CHECK(!IsCompiledLayoutCurrent(header, layout.Name().c_str()));
+
+        // Edited, changing the size
+        layout.Write(edited + "HUD,400,0,0,10,10\n");
+        CHECK(!IsCompiledLayoutCurrent(header, layout.Name().c_str()));
+
+        // A compiled layout can ship without its .csv
+        CHECK(IsCompiledLayoutCurrent(header, L"/tmp/SampleGUILayoutTests-missing.csv"));
+        CHECK(FAILED(GetLayoutSourceStamp(L"/tmp/SampleGUILayoutTests-missing.csv", size, writeTime)));
+    }
+
+    void TestLayoutNames()
+    {
+        CHECK(ReplaceLayoutExtension(L"Assets\\SampleUI.csv", c_CompiledLayoutExt) == L"Assets\\SampleUI.uilayout");
+        CHECK(ReplaceLayoutExtension(L"Assets/SampleUI", L".csv") == L"Assets/SampleUI.csv");
+        CHECK(ReplaceLayoutExtension(L"v1.2\\SampleUI", L".csv") == L"v1.2\\SampleUI.csv");
+        CHECK(IsCompiledLayoutName(L"Assets\\SampleUI.uilayout"));
+        CHECK(IsCompiledLayoutName(L"SAMPLEUI.UILAYOUT"));
+        CHECK(!IsCompiledLayoutName(L"SampleUI.csv"));
+        CHECK(!IsCompiledLayoutName(L"layout"));
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> files(argv + 1, argv + argc);
+    if (files.empty())
+    {
+        files = FindSampleLayouts();
+    }
+
+    TestSampleLayoutsRoundTrip(files);
+    TestParseLayout();
+    TestParseErrors();
+    TestValidateRejectsDamagedLayouts();
+    TestSourceStamp();
+    TestLayoutNames();
+
+    if (g_failures != 0)
+    {
+        printf("%d check(s) failed\n", g_failures);
+        return 1;
+    }
+
+#ifdef _DEBUG
+    printf("All SampleGUILayout tests passed (%zu sample layouts, debug)\n", files.size());
+#else
+    printf("All SampleGUILayout tests passed (%zu sample layouts)\n", files.size());
+#endif
+    return 0;
+}
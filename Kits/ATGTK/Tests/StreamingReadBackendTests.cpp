@@ -0,0 +1,237 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Tests for the threaded WaveBankStreamer read backend, reading from an in-memory file.
+//
+
+#include "pch.h"
+#include "StreamingReadBackend.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+using namespace DX;
+
+namespace
+{
+    int g_failures = 0;
+
+#define CHECK(condition) \
+    do { if (!(condition)) { ++g_failures; printf("%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #condition); } } while (0)
+
+    const uint32_t c_sectorSize = 512;
+
+    // An in-memory file whose reads can be slowed down or failed.
+    struct MemoryFile
+    {
+        MemoryFile(size_t size) : data(size), latencyMs(0), reads(0)
+        {
+            for (size_t i = 0; i < size; ++i)
+            {
+                data[i] = static_cast<uint8_t>(i * 7 + 3);
+            }
+        }
+
+        StreamingReadFunction Reader()
+        {
+            return [this](uint64_t offset, void* dest, uint32_t size, uint32_t& bytesRead) -> HRESULT
+            {
+                ++reads;
+                if (latencyMs)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(latencyMs.load()));
+                }
+                if (offset > data.size())
+                {
+                    return E_FAIL;
+                }
+                bytesRead = static_cast<uint32_t>(std::min<uint64_t>(size, data.size() - offset));
+                memcpy(dest, data.data() + offset, bytesRead);
+                return S_OK;
+            };
+        }
+
+        std::vector<uint8_t>    data;
+        std::atomic<uint32_t>   latencyMs;
+        std::atomic<uint32_t>   reads;
+    };
+
+    StreamingReadRequest MakeRequest(uint64_t offset, uint8_t* dest, uint32_t size)
+    {
+        StreamingReadRequest request = {};
+        request.offset = offset;
+        request.dest = dest;
+        request.size = size;
+        return request;
+    }
+
+    // Polls GetCompleted the way the streamer's Update does.
+    StreamingReadRequest* WaitForCompleted(IStreamingReadBackend& backend)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+            if (auto request = backend.GetCompleted())
+            {
+                return request;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return nullptr;
+    }
+
+    void TestCreateValidatesArguments()
+    {
+        MemoryFile file(c_sectorSize);
+        std::unique_ptr<IStreamingReadBackend> backend;
+
+        CHECK(CreateThreadedReadBackend(StreamingReadFunction(), c_sectorSize, backend) == E_INVALIDARG && !backend);
+        CHECK(CreateThreadedReadBackend(file.Reader(), 0, backend) == E_INVALIDARG && !backend);
+        CHECK(CreateThreadedReadBackend(file.Reader(), 3000, backend) == E_INVALIDARG && !backend);
+        CHECK(SUCCEEDED(CreateThreadedReadBackend(file.Reader(), c_sectorSize, backend)) && backend);
+        CHECK(backend->SectorSize() == c_sectorSize);
+        CHECK(backend->Submit(nullptr) == E_INVALIDARG);
+    }
+
+    void TestReadsCompleteInOrder()
+    {
+        const uint32_t count = 16;
+        MemoryFile file(count * c_sectorSize);
+        std::unique_ptr<IStreamingReadBackend> backend;
+        CHECK(SUCCEEDED(CreateThreadedReadBackend(file.Reader(), c_sectorSize, backend)));
+
+        std::vector<uint8_t> buffer(count * c_sectorSize);
+        std::vector<StreamingReadRequest> requests;
+        for (uint32_t j = 0; j < count; ++j)
+        {
+            requests.push_back(MakeRequest(uint64_t(j) * c_sectorSize, buffer.data() + j * c_sectorSize, c_sectorSize));
+        }
+        for (auto& request : requests)
+        {
+            CHECK(SUCCEEDED(backend->Submit(&request)));
+        }
+
+        for (uint32_t j = 0; j < count; ++j)
+        {
+            auto request = WaitForCompleted(*backend);
+            CHECK(request == &requests[j]);
+            if (request)
+            {
+                CHECK(request->result == S_OK);
+                CHECK(request->bytesRead == c_sectorSize);
+            }
+        }
+        CHECK(backend->GetCompleted() == nullptr);
+        CHECK(buffer == file.data);
+    }
+
+    // Sector-rounded reads at the end of the file come back short, and failures are passed through.
+    void TestShortAndFailedReads()
+    {
+        MemoryFile file(c_sectorSize + 100);
+        std::unique_ptr<IStreamingReadBackend> backend;
+        CHECK(SUCCEEDED(CreateThreadedReadBackend(file.Reader(), c_sectorSize, backend)));
+
+        std::vector<uint8_t> buffer(c_sectorSize);
+        auto tail = MakeRequest(c_sectorSize, buffer.data(), c_sectorSize);
+        CHECK(SUCCEEDED(backend->Submit(&tail)));
+        CHECK(WaitForCompleted(*backend) == &tail);
+        CHECK(tail.result == S_OK && tail.bytesRead == 100);
+        CHECK(memcmp(buffer.data(), file.data.data() + c_sectorSize, 100) == 0);
+
+        auto past = MakeRequest(4 * c_sectorSize, buffer.data(), c_sectorSize);
+        CHECK(SUCCEEDED(backend->Submit(&past)));
+        CHECK(WaitForCompleted(*backend) == &past);
+        CHECK(past.result == E_FAIL && past.bytesRead == 0);
+    }
+
+    // CancelAll aborts queued reads, waits for the one being read, and every request is still returned.
+    void TestCancelAll()
+    {
+        const uint32_t count = 8;
+        MemoryFile file(count * c_sectorSize);
+        file.latencyMs = 50;
+        std::unique_ptr<IStreamingReadBackend> backend;
+        CHECK(SUCCEEDED(CreateThreadedReadBackend(file.Reader(), c_sectorSize, backend)));
+
+        std::vector<uint8_t> buffer(count * c_sectorSize);
+        std::vector<StreamingReadRequest> requests;
+        for (uint32_t j = 0; j < count; ++j)
+        {
+            requests.push_back(MakeRequest(uint64_t(j) * c_sectorSize, buffer.data() + j * c_sectorSize, c_sectorSize));
+        }
+        for (auto& request : requests)
+        {
+            CHECK(SUCCEEDED(backend->Submit(&request)));
+            CHECK(request.result == E_PENDING);
+        }
+
+        // Let the worker start the first read.
+        while (file.reads == 0)
+        {
+            std::this_thread::yield();
+        }
+        backend->CancelAll();
+
+        uint32_t returned = 0;
+        uint32_t aborted = 0;
+        while (auto request = backend->GetCompleted())
+        {
+            ++returned;
+            CHECK(request->result == S_OK || request->result == E_ABORT);
+            if (request->result == E_ABORT)
+            {
+                ++aborted;
+            }
+        }
+        CHECK(returned == count);
+        CHECK(aborted == count - file.reads);
+        CHECK(requests[0].result == S_OK);
+    }
+
+    void TestDestroyWithReadsQueued()
+    {
+        MemoryFile file(4 * c_sectorSize);
+        file.latencyMs = 20;
+        std::vector<uint8_t> buffer(4 * c_sectorSize);
+        std::vector<StreamingReadRequest> requests;
+        for (uint32_t j = 0; j < 4; ++j)
+        {
+            requests.push_back(MakeRequest(uint64_t(j) * c_sectorSize, buffer.data() + j * c_sectorSize, c_sectorSize));
+        }
+
+        {
+            std::unique_ptr<IStreamingReadBackend> backend;
+            CHECK(SUCCEEDED(CreateThreadedReadBackend(file.Reader(), c_sectorSize, backend)));
+            for (auto& request : requests)
+            {
+                CHECK(SUCCEEDED(backend->Submit(&request)));
+            }
+        }
+
+        // The worker finishes the read it had started and leaves the rest.
+        CHECK(file.reads <= 1);
+    }
+}
+
+int main()
+{
+    TestCreateValidatesArguments();
+    TestReadsCompleteInOrder();
+    TestShortAndFailedReads();
+    TestCancelAll();
+    TestDestroyWithReadsQueued();
+
+    if (g_failures != 0)
+    {
+        printf("%d check(s) failed\n", g_failures);
+        return 1;
+    }
+
+    printf("All StreamingReadBackend tests passed\n");
+    return 0;
+}
@@ -0,0 +1,211 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Word wrap throughput of TextLayout against the wrap SampleGUI used before it, which measured the
+// whole line again with SpriteFont::MeasureDrawBounds after every character. The old measurement is
+// reproduced here from the same glyph metrics, so both wraps must give the same result; the
+// benchmark fails if they don't.
+//
+// TextLayout.h is included on its own, without the sample's precompiled header, to check that it
+// builds without the SAL annotations being defined.
+//
+// Usage: TextLayoutBenchmark [iterations]
+//
+
+#include "TextLayout.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace ATG;
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    // A proportional font for printable ASCII, with some glyphs overhanging their advance.
+    GlyphAdvanceTable MakeFont()
+    {
+        std::vector<GlyphAdvanceTable::Glyph> glyphs;
+        for (uint32_t ch = 32; ch < 127; ++ch)
+        {
+            GlyphAdvanceTable::Glyph glyph = {};
+            glyph.character = ch;
+            glyph.xOffset = (ch % 7 == 0) ? -1.f : 0.f;
+            glyph.width = float(6 + (ch * 37) % 9);
+            glyph.advance = glyph.width + ((ch % 5 == 0) ? -2.f : 1.f);
+            glyph.blank = (ch == L' ');
+            glyphs.push_back(glyph);
+        }
+        return GlyphAdvanceTable(glyphs.data(), glyphs.size(), L'?');
+    }
+
+    // SpriteFont::MeasureDrawBounds: the right edge of the ink of the text, which may span several lines.
+    long MeasureRight(const GlyphAdvanceTable& glyphs, const wchar_t* text)
+    {
+        float x = 0.f;
+        float right = 0.f;
+        for (; *text; ++text)
+        {
+            if (*text == L'\n')
+            {
+                x = 0.f;
+                continue;
+            }
+            if (*text == L'\r')
+                continue;
+
+            auto glyph = glyphs.Find(*text);
+            if (!glyph)
+                continue;
+
+            float glyphX = std::max(x + glyph->xOffset, 0.f);
+            x = glyphX + glyph->advance;
+            if (!glyph->blank)
+            {
+                right = std::max(right, glyphX + std::max(glyph->advance, glyph->width));
+            }
+        }
+        return long(right);
+    }
+
+    // The word wrap SampleGUI used before TextLayout.
+    std::wstring OldWordWrap(const GlyphAdvanceTable& glyphs, const wchar_t* text, long width, std::vector<size_t>& lineStarts)
+    {
+        lineStarts.clear();
+        if (*text)
+            lineStarts.push_back(0);
+
+        std::wstring str;
+        str.reserve(wcslen(text));
+
+        size_t line_start = 0;
+        size_t last_line = 0;
+        size_t last_word = 0;
+        size_t extra = 0;
+
+        const wchar_t *ptr = text;
+
+        wchar_t prevch = 0;
+        while (*ptr != L'\0')
+        {
+            const wchar_t ch = *ptr;
+
+            str.push_back(ch);
+
+            if (iswspace(ch))
+            {
+                last_word = size_t(ptr - text);
+            }
+            else if (prevch == L'-')
+            {
+                last_word = size_t(ptr - text - 1);
+            }
+
+            if (MeasureRight(glyphs, str.c_str() + line_start) > width)
+            {
+                if (last_word > last_line)
+                {
+                    str.erase(str.cbegin() + ptrdiff_t(last_word + extra), str.cend());
+                    str.push_back(L'\n');
+                    ++extra;
+                    last_line = last_word;
+                    ptr = text + last_word + 1;
+                }
+                else
+                {
+                    str.erase(str.cend() - 1);
+                    str.push_back(L'\n');
+                    ++extra;
+                    last_line = last_word = str.length() - extra;
+                }
+
+                line_start = last_line + extra;
+                lineStarts.push_back(last_line + extra);
+
+                prevch = 0;
+                continue;
+            }
+
+            ++ptr;
+            prevch = ch;
+        }
+
+        return str;
+    }
+
+    std::wstring MakeText(size_t length, unsigned int seed)
+    {
+        static const wchar_t* const words[] =
+        {
+            L"Xbox", L"Live", L"sample", L"leaderboard", L"multiplayer", L"session", L"a", L"of", L"the",
+            L"well-known", L"achievement", L"presence", L"user-interface", L"to", L"matchmaking", L"Supercalifragilisticexpialidocious"
+        };
+
+        std::wstring text;
+        while (text.size() < length)
+        {
+            seed = seed * 1103515245 + 12345;
+            text += words[(seed >> 16) % (sizeof(words) / sizeof(words[0]))];
+            text += ((seed >> 8) % 23 == 0) ? L'\n' : L' ';
+        }
+        text.resize(length);
+        return text;
+    }
+
+    template<typename Func>
+    double NanosecondsPerCall(unsigned int iterations, Func func)
+    {
+        auto start = Clock::now();
+        for (unsigned int j = 0; j < iterations; ++j)
+        {
+            func();
+        }
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int iterations = (argc > 1) ? static_cast<unsigned int>(strtoul(argv[1], nullptr, 10)) : 200;
+
+    auto font = MakeFont();
+
+    printf("%-10s %-8s %14s %14s %14s %10s\n", "chars", "width", "old (us)", "wrap (us)", "cached (us)", "speedup");
+
+    const size_t lengths[] = { 64, 256, 1024, 4096 };
+    const long widths[] = { 200, 600 };
+    for (auto length : lengths)
+    {
+        for (auto width : widths)
+        {
+            auto text = MakeText(length, unsigned(length + width));
+
+            std::vector<size_t> oldLines;
+            auto oldText = OldWordWrap(font, text.c_str(), width, oldLines);
+
+            WrappedText wrapped;
+            WordWrap(font, text.c_str(), text.size(), width, wrapped);
+            if (wrapped.text != oldText || wrapped.lineStarts != oldLines)
+            {
+                printf("Wrap of %zu characters at width %ld differs from the old wrap\n", length, width);
+                return 1;
+            }
+
+            // The old wrap is quadratic in the line length, so it gets fewer iterations
+            unsigned int oldIterations = std::max(1u, iterations / 10);
+            double oldNs = NanosecondsPerCall(oldIterations, [&]() { OldWordWrap(font, text.c_str(), width, oldLines); });
+            double wrapNs = NanosecondsPerCall(iterations, [&]() { WordWrap(font, text.c_str(), text.size(), width, wrapped); });
+
+            TextLayoutCache cache;
+            cache.WordWrap(font, text.c_str(), width);
+            double cachedNs = NanosecondsPerCall(iterations * 10, [&]() { cache.WordWrap(font, text.c_str(), width); });
+
+            printf("%-10zu %-8ld %14.2f %14.2f %14.2f %9.1fx\n", length, width, oldNs / 1000.0, wrapNs / 1000.0, cachedNs / 1000.0, oldNs / wrapNs);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,139 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Logging throughput of the TextConsole message queue with 1 to 8 threads writing while a render
+// thread drains it, against the mutex the console used to take for every message. Layout and
+// drawing are not included; the baseline only copies each message into a list under the lock, so
+// it understates what writers used to wait for.
+//
+// Usage: TextMessageQueueBenchmark [messages per thread]
+//
+
+#include "pch.h"
+#include "TextMessageQueue.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <string>
+#include <thread>
+
+using namespace DX;
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    const float c_white[4] = { 1.f, 1.f, 1.f, 1.f };
+
+    struct Result
+    {
+        double  messagesPerSecond;  // Written by all threads, including dropped ones
+        double  worstWriteUs;       // Longest single write
+        double  droppedPercent;
+    };
+
+    // Runs the writers while the calling thread drains once per simulated frame.
+    template<typename Write, typename Drain>
+    Result Run(int threadCount, int messagesPerThread, Write write, Drain drain)
+    {
+        std::atomic<int> running(threadCount);
+        std::vector<double> worst(threadCount, 0.0);
+        std::vector<std::thread> threads;
+
+        auto start = Clock::now();
+        for (int t = 0; t < threadCount; ++t)
+        {
+            threads.emplace_back([&, t]()
+            {
+                wchar_t text[64];
+                for (int j = 0; j < messagesPerThread; ++j)
+                {
+                    int length = swprintf(text, 64, L"Thread %d wrote message number %d", t, j);
+                    auto before = Clock::now();
+                    write(text, size_t(length));
+                    worst[t] = std::max(worst[t], std::chrono::duration<double, std::micro>(Clock::now() - before).count());
+                }
+                --running;
+            });
+        }
+
+        uint64_t drained = 0;
+        while (running > 0)
+        {
+            drained += drain();
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        drained += drain();
+
+        uint64_t total = uint64_t(threadCount) * messagesPerThread;
+
+        Result result;
+        result.messagesPerSecond = double(total) / seconds;
+        result.worstWriteUs = *std::max_element(worst.begin(), worst.end());
+        result.droppedPercent = 100.0 * double(total - drained) / double(total);
+        return result;
+    }
+
+    Result RunQueue(int threadCount, int messagesPerThread)
+    {
+        TextMessageQueue queue;
+        return Run(threadCount, messagesPerThread,
+            [&queue](const wchar_t* str, size_t length)
+            {
+                queue.Push(c_white, str, length, true);
+            },
+            [&queue]()
+            {
+                uint64_t count = 0;
+                queue.Drain([&count](const float*, const wchar_t*, size_t, bool) { ++count; }, [](uint32_t) {});
+                return count;
+            });
+    }
+
+    Result RunMutex(int threadCount, int messagesPerThread)
+    {
+        std::mutex mutex;
+        std::deque<std::wstring> lines;
+        return Run(threadCount, messagesPerThread,
+            [&](const wchar_t* str, size_t length)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                lines.emplace_back(str, length);
+            },
+            [&]()
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                uint64_t count = lines.size();
+                lines.clear();
+                return count;
+            });
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int messagesPerThread = (argc > 1) ? atoi(argv[1]) : 200000;
+
+    printf("%d messages per thread, %u hardware threads\n", messagesPerThread, std::thread::hardware_concurrency());
+    printf("%-8s %-8s %16s %18s %10s\n", "threads", "queue", "messages/s", "worst write (us)", "dropped");
+
+    const int threadCounts[] = { 1, 2, 4, 8 };
+    for (auto threads : threadCounts)
+    {
+        auto queue = RunQueue(threads, messagesPerThread);
+        printf("%-8d %-8s %16.0f %18.1f %9.2f%%\n", threads, "ring", queue.messagesPerSecond, queue.worstWriteUs, queue.droppedPercent);
+
+        auto mutex = RunMutex(threads, messagesPerThread);
+        printf("%-8d %-8s %16.0f %18.1f %9.2f%%\n", threads, "mutex", mutex.messagesPerSecond, mutex.worstWriteUs, mutex.droppedPercent);
+    }
+
+    return 0;
+}
@@ -0,0 +1,207 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Tests for the TextConsole message queue.
+//
+
+#include "pch.h"
+#include "TextMessageQueue.h"
+
+#include <cstdio>
+#include <string>
+#include <thread>
+
+using namespace DX;
+
+namespace
+{
+    int g_failures = 0;
+
+#define CHECK(condition) \
+    do { if (!(condition)) { ++g_failures; printf("%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #condition); } } while (0)
+
+    const float c_white[4] = { 1.f, 1.f, 1.f, 1.f };
+
+    struct Output
+    {
+        Output() : dropped(0), notices(0) {}
+
+        std::wstring    text;
+        uint32_t        dropped;
+        uint32_t        notices;
+    };
+
+    void Drain(TextMessageQueue& queue, Output& output)
+    {
+        queue.Drain(
+            [&output](const float*, const wchar_t* str, size_t length, bool newLine)
+            {
+                output.text.append(str, length);
+                if (newLine)
+                {
+                    output.text += L'\n';
+                }
+            },
+            [&output](uint32_t count)
+            {
+                output.dropped += count;
+                ++output.notices;
+            });
+    }
+
+    bool Push(TextMessageQueue& queue, const std::wstring& str, bool newLine = true)
+    {
+        return queue.Push(c_white, str.c_str(), str.size(), newLine);
+    }
+
+    void TestOrderAndColor()
+    {
+        TextMessageQueue queue;
+
+        const float red[4] = { 1.f, 0.f, 0.f, 1.f };
+        CHECK(queue.Push(red, L"Hello", 5, false));
+        CHECK(Push(queue, L", world"));
+        CHECK(Push(queue, L"", true));
+
+        std::wstring text;
+        uint32_t calls = 0;
+        queue.Drain(
+            [&](const float* color, const wchar_t* str, size_t length, bool newLine)
+            {
+                if (calls++ == 0)
+                {
+                    CHECK(color[0] == 1.f && color[1] == 0.f);
+                    CHECK(!newLine);
+                }
+                text.append(str, length);
+            },
+            [](uint32_t) { CHECK(false); });
+
+        CHECK(calls == 3);
+        CHECK(text == L"Hello, world");
+    }
+
+    // Messages that don't fit are dropped, counted, and reported once by the next drain.
+    void TestDropsAreReported()
+    {
+        TextMessageQueue queue;
+        std::wstring line(500, L'x');
+
+        uint32_t pushed = 0;
+        while (Push(queue, line))
+        {
+            ++pushed;
+        }
+        CHECK(pushed > 0);
+        CHECK(!Push(queue, line));
+        CHECK(queue.GetDropped() == 2);
+
+        Output output;
+        Drain(queue, output);
+        CHECK(output.notices == 1 && output.dropped == 2);
+        CHECK(output.text.size() == pushed * (line.size() + 1));
+
+        // The space is reused, wrapping around the end of the ring.
+        for (uint32_t j = 0; j < pushed * 3; ++j)
+        {
+            CHECK(Push(queue, line));
+            if (j % 8 == 7)
+            {
+                Drain(queue, output);
+            }
+        }
+        Drain(queue, output);
+        CHECK(output.notices == 1);
+        CHECK(output.text.size() == pushed * 4 * (line.size() + 1));
+    }
+
+    void TestLongMessagesAreTruncated()
+    {
+        TextMessageQueue queue;
+        std::wstring huge(TextMessageQueue::c_capacityBytes, L'y');
+        CHECK(Push(queue, huge, false));
+
+        Output output;
+        Drain(queue, output);
+        CHECK(!output.text.empty() && output.text.size() * sizeof(wchar_t) < TextMessageQueue::c_capacityBytes / 2);
+    }
+
+    // Every message from every thread arrives whole and in the order its thread wrote it, or is counted as dropped.
+    void TestThreads()
+    {
+        TextMessageQueue queue;
+        const int threadCount = 8;
+        const int messagesPerThread = 20000;
+
+        std::atomic<int> running(threadCount);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < threadCount; ++t)
+        {
+            threads.emplace_back([&queue, &running, t]()
+            {
+                for (int j = 0; j < messagesPerThread; ++j)
+                {
+                    wchar_t text[32];
+                    int length = swprintf(text, 32, L"%d:%d", t, j);
+                    queue.Push(c_white, text, size_t(length), true);
+                }
+                --running;
+            });
+        }
+
+        std::vector<int> next(threadCount, 0);
+        uint32_t received = 0;
+        uint32_t dropped = 0;
+        bool ordered = true;
+        auto drain = [&]()
+        {
+            queue.Drain(
+                [&](const float*, const wchar_t* str, size_t length, bool newLine)
+                {
+                    std::wstring text(str, length);
+                    int t = -1;
+                    int j = -1;
+                    if (!newLine || swscanf(text.c_str(), L"%d:%d", &t, &j) != 2 || t < 0 || t >= threadCount || j < next[t])
+                    {
+                        ordered = false;
+                        return;
+                    }
+                    next[t] = j + 1;
+                    ++received;
+                },
+                [&](uint32_t count) { dropped += count; });
+        };
+
+        while (running > 0)
+        {
+            drain();
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        drain();
+
+        CHECK(ordered);
+        CHECK(received + dropped == uint32_t(threadCount * messagesPerThread));
+        CHECK(dropped == queue.GetDropped());
+    }
+}
+
+int main()
+{
+    TestOrderAndColor();
+    TestDropsAreReported();
+    TestLongMessagesAreTruncated();
+    TestThreads();
+
+    if (g_failures != 0)
+    {
+        printf("%d check(s) failed\n", g_failures);
+        return 1;
+    }
+
+    printf("All TextMessageQueue tests passed\n");
+    return 0;
+}
@@ -0,0 +1,532 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Tests for the DX::WaveBankStreamer scheduler, driven by a fake read backend whose reads only finish
+// (or fail) when the test says so. Covers the order reads are issued in by playback deadline, the cap
+// on reads in flight and the queue depth, underrun counting, retrying failed reads, and streams which
+// fail for good.
+//
+// Usage: WaveBankStreamerTests
+//
+
+#include "pch.h"
+#include "WaveBankStreamer.h"
+
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+    int g_failures = 0;
+
+#define CHECK(condition) \
+    do { if (!(condition)) { ++g_failures; printf("%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #condition); } } while (0)
+
+    const uint32_t c_sectorSize = 512;
+    const uint32_t c_bufferSize = 4096;
+
+    // Reads from an in-memory file, held until the test completes them.
+    class FakeReadBackend : public IStreamingReadBackend
+    {
+    public:
+        explicit FakeReadBackend(const std::vector<uint8_t>& file) :
+            m_file(file),
+            m_capacity(UINT32_MAX),
+            m_submitFailures(0),
+            m_maxPending(0)
+        {
+        }
+
+        HRESULT Submit(StreamingReadRequest* request) override
+        {
+            if (!request)
+                return E_INVALIDARG;
+
+            if (m_pending.size() >= m_capacity)
+                return HRESULT_FROM_WIN32(ERROR_BUSY);
+
+            submitted.push_back(request->offset);
+
+            if (m_submitFailures)
+            {
+                --m_submitFailures;
+                return E_FAIL;
+            }
+
+            request->bytesRead = 0;
+            request->result = E_PENDING;
+            m_pending.push_back(request);
+            m_maxPending = std::max(m_maxPending, m_pending.size());
+            return S_OK;
+        }
+
+        StreamingReadRequest* GetCompleted() override
+        {
+            if (m_completed.empty())
+                return nullptr;
+
+            auto request = m_completed.front();
+            m_completed.pop_front();
+            return request;
+        }
+
+        void CancelAll() override
+        {
+            while (!m_pending.empty())
+            {
+                Finish(0, E_ABORT);
+            }
+        }
+
+        uint32_t SectorSize() const override { return c_sectorSize; }
+
+        // Finishes the read at index in the pending reads, oldest first. Successful reads are copied from the file,
+        // and are short past its end.
+        void Finish(size_t index, HRESULT result = S_OK)
+        {
+            auto request = m_pending[index];
+            m_pending.erase(m_pending.begin() + ptrdiff_t(index));
+
+            if (SUCCEEDED(result))
+            {
+                uint64_t available = (request->offset < m_file.size()) ? m_file.size() - request->offset : 0;
+                request->bytesRead = static_cast<uint32_t>(std::min<uint64_t>(request->size, available));
+                memcpy(request->dest, m_file.data() + request->offset, request->bytesRead);
+            }
+            request->result = result;
+            m_completed.push_back(request);
+        }
+
+        // Finishes the pending read of the given offset; returns false if there isn't one.
+        bool FinishAt(uint64_t offset, HRESULT result = S_OK)
+        {
+            for (size_t j = 0; j < m_pending.size(); ++j)
+            {
+                if (m_pending[j]->offset == offset)
+                {
+                    Finish(j, result);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void FinishAll()
+        {
+            while (!m_pending.empty())
+            {
+                Finish(0);
+            }
+        }
+
+        size_t Pending() const { return m_pending.size(); }
+        size_t MaxPending() const { return m_maxPending; }
+
+        void SetCapacity(uint32_t capacity) { m_capacity = capacity; }
+        void FailSubmits(uint32_t count) { m_submitFailures = count; }
+
+        // Offset of every read submitted, in order
+        std::vector<uint64_t> submitted;
+
+    private:
+        const std::vector<uint8_t>&             m_file;
+        uint32_t                                m_capacity;
+        uint32_t                                m_submitFailures;
+        size_t                                  m_maxPending;
+        std::deque<StreamingReadRequest*>       m_pending;
+        std::deque<StreamingReadRequest*>       m_completed;
+    };
+
+    std::vector<uint8_t> MakeFile(size_t size)
+    {
+        std::vector<uint8_t> file(size);
+        for (size_t i = 0; i < size; ++i)
+        {
+            file[i] = static_cast<uint8_t>(i * 7 + (i >> 9));
+        }
+        return file;
+    }
+
+    StreamingWave MakeWave(uint64_t offset, uint32_t length, uint32_t bytesPerSecond, uint32_t blockAlign = 4)
+    {
+        StreamingWave wave = {};
+        wave.offset = offset;
+        wave.length = length;
+        wave.blockAlign = blockAlign;
+        wave.bytesPerSecond = bytesPerSecond;
+        return wave;
+    }
+
+    WaveBankStreamer::Settings TestSettings(uint32_t maxReadsInFlight)
+    {
+        WaveBankStreamer::Settings settings;
+        settings.maxStreams = 4;
+        settings.buffersPerStream = 3;
+        settings.bufferSize = c_bufferSize;
+        settings.maxReadsInFlight = maxReadsInFlight;
+        return settings;
+    }
+
+    // The sector-aligned offset the read of a stream's buffer starts at
+    uint64_t ReadOffset(const StreamingWave& wave, uint32_t buffer)
+    {
+        return (wave.offset + uint64_t(buffer) * c_bufferSize) & ~uint64_t(c_sectorSize - 1);
+    }
+
+    // Reads are issued earliest playback deadline first. A stream's deadline for a buffer is when the audio
+    // before it will have played, so a fast stream's later buffers come before a slow stream's.
+    void TestDeadlineOrdering()
+    {
+        auto file = MakeFile(1024 * 1024);
+        auto backend = new FakeReadBackend(file);
+        WaveBankStreamer streamer(std::unique_ptr<IStreamingReadBackend>(backend), TestSettings(1));
+
+        // 4 seconds a buffer, and 40 ms a buffer
+        auto slow = MakeWave(1000, 64 * 1024, 1000);
+        auto fast = MakeWave(300000, 64 * 1024, 100000);
+        uint32_t slowStream = streamer.Start(slow);
+        uint32_t fastStream = streamer.Start(fast);
+        CHECK(slowStream != WaveBankStreamer::c_InvalidStream && fastStream != WaveBankStreamer::c_InvalidStream);
+
+        // Only one read at a time, so the order is up to the scheduler
+        for (int j = 0; j < 8 && backend->Pending(); ++j)
+        {
+            CHECK(backend->Pending() == 1);
+            backend->Finish(0);
+            streamer.Update();
+        }
+
+        std::vector<uint64_t> expected =
+        {
+            ReadOffset(slow, 0),
+            ReadOffset(fast, 0), ReadOffset(fast, 1), ReadOffset(fast, 2),
+            ReadOffset(slow, 1), ReadOffset(slow, 2),
+        };
+        CHECK(backend->submitted == expected);
+
+        // Play the slow stream's first buffer and all of the fast stream's. With the backend busy, the freed
+        // buffers of both are queued, and the fast stream's is read first though the slow stream's was queued first.
+        WaveBankStreamer::Buffer buffer;
+        CHECK(streamer.AcquireBuffer(slowStream, buffer));
+        for (int j = 0; j < 3; ++j)
+        {
+            CHECK(streamer.AcquireBuffer(fastStream, buffer));
+        }
+        backend->SetCapacity(0);
+        streamer.ReleaseBuffer(slowStream);
+        streamer.ReleaseBuffer(fastStream);
+        CHECK(streamer.GetStatistics().queueDepth == 2);
+
+        backend->SetCapacity(UINT32_MAX);
+        streamer.Update();
+        CHECK(backend->submitted.size() == 7 && backend->submitted.back() == ReadOffset(fast, 3));
+
+        backend->Finish(0);
+        streamer.Update();
+        CHECK(backend->submitted.size() == 8 && backend->submitted.back() == ReadOffset(slow, 3));
+    }
+
+    // Only the first miss is an underrun while a stream waits for its reads; a stream which has been fed and
+    // misses again is another.
+    void TestUnderrunCounting()
+    {
+        auto file = MakeFile(1024 * 1024);
+        auto backend = new FakeReadBackend(file);
+        WaveBankStreamer streamer(std::unique_ptr<IStreamingReadBackend>(backend), TestSettings(4));
+
+        uint32_t stream = streamer.Start(MakeWave(0, 64 * 1024, 48000));
+        WaveBankStreamer::Buffer buffer;
+        CHECK(!streamer.AcquireBuffer(stream, buffer));
+        CHECK(!streamer.AcquireBuffer(stream, buffer));
+        CHECK(streamer.GetStatistics().underruns == 1);
+
+        backend->FinishAll();
+        streamer.Update();
+        for (int j = 0; j < 3; ++j)
+        {
+            CHECK(streamer.AcquireBuffer(stream, buffer));
+        }
+        CHECK(streamer.GetBuffersQueued(stream) == 3);
+
+        // Every buffer is with the voice
+        CHECK(!streamer.AcquireBuffer(stream, buffer));
+        CHECK(streamer.GetStatistics().underruns == 2);
+
+        streamer.ReleaseBuffer(stream);
+        CHECK(backend->Pending() == 1);
+        CHECK(!streamer.AcquireBuffer(stream, buffer));
+        CHECK(streamer.GetStatistics().underruns == 2);
+
+        backend->FinishAll();
+        streamer.Update();
+        CHECK(streamer.AcquireBuffer(stream, buffer));
+        CHECK(!streamer.AcquireBuffer(stream, buffer));
+        CHECK(streamer.GetStatistics().underruns == 3);
+
+        // A stopped stream isn't starved
+        streamer.Stop(stream);
+        CHECK(!streamer.AcquireBuffer(stream, buffer));
+        CHECK(streamer.GetStatistics().underruns == 3);
+    }
+
+    // Reads beyond the in-flight cap wait in the queue, and a backend which is busy holds them there too
+    void TestQueueDepth()
+    {
+        auto file = MakeFile(1024 * 1024);
+        auto backend = new FakeReadBackend(file);
+        WaveBankStreamer streamer(std::unique_ptr<IStreamingReadBackend>(backend), TestSettings(2));
+
+        for (uint32_t j = 0; j < 3; ++j)
+        {
+            CHECK(streamer.Start(MakeWave(j * 200000, 64 * 1024, 48000)) == j);
+        }
+
+        auto stats = streamer.GetStatistics();
+        CHECK(stats.readsInFlight == 2 && stats.queueDepth == 7);
+        CHECK(stats.readsIssued == 2 && stats.maxQueueDepth == 3);
+        CHECK(backend->Pending() == 2);
+
+        backend->Finish(0);
+        streamer.Update();
+        stats = streamer.GetStatistics();
+        CHECK(stats.readsInFlight == 2 && stats.queueDepth == 6 && stats.maxQueueDepth == 7);
+
+        while (backend->Pending())
+        {
+            backend->Finish(0);
+            streamer.Update();
+        }
+        stats = streamer.GetStatistics();
+        CHECK(stats.queueDepth == 0 && stats.readsInFlight == 0);
+        CHECK(stats.readsIssued == 9 && stats.readsCompleted == 9 && stats.readsFailed == 0);
+        CHECK(stats.maxReadsInFlight == 2 && backend->MaxPending() == 2);
+        CHECK(stats.bytesRead >= 9 * c_bufferSize);
+
+        // A backend with room for fewer reads than the cap returns ERROR_BUSY, which isn't a failure
+        auto busyBackend = new FakeReadBackend(file);
+        busyBackend->SetCapacity(1);
+        WaveBankStreamer busy(std::unique_ptr<IStreamingReadBackend>(busyBackend), TestSettings(4));
+        busy.Start(MakeWave(0, 64 * 1024, 48000));
+        stats = busy.GetStatistics();
+        CHECK(stats.readsIssued == 1 && stats.readsInFlight == 1 && stats.queueDepth == 2 && stats.readsFailed == 0);
+
+        while (busyBackend->Pending())
+        {
+            busyBackend->Finish(0);
+            busy.Update();
+        }
+        CHECK(busy.GetStatistics().readsCompleted == 3 && busy.GetStatistics().queueDepth == 0);
+    }
+
+    // The buffers hold the wave, from an offset part way into a sector, and the last is marked as the end
+    void TestBufferContents()
+    {
+        auto file = MakeFile(256 * 1024);
+        auto backend = new FakeReadBackend(file);
+        WaveBankStreamer streamer(std::unique_ptr<IStreamingReadBackend>(backend), TestSettings(4));
+
+        auto wave = MakeWave(777, 3 * c_bufferSize + 100, 48000);
+        uint32_t stream = streamer.Start(wave);
+
+        std::vector<uint8_t> played;
+        bool ended = false;
+        for (int j = 0; j < 20 && !ended; ++j)
+        {
+            backend->FinishAll();
+            streamer.Update();
+
+            WaveBankStreamer::Buffer buffer;
+            while (streamer.AcquireBuffer(stream, buffer))
+            {
+                CHECK(!ended);
+                played.insert(played.end(), buffer.data, buffer.data + buffer.size);
+                ended = buffer.endOfStream;
+                streamer.ReleaseBuffer(stream);
+            }
+        }
+        CHECK(ended);
+        CHECK(played.size() == wave.length);
+        CHECK(std::equal(played.begin(), played.end(), file.begin() + ptrdiff_t(wave.offset)));
+
+        WaveBankStreamer::Buffer buffer;
+        auto underruns = streamer.GetStatistics().underruns;
+        CHECK(!streamer.AcquireBuffer(stream, buffer));
+        CHECK(streamer.GetStatistics().underruns == underruns);
+
+        // A looping stream starts again from the beginning, and never ends
+        streamer.Stop(stream);
+        stream = streamer.Start(wave, true);
+        played.clear();
+        for (int j = 0; j < 20 && played.size() < 2 * wave.length; ++j)
+        {
+            backend->FinishAll();
+            streamer.Update();
+            while (streamer.AcquireBuffer(stream, buffer))
+            {
+                CHECK(!buffer.endOfStream);
+                played.insert(played.end(), buffer.data, buffer.data + buffer.size);
+                streamer.ReleaseBuffer(stream);
+            }
+        }
+        CHECK(played.size() >= 2 * wave.length);
+        CHECK(std::equal(file.begin() + ptrdiff_t(wave.offset), file.begin() + ptrdiff_t(wave.offset + wave.length), played.begin() + ptrdiff_t(wave.length)));
+    }
+
+    // A failed read, whether it fails when submitted or when it completes, is queued again on the next Update
+    void TestFailedReadsAreRetried()
+    {
+        auto file = MakeFile(1024 * 1024);
+        auto backend = new FakeReadBackend(file);
+        WaveBankStreamer streamer(std::unique_ptr<IStreamingReadBackend>(backend), TestSettings(4));
+
+        auto wave = MakeWave(0, 64 * 1024, 48000);
+        backend->FailSubmits(1);
+        uint32_t stream = streamer.Start(wave);
+        CHECK(backend->submitted.size() == 3 && backend->Pending() == 2);
+        CHECK(streamer.GetStatistics().readsRetried == 1 && streamer.GetStatistics().queueDepth == 1);
+
+        // The second read fails as it completes
+        CHECK(backend->FinishAt(ReadOffset(wave, 1), E_FAIL));
+        streamer.Update();
+        CHECK(streamer.GetStatistics().readsRetried == 2);
+        CHECK(streamer.GetStreamError(stream) == S_OK);
+
+        // Both are read again
+        streamer.Update();
+        CHECK(backend->Pending() == 3);
+        backend->FinishAll();
+        streamer.Update();
+
+        WaveBankStreamer::Buffer buffer;
+        for (uint32_t j = 0; j < 3; ++j)
+        {
+            CHECK(streamer.AcquireBuffer(stream, buffer));
+            CHECK(buffer.size == c_bufferSize && memcmp(buffer.data, file.data() + wave.offset + j * c_bufferSize, c_bufferSize) == 0);
+        }
+
+        auto stats = streamer.GetStatistics();
+        CHECK(stats.readsFailed == 2 && stats.readsRetried == 2 && stats.readsCompleted == 4);
+        CHECK(streamer.GetStreamError(stream) == S_OK);
+    }
+
+    // Once its retries run out a stream fails: what was read before still plays, then AcquireBuffer returns false
+    // without counting underruns, and the error is reported until the stream is started again.
+    void TestStreamFailsAfterRetries()
+    {
+        auto file = MakeFile(1024 * 1024);
+        auto backend = new FakeReadBackend(file);
+        auto settings = TestSettings(4);
+        settings.maxReadRetries = 2;
+        WaveBankStreamer streamer(std::unique_ptr<IStreamingReadBackend>(backend), settings);
+
+        auto wave = MakeWave(0, 64 * 1024, 48000);
+        uint32_t stream = streamer.Start(wave);
+        CHECK(backend->FinishAt(ReadOffset(wave, 0)));
+
+        // Each Update reads a failed buffer again, so it fails once and then on each retry
+        for (uint32_t attempt = 0; attempt <= settings.maxReadRetries; ++attempt)
+        {
+            CHECK(streamer.GetStreamError(stream) == S_OK);
+            streamer.Update();
+            CHECK(backend->FinishAt(ReadOffset(wave, 1), E_FAIL));
+            streamer.Update();
+        }
+        CHECK(streamer.GetStreamError(stream) == E_FAIL);
+        CHECK(streamer.IsActive(stream));
+
+        // The third buffer's read was already in flight; it's collected but never played
+        backend->FinishAll();
+        streamer.Update();
+        streamer.Update();
+        CHECK(backend->Pending() == 0);
+
+        auto stats = streamer.GetStatistics();
+        CHECK(stats.readsFailed == 3 && stats.readsRetried == 2 && stats.queueDepth == 0);
+
+        WaveBankStreamer::Buffer buffer;
+        CHECK(streamer.AcquireBuffer(stream, buffer) && !buffer.endOfStream);
+        streamer.ReleaseBuffer(stream);
+        CHECK(!streamer.AcquireBuffer(stream, buffer));
+        CHECK(!streamer.AcquireBuffer(stream, buffer));
+        CHECK(streamer.GetStatistics().underruns == 0);
+        CHECK(backend->Pending() == 0);
+
+        // Starting the stream again clears the error
+        streamer.Stop(stream);
+        CHECK(streamer.Start(wave) == stream);
+        CHECK(streamer.GetStreamError(stream) == S_OK);
+        CHECK(backend->Pending() == 3);
+
+        CHECK(streamer.GetStreamError(WaveBankStreamer::c_InvalidStream) == E_INVALIDARG);
+    }
+
+    // A file which ends before the wave does can't be fixed by reading again, so the stream fails at once
+    void TestShortReadIsEndOfFile()
+    {
+        auto file = MakeFile(10 * 1024);
+        auto backend = new FakeReadBackend(file);
+        WaveBankStreamer streamer(std::unique_ptr<IStreamingReadBackend>(backend), TestSettings(4));
+
+        // The third buffer would run 2 KB past the end of the file
+        uint32_t stream = streamer.Start(MakeWave(0, 12 * 1024, 48000));
+        backend->FinishAll();
+        streamer.Update();
+
+        CHECK(streamer.GetStreamError(stream) == HRESULT_FROM_WIN32(ERROR_HANDLE_EOF));
+        CHECK(streamer.GetStatistics().readsRetried == 0);
+
+        WaveBankStreamer::Buffer buffer;
+        CHECK(streamer.AcquireBuffer(stream, buffer));
+        CHECK(streamer.AcquireBuffer(stream, buffer));
+        CHECK(!streamer.AcquireBuffer(stream, buffer));
+    }
+
+    void TestStartValidatesWaves()
+    {
+        auto file = MakeFile(64 * 1024);
+        auto backend = new FakeReadBackend(file);
+        WaveBankStreamer streamer(std::unique_ptr<IStreamingReadBackend>(backend), TestSettings(4));
+
+        CHECK(streamer.Start(MakeWave(0, 0, 48000)) == WaveBankStreamer::c_InvalidStream);
+
+        // Every stream in use
+        for (uint32_t j = 0; j < 4; ++j)
+        {
+            CHECK(streamer.Start(MakeWave(0, 8192, 48000)) == j);
+        }
+        CHECK(streamer.Start(MakeWave(0, 8192, 48000)) == WaveBankStreamer::c_InvalidStream);
+
+        // A stopped stream whose reads are still in flight isn't reused until they finish
+        streamer.Stop(0);
+        CHECK(streamer.Start(MakeWave(0, 8192, 48000)) == WaveBankStreamer::c_InvalidStream);
+        backend->FinishAll();
+        streamer.Update();
+        CHECK(streamer.Start(MakeWave(0, 8192, 48000)) == 0);
+    }
+}
+
+int main()
+{
+    TestDeadlineOrdering();
+    TestUnderrunCounting();
+    TestQueueDepth();
+    TestBufferContents();
+    TestFailedReadsAreRetried();
+    TestStreamFailsAfterRetries();
+    TestShortReadIsEndOfFile();
+    TestStartValidatesWaves();
+
+    if (g_failures != 0)
+    {
+        printf("%d check(s) failed\n", g_failures);
+        return 1;
+    }
+
+    printf("All WaveBankStreamer tests passed\n");
+    return 0;
+}
@@ -0,0 +1,79 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Stands in for a sample's precompiled header when kit files are built for these tests outside of
+// Windows. Only the standard headers, the SAL annotations, _countof, the HRESULT and Win32 error
+// codes, and the few Microsoft CRT string functions the kit files use are provided.
+//
+
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <wctype.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifndef _WIN32
+#define _In_
+#define _In_opt_
+#define _In_z_
+#define _In_opt_z_
+#define _In_reads_(size)
+#define _In_reads_bytes_(size)
+#define _Out_
+#define _Out_opt_
+#define _Out_writes_(size)
+#define _Out_writes_bytes_(size)
+#define _Inout_
+#define _Inout_z_
+#define _Printf_format_string_
+#define _Use_decl_annotations_
+
+#define _countof(array) (sizeof(array) / sizeof((array)[0]))
+
+#define MAX_PATH 260
+
+#define _wcsicmp  wcscasecmp
+#define wcstok_s  wcstok
+#define swscanf_s swscanf
+
+inline int _wtoi(const wchar_t* str) { return static_cast<int>(wcstol(str, nullptr, 10)); }
+
+template<size_t TLength>
+int _wcsupr_s(wchar_t(&str)[TLength])
+{
+    for (size_t j = 0; j < TLength && str[j]; ++j)
+    {
+        str[j] = static_cast<wchar_t>(towupper(static_cast<wint_t>(str[j])));
+    }
+    return 0;
+}
+
+typedef int32_t HRESULT;
+
+#define SUCCEEDED(hr)         (static_cast<HRESULT>(hr) >= 0)
+#define FAILED(hr)            (static_cast<HRESULT>(hr) < 0)
+
+#define S_OK                  static_cast<HRESULT>(0L)
+#define S_FALSE               static_cast<HRESULT>(1L)
+#define E_ABORT               static_cast<HRESULT>(0x80004004L)
+#define E_FAIL                static_cast<HRESULT>(0x80004005L)
+#define E_INVALIDARG          static_cast<HRESULT>(0x80070057L)
+#define E_OUTOFMEMORY         static_cast<HRESULT>(0x8007000EL)
+#define E_ILLEGAL_METHOD_CALL static_cast<HRESULT>(0x8000000EL)
+#define E_PENDING             static_cast<HRESULT>(0x8000000AL)
+
+#define ERROR_HANDLE_EOF      38L
+#define ERROR_BUSY            170L
+
+#define HRESULT_FROM_WIN32(x) (static_cast<HRESULT>(x) <= 0 ? static_cast<HRESULT>(x) : static_cast<HRESULT>((static_cast<uint32_t>(x) & 0x0000FFFF) | 0x80070000))
+#endif
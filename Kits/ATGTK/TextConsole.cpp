@@ -26,7 +26,10 @@ TextConsole::TextConsole()
     m_foregroundColor(1.f, 1.f, 1.f, 1.f),
     m_debugOutput(false),
     m_columns(0),
-    m_rows(0)
+    m_rows(0),
+    m_filledLines(0),
+    m_scrollback(0),
+    m_scrollOffset(0)
 {
     Clear();
 }
@@ -43,7 +46,10 @@ TextConsole::TextConsole(
     m_foregroundColor(1.f, 1.f, 1.f, 1.f),
     m_debugOutput(false),
     m_columns(0),
-    m_rows(0)
+    m_rows(0),
+    m_filledLines(0),
+    m_scrollback(0),
+    m_scrollOffset(0)
 {
     RestoreDevice(device, upload, rtState, fontName, cpuDescriptor, gpuDescriptor);
 
@@ -56,7 +62,10 @@ TextConsole::TextConsole(ID3D11DeviceContext* context, const wchar_t* fontName)
     m_foregroundColor(1.f, 1.f, 1.f, 1.f),
     m_debugOutput(false),
     m_columns(0),
-    m_rows(0)
+    m_rows(0),
+    m_filledLines(0),
+    m_scrollback(0),
+    m_scrollOffset(0)
 {
     RestoreDevice(context, fontName);
 
@@ -70,11 +79,13 @@ void TextConsole::Render(_In_ ID3D12GraphicsCommandList* commandList)
 void TextConsole::Render()
 #endif
 {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    ProcessMessages();
+
     if (!m_lines)
         return;
 
-    std::lock_guard<std::mutex> lock(m_mutex);
-
     float lineSpacing = m_font->GetLineSpacing();
 
     float x = float(m_layout.left);
@@ -88,19 +99,35 @@ void TextConsole::Render()
     m_batch->Begin();
 #endif
 
-    auto textLine = static_cast<unsigned int>(m_currentLine + 1) % m_rows;
+    // Lines are the scrollback history followed by the console rows, oldest first
+    auto historyLines = static_cast<unsigned int>(m_history.size());
+    unsigned int firstLine = historyLines - std::min(m_scrollOffset, historyLines);
 
     for (unsigned int line = 0; line < m_rows; ++line)
     {
         XMFLOAT2 pos(x, y + lineSpacing * float(line));
 
-        if (*(m_lines[textLine].m_text))
+        const wchar_t* text;
+        const XMFLOAT4* textColor;
+
+        unsigned int index = firstLine + line;
+        if (index < historyLines)
+        {
+            text = m_history[index].m_text.c_str();
+            textColor = &m_history[index].m_textColor;
+        }
+        else
         {
-            XMVECTOR lineColor = XMLoadFloat4(&m_lines[textLine].m_textColor);
-            m_font->DrawString(m_batch.get(), m_lines[textLine].m_text, pos, XMColorEqual(lineColor, Line::s_defaultColor) ? foregroundColor : lineColor);
+            auto textLine = static_cast<unsigned int>(m_currentLine + 1 + index - historyLines) % m_rows;
+            text = m_lines[textLine].m_text;
+            textColor = &m_lines[textLine].m_textColor;
         }
 
-        textLine = static_cast<unsigned int>(textLine + 1) % m_rows;
+        if (*text)
+        {
+            XMVECTOR lineColor = XMLoadFloat4(textColor);
+            m_font->DrawString(m_batch.get(), text, pos, XMColorEqual(lineColor, Line::s_defaultColor) ? foregroundColor : lineColor);
+        }
     }
 
     m_batch->End();
@@ -110,6 +137,9 @@ void TextConsole::Clear()
 {
     std::lock_guard<std::mutex> lock(m_mutex);
 
+    // Messages written before the clear are laid out now, so they are cleared along with the rest
+    ProcessMessages();
+
     if (m_buffer)
     {
         memset(m_buffer.get(), 0, sizeof(wchar_t) * (m_columns + 1) * m_rows);
@@ -123,7 +153,9 @@ void TextConsole::Clear()
         }
     }
 
-    m_currentColumn = m_currentLine = 0;
+    m_currentColumn = m_currentLine = m_filledLines = 0;
+    m_scrollOffset = 0;
+    m_history.clear();
 }
 
 _Use_decl_annotations_
@@ -135,9 +167,7 @@ void TextConsole::Write(const wchar_t* str)
 _Use_decl_annotations_
 void XM_CALLCONV TextConsole::Write(FXMVECTOR color, const wchar_t* str)
 {
-    std::lock_guard<std::mutex> lock(m_mutex);
-
-    ProcessString(color, str);
+    EnqueueMessage(color, str, wcslen(str), false);
 
 #ifndef NDEBUG
     if (m_debugOutput)
@@ -156,10 +186,7 @@ void TextConsole::WriteLine(const wchar_t* str)
 _Use_decl_annotations_
 void XM_CALLCONV TextConsole::WriteLine(FXMVECTOR color, const wchar_t* str)
 {
-    std::lock_guard<std::mutex> lock(m_mutex);
-
-    ProcessString(color, str);
-    IncrementLine();
+    EnqueueMessage(color, str, wcslen(str), true);
 
 #ifndef NDEBUG
     if (m_debugOutput)
@@ -195,23 +222,24 @@ void TextConsole::Format(CXMVECTOR color, const wchar_t* strFormat, ...)
 _Use_decl_annotations_
 void TextConsole::FormatImpl(CXMVECTOR color, const wchar_t* strFormat, va_list args)
 {
-    std::lock_guard<std::mutex> lock(m_mutex);
+    // Each thread formats into its own buffer, so only the queue is shared
+    static thread_local std::vector<wchar_t> s_tempBuffer;
 
     auto len = size_t(_vscwprintf(strFormat, args) + 1);
 
-    if (m_tempBuffer.size() < len)
-        m_tempBuffer.resize(len);
-
-    memset(m_tempBuffer.data(), 0, sizeof(wchar_t) * len);
+    if (s_tempBuffer.size() < len)
+        s_tempBuffer.resize(len);
 
-    vswprintf_s(m_tempBuffer.data(), m_tempBuffer.size(), strFormat, args);
+    int written = vswprintf_s(s_tempBuffer.data(), s_tempBuffer.size(), strFormat, args);
+    if (written < 0)
+        return;
 
-    ProcessString(color, m_tempBuffer.data());
+    EnqueueMessage(color, s_tempBuffer.data(), size_t(written), false);
 
 #ifndef NDEBUG
     if (m_debugOutput)
     {
-        OutputDebugStringW(m_tempBuffer.data());
+        OutputDebugStringW(s_tempBuffer.data());
     }
 #endif
 }
@@ -220,6 +248,8 @@ void TextConsole::SetWindow(const RECT& layout)
 {
     std::lock_guard<std::mutex> lock(m_mutex);
 
+    ProcessMessages();
+
     m_layout = layout;
 
     assert(m_font != 0);
@@ -256,6 +286,8 @@ void TextConsole::SetWindow(const RECT& layout)
     std::swap(buffer, m_buffer);
     std::swap(lines, m_lines);
 
+    m_filledLines = std::min(m_filledLines, m_rows);
+
     if ((m_currentColumn >= m_columns) || (m_currentLine >= m_rows))
     {
         IncrementLine();
@@ -330,8 +362,70 @@ void TextConsole::SetRotation(DXGI_MODE_ROTATION rotation)
     }
 }
 
+void TextConsole::SetScrollback(unsigned int lines)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_scrollback = lines;
+    while (m_history.size() > m_scrollback)
+    {
+        m_history.pop_front();
+    }
+}
+
+void TextConsole::SetScrollOffset(unsigned int lines)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_scrollOffset = lines;
+}
+
+unsigned int TextConsole::GetScrollbackLines()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    ProcessMessages();
+
+    return static_cast<unsigned int>(m_history.size());
+}
+
+_Use_decl_annotations_
+void XM_CALLCONV TextConsole::EnqueueMessage(FXMVECTOR color, const wchar_t* str, size_t length, bool newLine)
+{
+    XMFLOAT4 messageColor;
+    XMStoreFloat4(&messageColor, color);
+    m_messages.Push(&messageColor.x, str, length, newLine);
+}
+
+void TextConsole::ProcessMessages()
+{
+    m_messages.Drain(
+        [this](const float color[4], const wchar_t* str, size_t length, bool newLine)
+        {
+            ProcessString(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(color)), str, length);
+
+            if (newLine)
+            {
+                IncrementLine();
+            }
+        },
+        [this](uint32_t count)
+        {
+            // Show where output was lost, on a line of its own
+            if (m_currentColumn > 0)
+            {
+                IncrementLine();
+            }
+
+            wchar_t text[64] = {};
+            int length = swprintf_s(text, L"[%u message(s) dropped: the console queue was full]", count);
+            ProcessString(Colors::Red, text, size_t(std::max(length, 0)));
+            IncrementLine();
+        });
+}
+
 _Use_decl_annotations_
-void TextConsole::ProcessString(FXMVECTOR color, const wchar_t* str)
+void TextConsole::ProcessString(FXMVECTOR color, const wchar_t* str, size_t length)
 {
     if (!m_lines)
         return;
@@ -340,7 +434,7 @@ void TextConsole::ProcessString(FXMVECTOR color, const wchar_t* str)
 
     float width = float(m_layout.right - m_layout.left);
 
-    for (const wchar_t* ch = str; *ch != 0; ++ch)
+    for (const wchar_t* ch = str; ch != str + length; ++ch)
     {
         if (*ch == '\n')
         {
@@ -358,6 +452,7 @@ void TextConsole::ProcessString(FXMVECTOR color, const wchar_t* str)
         else
         {
             m_lines[m_currentLine].m_text[m_currentColumn] = *ch;
+            m_lines[m_currentLine].m_text[m_currentColumn + 1] = L'\0';
 
             auto fontSize = m_font->MeasureString(m_lines[m_currentLine].m_text);
             if (XMVectorGetX(fontSize) > width)
@@ -372,6 +467,7 @@ void TextConsole::ProcessString(FXMVECTOR color, const wchar_t* str)
         {
             IncrementLine();
             m_lines[m_currentLine].m_text[0] = *ch;
+            m_lines[m_currentLine].m_text[1] = L'\0';
             m_lines[m_currentLine].SetColor(color);
         }
 
@@ -386,7 +482,25 @@ void TextConsole::IncrementLine()
 
     m_currentLine = (m_currentLine + 1) % m_rows;
     m_currentColumn = 0;
-    memset(m_lines[m_currentLine].m_text, 0, sizeof(wchar_t) * (m_columns + 1));
+
+    // Once every row has been used, the next line overwrites the oldest
+    if (m_filledLines + 1 < m_rows)
+    {
+        ++m_filledLines;
+    }
+    else if (m_scrollback > 0)
+    {
+        if (m_history.size() >= m_scrollback)
+        {
+            m_history.pop_front();
+        }
+
+        HistoryLine history = { m_lines[m_currentLine].m_text, m_lines[m_currentLine].m_textColor };
+        m_history.emplace_back(std::move(history));
+    }
+
+    // Text is always kept terminated, so only the start of the line needs clearing
+    m_lines[m_currentLine].m_text[0] = L'\0';
 }
 
 //--------------------------------------------------------------------------------------
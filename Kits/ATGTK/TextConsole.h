@@ -6,6 +6,11 @@
 //
 // Note: This is best used with monospace rather than proportional fonts
 //
+// Write, WriteLine and Format can be called from any thread without blocking: messages are copied into
+// a lock-free queue and laid out on the thread that calls Render. If the queue is full, messages are
+// dropped; the console shows how many were lost where they would have been, and GetDroppedMessages
+// counts them.
+//
 // Copyright (c) Microsoft Corporation. All rights reserved.
 // Licensed under the MIT License.
 //--------------------------------------------------------------------------------------
@@ -18,8 +23,12 @@
 #endif
 #include "SpriteBatch.h"
 #include "SpriteFont.h"
+#include "TextMessageQueue.h"
 
+#include <atomic>
+#include <deque>
 #include <mutex>
+#include <string>
 #include <vector>
 
 #include <wrl/client.h>
@@ -73,6 +82,17 @@ namespace DX
 
         void SetDebugOutput(bool debug) { m_debugOutput = debug; }
 
+        // Keeps up to this many lines that have scrolled off the top of the console (0 to disable)
+        void SetScrollback(unsigned int lines);
+
+        // Shows the console scrolled back by this many lines (0 for the latest output)
+        void SetScrollOffset(unsigned int lines);
+
+        unsigned int GetScrollbackLines();
+
+        // Number of messages dropped because the queue was full
+        uint32_t GetDroppedMessages() const { return m_messages.GetDropped(); }
+
         void ReleaseDevice();
 #if defined(__d3d12_h__) || defined(__d3d12_x_h__)
         void RestoreDevice(
@@ -93,7 +113,9 @@ namespace DX
 
     protected:
         void FormatImpl(DirectX::CXMVECTOR color, _In_z_ _Printf_format_string_ const wchar_t* strFormat, va_list args);
-        void XM_CALLCONV ProcessString(DirectX::FXMVECTOR color, _In_z_ const wchar_t* str);
+        void XM_CALLCONV EnqueueMessage(DirectX::FXMVECTOR color, _In_reads_(length) const wchar_t* str, size_t length, bool newLine);
+        void ProcessMessages();
+        void XM_CALLCONV ProcessString(DirectX::FXMVECTOR color, _In_reads_(length) const wchar_t* str, size_t length);
         void IncrementLine();
 
         struct Line
@@ -117,10 +139,23 @@ namespace DX
         unsigned int                                    m_rows;
         unsigned int                                    m_currentColumn;
         unsigned int                                    m_currentLine;
+        unsigned int                                    m_filledLines;
 
         std::unique_ptr<wchar_t[]>                      m_buffer;
         std::unique_ptr<Line[]>                         m_lines;
-        std::vector<wchar_t>                            m_tempBuffer;
+
+        struct HistoryLine
+        {
+            std::wstring                                m_text;
+            DirectX::XMFLOAT4                           m_textColor;
+        };
+
+        unsigned int                                    m_scrollback;
+        unsigned int                                    m_scrollOffset;
+        std::deque<HistoryLine>                         m_history;
+
+        // Messages waiting to be laid out
+        TextMessageQueue                                m_messages;
 
         std::unique_ptr<DirectX::SpriteBatch>           m_batch;
         std::unique_ptr<DirectX::SpriteFont>            m_font;
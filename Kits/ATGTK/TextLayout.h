@@ -0,0 +1,344 @@
+//--------------------------------------------------------------------------------------
+// File: TextLayout.h
+//
+// Word wrapping for proportional bitmap fonts.
+//
+// Glyph metrics are copied once per font into a GlyphAdvanceTable, so wrapping a string is a
+// single pass over its characters rather than re-measuring the line with SpriteFont for each
+// character. Results are cached by text hash, font and width, so controls that are laid out
+// again with unchanged text and width reuse the previous result. There are no Direct3D or
+// DirectXTK dependencies, so layout can be used and profiled without a GPU.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+//-------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <wctype.h>
+
+#include <algorithm>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _In_reads_
+#define _In_reads_(size)
+#endif
+
+#ifndef _In_z_
+#define _In_z_
+#endif
+
+
+namespace ATG
+{
+    class GlyphAdvanceTable
+    {
+    public:
+        struct Glyph
+        {
+            uint32_t    character;
+            float       xOffset;
+            float       advance;    // Width of the glyph plus its XAdvance
+            float       width;
+            bool        blank;      // Whitespace which draws no pixels
+        };
+
+        GlyphAdvanceTable() :
+            m_default(c_none)
+        {
+            std::fill(std::begin(m_direct), std::end(m_direct), uint32_t(c_none));
+        }
+
+        // Glyphs may be in any order. Characters without a glyph use defaultCharacter, or take no space if it
+        // is 0 or also missing.
+        GlyphAdvanceTable(_In_reads_(count) const Glyph* glyphs, size_t count, wchar_t defaultCharacter) :
+            m_glyphs(glyphs, glyphs + count),
+            m_default(c_none)
+        {
+            std::sort(m_glyphs.begin(), m_glyphs.end(), [](const Glyph& a, const Glyph& b) { return a.character < b.character; });
+
+            std::fill(std::begin(m_direct), std::end(m_direct), uint32_t(c_none));
+            for (size_t j = 0; j < m_glyphs.size() && m_glyphs[j].character < c_directCount; ++j)
+            {
+                m_direct[m_glyphs[j].character] = static_cast<uint32_t>(j);
+            }
+
+            if (defaultCharacter)
+            {
+                m_default = Search(defaultCharacter);
+            }
+        }
+
+        const Glyph* Find(wchar_t character) const
+        {
+            uint32_t index = (uint32_t(character) < c_directCount) ? m_direct[character] : Search(character);
+            if (index == c_none)
+            {
+                index = m_default;
+            }
+
+            return (index != c_none) ? &m_glyphs[index] : nullptr;
+        }
+
+        bool IsEmpty() const { return m_glyphs.empty(); }
+
+    private:
+        static const uint32_t c_directCount = 256;
+        static const uint32_t c_none = UINT32_MAX;
+
+        uint32_t Search(wchar_t character) const
+        {
+            auto it = std::lower_bound(m_glyphs.cbegin(), m_glyphs.cend(), uint32_t(character),
+                [](const Glyph& glyph, uint32_t ch) { return glyph.character < ch; });
+
+            return (it != m_glyphs.cend() && it->character == uint32_t(character)) ? static_cast<uint32_t>(it - m_glyphs.cbegin()) : c_none;
+        }
+
+        std::vector<Glyph>  m_glyphs;
+        uint32_t            m_direct[c_directCount];
+        uint32_t            m_default;
+    };
+
+    // Text with a newline inserted at each wrap, and the index into it at which each line starts.
+    struct WrappedText
+    {
+        std::wstring        text;
+        std::vector<size_t> lineStarts;
+    };
+
+    // Wraps text to fit in width pixels, matching the bounds SpriteFont::MeasureDrawBounds gives the line.
+    // Lines are broken at the last whitespace or hyphen, which is replaced by the newline, or otherwise
+    // between characters. Newlines already in the text don't start a new entry in lineStarts.
+    inline void WordWrap(const GlyphAdvanceTable& glyphs, _In_reads_(length) const wchar_t* text, size_t length, long width, WrappedText& result)
+    {
+        result.text.clear();
+        result.text.reserve(length + length / 16);
+        result.lineStarts.clear();
+
+        if (!length)
+            return;
+
+        result.lineStarts.push_back(0);
+
+        size_t lastLine = 0;
+        size_t lastWord = 0;
+        size_t extra = 0;
+
+        // Pen position relative to the start of the line
+        float x = 0.f;
+
+        wchar_t prevch = 0;
+        size_t j = 0;
+        while (j < length)
+        {
+            const wchar_t ch = text[j];
+
+            result.text.push_back(ch);
+
+            if (iswspace(ch))
+            {
+                lastWord = j;
+            }
+            else if (prevch == L'-')
+            {
+                lastWord = j - 1;
+            }
+
+            const GlyphAdvanceTable::Glyph* glyph = nullptr;
+            float glyphX = 0.f;
+
+            if (ch == L'\n')
+            {
+                x = 0.f;
+            }
+            else if (ch != L'\r')
+            {
+                glyph = glyphs.Find(ch);
+                if (glyph)
+                {
+                    glyphX = std::max(x + glyph->xOffset, 0.f);
+                    x = glyphX + glyph->advance;
+                }
+            }
+
+            bool overflow = false;
+            if (glyph && !glyph->blank)
+            {
+                // Measured bounds are truncated to whole pixels
+                overflow = long(glyphX + std::max(glyph->advance, glyph->width)) > width;
+            }
+
+            // A line always takes at least one character, so a glyph wider than the line can't stall the wrap
+            const size_t lineStart = lastLine + extra;
+            if (overflow && result.text.length() - 1 > lineStart)
+            {
+                if (lastWord > lastLine)
+                {
+                    result.text.erase(result.text.cbegin() + ptrdiff_t(lastWord + extra), result.text.cend());
+                    result.text.push_back(L'\n');
+                    ++extra;
+                    lastLine = lastWord;
+                    j = lastWord + 1;
+                }
+                else
+                {
+                    result.text.back() = L'\n';
+                    ++extra;
+                    lastLine = lastWord = result.text.length() - extra;
+                }
+
+                result.lineStarts.push_back(lastLine + extra);
+
+                x = 0.f;
+                prevch = 0;
+                continue;
+            }
+
+            ++j;
+            prevch = ch;
+        }
+    }
+
+    // Caches wrapped text by the text, font and width. The least recently used results are discarded once
+    // there are more than maxEntries.
+    class TextLayoutCache
+    {
+    public:
+        explicit TextLayoutCache(size_t maxEntries = 256) :
+            m_maxEntries(std::max<size_t>(maxEntries, 1)),
+            m_hits(0),
+            m_misses(0)
+        {
+        }
+
+        TextLayoutCache(TextLayoutCache&&) = default;
+        TextLayoutCache& operator= (TextLayoutCache&&) = default;
+
+        TextLayoutCache(TextLayoutCache const&) = delete;
+        TextLayoutCache& operator=(TextLayoutCache const&) = delete;
+
+        // The result stays valid after it is evicted, or the cache is cleared.
+        std::shared_ptr<const WrappedText> WordWrap(const GlyphAdvanceTable& glyphs, _In_z_ const wchar_t* text, long width)
+        {
+            Key key;
+            key.glyphs = &glyphs;
+            key.width = width;
+            key.length = wcslen(text);
+            key.hash = Hash(text, key.length);
+
+            auto range = m_index.equal_range(key.hash);
+            for (auto it = range.first; it != range.second; ++it)
+            {
+                auto& entry = *it->second;
+                if (entry.key.glyphs == key.glyphs
+                    && entry.key.width == key.width
+                    && entry.key.length == key.length
+                    && memcmp(entry.source.c_str(), text, key.length * sizeof(wchar_t)) == 0)
+                {
+                    m_entries.splice(m_entries.begin(), m_entries, it->second);
+                    ++m_hits;
+                    return entry.result;
+                }
+            }
+
+            ++m_misses;
+
+            auto result = std::make_shared<WrappedText>();
+            ATG::WordWrap(glyphs, text, key.length, width, *result);
+
+            m_entries.emplace_front();
+            auto& entry = m_entries.front();
+            entry.key = key;
+            entry.source.assign(text, key.length);
+            entry.result = result;
+            m_index.emplace(key.hash, m_entries.begin());
+
+            while (m_entries.size() > m_maxEntries)
+            {
+                Evict(std::prev(m_entries.end()));
+            }
+
+            return result;
+        }
+
+        // Discards the results for a font, such as when it is released.
+        void Remove(const GlyphAdvanceTable& glyphs)
+        {
+            for (auto it = m_entries.begin(); it != m_entries.end();)
+            {
+                auto next = std::next(it);
+                if (it->key.glyphs == &glyphs)
+                {
+                    Evict(it);
+                }
+                it = next;
+            }
+        }
+
+        void Clear()
+        {
+            m_entries.clear();
+            m_index.clear();
+        }
+
+        size_t GetHits() const { return m_hits; }
+        size_t GetMisses() const { return m_misses; }
+
+    private:
+        struct Key
+        {
+            const GlyphAdvanceTable*    glyphs;
+            long                        width;
+            size_t                      length;
+            uint64_t                    hash;
+        };
+
+        struct Entry
+        {
+            Key                                 key;
+            std::wstring                        source;
+            std::shared_ptr<const WrappedText>  result;
+        };
+
+        typedef std::list<Entry> EntryList;
+
+        static uint64_t Hash(_In_reads_(length) const wchar_t* text, size_t length)
+        {
+            // FNV-1a
+            uint64_t hash = 14695981039346656037ull;
+            for (size_t j = 0; j < length; ++j)
+            {
+                hash ^= uint64_t(text[j]);
+                hash *= 1099511628211ull;
+            }
+            return hash;
+        }
+
+        void Evict(EntryList::iterator entry)
+        {
+            auto range = m_index.equal_range(entry->key.hash);
+            for (auto it = range.first; it != range.second; ++it)
+            {
+                if (it->second == entry)
+                {
+                    m_index.erase(it);
+                    break;
+                }
+            }
+
+            m_entries.erase(entry);
+        }
+
+        size_t                                                      m_maxEntries;
+        size_t                                                      m_hits;
+        size_t                                                      m_misses;
+        EntryList                                                   m_entries;
+        std::unordered_multimap<uint64_t, EntryList::iterator>      m_index;
+    };
+}
@@ -0,0 +1,164 @@
+//--------------------------------------------------------------------------------------
+// File: TextMessageQueue.h
+//
+// Multi-producer, single-consumer queue of text messages used by TextConsole
+//
+// Push can be called from any thread without blocking: a message is copied into a fixed-size ring
+// reserved with a compare-and-swap, and published by storing its size. Drain hands the complete
+// messages to the consumer in order. When the ring is full, messages are dropped and counted, and
+// Drain reports the count so the consumer can show it.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+#ifndef _In_reads_
+#define _In_reads_(size)
+#endif
+
+
+namespace DX
+{
+    class TextMessageQueue
+    {
+    public:
+        static const size_t c_capacityBytes = 128 * 1024;
+
+        TextMessageQueue() :
+            m_messages(new uint8_t[c_capacityBytes]),
+            m_reserve(0),
+            m_read(0),
+            m_dropped(0),
+            m_reportedDrops(0)
+        {
+            memset(m_messages.get(), 0, c_capacityBytes);
+        }
+
+        TextMessageQueue(TextMessageQueue const&) = delete;
+        TextMessageQueue& operator= (TextMessageQueue const&) = delete;
+
+        // Copies a message into the queue. Returns false if the queue is full and the message was dropped.
+        bool Push(const float color[4], _In_reads_(length) const wchar_t* str, size_t length, bool newLine)
+        {
+            // Very long messages are truncated so they always fit
+            length = std::min(length, (c_capacityBytes / 2 - sizeof(Header)) / sizeof(wchar_t));
+
+            uint64_t size = MessageSize(length);
+            uint64_t padding;
+
+            uint64_t reserve = m_reserve.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                // Messages don't wrap around the end of the queue, so skip to the start if there isn't room
+                uint64_t offset = reserve & (c_capacityBytes - 1);
+                padding = (offset + size > c_capacityBytes) ? (c_capacityBytes - offset) : 0;
+
+                if (reserve + padding + size - m_read.load(std::memory_order_acquire) > c_capacityBytes)
+                {
+                    m_dropped.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+
+                if (m_reserve.compare_exchange_weak(reserve, reserve + padding + size, std::memory_order_acq_rel, std::memory_order_relaxed))
+                    break;
+            }
+
+            if (padding)
+            {
+                auto header = reinterpret_cast<Header*>(m_messages.get() + (reserve & (c_capacityBytes - 1)));
+                header->length = 0;
+                header->flags = c_padding;
+                header->size.store(static_cast<uint32_t>(padding), std::memory_order_release);
+            }
+
+            auto header = reinterpret_cast<Header*>(m_messages.get() + ((reserve + padding) & (c_capacityBytes - 1)));
+            header->length = static_cast<uint32_t>(length);
+            header->flags = newLine ? c_newLine : 0;
+            memcpy(header->color, color, sizeof(header->color));
+            memcpy(static_cast<void*>(header + 1), str, length * sizeof(wchar_t));
+            header->size.store(static_cast<uint32_t>(size), std::memory_order_release);
+            return true;
+        }
+
+        // Calls message(color, str, length, newLine) for each complete message in order, then dropped(count) if
+        // messages have been dropped since the last call. Only one thread can drain at a time.
+        template<typename MessageFunc, typename DroppedFunc>
+        void Drain(MessageFunc message, DroppedFunc dropped)
+        {
+            // Drops are counted before draining, so the count is shown after any message that was written before them
+            uint32_t drops = m_dropped.load(std::memory_order_relaxed);
+
+            uint64_t read = m_read.load(std::memory_order_relaxed);
+            uint64_t end = m_reserve.load(std::memory_order_acquire);
+
+            while (read != end)
+            {
+                auto header = reinterpret_cast<Header*>(m_messages.get() + (read & (c_capacityBytes - 1)));
+
+                // Later messages wait for this one to be finished, to keep them in order
+                uint32_t size = header->size.load(std::memory_order_acquire);
+                if (!size)
+                    break;
+
+                if (!(header->flags & c_padding))
+                {
+                    message(header->color, reinterpret_cast<const wchar_t*>(header + 1), size_t(header->length), (header->flags & c_newLine) != 0);
+                }
+
+                // The space can be reused by any message, which must find no header until it is complete
+                memset(static_cast<void*>(header), 0, size);
+
+                read += size;
+                m_read.store(read, std::memory_order_release);
+            }
+
+            if (drops != m_reportedDrops)
+            {
+                dropped(drops - m_reportedDrops);
+                m_reportedDrops = drops;
+            }
+        }
+
+        // Number of messages dropped because the queue was full
+        uint32_t GetDropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    private:
+        // Messages are stored in the queue as a header followed by the text, in whole numbers of headers
+        // so a header always fits in the padding before the queue wraps.
+        struct Header
+        {
+            std::atomic<uint32_t>   size;       // Bytes including the header; 0 until the message is complete
+            uint32_t                length;     // Characters of text
+            uint32_t                flags;
+            uint32_t                reserved;
+            float                   color[4];
+        };
+
+        static_assert(sizeof(Header) == 32, "Header size mismatch");
+        static_assert((c_capacityBytes & (c_capacityBytes - 1)) == 0, "Queue size must be a power of 2");
+
+        static const uint32_t c_newLine = 0x1;
+        static const uint32_t c_padding = 0x2;
+
+        static uint64_t MessageSize(size_t length)
+        {
+            size_t bytes = sizeof(Header) + length * sizeof(wchar_t);
+            return (bytes + sizeof(Header) - 1) & ~(sizeof(Header) - 1);
+        }
+
+        std::unique_ptr<uint8_t[]>  m_messages;
+        std::atomic<uint64_t>       m_reserve;
+        std::atomic<uint64_t>       m_read;
+        std::atomic<uint32_t>       m_dropped;
+        uint32_t                    m_reportedDrops;    // Owned by the consumer
+    };
+}
@@ -0,0 +1,99 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Compiles .csv UI layouts for ATG::UIManager into .uilayout files, which LoadLayout maps and uses without
+// parsing when they are current with their .csv (see SampleGUILayout.h). Run it on a sample's
+// Assets\SampleUI.csv before deploying, and deploy the SampleUI.uilayout it writes next to the .csv.
+//
+// The stamp recorded for the .csv is its size and last write time, so compile on the machine the
+// layouts are deployed from, and recompile whenever the .csv changes.
+//
+// Usage: CompileUILayout [-o <output.uilayout>] <layout.csv>...
+//
+// -o names the output when there is one input; otherwise each .uilayout is written next to its .csv.
+//
+
+#include "pch.h"
+#include "SampleGUILayout.h"
+
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <vector>
+
+using namespace ATG;
+
+namespace
+{
+    std::wstring Widen(const char* str)
+    {
+        size_t length = mbstowcs(nullptr, str, 0);
+        if (length == static_cast<size_t>(-1))
+            return std::wstring();
+
+        std::wstring result(length, L'\0');
+        mbstowcs(&result[0], str, length);
+        return result;
+    }
+
+    void Usage()
+    {
+        printf("Usage: CompileUILayout [-o <output.uilayout>] <layout.csv>...\n");
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const char* output = nullptr;
+    std::vector<const char*> inputs;
+
+    for (int j = 1; j < argc; ++j)
+    {
+        if (strcmp(argv[j], "-o") == 0 && j + 1 < argc)
+        {
+            output = argv[++j];
+        }
+        else if (argv[j][0] == '-')
+        {
+            Usage();
+            return 1;
+        }
+        else
+        {
+            inputs.push_back(argv[j]);
+        }
+    }
+
+    if (inputs.empty() || (output && inputs.size() > 1))
+    {
+        Usage();
+        return 1;
+    }
+
+    for (auto input : inputs)
+    {
+        std::wstring layoutFile = Widen(input);
+        std::wstring compiledFile = (output) ? Widen(output) : ReplaceLayoutExtension(layoutFile.c_str(), c_CompiledLayoutExt);
+        if (layoutFile.empty() || compiledFile.empty())
+        {
+            printf("ERROR: %s: invalid file name\n", input);
+            return 1;
+        }
+
+        try
+        {
+            CompileLayoutFile(layoutFile.c_str(), compiledFile.c_str());
+        }
+        catch (const std::exception& e)
+        {
+            printf("ERROR: %s: %s\n", input, e.what());
+            return 1;
+        }
+
+        printf("%s -> %ls\n", input, compiledFile.c_str());
+    }
+
+    return 0;
+}
@@ -550,6 +550,36 @@ namespace
 
         return (*bytesRead < fileInfo.EndOfFile.LowPart) ? E_FAIL : S_OK;
     }
+
+
+    //---------------------------------------------------------------------------------
+    HRESULT MapAudioFromFile(
+        _In_z_ const wchar_t* szFileName,
+        _Inout_ DX::MappedFile& wavData)
+    {
+        if (!szFileName)
+            return E_INVALIDARG;
+
+        HRESULT hr = wavData.Open(szFileName);
+        if (FAILED(hr))
+            return hr;
+
+        // File is too big for 32-bit audio sizes
+        if (wavData.GetSize() > UINT32_MAX)
+        {
+            wavData.Close();
+            return E_FAIL;
+        }
+
+        // Need at least enough data to have a valid minimal WAV file
+        if (wavData.GetSize() < (sizeof(RIFFChunk) * 2 + sizeof(DWORD) + sizeof(WAVEFORMAT)))
+        {
+            wavData.Close();
+            return E_FAIL;
+        }
+
+        return S_OK;
+    }
 }
 
 //-------------------------------------------------------------------------------------
@@ -615,6 +645,32 @@ HRESULT DX::LoadWAVAudioFromFile(
 }
 
 
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DX::LoadWAVAudioFromFile(
+    const wchar_t* szFileName,
+    MappedFile& wavData,
+    const WAVEFORMATEX** wfx,
+    const uint8_t** startAudio,
+    uint32_t* audioBytes)
+{
+    if (!szFileName || !wfx || !startAudio || !audioBytes)
+        return E_INVALIDARG;
+
+    *wfx = nullptr;
+    *startAudio = nullptr;
+    *audioBytes = 0;
+
+    HRESULT hr = MapAudioFromFile(szFileName, wavData);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    return LoadWAVAudioInMemory(wavData.GetData(), wavData.GetSize(), wfx, startAudio, audioBytes);
+}
+
+
 //-------------------------------------------------------------------------------------
 _Use_decl_annotations_
 HRESULT DX::LoadWAVAudioInMemoryEx(
@@ -703,3 +759,24 @@ HRESULT DX::LoadWAVAudioFromFileEx(
     return S_OK;
 }
 
+
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DX::LoadWAVAudioFromFileEx(
+    const wchar_t* szFileName,
+    MappedFile& wavData,
+    DX::WAVData& result)
+{
+    if (!szFileName)
+        return E_INVALIDARG;
+
+    memset(&result, 0, sizeof(result));
+
+    HRESULT hr = MapAudioFromFile(szFileName, wavData);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    return LoadWAVAudioInMemoryEx(wavData.GetData(), wavData.GetSize(), result);
+}
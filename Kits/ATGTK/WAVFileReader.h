@@ -14,6 +14,8 @@
 #include <memory>
 #include <mmreg.h>
 
+#include "MappedFile.h"
+
 #if defined(_XBOX_ONE) && defined(_TITLE)
 #include <xma2defs.h>
 #endif
@@ -60,6 +62,15 @@ namespace DX
         _Outptr_ const uint8_t** startAudio,
         _Out_ uint32_t* audioBytes);
 
+    // Maps the file read-only instead of reading it in; startAudio points into the mapping, which must
+    // stay open while the audio is in use.
+    HRESULT LoadWAVAudioFromFile(
+        _In_z_ const wchar_t* szFileName,
+        _Inout_ MappedFile& wavData,
+        _Outptr_ const WAVEFORMATEX** wfx,
+        _Outptr_ const uint8_t** startAudio,
+        _Out_ uint32_t* audioBytes);
+
     struct WAVData
     {
         const WAVEFORMATEX* wfx;
@@ -140,4 +151,9 @@ namespace DX
         _In_z_ const wchar_t* szFileName,
         _Inout_ std::unique_ptr<uint8_t[]>& wavData,
         _Out_ WAVData& result);
+
+    HRESULT LoadWAVAudioFromFileEx(
+        _In_z_ const wchar_t* szFileName,
+        _Inout_ MappedFile& wavData,
+        _Out_ WAVData& result);
 }
\ No newline at end of file
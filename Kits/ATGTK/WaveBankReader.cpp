@@ -6,6 +6,7 @@
 //
 #include "pch.h"
 #include "WaveBankReader.h"
+#include "MappedFile.h"
 
 #include <map>
 #include <string>
@@ -429,7 +430,8 @@ class WaveBankReader::Impl
 public:
     Impl() :
         m_async( INVALID_HANDLE_VALUE ),
-        m_prepared(false)
+        m_prepared(false),
+        m_mappedWaveData(nullptr)
 #if defined(_XBOX_ONE) && defined(_TITLE)
         , m_xmaMemory(nullptr)
 #endif
@@ -441,7 +443,7 @@ public:
 
     ~Impl() { Close(); }
 
-    HRESULT Open( _In_z_ const wchar_t* szFileName );
+    HRESULT Open( _In_z_ const wchar_t* szFileName, bool memoryMapped );
     void Close();
 
     HRESULT GetFormat( _In_ uint32_t index, _Out_writes_bytes_(maxsize) WAVEFORMATEX* pFormat, _In_ size_t maxsize ) const;
@@ -487,6 +489,10 @@ private:
     std::unique_ptr<uint8_t[]>          m_seekData;
     std::unique_ptr<uint8_t[]>          m_waveData;
 
+    // Read-only view of the whole bank for memory-mapped in-memory banks
+    DX::MappedFile                      m_mapping;
+    const uint8_t*                      m_mappedWaveData;
+
 #if defined(_XBOX_ONE) && defined(_TITLE)
 public:
     void*                               m_xmaMemory;
@@ -495,7 +501,7 @@ public:
 
 
 _Use_decl_annotations_
-HRESULT WaveBankReader::Impl::Open( const wchar_t* szFileName )
+HRESULT WaveBankReader::Impl::Open( const wchar_t* szFileName, bool memoryMapped )
 {
     Close();
     Clear();
@@ -844,9 +850,6 @@ HRESULT WaveBankReader::Impl::Open( const wchar_t* szFileName )
     }
     else
     {
-        // If in-memory, kick off read of wave data
-        void *dest;
-
 #if defined(_XBOX_ONE) && defined(_TITLE)
         bool xma = false;
         if ( m_data.dwFlags & BANKDATA::FLAGS_COMPACT )
@@ -866,7 +869,36 @@ HRESULT WaveBankReader::Impl::Open( const wchar_t* szFileName )
                 }
             }
         }
+#else
+        const bool xma = false;
+#endif
+
+        if ( memoryMapped && !xma )
+        {
+            // Point straight into a read-only mapping of the file, so wave data is paged in as it is played.
+            // XMA has to be in APU memory, so is always read.
+            hFile.reset();
+
+            HRESULT hr = m_mapping.Open( szFileName );
+            if ( FAILED(hr) )
+                return hr;
+
+            uint64_t waveEnd = uint64_t( m_header.Segments[HEADER::SEGIDX_ENTRYWAVEDATA].dwOffset ) + waveLen;
+            if ( waveEnd > m_mapping.GetSize() )
+            {
+                m_mapping.Close();
+                return HRESULT_FROM_WIN32( ERROR_HANDLE_EOF );
+            }
 
+            m_mappedWaveData = m_mapping.GetData() + m_header.Segments[HEADER::SEGIDX_ENTRYWAVEDATA].dwOffset;
+            m_prepared = true;
+            return S_OK;
+        }
+
+        // If in-memory, kick off read of wave data
+        void *dest;
+
+#if defined(_XBOX_ONE) && defined(_TITLE)
         if ( xma )
         {
             HRESULT hr = ApuAlloc( &m_xmaMemory, nullptr, waveLen, SHAPE_XMA_INPUT_BUFFER_ALIGNMENT );
@@ -931,6 +963,9 @@ void WaveBankReader::Impl::Close()
     }
     m_event.reset();
 
+    m_mappedWaveData = nullptr;
+    m_mapping.Close();
+
 #if defined(_XBOX_ONE) && defined(_TITLE)
     if ( m_xmaMemory )
     {
@@ -1094,6 +1129,9 @@ HRESULT WaveBankReader::Impl::GetWaveData( uint32_t index, const uint8_t** pData
     const uint8_t* waveData = m_waveData.get();
 #endif
 
+    if ( m_mappedWaveData )
+        waveData = m_mappedWaveData;
+
     if ( !waveData )
         return E_FAIL;
 
@@ -1263,9 +1301,9 @@ WaveBankReader::~WaveBankReader()
 
 
 _Use_decl_annotations_
-HRESULT WaveBankReader::Open( const wchar_t* szFileName )
+HRESULT WaveBankReader::Open( const wchar_t* szFileName, bool memoryMapped )
 {
-    return pImpl->Open( szFileName );
+    return pImpl->Open( szFileName, memoryMapped );
 }
 
 
@@ -1343,6 +1381,12 @@ uint32_t WaveBankReader::BankAudioSize() const
 }
 
 
+uint32_t WaveBankReader::BankAudioOffset() const
+{
+    return pImpl->m_header.Segments[HEADER::SEGIDX_ENTRYWAVEDATA].dwOffset;
+}
+
+
 _Use_decl_annotations_
 HRESULT WaveBankReader::GetFormat( uint32_t index, WAVEFORMATEX* pFormat, size_t maxsize ) const
 {
@@ -25,7 +25,9 @@ namespace DX
 
         ~WaveBankReader();
 
-        HRESULT Open( _In_z_ const wchar_t* szFileName );
+        // For in-memory banks, memoryMapped maps the file read-only rather than reading in the wave data, so
+        // GetWaveData points into the mapping and pages are only loaded as they are touched.
+        HRESULT Open( _In_z_ const wchar_t* szFileName, bool memoryMapped = false );
 
         uint32_t Find( _In_z_ const char* name ) const;
 
@@ -45,6 +47,9 @@ namespace DX
 
         uint32_t BankAudioSize() const;
 
+        // File offset of the wave data, which Metadata::offsetBytes is relative to.
+        uint32_t BankAudioOffset() const;
+
         HRESULT GetFormat( _In_ uint32_t index, _Out_writes_bytes_(maxsize) WAVEFORMATEX* pFormat, _In_ size_t maxsize ) const;
 
         HRESULT GetWaveData( _In_ uint32_t index, _Outptr_ const uint8_t** pData, _Out_ uint32_t& dataSize ) const;
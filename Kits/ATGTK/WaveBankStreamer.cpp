@@ -0,0 +1,986 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Streaming playback reads for Wave Banks
+//
+#include "pch.h"
+#include "WaveBankStreamer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <stdexcept>
+#include <vector>
+
+#if defined(_XBOX_ONE) && defined(_TITLE)
+#include <apu.h>
+#endif
+
+
+namespace
+{
+
+#ifdef _WIN32
+struct handle_closer { void operator()(HANDLE h) { if (h) CloseHandle(h); } };
+
+typedef std::unique_ptr<void, handle_closer> ScopedHandle;
+
+static const uint32_t XMA_PACKET_SIZE = 2048;
+static const uint32_t DEFAULT_SECTOR_SIZE = 4096;
+#endif
+
+inline uint64_t AlignDown( uint64_t value, uint32_t alignment ) { return value & ~uint64_t( alignment - 1 ); }
+inline uint64_t AlignUp( uint64_t value, uint32_t alignment ) { return ( value + alignment - 1 ) & ~uint64_t( alignment - 1 ); }
+
+inline bool IsPow2( uint32_t value ) { return value && !( value & ( value - 1 ) ); }
+
+
+//--------------------------------------------------------------------------------------
+// Sector-aligned read buffers. On Xbox One these come from APU memory so XMA can be decoded in place.
+struct aligned_deleter
+{
+    void operator()( uint8_t* p )
+    {
+#if defined(_XBOX_ONE) && defined(_TITLE)
+        if ( p ) ApuFree( p );
+#elif defined(_WIN32)
+        _aligned_free( p );
+#else
+        free( p );
+#endif
+    }
+};
+
+typedef std::unique_ptr<uint8_t, aligned_deleter> AlignedBuffer;
+
+AlignedBuffer AllocateAligned( size_t size, uint32_t alignment )
+{
+#if defined(_XBOX_ONE) && defined(_TITLE)
+    void* ptr = nullptr;
+    if ( FAILED( ApuAlloc( &ptr, nullptr, static_cast<UINT32>( size ), std::max<UINT32>( alignment, SHAPE_XMA_INPUT_BUFFER_ALIGNMENT ) ) ) )
+        return AlignedBuffer();
+    return AlignedBuffer( reinterpret_cast<uint8_t*>( ptr ) );
+#elif defined(_WIN32)
+    return AlignedBuffer( reinterpret_cast<uint8_t*>( _aligned_malloc( size, alignment ) ) );
+#else
+    // aligned_alloc needs a size which is a multiple of the alignment
+    return AlignedBuffer( reinterpret_cast<uint8_t*>( aligned_alloc( alignment, static_cast<size_t>( AlignUp( size, alignment ) ) ) ) );
+#endif
+}
+
+
+#ifdef _WIN32
+//--------------------------------------------------------------------------------------
+// Overlapped I/O backend
+class OverlappedReadBackend : public DX::IStreamingReadBackend
+{
+public:
+    OverlappedReadBackend( HANDLE hAsync, uint32_t maxRequests ) :
+        m_async( hAsync ),
+        m_sectorSize( DEFAULT_SECTOR_SIZE ),
+        m_slots( maxRequests )
+    {
+    }
+
+    ~OverlappedReadBackend()
+    {
+        CancelAll();
+    }
+
+    HRESULT Initialize()
+    {
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+        // Unbuffered reads must be aligned to the physical sector size of the volume
+        FILE_STORAGE_INFO info = {};
+        if ( GetFileInformationByHandleEx( m_async, FileStorageInfo, &info, sizeof(info) ) )
+        {
+            uint32_t sectorSize = info.FileSystemEffectivePhysicalBytesPerSectorForAtomicity;
+            if ( IsPow2( sectorSize ) && sectorSize > m_sectorSize )
+            {
+                m_sectorSize = sectorSize;
+            }
+        }
+#endif
+
+        for( auto& slot : m_slots )
+        {
+#if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
+            slot.event.reset( CreateEventEx( nullptr, nullptr, CREATE_EVENT_MANUAL_RESET, EVENT_MODIFY_STATE | SYNCHRONIZE ) );
+#else
+            slot.event.reset( CreateEvent( nullptr, TRUE, FALSE, nullptr ) );
+#endif
+            if ( !slot.event )
+            {
+                return HRESULT_FROM_WIN32( GetLastError() );
+            }
+        }
+
+        return S_OK;
+    }
+
+    HRESULT Submit( DX::StreamingReadRequest* request ) override
+    {
+        if ( !request )
+            return E_INVALIDARG;
+
+        auto it = std::find_if( m_slots.begin(), m_slots.end(), []( const Slot& slot ) { return slot.request == nullptr; } );
+        if ( it == m_slots.end() )
+            return HRESULT_FROM_WIN32( ERROR_BUSY );
+
+        memset( &it->overlapped, 0, sizeof(OVERLAPPED) );
+        it->overlapped.Offset = static_cast<DWORD>( request->offset );
+        it->overlapped.OffsetHigh = static_cast<DWORD>( request->offset >> 32 );
+        it->overlapped.hEvent = it->event.get();
+
+        request->bytesRead = 0;
+        request->result = E_PENDING;
+
+        if ( !ReadFile( m_async, request->dest, request->size, nullptr, &it->overlapped ) )
+        {
+            DWORD error = GetLastError();
+            if ( error != ERROR_IO_PENDING )
+            {
+                request->result = HRESULT_FROM_WIN32( error );
+                m_completed.push_back( request );
+                return S_OK;
+            }
+        }
+
+        it->request = request;
+        return S_OK;
+    }
+
+    DX::StreamingReadRequest* GetCompleted() override
+    {
+        if ( !m_completed.empty() )
+        {
+            auto request = m_completed.front();
+            m_completed.pop_front();
+            return request;
+        }
+
+        for( auto& slot : m_slots )
+        {
+            if ( slot.request && HasOverlappedIoCompleted( &slot.overlapped ) )
+            {
+                return Complete( slot, FALSE );
+            }
+        }
+
+        return nullptr;
+    }
+
+    void CancelAll() override
+    {
+        bool pending = std::any_of( m_slots.cbegin(), m_slots.cend(), []( const Slot& slot ) { return slot.request != nullptr; } );
+        if ( !pending )
+            return;
+
+        (void)CancelIoEx( m_async, nullptr );
+
+        for( auto& slot : m_slots )
+        {
+            if ( slot.request )
+            {
+                m_completed.push_back( Complete( slot, TRUE ) );
+            }
+        }
+    }
+
+    uint32_t SectorSize() const override { return m_sectorSize; }
+
+private:
+    struct Slot
+    {
+        Slot() : request( nullptr ) { memset( &overlapped, 0, sizeof(OVERLAPPED) ); }
+
+        OVERLAPPED                  overlapped;
+        ScopedHandle                event;
+        DX::StreamingReadRequest*   request;
+    };
+
+    DX::StreamingReadRequest* Complete( Slot& slot, BOOL wait )
+    {
+        auto request = slot.request;
+
+        DWORD bytes = 0;
+        if ( GetOverlappedResult( m_async, &slot.overlapped, &bytes, wait ) )
+        {
+            request->bytesRead = bytes;
+            request->result = S_OK;
+        }
+        else
+        {
+            request->result = HRESULT_FROM_WIN32( GetLastError() );
+        }
+
+        slot.request = nullptr;
+        return request;
+    }
+
+    HANDLE                                  m_async;
+    uint32_t                                m_sectorSize;
+    std::vector<Slot>                       m_slots;
+    std::deque<DX::StreamingReadRequest*>   m_completed;
+};
+#endif
+
+
+} // anonymous namespace
+
+
+#ifdef _WIN32
+_Use_decl_annotations_
+HRESULT DX::CreateOverlappedReadBackend( HANDLE hAsync, uint32_t maxRequests, std::unique_ptr<IStreamingReadBackend>& backend )
+{
+    backend.reset();
+
+    if ( !hAsync || hAsync == INVALID_HANDLE_VALUE || !maxRequests )
+        return E_INVALIDARG;
+
+    std::unique_ptr<OverlappedReadBackend> result( new (std::nothrow) OverlappedReadBackend( hAsync, maxRequests ) );
+    if ( !result )
+        return E_OUTOFMEMORY;
+
+    HRESULT hr = result->Initialize();
+    if ( FAILED(hr) )
+        return hr;
+
+    backend = std::move( result );
+    return S_OK;
+}
+#endif
+
+
+using namespace DX;
+
+//--------------------------------------------------------------------------------------
+class WaveBankStreamer::Impl
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    Impl( const WaveBankReader* bank, std::unique_ptr<IStreamingReadBackend> backend, const Settings& settings ) :
+        m_bank( bank ),
+        m_backend( std::move( backend ) ),
+        m_settings( settings ),
+        m_sectorSize( 0 ),
+        m_readsInFlight( 0 ),
+        m_totalLatency( 0 )
+    {
+        if ( !m_backend )
+            throw std::runtime_error( "WaveBankStreamer requires a read backend" );
+
+#ifdef _WIN32
+        if ( m_bank && !m_bank->IsStreamingBank() )
+            throw std::runtime_error( "WaveBankStreamer requires a streaming wave bank" );
+#endif
+
+        m_sectorSize = m_backend->SectorSize();
+        m_settings.maxStreams = std::max<uint32_t>( m_settings.maxStreams, 1 );
+        m_settings.buffersPerStream = std::max<uint32_t>( m_settings.buffersPerStream, 2 );
+        m_settings.maxReadsInFlight = std::max<uint32_t>( m_settings.maxReadsInFlight, 1 );
+        m_settings.bufferSize = static_cast<uint32_t>( AlignUp( std::max( m_settings.bufferSize, m_sectorSize ), m_sectorSize ) );
+
+        m_streams.resize( m_settings.maxStreams );
+        for( auto& stream : m_streams )
+        {
+            stream.slots.resize( m_settings.buffersPerStream );
+        }
+
+        ResetStatistics();
+    }
+
+    ~Impl()
+    {
+        m_backend->CancelAll();
+        while ( m_backend->GetCompleted() ) {}
+    }
+
+#ifdef _WIN32
+    uint32_t Start( uint32_t index, bool loop );
+#endif
+    uint32_t Start( const StreamingWave& wave, bool loop );
+    void Stop( uint32_t stream );
+    void Update();
+    bool AcquireBuffer( uint32_t stream, Buffer& buffer );
+    void ReleaseBuffer( uint32_t stream );
+
+    bool IsActive( uint32_t stream ) const
+    {
+        return ( stream < m_streams.size() ) && m_streams[ stream ].active;
+    }
+
+    HRESULT GetStreamError( uint32_t stream ) const
+    {
+        return ( stream < m_streams.size() ) ? m_streams[ stream ].error : E_INVALIDARG;
+    }
+
+    uint32_t GetBuffersQueued( uint32_t stream ) const
+    {
+        if ( stream >= m_streams.size() )
+            return 0;
+
+        auto& s = m_streams[ stream ];
+        return s.acquireSeq - s.releaseSeq;
+    }
+
+    Statistics GetStatistics() const
+    {
+        Statistics stats = m_stats;
+        stats.queueDepth = 0;
+        for( auto& stream : m_streams )
+        {
+            for( auto& slot : stream.slots )
+            {
+                if ( slot.state == Slot::QUEUED || slot.state == Slot::RETRY )
+                    ++stats.queueDepth;
+            }
+        }
+        stats.readsInFlight = m_readsInFlight;
+        stats.averageReadLatencyMs = ( m_stats.readsCompleted > 0 ) ? ( m_totalLatency * 1000.0 / double( m_stats.readsCompleted ) ) : 0.0;
+        return stats;
+    }
+
+    void ResetStatistics()
+    {
+        memset( &m_stats, 0, sizeof(m_stats) );
+        m_totalLatency = 0;
+    }
+
+private:
+    struct Slot : public StreamingReadRequest
+    {
+        // A failed read waits in RETRY until the next Update queues it again
+        enum State { FREE, QUEUED, READING, READY, ACQUIRED, RETRY, FAILED };
+
+        Slot() :
+            state( FREE ),
+            stream( 0 ),
+            generation( 0 ),
+            retries( 0 ),
+            capacity( 0 ),
+            skip( 0 ),
+            length( 0 ),
+            endOfStream( false ),
+            deadline( 0 )
+        {
+            offset = 0;
+            dest = nullptr;
+            size = 0;
+            bytesRead = 0;
+            result = S_OK;
+        }
+
+        State                   state;
+        uint32_t                stream;
+        uint32_t                generation;
+        uint32_t                retries;
+        AlignedBuffer           memory;
+        size_t                  capacity;
+        uint32_t                skip;           // Offset of the audio data in the buffer
+        uint32_t                length;         // Bytes of audio data
+        bool                    endOfStream;
+        std::vector<uint32_t>   seekTable;
+        double                  deadline;
+        Clock::time_point       issued;
+    };
+
+    struct Stream
+    {
+        Stream() :
+            active( false ),
+            loop( false ),
+            starved( false ),
+            endQueued( false ),
+            error( S_OK ),
+            generation( 0 ),
+            waveOffset( 0 ),
+            waveLength( 0 ),
+            readPos( 0 ),
+            bytesPerBuffer( 0 ),
+            blockAlign( 1 ),
+            bytesPerSecond( 1.0 ),
+            readSeq( 0 ),
+            acquireSeq( 0 ),
+            releaseSeq( 0 ),
+            runOut( 0 ),
+            seekTable( nullptr ),
+            seekTableCount( 0 )
+        {
+        }
+
+        bool                active;
+        bool                loop;
+        bool                starved;
+        bool                endQueued;
+        HRESULT             error;          // Set once a read has failed for good
+        uint32_t            generation;
+        uint64_t            waveOffset;     // Absolute file offset of the wave data
+        uint32_t            waveLength;
+        uint32_t            readPos;        // Next position to read, relative to waveOffset
+        uint32_t            bytesPerBuffer;
+        uint32_t            blockAlign;
+        double              bytesPerSecond;
+        uint32_t            readSeq;        // Buffers are read, acquired and released in sequence
+        uint32_t            acquireSeq;
+        uint32_t            releaseSeq;
+        double              runOut;         // Time at which acquired audio will have finished playing
+        const uint32_t*     seekTable;      // xWMA decoded packet cumulative bytes
+        uint32_t            seekTableCount;
+        std::vector<Slot>   slots;
+
+        Slot& SlotFor( uint32_t seq ) { return slots[ seq % slots.size() ]; }
+    };
+
+    double Now() const
+    {
+        return std::chrono::duration<double>( Clock::now() - m_epoch ).count();
+    }
+
+    double Duration( const Stream& stream, uint32_t length ) const
+    {
+        return double( length ) / stream.bytesPerSecond;
+    }
+
+    void QueueReads( uint32_t streamIndex );
+    void IssueReads();
+    void OnReadComplete( Slot& slot );
+    void OnReadFailed( Slot& slot, HRESULT hr, bool retry );
+
+    const WaveBankReader*                   m_bank;
+    std::unique_ptr<IStreamingReadBackend>  m_backend;
+    Settings                                m_settings;
+    uint32_t                                m_sectorSize;
+    std::vector<Stream>                     m_streams;
+
+    uint32_t                                m_readsInFlight;
+    Statistics                              m_stats;
+    double                                  m_totalLatency;
+
+    const Clock::time_point                 m_epoch = Clock::now();
+};
+
+
+#ifdef _WIN32
+uint32_t WaveBankStreamer::Impl::Start( uint32_t index, bool loop )
+{
+    if ( !m_bank )
+        return c_InvalidStream;
+
+    WaveBankReader::Metadata metadata;
+    if ( FAILED( m_bank->GetMetadata( index, metadata ) ) || !metadata.lengthBytes )
+        return c_InvalidStream;
+
+    uint8_t formatBuff[ 64 ] = {};
+    auto format = reinterpret_cast<WAVEFORMATEX*>( formatBuff );
+    if ( FAILED( m_bank->GetFormat( index, format, sizeof(formatBuff) ) ) )
+        return c_InvalidStream;
+
+    const uint32_t* seekTable = nullptr;
+    uint32_t seekTableCount = 0;
+    uint32_t tag = 0;
+    if ( FAILED( m_bank->GetSeekTable( index, &seekTable, seekTableCount, tag ) ) )
+        return c_InvalidStream;
+
+    StreamingWave wave = {};
+    wave.offset = uint64_t( m_bank->BankAudioOffset() ) + metadata.offsetBytes;
+    wave.length = metadata.lengthBytes;
+    wave.bytesPerSecond = format->nAvgBytesPerSec;
+
+    // Buffers hold whole blocks: XMA packets, xWMA packets, or PCM/ADPCM blocks
+    switch( format->wFormatTag )
+    {
+    case 0x166 /* WAVE_FORMAT_XMA2 */:
+        wave.blockAlign = XMA_PACKET_SIZE;
+        break;
+
+    default:
+        wave.blockAlign = format->nBlockAlign;
+        break;
+    }
+
+    if ( tag == WAVE_FORMAT_WMAUDIO2 || tag == WAVE_FORMAT_WMAUDIO3 )
+    {
+        wave.seekTable = seekTable;
+        wave.seekTableCount = seekTableCount;
+    }
+
+    return Start( wave, loop );
+}
+#endif
+
+
+uint32_t WaveBankStreamer::Impl::Start( const StreamingWave& wave, bool loop )
+{
+    if ( !wave.length )
+        return c_InvalidStream;
+
+    // Streams that were stopped with reads in flight or buffers still acquired can't be reused until
+    // those finish or are released
+    uint32_t streamIndex = 0;
+    for( ; streamIndex < m_streams.size(); ++streamIndex )
+    {
+        auto& stream = m_streams[ streamIndex ];
+        if ( !stream.active
+             && std::none_of( stream.slots.cbegin(), stream.slots.cend(), []( const Slot& slot ) { return slot.state == Slot::READING || slot.state == Slot::ACQUIRED; } ) )
+            break;
+    }
+
+    if ( streamIndex >= m_streams.size() )
+        return c_InvalidStream;
+
+    auto& stream = m_streams[ streamIndex ];
+
+    stream.blockAlign = std::max<uint32_t>( wave.blockAlign, 1 );
+    stream.seekTable = wave.seekTable;
+    stream.seekTableCount = wave.seekTable ? wave.seekTableCount : 0;
+
+    stream.bytesPerBuffer = std::max( stream.blockAlign, ( m_settings.bufferSize / stream.blockAlign ) * stream.blockAlign );
+
+    // Reads can start part way into a sector, so leave room for one more
+    size_t capacity = static_cast<size_t>( AlignUp( stream.bytesPerBuffer, m_sectorSize ) ) + m_sectorSize;
+    for( auto& slot : stream.slots )
+    {
+        if ( slot.capacity < capacity )
+        {
+            slot.memory = AllocateAligned( capacity, m_sectorSize );
+            if ( !slot.memory )
+            {
+                slot.capacity = 0;
+                return c_InvalidStream;
+            }
+            slot.capacity = capacity;
+        }
+        slot.state = Slot::FREE;
+    }
+
+    stream.active = true;
+    stream.loop = loop;
+    stream.starved = false;
+    stream.endQueued = false;
+    stream.error = S_OK;
+    ++stream.generation;
+    stream.waveOffset = wave.offset;
+    stream.waveLength = wave.length;
+    stream.readPos = 0;
+    stream.bytesPerSecond = std::max<double>( wave.bytesPerSecond, 1.0 );
+    stream.readSeq = stream.acquireSeq = stream.releaseSeq = 0;
+    stream.runOut = Now();
+
+    QueueReads( streamIndex );
+    IssueReads();
+
+    return streamIndex;
+}
+
+
+void WaveBankStreamer::Impl::Stop( uint32_t streamIndex )
+{
+    if ( !IsActive( streamIndex ) )
+        return;
+
+    auto& stream = m_streams[ streamIndex ];
+    stream.active = false;
+    ++stream.generation;
+
+    for( auto& slot : stream.slots )
+    {
+        // Reads in flight are freed when they complete, and acquired buffers when they are released
+        if ( slot.state != Slot::READING && slot.state != Slot::ACQUIRED )
+            slot.state = Slot::FREE;
+    }
+}
+
+
+void WaveBankStreamer::Impl::Update()
+{
+    // Reads which failed since the last update go back in the queue
+    for( auto& stream : m_streams )
+    {
+        for( auto& slot : stream.slots )
+        {
+            if ( slot.state == Slot::RETRY )
+                slot.state = Slot::QUEUED;
+        }
+    }
+
+    while ( auto request = m_backend->GetCompleted() )
+    {
+        OnReadComplete( *static_cast<Slot*>( request ) );
+    }
+
+    for( uint32_t j = 0; j < m_streams.size(); ++j )
+    {
+        QueueReads( j );
+    }
+
+    IssueReads();
+}
+
+
+bool WaveBankStreamer::Impl::AcquireBuffer( uint32_t streamIndex, Buffer& buffer )
+{
+    memset( &buffer, 0, sizeof(Buffer) );
+
+    if ( !IsActive( streamIndex ) )
+        return false;
+
+    auto& stream = m_streams[ streamIndex ];
+
+    if ( stream.acquireSeq == stream.readSeq && stream.endQueued )
+        return false;
+
+    // The buffers read before a failed read still play. The failed read itself isn't waited on, so isn't an underrun.
+    auto& slot = stream.SlotFor( stream.acquireSeq );
+    if ( slot.state == Slot::FAILED || ( FAILED( stream.error ) && slot.state != Slot::READY ) )
+        return false;
+
+    if ( slot.state != Slot::READY )
+    {
+        // Only count the first miss while a stream is waiting on its reads
+        if ( !stream.starved )
+        {
+            stream.starved = true;
+            ++m_stats.underruns;
+        }
+        return false;
+    }
+
+    buffer.data = slot.memory.get() + slot.skip;
+    buffer.size = slot.length;
+    buffer.seekTable = slot.seekTable.empty() ? nullptr : slot.seekTable.data();
+    buffer.seekTableCount = static_cast<uint32_t>( slot.seekTable.size() );
+    buffer.endOfStream = slot.endOfStream;
+
+    slot.state = Slot::ACQUIRED;
+    ++stream.acquireSeq;
+    stream.starved = false;
+    stream.runOut = std::max( stream.runOut, Now() ) + Duration( stream, slot.length );
+
+    return true;
+}
+
+
+void WaveBankStreamer::Impl::ReleaseBuffer( uint32_t streamIndex )
+{
+    // Stopped streams still release the buffers their voice was playing
+    if ( streamIndex >= m_streams.size() )
+        return;
+
+    auto& stream = m_streams[ streamIndex ];
+    if ( stream.releaseSeq == stream.acquireSeq )
+        return;
+
+    auto& slot = stream.SlotFor( stream.releaseSeq );
+    assert( slot.state == Slot::ACQUIRED );
+    slot.state = Slot::FREE;
+    ++stream.releaseSeq;
+
+    QueueReads( streamIndex );
+    IssueReads();
+}
+
+
+void WaveBankStreamer::Impl::QueueReads( uint32_t streamIndex )
+{
+    auto& stream = m_streams[ streamIndex ];
+    if ( !stream.active || FAILED( stream.error ) )
+        return;
+
+    while ( !stream.endQueued )
+    {
+        auto& slot = stream.SlotFor( stream.readSeq );
+        if ( slot.state != Slot::FREE )
+            break;
+
+        uint32_t length = std::min( stream.bytesPerBuffer, stream.waveLength - stream.readPos );
+
+        uint64_t start = stream.waveOffset + stream.readPos;
+        uint64_t alignedStart = AlignDown( start, m_sectorSize );
+
+        slot.stream = streamIndex;
+        slot.generation = stream.generation;
+        slot.offset = alignedStart;
+        slot.dest = slot.memory.get();
+        slot.size = static_cast<uint32_t>( AlignUp( start + length, m_sectorSize ) - alignedStart );
+        slot.skip = static_cast<uint32_t>( start - alignedStart );
+        slot.length = length;
+        slot.endOfStream = false;
+
+        // xWMA buffers need the cumulative decoded bytes of their own packets
+        slot.seekTable.clear();
+        if ( stream.seekTable )
+        {
+            uint32_t firstPacket = stream.readPos / stream.blockAlign;
+            uint32_t lastPacket = std::min( ( stream.readPos + length + stream.blockAlign - 1 ) / stream.blockAlign, stream.seekTableCount );
+            uint32_t base = ( firstPacket > 0 && firstPacket <= stream.seekTableCount ) ? stream.seekTable[ firstPacket - 1 ] : 0;
+            for( uint32_t packet = firstPacket; packet < lastPacket; ++packet )
+            {
+                slot.seekTable.push_back( stream.seekTable[ packet ] - base );
+            }
+        }
+
+        assert( slot.size <= slot.capacity );
+
+        slot.state = Slot::QUEUED;
+        slot.retries = 0;
+        ++stream.readSeq;
+
+        stream.readPos += length;
+        if ( stream.readPos >= stream.waveLength )
+        {
+            if ( stream.loop )
+            {
+                stream.readPos = 0;
+            }
+            else
+            {
+                slot.endOfStream = true;
+                stream.endQueued = true;
+            }
+        }
+    }
+}
+
+
+void WaveBankStreamer::Impl::IssueReads()
+{
+    for(;;)
+    {
+        if ( m_readsInFlight >= m_settings.maxReadsInFlight )
+            break;
+
+        // Issue the queued read whose stream will run out of audio first
+        Slot* next = nullptr;
+        double nextDeadline = 0;
+
+        uint32_t queued = 0;
+        for( auto& stream : m_streams )
+        {
+            if ( !stream.active || FAILED( stream.error ) )
+                continue;
+
+            double deadline = stream.runOut;
+            for( uint32_t seq = stream.acquireSeq; seq != stream.readSeq; ++seq )
+            {
+                auto& slot = stream.SlotFor( seq );
+                if ( slot.state == Slot::QUEUED )
+                {
+                    ++queued;
+                    if ( !next || deadline < nextDeadline )
+                    {
+                        next = &slot;
+                        nextDeadline = deadline;
+                    }
+                }
+                deadline += Duration( stream, slot.length );
+            }
+        }
+
+        m_stats.maxQueueDepth = std::max( m_stats.maxQueueDepth, queued );
+
+        if ( !next )
+            break;
+
+        next->deadline = nextDeadline;
+        next->issued = Clock::now();
+
+        HRESULT hr = m_backend->Submit( next );
+        if ( hr == HRESULT_FROM_WIN32( ERROR_BUSY ) )
+            break;
+
+        ++m_stats.readsIssued;
+
+        if ( FAILED(hr) )
+        {
+            OnReadFailed( *next, hr, true );
+            continue;
+        }
+
+        next->state = Slot::READING;
+        ++m_readsInFlight;
+        m_stats.maxReadsInFlight = std::max( m_stats.maxReadsInFlight, m_readsInFlight );
+    }
+}
+
+
+void WaveBankStreamer::Impl::OnReadComplete( Slot& slot )
+{
+    assert( slot.state == Slot::READING );
+    assert( m_readsInFlight > 0 );
+    --m_readsInFlight;
+
+    auto now = Clock::now();
+    ++m_stats.readsCompleted;
+    m_totalLatency += std::chrono::duration<double>( now - slot.issued ).count();
+
+    auto& stream = m_streams[ slot.stream ];
+    if ( !stream.active || slot.generation != stream.generation )
+    {
+        // Stream was stopped while the read was in flight
+        slot.state = Slot::FREE;
+        return;
+    }
+
+    if ( FAILED( slot.result ) )
+    {
+        OnReadFailed( slot, slot.result, true );
+        return;
+    }
+
+    // Reads are rounded up to whole sectors, so can be short at the end of the file, but not short of the
+    // audio. Reading again won't make the file any longer.
+    if ( slot.bytesRead < slot.skip + slot.length )
+    {
+        OnReadFailed( slot, HRESULT_FROM_WIN32( ERROR_HANDLE_EOF ), false );
+        return;
+    }
+
+    m_stats.bytesRead += slot.bytesRead;
+
+    if ( std::chrono::duration<double>( now - m_epoch ).count() > slot.deadline )
+    {
+        ++m_stats.lateReads;
+    }
+
+    slot.state = Slot::READY;
+}
+
+
+void WaveBankStreamer::Impl::OnReadFailed( Slot& slot, HRESULT hr, bool retry )
+{
+    ++m_stats.readsFailed;
+
+    if ( retry && slot.retries < m_settings.maxReadRetries )
+    {
+        ++slot.retries;
+        ++m_stats.readsRetried;
+        slot.state = Slot::RETRY;
+        return;
+    }
+
+    // The stream can't play past this buffer, so its other queued reads are dropped. Reads in flight are
+    // freed as they complete, and READY buffers stay until the stream is stopped.
+    auto& stream = m_streams[ slot.stream ];
+    stream.error = hr;
+    slot.state = Slot::FAILED;
+
+    for( auto& other : stream.slots )
+    {
+        if ( other.state == Slot::QUEUED || other.state == Slot::RETRY )
+            other.state = Slot::FREE;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+#ifdef _WIN32
+WaveBankStreamer::WaveBankStreamer( const WaveBankReader& bank, std::unique_ptr<IStreamingReadBackend> backend, const Settings& settings ) :
+    pImpl( new Impl( &bank, std::move( backend ), settings ) )
+{
+}
+#endif
+
+
+WaveBankStreamer::WaveBankStreamer( std::unique_ptr<IStreamingReadBackend> backend, const Settings& settings ) :
+    pImpl( new Impl( nullptr, std::move( backend ), settings ) )
+{
+}
+
+
+// Move constructor.
+WaveBankStreamer::WaveBankStreamer(WaveBankStreamer&& moveFrom)
+    : pImpl(std::move(moveFrom.pImpl))
+{
+}
+
+
+// Move assignment.
+WaveBankStreamer& WaveBankStreamer::operator= (WaveBankStreamer&& moveFrom)
+{
+    pImpl = std::move(moveFrom.pImpl);
+    return *this;
+}
+
+
+WaveBankStreamer::~WaveBankStreamer()
+{
+}
+
+
+#ifdef _WIN32
+_Use_decl_annotations_
+uint32_t WaveBankStreamer::Start( uint32_t index, bool loop )
+{
+    return pImpl->Start( index, loop );
+}
+#endif
+
+
+_Use_decl_annotations_
+uint32_t WaveBankStreamer::Start( const StreamingWave& wave, bool loop )
+{
+    return pImpl->Start( wave, loop );
+}
+
+
+_Use_decl_annotations_
+void WaveBankStreamer::Stop( uint32_t stream )
+{
+    pImpl->Stop( stream );
+}
+
+
+_Use_decl_annotations_
+bool WaveBankStreamer::IsActive( uint32_t stream ) const
+{
+    return pImpl->IsActive( stream );
+}
+
+
+void WaveBankStreamer::Update()
+{
+    pImpl->Update();
+}
+
+
+_Use_decl_annotations_
+bool WaveBankStreamer::AcquireBuffer( uint32_t stream, Buffer& buffer )
+{
+    return pImpl->AcquireBuffer( stream, buffer );
+}
+
+
+_Use_decl_annotations_
+void WaveBankStreamer::ReleaseBuffer( uint32_t stream )
+{
+    pImpl->ReleaseBuffer( stream );
+}
+
+
+_Use_decl_annotations_
+HRESULT WaveBankStreamer::GetStreamError( uint32_t stream ) const
+{
+    return pImpl->GetStreamError( stream );
+}
+
+
+_Use_decl_annotations_
+uint32_t WaveBankStreamer::GetBuffersQueued( uint32_t stream ) const
+{
+    return pImpl->GetBuffersQueued( stream );
+}
+
+
+WaveBankStreamer::Statistics WaveBankStreamer::GetStatistics() const
+{
+    return pImpl->GetStatistics();
+}
+
+
+void WaveBankStreamer::ResetStatistics()
+{
+    pImpl->ResetStatistics();
+}
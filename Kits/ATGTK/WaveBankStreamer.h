@@ -0,0 +1,165 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Streaming playback reads for Wave Banks
+//
+// The streamer keeps a ring of sector-aligned buffers per stream and reads ahead of playback.
+// Pending reads are issued in order of playback deadline (the time at which a stream would run
+// out of audio without them), and the number of reads in flight is capped. Reads are done through
+// an IStreamingReadBackend, which is overlapped I/O on the bank's unbuffered async handle on
+// Windows, or a worker thread over any blocking read function elsewhere.
+//
+// A read which fails is queued again, up to Settings::maxReadRetries times. After that, or if the
+// file turns out to be shorter than the wave, the stream fails: the buffers before the failed read
+// still play, then AcquireBuffer returns false and GetStreamError reports why, so stop the voice
+// rather than waiting for more audio.
+//
+// The streamer is not thread-safe. Update, AcquireBuffer and ReleaseBuffer should all be called
+// from the same thread; forward IXAudio2VoiceCallback::OnBufferEnd to that thread.
+//
+// Outside of Windows only the scheduling is built: waves are described with StreamingWave rather
+// than looked up in a WaveBankReader, which is how the tests drive it with a fake backend.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+
+#include "StreamingReadBackend.h"
+
+#ifdef _WIN32
+#include "WaveBankReader.h"
+#endif
+
+
+namespace DX
+{
+#ifdef _WIN32
+    // Overlapped reads on a handle opened with FILE_FLAG_OVERLAPPED, such as WaveBankReader::GetAsyncHandle.
+    // The handle is not owned. With FILE_FLAG_NO_BUFFERING the volume's sector size is honored.
+    HRESULT CreateOverlappedReadBackend( _In_ HANDLE hAsync, _In_ uint32_t maxRequests, _Out_ std::unique_ptr<IStreamingReadBackend>& backend );
+#else
+    class WaveBankReader;
+#endif
+
+    // Where a wave's data is in the file the backend reads, and how fast it plays.
+    struct StreamingWave
+    {
+        uint64_t        offset;             // File offset of the wave data
+        uint32_t        length;             // Bytes of wave data
+        uint32_t        blockAlign;         // Buffers hold whole blocks: XMA packets, xWMA packets, or PCM/ADPCM blocks
+        uint32_t        bytesPerSecond;
+        const uint32_t* seekTable;          // xWMA decoded packet cumulative bytes, or nullptr
+        uint32_t        seekTableCount;
+    };
+
+    class WaveBankStreamer
+    {
+    public:
+        struct Settings
+        {
+            uint32_t    maxStreams;         // Number of streams that can play at once
+            uint32_t    buffersPerStream;   // 2 for double buffering, 3 for triple buffering
+            uint32_t    bufferSize;         // Bytes of audio per buffer, rounded to the sector size
+            uint32_t    maxReadsInFlight;   // Reads submitted to the backend at once
+            uint32_t    maxReadRetries;     // Times a failed read is queued again before its stream fails
+
+            Settings() :
+                maxStreams( 8 ),
+                buffersPerStream( 3 ),
+                bufferSize( 65536 ),
+                maxReadsInFlight( 4 ),
+                maxReadRetries( 2 )
+            {
+            }
+        };
+
+        // A buffer of audio to submit to a voice. For xWMA, seekTable has the decoded packet cumulative
+        // bytes for just this buffer, for use as XAUDIO2_BUFFER_WMA::pDecodedPacketCumulativeBytes.
+        struct Buffer
+        {
+            const uint8_t*  data;
+            uint32_t        size;
+            const uint32_t* seekTable;
+            uint32_t        seekTableCount;
+            bool            endOfStream;
+        };
+
+        struct Statistics
+        {
+            uint64_t    readsIssued;
+            uint64_t    readsCompleted;
+            uint64_t    readsFailed;
+            uint64_t    readsRetried;       // Failed reads that were queued again
+            uint64_t    bytesRead;
+            uint64_t    underruns;          // A voice needed a buffer that wasn't ready
+            uint64_t    lateReads;          // A read finished after its playback deadline
+            uint32_t    queueDepth;         // Reads waiting to be issued
+            uint32_t    maxQueueDepth;
+            uint32_t    readsInFlight;      // Reads submitted to the backend
+            uint32_t    maxReadsInFlight;
+            double      averageReadLatencyMs;
+        };
+
+        static const uint32_t c_InvalidStream = uint32_t(-1);
+
+#ifdef _WIN32
+        WaveBankStreamer( _In_ const WaveBankReader& bank, _In_ std::unique_ptr<IStreamingReadBackend> backend, const Settings& settings = Settings() );
+#endif
+
+        // Streams waves described by StreamingWave from whatever file the backend reads.
+        explicit WaveBankStreamer( _In_ std::unique_ptr<IStreamingReadBackend> backend, const Settings& settings = Settings() );
+
+        WaveBankStreamer(WaveBankStreamer&& moveFrom);
+        WaveBankStreamer& operator= (WaveBankStreamer&& moveFrom);
+
+        WaveBankStreamer(WaveBankStreamer const&) = delete;
+        WaveBankStreamer& operator=(WaveBankStreamer const&) = delete;
+
+        ~WaveBankStreamer();
+
+#ifdef _WIN32
+        // Starts reading a wave from the bank. Returns c_InvalidStream if all streams are in use.
+        uint32_t Start( _In_ uint32_t index, _In_ bool loop = false );
+#endif
+
+        // Starts reading a wave. Returns c_InvalidStream if all streams are in use or the wave is empty.
+        uint32_t Start( _In_ const StreamingWave& wave, _In_ bool loop = false );
+
+        // Stops a stream. Its reads in flight are abandoned and reused once they finish. Buffers that
+        // have been acquired stay valid until they are released with ReleaseBuffer, so either keep
+        // forwarding OnBufferEnd or flush the voice and release them, and the stream is not reused until then.
+        void Stop( _In_ uint32_t stream );
+
+        bool IsActive( _In_ uint32_t stream ) const;
+
+        // Issues reads and collects finished ones. Call regularly, such as once per frame.
+        void Update();
+
+        // Gets the next buffer of a stream to submit to its voice. Returns false if the stream has reached
+        // its end, has failed, or the next buffer isn't ready yet (which is counted as an underrun).
+        bool AcquireBuffer( _In_ uint32_t stream, _Out_ Buffer& buffer );
+
+        // S_OK, or the error of the read which made the stream fail. A short read, where the file ends
+        // before the wave does, is HRESULT_FROM_WIN32( ERROR_HANDLE_EOF ).
+        HRESULT GetStreamError( _In_ uint32_t stream ) const;
+
+        // Returns the oldest acquired buffer of a stream once its voice has finished playing it. This is
+        // also needed after Stop.
+        void ReleaseBuffer( _In_ uint32_t stream );
+
+        // Number of acquired buffers for a stream that haven't been released.
+        uint32_t GetBuffersQueued( _In_ uint32_t stream ) const;
+
+        Statistics GetStatistics() const;
+        void ResetStatistics();
+
+    private:
+        // Private implementation.
+        class Impl;
+
+        std::unique_ptr<Impl> pImpl;
+    };
+}
@@ -4,6 +4,7 @@
 #include "pch.h"
 
 #include "HttpCall.h"
+#include "HttpCallInternal.h"
 #include <ixmlhttprequest2.h>
 
 #define AUTOMATIC_INSERTION
@@ -12,22 +13,6 @@ using namespace Microsoft::WRL;
 
 namespace ATG
 {
-    const size_t c_maxRequestChunkSize = 128 * 1024;
-
-    std::wstring MakeLowerWString(const wchar_t* begin, const wchar_t *end)
-    {
-        std::wstring result;
-        result.reserve(end - begin);
-
-        while(begin != end)
-        {
-            result.push_back(towlower(*begin));
-            ++begin;
-        }
-
-        return result;
-    }
-
     std::wstring ConvertHeadersToString(const std::vector<ATG::HttpHeader> &headers)
     {
         std::wstring headerString = L"";
@@ -41,43 +26,9 @@ namespace ATG
         return headerString;
     }
 
-    std::wstring GetHostFromUrl(const std::wstring &url)
-    {
-        // Assuming calls are https://
-        auto pos = url.find_first_of(L'/',size_t(8));
-        assert(pos != std::wstring::npos);
-        return MakeLowerWString(&url[8], &url[pos + 1]);
-        
-    }
-
-    std::wstring GetHostFromUrl(const wchar_t *url)
-    {
-        auto pos = wcschr(url + 8,L'/');
-        assert(pos != nullptr);
-        return MakeLowerWString(url + 8, pos + 1);
-    }
-
-    std::vector<std::wstring> SplitString(const std::wstring &string, const std::wstring &token)
-    {
-        std::vector<std::wstring> splitString;
-
-        size_t start = 0;
-        size_t end = string.find_first_of(token);
-
-        while (end != std::wstring::npos)
-        {
-            splitString.push_back(string.substr(start, end));
-
-            start = end + 1;
-            end = string.find_first_of(token, start);
-        }
-
-        return splitString;
-    }
-
     // Buffer with the required ISequentialStream interface to send data with and IXHR2 request. The only method
     // required for use is Read.  IXHR2 will not write to this buffer nor will it use anything from the IDispatch
-    // interface.
+    // interface. Data is read straight from the HttpRequestBody into the buffer IXHR2 provides.
     class HttpRequestStream : public RuntimeClass<RuntimeClassFlags<ClassicCom>, ISequentialStream, IDispatch>
     {
     public:
@@ -95,26 +46,22 @@ namespace ATG
         HRESULT Invoke(DISPID, REFIID, LCID, WORD, DISPPARAMS FAR*, VARIANT FAR*, EXCEPINFO FAR*, unsigned int FAR*) { return S_OK; }
 
         // Methods created for simplicity when creating and passing along the buffer
-        HRESULT Open(const void *buffer, size_t bufferSize);
-        size_t Size() const { return m_bufferSize; }
+        HRESULT Open(const HttpRequestBody &body);
+        size_t Size() const { return m_body.Size(); }
     private:
-        void AllocateInternalBuffer(size_t size);
-        void FreeInternalBuffer();
-
-        unsigned char    *m_buffer;
+        HttpRequestBody   m_body;
         size_t            m_seekLocation;
-        size_t            m_bufferSize;
     };
     
     // This handles the data coming in from the HTTP request. As the data comes in it copies it into a growable buffer.
     // Upon completion of the request the buffers get combined into a contiguous buffer to be returned to the callback.
-    class HttpCallback : public RuntimeClass<RuntimeClassFlags<ClassicCom>, IXMLHTTPRequest2Callback>
+    class HttpCallback : public RuntimeClass<RuntimeClassFlags<ClassicCom>, IXMLHTTPRequest2Callback>, public IHttpRequest
     {
     public:
         HttpCallback();
         virtual ~HttpCallback();
 
-        HRESULT RuntimeClassInitialize(std::function<void(HttpResponse *)> callback);
+        HRESULT RuntimeClassInitialize(std::function<void(HttpResponse *)> callback, HttpCompletionHandler onComplete);
     
         // IXMLHTTPRequest2Callback Methods
         HRESULT OnRedirect(IXMLHTTPRequest2 *, const WCHAR *) { return S_OK; }
@@ -123,12 +70,12 @@ namespace ATG
         HRESULT OnResponseReceived(IXMLHTTPRequest2 *request, ISequentialStream *responseStream);
         HRESULT OnError(IXMLHTTPRequest2 *request, HRESULT error);
 
-        // Methods to build and send the call
-        HRESULT OpenRequest(const wchar_t *verb, const wchar_t *url);
-        HRESULT SetTimeout(unsigned long timeoutMs);
-        HRESULT SetHeaders(const std::vector<HttpHeader> &headers);
-        void SetContent(const unsigned char *buffer, size_t bufferSize);
-        HRESULT Send();
+        // IHttpRequest Methods to build and send the call
+        HRESULT OpenRequest(const wchar_t *verb, const wchar_t *url) override;
+        HRESULT SetTimeout(unsigned long timeoutMs) override;
+        HRESULT SetHeaders(const std::vector<HttpHeader> &headers) override;
+        void SetContent(const HttpRequestBody &body) override;
+        HRESULT Send() override;
 
         const std::wstring &GetHost() const { return m_host; }
     private:
@@ -148,6 +95,7 @@ namespace ATG
 
         // Response
         HttpResponse              m_response;
+        HttpCompletionHandler     m_onComplete;
 
         // Request Data
         ComPtr<IXMLHTTPRequest2>  m_request;
@@ -155,208 +103,61 @@ namespace ATG
 
         std::wstring              m_host;
     };
-}
-
-class ATG::HttpCallManager::Impl
-{
-public:
-    Impl() :
-        m_timeoutMS(0)
-    {
-        if (s_httpCallManager)
-        {
-            throw std::exception("HttpCallManager is a singleton");
-        }
-
-        s_httpCallManager = this;
-    }
-    ~Impl()
-    {
-        s_httpCallManager = nullptr;
-    }
-
-    std::vector<HttpResponse> DoWork()
-    {
-        std::vector<HttpResponse> currentResponses; 
-        
-        {
-            // Move the responses to the new vector and clear the buffer.
-            std::lock_guard<std::mutex> lock(m_responseLock);
-            currentResponses = std::move(m_responses);
-        }
-
-        {
-            std::lock_guard<std::mutex> lock(m_bufferedCallLock);
-            // Go through all of the calls that were buffered for each endpoint and send
-            // as many as possible.
-            for(auto &hostQueue : m_bufferedCalls)
-            {
-                auto queue = hostQueue.second;
-
-                while (!queue.empty() && AquireCallSlot(hostQueue.first))
-                {
-                    queue.front()->Send();
-                    queue.pop_front();
-                }
-            }
-        }
-        
-        return currentResponses;
-    }
 
-    HRESULT MakeHttpCall(const std::wstring &verb, 
-                         const std::wstring &uri,
-                         const unsigned char *buffer, 
-                         size_t bufferSize,
-                         const std::vector<HttpHeader> &headers,
-                         std::function<void(HttpResponse *)> callback)
+    // Transport that creates an HttpCallback (IXMLHTTPRequest2) for each call.
+    class XmlHttpTransport : public IHttpTransport
     {
-        // Create the request
-        ComPtr<HttpCallback> call;
-        MakeAndInitialize<HttpCallback>(&call, callback);
-
-        auto result = call->OpenRequest(verb.c_str(), uri.c_str());
-        if (FAILED(result)) return result;
-
-        result = call->SetHeaders(headers);
-        if (FAILED(result)) return result;
-
-        if(buffer != nullptr)
-        {
-            call->SetContent(buffer, bufferSize);
-        }
-        result = call->SetTimeout(m_timeoutMS);
-        if (FAILED(result)) return result;
-        
-
-        auto host = GetHostFromUrl(uri);
-
-        // IXHR2 can only have 6 calls to a specific endpoint in flight at once. This
-        // will place the call in a queue if there are too many in flight and on the
-        // next frame send it if there is space.
-        if(AquireCallSlot(host))
+    public:
+        HRESULT CreateRequest(std::function<void(HttpResponse *)> callback,
+                              HttpCompletionHandler onComplete,
+                              std::shared_ptr<IHttpRequest> &request) override
         {
-            result = call->Send();
+            ComPtr<HttpCallback> call;
+            auto result = MakeAndInitialize<HttpCallback>(&call, callback, onComplete);
             if (FAILED(result)) return result;
-        }
-        else
-        {
-            std::lock_guard<std::mutex> lock(m_bufferedCallLock);
-            m_bufferedCalls[host].push_back(call);
-        }
 
-        return result;
-    }
-
-    void SetTimeout(unsigned long timeoutMS)
-    {
-        m_timeoutMS = timeoutMS;
-    }
-
-    void AddResponse(HttpResponse response)
-    {
-        std::lock_guard<std::mutex> lock(m_responseLock);
-        m_responses.push_back(response);
-    }
-
-    void RegisterHost(const std::wstring &host)
-    {
-        // Add a new endpoint counter if it doesn't exist.
-        if(m_requestInFlight.find(host) == m_requestInFlight.end())
-        {
-            std::lock_guard<std::mutex> lock(m_requestsInFlightLock);
-            // Make one more check before adding just in case another thread already added it
-            if (m_requestInFlight.find(host) == m_requestInFlight.end())
+            // IXHR2 holds its own reference to the callback while the call is in flight, so the
+            // shared_ptr only needs to own the reference handed out by MakeAndInitialize.
+            request = std::shared_ptr<IHttpRequest>(call.Detach(), [](IHttpRequest *p)
             {
-                m_requestInFlight[host] = 0;
-            }
-        }
-    }
+                static_cast<HttpCallback *>(p)->Release();
+            });
 
-    bool AquireCallSlot(const std::wstring &host)
-    {
-        // IXHR2 only allows 6 calls in flight to a given endpoint
-        std::lock_guard<std::mutex> lock(m_requestsInFlightLock);
-        auto &counter = m_requestInFlight[host];
-        if (counter < 6)
-        {
-            ++counter;
-            return true;
+            return S_OK;
         }
-        return false;
-    }
-
-    void ReleaseCallToHost(const std::wstring &host)
-    {
-        std::lock_guard<std::mutex> lock(m_requestsInFlightLock);
-        --m_requestInFlight[host];
-    }
-
-    static HttpCallManager::Impl* s_httpCallManager;
-private:
-    std::mutex                   m_responseLock;
-    std::vector<HttpResponse>    m_responses;
-
-    unsigned long                m_timeoutMS;
-
-    std::mutex                                               m_requestsInFlightLock;
-    std::map<std::wstring, int>                              m_requestInFlight;
-    std::mutex                                               m_bufferedCallLock;
-    std::map<std::wstring, std::deque<ComPtr<HttpCallback>>> m_bufferedCalls;
-};
-
-ATG::HttpCallManager::Impl* ATG::HttpCallManager::Impl::s_httpCallManager = nullptr;
-
-// Public Constructor
-ATG::HttpCallManager::HttpCallManager() :
-    pImpl(new Impl())
-{
-
-}
-
-// Public Destructor
-ATG::HttpCallManager::~HttpCallManager()
-{
 
+        // IXHR2 can only have 6 calls to a specific endpoint in flight at once.
+        int MaxCallsPerHost() const override { return 6; }
+    };
 }
 
-// Public Methods
-std::vector<ATG::HttpResponse> ATG::HttpCallManager::DoWork()
+std::shared_ptr<ATG::IHttpTransport> ATG::CreateXmlHttpTransport()
 {
-    return pImpl->DoWork();
+    return std::make_shared<XmlHttpTransport>();
 }
-
-HRESULT ATG::HttpCallManager::MakeHttpCall(const wchar_t *verb,
-                                           const wchar_t *uri,
-                                           const std::vector<HttpHeader> &headers, 
-                                           std::function<void(HttpResponse *)> callback)
+// Public Constructor
+ATG::HttpCallManager::HttpCallManager() :
+    HttpCallManager(CreateXmlHttpTransport())
 {
-    return pImpl->MakeHttpCall(verb, uri, nullptr, 0, headers, callback );
-}
 
-HRESULT ATG::HttpCallManager::MakeHttpCall(const wchar_t *verb,
-                                           const wchar_t *uri,
-                                           const std::vector<HttpHeader> &headers, 
-                                           std::vector<unsigned char> &bodyContent,
-                                           std::function<void(HttpResponse *)> callback)
-{
-    return pImpl->MakeHttpCall(verb, uri, &bodyContent[0], bodyContent.size(), headers, callback);
 }
 
 HRESULT ATG::HttpCallManager::MakeHttpCallWithAuth(std::shared_ptr<xbox::services::xbox_live_context> userContext,
                                                    const wchar_t *verb, 
                                                    const wchar_t *uri,
                                                    const std::vector<HttpHeader> &headers, 
-                                                   std::function<void(HttpResponse *)> callback)
+                                                   std::function<void(HttpResponse *)> callback,
+                                                   const wchar_t *callClass)
 {
     HRESULT result = S_OK;
+    std::wstring callClassName = callClass ? callClass : L"";
 #if defined(_XBOX_ONE) && defined(_TITLE)
     #if defined(AUTOMATIC_INSERTION)
     // On Xbox One auth headers will be auto inserted if the xbl-authz-actor-10 header 
     // is set with the user's hash
     auto authHeaders = headers;
     authHeaders.emplace_back(L"xbl-authz-actor-10", userContext->user()->XboxUserHash->Data());
-    result = pImpl->MakeHttpCall(verb, uri, nullptr, 0, authHeaders, callback);
+    result = MakeHttpCall(verb, uri, authHeaders, callback, callClassName.c_str());
     #else
     // Demonstration of how to manually get the Authorization and Signature headers on Xbox
     auto asyncOp = userContext->user()->GetTokenAndSignatureAsync(ref new Platform::String(verb.c_str()),
@@ -372,7 +173,7 @@ HRESULT ATG::HttpCallManager::MakeHttpCallWithAuth(std::shared_ptr<xbox::service
             authHeaders.emplace_back(std::wstring(L"Authorization"), std::wstring(payload->Token->Data()));
             authHeaders.emplace_back(std::wstring(L"Signature"), std::wstring(payload->Signature->Data()));
             
-            auto result = pImpl->MakeHttpCall(verb, uri, nullptr, 0, headers, callback);
+            auto result = MakeHttpCall(verb, uri, headers, callback, callClassName.c_str());
 
             // As we are in an async call, we can't return the result immediately.  So it gets queued
             // in the response queue.
@@ -381,7 +182,7 @@ HRESULT ATG::HttpCallManager::MakeHttpCallWithAuth(std::shared_ptr<xbox::service
                 HttpResponse response;
                 response.SetError(result, L"Error attempting to make call.");
                 response.SetCallback(callback);
-                pImpl->AddResponse(response);
+                AddResponse(response);
             }
         }
         catch (...)
@@ -389,7 +190,7 @@ HRESULT ATG::HttpCallManager::MakeHttpCallWithAuth(std::shared_ptr<xbox::service
             HttpResponse response;
             response.SetError(e->HResult, e->Message->Data());
             response.SetCallback(callback);
-            pImpl->AddResponse(response);
+            AddResponse(response);
         }
     });
     #endif
@@ -407,7 +208,7 @@ HRESULT ATG::HttpCallManager::MakeHttpCallWithAuth(std::shared_ptr<xbox::service
             authHeaders.emplace_back(std::wstring(L"Authorization"), payload.token());
             authHeaders.emplace_back(std::wstring(L"Signature"), payload.signature());
             
-            auto result = pImpl->MakeHttpCall(verb, uri, nullptr, 0, headers, callback);
+            auto result = MakeHttpCall(verb, uri, headers, callback, callClassName.c_str());
 
             // As we are in an async call, we can't return the result immediately.  So it gets queued
             // in the response queue.
@@ -416,7 +217,7 @@ HRESULT ATG::HttpCallManager::MakeHttpCallWithAuth(std::shared_ptr<xbox::service
                 HttpResponse response;
                 response.SetError(result, L"Error attempting to make call.");
                 response.SetCallback(callback);
-                pImpl->AddResponse(response);
+                AddResponse(response);
             }
         });
 #endif
@@ -428,16 +229,18 @@ HRESULT ATG::HttpCallManager::MakeHttpCallWithAuth(std::shared_ptr<xbox::service
                                                    const wchar_t *uri,
                                                    const std::vector<HttpHeader> &headers, 
                                                    std::vector<unsigned char> &bodyContent,
-                                                   std::function<void(HttpResponse *)> callback)
+                                                   std::function<void(HttpResponse *)> callback,
+                                                   const wchar_t *callClass)
 {
     HRESULT result = S_OK;
+    std::wstring callClassName = callClass ? callClass : L"";
 #if defined(_XBOX_ONE) && defined(_TITLE)
     #ifdef AUTOMATIC_INSERTION
     // On Xbox One auth headers will be auto inserted if the xbl-authz-actor-10 header 
     // is set with the user's hash
     auto authHeaders = headers;
     authHeaders.emplace_back(L"xbl-authz-actor-10", userContext->user()->XboxUserHash->Data());
-    result = pImpl->MakeHttpCall(verb, uri, &bodyContent[0], bodyContent.size(), headers, callback);
+    result = MakeHttpCall(verb, uri, headers, HttpRequestBody::FromCopy(bodyContent.data(), bodyContent.size()), callback, callClassName.c_str());
     #else
     // Demonstration of how to manually get the Authorization and Signature headers on Xbox
     auto asyncOp = userContext->user()->GetTokenAndSignatureAsync(ref new Platform::String(verb.c_str()),
@@ -454,7 +257,7 @@ HRESULT ATG::HttpCallManager::MakeHttpCallWithAuth(std::shared_ptr<xbox::service
             authHeaders.emplace_back(std::wstring(L"Authorization"), std::wstring(payload->Token->Data()));
             authHeaders.emplace_back(std::wstring(L"Signature"), std::wstring(payload->Signature->Data()));
             
-            auto result = pImpl->MakeHttpCall(verb, uri, &bodyContent[0], bodyContent.size(), headers, callback);
+            auto result = MakeHttpCall(verb, uri, headers, HttpRequestBody::FromCopy(bodyContent.data(), bodyContent.size()), callback, callClassName.c_str());
 
             // As we are in an async call, we can't return the result immediately.  So it gets queued
             // in the response queue.
@@ -463,7 +266,7 @@ HRESULT ATG::HttpCallManager::MakeHttpCallWithAuth(std::shared_ptr<xbox::service
                 HttpResponse response;
                 response.SetError(result, L"Error attempting to make call.");
                 response.SetCallback(callback);
-                pImpl->AddResponse(response);
+                AddResponse(response);
             }
         }
         catch (Platform::Exception ^e)
@@ -471,7 +274,7 @@ HRESULT ATG::HttpCallManager::MakeHttpCallWithAuth(std::shared_ptr<xbox::service
             HttpResponse response;
             response.SetError(e->HResult, e->Message->Data());
             response.SetCallback(callback);
-            pImpl->AddResponse(response);
+            AddResponse(response);
         }
     });
     #endif
@@ -489,7 +292,7 @@ HRESULT ATG::HttpCallManager::MakeHttpCallWithAuth(std::shared_ptr<xbox::service
             authHeaders.emplace_back(std::wstring(L"Authorization"), payload.token());
             authHeaders.emplace_back(std::wstring(L"Signature"), payload.signature());
             
-            auto result = pImpl->MakeHttpCall(verb, uri, &bodyContent[0], bodyContent.size(), headers, callback);
+            auto result = MakeHttpCall(verb, uri, headers, HttpRequestBody::FromCopy(bodyContent.data(), bodyContent.size()), callback, callClassName.c_str());
 
             // As we are in an async call, we can't return the result immediately.  So it gets queued
             // in the response queue.
@@ -498,29 +301,13 @@ HRESULT ATG::HttpCallManager::MakeHttpCallWithAuth(std::shared_ptr<xbox::service
                 HttpResponse response;
                 response.SetError(result, L"Error attempting to make call.");
                 response.SetCallback(callback);
-                pImpl->AddResponse(response);
+                AddResponse(response);
             }
         });
 #endif
     return result;
 }
 
-void ATG::HttpCallManager::SetTimeout(unsigned long timeoutMS)
-{
-    pImpl->SetTimeout(timeoutMS);
-}
-
-void ATG::HttpResponse::ParseHeaders(const std::wstring &headers)
-{
-    auto headersSplit = SplitString(headers, L"\r\n");
-
-    for (auto &headerLine : headersSplit)
-    {
-        size_t splitLocation = headerLine.find_first_of(L':');
-        m_responseHeaders.emplace_back(headerLine.substr(0,splitLocation - 1).c_str(), headerLine.substr(splitLocation + 1).c_str());
-    }
-}
-
 // Callback for handling the http response
 ATG::HttpCallback::HttpCallback()
 {
@@ -545,8 +332,8 @@ HRESULT ATG::HttpCallback::OnHeadersAvailable(IXMLHTTPRequest2 *request, DWORD r
     HRESULT hr = request->GetAllResponseHeaders(&headers);
     if (SUCCEEDED(hr))
     {
-        // Parse the header string and parse into a vector<HttpHeader>
-        m_response.ParseHeaders(headers);
+        // Keep the header string; it is only split up if the headers are read.
+        m_response.SetResponseHeaders(headers, wcslen(headers));
     }
 
     // The header string that was passed in needs to be deleted here.
@@ -579,15 +366,7 @@ HRESULT ATG::HttpCallback::OnResponseReceived(IXMLHTTPRequest2 *, ISequentialStr
     m_response.SetResponseBody(memory.m_page, memory.m_usedSpace);
 
     // Let the HttpCallManager know the call is completed
-    auto mgr = HttpCallManager::Impl::s_httpCallManager;
-    if (!mgr)
-    {
-        throw std::exception("HttpCallManager");
-    }
-    // Release the slot so another call to this host can be made
-    mgr->ReleaseCallToHost(m_host);
-    // Add the response to the queue to be processed later.
-    mgr->AddResponse(std::move(m_response));
+    m_onComplete(std::move(m_response));
     m_request.Reset();
 
     return result;
@@ -599,13 +378,7 @@ HRESULT ATG::HttpCallback::OnError(IXMLHTTPRequest2 *, HRESULT error)
     std::wstring errorMessage = L"[HttpCallback::OnError] ";
     errorMessage.append(std::to_wstring(error));
     m_response.SetError(error, errorMessage);
-    auto mgr = HttpCallManager::Impl::s_httpCallManager;
-    if (!mgr)
-    {
-        throw std::exception("HttpCallManager");
-    }
-    mgr->ReleaseCallToHost(m_host);
-    mgr->AddResponse(std::move(m_response));
+    m_onComplete(std::move(m_response));
     m_request.Reset();
 
     return S_OK;
@@ -647,7 +420,7 @@ HRESULT ATG::HttpCallback::ReadToBuffer(ISequentialStream *stream)
 
 ATG::HttpCallback::MemoryPage &ATG::HttpCallback::AllocatePage()
 {
-    MemoryPage page(new unsigned char[c_maxRequestChunkSize]);
+    MemoryPage page(HttpBufferPool::Get().Allocate());
     m_memoryPages.push_back(page);
 
     return m_memoryPages.back();
@@ -671,15 +444,16 @@ ATG::HttpCallback::MemoryPage ATG::HttpCallback::MakeContiguous()
     {
         memcpy(combinedBuffer + offset, memory.m_page, memory.m_usedSpace);
         offset += memory.m_usedSpace;
-        delete [] memory.m_page;
+        HttpBufferPool::Get().Free(memory.m_page);
     }
     return MemoryPage(combinedBuffer, totalBufferSize);
 }
 
 // Com Interface to create the HttpCallback and initialize it with the provided callback.
-HRESULT ATG::HttpCallback::RuntimeClassInitialize(std::function<void(HttpResponse *)> callback)
+HRESULT ATG::HttpCallback::RuntimeClassInitialize(std::function<void(HttpResponse *)> callback, HttpCompletionHandler onComplete)
 {
     m_response.SetCallback(callback);
+    m_onComplete = onComplete;
     auto result = ::CoCreateInstance(__uuidof(FreeThreadedXMLHTTP60),
         nullptr,
         CLSCTX_SERVER,
@@ -764,11 +538,11 @@ HRESULT ATG::HttpCallback::SetHeaders(const std::vector<HttpHeader> &headers)
     return result;
 }
 
-void ATG::HttpCallback::SetContent(const unsigned char *buffer, size_t bufferSize)
+void ATG::HttpCallback::SetContent(const HttpRequestBody &body)
 {
     m_requestBuffer = Make<HttpRequestStream>();
-    m_requestBuffer->Open(buffer, bufferSize);
-    m_request->SetRequestHeader(L"Content-Length", std::to_wstring(bufferSize).c_str() );
+    m_requestBuffer->Open(body);
+    m_request->SetRequestHeader(L"Content-Length", std::to_wstring(body.Size()).c_str() );
 }
 
 HRESULT ATG::HttpCallback::Send()
@@ -797,65 +571,128 @@ HRESULT ATG::HttpCallback::Send()
 
 // Read Only buffer for sending data
 ATG::HttpRequestStream::HttpRequestStream() :
-    m_buffer(nullptr),
-    m_seekLocation(0),
-    m_bufferSize(0)
+    m_seekLocation(0)
 {
 
 }
 
 ATG::HttpRequestStream::~HttpRequestStream()
 {
-    FreeInternalBuffer();
+
 }
 
-HRESULT ATG::HttpRequestStream::Open(const void *buffer, size_t bufferSize)
+HRESULT ATG::HttpRequestStream::Open(const HttpRequestBody &body)
 {
-    AllocateInternalBuffer(bufferSize);
-
-    memcpy(m_buffer, buffer, bufferSize);
+    m_body = body;
+    m_seekLocation = 0;
 
     return S_OK;
 }
 
 HRESULT ATG::HttpRequestStream::Read(void *buffer, unsigned long bufferSize, unsigned long *bytesRead)
 {
-    if (buffer == nullptr)
+    if (buffer == nullptr || bytesRead == nullptr)
     {
         return E_INVALIDARG;
     }
 
-    long result = S_OK;
-
-    if (bufferSize + m_seekLocation > m_bufferSize)
+    size_t read = 0;
+    HRESULT result = m_body.Read(m_seekLocation, static_cast<unsigned char *>(buffer), bufferSize, &read);
+    if (FAILED(result))
     {
-        result = S_FALSE;
-
-        // Calculate how many bytes are remaining 
-        bufferSize = static_cast<unsigned long>(m_bufferSize - m_seekLocation);
+        *bytesRead = 0;
+        return result;
     }
 
-    memcpy(buffer, m_buffer + m_seekLocation, bufferSize);
-
-    *bytesRead = bufferSize;
-    m_seekLocation += bufferSize;
+    *bytesRead = static_cast<unsigned long>(read);
+    m_seekLocation += read;
     
-    return result;
+    return (read < bufferSize) ? S_FALSE : S_OK;
 }
 
-void ATG::HttpRequestStream::AllocateInternalBuffer(size_t size)
+namespace ATG
 {
-    if (m_buffer != nullptr)
+    // Read-only view of a file. Pages are only brought in as IXHR2 reads them.
+    class HttpMappedFileBody : public HttpBufferBody
     {
-        FreeInternalBuffer();
-    }
+    public:
+        HttpMappedFileBody() : HttpBufferBody(nullptr, 0) {}
+
+        ~HttpMappedFileBody()
+        {
+            if (m_buffer != nullptr)
+            {
+                UnmapViewOfFile(m_buffer);
+            }
+        }
+
+        HRESULT Open(const wchar_t *fileName)
+        {
+#if (_WIN32_WINNT >= 0x0602 /*_WIN32_WINNT_WIN8*/)
+            ScopedHandle hFile(safe_handle(CreateFile2(fileName,
+                GENERIC_READ,
+                FILE_SHARE_READ,
+                OPEN_EXISTING,
+                nullptr)));
+#else
+            ScopedHandle hFile(safe_handle(CreateFileW(fileName,
+                GENERIC_READ,
+                FILE_SHARE_READ,
+                nullptr,
+                OPEN_EXISTING,
+                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                nullptr)));
+#endif
+            if (!hFile)
+            {
+                return HRESULT_FROM_WIN32(GetLastError());
+            }
+
+            FILE_STANDARD_INFO fileInfo;
+            if (!GetFileInformationByHandleEx(hFile.get(), FileStandardInfo, &fileInfo, sizeof(fileInfo)))
+            {
+                return HRESULT_FROM_WIN32(GetLastError());
+            }
 
-    m_bufferSize = size;
-    m_buffer = new unsigned char[size];
+            // Empty files can't be mapped, but make a valid empty body.
+            if (fileInfo.EndOfFile.QuadPart == 0)
+            {
+                return S_OK;
+            }
+
+            ScopedHandle hMapping(CreateFileMappingW(hFile.get(), nullptr, PAGE_READONLY, 0, 0, nullptr));
+            if (!hMapping)
+            {
+                return HRESULT_FROM_WIN32(GetLastError());
+            }
+
+            auto view = MapViewOfFile(hMapping.get(), FILE_MAP_READ, 0, 0, 0);
+            if (view == nullptr)
+            {
+                return HRESULT_FROM_WIN32(GetLastError());
+            }
+
+            m_buffer = static_cast<const unsigned char *>(view);
+            m_size = static_cast<size_t>(fileInfo.EndOfFile.QuadPart);
+            return S_OK;
+        }
+
+    private:
+        struct handle_closer { void operator()(HANDLE h) { if (h) CloseHandle(h); } };
+
+        typedef std::unique_ptr<void, handle_closer> ScopedHandle;
+
+        static HANDLE safe_handle(HANDLE h) { return (h == INVALID_HANDLE_VALUE) ? nullptr : h; }
+    };
 }
 
-void ATG::HttpRequestStream::FreeInternalBuffer()
+HRESULT ATG::HttpRequestBody::FromFile(const wchar_t *fileName, HttpRequestBody &body)
 {
-    delete[] m_buffer;
-    m_buffer = nullptr;
+    auto source = std::make_shared<HttpMappedFileBody>();
+    auto result = source->Open(fileName);
+    if (SUCCEEDED(result))
+    {
+        body = HttpRequestBody(source);
+    }
+    return result;
 }
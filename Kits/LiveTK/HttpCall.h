@@ -3,6 +3,15 @@
 
 #pragma once
 
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "HttpPlatform.h"
+
 namespace xbox
 {
     namespace services
@@ -27,13 +36,34 @@ namespace ATG
         std::wstring m_value;
     };
 
+    // A header name and value pointing into the HttpResponse that owns them. Neither string is null
+    // terminated and both are only valid for the lifetime of that response.
+    struct HttpHeaderView
+    {
+        const wchar_t *name;
+        size_t         nameLength;
+        const wchar_t *value;
+        size_t         valueLength;
+    };
+
+    // Parsed Cache-Control response directives. maxAge is -1 when no max-age was given.
+    struct HttpCacheControl
+    {
+        long maxAge;
+        bool noCache;
+        bool noStore;
+        bool isPrivate;
+        bool isPublic;
+        bool mustRevalidate;
+    };
+
     // Holds either the response from the web service call or the error from attempting to make the call.
     // The process method calls the callback that was set with the associated call for either handling the
     // error of processing the response body.
     class HttpResponse
     {
     public:
-        HttpResponse() : m_errorCode(S_OK), m_errorMessage(L"") {}
+        HttpResponse() : m_errorCode(S_OK), m_errorMessage(L""), m_httpResponseCode(0), m_headersIndexed(false), m_responseBodySize(0) {}
 
         // This is the first method that should be called when processing the call to determine if errors 
         // should be handled or the response can be parsed.
@@ -45,29 +75,188 @@ namespace ATG
 
         //  Getters for retrieving information from a successful request
         unsigned long HttpResponseCode() const { return m_httpResponseCode; }
-        const std::vector<HttpHeader> &ResponseHeaders() const { return m_responseHeaders; }
         std::shared_ptr<unsigned char> ResponseBody() const { return m_responseBody; }
         size_t ResponseBodySize() const { return m_responseBodySize; }
 
+        // Response headers are kept as the single string returned by the transport. The offsets of each
+        // header are found the first time any of these are called; none of them allocate afterwards.
+        size_t HeaderCount() const;
+        HttpHeaderView Header(size_t index) const;
+        bool FindHeader(const wchar_t *name, HttpHeaderView &header) const;
+
+        // Typed accessors for common headers. They return false if the header is missing or malformed.
+        bool ContentLength(uint64_t &length) const;
+        bool ETag(HttpHeaderView &etag) const;
+        bool RetryAfter(unsigned long &seconds) const;    // Handles both delta-seconds and HTTP-date
+        bool CacheControl(HttpCacheControl &cacheControl) const;
+
         void SetError(long errorCode, const std::wstring &errorMessage) { m_errorCode = errorCode; m_errorMessage = errorMessage; }
 
         void SetResponseCode(unsigned long response) { m_httpResponseCode = response; }
-        void ParseHeaders(const std::wstring &headers);
+        // Takes a copy of the raw "Name: value\r\n" header block.
+        void SetResponseHeaders(const wchar_t *headers, size_t length);
         void SetResponseBody(unsigned char *body, size_t bodySize) { m_responseBody = std::shared_ptr<unsigned char>(body, std::default_delete<unsigned char[]>()); m_responseBodySize = bodySize; }
         void SetCallback(std::function<void(HttpResponse *)> callback) { m_callback = callback; }
 
+        // Result of the decoder registered for the call's class (see HttpCallManager::SetDecoder). Null if
+        // no decoder ran, which is the case for errors and non-2xx responses.
+        template<typename T>
+        std::shared_ptr<T> DecodedResult() const { return std::static_pointer_cast<T>(m_decodedResult); }
+        void SetDecodedResult(std::shared_ptr<void> result) { m_decodedResult = result; }
+
         void Process() { m_callback(this); }
     private:
+        struct HeaderIndex
+        {
+            uint32_t nameOffset;
+            uint32_t nameLength;
+            uint32_t valueOffset;
+            uint32_t valueLength;
+        };
+        void IndexHeaders() const;
+
         long          m_errorCode;
         std::wstring  m_errorMessage;
 
         unsigned long                       m_httpResponseCode;
-        std::vector<HttpHeader>             m_responseHeaders;
+        std::wstring                        m_responseHeaders;
+        mutable std::vector<HeaderIndex>    m_headerIndex;
+        mutable bool                        m_headersIndexed;
         size_t                              m_responseBodySize;
         std::shared_ptr<unsigned char>      m_responseBody;
+        std::shared_ptr<void>               m_decodedResult;
         std::function<void(HttpResponse *)> m_callback;
     };
 
+    // The bytes sent as the body of a request. Buffer and file bodies are read in place when the transport
+    // pulls them, so large uploads are neither copied nor fully resident. Copied bodies are held in pooled
+    // chunks rather than one large allocation. All but producer bodies can be re-read for retries.
+    class HttpRequestBody
+    {
+    public:
+        // Writes up to bufferSize bytes of the body into buffer, returning S_FALSE once no data is left.
+        typedef std::function<HRESULT(unsigned char *buffer, size_t bufferSize, size_t *bytesWritten)> Producer;
+
+        HttpRequestBody() {}
+
+        // The caller's buffer must remain valid until the call's callback has been processed.
+        static HttpRequestBody FromBuffer(const void *buffer, size_t size);
+        static HttpRequestBody FromCopy(const void *buffer, size_t size);
+        static HRESULT FromFile(const wchar_t *fileName, HttpRequestBody &body);
+        static HttpRequestBody FromProducer(size_t size, Producer producer);
+
+        bool IsEmpty() const { return !m_source; }
+        size_t Size() const;
+        bool IsReplayable() const;
+
+        // Copies up to bufferSize bytes starting at offset. Producer bodies must be read sequentially.
+        HRESULT Read(size_t offset, unsigned char *buffer, size_t bufferSize, size_t *bytesRead) const;
+
+        class Source;
+    private:
+        explicit HttpRequestBody(std::shared_ptr<Source> source) : m_source(source) {}
+
+        std::shared_ptr<Source> m_source;
+    };
+
+    // Turns a response body (typically JSON) into a typed result. Runs on one of the HttpCallManager's
+    // decode threads, so it must not touch game state.
+    typedef std::function<std::shared_ptr<void>(const HttpResponse &response)> HttpResponseDecoder;
+
+    // A single request created by an IHttpTransport. The HttpCallManager drives each request through
+    // OpenRequest, SetTimeout, SetHeaders, SetContent and then Send (possibly on a later frame if the
+    // host has too many calls in flight).
+    class IHttpRequest
+    {
+    public:
+        virtual ~IHttpRequest() = default;
+
+        virtual HRESULT OpenRequest(const wchar_t *verb, const wchar_t *url) = 0;
+        virtual HRESULT SetTimeout(unsigned long timeoutMs) = 0;
+        virtual HRESULT SetHeaders(const std::vector<HttpHeader> &headers) = 0;
+        virtual void SetContent(const HttpRequestBody &body) = 0;
+        virtual HRESULT Send() = 0;
+    };
+
+    // Called by a transport exactly once per request when it has finished, either with a response
+    // or with an error set on the HttpResponse. May be called from any thread.
+    typedef std::function<void(HttpResponse &&response)> HttpCompletionHandler;
+
+    // Creates requests for the HttpCallManager. The default transport uses IXMLHTTPRequest2, see
+    // HttpLoopbackTransport.h for an in-process transport that does not need the network.
+    class IHttpTransport
+    {
+    public:
+        virtual ~IHttpTransport() = default;
+
+        virtual HRESULT CreateRequest(std::function<void(HttpResponse *)> callback,
+                                      HttpCompletionHandler onComplete,
+                                      std::shared_ptr<IHttpRequest> &request) = 0;
+
+        // Maximum number of calls that may be in flight to a single host at once.
+        virtual int MaxCallsPerHost() const = 0;
+    };
+
+    // Returns the IXMLHTTPRequest2 based transport used by default.
+    std::shared_ptr<IHttpTransport> CreateXmlHttpTransport();
+
+    // Declarative retry behavior for a class of calls, see HttpCallManager::SetRetryPolicy. Transport
+    // errors and 408, 429, 500, 502, 503 and 504 responses are retried. The default policy does not retry.
+    struct HttpRetryPolicy
+    {
+        HttpRetryPolicy() :
+            maxAttempts(1),
+            idempotentOnly(true),
+            baseDelayMs(100),
+            maxDelayMs(10000),
+            honorRetryAfter(true)
+        {}
+
+        unsigned int  maxAttempts;      // Total attempts including the first one
+        bool          idempotentOnly;   // Only retry GET, HEAD, PUT, DELETE and OPTIONS
+        unsigned long baseDelayMs;      // Backoff uses decorrelated jitter between these bounds
+        unsigned long maxDelayMs;
+        bool          honorRetryAfter;  // Wait at least as long as a Retry-After header asks, giving
+                                        // up if that is longer than maxDelayMs
+    };
+
+    // Per-host circuit breaker. After failureThreshold consecutive transient failures the host is
+    // considered unhealthy and calls to it fail fast with HTTP_E_CIRCUIT_OPEN for openDurationMs. A
+    // single probe call is then let through to decide whether to close the circuit again. Disabled
+    // by default; titles opt in with HttpCallManager::SetCircuitBreaker.
+    struct HttpCircuitBreakerSettings
+    {
+        HttpCircuitBreakerSettings() :
+            enabled(false),
+            failureThreshold(5),
+            openDurationMs(30000)
+        {}
+
+        bool          enabled;
+        unsigned int  failureThreshold;
+        unsigned long openDurationMs;
+    };
+
+    enum class HttpCircuitState
+    {
+        Closed,
+        Open,
+        HalfOpen,
+    };
+
+    const HRESULT HTTP_E_CIRCUIT_OPEN = MAKE_HRESULT(SEVERITY_ERROR, FACILITY_ITF, 0x0201);
+
+    struct HttpCallMetrics
+    {
+        uint64_t calls;
+        uint64_t retries;
+        uint64_t backoffTimeMS;     // Total time calls have spent waiting to be retried
+        uint64_t circuitsOpened;
+        uint64_t callsFailedFast;
+        uint64_t openCircuits;      // Hosts currently open or half open
+        uint64_t decodesPending;    // Responses waiting for or running on a decode thread
+    };
+
     // Singleton class for managing HTTP calls made to web services.  All responses and errors are buffered
     // and returned via the DoWork method to allow processing of the responses to done when and where the
     // title can.
@@ -75,6 +264,7 @@ namespace ATG
     {
     public:
         HttpCallManager();
+        explicit HttpCallManager(std::shared_ptr<IHttpTransport> transport);
         HttpCallManager(HttpCallManager&& moveFrom) = default;
         HttpCallManager& operator=(HttpCallManager&& moveFrom) = default;
 
@@ -85,16 +275,30 @@ namespace ATG
 
         std::vector<HttpResponse> DoWork();
 
+        // Alternative to DoWork that processes completed responses itself, stopping once budgetUS
+        // microseconds have been spent. Anything left is deferred to the next call.
+        size_t ProcessResponses(unsigned long budgetUS);
+        size_t GetDeferredResponseCount() const;
+
         HRESULT MakeHttpCall(const wchar_t *verb, 
                              const wchar_t *uri,
                              const std::vector<HttpHeader> &headers,
-                             std::function<void(HttpResponse *)> callback);
+                             std::function<void(HttpResponse *)> callback,
+                             const wchar_t *callClass = nullptr);
 
         HRESULT MakeHttpCall(const wchar_t *verb, 
                              const wchar_t *uri,
                              const std::vector<HttpHeader> &headers,
                              std::vector<unsigned char> &bodyContent,
-                             std::function<void(HttpResponse *)> callback);
+                             std::function<void(HttpResponse *)> callback,
+                             const wchar_t *callClass = nullptr);
+
+        HRESULT MakeHttpCall(const wchar_t *verb, 
+                             const wchar_t *uri,
+                             const std::vector<HttpHeader> &headers,
+                             const HttpRequestBody &body,
+                             std::function<void(HttpResponse *)> callback,
+                             const wchar_t *callClass = nullptr);
 
         // These calls may send the call from a separate thread due to a call to GetTokenAndSignatureAsync
         // to add the XSTS token to the call.
@@ -102,23 +306,49 @@ namespace ATG
                                      const wchar_t *verb,
                                      const wchar_t *uri,
                                      const std::vector<HttpHeader> &headers,
-                                     std::function<void(HttpResponse *)> callback);
+                                     std::function<void(HttpResponse *)> callback,
+                                     const wchar_t *callClass = nullptr);
 
         HRESULT MakeHttpCallWithAuth(std::shared_ptr<xbox::services::xbox_live_context> userContext,
                                      const wchar_t *verb,
                                      const wchar_t *uri,
                                      const std::vector<HttpHeader> &headers,
                                      std::vector<unsigned char> &bodyContent,
-                                     std::function<void(HttpResponse *)> callback);
+                                     std::function<void(HttpResponse *)> callback,
+                                     const wchar_t *callClass = nullptr);
 
         void SetTimeout(unsigned long timeoutMS);
 
+        // Calls made with a callClass use the policy registered for it, everything else uses the
+        // default policy which is set by passing a null callClass.
+        void SetRetryPolicy(const wchar_t *callClass, const HttpRetryPolicy &policy);
+        void SetCircuitBreaker(const HttpCircuitBreakerSettings &settings);
+
+        // Successful responses to calls of this class are decoded on a worker thread before they are
+        // returned by DoWork, so callbacks only need to read HttpResponse::DecodedResult<T>().
+        void SetDecoder(const wchar_t *callClass, HttpResponseDecoder decoder);
+        void SetDecodeThreadCount(unsigned int count);   // Takes effect before the first decoder is set
+
+        template<typename T>
+        void SetDecoder(const wchar_t *callClass, std::function<std::shared_ptr<T>(const HttpResponse &)> decoder)
+        {
+            SetDecoder(callClass, HttpResponseDecoder([decoder](const HttpResponse &response) -> std::shared_ptr<void>
+            {
+                return decoder(response);
+            }));
+        }
+
+        HttpCircuitState GetCircuitState(const wchar_t *uri) const;
+        HttpCallMetrics GetMetrics() const;
+
     private:
+        // Queues a response (typically an error) to be returned by the next DoWork.
+        void AddResponse(HttpResponse response);
+
         // Private implementation.
         class Impl;
 
         std::unique_ptr<Impl> pImpl;
 
-        friend class HttpCallback;
     };
 }
\ No newline at end of file
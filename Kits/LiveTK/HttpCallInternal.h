@@ -0,0 +1,120 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Pieces shared by the portable HttpCallManager (HttpCallManager.cpp) and the IXMLHTTPRequest2
+// transport (HttpCall.cpp). Not meant to be included by titles.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "HttpCall.h"
+
+namespace ATG
+{
+    const size_t c_maxRequestChunkSize = 128 * 1024;
+
+    std::wstring MakeLowerWString(const wchar_t* begin, const wchar_t *end);
+    std::wstring GetHostFromUrl(const std::wstring &url);
+    std::wstring GetHostFromUrl(const wchar_t *url);
+
+    // Fixed size chunks shared by request bodies and response pages so that calls do not allocate and free
+    // large buffers each time.
+    class HttpBufferPool
+    {
+    public:
+        static HttpBufferPool &Get()
+        {
+            static HttpBufferPool s_pool;
+            return s_pool;
+        }
+
+        unsigned char *Allocate()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_lock);
+                if (!m_freeChunks.empty())
+                {
+                    auto chunk = m_freeChunks.back();
+                    m_freeChunks.pop_back();
+                    return chunk;
+                }
+            }
+            return new unsigned char[c_maxRequestChunkSize];
+        }
+
+        void Free(unsigned char *chunk)
+        {
+            if (chunk == nullptr)
+            {
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_lock);
+                if (m_freeChunks.size() < c_maxPooledChunks)
+                {
+                    m_freeChunks.push_back(chunk);
+                    return;
+                }
+            }
+            delete[] chunk;
+        }
+
+    private:
+        HttpBufferPool() {}
+        ~HttpBufferPool()
+        {
+            for (auto chunk : m_freeChunks)
+            {
+                delete[] chunk;
+            }
+        }
+
+        static const size_t c_maxPooledChunks = 64;
+
+        std::mutex                   m_lock;
+        std::vector<unsigned char *> m_freeChunks;
+    };
+}
+
+// Request body sources
+class ATG::HttpRequestBody::Source
+{
+public:
+    virtual ~Source() = default;
+
+    virtual size_t Size() const = 0;
+    virtual bool IsReplayable() const { return true; }
+    virtual HRESULT Read(size_t offset, unsigned char *buffer, size_t bufferSize, size_t *bytesRead) = 0;
+};
+
+namespace ATG
+{
+    // Caller owned memory, read in place.
+    class HttpBufferBody : public HttpRequestBody::Source
+    {
+    public:
+        HttpBufferBody(const void *buffer, size_t size) : m_buffer(static_cast<const unsigned char *>(buffer)), m_size(size) {}
+
+        size_t Size() const override { return m_size; }
+
+        HRESULT Read(size_t offset, unsigned char *buffer, size_t bufferSize, size_t *bytesRead) override
+        {
+            size_t count = (offset < m_size) ? std::min(bufferSize, m_size - offset) : 0;
+            memcpy(buffer, m_buffer + offset, count);
+            *bytesRead = count;
+            return S_OK;
+        }
+
+    protected:
+        const unsigned char *m_buffer;
+        size_t               m_size;
+    };
+}
@@ -0,0 +1,1390 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// The HttpCallManager itself, response header parsing and the request bodies that do not need the OS.
+// Nothing here uses IXMLHTTPRequest2 or the precompiled header, so this file is compiled with
+// precompiled headers turned off and also builds for the tests in Tests/. HttpCall.cpp adds the
+// IXMLHTTPRequest2 transport, file bodies and Xbox Live authentication; file bodies for the tests'
+// POSIX builds are at the end of this file.
+//
+
+#include "HttpCall.h"
+#include "HttpCallInternal.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstring>
+#include <ctime>
+#include <cwctype>
+#include <deque>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ATG
+{
+    std::wstring MakeLowerWString(const wchar_t* begin, const wchar_t *end)
+    {
+        std::wstring result;
+        result.reserve(end - begin);
+
+        while(begin != end)
+        {
+            result.push_back(towlower(*begin));
+            ++begin;
+        }
+
+        return result;
+    }
+    std::wstring GetHostFromUrl(const std::wstring &url)
+    {
+        // Assuming calls are https://
+        auto pos = url.find_first_of(L'/',size_t(8));
+        assert(pos != std::wstring::npos);
+        return MakeLowerWString(&url[8], &url[pos + 1]);
+        
+    }
+
+    std::wstring GetHostFromUrl(const wchar_t *url)
+    {
+        auto pos = wcschr(url + 8,L'/');
+        assert(pos != nullptr);
+        return MakeLowerWString(url + 8, pos + 1);
+    }
+
+    bool IsHeaderWhitespace(wchar_t c)
+    {
+        return c == L' ' || c == L'\t';
+    }
+
+    // Case insensitive compare of a header token against a null terminated string.
+    bool TokenEquals(const wchar_t *token, size_t tokenLength, const wchar_t *value)
+    {
+        size_t valueLength = wcslen(value);
+        return tokenLength == valueLength && _wcsnicmp(token, value, tokenLength) == 0;
+    }
+
+    bool ParseUnsigned(const wchar_t *begin, size_t length, uint64_t &result)
+    {
+        if (length == 0)
+        {
+            return false;
+        }
+
+        result = 0;
+        for (size_t i = 0; i < length; ++i)
+        {
+            if (begin[i] < L'0' || begin[i] > L'9')
+            {
+                return false;
+            }
+
+            // A value too large to hold is malformed rather than wrapped around
+            uint64_t digit = static_cast<uint64_t>(begin[i] - L'0');
+            if (result > (UINT64_MAX - digit) / 10)
+            {
+                return false;
+            }
+            result = result * 10 + digit;
+        }
+        return true;
+    }
+
+    // Parses an IMF-fixdate ("Sun, 06 Nov 1994 08:49:37 GMT") into seconds since the Unix epoch.
+    bool ParseHttpDate(const wchar_t *begin, size_t length, int64_t &result)
+    {
+        static const wchar_t *s_months[] = { L"Jan", L"Feb", L"Mar", L"Apr", L"May", L"Jun", L"Jul", L"Aug", L"Sep", L"Oct", L"Nov", L"Dec" };
+
+        if (length < 29 || begin[3] != L',')
+        {
+            return false;
+        }
+
+        uint64_t day, year, hour, minute, second;
+        if (!ParseUnsigned(begin + 5, 2, day)
+            || !ParseUnsigned(begin + 12, 4, year)
+            || !ParseUnsigned(begin + 17, 2, hour)
+            || !ParseUnsigned(begin + 20, 2, minute)
+            || !ParseUnsigned(begin + 23, 2, second))
+        {
+            return false;
+        }
+
+        int month = -1;
+        for (int i = 0; i < 12; ++i)
+        {
+            if (_wcsnicmp(begin + 8, s_months[i], 3) == 0)
+            {
+                month = i + 1;
+                break;
+            }
+        }
+        if (month < 0)
+        {
+            return false;
+        }
+
+        // Days from civil, see http://howardhinnant.github.io/date_algorithms.html
+        int64_t y = static_cast<int64_t>(year) - (month <= 2 ? 1 : 0);
+        int64_t era = (y >= 0 ? y : y - 399) / 400;
+        int64_t yearOfEra = y - era * 400;
+        int64_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + static_cast<int64_t>(day) - 1;
+        int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+        int64_t days = era * 146097 + dayOfEra - 719468;
+
+        result = days * 86400 + static_cast<int64_t>(hour * 3600 + minute * 60 + second);
+        return true;
+    }
+}
+
+class ATG::HttpCallManager::Impl
+{
+public:
+    Impl(std::shared_ptr<IHttpTransport> transport) :
+        m_timeoutMS(0),
+        m_transport(transport),
+        m_random(std::random_device()())
+    {
+        if (s_httpCallManager)
+        {
+            throw std::logic_error("HttpCallManager is a singleton");
+        }
+
+        s_httpCallManager = this;
+
+        m_calls = 0;
+        m_retries = 0;
+        m_backoffTimeMS = 0;
+        m_circuitsOpened = 0;
+        m_callsFailedFast = 0;
+        m_decodesPending = 0;
+    }
+    ~Impl()
+    {
+        StopDecodeThreads();
+        s_httpCallManager = nullptr;
+    }
+
+    std::vector<HttpResponse> DoWork()
+    {
+        SendPendingCalls();
+
+        // Responses left over from a budgeted ProcessResponses are returned first.
+        std::vector<HttpResponse> currentResponses(std::make_move_iterator(m_deferredResponses.begin()),
+                                                   std::make_move_iterator(m_deferredResponses.end()));
+        m_deferredResponses.clear();
+
+        {
+            // Move the responses to the new vector and clear the buffer.
+            std::lock_guard<std::mutex> lock(m_responseLock);
+            std::move(m_responses.begin(), m_responses.end(), std::back_inserter(currentResponses));
+            m_responses.clear();
+        }
+
+        return currentResponses;
+    }
+
+    size_t ProcessResponses(unsigned long budgetUS)
+    {
+        SendPendingCalls();
+
+        {
+            std::lock_guard<std::mutex> lock(m_responseLock);
+            std::move(m_responses.begin(), m_responses.end(), std::back_inserter(m_deferredResponses));
+            m_responses.clear();
+        }
+
+        // Always make progress by processing at least one response, even if it blows the budget.
+        auto start = std::chrono::steady_clock::now();
+        auto budget = std::chrono::microseconds(budgetUS);
+        size_t processed = 0;
+        while (!m_deferredResponses.empty())
+        {
+            if (processed > 0 && std::chrono::steady_clock::now() - start >= budget)
+            {
+                break;
+            }
+
+            auto response = std::move(m_deferredResponses.front());
+            m_deferredResponses.pop_front();
+            response.Process();
+            ++processed;
+        }
+
+        return processed;
+    }
+
+    size_t GetDeferredResponseCount() const
+    {
+        return m_deferredResponses.size();
+    }
+
+    void SendPendingCalls()
+    {
+        // Re-issue any retries whose backoff has elapsed.
+        std::vector<std::shared_ptr<CallState>> dueRetries;
+        {
+            std::lock_guard<std::mutex> lock(m_retryLock);
+            auto now = std::chrono::steady_clock::now();
+            while (!m_delayedCalls.empty() && m_delayedCalls.begin()->first <= now)
+            {
+                dueRetries.push_back(m_delayedCalls.begin()->second);
+                m_delayedCalls.erase(m_delayedCalls.begin());
+            }
+        }
+        for (auto &call : dueRetries)
+        {
+            auto result = StartCall(call);
+            if (FAILED(result))
+            {
+                FailCall(*call, result, L"Error attempting to retry call.");
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_bufferedCallLock);
+            // Go through all of the calls that were buffered for each endpoint and send
+            // as many as possible.
+            for(auto &hostQueue : m_bufferedCalls)
+            {
+                auto &queue = hostQueue.second;
+
+                while (!queue.empty() && AquireCallSlot(hostQueue.first))
+                {
+                    // The circuit breaker admitted the call when it was buffered; checking again would
+                    // fail a half-open probe against its own probe flag.
+                    auto call = queue.front();
+                    queue.pop_front();
+
+                    if (FAILED(call.second->Send()))
+                    {
+                        ReleaseCallToHost(hostQueue.first);
+                        FailCall(*call.first, E_FAIL, L"Error attempting to send buffered call.");
+                    }
+                }
+            }
+        }
+    }
+
+    HRESULT MakeHttpCall(const std::wstring &verb, 
+                         const std::wstring &uri,
+                         const HttpRequestBody &body,
+                         const std::vector<HttpHeader> &headers,
+                         std::function<void(HttpResponse *)> callback,
+                         const std::wstring &callClass)
+    {
+        auto call = std::make_shared<CallState>();
+        call->verb = verb;
+        call->uri = uri;
+        call->host = GetHostFromUrl(uri);
+        call->headers = headers;
+        call->body = body;
+        call->callback = callback;
+        call->policy = GetRetryPolicy(callClass);
+        call->decoder = GetDecoder(callClass);
+        call->attempt = 0;
+        call->circuitGeneration = 0;
+        call->isProbe = false;
+        call->lastDelayMS = call->policy.baseDelayMs;
+        call->canRetry = call->policy.maxAttempts > 1
+            && (!call->policy.idempotentOnly || IsIdempotent(verb))
+            && (body.IsEmpty() || body.IsReplayable());
+
+        ++m_calls;
+
+        return StartCall(call);
+    }
+
+    void SetTimeout(unsigned long timeoutMS)
+    {
+        m_timeoutMS = timeoutMS;
+    }
+
+    void SetRetryPolicy(const wchar_t *callClass, const HttpRetryPolicy &policy)
+    {
+        std::lock_guard<std::mutex> lock(m_retryLock);
+        if (callClass == nullptr)
+        {
+            m_defaultRetryPolicy = policy;
+        }
+        else
+        {
+            m_retryPolicies[callClass] = policy;
+        }
+    }
+
+    void SetDecoder(const wchar_t *callClass, HttpResponseDecoder decoder)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_decoderLock);
+            m_decoders[callClass] = decoder;
+        }
+
+        if (decoder)
+        {
+            StartDecodeThreads();
+        }
+    }
+
+    void SetDecodeThreadCount(unsigned int count)
+    {
+        std::lock_guard<std::mutex> lock(m_decodeLock);
+        m_decodeThreadCount = std::max(count, 1u);
+    }
+
+    void SetCircuitBreaker(const HttpCircuitBreakerSettings &settings)
+    {
+        std::lock_guard<std::mutex> lock(m_circuitLock);
+        m_circuitSettings = settings;
+    }
+
+    HttpCircuitState GetCircuitState(const std::wstring &uri)
+    {
+        auto host = GetHostFromUrl(uri);
+
+        std::lock_guard<std::mutex> lock(m_circuitLock);
+        auto circuit = m_circuits.find(host);
+        if (circuit == m_circuits.end())
+        {
+            return HttpCircuitState::Closed;
+        }
+
+        if (circuit->second.state == HttpCircuitState::Open && std::chrono::steady_clock::now() >= circuit->second.openUntil)
+        {
+            return HttpCircuitState::HalfOpen;
+        }
+        return circuit->second.state;
+    }
+
+    HttpCallMetrics GetMetrics()
+    {
+        HttpCallMetrics metrics;
+        metrics.calls = m_calls;
+        metrics.retries = m_retries;
+        metrics.backoffTimeMS = m_backoffTimeMS;
+        metrics.circuitsOpened = m_circuitsOpened;
+        metrics.callsFailedFast = m_callsFailedFast;
+        metrics.decodesPending = m_decodesPending;
+
+        std::lock_guard<std::mutex> lock(m_circuitLock);
+        metrics.openCircuits = 0;
+        for (const auto &circuit : m_circuits)
+        {
+            if (circuit.second.state != HttpCircuitState::Closed)
+            {
+                ++metrics.openCircuits;
+            }
+        }
+
+        return metrics;
+    }
+
+    void AddResponse(HttpResponse response)
+    {
+        std::lock_guard<std::mutex> lock(m_responseLock);
+        m_responses.push_back(std::move(response));
+    }
+
+    void RegisterHost(const std::wstring &host)
+    {
+        // Add a new endpoint counter if it doesn't exist.
+        if(m_requestInFlight.find(host) == m_requestInFlight.end())
+        {
+            std::lock_guard<std::mutex> lock(m_requestsInFlightLock);
+            // Make one more check before adding just in case another thread already added it
+            if (m_requestInFlight.find(host) == m_requestInFlight.end())
+            {
+                m_requestInFlight[host] = 0;
+            }
+        }
+    }
+
+    bool AquireCallSlot(const std::wstring &host)
+    {
+        // The transport limits how many calls can be in flight to a given endpoint
+        std::lock_guard<std::mutex> lock(m_requestsInFlightLock);
+        auto &counter = m_requestInFlight[host];
+        if (counter < m_transport->MaxCallsPerHost())
+        {
+            ++counter;
+            return true;
+        }
+        return false;
+    }
+
+    void ReleaseCallToHost(const std::wstring &host)
+    {
+        std::lock_guard<std::mutex> lock(m_requestsInFlightLock);
+        --m_requestInFlight[host];
+    }
+
+    static HttpCallManager::Impl* s_httpCallManager;
+private:
+    // Everything needed to issue a call again when it is retried.
+    struct CallState
+    {
+        std::wstring                        verb;
+        std::wstring                        uri;
+        std::wstring                        host;
+        std::vector<HttpHeader>             headers;
+        std::function<void(HttpResponse *)> callback;
+
+        HttpRequestBody                     body;
+
+        HttpRetryPolicy                     policy;
+        HttpResponseDecoder                 decoder;
+        bool                                canRetry;
+        unsigned int                        attempt;
+        unsigned long                       lastDelayMS;
+
+        uint64_t                            circuitGeneration;  // Circuit generation the attempt was admitted in
+        bool                                isProbe;            // The attempt is the half-open probe
+    };
+
+    struct Circuit
+    {
+        Circuit() : state(HttpCircuitState::Closed), consecutiveFailures(0), probeInFlight(false), generation(0) {}
+
+        HttpCircuitState                      state;
+        unsigned int                          consecutiveFailures;
+        bool                                  probeInFlight;
+        uint64_t                              generation;   // Bumped whenever the circuit opens or lets a probe through
+        std::chrono::steady_clock::time_point openUntil;
+    };
+
+    static bool IsIdempotent(const std::wstring &verb)
+    {
+        return _wcsicmp(verb.c_str(), L"GET") == 0
+            || _wcsicmp(verb.c_str(), L"HEAD") == 0
+            || _wcsicmp(verb.c_str(), L"PUT") == 0
+            || _wcsicmp(verb.c_str(), L"DELETE") == 0
+            || _wcsicmp(verb.c_str(), L"OPTIONS") == 0;
+    }
+
+    // Transport errors, throttling and server errors are worth retrying and count against the host's health.
+    static bool IsTransientFailure(const HttpResponse &response)
+    {
+        if (response.IsError())
+        {
+            return true;
+        }
+
+        auto code = response.HttpResponseCode();
+        return code == 408 || code == 429 || code == 500 || code == 502 || code == 503 || code == 504;
+    }
+
+    static unsigned long GetRetryAfterMS(const HttpResponse &response)
+    {
+        unsigned long seconds = 0;
+        if (response.RetryAfter(seconds))
+        {
+            return static_cast<unsigned long>(std::min<uint64_t>(uint64_t(seconds) * 1000, ULONG_MAX));
+        }
+        return 0;
+    }
+
+    HttpRetryPolicy GetRetryPolicy(const std::wstring &callClass)
+    {
+        std::lock_guard<std::mutex> lock(m_retryLock);
+        auto policy = m_retryPolicies.find(callClass);
+        return (policy != m_retryPolicies.end()) ? policy->second : m_defaultRetryPolicy;
+    }
+
+    HttpResponseDecoder GetDecoder(const std::wstring &callClass)
+    {
+        std::lock_guard<std::mutex> lock(m_decoderLock);
+        auto decoder = m_decoders.find(callClass);
+        return (decoder != m_decoders.end()) ? decoder->second : HttpResponseDecoder();
+    }
+
+    void StartDecodeThreads()
+    {
+        std::lock_guard<std::mutex> lock(m_decodeLock);
+        if (!m_decodeThreads.empty())
+        {
+            return;
+        }
+
+        m_decodeShutdown = false;
+        for (unsigned int i = 0; i < m_decodeThreadCount; ++i)
+        {
+            m_decodeThreads.emplace_back(&Impl::DecodeThread, this);
+        }
+    }
+
+    void StopDecodeThreads()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_decodeLock);
+            m_decodeShutdown = true;
+        }
+        m_decodeSignal.notify_all();
+
+        for (auto &thread : m_decodeThreads)
+        {
+            thread.join();
+        }
+        m_decodeThreads.clear();
+    }
+
+    void QueueDecode(HttpResponseDecoder decoder, HttpResponse &&response)
+    {
+        ++m_decodesPending;
+
+        // Signaled under the lock: once the decode thread has the response the call can be returned by
+        // DoWork and the manager destroyed, so this thread must not touch it afterwards.
+        std::lock_guard<std::mutex> lock(m_decodeLock);
+        m_decodeQueue.emplace_back(decoder, std::move(response));
+        m_decodeSignal.notify_one();
+    }
+
+    void DecodeThread()
+    {
+        std::unique_lock<std::mutex> lock(m_decodeLock);
+
+        for (;;)
+        {
+            m_decodeSignal.wait(lock, [this]() { return m_decodeShutdown || !m_decodeQueue.empty(); });
+            if (m_decodeShutdown)
+            {
+                return;
+            }
+
+            auto work = std::move(m_decodeQueue.front());
+            m_decodeQueue.pop_front();
+            lock.unlock();
+
+            auto &response = work.second;
+            try
+            {
+                response.SetDecodedResult(work.first(response));
+            }
+            catch (...)
+            {
+                // Anything escaping a decoder would take down the decode thread, so fail the response instead.
+                response.SetError(E_FAIL, L"[HttpCallManager] Decoder failed");
+            }
+
+            AddResponse(std::move(response));
+            --m_decodesPending;
+
+            lock.lock();
+        }
+    }
+
+    // Creates and sends (or buffers) one attempt of the call.
+    HRESULT StartCall(std::shared_ptr<CallState> call)
+    {
+        ++call->attempt;
+
+        if (!AllowRequest(*call))
+        {
+            FailFast(*call);
+            return S_OK;
+        }
+
+        // Create the request
+        std::shared_ptr<IHttpRequest> request;
+        auto result = m_transport->CreateRequest(call->callback,
+            [this, call](HttpResponse &&response)
+            {
+                OnCallComplete(call, std::move(response));
+            },
+            request);
+        if (FAILED(result)) return result;
+
+        result = request->OpenRequest(call->verb.c_str(), call->uri.c_str());
+        if (FAILED(result)) return result;
+
+        result = request->SetHeaders(call->headers);
+        if (FAILED(result)) return result;
+
+        if(!call->body.IsEmpty())
+        {
+            request->SetContent(call->body);
+        }
+        result = request->SetTimeout(m_timeoutMS);
+        if (FAILED(result)) return result;
+
+        // Transports limit the number of calls to a specific endpoint in flight at once (6 for IXHR2).
+        // This will place the call in a queue if there are too many in flight and on the next frame
+        // send it if there is space.
+        if(AquireCallSlot(call->host))
+        {
+            result = request->Send();
+            if (FAILED(result))
+            {
+                ReleaseCallToHost(call->host);
+                return result;
+            }
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock(m_bufferedCallLock);
+            m_bufferedCalls[call->host].emplace_back(call, request);
+        }
+
+        return result;
+    }
+
+    // Called by the transport, possibly from another thread.
+    void OnCallComplete(std::shared_ptr<CallState> call, HttpResponse &&response)
+    {
+        // Release the slot so another call to this host can be made
+        ReleaseCallToHost(call->host);
+
+        bool failed = IsTransientFailure(response);
+        RecordResult(*call, failed);
+
+        if (failed && call->canRetry && call->attempt < call->policy.maxAttempts)
+        {
+            // Decorrelated jitter: sleep = min(cap, random_between(base, previous sleep * 3))
+            unsigned long delayMS = 0;
+            {
+                std::lock_guard<std::mutex> lock(m_retryLock);
+                unsigned long upper = std::max(call->policy.baseDelayMs, call->lastDelayMS * 3);
+                delayMS = std::uniform_int_distribution<unsigned long>(call->policy.baseDelayMs, upper)(m_random);
+            }
+            delayMS = std::min(delayMS, call->policy.maxDelayMs);
+            call->lastDelayMS = delayMS;
+
+            bool retry = true;
+            if (call->policy.honorRetryAfter)
+            {
+                // Give up instead of waiting longer than the policy allows.
+                auto retryAfterMS = GetRetryAfterMS(response);
+                if (retryAfterMS > call->policy.maxDelayMs)
+                {
+                    retry = false;
+                }
+                delayMS = std::max(delayMS, retryAfterMS);
+            }
+
+            if (retry)
+            {
+                ++m_retries;
+                m_backoffTimeMS += delayMS;
+
+                std::lock_guard<std::mutex> lock(m_retryLock);
+                m_delayedCalls.emplace(std::chrono::steady_clock::now() + std::chrono::milliseconds(delayMS), call);
+                return;
+            }
+        }
+
+        // Successful responses for a call class with a decoder are decoded on a worker thread first.
+        if (call->decoder && !response.IsError() && response.HttpResponseCode() >= 200 && response.HttpResponseCode() < 300)
+        {
+            QueueDecode(call->decoder, std::move(response));
+            return;
+        }
+
+        // Add the response to the queue to be processed later.
+        AddResponse(std::move(response));
+    }
+
+    // Circuit breaker: returns false if calls to the host should fail fast. Admission is decided once
+    // per attempt, which records the circuit generation it was admitted in.
+    bool AllowRequest(CallState &call)
+    {
+        std::lock_guard<std::mutex> lock(m_circuitLock);
+        call.isProbe = false;
+        if (!m_circuitSettings.enabled)
+        {
+            return true;
+        }
+
+        auto &circuit = m_circuits[call.host];
+        call.circuitGeneration = circuit.generation;
+        switch (circuit.state)
+        {
+        case HttpCircuitState::Closed:
+            return true;
+
+        case HttpCircuitState::Open:
+            if (std::chrono::steady_clock::now() < circuit.openUntil)
+            {
+                return false;
+            }
+            // Cool down has elapsed, let a single probe through.
+            circuit.state = HttpCircuitState::HalfOpen;
+            AdmitProbe(circuit, call);
+            return true;
+
+        case HttpCircuitState::HalfOpen:
+        default:
+            if (circuit.probeInFlight)
+            {
+                return false;
+            }
+            AdmitProbe(circuit, call);
+            return true;
+        }
+    }
+
+    static void AdmitProbe(Circuit &circuit, CallState &call)
+    {
+        circuit.probeInFlight = true;
+        call.circuitGeneration = ++circuit.generation;
+        call.isProbe = true;
+    }
+
+    void RecordResult(const CallState &call, bool failed)
+    {
+        std::lock_guard<std::mutex> lock(m_circuitLock);
+        if (!m_circuitSettings.enabled)
+        {
+            return;
+        }
+
+        // Calls that were already in flight when the circuit opened, or that were admitted before the
+        // current probe, say nothing about the host's health now.
+        auto &circuit = m_circuits[call.host];
+        if (call.circuitGeneration != circuit.generation)
+        {
+            return;
+        }
+
+        if (call.isProbe)
+        {
+            circuit.probeInFlight = false;
+        }
+
+        if (!failed)
+        {
+            circuit.state = HttpCircuitState::Closed;
+            circuit.consecutiveFailures = 0;
+            return;
+        }
+
+        ++circuit.consecutiveFailures;
+        if (circuit.state == HttpCircuitState::HalfOpen || circuit.consecutiveFailures >= m_circuitSettings.failureThreshold)
+        {
+            if (circuit.state != HttpCircuitState::Open)
+            {
+                ++m_circuitsOpened;
+            }
+            ++circuit.generation;
+            circuit.probeInFlight = false;
+            circuit.state = HttpCircuitState::Open;
+            circuit.openUntil = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_circuitSettings.openDurationMs);
+        }
+    }
+
+    void FailFast(const CallState &call)
+    {
+        ++m_callsFailedFast;
+        FailCall(call, HTTP_E_CIRCUIT_OPEN, L"[HttpCallManager] Circuit open for host " + call.host);
+    }
+
+    void FailCall(const CallState &call, HRESULT error, const std::wstring &message)
+    {
+        HttpResponse response;
+        response.SetError(error, message);
+        response.SetCallback(call.callback);
+        AddResponse(response);
+    }
+
+    std::mutex                   m_responseLock;
+    std::vector<HttpResponse>    m_responses;
+
+    unsigned long                m_timeoutMS;
+    std::shared_ptr<IHttpTransport> m_transport;
+
+    std::mutex                                               m_requestsInFlightLock;
+    std::map<std::wstring, int>                              m_requestInFlight;
+    std::mutex                                               m_bufferedCallLock;
+    std::map<std::wstring, std::deque<std::pair<std::shared_ptr<CallState>, std::shared_ptr<IHttpRequest>>>> m_bufferedCalls;
+
+    // Retries
+    std::mutex                                                                    m_retryLock;
+    HttpRetryPolicy                                                               m_defaultRetryPolicy;
+    std::map<std::wstring, HttpRetryPolicy>                                       m_retryPolicies;
+    std::multimap<std::chrono::steady_clock::time_point, std::shared_ptr<CallState>> m_delayedCalls;
+    std::mt19937                                                                  m_random;
+
+    // Per-host circuit breakers
+    std::mutex                                               m_circuitLock;
+    HttpCircuitBreakerSettings                               m_circuitSettings;
+    std::map<std::wstring, Circuit>                          m_circuits;
+
+    // Metrics
+    std::atomic<uint64_t>        m_calls;
+    std::atomic<uint64_t>        m_retries;
+    std::atomic<uint64_t>        m_backoffTimeMS;
+    std::atomic<uint64_t>        m_circuitsOpened;
+    std::atomic<uint64_t>        m_callsFailedFast;
+    std::atomic<uint64_t>        m_decodesPending;
+
+    // Decoders have their own lock so that looking one up never waits on retry scheduling.
+    std::mutex                                               m_decoderLock;
+    std::map<std::wstring, HttpResponseDecoder>              m_decoders;
+
+    // Decoding on worker threads. Responses that did not fit in a ProcessResponses budget wait in
+    // m_deferredResponses, which is only touched from the thread calling DoWork/ProcessResponses.
+    std::mutex                                               m_decodeLock;
+    std::condition_variable                                  m_decodeSignal;
+    std::deque<std::pair<HttpResponseDecoder, HttpResponse>> m_decodeQueue;
+    std::vector<std::thread>                                 m_decodeThreads;
+    unsigned int                                             m_decodeThreadCount = 2;
+    bool                                                     m_decodeShutdown = false;
+    std::deque<HttpResponse>                                 m_deferredResponses;
+};
+
+ATG::HttpCallManager::Impl* ATG::HttpCallManager::Impl::s_httpCallManager = nullptr;
+
+ATG::HttpCallManager::HttpCallManager(std::shared_ptr<IHttpTransport> transport) :
+    pImpl(new Impl(transport))
+{
+
+}
+
+// Public Destructor
+ATG::HttpCallManager::~HttpCallManager()
+{
+
+}
+
+// Public Methods
+std::vector<ATG::HttpResponse> ATG::HttpCallManager::DoWork()
+{
+    return pImpl->DoWork();
+}
+
+size_t ATG::HttpCallManager::ProcessResponses(unsigned long budgetUS)
+{
+    return pImpl->ProcessResponses(budgetUS);
+}
+
+size_t ATG::HttpCallManager::GetDeferredResponseCount() const
+{
+    return pImpl->GetDeferredResponseCount();
+}
+
+HRESULT ATG::HttpCallManager::MakeHttpCall(const wchar_t *verb,
+                                           const wchar_t *uri,
+                                           const std::vector<HttpHeader> &headers, 
+                                           std::function<void(HttpResponse *)> callback,
+                                           const wchar_t *callClass)
+{
+    return pImpl->MakeHttpCall(verb, uri, HttpRequestBody(), headers, callback, callClass ? callClass : L"");
+}
+
+HRESULT ATG::HttpCallManager::MakeHttpCall(const wchar_t *verb,
+                                           const wchar_t *uri,
+                                           const std::vector<HttpHeader> &headers, 
+                                           std::vector<unsigned char> &bodyContent,
+                                           std::function<void(HttpResponse *)> callback,
+                                           const wchar_t *callClass)
+{
+    // The caller's vector may go away once this returns, so it is copied into pooled chunks.
+    return pImpl->MakeHttpCall(verb, uri, HttpRequestBody::FromCopy(bodyContent.data(), bodyContent.size()), headers, callback, callClass ? callClass : L"");
+}
+
+HRESULT ATG::HttpCallManager::MakeHttpCall(const wchar_t *verb,
+                                           const wchar_t *uri,
+                                           const std::vector<HttpHeader> &headers, 
+                                           const HttpRequestBody &body,
+                                           std::function<void(HttpResponse *)> callback,
+                                           const wchar_t *callClass)
+{
+    return pImpl->MakeHttpCall(verb, uri, body, headers, callback, callClass ? callClass : L"");
+}
+
+void ATG::HttpCallManager::SetTimeout(unsigned long timeoutMS)
+{
+    pImpl->SetTimeout(timeoutMS);
+}
+
+void ATG::HttpCallManager::SetRetryPolicy(const wchar_t *callClass, const HttpRetryPolicy &policy)
+{
+    pImpl->SetRetryPolicy(callClass, policy);
+}
+
+void ATG::HttpCallManager::SetDecoder(const wchar_t *callClass, HttpResponseDecoder decoder)
+{
+    pImpl->SetDecoder(callClass ? callClass : L"", decoder);
+}
+
+void ATG::HttpCallManager::SetDecodeThreadCount(unsigned int count)
+{
+    pImpl->SetDecodeThreadCount(count);
+}
+
+void ATG::HttpCallManager::SetCircuitBreaker(const HttpCircuitBreakerSettings &settings)
+{
+    pImpl->SetCircuitBreaker(settings);
+}
+
+ATG::HttpCircuitState ATG::HttpCallManager::GetCircuitState(const wchar_t *uri) const
+{
+    return pImpl->GetCircuitState(uri);
+}
+
+ATG::HttpCallMetrics ATG::HttpCallManager::GetMetrics() const
+{
+    return pImpl->GetMetrics();
+}
+
+void ATG::HttpCallManager::AddResponse(HttpResponse response)
+{
+    pImpl->AddResponse(std::move(response));
+}
+
+void ATG::HttpResponse::SetResponseHeaders(const wchar_t *headers, size_t length)
+{
+    m_responseHeaders.assign(headers, length);
+
+    // A line starting with whitespace continues the header before it (obsolete line folding). The line break
+    // is replaced with spaces, so the folded value stays in one piece and the offsets still point into it.
+    for (size_t i = 1; i < length; ++i)
+    {
+        if (m_responseHeaders[i] != L'\r' && m_responseHeaders[i] != L'\n')
+        {
+            continue;
+        }
+
+        size_t breakEnd = i + ((m_responseHeaders[i] == L'\r' && i + 1 < length && m_responseHeaders[i + 1] == L'\n') ? 2 : 1);
+        if (breakEnd < length && IsHeaderWhitespace(m_responseHeaders[breakEnd]))
+        {
+            std::fill(m_responseHeaders.begin() + i, m_responseHeaders.begin() + breakEnd, L' ');
+        }
+        i = breakEnd - 1;
+    }
+
+    m_headerIndex.clear();
+    m_headersIndexed = false;
+}
+
+void ATG::HttpResponse::IndexHeaders() const
+{
+    m_headersIndexed = true;
+
+    const wchar_t *buffer = m_responseHeaders.c_str();
+    size_t size = m_responseHeaders.size();
+    size_t lineStart = 0;
+
+    while (lineStart < size)
+    {
+        size_t lineEnd = lineStart;
+        while (lineEnd < size && buffer[lineEnd] != L'\r' && buffer[lineEnd] != L'\n')
+        {
+            ++lineEnd;
+        }
+
+        // Lines without a colon (status lines, blank lines) are not headers.
+        size_t colon = lineStart;
+        while (colon < lineEnd && buffer[colon] != L':')
+        {
+            ++colon;
+        }
+
+        if (colon < lineEnd && colon > lineStart)
+        {
+            size_t nameEnd = colon;
+            while (nameEnd > lineStart && IsHeaderWhitespace(buffer[nameEnd - 1]))
+            {
+                --nameEnd;
+            }
+
+            size_t valueStart = colon + 1;
+            size_t valueEnd = lineEnd;
+            while (valueStart < valueEnd && IsHeaderWhitespace(buffer[valueStart]))
+            {
+                ++valueStart;
+            }
+            while (valueEnd > valueStart && IsHeaderWhitespace(buffer[valueEnd - 1]))
+            {
+                --valueEnd;
+            }
+
+            HeaderIndex index;
+            index.nameOffset = static_cast<uint32_t>(lineStart);
+            index.nameLength = static_cast<uint32_t>(nameEnd - lineStart);
+            index.valueOffset = static_cast<uint32_t>(valueStart);
+            index.valueLength = static_cast<uint32_t>(valueEnd - valueStart);
+            m_headerIndex.push_back(index);
+        }
+
+        // Skip the line terminator, whether it is \r\n or a lone \n
+        lineStart = lineEnd;
+        while (lineStart < size && (buffer[lineStart] == L'\r' || buffer[lineStart] == L'\n'))
+        {
+            ++lineStart;
+        }
+    }
+}
+
+size_t ATG::HttpResponse::HeaderCount() const
+{
+    if (!m_headersIndexed)
+    {
+        IndexHeaders();
+    }
+    return m_headerIndex.size();
+}
+
+ATG::HttpHeaderView ATG::HttpResponse::Header(size_t index) const
+{
+    if (!m_headersIndexed)
+    {
+        IndexHeaders();
+    }
+
+    const auto &entry = m_headerIndex.at(index);
+    HttpHeaderView header;
+    header.name = m_responseHeaders.c_str() + entry.nameOffset;
+    header.nameLength = entry.nameLength;
+    header.value = m_responseHeaders.c_str() + entry.valueOffset;
+    header.valueLength = entry.valueLength;
+    return header;
+}
+
+bool ATG::HttpResponse::FindHeader(const wchar_t *name, HttpHeaderView &header) const
+{
+    size_t count = HeaderCount();
+    for (size_t i = 0; i < count; ++i)
+    {
+        const auto &entry = m_headerIndex[i];
+        if (TokenEquals(m_responseHeaders.c_str() + entry.nameOffset, entry.nameLength, name))
+        {
+            header = Header(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ATG::HttpResponse::ContentLength(uint64_t &length) const
+{
+    HttpHeaderView header;
+    return FindHeader(L"Content-Length", header) && ParseUnsigned(header.value, header.valueLength, length);
+}
+
+bool ATG::HttpResponse::ETag(HttpHeaderView &etag) const
+{
+    return FindHeader(L"ETag", etag);
+}
+
+bool ATG::HttpResponse::RetryAfter(unsigned long &seconds) const
+{
+    HttpHeaderView header;
+    if (!FindHeader(L"Retry-After", header))
+    {
+        return false;
+    }
+
+    uint64_t delay = 0;
+    if (ParseUnsigned(header.value, header.valueLength, delay))
+    {
+        seconds = static_cast<unsigned long>(std::min<uint64_t>(delay, ULONG_MAX));
+        return true;
+    }
+
+    int64_t date = 0;
+    if (ParseHttpDate(header.value, header.valueLength, date))
+    {
+        int64_t now = static_cast<int64_t>(time(nullptr));
+        seconds = (date > now) ? static_cast<unsigned long>(date - now) : 0;
+        return true;
+    }
+
+    return false;
+}
+
+bool ATG::HttpResponse::CacheControl(HttpCacheControl &cacheControl) const
+{
+    HttpHeaderView header;
+    if (!FindHeader(L"Cache-Control", header))
+    {
+        return false;
+    }
+
+    cacheControl.maxAge = -1;
+    cacheControl.noCache = false;
+    cacheControl.noStore = false;
+    cacheControl.isPrivate = false;
+    cacheControl.isPublic = false;
+    cacheControl.mustRevalidate = false;
+
+    // Comma separated directives, some of which have an =argument
+    const wchar_t *current = header.value;
+    const wchar_t *end = header.value + header.valueLength;
+    while (current < end)
+    {
+        while (current < end && (IsHeaderWhitespace(*current) || *current == L','))
+        {
+            ++current;
+        }
+
+        const wchar_t *directive = current;
+        while (current < end && *current != L',' && *current != L'=' && !IsHeaderWhitespace(*current))
+        {
+            ++current;
+        }
+        size_t directiveLength = current - directive;
+
+        const wchar_t *argument = current;
+        size_t argumentLength = 0;
+        if (current < end && *current == L'=')
+        {
+            argument = ++current;
+            while (current < end && *current != L',' && !IsHeaderWhitespace(*current))
+            {
+                ++current;
+            }
+            argumentLength = current - argument;
+        }
+
+        if (TokenEquals(directive, directiveLength, L"max-age"))
+        {
+            uint64_t maxAge = 0;
+            if (ParseUnsigned(argument, argumentLength, maxAge))
+            {
+                cacheControl.maxAge = static_cast<long>(std::min<uint64_t>(maxAge, LONG_MAX));
+            }
+        }
+        else if (TokenEquals(directive, directiveLength, L"no-cache"))
+        {
+            cacheControl.noCache = true;
+        }
+        else if (TokenEquals(directive, directiveLength, L"no-store"))
+        {
+            cacheControl.noStore = true;
+        }
+        else if (TokenEquals(directive, directiveLength, L"private"))
+        {
+            cacheControl.isPrivate = true;
+        }
+        else if (TokenEquals(directive, directiveLength, L"public"))
+        {
+            cacheControl.isPublic = true;
+        }
+        else if (TokenEquals(directive, directiveLength, L"must-revalidate"))
+        {
+            cacheControl.mustRevalidate = true;
+        }
+
+        while (current < end && *current != L',')
+        {
+            ++current;
+        }
+    }
+
+    return true;
+}
+
+namespace ATG
+{
+    // A copy of the caller's data held in chunks from the HttpBufferPool.
+    class HttpPooledBody : public HttpRequestBody::Source
+    {
+    public:
+        HttpPooledBody(const void *buffer, size_t size) : m_size(size)
+        {
+            auto source = static_cast<const unsigned char *>(buffer);
+            for (size_t offset = 0; offset < size; offset += c_maxRequestChunkSize)
+            {
+                auto chunk = HttpBufferPool::Get().Allocate();
+                memcpy(chunk, source + offset, std::min(c_maxRequestChunkSize, size - offset));
+                m_chunks.push_back(chunk);
+            }
+        }
+
+        ~HttpPooledBody()
+        {
+            for (auto chunk : m_chunks)
+            {
+                HttpBufferPool::Get().Free(chunk);
+            }
+        }
+
+        size_t Size() const override { return m_size; }
+
+        HRESULT Read(size_t offset, unsigned char *buffer, size_t bufferSize, size_t *bytesRead) override
+        {
+            size_t total = 0;
+            while (total < bufferSize && offset < m_size)
+            {
+                size_t chunkOffset = offset % c_maxRequestChunkSize;
+                size_t count = std::min(std::min(bufferSize - total, c_maxRequestChunkSize - chunkOffset), m_size - offset);
+                memcpy(buffer + total, m_chunks[offset / c_maxRequestChunkSize] + chunkOffset, count);
+                total += count;
+                offset += count;
+            }
+            *bytesRead = total;
+            return S_OK;
+        }
+
+    private:
+        std::vector<unsigned char *> m_chunks;
+        size_t                       m_size;
+    };
+
+    // Data generated on demand straight into the transport's buffer. It can only be read once.
+    class HttpProducerBody : public HttpRequestBody::Source
+    {
+    public:
+        HttpProducerBody(size_t size, HttpRequestBody::Producer producer) : m_size(size), m_position(0), m_producer(producer) {}
+
+        size_t Size() const override { return m_size; }
+        bool IsReplayable() const override { return false; }
+
+        HRESULT Read(size_t offset, unsigned char *buffer, size_t bufferSize, size_t *bytesRead) override
+        {
+            if (offset != m_position)
+            {
+                return E_ILLEGAL_METHOD_CALL;
+            }
+
+            size_t total = 0;
+            bufferSize = std::min(bufferSize, m_size - m_position);
+            while (total < bufferSize)
+            {
+                size_t written = 0;
+                HRESULT result = m_producer(buffer + total, bufferSize - total, &written);
+                if (FAILED(result))
+                {
+                    return result;
+                }
+
+                total += written;
+                if (result == S_FALSE || written == 0)
+                {
+                    break;
+                }
+            }
+
+            m_position += total;
+            *bytesRead = total;
+            return S_OK;
+        }
+
+    private:
+        size_t                     m_size;
+        size_t                     m_position;
+        HttpRequestBody::Producer  m_producer;
+    };
+}
+
+ATG::HttpRequestBody ATG::HttpRequestBody::FromBuffer(const void *buffer, size_t size)
+{
+    return HttpRequestBody(std::make_shared<HttpBufferBody>(buffer, size));
+}
+
+ATG::HttpRequestBody ATG::HttpRequestBody::FromCopy(const void *buffer, size_t size)
+{
+    return HttpRequestBody(std::make_shared<HttpPooledBody>(buffer, size));
+}
+ATG::HttpRequestBody ATG::HttpRequestBody::FromProducer(size_t size, Producer producer)
+{
+    return HttpRequestBody(std::make_shared<HttpProducerBody>(size, producer));
+}
+
+size_t ATG::HttpRequestBody::Size() const
+{
+    return m_source ? m_source->Size() : 0;
+}
+
+bool ATG::HttpRequestBody::IsReplayable() const
+{
+    return !m_source || m_source->IsReplayable();
+}
+
+HRESULT ATG::HttpRequestBody::Read(size_t offset, unsigned char *buffer, size_t bufferSize, size_t *bytesRead) const
+{
+    if (!m_source)
+    {
+        *bytesRead = 0;
+        return S_OK;
+    }
+    return m_source->Read(offset, buffer, bufferSize, bytesRead);
+}
+
+#ifndef _WIN32
+
+namespace ATG
+{
+    // Read-only mapping of a file, as HttpCall.cpp makes on Windows. Pages are only brought in as they are read.
+    class HttpMappedFileBody : public HttpBufferBody
+    {
+    public:
+        HttpMappedFileBody() : HttpBufferBody(nullptr, 0) {}
+
+        ~HttpMappedFileBody()
+        {
+            if (m_buffer != nullptr)
+            {
+                munmap(const_cast<unsigned char *>(m_buffer), m_size);
+            }
+        }
+
+        HRESULT Open(const wchar_t *fileName)
+        {
+            size_t length = wcstombs(nullptr, fileName, 0);
+            if (length == static_cast<size_t>(-1))
+            {
+                return E_INVALIDARG;
+            }
+            std::string path(length, '\0');
+            wcstombs(&path[0], fileName, length);
+
+            int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (file < 0)
+            {
+                return (errno == ENOENT) ? HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) : E_FAIL;
+            }
+
+            HRESULT result = S_OK;
+            struct stat fileInfo;
+            if (fstat(file, &fileInfo) != 0)
+            {
+                result = E_FAIL;
+            }
+            else if (fileInfo.st_size > 0)  // Empty files can't be mapped, but make a valid empty body.
+            {
+                void *view = mmap(nullptr, static_cast<size_t>(fileInfo.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+                if (view == MAP_FAILED)
+                {
+                    result = E_FAIL;
+                }
+                else
+                {
+                    m_buffer = static_cast<const unsigned char *>(view);
+                    m_size = static_cast<size_t>(fileInfo.st_size);
+                }
+            }
+
+            close(file);
+            return result;
+        }
+    };
+}
+
+HRESULT ATG::HttpRequestBody::FromFile(const wchar_t *fileName, HttpRequestBody &body)
+{
+    auto source = std::make_shared<HttpMappedFileBody>();
+    auto result = source->Open(fileName);
+    if (SUCCEEDED(result))
+    {
+        body = HttpRequestBody(source);
+    }
+    return result;
+}
+
+#endif
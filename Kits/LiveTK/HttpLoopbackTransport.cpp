@@ -0,0 +1,592 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Compiled without the precompiled header; see HttpPlatform.h.
+
+#include "HttpLoopbackTransport.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+
+namespace
+{
+    // HTTP request lines and headers are ASCII, so a simple narrowing/widening is all that is needed here.
+    std::string NarrowAscii(const std::wstring &string)
+    {
+        std::string result;
+        result.reserve(string.size());
+        for (auto c : string)
+        {
+            result.push_back(static_cast<char>(c & 0x7F));
+        }
+        return result;
+    }
+
+    std::wstring WidenAscii(const char *begin, const char *end)
+    {
+        return std::wstring(begin, end);
+    }
+
+    // Splits an absolute url into the host and the path (including the query).
+    void SplitUrl(const std::wstring &url, std::wstring &host, std::wstring &path)
+    {
+        size_t hostStart = url.find(L"://");
+        hostStart = (hostStart == std::wstring::npos) ? 0 : hostStart + 3;
+
+        size_t pathStart = url.find(L'/', hostStart);
+        if (pathStart == std::wstring::npos)
+        {
+            host = url.substr(hostStart);
+            path = L"/";
+        }
+        else
+        {
+            host = url.substr(hostStart, pathStart - hostStart);
+            path = url.substr(pathStart);
+        }
+    }
+
+    const char *StatusText(unsigned long statusCode)
+    {
+        switch (statusCode)
+        {
+        case 200: return "OK";
+        case 201: return "Created";
+        case 204: return "No Content";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 429: return "Too Many Requests";
+        case 500: return "Internal Server Error";
+        case 503: return "Service Unavailable";
+        default:  return "Unknown";
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// LoopbackHttpServer
+//--------------------------------------------------------------------------------------
+
+class ATG::LoopbackHttpServer::Impl
+{
+public:
+    Impl(unsigned int workerThreads, uint32_t seed) :
+        m_shutdown(false),
+        m_random(seed)
+    {
+        ResetStats();
+
+        workerThreads = std::max(workerThreads, 1u);
+        for (unsigned int i = 0; i < workerThreads; ++i)
+        {
+            m_workers.emplace_back(&Impl::WorkerThread, this);
+        }
+    }
+
+    ~Impl()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_jobLock);
+            m_shutdown = true;
+        }
+        m_jobSignal.notify_all();
+
+        for (auto &worker : m_workers)
+        {
+            worker.join();
+        }
+
+        // Every request gets exactly one completion, so the ones that were never answered are failed.
+        // A completion may submit again, hence the loop.
+        std::multimap<TimePoint, Job> pending;
+        for (;;)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_jobLock);
+                pending.swap(m_jobs);
+            }
+            if (pending.empty())
+            {
+                break;
+            }
+
+            for (auto &job : pending)
+            {
+                job.second.completion(E_ABORT, std::string());
+            }
+            pending.clear();
+        }
+    }
+
+    void AddRoute(const LoopbackRoute &route)
+    {
+        std::lock_guard<std::mutex> lock(m_routeLock);
+        m_routes.push_back(route);
+    }
+
+    void ClearRoutes()
+    {
+        std::lock_guard<std::mutex> lock(m_routeLock);
+        m_routes.clear();
+    }
+
+    LoopbackServerStats GetStats() const
+    {
+        LoopbackServerStats stats;
+        stats.requests = m_requests;
+        stats.bytesReceived = m_bytesReceived;
+        stats.bytesSent = m_bytesSent;
+        stats.errorsInjected = m_errorsInjected;
+        stats.throttled = m_throttled;
+        stats.timeouts = m_timeouts;
+        stats.notFound = m_notFound;
+        return stats;
+    }
+
+    void ResetStats()
+    {
+        m_requests = 0;
+        m_bytesReceived = 0;
+        m_bytesSent = 0;
+        m_errorsInjected = 0;
+        m_throttled = 0;
+        m_timeouts = 0;
+        m_notFound = 0;
+    }
+
+    void Submit(std::string &&rawRequest, unsigned long timeoutMs, std::function<void(HRESULT, std::string &&)> completion)
+    {
+        Job job;
+        job.parsed = false;
+        job.timeoutMs = timeoutMs;
+        job.result = S_OK;
+        job.data = std::move(rawRequest);
+        job.completion = completion;
+
+        Schedule(std::chrono::steady_clock::now(), std::move(job));
+    }
+
+private:
+    struct Job
+    {
+        bool                                         parsed;
+        unsigned long                                timeoutMs;
+        HRESULT                                      result;
+        std::string                                  data;        // The request until parsed, then the response
+        std::function<void(HRESULT, std::string &&)> completion;
+    };
+
+    typedef std::chrono::steady_clock::time_point TimePoint;
+
+    void Schedule(TimePoint due, Job &&job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_jobLock);
+            m_jobs.emplace(due, std::move(job));
+        }
+        m_jobSignal.notify_one();
+    }
+
+    void WorkerThread()
+    {
+        std::unique_lock<std::mutex> lock(m_jobLock);
+
+        while (!m_shutdown)
+        {
+            if (m_jobs.empty())
+            {
+                m_jobSignal.wait(lock);
+                continue;
+            }
+
+            auto next = m_jobs.begin();
+            TimePoint due = next->first;
+            if (due > std::chrono::steady_clock::now())
+            {
+                // Another worker may take the job while this one waits, so wait on a copy of the time.
+                m_jobSignal.wait_until(lock, due);
+                continue;
+            }
+
+            Job job = std::move(next->second);
+            m_jobs.erase(next);
+
+            lock.unlock();
+
+            if (job.parsed)
+            {
+                job.completion(job.result, std::move(job.data));
+            }
+            else
+            {
+                unsigned long delayMs = HandleRequest(job);
+                Schedule(std::chrono::steady_clock::now() + std::chrono::milliseconds(delayMs), std::move(job));
+            }
+
+            lock.lock();
+        }
+    }
+
+    // Parses the request held by the job and replaces it with the response. Returns the delay
+    // before the response should be delivered.
+    unsigned long HandleRequest(Job &job)
+    {
+        ++m_requests;
+        m_bytesReceived += job.data.size();
+        job.parsed = true;
+
+        // Request line: VERB SP path SP HTTP/1.1
+        const std::string &request = job.data;
+        size_t lineEnd = request.find("\r\n");
+        size_t verbEnd = request.find(' ');
+        size_t pathEnd = (verbEnd == std::string::npos) ? std::string::npos : request.find(' ', verbEnd + 1);
+        if (lineEnd == std::string::npos || pathEnd == std::string::npos || pathEnd > lineEnd)
+        {
+            job.data = BuildResponse(400, std::vector<HttpHeader>(), std::string(), 0);
+            return 0;
+        }
+
+        std::wstring path = WidenAscii(request.data() + verbEnd + 1, request.data() + pathEnd);
+        bool isHead = request.compare(0, verbEnd, "HEAD") == 0;
+
+        LoopbackRoute route;
+        bool found = false;
+        float roll = 0.0f;
+        unsigned long jitterMs = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_routeLock);
+
+            size_t bestLength = 0;
+            for (const auto &candidate : m_routes)
+            {
+                if (path.compare(0, candidate.pathPrefix.size(), candidate.pathPrefix) == 0
+                    && (!found || candidate.pathPrefix.size() > bestLength))
+                {
+                    route = candidate;
+                    bestLength = candidate.pathPrefix.size();
+                    found = true;
+                }
+            }
+
+            roll = std::uniform_real_distribution<float>(0.0f, 1.0f)(m_random);
+            if (found && route.latencyJitterMs > 0)
+            {
+                jitterMs = std::uniform_int_distribution<unsigned long>(0, route.latencyJitterMs)(m_random);
+            }
+        }
+
+        if (!found)
+        {
+            ++m_notFound;
+            job.data = BuildResponse(404, std::vector<HttpHeader>(), std::string(), 0);
+            return 0;
+        }
+
+        unsigned long delayMs = route.latencyMs + jitterMs;
+
+        if (roll < route.errorRate)
+        {
+            ++m_errorsInjected;
+            job.result = route.errorCode;
+            job.data.clear();
+        }
+        else if (roll < route.errorRate + route.throttleRate)
+        {
+            ++m_throttled;
+            std::vector<HttpHeader> headers;
+            headers.emplace_back(L"Retry-After", std::to_wstring(route.retryAfterSeconds).c_str());
+            job.data = BuildResponse(503, headers, std::string(), 0);
+        }
+        else
+        {
+            std::string echoed;
+            if (route.echoBody)
+            {
+                size_t headersEnd = request.find("\r\n\r\n");
+                echoed = (headersEnd == std::string::npos) ? std::string() : request.substr(headersEnd + 4);
+            }
+            job.data = BuildResponse(route.statusCode, route.headers, route.echoBody ? echoed : route.body, isHead ? 0 : route.bodySize);
+            if (route.bytesPerSecond > 0)
+            {
+                delayMs += static_cast<unsigned long>((job.data.size() * 1000) / route.bytesPerSecond);
+            }
+        }
+
+        if (job.timeoutMs != 0 && delayMs > job.timeoutMs)
+        {
+            ++m_timeouts;
+            job.result = HRESULT_FROM_WIN32(ERROR_TIMEOUT);
+            job.data.clear();
+            delayMs = job.timeoutMs;
+        }
+
+        m_bytesSent += job.data.size();
+        return delayMs;
+    }
+
+    static std::string BuildResponse(unsigned long statusCode, const std::vector<HttpHeader> &headers, const std::string &body, size_t fillerSize)
+    {
+        size_t bodySize = body.empty() ? fillerSize : body.size();
+
+        std::string response = "HTTP/1.1 ";
+        response.append(std::to_string(statusCode));
+        response.push_back(' ');
+        response.append(StatusText(statusCode));
+        response.append("\r\n");
+
+        bool hasContentLength = false;
+        for (const auto &header : headers)
+        {
+            response.append(NarrowAscii(header.Header()));
+            response.append(": ");
+            response.append(NarrowAscii(header.Value()));
+            response.append("\r\n");
+            hasContentLength = hasContentLength || _wcsicmp(header.Header().c_str(), L"Content-Length") == 0;
+        }
+
+        // A route's own Content-Length is sent in place of the real one, so malformed values can be scripted
+        if (!hasContentLength)
+        {
+            response.append("Content-Length: ");
+            response.append(std::to_string(bodySize));
+            response.append("\r\n");
+        }
+        response.append("\r\n");
+
+        if (body.empty())
+        {
+            response.append(fillerSize, 'x');
+        }
+        else
+        {
+            response.append(body);
+        }
+
+        return response;
+    }
+
+    std::mutex                      m_jobLock;
+    std::condition_variable         m_jobSignal;
+    std::multimap<TimePoint, Job>   m_jobs;
+    bool                            m_shutdown;
+    std::vector<std::thread>        m_workers;
+
+    std::mutex                      m_routeLock;
+    std::vector<LoopbackRoute>      m_routes;
+    std::mt19937                    m_random;
+
+    std::atomic<uint64_t>           m_requests;
+    std::atomic<uint64_t>           m_bytesReceived;
+    std::atomic<uint64_t>           m_bytesSent;
+    std::atomic<uint64_t>           m_errorsInjected;
+    std::atomic<uint64_t>           m_throttled;
+    std::atomic<uint64_t>           m_timeouts;
+    std::atomic<uint64_t>           m_notFound;
+};
+
+ATG::LoopbackHttpServer::LoopbackHttpServer(unsigned int workerThreads, uint32_t seed) :
+    pImpl(new Impl(workerThreads, seed))
+{
+}
+
+ATG::LoopbackHttpServer::~LoopbackHttpServer()
+{
+}
+
+void ATG::LoopbackHttpServer::AddRoute(const LoopbackRoute &route)
+{
+    pImpl->AddRoute(route);
+}
+
+void ATG::LoopbackHttpServer::ClearRoutes()
+{
+    pImpl->ClearRoutes();
+}
+
+ATG::LoopbackServerStats ATG::LoopbackHttpServer::GetStats() const
+{
+    return pImpl->GetStats();
+}
+
+void ATG::LoopbackHttpServer::ResetStats()
+{
+    pImpl->ResetStats();
+}
+
+void ATG::LoopbackHttpServer::Submit(std::string &&rawRequest, unsigned long timeoutMs, std::function<void(HRESULT, std::string &&)> completion)
+{
+    pImpl->Submit(std::move(rawRequest), timeoutMs, completion);
+}
+
+//--------------------------------------------------------------------------------------
+// LoopbackHttpTransport
+//--------------------------------------------------------------------------------------
+
+namespace ATG
+{
+    // Builds the HTTP/1.1 text for a call and parses the server's reply back into an HttpResponse.
+    class LoopbackHttpRequest : public IHttpRequest, public std::enable_shared_from_this<LoopbackHttpRequest>
+    {
+    public:
+        LoopbackHttpRequest(std::shared_ptr<LoopbackHttpServer> server, std::function<void(HttpResponse *)> callback, HttpCompletionHandler onComplete) :
+            m_server(server),
+            m_onComplete(onComplete),
+            m_timeoutMs(0)
+        {
+            m_response.SetCallback(callback);
+        }
+
+        HRESULT OpenRequest(const wchar_t *verb, const wchar_t *url) override
+        {
+            std::wstring host;
+            std::wstring path;
+            SplitUrl(url, host, path);
+
+            m_request = NarrowAscii(verb);
+            m_request.push_back(' ');
+            m_request.append(NarrowAscii(path));
+            m_request.append(" HTTP/1.1\r\nHost: ");
+            m_request.append(NarrowAscii(host));
+            m_request.append("\r\nUser-Agent: ATG-HttpCallManager\r\n");
+
+            return S_OK;
+        }
+
+        HRESULT SetTimeout(unsigned long timeoutMs) override
+        {
+            m_timeoutMs = timeoutMs;
+            return S_OK;
+        }
+
+        HRESULT SetHeaders(const std::vector<HttpHeader> &headers) override
+        {
+            for (const auto &header : headers)
+            {
+                m_request.append(NarrowAscii(header.Header()));
+                m_request.append(": ");
+                m_request.append(NarrowAscii(header.Value()));
+                m_request.append("\r\n");
+            }
+            return S_OK;
+        }
+
+        void SetContent(const HttpRequestBody &body) override
+        {
+            m_body = body;
+        }
+
+        HRESULT Send() override
+        {
+            std::string request = m_request;
+            request.append("Content-Length: ");
+            request.append(std::to_string(m_body.Size()));
+            request.append("\r\n\r\n");
+
+            // The body is pulled in the same sized reads IXHR2 would use.
+            size_t headerSize = request.size();
+            request.resize(headerSize + m_body.Size());
+            size_t offset = 0;
+            while (offset < m_body.Size())
+            {
+                size_t bytesRead = 0;
+                size_t readSize = std::min<size_t>(m_body.Size() - offset, 128 * 1024);
+                HRESULT result = m_body.Read(offset, reinterpret_cast<unsigned char *>(&request[headerSize + offset]), readSize, &bytesRead);
+                if (FAILED(result))
+                {
+                    return result;
+                }
+                if (bytesRead == 0)
+                {
+                    break;
+                }
+                offset += bytesRead;
+            }
+            request.resize(headerSize + offset);
+
+            // Keep the request alive until the server has answered.
+            auto self = shared_from_this();
+            m_server->Submit(std::move(request), m_timeoutMs, [self](HRESULT result, std::string &&response)
+            {
+                self->OnComplete(result, response);
+            });
+
+            return S_OK;
+        }
+
+    private:
+        void OnComplete(HRESULT result, const std::string &response)
+        {
+            if (FAILED(result))
+            {
+                std::wstring errorMessage = L"[LoopbackHttpRequest::OnError] ";
+                errorMessage.append(std::to_wstring(result));
+                m_response.SetError(result, errorMessage);
+            }
+            else
+            {
+                ParseResponse(response);
+            }
+
+            m_onComplete(std::move(m_response));
+        }
+
+        void ParseResponse(const std::string &response)
+        {
+            // Status line: HTTP/1.1 SP code SP reason
+            size_t statusEnd = response.find("\r\n");
+            size_t codeStart = response.find(' ');
+            if (statusEnd == std::string::npos || codeStart == std::string::npos || codeStart > statusEnd)
+            {
+                m_response.SetError(E_FAIL, L"[LoopbackHttpRequest] Malformed status line");
+                return;
+            }
+            m_response.SetResponseCode(strtoul(response.c_str() + codeStart + 1, nullptr, 10));
+
+            size_t headersEnd = response.find("\r\n\r\n", statusEnd);
+            if (headersEnd == std::string::npos)
+            {
+                m_response.SetError(E_FAIL, L"[LoopbackHttpRequest] Malformed headers");
+                return;
+            }
+
+            // Headers are handed over in the same "Name: value\r\n" form as GetAllResponseHeaders.
+            std::wstring headers = WidenAscii(response.data() + statusEnd + 2, response.data() + headersEnd + 2);
+            m_response.SetResponseHeaders(headers.c_str(), headers.size());
+
+            size_t bodyStart = headersEnd + 4;
+            size_t bodySize = response.size() - bodyStart;
+            unsigned char *body = nullptr;
+            if (bodySize > 0)
+            {
+                body = new unsigned char[bodySize];
+                memcpy(body, response.data() + bodyStart, bodySize);
+            }
+            m_response.SetResponseBody(body, bodySize);
+        }
+
+        std::shared_ptr<LoopbackHttpServer> m_server;
+        HttpCompletionHandler               m_onComplete;
+        HttpResponse                        m_response;
+
+        std::string                         m_request;
+        HttpRequestBody                     m_body;
+        unsigned long                       m_timeoutMs;
+    };
+}
+
+HRESULT ATG::LoopbackHttpTransport::CreateRequest(std::function<void(HttpResponse *)> callback,
+                                                   HttpCompletionHandler onComplete,
+                                                   std::shared_ptr<IHttpRequest> &request)
+{
+    request = std::make_shared<LoopbackHttpRequest>(m_server, callback, onComplete);
+    return S_OK;
+}
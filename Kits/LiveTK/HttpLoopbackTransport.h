@@ -0,0 +1,120 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// In-process HTTP/1.1 server and matching IHttpTransport for exercising the HttpCallManager
+// without a network connection or Xbox Live. Requests are serialized to HTTP/1.1 text, handed to
+// the server's worker threads, parsed, answered from a set of scripted routes and parsed back
+// into an HttpResponse. Latency, throughput and failures can be injected per route.
+//
+
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "HttpCall.h"
+
+namespace ATG
+{
+    // Scripted behavior for all requests whose path starts with pathPrefix. The longest matching
+    // prefix wins; requests that match no route are answered with a 404.
+    struct LoopbackRoute
+    {
+        LoopbackRoute() :
+            statusCode(200),
+            bodySize(0),
+            echoBody(false),
+            latencyMs(0),
+            latencyJitterMs(0),
+            bytesPerSecond(0),
+            errorRate(0.0f),
+            errorCode(E_FAIL),
+            throttleRate(0.0f),
+            retryAfterSeconds(1)
+        {}
+
+        std::wstring            pathPrefix;
+        unsigned long           statusCode;
+        std::vector<HttpHeader> headers;           // A Content-Length here replaces the one the server sends
+        std::string             body;              // Sent as-is when not empty
+        size_t                  bodySize;          // Otherwise this many filler bytes are sent
+        bool                    echoBody;          // Or the request's own body is sent back
+
+        unsigned long           latencyMs;         // Time to first byte
+        unsigned long           latencyJitterMs;   // Uniform random extra latency
+        uint64_t                bytesPerSecond;    // Simulated transfer rate, 0 is unlimited
+
+        float                   errorRate;         // Fraction of requests failing with errorCode
+        HRESULT                 errorCode;
+        float                   throttleRate;      // Fraction of requests answered with 503 and Retry-After
+        unsigned long           retryAfterSeconds;
+    };
+
+    struct LoopbackServerStats
+    {
+        uint64_t requests;
+        uint64_t bytesReceived;
+        uint64_t bytesSent;
+        uint64_t errorsInjected;
+        uint64_t throttled;
+        uint64_t timeouts;
+        uint64_t notFound;
+    };
+
+    class LoopbackHttpServer
+    {
+    public:
+        // Results are deterministic for a given seed and request order when workerThreads is 1.
+        explicit LoopbackHttpServer(unsigned int workerThreads = 2, uint32_t seed = 0);
+
+        LoopbackHttpServer(LoopbackHttpServer const&) = delete;
+        LoopbackHttpServer& operator=(LoopbackHttpServer const&) = delete;
+
+        ~LoopbackHttpServer();
+
+        void AddRoute(const LoopbackRoute &route);
+        void ClearRoutes();
+
+        LoopbackServerStats GetStats() const;
+        void ResetStats();
+
+        // Queues a raw HTTP/1.1 request. The completion is called on a server thread with either a raw
+        // HTTP/1.1 response and S_OK, or a failed HRESULT and an empty response. A timeout of 0 waits
+        // for the scripted latency regardless of its length. Requests that have not completed when the
+        // server is destroyed complete with E_ABORT.
+        void Submit(std::string &&rawRequest,
+                    unsigned long timeoutMs,
+                    std::function<void(HRESULT, std::string &&)> completion);
+
+    private:
+        // Private implementation.
+        class Impl;
+
+        std::unique_ptr<Impl> pImpl;
+    };
+
+    // IHttpTransport that sends every call to a LoopbackHttpServer.
+    class LoopbackHttpTransport : public IHttpTransport
+    {
+    public:
+        explicit LoopbackHttpTransport(std::shared_ptr<LoopbackHttpServer> server, int maxCallsPerHost = 6) :
+            m_server(server),
+            m_maxCallsPerHost(maxCallsPerHost)
+        {}
+
+        HRESULT CreateRequest(std::function<void(HttpResponse *)> callback,
+                              HttpCompletionHandler onComplete,
+                              std::shared_ptr<IHttpRequest> &request) override;
+
+        int MaxCallsPerHost() const override { return m_maxCallsPerHost; }
+
+    private:
+        std::shared_ptr<LoopbackHttpServer> m_server;
+        int                                 m_maxCallsPerHost;
+    };
+}
@@ -0,0 +1,51 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// The few Windows types the portable parts of the HttpCallManager use (HttpCallManager.cpp and
+// HttpLoopbackTransport.cpp), so that they also build without the Windows headers.
+//
+
+#pragma once
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+#else
+
+#include <stdint.h>
+#include <wchar.h>
+
+typedef int32_t HRESULT;
+
+#define SUCCEEDED(hr)   (((HRESULT)(hr)) >= 0)
+#define FAILED(hr)      (((HRESULT)(hr)) < 0)
+
+#define SEVERITY_ERROR  1
+#define FACILITY_ITF    4
+#define FACILITY_WIN32  7
+
+#define MAKE_HRESULT(sev, fac, code) \
+    ((HRESULT)(((uint32_t)(sev) << 31) | ((uint32_t)(fac) << 16) | ((uint32_t)(code))))
+
+#define S_OK                    ((HRESULT)0)
+#define S_FALSE                 ((HRESULT)1)
+#define E_NOTIMPL               ((HRESULT)0x80004001)
+#define E_ABORT                 ((HRESULT)0x80004004)
+#define E_FAIL                  ((HRESULT)0x80004005)
+#define E_ILLEGAL_METHOD_CALL   ((HRESULT)0x8000000E)
+#define E_INVALIDARG            ((HRESULT)0x80070057)
+
+#define ERROR_FILE_NOT_FOUND    2
+#define ERROR_TIMEOUT           1460
+
+inline HRESULT HRESULT_FROM_WIN32(unsigned long error)
+{
+    return (HRESULT)error <= 0 ? (HRESULT)error : MAKE_HRESULT(SEVERITY_ERROR, FACILITY_WIN32, error & 0x0000FFFF);
+}
+
+inline int _wcsicmp(const wchar_t *a, const wchar_t *b) { return wcscasecmp(a, b); }
+inline int _wcsnicmp(const wchar_t *a, const wchar_t *b, size_t count) { return wcsncasecmp(a, b, count); }
+
+#endif
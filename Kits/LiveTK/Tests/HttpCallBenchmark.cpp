@@ -0,0 +1,115 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Requests per second and latency percentiles of the HttpCallManager over the loopback transport.
+// The server answers immediately, so this measures the manager, the transport and the HTTP/1.1
+// serialization rather than any simulated network.
+//
+// Usage: HttpCallBenchmark [requests] [calls in flight]
+//
+
+#include "HttpCall.h"
+#include "HttpLoopbackTransport.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+using namespace ATG;
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    struct Result
+    {
+        double requestsPerSecond;
+        double p50Us;
+        double p99Us;
+    };
+
+    Result Run(unsigned int serverThreads, size_t requests, size_t inFlight, size_t bodySize)
+    {
+        auto server = std::make_shared<LoopbackHttpServer>(serverThreads);
+        LoopbackRoute route;
+        route.pathPrefix = L"/";
+        route.bodySize = bodySize;
+        server->AddRoute(route);
+
+        // Allow every call in flight at once so the manager's own per-host buffering is not the limit.
+        HttpCallManager manager(std::make_shared<LoopbackHttpTransport>(server, static_cast<int>(inFlight)));
+
+        std::vector<double> latencies;
+        latencies.reserve(requests);
+
+        size_t started = 0;
+        size_t completed = 0;
+        auto issue = [&]()
+        {
+            auto sent = Clock::now();
+            ++started;
+            manager.MakeHttpCall(L"GET", L"https://loopback/item", std::vector<HttpHeader>(), [&, sent](HttpResponse *response)
+            {
+                if (response->IsError() || response->HttpResponseCode() != 200)
+                {
+                    printf("Request failed\n");
+                    exit(1);
+                }
+                latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - sent).count());
+                ++completed;
+            });
+        };
+
+        auto start = Clock::now();
+        while (started < std::min(inFlight, requests))
+        {
+            issue();
+        }
+
+        while (completed < requests)
+        {
+            for (auto &response : manager.DoWork())
+            {
+                response.Process();
+                if (started < requests)
+                {
+                    issue();
+                }
+            }
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        std::sort(latencies.begin(), latencies.end());
+        Result result;
+        result.requestsPerSecond = requests / seconds;
+        result.p50Us = latencies[latencies.size() / 2];
+        result.p99Us = latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+        return result;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t requests = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 100000;
+    size_t inFlight = (argc > 2) ? strtoul(argv[2], nullptr, 10) : 64;
+
+    printf("%zu requests, %zu in flight\n", requests, inFlight);
+    printf("%-16s %-10s %14s %12s %12s\n", "server threads", "body", "requests/s", "p50 (us)", "p99 (us)");
+
+    const unsigned int threads[] = { 1, 2, 4 };
+    const size_t bodies[] = { 0, 4096 };
+    for (auto bodySize : bodies)
+    {
+        for (auto serverThreads : threads)
+        {
+            auto result = Run(serverThreads, requests, inFlight, bodySize);
+            printf("%-16u %-10zu %14.0f %12.1f %12.1f\n", serverThreads, bodySize, result.requestsPerSecond, result.p50Us, result.p99Us);
+        }
+    }
+
+    return 0;
+}
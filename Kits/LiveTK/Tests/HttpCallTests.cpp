@@ -0,0 +1,1125 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Tests for the portable HttpCallManager core, driven through the in-process loopback server.
+//
+
+#include "HttpCall.h"
+#include "HttpLoopbackTransport.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace ATG;
+
+namespace
+{
+    int g_failures = 0;
+
+#define CHECK(condition) \
+    do { if (!(condition)) { ++g_failures; printf("%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #condition); } } while (0)
+
+    typedef std::chrono::steady_clock Clock;
+
+    // A call's outcome as seen by its callback.
+    struct CallResult
+    {
+        CallResult() : done(false), error(S_OK), status(0) {}
+
+        bool          done;
+        long          error;
+        unsigned long status;
+    };
+
+    std::function<void(HttpResponse *)> Record(std::shared_ptr<CallResult> result)
+    {
+        return [result](HttpResponse *response)
+        {
+            result->done = true;
+            result->error = response->ErrorCode();
+            result->status = response->HttpResponseCode();
+        };
+    }
+
+    // Pumps DoWork until the predicate holds or the timeout expires.
+    bool PumpUntil(HttpCallManager &manager, std::function<bool()> predicate, unsigned long timeoutMs = 5000)
+    {
+        auto deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+        for (;;)
+        {
+            for (auto &response : manager.DoWork())
+            {
+                response.Process();
+            }
+            if (predicate())
+            {
+                return true;
+            }
+            if (Clock::now() > deadline)
+            {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    void PumpFor(HttpCallManager &manager, unsigned long ms)
+    {
+        PumpUntil(manager, []() { return false; }, ms);
+    }
+
+    std::shared_ptr<CallResult> Get(HttpCallManager &manager, const wchar_t *url)
+    {
+        auto result = std::make_shared<CallResult>();
+        CHECK(SUCCEEDED(manager.MakeHttpCall(L"GET", url, std::vector<HttpHeader>(), Record(result))));
+        return result;
+    }
+
+    LoopbackRoute Route(const wchar_t *path, unsigned long latencyMs = 0)
+    {
+        LoopbackRoute route;
+        route.pathPrefix = path;
+        route.latencyMs = latencyMs;
+        return route;
+    }
+
+    LoopbackRoute FailingRoute(const wchar_t *path)
+    {
+        LoopbackRoute route = Route(path);
+        route.errorRate = 1.0f;
+        return route;
+    }
+
+    // Makes a GET and returns a copy of the response once it has been processed.
+    std::shared_ptr<HttpResponse> Fetch(HttpCallManager &manager, const wchar_t *url)
+    {
+        auto response = std::make_shared<HttpResponse>();
+        bool done = false;
+        CHECK(SUCCEEDED(manager.MakeHttpCall(L"GET", url, std::vector<HttpHeader>(), [&response, &done](HttpResponse *completed)
+        {
+            *response = *completed;
+            done = true;
+        })));
+        CHECK(PumpUntil(manager, [&done]() { return done; }));
+        return response;
+    }
+
+    std::wstring ValueOf(const HttpHeaderView &header)
+    {
+        return std::wstring(header.value, header.valueLength);
+    }
+
+    std::wstring NameOf(const HttpHeaderView &header)
+    {
+        return std::wstring(header.name, header.nameLength);
+    }
+
+    std::vector<unsigned char> MakeBody(size_t size, uint32_t seed)
+    {
+        std::vector<unsigned char> body(size);
+        uint32_t state = seed * 2654435761u + 1;
+        for (auto &b : body)
+        {
+            state = state * 1664525u + 1013904223u;
+            b = static_cast<unsigned char>(state >> 24);
+        }
+        return body;
+    }
+
+    // Sends body to a route which echoes it back, and returns a copy of the response.
+    std::shared_ptr<HttpResponse> Upload(HttpCallManager &manager, const wchar_t *verb, const wchar_t *url, const HttpRequestBody &body, HRESULT expected = S_OK)
+    {
+        auto response = std::make_shared<HttpResponse>();
+        bool done = false;
+        HRESULT result = manager.MakeHttpCall(verb, url, std::vector<HttpHeader>(), body, [&response, &done](HttpResponse *completed)
+        {
+            *response = *completed;
+            done = true;
+        });
+        CHECK(result == expected);
+        if (SUCCEEDED(result))
+        {
+            CHECK(PumpUntil(manager, [&done]() { return done; }));
+        }
+        return response;
+    }
+
+    bool Echoed(const HttpResponse &response, const std::vector<unsigned char> &body)
+    {
+        return !response.IsError()
+            && response.HttpResponseCode() == 200
+            && response.ResponseBodySize() == body.size()
+            && (body.empty() || memcmp(response.ResponseBody().get(), body.data(), body.size()) == 0);
+    }
+
+    LoopbackRoute EchoRoute(const wchar_t *path)
+    {
+        LoopbackRoute route = Route(path);
+        route.echoBody = true;
+        return route;
+    }
+
+    // Sizes around the transport's 128 KB reads and the pool's 128 KB chunks
+    const size_t c_uploadSizes[] = { 1, 1000, 128 * 1024 - 1, 128 * 1024, 128 * 1024 + 1, 3 * 128 * 1024 + 77, 2 * 1024 * 1024 };
+
+    // Wraps the loopback transport to record when each attempt of a call is made, and the manager's
+    // total backoff time at that point, so the delay chosen before each retry can be read back exactly.
+    class RecordingTransport : public IHttpTransport
+    {
+    public:
+        explicit RecordingTransport(std::shared_ptr<LoopbackHttpServer> server) : m_transport(server), m_manager(nullptr) {}
+
+        void SetManager(HttpCallManager *manager) { m_manager = manager; }
+
+        HRESULT CreateRequest(std::function<void(HttpResponse *)> callback,
+                              HttpCompletionHandler onComplete,
+                              std::shared_ptr<IHttpRequest> &request) override
+        {
+            m_attemptTimes.push_back(Clock::now());
+            m_backoffTimes.push_back(m_manager ? m_manager->GetMetrics().backoffTimeMS : 0);
+            return m_transport.CreateRequest(callback, onComplete, request);
+        }
+
+        int MaxCallsPerHost() const override { return m_transport.MaxCallsPerHost(); }
+
+        size_t Attempts() const { return m_attemptTimes.size(); }
+
+        // The backoff the manager chose before the given retry (attempt 1 is the first retry)
+        unsigned long DelayBefore(size_t attempt) const { return static_cast<unsigned long>(m_backoffTimes[attempt] - m_backoffTimes[attempt - 1]); }
+
+        unsigned long ElapsedBefore(size_t attempt) const
+        {
+            return static_cast<unsigned long>(std::chrono::duration_cast<std::chrono::milliseconds>(m_attemptTimes[attempt] - m_attemptTimes[attempt - 1]).count());
+        }
+
+        void Reset()
+        {
+            m_attemptTimes.clear();
+            m_backoffTimes.clear();
+        }
+
+    private:
+        LoopbackHttpTransport           m_transport;
+        HttpCallManager                *m_manager;
+        std::vector<Clock::time_point>  m_attemptTimes;
+        std::vector<uint64_t>           m_backoffTimes;
+    };
+
+    HttpRetryPolicy RetryPolicy(unsigned int maxAttempts, unsigned long baseDelayMs, unsigned long maxDelayMs)
+    {
+        HttpRetryPolicy policy;
+        policy.maxAttempts = maxAttempts;
+        policy.baseDelayMs = baseDelayMs;
+        policy.maxDelayMs = maxDelayMs;
+        return policy;
+    }
+
+    LoopbackRoute StatusRoute(const wchar_t *path, unsigned long statusCode)
+    {
+        LoopbackRoute route = Route(path);
+        route.statusCode = statusCode;
+        return route;
+    }
+
+    // An IMF-fixdate secondsFromNow seconds from now, as a Retry-After header carries it
+    std::wstring HttpDate(long secondsFromNow)
+    {
+        time_t when = time(nullptr) + secondsFromNow;
+        struct tm utc;
+#ifdef _WIN32
+        gmtime_s(&utc, &when);
+#else
+        gmtime_r(&when, &utc);
+#endif
+        char text[64];
+        strftime(text, sizeof(text), "%a, %d %b %Y %H:%M:%S GMT", &utc);
+        return std::wstring(text, text + strlen(text));
+    }
+
+    void TestRoundTripAndHeaders()
+    {
+        auto server = std::make_shared<LoopbackHttpServer>(1);
+        LoopbackRoute route = Route(L"/item");
+        route.body = "{\"id\":1}";
+        route.headers.emplace_back(L"ETag", L"\"v7\"");
+        route.headers.emplace_back(L"Cache-Control", L"private, max-age=60");
+        route.headers.emplace_back(L"Retry-After", L"5");
+        server->AddRoute(route);
+
+        HttpCallManager manager(std::make_shared<LoopbackHttpTransport>(server));
+
+        bool done = false;
+        manager.MakeHttpCall(L"GET", L"https://loopback/item", std::vector<HttpHeader>(), [&done](HttpResponse *response)
+        {
+            done = true;
+            CHECK(!response->IsError());
+            CHECK(response->HttpResponseCode() == 200);
+            CHECK(response->ResponseBodySize() == 8);
+            CHECK(memcmp(response->ResponseBody().get(), "{\"id\":1}", 8) == 0);
+
+            HttpHeaderView etag;
+            CHECK(response->ETag(etag) && std::wstring(etag.value, etag.valueLength) == L"\"v7\"");
+
+            HttpCacheControl cacheControl;
+            CHECK(response->CacheControl(cacheControl) && cacheControl.maxAge == 60 && cacheControl.isPrivate);
+
+            uint64_t length = 0;
+            CHECK(response->ContentLength(length) && length == 8);
+
+            unsigned long retryAfter = 0;
+            CHECK(response->RetryAfter(retryAfter) && retryAfter == 5);
+        });
+
+        CHECK(PumpUntil(manager, [&done]() { return done; }));
+
+        auto missing = Get(manager, L"https://loopback/missing");
+        CHECK(PumpUntil(manager, [&missing]() { return missing->done; }));
+        CHECK(missing->status == 404);
+    }
+
+    void TestCircuitBreakerDisabledByDefault()
+    {
+        CHECK(!HttpCircuitBreakerSettings().enabled);
+
+        auto server = std::make_shared<LoopbackHttpServer>(1);
+        server->AddRoute(FailingRoute(L"/fail"));
+
+        HttpCallManager manager(std::make_shared<LoopbackHttpTransport>(server));
+
+        std::vector<std::shared_ptr<CallResult>> results;
+        for (int i = 0; i < 20; ++i)
+        {
+            results.push_back(Get(manager, L"https://loopback/fail"));
+            CHECK(PumpUntil(manager, [&results]() { return results.back()->done; }));
+        }
+
+        for (const auto &result : results)
+        {
+            CHECK(result->error == E_FAIL);
+        }
+        CHECK(manager.GetMetrics().callsFailedFast == 0);
+    }
+
+    // A success from a call that was in flight before the circuit opened must not close it, nor
+    // clear the flag of the probe that is in flight.
+    void TestStaleResultsAreIgnored()
+    {
+        auto server = std::make_shared<LoopbackHttpServer>(4);
+        server->AddRoute(Route(L"/slow", 300));
+        server->AddRoute(Route(L"/probe", 800));
+        server->AddRoute(FailingRoute(L"/fail"));
+
+        HttpCallManager manager(std::make_shared<LoopbackHttpTransport>(server));
+
+        HttpCircuitBreakerSettings settings;
+        settings.enabled = true;
+        settings.failureThreshold = 1;
+        settings.openDurationMs = 100;
+        manager.SetCircuitBreaker(settings);
+
+        auto stale = Get(manager, L"https://loopback/slow");
+        auto failed = Get(manager, L"https://loopback/fail");
+        CHECK(PumpUntil(manager, [&failed]() { return failed->done; }));
+        CHECK(manager.GetCircuitState(L"https://loopback/") == HttpCircuitState::Open);
+
+        PumpFor(manager, 150);
+        auto probe = Get(manager, L"https://loopback/probe");
+        auto rejected = Get(manager, L"https://loopback/slow");
+
+        CHECK(PumpUntil(manager, [&stale]() { return stale->done; }));
+        CHECK(stale->status == 200);
+        PumpFor(manager, 50);
+        CHECK(manager.GetCircuitState(L"https://loopback/") == HttpCircuitState::HalfOpen);
+
+        // A second call while the probe is out is still rejected.
+        auto alsoRejected = Get(manager, L"https://loopback/slow");
+
+        CHECK(PumpUntil(manager, [&probe]() { return probe->done; }));
+        CHECK(probe->status == 200);
+        CHECK(rejected->error == HTTP_E_CIRCUIT_OPEN);
+        CHECK(alsoRejected->error == HTTP_E_CIRCUIT_OPEN);
+        CHECK(manager.GetCircuitState(L"https://loopback/") == HttpCircuitState::Closed);
+    }
+
+    // A probe that has to wait for a call slot is sent when one frees up instead of failing against
+    // its own probe flag.
+    void TestBufferedProbeIsSent()
+    {
+        auto server = std::make_shared<LoopbackHttpServer>(4);
+        server->AddRoute(Route(L"/short", 300));
+        server->AddRoute(Route(L"/long", 900));
+        server->AddRoute(Route(L"/probe"));
+        server->AddRoute(FailingRoute(L"/fail"));
+
+        HttpCallManager manager(std::make_shared<LoopbackHttpTransport>(server, 2));
+
+        HttpCircuitBreakerSettings settings;
+        settings.enabled = true;
+        settings.failureThreshold = 1;
+        settings.openDurationMs = 100;
+        manager.SetCircuitBreaker(settings);
+
+        // Two slots: /short and /long go out, /fail and a second /long wait. /fail is sent when /short
+        // completes and opens the circuit, after which the second /long still takes the slot it was
+        // admitted for.
+        std::vector<std::shared_ptr<CallResult>> stale;
+        stale.push_back(Get(manager, L"https://loopback/short"));
+        stale.push_back(Get(manager, L"https://loopback/long"));
+        auto failed = Get(manager, L"https://loopback/fail");
+        stale.push_back(Get(manager, L"https://loopback/long"));
+
+        CHECK(PumpUntil(manager, [&failed]() { return failed->done; }));
+        PumpFor(manager, 150);
+
+        // Both slots are held by stale calls, so the probe is buffered.
+        auto probe = Get(manager, L"https://loopback/probe");
+        CHECK(PumpUntil(manager, [&probe]() { return probe->done; }));
+        CHECK(probe->error == S_OK && probe->status == 200);
+        CHECK(manager.GetCircuitState(L"https://loopback/") == HttpCircuitState::Closed);
+
+        CHECK(PumpUntil(manager, [&stale]() { return stale[0]->done && stale[1]->done && stale[2]->done; }));
+        for (const auto &result : stale)
+        {
+            CHECK(result->status == 200);
+        }
+    }
+
+    void TestDecoderExceptions()
+    {
+        auto server = std::make_shared<LoopbackHttpServer>(1);
+        server->AddRoute(Route(L"/decode"));
+
+        HttpCallManager manager(std::make_shared<LoopbackHttpTransport>(server));
+
+        std::atomic<int> decodes(0);
+        manager.SetDecoder(L"Decoded", HttpResponseDecoder([&decodes](const HttpResponse &) -> std::shared_ptr<void>
+        {
+            if (decodes++ == 0)
+            {
+                throw 42;
+            }
+            return std::make_shared<int>(7);
+        }));
+
+        auto thrown = std::make_shared<CallResult>();
+        manager.MakeHttpCall(L"GET", L"https://loopback/decode", std::vector<HttpHeader>(), Record(thrown), L"Decoded");
+        CHECK(PumpUntil(manager, [&thrown]() { return thrown->done; }));
+        CHECK(thrown->error == E_FAIL);
+
+        // The decode thread survived and decodes the next response.
+        std::shared_ptr<int> decoded;
+        manager.MakeHttpCall(L"GET", L"https://loopback/decode", std::vector<HttpHeader>(), [&decoded](HttpResponse *response)
+        {
+            decoded = response->DecodedResult<int>();
+        }, L"Decoded");
+        CHECK(PumpUntil(manager, [&decoded]() { return decoded != nullptr; }));
+        CHECK(decoded && *decoded == 7);
+    }
+
+    // Header names match whatever their case, in the response and in the name looked up.
+    void TestHeaderLookupIgnoresCase()
+    {
+        auto server = std::make_shared<LoopbackHttpServer>(1);
+        LoopbackRoute route = Route(L"/headers");
+        route.body = "abc";
+        route.headers.emplace_back(L"x-CUSTOM-name", L"Value");
+        route.headers.emplace_back(L"etag", L"\"v1\"");
+        route.headers.emplace_back(L"RETRY-AFTER", L"7");
+        route.headers.emplace_back(L"cache-control", L"NO-STORE, Max-Age=5");
+        server->AddRoute(route);
+
+        HttpCallManager manager(std::make_shared<LoopbackHttpTransport>(server));
+        auto response = Fetch(manager, L"https://loopback/headers");
+
+        HttpHeaderView header;
+        const wchar_t *names[] = { L"X-Custom-Name", L"x-custom-name", L"X-CUSTOM-NAME", L"x-CUSTOM-name" };
+        for (auto name : names)
+        {
+            CHECK(response->FindHeader(name, header) && ValueOf(header) == L"Value" && NameOf(header) == L"x-CUSTOM-name");
+        }
+
+        // Only whole names match
+        CHECK(!response->FindHeader(L"X-Custom", header));
+        CHECK(!response->FindHeader(L"X-Custom-Name-2", header));
+
+        CHECK(response->ETag(header) && ValueOf(header) == L"\"v1\"");
+
+        unsigned long retryAfter = 0;
+        CHECK(response->RetryAfter(retryAfter) && retryAfter == 7);
+
+        HttpCacheControl cacheControl;
+        CHECK(response->CacheControl(cacheControl) && cacheControl.noStore && cacheControl.maxAge == 5);
+
+        uint64_t length = 0;
+        CHECK(response->ContentLength(length) && length == 3);
+    }
+
+    // Every copy of a repeated header is kept in order; lookups return the first.
+    void TestRepeatedHeaders()
+    {
+        auto server = std::make_shared<LoopbackHttpServer>(1);
+        LoopbackRoute route = Route(L"/repeated");
+        route.headers.emplace_back(L"Set-Cookie", L"a=1");
+        route.headers.emplace_back(L"X-Other", L"between");
+        route.headers.emplace_back(L"set-cookie", L"b=2");
+        route.headers.emplace_back(L"Set-Cookie", L"c=3");
+        route.headers.emplace_back(L"Retry-After", L"3");
+        route.headers.emplace_back(L"Retry-After", L"9");
+        server->AddRoute(route);
+
+        HttpCallManager manager(std::make_shared<LoopbackHttpTransport>(server));
+        auto response = Fetch(manager, L"https://loopback/repeated");
+
+        CHECK(response->HeaderCount() == 7); // and the server's Content-Length
+
+        std::vector<std::wstring> cookies;
+        for (size_t i = 0; i < response->HeaderCount(); ++i)
+        {
+            auto header = response->Header(i);
+            if (NameOf(header) == L"Set-Cookie" || NameOf(header) == L"set-cookie")
+            {
+                cookies.push_back(ValueOf(header));
+            }
+        }
+        CHECK((cookies == std::vector<std::wstring>{ L"a=1", L"b=2", L"c=3" }));
+
+        HttpHeaderView header;
+        CHECK(response->FindHeader(L"Set-Cookie", header) && ValueOf(header) == L"a=1");
+
+        unsigned long retryAfter = 0;
+        CHECK(response->RetryAfter(retryAfter) && retryAfter == 3);
+
+        bool threw = false;
+        try
+        {
+            response->Header(7);
+        }
+        catch (const std::out_of_range &)
+        {
+            threw = true;
+        }
+        CHECK(threw);
+    }
+
+    // Whitespace around names and values is not part of them, and a folded header is one value.
+    void TestFoldedWhitespace()
+    {
+        auto server = std::make_shared<LoopbackHttpServer>(1);
+        LoopbackRoute route = Route(L"/whitespace");
+        route.headers.emplace_back(L"X-Padded", L" \t padded value \t ");
+        route.headers.emplace_back(L"X-Empty", L"   ");
+        route.headers.emplace_back(L"X-Folded", L"first,\r\n second,\r\n\tthird");
+        route.headers.emplace_back(L"Cache-Control", L"no-cache,\r\n  max-age=30");
+        route.headers.emplace_back(L"Retry-After", L"  12\t");
+        route.headers.emplace_back(L"X-After-Fold", L"next");
+        server->AddRoute(route);
+
+        HttpCallManager manager(std::make_shared<LoopbackHttpTransport>(server));
+        auto response = Fetch(manager, L"https://loopback/whitespace");
+
+        CHECK(response->HeaderCount() == 7);
+
+        HttpHeaderView header;
+        CHECK(response->FindHeader(L"X-Padded", header) && ValueOf(header) == L"padded value");
+        CHECK(response->FindHeader(L"X-Empty", header) && header.valueLength == 0);
+
+        // Each line break of a fold becomes spaces
+        CHECK(response->FindHeader(L"X-Folded", header) && ValueOf(header) == L"first,   second,  \tthird");
+
+        HttpCacheControl cacheControl;
+        CHECK(response->CacheControl(cacheControl) && cacheControl.noCache && cacheControl.maxAge == 30);
+
+        unsigned long retryAfter = 0;
+        CHECK(response->RetryAfter(retryAfter) && retryAfter == 12);
+
+        // The header after a fold is still found
+        CHECK(response->FindHeader(L"X-After-Fold", header) && ValueOf(header) == L"next");
+
+        // Names have trailing whitespace trimmed, and lone \n line breaks are accepted
+        HttpResponse raw;
+        const wchar_t headers[] = L"Name \t: value\nContent-Length:  42 \n\nNot-A-Header\n";
+        raw.SetResponseHeaders(headers, wcslen(headers));
+        CHECK(raw.HeaderCount() == 2);
+        CHECK(raw.FindHeader(L"Name", header) && ValueOf(header) == L"value");
+        uint64_t length = 0;
+        CHECK(raw.ContentLength(length) && length == 42);
+    }
+
+    // Content-Length and Retry-After values that aren't numbers, or dates, are reported as malformed.
+    void TestMalformedHeaders()
+    {
+        auto server = std::make_shared<LoopbackHttpServer>(1);
+
+        const wchar_t *badLengths[] = { L"abc", L"12abc", L"-1", L"+5", L"1 2", L"0x10", L"1.5", L"99999999999999999999999" };
+        for (size_t i = 0; i < sizeof(badLengths) / sizeof(badLengths[0]); ++i)
+        {
+            LoopbackRoute route = Route((L"/length/" + std::to_wstring(i) + L"/").c_str());
+            route.headers.emplace_back(L"Content-Length", badLengths[i]);
+            server->AddRoute(route);
+        }
+
+        const wchar_t *badRetryAfters[] =
+        {
+            L"soon",
+            L"-5",
+            L"1.5",
+            L"99999999999999999999999",
+            L"Sun, 06 Nov 1994 08:49:37",           // no zone, so too short
+            L"Sun, 06 Foo 1994 08:49:37 GMT",       // no such month
+            L"Sunday, 06-Nov-94 08:49:37 GMT",      // obsolete RFC 850 form
+            L"Sun, xx Nov 1994 08:49:37 GMT",
+        };
+        for (size_t i = 0; i < sizeof(badRetryAfters) / sizeof(badRetryAfters[0]); ++i)
+        {
+            LoopbackRoute route = Route((L"/retry/" + std::to_wstring(i) + L"/").c_str());
+            route.headers.emplace_back(L"Retry-After", badRetryAfters[i]);
+            server->AddRoute(route);
+        }
+
+        HttpCallManager manager(std::make_shared<LoopbackHttpTransport>(server));
+
+        for (size_t i = 0; i < sizeof(badLengths) / sizeof(badLengths[0]); ++i)
+        {
+            auto response = Fetch(manager, (L"https://loopback/length/" + std::to_wstring(i) + L"/").c_str());
+            uint64_t length = 12345;
+            CHECK(!response->ContentLength(length));
+        }
+
+        for (size_t i = 0; i < sizeof(badRetryAfters) / sizeof(badRetryAfters[0]); ++i)
+        {
+            auto response = Fetch(manager, (L"https://loopback/retry/" + std::to_wstring(i) + L"/").c_str());
+            unsigned long retryAfter = 12345;
+            CHECK(!response->RetryAfter(retryAfter));
+        }
+
+        // A malformed Retry-After on a 503 leaves the retry to the jittered backoff
+        LoopbackRoute unavailable = StatusRoute(L"/unavailable", 503);
+        unavailable.headers.emplace_back(L"Retry-After", L"soon");
+        server->AddRoute(unavailable);
+        manager.SetRetryPolicy(nullptr, RetryPolicy(2, 1, 20));
+        auto start = Clock::now();
+        auto result = Get(manager, L"https://loopback/unavailable");
+        CHECK(PumpUntil(manager, [&result]() { return result->done; }));
+        CHECK(result->status == 503);
+        CHECK(Clock::now() - start < std::chrono::milliseconds(1000));
+        CHECK(manager.GetMetrics().retries == 1);
+
+        // The largest values that fit are still read
+        HttpResponse raw;
+        const wchar_t headers[] = L"Content-Length: 18446744073709551615\r\nRetry-After: 4294967295\r\n";
+        raw.SetResponseHeaders(headers, wcslen(headers));
+        uint64_t length = 0;
+        CHECK(raw.ContentLength(length) && length == UINT64_MAX);
+        unsigned long retryAfter = 0;
+        CHECK(raw.RetryAfter(retryAfter) && retryAfter == 4294967295ul);
+    }
+
+    // Looking up a header the response doesn't have fails without touching the output, whether or not
+    // there are any headers at all.
+    void TestMissingHeaders()
+    {
+        auto server = std::make_shared<LoopbackHttpServer>(1);
+        server->AddRoute(Route(L"/plain"));
+
+        HttpCallManager manager(std::make_shared<LoopbackHttpTransport>(server));
+        auto response = Fetch(manager, L"https://loopback/plain");
+
+        CHECK(response->HeaderCount() == 1);
+
+        HttpHeaderView header = { nullptr, 0, nullptr, 0 };
+        CHECK(!response->FindHeader(L"X-Missing", header) && header.name == nullptr);
+        CHECK(!response->ETag(header) && header.name == nullptr);
+
+        unsigned long retryAfter = 12345;
+        CHECK(!response->RetryAfter(retryAfter) && retryAfter == 12345);
+
+        HttpCacheControl cacheControl;
+        cacheControl.maxAge = 12345;
+        CHECK(!response->CacheControl(cacheControl) && cacheControl.maxAge == 12345);
+
+        uint64_t length = 0;
+        CHECK(response->ContentLength(length) && length == 0);
+
+        // Errors have no headers at all
+        server->AddRoute(FailingRoute(L"/fail"));
+        auto failed = Fetch(manager, L"https://loopback/fail");
+        CHECK(failed->IsError());
+        CHECK(failed->HeaderCount() == 0);
+        CHECK(!failed->ContentLength(length));
+        CHECK(!failed->FindHeader(L"Content-Length", header));
+
+        HttpResponse empty;
+        empty.SetResponseHeaders(L"", 0);
+        CHECK(empty.HeaderCount() == 0 && !empty.FindHeader(L"", header));
+    }
+
+    // Each retry waits between baseDelayMs and three times the previous delay, capped at maxDelayMs, and
+    // the call is sent again no sooner than that.
+    void TestRetryJitterBounds()
+    {
+        auto server = std::make_shared<LoopbackHttpServer>(1);
+        server->AddRoute(StatusRoute(L"/unavailable", 503));
+        server->AddRoute(StatusRoute(L"/throttled", 429));
+
+        auto transport = std::make_shared<RecordingTransport>(server);
+        HttpCallManager manager(transport);
+        transport->SetManager(&manager);
+
+        const unsigned long baseDelayMs = 5;
+        const unsigned long maxDelayMs = 60;
+        manager.SetRetryPolicy(nullptr, RetryPolicy(6, baseDelayMs, maxDelayMs));
+
+        unsigned long longestDelay = 0;
+        for (int i = 0; i < 10; ++i)
+        {
+            transport->Reset();
+            auto result = Get(manager, (i % 2 == 0) ? L"https://loopback/unavailable" : L"https://loopback/throttled");
+            CHECK(PumpUntil(manager, [&result]() { return result->done; }));
+            CHECK(result->status == ((i % 2 == 0) ? 503u : 429u));
+            CHECK(transport->Attempts() == 6);
+
+            unsigned long previous = baseDelayMs;
+            for (size_t attempt = 1; attempt < transport->Attempts(); ++attempt)
+            {
+                unsigned long delay = transport->DelayBefore(attempt);
+                CHECK(delay >= baseDelayMs);
+                CHECK(delay <= std::min(maxDelayMs, std::max(baseDelayMs, previous * 3)));
+                CHECK(transport->ElapsedBefore(attempt) >= delay);
+                longestDelay = std::max(longestDelay, delay);
+                previous = delay;
+            }
+        }
+
+        // Five retries growing by up to three times each reach the cap at least once in ten calls
+        CHECK(longestDelay == maxDelayMs || longestDelay > maxDelayMs / 2);
+
+        auto metrics = manager.GetMetrics();
+        CHECK(metrics.calls == 10);
+        CHECK(metrics.retries == 50);
+    }
+
+    // A Retry-After header, in seconds or as an HTTP-date, sets a lower bound on the backoff. One asking for
+    // longer than maxDelayMs ends the retries instead.
+    void TestRetryAfterOverridesBackoff()
+    {
+        auto server = std::make_shared<LoopbackHttpServer>(1);
+
+        LoopbackRoute seconds = Route(L"/seconds");
+        seconds.throttleRate = 1.0f;    // 503 with Retry-After: 1
+        seconds.retryAfterSeconds = 1;
+        server->AddRoute(seconds);
+
+        LoopbackRoute date = StatusRoute(L"/date", 429);
+        date.headers.emplace_back(L"Retry-After", HttpDate(2).c_str());
+        server->AddRoute(date);
+
+        LoopbackRoute past = StatusRoute(L"/past", 429);
+        past.headers.emplace_back(L"Retry-After", L"Sun, 06 Nov 1994 08:49:37 GMT");
+        server->AddRoute(past);
+
+        LoopbackRoute tooLong = StatusRoute(L"/too-long", 503);
+        tooLong.headers.emplace_back(L"Retry-After", L"30");
+        server->AddRoute(tooLong);
+
+        auto transport = std::make_shared<RecordingTransport>(server);
+        HttpCallManager manager(transport);
+        transport->SetManager(&manager);
+        manager.SetRetryPolicy(nullptr, RetryPolicy(2, 10, 5000));
+
+        auto result = Get(manager, L"https://loopback/seconds");
+        CHECK(PumpUntil(manager, [&result]() { return result->done; }));
+        CHECK(transport->Attempts() == 2);
+        CHECK(transport->DelayBefore(1) == 1000);
+        CHECK(transport->ElapsedBefore(1) >= 1000);
+
+        // The date has a resolution of a second, and a second may have started since it was made
+        transport->Reset();
+        result = Get(manager, L"https://loopback/date");
+        CHECK(PumpUntil(manager, [&result]() { return result->done; }));
+        CHECK(transport->Attempts() == 2);
+        CHECK(transport->DelayBefore(1) == 1000 || transport->DelayBefore(1) == 2000);
+        CHECK(transport->ElapsedBefore(1) >= transport->DelayBefore(1));
+
+        // A date in the past leaves the jittered backoff as it was
+        transport->Reset();
+        result = Get(manager, L"https://loopback/past");
+        CHECK(PumpUntil(manager, [&result]() { return result->done; }));
+        CHECK(transport->Attempts() == 2);
+        CHECK(transport->DelayBefore(1) >= 10 && transport->DelayBefore(1) <= 30);
+
+        transport->Reset();
+        result = Get(manager, L"https://loopback/too-long");
+        CHECK(PumpUntil(manager, [&result]() { return result->done; }));
+        CHECK(transport->Attempts() == 1);
+        CHECK(result->status == 503);
+
+        // Unless the policy ignores Retry-After
+        HttpRetryPolicy ignore = RetryPolicy(2, 10, 5000);
+        ignore.honorRetryAfter = false;
+        manager.SetRetryPolicy(L"IgnoreRetryAfter", ignore);
+
+        transport->Reset();
+        result = std::make_shared<CallResult>();
+        manager.MakeHttpCall(L"GET", L"https://loopback/too-long", std::vector<HttpHeader>(), Record(result), L"IgnoreRetryAfter");
+        CHECK(PumpUntil(manager, [&result]() { return result->done; }));
+        CHECK(transport->Attempts() == 2);
+        CHECK(transport->DelayBefore(1) <= 30);
+    }
+
+    // Calls stop at maxAttempts, returning the last failure; a success part way through ends them early.
+    void TestRetryStopsAtMaxAttempts()
+    {
+        auto server = std::make_shared<LoopbackHttpServer>(1);
+        server->AddRoute(StatusRoute(L"/unavailable", 503));
+        server->AddRoute(FailingRoute(L"/fail"));
+
+        LoopbackRoute flaky = Route(L"/flaky");
+        flaky.throttleRate = 0.5f;
+        flaky.retryAfterSeconds = 0;
+        server->AddRoute(flaky);
+
+        auto transport = std::make_shared<RecordingTransport>(server);
+        HttpCallManager manager(transport);
+        transport->SetManager(&manager);
+
+        const unsigned int attempts[] = { 1, 2, 5 };
+        for (auto maxAttempts : attempts)
+        {
+            manager.SetRetryPolicy(nullptr, RetryPolicy(maxAttempts, 1, 5));
+
+            transport->Reset();
+            auto unavailable = Get(manager, L"https://loopback/unavailable");
+            CHECK(PumpUntil(manager, [&unavailable]() { return unavailable->done; }));
+            CHECK(unavailable->status == 503);
+            CHECK(transport->Attempts() == maxAttempts);
+
+            transport->Reset();
+            auto failed = Get(manager, L"https://loopback/fail");
+            CHECK(PumpUntil(manager, [&failed]() { return failed->done; }));
+            CHECK(failed->error == E_FAIL);
+            CHECK(transport->Attempts() == maxAttempts);
+        }
+
+        // With the server failing half the time, twenty attempts all but always get through
+        manager.SetRetryPolicy(nullptr, RetryPolicy(20, 1, 5));
+        for (int i = 0; i < 20; ++i)
+        {
+            transport->Reset();
+            auto result = Get(manager, L"https://loopback/flaky");
+            CHECK(PumpUntil(manager, [&result]() { return result->done; }));
+            CHECK(result->status == 200);
+            CHECK(transport->Attempts() < 20);
+        }
+    }
+
+    // Non-idempotent verbs are only retried when the policy allows it, and only transient statuses are retried.
+    void TestNonRetryableCalls()
+    {
+        auto server = std::make_shared<LoopbackHttpServer>(1);
+        server->AddRoute(StatusRoute(L"/unavailable", 503));
+        server->AddRoute(StatusRoute(L"/throttled", 429));
+        const unsigned long permanent[] = { 400, 404, 501, 200 };
+        for (auto status : permanent)
+        {
+            server->AddRoute(StatusRoute((L"/status/" + std::to_wstring(status)).c_str(), status));
+        }
+
+        auto transport = std::make_shared<RecordingTransport>(server);
+        HttpCallManager manager(transport);
+        transport->SetManager(&manager);
+        manager.SetRetryPolicy(nullptr, RetryPolicy(3, 1, 5));
+
+        const wchar_t *verbs[] = { L"POST", L"PATCH" };
+        const wchar_t *urls[] = { L"https://loopback/unavailable", L"https://loopback/throttled" };
+        for (auto verb : verbs)
+        {
+            for (auto url : urls)
+            {
+                transport->Reset();
+                auto result = std::make_shared<CallResult>();
+                CHECK(SUCCEEDED(manager.MakeHttpCall(verb, url, std::vector<HttpHeader>(), Record(result))));
+                CHECK(PumpUntil(manager, [&result]() { return result->done; }));
+                CHECK(transport->Attempts() == 1);
+            }
+        }
+
+        // Idempotent verbs other than GET are retried
+        const wchar_t *idempotent[] = { L"PUT", L"DELETE", L"HEAD", L"OPTIONS" };
+        for (auto verb : idempotent)
+        {
+            transport->Reset();
+            auto result = std::make_shared<CallResult>();
+            CHECK(SUCCEEDED(manager.MakeHttpCall(verb, L"https://loopback/unavailable", std::vector<HttpHeader>(), Record(result))));
+            CHECK(PumpUntil(manager, [&result]() { return result->done; }));
+            CHECK(transport->Attempts() == 3);
+        }
+
+        for (auto status : permanent)
+        {
+            transport->Reset();
+            auto result = Get(manager, (L"https://loopback/status/" + std::to_wstring(status)).c_str());
+            CHECK(PumpUntil(manager, [&result]() { return result->done; }));
+            CHECK(result->status == status);
+            CHECK(transport->Attempts() == 1);
+        }
+
+        // A policy that allows any verb retries POST
+        HttpRetryPolicy anyVerb = RetryPolicy(3, 1, 5);
+        anyVerb.idempotentOnly = false;
+        manager.SetRetryPolicy(L"AnyVerb", anyVerb);
+
+        transport->Reset();
+        auto result = std::make_shared<CallResult>();
+        CHECK(SUCCEEDED(manager.MakeHttpCall(L"POST", L"https://loopback/unavailable", std::vector<HttpHeader>(), Record(result), L"AnyVerb")));
+        CHECK(PumpUntil(manager, [&result]() { return result->done; }));
+        CHECK(transport->Attempts() == 3);
+
+        // The default policy doesn't retry at all
+        CHECK(HttpRetryPolicy().maxAttempts == 1);
+        manager.SetRetryPolicy(nullptr, HttpRetryPolicy());
+        transport->Reset();
+        auto once = Get(manager, L"https://loopback/unavailable");
+        CHECK(PumpUntil(manager, [&once]() { return once->done; }));
+        CHECK(transport->Attempts() == 1);
+    }
+
+    // Caller buffers are read in place. Replayed for retries, every attempt sends the whole body.
+    void TestUploadFromBuffer()
+    {
+        auto server = std::make_shared<LoopbackHttpServer>(1, 29);
+        server->AddRoute(EchoRoute(L"/echo"));
+        LoopbackRoute flaky = EchoRoute(L"/flaky");
+        flaky.throttleRate = 0.5f;
+        flaky.retryAfterSeconds = 0;
+        server->AddRoute(flaky);
+
+        HttpCallManager manager(std::make_shared<LoopbackHttpTransport>(server));
+        manager.SetRetryPolicy(nullptr, RetryPolicy(20, 1, 5));
+
+        for (auto size : c_uploadSizes)
+        {
+            auto data = MakeBody(size, static_cast<uint32_t>(size));
+            auto body = HttpRequestBody::FromBuffer(data.data(), data.size());
+            CHECK(body.Size() == size && body.IsReplayable());
+
+            CHECK(Echoed(*Upload(manager, L"POST", L"https://loopback/echo", body), data));
+            CHECK(Echoed(*Upload(manager, L"PUT", L"https://loopback/flaky", body), data));
+        }
+
+        auto empty = HttpRequestBody::FromBuffer(nullptr, 0);
+        CHECK(Echoed(*Upload(manager, L"POST", L"https://loopback/echo", empty), std::vector<unsigned char>()));
+        CHECK(manager.GetMetrics().retries > 0);
+    }
+
+    // File bodies map the file and read it in place.
+    void TestUploadFromFile()
+    {
+        auto server = std::make_shared<LoopbackHttpServer>(1);
+        server->AddRoute(EchoRoute(L"/echo"));
+        HttpCallManager manager(std::make_shared<LoopbackHttpTransport>(server));
+
+        const size_t sizes[] = { 0, 1, 4096, 128 * 1024 + 1, 5 * 1024 * 1024 + 3 };
+        for (auto size : sizes)
+        {
+            char path[] = "/tmp/HttpCallTestsXXXXXX";
+            int file = mkstemp(path);
+            CHECK(file >= 0);
+
+            auto data = MakeBody(size, static_cast<uint32_t>(size) + 1);
+            CHECK(data.empty() || write(file, data.data(), data.size()) == static_cast<ssize_t>(data.size()));
+            close(file);
+
+            HttpRequestBody body;
+            CHECK(SUCCEEDED(HttpRequestBody::FromFile(std::wstring(path, path + strlen(path)).c_str(), body)));
+            CHECK(body.Size() == size && body.IsReplayable());
+
+            // The mapping outlives the file's name
+            unlink(path);
+
+            CHECK(Echoed(*Upload(manager, L"PUT", L"https://loopback/echo", body), data));
+            CHECK(Echoed(*Upload(manager, L"PUT", L"https://loopback/echo", body), data));
+        }
+
+        HttpRequestBody missing;
+        CHECK(HttpRequestBody::FromFile(L"/tmp/HttpCallTests-missing", missing) == HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND));
+        CHECK(missing.IsEmpty());
+    }
+
+    // Producer bodies are read once, in order, and never retried, since the data can't be produced again.
+    void TestUploadFromProducer()
+    {
+        auto server = std::make_shared<LoopbackHttpServer>(1);
+        server->AddRoute(EchoRoute(L"/echo"));
+        server->AddRoute(StatusRoute(L"/unavailable", 503));
+
+        HttpCallManager manager(std::make_shared<LoopbackHttpTransport>(server));
+        HttpRetryPolicy anyVerb = RetryPolicy(3, 1, 5);
+        anyVerb.idempotentOnly = false;
+        manager.SetRetryPolicy(nullptr, anyVerb);
+
+        for (auto size : c_uploadSizes)
+        {
+            auto data = MakeBody(size, static_cast<uint32_t>(size) + 2);
+
+            // Hands the data over in small, uneven pieces, and says when it is done
+            auto produced = std::make_shared<size_t>(0);
+            auto calls = std::make_shared<size_t>(0);
+            auto producer = [data, produced, calls](unsigned char *buffer, size_t bufferSize, size_t *bytesWritten) -> HRESULT
+            {
+                ++*calls;
+                size_t count = std::min(std::min(bufferSize, size_t(1000 + *calls % 7)), data.size() - *produced);
+                memcpy(buffer, data.data() + *produced, count);
+                *produced += count;
+                *bytesWritten = count;
+                return (*produced == data.size()) ? S_FALSE : S_OK;
+            };
+
+            auto body = HttpRequestBody::FromProducer(size, producer);
+            CHECK(body.Size() == size && !body.IsReplayable());
+            CHECK(Echoed(*Upload(manager, L"POST", L"https://loopback/echo", body), data));
+            CHECK(*produced == size);
+
+            // Once read, it can't be read from the start again
+            unsigned char byte;
+            size_t bytesRead = 0;
+            CHECK(body.Read(0, &byte, 1, &bytesRead) == E_ILLEGAL_METHOD_CALL);
+
+            // A transient failure is returned rather than retried, and the producer isn't asked for the data again
+            *produced = 0;
+            server->ResetStats();
+            auto unavailable = Upload(manager, L"PUT", L"https://loopback/unavailable", HttpRequestBody::FromProducer(size, producer));
+            CHECK(unavailable->HttpResponseCode() == 503);
+            CHECK(server->GetStats().requests == 1);
+            CHECK(*produced == size);
+        }
+
+        // A producer that fails fails the call
+        auto failing = HttpRequestBody::FromProducer(10, [](unsigned char *, size_t, size_t *bytesWritten) -> HRESULT
+        {
+            *bytesWritten = 0;
+            return E_ABORT;
+        });
+        Upload(manager, L"POST", L"https://loopback/echo", failing, E_ABORT);
+
+        // Pooled copies of the same data are retried
+        auto data = MakeBody(1000, 3);
+        server->ResetStats();
+        auto retried = Upload(manager, L"PUT", L"https://loopback/unavailable", HttpRequestBody::FromCopy(data.data(), data.size()));
+        CHECK(retried->HttpResponseCode() == 503);
+        CHECK(server->GetStats().requests == 3);
+    }
+
+    // Copied bodies hold their own copy in pooled chunks, so the caller's buffer can go at once.
+    void TestUploadFromPooledCopy()
+    {
+        auto server = std::make_shared<LoopbackHttpServer>(1, 30);
+        server->AddRoute(EchoRoute(L"/echo"));
+        LoopbackRoute flaky = EchoRoute(L"/flaky");
+        flaky.throttleRate = 0.5f;
+        flaky.retryAfterSeconds = 0;
+        server->AddRoute(flaky);
+
+        HttpCallManager manager(std::make_shared<LoopbackHttpTransport>(server));
+        manager.SetRetryPolicy(nullptr, RetryPolicy(20, 1, 5));
+
+        for (auto size : c_uploadSizes)
+        {
+            auto data = MakeBody(size, static_cast<uint32_t>(size) + 4);
+            std::vector<HttpRequestBody> bodies;
+            {
+                auto scratch = data;
+                bodies.push_back(HttpRequestBody::FromCopy(scratch.data(), scratch.size()));
+                std::fill(scratch.begin(), scratch.end(), static_cast<unsigned char>(0xCD));
+            }
+            CHECK(bodies[0].Size() == size && bodies[0].IsReplayable());
+
+            // Reads may start anywhere and cross chunks
+            std::vector<unsigned char> read(size);
+            size_t bytesRead = 0;
+            size_t offset = size / 3;
+            CHECK(SUCCEEDED(bodies[0].Read(offset, read.data(), size - offset, &bytesRead)) && bytesRead == size - offset);
+            CHECK(std::equal(read.begin(), read.begin() + bytesRead, data.begin() + offset));
+            CHECK(SUCCEEDED(bodies[0].Read(size, read.data(), 1, &bytesRead)) && bytesRead == 0);
+
+            CHECK(Echoed(*Upload(manager, L"POST", L"https://loopback/echo", bodies[0]), data));
+            CHECK(Echoed(*Upload(manager, L"PUT", L"https://loopback/flaky", bodies[0]), data));
+
+            // Chunks freed by one body are reused by the next without leaking data between them
+            bodies.clear();
+            auto other = MakeBody(size, static_cast<uint32_t>(size) + 5);
+            CHECK(Echoed(*Upload(manager, L"POST", L"https://loopback/echo", HttpRequestBody::FromCopy(other.data(), other.size())), other));
+        }
+        CHECK(manager.GetMetrics().retries > 0);
+    }
+
+    void TestServerShutdownFailsPendingRequests()
+    {
+        std::atomic<int> completions(0);
+        std::atomic<int> aborted(0);
+        {
+            LoopbackHttpServer server(2);
+            server.AddRoute(Route(L"/", 60000));
+
+            for (int i = 0; i < 5; ++i)
+            {
+                server.Submit("GET / HTTP/1.1\r\nHost: loopback\r\n\r\n", 0, [&completions, &aborted](HRESULT result, std::string &&response)
+                {
+                    ++completions;
+                    if (result == E_ABORT && response.empty())
+                    {
+                        ++aborted;
+                    }
+                });
+            }
+
+            // Let the workers parse the requests so both queued and parsed jobs are pending.
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        CHECK(completions == 5);
+        CHECK(aborted == 5);
+    }
+}
+
+int main()
+{
+    TestRoundTripAndHeaders();
+    TestHeaderLookupIgnoresCase();
+    TestRepeatedHeaders();
+    TestFoldedWhitespace();
+    TestMalformedHeaders();
+    TestMissingHeaders();
+    TestCircuitBreakerDisabledByDefault();
+    TestStaleResultsAreIgnored();
+    TestBufferedProbeIsSent();
+    TestDecoderExceptions();
+    TestRetryJitterBounds();
+    TestRetryAfterOverridesBackoff();
+    TestRetryStopsAtMaxAttempts();
+    TestNonRetryableCalls();
+    TestUploadFromBuffer();
+    TestUploadFromFile();
+    TestUploadFromProducer();
+    TestUploadFromPooledCopy();
+    TestServerShutdownFailsPendingRequests();
+
+    if (g_failures != 0)
+    {
+        printf("%d check(s) failed\n", g_failures);
+        return 1;
+    }
+
+    printf("All HttpCallManager tests passed\n");
+    return 0;
+}
@@ -0,0 +1,184 @@
+// Copyright (c) Microsoft Corporation
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// Upload throughput of the HttpCallManager over the loopback transport, for bodies of 1 to 64 MB from
+// each HttpRequestBody source: the caller's buffer read in place, a mapped file, a producer writing
+// straight into the transport's buffer, and a copy held in pooled chunks. The copy is made for every
+// upload, as a title would make it. The server discards the body, so the time is spent pulling the
+// body into the request and handing it over.
+//
+// Usage: HttpUploadBenchmark [megabytes uploaded per measurement]
+//
+
+#include "HttpCall.h"
+#include "HttpLoopbackTransport.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace ATG;
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    enum class Source
+    {
+        Buffer,
+        File,
+        Producer,
+        PooledCopy,
+    };
+
+    const char *SourceName(Source source)
+    {
+        switch (source)
+        {
+        case Source::Buffer:     return "buffer";
+        case Source::File:       return "mapped file";
+        case Source::Producer:   return "producer";
+        case Source::PooledCopy: return "pooled copy";
+        default:                 return "";
+        }
+    }
+
+    HttpRequestBody MakeBody(Source source, const std::vector<unsigned char> &data, const std::wstring &fileName)
+    {
+        switch (source)
+        {
+        case Source::File:
+        {
+            HttpRequestBody body;
+            if (FAILED(HttpRequestBody::FromFile(fileName.c_str(), body)))
+            {
+                printf("ERROR: can't map the upload file\n");
+                exit(1);
+            }
+            return body;
+        }
+        case Source::Producer:
+        {
+            auto offset = std::make_shared<size_t>(0);
+            return HttpRequestBody::FromProducer(data.size(), [&data, offset](unsigned char *buffer, size_t bufferSize, size_t *bytesWritten) -> HRESULT
+            {
+                size_t count = std::min(bufferSize, data.size() - *offset);
+                memcpy(buffer, data.data() + *offset, count);
+                *offset += count;
+                *bytesWritten = count;
+                return (*offset == data.size()) ? S_FALSE : S_OK;
+            });
+        }
+        case Source::PooledCopy:
+            return HttpRequestBody::FromCopy(data.data(), data.size());
+        case Source::Buffer:
+        default:
+            return HttpRequestBody::FromBuffer(data.data(), data.size());
+        }
+    }
+
+    // Returns the upload rate in MB/s
+    double Run(HttpCallManager &manager, LoopbackHttpServer &server, Source source, const std::vector<unsigned char> &data, const std::wstring &fileName, size_t uploads)
+    {
+        server.ResetStats();
+
+        auto start = Clock::now();
+        for (size_t i = 0; i < uploads; ++i)
+        {
+            bool done = false;
+            HRESULT result = manager.MakeHttpCall(L"PUT", L"https://loopback/upload", std::vector<HttpHeader>(), MakeBody(source, data, fileName), [&done](HttpResponse *response)
+            {
+                if (response->IsError() || response->HttpResponseCode() != 200)
+                {
+                    printf("ERROR: upload failed\n");
+                    exit(1);
+                }
+                done = true;
+            });
+            if (FAILED(result))
+            {
+                printf("ERROR: upload failed to start\n");
+                exit(1);
+            }
+
+            while (!done)
+            {
+                for (auto &response : manager.DoWork())
+                {
+                    response.Process();
+                }
+            }
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        if (server.GetStats().bytesReceived < uploads * data.size())
+        {
+            printf("ERROR: the server received %llu bytes\n", static_cast<unsigned long long>(server.GetStats().bytesReceived));
+            exit(1);
+        }
+
+        return double(data.size()) * uploads / (1024.0 * 1024.0) / seconds;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t megabytesPerMeasurement = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 256;
+
+    auto server = std::make_shared<LoopbackHttpServer>(1);
+    LoopbackRoute route;
+    route.pathPrefix = L"/upload";
+    server->AddRoute(route);
+
+    HttpCallManager manager(std::make_shared<LoopbackHttpTransport>(server));
+
+    const Source sources[] = { Source::Buffer, Source::File, Source::Producer, Source::PooledCopy };
+
+    printf("%zu MB uploaded per measurement, MB/s\n", megabytesPerMeasurement);
+    printf("%-8s", "size");
+    for (auto source : sources)
+    {
+        printf(" %12s", SourceName(source));
+    }
+    printf("\n");
+
+    for (size_t megabytes = 1; megabytes <= 64; megabytes *= 2)
+    {
+        std::vector<unsigned char> data(megabytes * 1024 * 1024);
+        for (size_t i = 0; i < data.size(); ++i)
+        {
+            data[i] = static_cast<unsigned char>(i * 31 + (i >> 12));
+        }
+
+        char path[] = "/tmp/HttpUploadBenchmarkXXXXXX";
+        int file = mkstemp(path);
+        if (file < 0 || write(file, data.data(), data.size()) != static_cast<ssize_t>(data.size()))
+        {
+            printf("ERROR: can't write the upload file\n");
+            return 1;
+        }
+        close(file);
+        std::wstring fileName(path, path + strlen(path));
+
+        size_t uploads = std::max<size_t>(2, megabytesPerMeasurement / megabytes);
+        printf("%-8s", (std::to_string(megabytes) + " MB").c_str());
+        for (auto source : sources)
+        {
+            printf(" %12.0f", Run(manager, *server, source, data, fileName, uploads));
+            fflush(stdout);
+        }
+        printf("\n");
+
+        unlink(path);
+    }
+
+    return 0;
+}